@@ -0,0 +1,36 @@
+// file auto-generated by assets packer, do not modify directly
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <core/data.h>
+#include <core/defs.h>
+
+#define ASSET_COVER data_flash(0x0000)
+extern const uint8_t ASSET_COVER_HEADER[];
+#define ASSET_COVER_DRAW(x, y) (GRAPHICS_IMAGE_STATIC(graphics_image_4bit_mixed, ASSET_COVER, ASSET_COVER_HEADER, x, y))
+#define ASSET_COVER_DRAW_REGION(x, y, top, bottom) (GRAPHICS_IMAGE_STATIC(graphics_image_4bit_mixed_region, ASSET_COVER, ASSET_COVER_HEADER, x, y, top, bottom))
+
+#define ASSET_IMAGE_4BIT_RAW data_flash(0x042a)
+extern const uint8_t ASSET_IMAGE_4BIT_RAW_HEADER[];
+#define ASSET_IMAGE_4BIT_RAW_DRAW(x, y) (GRAPHICS_IMAGE_STATIC(graphics_image_4bit_raw, ASSET_IMAGE_4BIT_RAW, ASSET_IMAGE_4BIT_RAW_HEADER, x, y))
+#define ASSET_IMAGE_4BIT_RAW_DRAW_REGION(x, y, top, bottom) (GRAPHICS_IMAGE_STATIC(graphics_image_4bit_raw_region, ASSET_IMAGE_4BIT_RAW, ASSET_IMAGE_4BIT_RAW_HEADER, x, y, top, bottom))
+#define ASSET_IMAGE_4BIT_MIXED data_flash(0x0c2e)
+extern const uint8_t ASSET_IMAGE_4BIT_MIXED_HEADER[];
+#define ASSET_IMAGE_4BIT_MIXED_DRAW(x, y) (GRAPHICS_IMAGE_STATIC(graphics_image_4bit_mixed, ASSET_IMAGE_4BIT_MIXED, ASSET_IMAGE_4BIT_MIXED_HEADER, x, y))
+#define ASSET_IMAGE_4BIT_MIXED_DRAW_REGION(x, y, top, bottom) (GRAPHICS_IMAGE_STATIC(graphics_image_4bit_mixed_region, ASSET_IMAGE_4BIT_MIXED, ASSET_IMAGE_4BIT_MIXED_HEADER, x, y, top, bottom))
+#define ASSET_IMAGE_4BIT_LZ data_flash(0x0fc3)
+extern const uint8_t ASSET_IMAGE_4BIT_LZ_HEADER[];
+#define ASSET_IMAGE_4BIT_LZ_DRAW(x, y) (GRAPHICS_IMAGE_STATIC(graphics_image_4bit_lz, ASSET_IMAGE_4BIT_LZ, ASSET_IMAGE_4BIT_LZ_HEADER, x, y))
+#define ASSET_IMAGE_4BIT_LZ_DRAW_REGION(x, y, top, bottom) (GRAPHICS_IMAGE_STATIC(graphics_image_4bit_lz_region, ASSET_IMAGE_4BIT_LZ, ASSET_IMAGE_4BIT_LZ_HEADER, x, y, top, bottom))
+#define ASSET_IMAGE_1BIT_RAW data_flash(0x10ff)
+extern const uint8_t ASSET_IMAGE_1BIT_RAW_HEADER[];
+#define ASSET_IMAGE_1BIT_RAW_DRAW(x, y) (GRAPHICS_IMAGE_STATIC(graphics_image_1bit_raw, ASSET_IMAGE_1BIT_RAW, ASSET_IMAGE_1BIT_RAW_HEADER, x, y))
+#define ASSET_IMAGE_1BIT_RAW_DRAW_REGION(x, y, top, bottom) (GRAPHICS_IMAGE_STATIC(graphics_image_1bit_raw_region, ASSET_IMAGE_1BIT_RAW, ASSET_IMAGE_1BIT_RAW_HEADER, x, y, top, bottom))
+#define ASSET_IMAGE_1BIT_MIXED data_flash(0x1303)
+extern const uint8_t ASSET_IMAGE_1BIT_MIXED_HEADER[];
+#define ASSET_IMAGE_1BIT_MIXED_DRAW(x, y) (GRAPHICS_IMAGE_STATIC(graphics_image_1bit_mixed, ASSET_IMAGE_1BIT_MIXED, ASSET_IMAGE_1BIT_MIXED_HEADER, x, y))
+#define ASSET_IMAGE_1BIT_MIXED_DRAW_REGION(x, y, top, bottom) (GRAPHICS_IMAGE_STATIC(graphics_image_1bit_mixed_region, ASSET_IMAGE_1BIT_MIXED, ASSET_IMAGE_1BIT_MIXED_HEADER, x, y, top, bottom))
+
+#define ASSET_SOUND_EXAMPLE 0x155c
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+#include <core/time.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Duration in system ticks during which each benchmark is repeated (1 s).
+// With the 256 Hz system tick, the result is accurate to about 0.5%.
+#define BENCH_DURATION 256
+
+// Nanoseconds per system tick.
+#define BENCH_NS_PER_TICK (1000000000UL / SYSTICK_FREQUENCY)
+
+// Number of benchmarks timed by repeatedly calling a function.
+#define BENCH_CALLS_COUNT 14
+
+// Page heights for which the frame time is measured, at most DISPLAY_MAX_PAGE_HEIGHT.
+#define BENCH_PAGE_HEIGHTS_COUNT 3
+
+#define BENCH_BUTTON_RESTART BUTTON4
+#define BENCH_BUTTON_EXIT BUTTON0
+
+typedef enum {
+    // benchmarks timed by repeatedly calling a function.
+    BENCH_STATE_CALLS,
+    // frame time for each page height.
+    BENCH_STATE_FRAMES,
+    BENCH_STATE_DONE,
+} bench_state_t;
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+    // bytes transferred per call, for throughput, or 0 if not applicable.
+    uint16_t bytes;
+} bench_call_t;
+
+typedef struct {
+    bench_state_t state;
+    // index of the next benchmark to run, or page height index for frame time.
+    uint8_t index;
+    // start time and number of frames drawn for frame time.
+    systime_t frame_start;
+    uint16_t frames;
+} bench_t;
+
+extern bench_t bench;
+
+#endif //BENCH_BENCH_H
@@ -0,0 +1,20 @@
+from assets_packer import Packer
+
+p = Packer(cover_image="cover.png")
+
+# the same images in each encoding, to compare drawing time between encodings.
+with p.group("image"):
+    p.image("pattern.png", name="4bit_raw", raw=True, binary=False)
+    p.image("pattern.png", name="4bit_mixed", binary=False)
+    p.image("pattern.png", name="4bit_lz", lz=True)
+    p.image("pattern-binary.png", name="1bit_raw", raw=True, binary=True)
+    p.image("pattern-binary.png", name="1bit_mixed", binary=True)
+
+# sound data from the example in core/sound.h, preceded by the signature.
+with p.group("sound"):
+    p.raw(bytes([0xf2, 0x01, 0x05, 0x00, 0x00, 0xff, 0x02, 0x24, 0x00, 0x04, 0x18, 0x3f, 0x19,
+                 0xc1, 0xf3, 0x24, 0x07, 0x25, 0x83, 0x26, 0x27, 0x28, 0x29, 0x82, 0x30,
+                 0x31, 0x6d, 0x0f, 0x6e, 0x80, 0x54, 0xc0, 0x83, 0xa9, 0x7e, 0xc0, 0x18,
+                 0x18, 0xff, 0xff, 0x00, 0xff, 0xff]), name="example")
+
+p.pack()
@@ -0,0 +1,274 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <bench.h>
+#include <assets.h>
+
+#include <sys/display.h>
+#include <sys/uart.h>
+
+#include <core/app.h>
+#include <core/callback.h>
+#include <core/display.h>
+#include <core/eeprom.h>
+#include <core/flash.h>
+#include <core/graphics.h>
+#include <core/input.h>
+#include <core/sound.h>
+
+#include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define EEPROM_BENCH_SIZE 32
+
+#define LINE_HEIGHT 6
+#define RESULTS_Y 10
+#define RESULTS_VALUE_X 72
+
+bench_t bench;
+
+static uint8_t buffer[FLASH_PAGE_SIZE];
+
+static void bench_clear(void) {
+    graphics_clear(DISPLAY_COLOR_BLACK);
+}
+
+static void bench_fill_rect(void) {
+    graphics_set_color(DISPLAY_COLOR_WHITE);
+    graphics_fill_rect(0, sys_display_page_ystart, DISPLAY_WIDTH, display_get_page_height());
+}
+
+static void bench_text(void) {
+    graphics_set_color(DISPLAY_COLOR_WHITE);
+    graphics_text(0, (int8_t) sys_display_page_ystart, "THE QUICK BROWN FOX 0123456789");
+}
+
+// images are drawn at the top of the current page so that a full page of rows is drawn.
+static void bench_image_1bit_raw(void) {
+    graphics_set_color(DISPLAY_COLOR_WHITE);
+    graphics_image_1bit_raw(ASSET_IMAGE_1BIT_RAW, 0, sys_display_page_ystart);
+}
+
+static void bench_image_1bit_mixed(void) {
+    graphics_set_color(DISPLAY_COLOR_WHITE);
+    graphics_image_1bit_mixed(ASSET_IMAGE_1BIT_MIXED, 0, sys_display_page_ystart);
+}
+
+static void bench_image_4bit_raw(void) {
+    graphics_image_4bit_raw(ASSET_IMAGE_4BIT_RAW, 0, sys_display_page_ystart);
+}
+
+static void bench_image_4bit_mixed(void) {
+    graphics_image_4bit_mixed(ASSET_IMAGE_4BIT_MIXED, 0, sys_display_page_ystart);
+}
+
+static void bench_image_4bit_lz(void) {
+    graphics_image_4bit_lz(ASSET_IMAGE_4BIT_LZ, 0, sys_display_page_ystart);
+}
+
+static void bench_flash_read_16(void) {
+    flash_read(0, 16, buffer);
+}
+
+static void bench_flash_read_64(void) {
+    flash_read(0, 64, buffer);
+}
+
+static void bench_flash_read_256(void) {
+    flash_read(0, 256, buffer);
+}
+
+static void bench_eeprom_read(void) {
+    eeprom_read(0, EEPROM_BENCH_SIZE, buffer);
+}
+
+static void bench_eeprom_write(void) {
+    // data is changed on every call, since nothing is written if it's unchanged.
+    memset(buffer, buffer[0] + 1, EEPROM_BENCH_SIZE);
+    eeprom_write(0, EEPROM_BENCH_SIZE, buffer);
+}
+
+static void bench_sound_load(void) {
+    // tracks are loaded but never started, so nothing is heard.
+    sound_load(data_flash(ASSET_SOUND_EXAMPLE));
+}
+
+static const bench_call_t BENCH_CALLS[BENCH_CALLS_COUNT] = {
+        {"clear", bench_clear, 0},
+        {"fill_rect", bench_fill_rect, 0},
+        {"text", bench_text, 0},
+        {"image_1bit_raw", bench_image_1bit_raw, 0},
+        {"image_1bit_mixed", bench_image_1bit_mixed, 0},
+        {"image_4bit_raw", bench_image_4bit_raw, 0},
+        {"image_4bit_mixed", bench_image_4bit_mixed, 0},
+        {"image_4bit_lz", bench_image_4bit_lz, 0},
+        {"flash_read_16", bench_flash_read_16, 16},
+        {"flash_read_64", bench_flash_read_64, 64},
+        {"flash_read_256", bench_flash_read_256, 256},
+        {"eeprom_read_32", bench_eeprom_read, EEPROM_BENCH_SIZE},
+        {"eeprom_write_32", bench_eeprom_write, EEPROM_BENCH_SIZE},
+        {"sound_load", bench_sound_load, 0},
+};
+
+static const uint8_t PAGE_HEIGHTS[BENCH_PAGE_HEIGHTS_COUNT] = {8, 16, 32};
+
+// time per call or per frame in nanoseconds for each benchmark, 0 if not run yet.
+static uint32_t results[BENCH_CALLS_COUNT + BENCH_PAGE_HEIGHTS_COUNT];
+
+static void uart_print(const char* str) {
+    while (*str) {
+        sys_uart_write(*str++);
+    }
+}
+
+static void write_result(const char* name, uint8_t page_height, uint32_t ns, uint16_t bytes) {
+    char buf[48];
+    if (page_height) {
+        sprintf(buf, "%s_%" PRIu8 ",%" PRIu32 ",%" PRIu16 "\n", name, page_height, ns, bytes);
+    } else {
+        sprintf(buf, "%s,%" PRIu32 ",%" PRIu16 "\n", name, ns, bytes);
+    }
+    uart_print(buf);
+}
+
+/**
+ * Call a function repeatedly for `BENCH_DURATION` and return the average time per call
+ * in nanoseconds. The timing starts on a system tick edge, and the function is always called
+ * at least once, so a call longer than the duration is measured correctly.
+ */
+static uint32_t time_calls(void (*run)(void)) {
+    systime_t start = time_get();
+    while (time_get() == start);
+    start = time_get();
+    uint32_t calls = 0;
+    systime_t elapsed;
+    do {
+        run();
+        ++calls;
+        elapsed = time_get() - start;
+    } while (elapsed < BENCH_DURATION);
+    return elapsed * BENCH_NS_PER_TICK / calls;
+}
+
+static void start_frames(void) {
+    display_set_page_height(PAGE_HEIGHTS[bench.index]);
+    bench.frame_start = time_get();
+    bench.frames = 0;
+}
+
+static void bench_start(void) {
+    memset(results, 0, sizeof results);
+    bench.state = BENCH_STATE_CALLS;
+    bench.index = 0;
+    uart_print("name,ns,bytes\n");
+}
+
+void callback_setup(void) {
+#ifdef SIMULATION
+    sim_flash_load("assets.dat");
+    sim_eeprom_load("eeprom.dat");
+#endif
+
+    sys_uart_init(SYS_UART_BAUD_RATE(UART_BAUD));
+    graphics_set_font(ASSET_FONT_3X5_BUILTIN);
+    bench_start();
+}
+
+bool callback_loop(void) {
+    input_latch();
+    if (bench.state == BENCH_STATE_CALLS) {
+        // a single benchmark is run per loop, to show progress in between.
+        const bench_call_t* call = &BENCH_CALLS[bench.index];
+        const uint32_t ns = time_calls(call->run);
+        results[bench.index] = ns;
+        write_result(call->name, 0, ns, call->bytes);
+        ++bench.index;
+        if (bench.index == BENCH_CALLS_COUNT) {
+            bench.state = BENCH_STATE_FRAMES;
+            bench.index = 0;
+            start_frames();
+        }
+        return true;
+
+    } else if (bench.state == BENCH_STATE_FRAMES) {
+        // frames are drawn back to back, the frame time includes drawing the progress screen.
+        const systime_t elapsed = time_get() - bench.frame_start;
+        if (elapsed >= BENCH_DURATION && bench.frames > 0) {
+            const uint32_t ns = elapsed * BENCH_NS_PER_TICK / bench.frames;
+            results[BENCH_CALLS_COUNT + bench.index] = ns;
+            write_result("frame", PAGE_HEIGHTS[bench.index], ns, 0);
+            ++bench.index;
+            if (bench.index == BENCH_PAGE_HEIGHTS_COUNT) {
+                display_set_page_height(DISPLAY_PAGE_HEIGHT);
+                bench.state = BENCH_STATE_DONE;
+                sys_uart_flush();
+            } else {
+                start_frames();
+            }
+        }
+        return true;
+    }
+
+    const uint8_t clicked = input_get_clicked();
+    if (clicked & BENCH_BUTTON_RESTART) {
+        bench_start();
+        return true;
+    } else if (clicked & BENCH_BUTTON_EXIT) {
+        app_terminate();
+    }
+    return false;
+}
+
+static void draw_result(uint8_t i, const char* name, uint8_t page_height) {
+    const int8_t y = (int8_t) (RESULTS_Y + i * LINE_HEIGHT);
+    char buf[24];
+    if (page_height) {
+        sprintf(buf, "%s %" PRIu8, name, page_height);
+    } else {
+        strcpy(buf, name);
+    }
+    // the builtin font has no lowercase letters and no underscore.
+    for (char* c = buf; *c; ++c) {
+        *c = *c == '_' ? ' ' : (char) toupper(*c);
+    }
+    graphics_text(0, y, buf);
+    const uint32_t ns = results[i];
+    if (ns) {
+        // shown in microseconds with one decimal.
+        sprintf(buf, "%" PRIu32 ".%" PRIu8 " US", ns / 1000, (uint8_t) (ns / 100 % 10));
+        graphics_text(RESULTS_VALUE_X, y, buf);
+    }
+}
+
+void callback_draw(void) {
+    if (bench.state == BENCH_STATE_FRAMES) {
+        ++bench.frames;
+    }
+
+    graphics_clear(DISPLAY_COLOR_BLACK);
+    graphics_set_color(DISPLAY_COLOR_WHITE);
+    graphics_text(0, 0, bench.state == BENCH_STATE_DONE ? "BENCHMARK DONE" : "BENCHMARK...");
+
+    graphics_set_color(11);
+    for (uint8_t i = 0; i < BENCH_CALLS_COUNT; ++i) {
+        draw_result(i, BENCH_CALLS[i].name, 0);
+    }
+    for (uint8_t i = 0; i < BENCH_PAGE_HEIGHTS_COUNT; ++i) {
+        draw_result(BENCH_CALLS_COUNT + i, "frame", PAGE_HEIGHTS[i]);
+    }
+}
@@ -0,0 +1,2 @@
+# UART is used to stream the results as CSV.
+DEFINES += SYS_UART_ENABLE UART_BAUD=250000
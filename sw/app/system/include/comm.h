@@ -38,8 +38,10 @@
  * The payload of different packet types defined are described below.
  * "RX" refers to the receiving side of the game console and "TX" refers to the transmitting side.
  *
- * For every packet sent, the transmitter should wait until the response packet is fully received.
- * The reason for this is that the RX buffer size is limited to the size of one packet.
+ * Packets are handled in order and each one gets a response (several for FLASH_STREAM).
+ * The transmitter can send more packets before receiving the responses to previous ones, as long
+ * as the total size of packets without a fully received response doesn't exceed the RX buffer
+ * size reported by the VERSION packet. Otherwise, data would be lost.
  */
 
 typedef enum {
@@ -50,6 +52,7 @@ typedef enum {
      * [0..1]: system app version
      * [2..3]: bootloader version
      * [4..5]: gcprog first compatible version
+     * [6..7]: UART RX buffer size in bytes
      */
     PACKET_VERSION = 0x00,
 
@@ -86,6 +89,111 @@ typedef enum {
      */
     PACKET_SLEEP = 0x03,
 
+    /**
+     * Read data from the flash memory.
+     * - RX payload:
+     * [0..2]: address, big endian
+     * [3]: number of bytes to read (1-253)
+     * - TX payload:
+     * [0..n]: data read
+     */
+    PACKET_FLASH_READ = 0x04,
+
+    /**
+     * Program data in the flash memory. The firmware waits until the flash is ready, enables
+     * writing, then programs the data and waits until programming is done before replying.
+     * The data must not cross a flash page boundary and must be in erased state beforehand.
+     * - RX payload:
+     * [0..2]: address, big endian
+     * [3..n]: data to program (1-250 bytes)
+     * - TX payload: empty
+     */
+    PACKET_FLASH_WRITE = 0x05,
+
+    /**
+     * Erase a block of the flash memory. The firmware waits until the flash is ready, enables
+     * writing, then starts the erase and replies immediately, since erasing can take seconds.
+     * Busy status must be polled with the SPI packet afterwards.
+     * - RX payload:
+     * [0]: erase instruction (see flash datasheet)
+     * [1..3]: block address, big endian (omitted for chip erase)
+     * - TX payload: empty
+     */
+    PACKET_FLASH_ERASE = 0x06,
+
+    /**
+     * Stream data from the flash memory. The firmware replies with as many back-to-back
+     * FLASH_STREAM packets as needed to transmit the requested data, without waiting for
+     * further requests. Each response packet has a full payload, except the last one.
+     * Transmission is paced by the UART TX buffer.
+     * - RX payload:
+     * [0..2]: address, big endian
+     * [3..5]: number of bytes to read, big endian (at least 1)
+     * - TX payloads:
+     * [0..n]: next chunk of data read
+     */
+    PACKET_FLASH_STREAM = 0x07,
+
+    /**
+     * Compute the CRC-CCITT of a range of the flash or EEPROM memory, with the same
+     * CRC used by the bootloader (initial value 0xffff). Used to verify written data.
+     * - RX payload:
+     * [0]: memory (0x0: flash memory, 0x1: EEPROM memory, same as SPI packet)
+     * [1..3]: address, big endian
+     * [4..6]: number of bytes, big endian (at least 1)
+     * - TX payload:
+     * [0..1]: CRC
+     */
+    PACKET_CRC_RANGE = 0x08,
+
+    /**
+     * Same as FLASH_WRITE but the data is LZSS compressed, using the same format as the one
+     * used by Tile World for levels. The firmware decompresses the data before programming it.
+     * Each packet is compressed independently, data decompressed from a packet must not exceed
+     * 256 bytes and must not cross a flash page boundary. If the data doesn't decompress
+     * correctly, nothing is programmed and the reply is omitted.
+     * - RX payload:
+     * [0..2]: address, big endian
+     * [3..n]: compressed data to program
+     * - TX payload: empty
+     */
+    PACKET_FLASH_WRITE_LZSS = 0x09,
+
+    /**
+     * Change the UART baud rate. The reply is sent at the current baud rate, then the firmware
+     * switches to the new baud rate. The new baud rate must be confirmed by sending a VERSION
+     * packet within 200 ms, otherwise or if anything else is received, the firmware goes back
+     * to the default baud rate (250K). The default baud rate is also restored on unlock.
+     * - RX payload:
+     * [0..3]: baud rate, little endian
+     * - TX payload:
+     * [0]: 0x01 if baud rate is supported and will be changed, 0x00 otherwise.
+     */
+    PACKET_BAUD = 0x0a,
+
+    /**
+     * Copy data from one flash location to another on the device, one page at a time.
+     * The firmware replies once all data has been programmed. The destination must be in erased
+     * state beforehand and must not overlap the source. The length should be kept small enough
+     * (a few kB) so that the reply arrives within the host timeout.
+     * - RX payload:
+     * [0..2]: source address, big endian
+     * [3..5]: destination address, big endian
+     * [6..7]: number of bytes to copy, big endian
+     * - TX payload: empty
+     */
+    PACKET_FLASH_COPY = 0x0b,
+
+    /**
+     * Notify the system app that an entry of the flash app index was changed. Writing to the
+     * flash doesn't reload the index, so this must be sent after changing it, for each entry
+     * changed. Only that entry is read again, and the memory usage order is updated.
+     * - RX payload:
+     * [0]: index entry changed (0-31), or 0xff to reload the whole index.
+     * - TX payload: empty
+     */
+    PACKET_INDEX_CHANGED = 0x0c,
+
     /**
      * Get info on the battery.
      * - RX payload: empty
@@ -113,12 +221,48 @@ typedef enum {
      * - TX payload: empty
      */
     PACKET_BATTERY_LOAD = 0x12,
+
+    /**
+     * Get performance counters gathered by the system app since the last PERF_STATS packet,
+     * then reset them. Loop phase samples are only available if the bootloader and the system
+     * app are built with LOOP_MONITOR, and the sound interrupt count only with SOUND_MONITOR.
+     * Unavailable counters are zero. Stack usage is measured since the system app was started,
+     * and is zero in simulation.
+     * - RX payload: empty
+     * - TX payload:
+     * [0..1]: system ticks elapsed since last request, saturated
+     * [2..17]: frame time histogram, 8 buckets of 4 system ticks each
+     * [18..19]: frames skipped by the render scheduler
+     * [20..21]: sound channel timer interrupts
+     * [22..35]: main loop phase samples, for each phase (see sys_loop_phase_t)
+     * [36]: bit 0 set if loop phase samples are available, bit 1 if sound count is available
+     * [37..38]: stack high-water mark in bytes
+     * [39..40]: RAM left for the stack in bytes
+     * All 16-bit values are little endian.
+     */
+    PACKET_PERF_STATS = 0x20,
+
+    /**
+     * Get the events recorded in the event trace since the last EVENT_TRACE packet, then clear
+     * them (see core/evtrace.h). Only available if the bootloader and the system app are built
+     * with EVENT_TRACE, otherwise the payload is empty.
+     * - RX payload: empty
+     * - TX payload:
+     * [0..1]: current system time
+     * [2]: number of events overwritten before being read, saturated
+     * [3..]: events, oldest first, 4 bytes each:
+     *     [0]: event (see evtrace_event_t)
+     *     [1]: argument
+     *     [2..3]: system time at which the event was recorded
+     * All 16-bit values are little endian.
+     */
+    PACKET_EVENT_TRACE = 0x21,
 } packet_type_t;
 
 /**
  * Receive & decode data from RX.
- * Once a packet signature is detected, this function blocks until packet is fully received.
- * If a fast mode enable packet is received, this function blocks until fast mode is disabled.
+ * A packet is only handled once it has been fully received in the RX buffer, otherwise this
+ * function returns immediately. If a LOCK packet is received, this function blocks until unlocked.
  * Must not be called with interrupts enabled.
  */
 void comm_receive(void);
@@ -24,6 +24,7 @@
 #include <core/flash.h>
 #include <core/eeprom.h>
 #include <core/graphics.h>
+#include <core/evtrace.h>
 
 // display frames per second
 #ifdef SIMULATION
@@ -35,6 +36,14 @@
 #define APP_INDEX_SIZE 32
 #define APP_ID_NONE 0
 
+// number of buckets in the frame time histogram, each bucket spans 4 system ticks (~16 ms),
+// the last bucket also counts all longer frame times.
+#define PERF_FRAME_TIME_BUCKETS 8
+#define PERF_FRAME_TIME_BUCKET_SHIFT 2
+
+// number of entries in the event trace buffer, if built with EVENT_TRACE (power of two).
+#define EVENT_TRACE_SIZE 32
+
 typedef enum {
     STATE_APPS = 0,
     STATE_FLASH = 1,
@@ -91,6 +100,11 @@ typedef struct {
     uint8_t max_position;
     // battery calibration
     disp_color_t battery_calib_color;
+    // performance stats, number of frames for each frame time since last PERF_STATS packet.
+    uint16_t frame_time_histogram[PERF_FRAME_TIME_BUCKETS];
+#ifdef EVENT_TRACE
+    evtrace_entry_t event_trace[EVENT_TRACE_SIZE];
+#endif
 } system_t;
 
 extern system_t state;
@@ -100,6 +114,12 @@ extern system_t state;
  */
 void system_load_flash_index(void);
 
+/**
+ * Read a single entry of the flash index again after it was changed, and update its position
+ * in the flash usage index without reloading the whole index.
+ */
+void system_update_flash_entry(uint8_t slot);
+
 /**
  * If EEPROM is marked as dirty, load or reload EEPROM index.
  */
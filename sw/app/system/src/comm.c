@@ -23,6 +23,9 @@
 #include <sys/spi.h>
 #include <sys/power.h>
 #include <sys/display.h>
+#include <sys/sound.h>
+#include <sys/time.h>
+#include <sys/ram.h>
 
 #include <core/defs.h>
 #include <core/time.h>
@@ -38,6 +41,7 @@
 #endif
 
 #define LOCK_BLINK_DURATION 250  // ms
+#define BAUD_CONFIRM_TIMEOUT 200  // ms
 
 enum {
     SPI_CS_FLASH = 0x0,
@@ -45,20 +49,63 @@ enum {
     SPI_CS_DISPLAY = 0x2,
 };
 
-// When a packet is being received, the comm_receive function will block until the packet has been
-// fully received. Hence, the payload buffer can share memory with the display buffer.
+// flash instructions used by the flash packets, see AT25SF081B datasheet.
+#define FLASH_INSTRUCTION_PAGE_PROGRAM 0x02
+#define FLASH_INSTRUCTION_WRITE_ENABLE 0x06
+
+// instructions shared by the flash and the EEPROM, see FT25C32A datasheet for the EEPROM.
+// The EEPROM uses a 2 bytes address instead of 3 bytes.
+#define MEMORY_INSTRUCTION_READ 0x03
+#define MEMORY_INSTRUCTION_READ_STATUS 0x05
+#define MEMORY_STATUS_BUSY 0x01
+
+// A packet is only read from the RX buffer once it has been fully received, and it's handled
+// right away. Hence, the payload buffer can share memory with the display buffer.
 static SHARED_DISP_BUF uint8_t payload[PAYLOAD_MAX_SIZE];
 
+// Buffer for data decompressed from a FLASH_WRITE_LZSS packet or copied by a FLASH_COPY
+// packet, one flash page.
+#define FLASH_PAGE_SIZE 256
+static SHARED_DISP_BUF uint8_t flash_page[FLASH_PAGE_SIZE];
+
+// LZSS format parameters, see app/tworld/utils/lzss.py.
+#define LZSS_LENGTH_BITS1 2
+#define LZSS_LENGTH_BITS2 7
+#define LZSS_BREAKEVEN1 2
+#define LZSS_BREAKEVEN2 3
+#define LZSS_LENGTH_MASK1 ((1 << LZSS_LENGTH_BITS1) - 1)
+#define LZSS_LENGTH_MASK2 ((1 << LZSS_LENGTH_BITS2) - 1)
+
+// INDEX_CHANGED packet payload to reload the whole flash index.
+#define INDEX_CHANGED_ALL 0xff
+
+// number of main loop phases reported by the PERF_STATS packet.
+#define PERF_LOOP_PHASE_COUNT 7
+
 static bool locked;
 
-static void comm_transmit(uint8_t type, uint8_t payload_length) {
+static systime_t perf_last_time;
+
+// true if baud rate was changed from the default.
+static bool baud_changed;
+// true if baud rate was changed and hasn't been confirmed yet.
+static bool baud_pending;
+static systime_t baud_change_time;
+
+/**
+ * Transmit a packet with a payload from a buffer. The payload is written by the UART interrupt
+ * while the packet is handled further, so the buffer must not be modified until the next packet
+ * is transmitted or until `sys_uart_wait_buffer` returns.
+ */
+static void comm_transmit_buffer(uint8_t type, const uint8_t* buffer, uint8_t payload_length) {
     sys_uart_write(PACKET_SIGNATURE);
     sys_uart_write(type);
     sys_uart_write(payload_length + PACKET_HEADER_SIZE - 1);
-    const uint8_t* ptr = payload;
-    while (payload_length--) {
-        sys_uart_write(*ptr++);
-    }
+    sys_uart_write_buffer(buffer, payload_length, 0);
+}
+
+static void comm_transmit(uint8_t type, uint8_t payload_length) {
+    comm_transmit_buffer(type, payload, payload_length);
 }
 
 static void handle_packet_version(void) {
@@ -68,7 +115,9 @@ static void handle_packet_version(void) {
     payload[3] = BOOT_VERSION >> 8;
     payload[4] = VERSION_PROG_COMP & 0xff;
     payload[5] = VERSION_PROG_COMP >> 8;
-    comm_transmit(PACKET_VERSION, 6);
+    payload[6] = SYS_UART_RX_BUFFER_SIZE & 0xff;
+    payload[7] = SYS_UART_RX_BUFFER_SIZE >> 8;
+    comm_transmit(PACKET_VERSION, 8);
 }
 
 static void handle_packet_spi(uint8_t data_length) {
@@ -77,7 +126,6 @@ static void handle_packet_spi(uint8_t data_length) {
     const uint8_t cs = options & 0x3;
     if (cs == SPI_CS_FLASH) {
         sys_spi_select_flash();
-        state.flags |= SYSTEM_FLAG_FLASH_DIRTY;
     } else if (cs == SPI_CS_EEPROM) {
         sys_spi_select_eeprom();
         state.flags |= SYSTEM_FLAG_EEPROM_DIRTY;
@@ -95,6 +143,322 @@ static void handle_packet_spi(uint8_t data_length) {
     }
 }
 
+static void select_memory(uint8_t cs) {
+    if (cs == SPI_CS_FLASH) {
+        sys_spi_select_flash();
+    } else {
+        sys_spi_select_eeprom();
+    }
+}
+
+static void memory_wait_ready(uint8_t cs) {
+    // the flash and the EEPROM share the same status instruction and busy bit.
+    select_memory(cs);
+    sys_spi_transmit_single(MEMORY_INSTRUCTION_READ_STATUS);
+    uint8_t status;
+    do {
+        // the status register is output continuously until the CS line is released.
+        sys_spi_transceive(1, &status);
+    } while (status & MEMORY_STATUS_BUSY);
+    sys_spi_deselect_all();
+}
+
+static void flash_wait_ready(void) {
+    memory_wait_ready(SPI_CS_FLASH);
+}
+
+static void flash_write_enable(void) {
+    sys_spi_select_flash();
+    sys_spi_transmit_single(FLASH_INSTRUCTION_WRITE_ENABLE);
+    sys_spi_deselect_flash();
+}
+
+static void handle_packet_flash_read(uint8_t payload_length) {
+    const uint8_t length = payload[3];
+    if (payload_length != 4 || length == 0) {
+        return;
+    }
+    flash_wait_ready();
+    sys_spi_select_flash();
+    sys_spi_transmit_single(MEMORY_INSTRUCTION_READ);
+    sys_spi_transmit(3, payload);
+    sys_spi_transceive(length, payload);
+    sys_spi_deselect_flash();
+    comm_transmit(PACKET_FLASH_READ, length);
+}
+
+static void handle_packet_flash_write(uint8_t payload_length) {
+    if (payload_length < 4) {
+        return;
+    }
+    flash_wait_ready();
+    flash_write_enable();
+    sys_spi_select_flash();
+    sys_spi_transmit_single(FLASH_INSTRUCTION_PAGE_PROGRAM);
+    sys_spi_transmit(payload_length, payload);
+    sys_spi_deselect_flash();
+    flash_wait_ready();
+    comm_transmit(PACKET_FLASH_WRITE, 0);
+}
+
+/**
+ * Decompress `length` bytes of LZSS data from `src` into the flash page buffer.
+ * Returns the decompressed size, or 0 if data is invalid or doesn't fit in the buffer.
+ */
+static uint16_t lzss_decode_page(const uint8_t* src, uint8_t length) {
+    const uint8_t* end = src + length;
+    uint16_t pos = 0;
+    uint8_t type_byte = 0;
+    uint8_t type_bits = 0;
+    while (src != end) {
+        if (type_bits == 0) {
+            // type token (for next 8 data tokens)
+            type_byte = *src++;
+            type_bits = 8;
+            if (src == end) {
+                break;
+            }
+        }
+        uint8_t b = *src++;
+        if (type_byte & 1) {
+            // back reference token
+            uint8_t reflen;
+            uint16_t distance;
+            if (b & 0x1) {
+                // two bytes encoding
+                if (src == end) {
+                    return 0;
+                }
+                uint16_t backref = (uint16_t) (b | *src++ << 8) >> 1;
+                reflen = (backref & LZSS_LENGTH_MASK2) + LZSS_BREAKEVEN2;
+                distance = (backref >> LZSS_LENGTH_BITS2) + 1;
+            } else {
+                // single byte encoding
+                uint8_t backref = b >> 1;
+                reflen = (backref & LZSS_LENGTH_MASK1) + LZSS_BREAKEVEN1;
+                distance = (backref >> LZSS_LENGTH_BITS1) + 1;
+            }
+            if (distance > pos || pos + reflen > FLASH_PAGE_SIZE) {
+                return 0;
+            }
+            // reference may overlap with output, must be copied byte by byte.
+            const uint8_t* ref = &flash_page[pos - distance];
+            uint8_t* out = &flash_page[pos];
+            pos += reflen;
+            while (reflen--) {
+                *out++ = *ref++;
+            }
+        } else {
+            // byte token
+            if (pos == FLASH_PAGE_SIZE) {
+                return 0;
+            }
+            flash_page[pos++] = b;
+        }
+        type_byte >>= 1;
+        --type_bits;
+    }
+    return pos;
+}
+
+static void handle_packet_flash_write_lzss(uint8_t payload_length) {
+    if (payload_length < 4) {
+        return;
+    }
+    const uint16_t length = lzss_decode_page(&payload[3], payload_length - 3);
+    if (length == 0) {
+        return;
+    }
+    flash_wait_ready();
+    flash_write_enable();
+    sys_spi_select_flash();
+    sys_spi_transmit_single(FLASH_INSTRUCTION_PAGE_PROGRAM);
+    sys_spi_transmit(3, payload);
+    sys_spi_transmit(length, flash_page);
+    sys_spi_deselect_flash();
+    flash_wait_ready();
+    comm_transmit(PACKET_FLASH_WRITE_LZSS, 0);
+}
+
+static void handle_packet_flash_copy(uint8_t payload_length) {
+    if (payload_length != 8) {
+        return;
+    }
+    uint24_t src = (uint24_t) payload[0] << 16 | (uint16_t) payload[1] << 8 | payload[2];
+    uint24_t dst = (uint24_t) payload[3] << 16 | (uint16_t) payload[4] << 8 | payload[5];
+    uint16_t length = (uint16_t) payload[6] << 8 | payload[7];
+    while (length != 0) {
+        // copy up to the end of the destination page, so that programming doesn't wrap around.
+        uint16_t chunk = FLASH_PAGE_SIZE - (uint8_t) dst;
+        if (chunk > length) {
+            chunk = length;
+        }
+        flash_wait_ready();
+        sys_spi_select_flash();
+        sys_spi_transmit_single(MEMORY_INSTRUCTION_READ);
+        sys_spi_transmit_single(src >> 16);
+        sys_spi_transmit_single(src >> 8);
+        sys_spi_transmit_single(src);
+        sys_spi_transceive(chunk, flash_page);
+        sys_spi_deselect_flash();
+
+        flash_write_enable();
+        sys_spi_select_flash();
+        sys_spi_transmit_single(FLASH_INSTRUCTION_PAGE_PROGRAM);
+        sys_spi_transmit_single(dst >> 16);
+        sys_spi_transmit_single(dst >> 8);
+        sys_spi_transmit_single(dst);
+        sys_spi_transmit(chunk, flash_page);
+        sys_spi_deselect_flash();
+
+        src += chunk;
+        dst += chunk;
+        length -= chunk;
+    }
+    flash_wait_ready();
+    comm_transmit(PACKET_FLASH_COPY, 0);
+}
+
+static void handle_packet_flash_erase(uint8_t payload_length) {
+    if (payload_length == 0) {
+        return;
+    }
+    flash_wait_ready();
+    flash_write_enable();
+    sys_spi_select_flash();
+    sys_spi_transmit(payload_length, payload);
+    sys_spi_deselect_flash();
+    comm_transmit(PACKET_FLASH_ERASE, 0);
+}
+
+static void handle_packet_index_changed(uint8_t payload_length) {
+    if (payload_length != 1) {
+        return;
+    }
+    const uint8_t slot = payload[0];
+    if (slot == INDEX_CHANGED_ALL) {
+        state.flags |= SYSTEM_FLAG_FLASH_DIRTY;
+    } else if (slot < APP_INDEX_SIZE) {
+        system_update_flash_entry(slot);
+    }
+    comm_transmit(PACKET_INDEX_CHANGED, 0);
+}
+
+static void handle_packet_flash_stream(uint8_t payload_length) {
+    if (payload_length != 6) {
+        return;
+    }
+    uint24_t length = (uint24_t) payload[3] << 16 | (uint16_t) payload[4] << 8 | payload[5];
+    flash_wait_ready();
+    sys_spi_select_flash();
+    sys_spi_transmit_single(MEMORY_INSTRUCTION_READ);
+    sys_spi_transmit(3, payload);
+    // the flash stays selected for the whole transfer. Chunks alternate between the payload and
+    // flash page buffers, so that the next chunk is read while the previous one is transmitted.
+    uint8_t* buffer = payload;
+    while (length != 0) {
+        const uint8_t chunk = length > PAYLOAD_MAX_SIZE ? PAYLOAD_MAX_SIZE : length;
+        sys_spi_transceive(chunk, buffer);
+        comm_transmit_buffer(PACKET_FLASH_STREAM, buffer, chunk);
+        buffer = buffer == payload ? flash_page : payload;
+        length -= chunk;
+    }
+    sys_spi_deselect_flash();
+}
+
+static void handle_packet_crc_range(uint8_t payload_length) {
+    const uint8_t cs = payload[0];
+    if (payload_length != 7 || (cs != SPI_CS_FLASH && cs != SPI_CS_EEPROM)) {
+        return;
+    }
+    uint24_t length = (uint24_t) payload[4] << 16 | (uint16_t) payload[5] << 8 | payload[6];
+    memory_wait_ready(cs);
+    select_memory(cs);
+    sys_spi_transmit_single(MEMORY_INSTRUCTION_READ);
+    if (cs == SPI_CS_FLASH) {
+        sys_spi_transmit(3, &payload[1]);
+    } else {
+        sys_spi_transmit(2, &payload[2]);
+    }
+    uint16_t crc = 0xffff;
+    while (length != 0) {
+        const uint8_t chunk = length > PAYLOAD_MAX_SIZE ? PAYLOAD_MAX_SIZE : length;
+        crc = sys_spi_receive_crc(chunk, payload, crc);
+        length -= chunk;
+    }
+    sys_spi_deselect_all();
+    payload[0] = crc & 0xff;
+    payload[1] = crc >> 8;
+    comm_transmit(PACKET_CRC_RANGE, 2);
+}
+
+static uint16_t compute_baud_calc(uint32_t baud) {
+    // same as SYS_UART_BAUD_RATE but computed at runtime without floating point.
+#ifdef SIMULATION
+    return baud / 100;
+#else
+    return (8 * (uint32_t) F_CPU + baud / 2) / baud;
+#endif
+}
+
+static void set_baud_default(void) {
+    sys_uart_flush();
+    sys_uart_set_baud(SYS_UART_BAUD_RATE(UART_BAUD));
+    baud_changed = false;
+    baud_pending = false;
+}
+
+static void handle_packet_baud(uint8_t payload_length) {
+    const uint32_t baud = (uint32_t) payload[3] << 24 | (uint24_t) payload[2] << 16 |
+                          (uint16_t) payload[1] << 8 | payload[0];
+    // the baud register must be at least 64 and fit on 16 bits.
+    const bool valid = payload_length == 4 && baud >= UART_BAUD &&
+                       compute_baud_calc(baud) >= 64;
+    payload[0] = valid;
+    comm_transmit(PACKET_BAUD, 1);
+    if (valid) {
+        // wait until reply is transmitted before changing baud rate.
+        sys_uart_flush();
+        sys_uart_set_baud(compute_baud_calc(baud));
+        baud_changed = true;
+        baud_pending = true;
+        baud_change_time = time_get();
+    }
+}
+
+static bool baud_confirm_read(uint8_t* c) {
+    while (!sys_uart_available()) {
+        if (time_get() - baud_change_time > millis_to_ticks(BAUD_CONFIRM_TIMEOUT)) {
+            return false;
+        }
+#ifdef SIMULATION
+        sim_uart_listen();
+#endif
+    }
+    *c = sys_uart_read();
+    return true;
+}
+
+static void baud_confirm(void) {
+    // Only an empty VERSION packet received at the new baud rate confirms it.
+    // The header is read with a timeout, since data received at the wrong baud rate
+    // could otherwise make the firmware wait for a payload that never comes.
+    uint8_t header[PACKET_HEADER_SIZE];
+    for (uint8_t i = 0; i < PACKET_HEADER_SIZE; ++i) {
+        if (!baud_confirm_read(&header[i])) {
+            set_baud_default();
+            return;
+        }
+    }
+    if (header[0] == PACKET_SIGNATURE && header[1] == PACKET_VERSION &&
+        header[2] == PACKET_HEADER_SIZE - 1) {
+        baud_pending = false;
+        handle_packet_version();
+    } else {
+        set_baud_default();
+    }
+}
+
 static void handle_packet_lock(void) {
     if (payload[0] == 0xff) {
         locked = true;
@@ -102,6 +466,9 @@ static void handle_packet_lock(void) {
         locked = false;
     }
     comm_transmit(PACKET_LOCK, 0);
+    if (!locked && baud_changed) {
+        set_baud_default();
+    }
 }
 
 static void handle_packet_sleep(void) {
@@ -158,14 +525,92 @@ static void handle_packet_battery_load(void) {
     comm_transmit(PACKET_BATTERY_LOAD, 0);
 }
 
+static uint8_t* write_u16(uint8_t* ptr, uint16_t value) {
+    *ptr++ = value & 0xff;
+    *ptr++ = value >> 8;
+    return ptr;
+}
+
+static void handle_packet_perf_stats(void) {
+    uint8_t* ptr = payload;
+    systime_t time = time_get();
+    systime_t elapsed = time - perf_last_time;
+    perf_last_time = time;
+    ptr = write_u16(ptr, elapsed > UINT16_MAX ? UINT16_MAX : elapsed);
+    for (uint8_t i = 0; i < PERF_FRAME_TIME_BUCKETS; ++i) {
+        ptr = write_u16(ptr, state.frame_time_histogram[i]);
+        state.frame_time_histogram[i] = 0;
+    }
+    ptr = write_u16(ptr, display_take_skipped_frames());
+
+    uint8_t flags = 0;
+#ifdef SOUND_MONITOR
+    ptr = write_u16(ptr, sys_sound_take_isr_count());
+    flags |= 1 << 1;
+#else
+    ptr = write_u16(ptr, 0);
+#endif
+#ifdef LOOP_MONITOR
+    _Static_assert(SYS_LOOP_PHASE_COUNT == PERF_LOOP_PHASE_COUNT, "loop phase count mismatch");
+    uint16_t samples[SYS_LOOP_PHASE_COUNT];
+    sys_time_take_loop_samples(samples);
+    for (uint8_t i = 0; i < SYS_LOOP_PHASE_COUNT; ++i) {
+        ptr = write_u16(ptr, samples[i]);
+    }
+    flags |= 1 << 0;
+#else
+    for (uint8_t i = 0; i < PERF_LOOP_PHASE_COUNT; ++i) {
+        ptr = write_u16(ptr, 0);
+    }
+#endif
+    *ptr++ = flags;
+    ptr = write_u16(ptr, sys_ram_get_stack_high_water());
+    ptr = write_u16(ptr, sys_ram_get_stack_space());
+    comm_transmit(PACKET_PERF_STATS, ptr - payload);
+}
+
+static void handle_packet_event_trace(void) {
+    uint8_t* ptr = payload;
+#ifdef EVENT_TRACE
+    evtrace_entry_t events[EVENT_TRACE_SIZE];
+    uint8_t lost;
+    const uint8_t count = evtrace_take(events, &lost);
+    ptr = write_u16(ptr, time_get());
+    *ptr++ = lost;
+    for (uint8_t i = 0; i < count; ++i) {
+        *ptr++ = events[i].event;
+        *ptr++ = events[i].arg;
+        ptr = write_u16(ptr, events[i].time);
+    }
+#endif
+    comm_transmit(PACKET_EVENT_TRACE, ptr - payload);
+}
+
 static void comm_receive_internal(void) {
+    if (baud_pending) {
+        baud_confirm();
+        return;
+    }
     if (!sys_uart_available()) return;
-    if (sys_uart_read() != PACKET_SIGNATURE) return;
+    if (sys_uart_peek(0) != PACKET_SIGNATURE) {
+        sys_uart_read();
+        return;
+    }
 
+    // Wait until the whole packet is in the RX buffer instead of blocking while it's received,
+    // so that the system app keeps running. A full size packet is one byte larger than the
+    // buffer can hold: it's read once the buffer is full, with its last byte soon to follow.
+    const uint8_t available = sys_uart_available_count();
+    if (available < PACKET_HEADER_SIZE) return;
+    const uint8_t packet_length = sys_uart_peek(2);
+    const uint8_t payload_length = packet_length < PACKET_HEADER_SIZE ? 0 :
+                                   packet_length - PACKET_HEADER_SIZE + 1;
+    if (available < PACKET_HEADER_SIZE + payload_length &&
+        available < SYS_UART_RX_BUFFER_SIZE - 1) return;
+
+    sys_uart_read();
     const packet_type_t type = sys_uart_read();
-    const uint8_t packet_length = sys_uart_read();
-    uint8_t payload_length = packet_length < PACKET_HEADER_SIZE ? 0 :
-                             packet_length - PACKET_HEADER_SIZE + 1;
+    sys_uart_read();
 
     uint8_t count = payload_length;
     uint8_t* ptr = payload;
@@ -181,12 +626,34 @@ static void comm_receive_internal(void) {
         handle_packet_lock();
     } else if (type == PACKET_SLEEP) {
         handle_packet_sleep();
+    } else if (type == PACKET_FLASH_READ) {
+        handle_packet_flash_read(payload_length);
+    } else if (type == PACKET_FLASH_WRITE) {
+        handle_packet_flash_write(payload_length);
+    } else if (type == PACKET_FLASH_ERASE) {
+        handle_packet_flash_erase(payload_length);
+    } else if (type == PACKET_FLASH_STREAM) {
+        handle_packet_flash_stream(payload_length);
+    } else if (type == PACKET_CRC_RANGE) {
+        handle_packet_crc_range(payload_length);
+    } else if (type == PACKET_FLASH_WRITE_LZSS) {
+        handle_packet_flash_write_lzss(payload_length);
+    } else if (type == PACKET_BAUD) {
+        handle_packet_baud(payload_length);
+    } else if (type == PACKET_FLASH_COPY) {
+        handle_packet_flash_copy(payload_length);
+    } else if (type == PACKET_INDEX_CHANGED) {
+        handle_packet_index_changed(payload_length);
     } else if (type == PACKET_BATTERY_INFO) {
         handle_packet_battery_info();
     } else if (type == PACKET_BATTERY_CALIB) {
         handle_packet_battery_calib();
     } else if (type == PACKET_BATTERY_LOAD) {
         handle_packet_battery_load();
+    } else if (type == PACKET_PERF_STATS) {
+        handle_packet_perf_stats();
+    } else if (type == PACKET_EVENT_TRACE) {
+        handle_packet_event_trace();
     }
 }
 
@@ -195,6 +662,8 @@ static systime_t last_time;
 void comm_receive(void) {
     do {
         comm_receive_internal();
+        // the response payload shares memory with the display buffer and with the next packet.
+        sys_uart_wait_buffer();
 
         if (locked) {
             // blink the LED as an indicator that the device is locked.
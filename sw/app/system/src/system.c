@@ -33,7 +33,6 @@
 #include <core/defs.h>
 
 #include <string.h>
-#include <stdlib.h>
 #include <stdio.h>
 #include <inttypes.h>
 
@@ -51,10 +50,22 @@ void callback_setup(void) {
     // mark both memories as dirty to do initial load.
     state.flags = SYSTEM_FLAG_EEPROM_DIRTY | SYSTEM_FLAG_FLASH_DIRTY;
     state.state = STATE_MAIN_MENU;
+
+#ifdef EVENT_TRACE
+    evtrace_start(state.event_trace, EVENT_TRACE_SIZE);
+#endif
 }
 
 void callback_draw(void) {
-    last_draw_time = time_get();
+    systime_t time = time_get();
+    uint8_t bucket = (time - last_draw_time) >> PERF_FRAME_TIME_BUCKET_SHIFT;
+    if (bucket >= PERF_FRAME_TIME_BUCKETS) {
+        bucket = PERF_FRAME_TIME_BUCKETS - 1;
+    }
+    if (state.frame_time_histogram[bucket] != UINT16_MAX) {
+        ++state.frame_time_histogram[bucket];
+    }
+    last_draw_time = time;
     draw();
 }
 
@@ -106,26 +117,70 @@ typedef struct {
     uint16_t size;
 } PACK_STRUCT eeprom_entry_t;
 
-// points the the first element of the current index (for sorting).
-static void* curr_index;
-// indicates the size of each member of the current index array.
-static uint8_t curr_index_sizeof;
-
-static int memory_usage_compare(const void* ap, const void* bp) {
-    uint8_t a_idx = *((const uint8_t*) ap);
-    uint8_t b_idx = *((const uint8_t*) bp);
+// returns the size of an entry in an index, which is the uint24 field after the app ID.
+static uint24_t get_entry_size(const void* index, uint8_t entry_sizeof, uint8_t pos) {
     // zero-initialized since uint24_t is uint32_t in simulator.
-    uint24_t a = 0;
-    uint24_t b = 0;
-    memcpy(&a, (uint8_t*) curr_index + curr_index_sizeof * a_idx + 1, 3);
-    memcpy(&b, (uint8_t*) curr_index + curr_index_sizeof * b_idx + 1, 3);
-    if (a < b) {
-        return 1;
-    } else if (a > b) {
-        return -1;
-    } else {
-        return 0;
+    uint24_t size = 0;
+    memcpy(&size, (const uint8_t*) index + entry_sizeof * pos + 1, 3);
+    return size;
+}
+
+/**
+ * Insert the entry at a position of an index in its usage index, which is sorted by decreasing
+ * size, after the entries of the same size. Positions at or after it in the usage index are
+ * shifted, the entry must have already been inserted in the index.
+ */
+static void usage_insert(mem_usage_t* usage, const void* index, uint8_t entry_sizeof,
+                         uint8_t pos) {
+    uint8_t* usage_index = usage->index;
+    for (uint8_t i = 0; i < usage->size; ++i) {
+        if (usage_index[i] >= pos) {
+            ++usage_index[i];
+        }
     }
+    const uint24_t size = get_entry_size(index, entry_sizeof, pos);
+    uint8_t i = usage->size;
+    while (i > 0 && get_entry_size(index, entry_sizeof, usage_index[i - 1]) < size) {
+        usage_index[i] = usage_index[i - 1];
+        --i;
+    }
+    usage_index[i] = pos;
+    ++usage->size;
+}
+
+/**
+ * Remove the entry at a position of an index from its usage index.
+ * Positions after it in the usage index are shifted back.
+ */
+static void usage_remove(mem_usage_t* usage, uint8_t pos) {
+    uint8_t* usage_index = usage->index;
+    uint8_t j = 0;
+    for (uint8_t i = 0; i < usage->size; ++i) {
+        const uint8_t p = usage_index[i];
+        if (p != pos) {
+            usage_index[j++] = p > pos ? p - 1 : p;
+        }
+    }
+    usage->size = j;
+}
+
+// read an entry from the flash index, returns false if the entry is empty.
+static bool read_flash_entry(uint8_t i, app_flash_t* app) {
+    flash_entry_t entry;
+    sys_flash_read_absolute(SYS_FLASH_INDEX_ADDR + i * SYS_FLASH_INDEX_ENTRY_SIZE,
+                            sizeof(entry), &entry);
+    if (entry.id == APP_ID_NONE) {
+        return false;
+    }
+    app->id = entry.id;
+    app->app_version = entry.app_version;
+    app->boot_version = entry.boot_version;
+    app->app_size = entry.app_size;
+    app->code_size = entry.code_size;
+    app->eeprom_size = entry.eeprom_size;
+    app->build_date = entry.build_date;
+    app->index = i;
+    return true;
 }
 
 void system_load_flash_index(void) {
@@ -134,50 +189,56 @@ void system_load_flash_index(void) {
     }
     state.flags &= ~SYSTEM_FLAG_FLASH_DIRTY;
 
+    state.flash_usage.size = 0;
+    state.flash_usage.total = 0;
+
     // check signature
     uint16_t signature;
     sys_flash_read_absolute(0, sizeof signature, &signature);
     if (signature != SYS_FLASH_SIGNATURE) {
         // flash wasn't initialized yet, no apps.
-        state.flash_usage.size = 0;
-        state.flash_usage.total = 0;
         return;
     }
 
-    // read index from flash
-    uint16_t address = SYS_FLASH_INDEX_ADDR;
+    // read index from flash, entries are sorted by size in the usage index as they are added.
     app_flash_t* index = state.flash_index;
-    flash_entry_t entry;
-    uint8_t size = 0;
     state.flash_usage.total = SYS_FLASH_DATA_START_ADDR;
     for (uint8_t i = 0; i < APP_INDEX_SIZE; ++i) {
-        // read flash entry
-        sys_flash_read_absolute(address, sizeof(entry), &entry);
-        if (entry.id != APP_ID_NONE) {
-            index->id = entry.id;
-            index->app_version = entry.app_version;
-            index->boot_version = entry.boot_version;
-            index->app_version = entry.app_version;
-            index->boot_version = entry.boot_version;
-            index->app_size = entry.app_size;
-            index->code_size = entry.code_size;
-            index->eeprom_size = entry.eeprom_size;
-            index->build_date = entry.build_date;
-            index->index = i;
-            ++index;
-
-            state.flash_usage.total += entry.app_size;
-            state.flash_usage.index[size] = size;
-            ++size;
+        const uint8_t pos = state.flash_usage.size;
+        if (read_flash_entry(i, &index[pos])) {
+            state.flash_usage.total += index[pos].app_size;
+            usage_insert(&state.flash_usage, index, sizeof *index, pos);
         }
-        address += SYS_FLASH_INDEX_ENTRY_SIZE;
     }
-    state.flash_usage.size = size;
 
-    // sort entries by size in the usage index (qsort has an outrageous code size but whatever)
-    curr_index = state.flash_index;
-    curr_index_sizeof = sizeof(state.flash_index) / APP_INDEX_SIZE;
-    qsort(state.flash_usage.index, size, sizeof(uint8_t), memory_usage_compare);
+    system_init_position();
+}
+
+void system_update_flash_entry(uint8_t slot) {
+    app_flash_t* index = state.flash_index;
+    mem_usage_t* usage = &state.flash_usage;
+
+    // find the position of the entry in the index, which is sorted by slot.
+    uint8_t pos = 0;
+    while (pos < usage->size && index[pos].index < slot) {
+        ++pos;
+    }
+
+    // remove the previous entry, if any.
+    if (pos < usage->size && index[pos].index == slot) {
+        usage->total -= index[pos].app_size;
+        usage_remove(usage, pos);
+        memmove(&index[pos], &index[pos + 1], (usage->size - pos) * sizeof *index);
+    }
+
+    // insert the new entry, if any.
+    app_flash_t app;
+    if (read_flash_entry(slot, &app)) {
+        memmove(&index[pos + 1], &index[pos], (usage->size - pos) * sizeof *index);
+        index[pos] = app;
+        usage->total += app.app_size;
+        usage_insert(usage, index, sizeof *index, pos);
+    }
 
     system_init_position();
 }
@@ -188,13 +249,14 @@ void system_load_eeprom_index(void) {
     }
     state.flags &= ~SYSTEM_FLAG_EEPROM_DIRTY;
 
+    state.eeprom_usage.size = 0;
+    state.eeprom_usage.total = 0;
+
     // check signature
     uint16_t signature;
     sys_eeprom_read_absolute(0, sizeof signature, &signature);
     if (signature != SYS_EEPROM_SIGNATURE) {
         // EEPROM wasn't initialized yet, no apps.
-        state.eeprom_usage.size = 0;
-        state.eeprom_usage.total = 0;
         return;
     }
 
@@ -202,28 +264,19 @@ void system_load_eeprom_index(void) {
     uint8_t address = SYS_EEPROM_INDEX_ADDR;
     app_eeprom_t* index = state.eeprom_index;
     eeprom_entry_t entry;
-    uint8_t size = 0;
     state.eeprom_usage.total = SYS_EEPROM_DATA_START_ADDR;
     for (uint8_t i = 0; i < APP_INDEX_SIZE; ++i) {
         // read flash entry
         sys_eeprom_read_absolute(address, sizeof(entry), &entry);
         if (entry.id != APP_ID_NONE) {
-            index->id = entry.id;
-            index->size = entry.size;
-            ++index;
-
+            const uint8_t pos = state.eeprom_usage.size;
+            index[pos].id = entry.id;
+            index[pos].size = entry.size;
             state.eeprom_usage.total += entry.size;
-            state.eeprom_usage.index[size] = size;
-            ++size;
+            usage_insert(&state.eeprom_usage, index, sizeof *index, pos);
         }
         address += SYS_EEPROM_INDEX_ENTRY_SIZE;
     }
-    state.eeprom_usage.size = size;
-
-    // sort entries by size in the usage index
-    curr_index = state.eeprom_index;
-    curr_index_sizeof = sizeof(state.eeprom_index) / APP_INDEX_SIZE;
-    qsort(state.eeprom_usage.index, size, sizeof(uint8_t), memory_usage_compare);
 
     system_init_position();
 }
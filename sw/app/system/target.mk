@@ -4,10 +4,14 @@
 DEFINES += SYS_UART_ENABLE UART_BAUD=250000 SYS_UART_RX_BUFFER_SIZE=256
 
 # gcprog version compatibility
-DEFINES += VERSION_PROG_COMP=3
+DEFINES += VERSION_PROG_COMP=4
 
 # use absolute memory access in simulation
 DEFINES += SIM_MEMORY_ABSOLUTE
 
+# record timing-sensitive events for the gcprog trace command (see core/evtrace.h).
+# the bootloader must be built with EVENT_TRACE too.
+#DEFINES += EVENT_TRACE
+
 # dialog setup
 DEFINES += DIALOG_MAX_ITEMS=5 DIALOG_NO_CHOICE DIALOG_NO_NUMBER DIALOG_NO_TEXT
@@ -32,7 +32,7 @@
 
 // Buttons for which delayed auto-shift is enabled.
 #define DAS_MASK         (BUTTON1 | BUTTON3 | BUTTON5)
-// Disallowed DAS mask (if all bits in mask are set, all DAS are disabled)
+// Disallowed DAS mask (if all buttons in mask are held, DAS is disabled)
 #define DAS_DISALLOWED (BUTTON_LEFT | BUTTON_RIGHT)
 
 // If a single button is pressed, wait for this delay in game ticks for a
@@ -18,6 +18,15 @@
 #ifndef TETRIS_RENDER_H
 #define TETRIS_RENDER_H
 
+#include <stdbool.h>
+
+/**
+ * Set the rows to refresh on the next frame, if only part of the game screen changed.
+ * Returns false if nothing changed since the last frame, in which case it needn't be drawn.
+ * This must be called once before each frame.
+ */
+bool set_game_dirty_rows(void);
+
 void draw(void);
 
 #endif //TETRIS_RENDER_H
@@ -24,6 +24,7 @@
 
 #define GRID_WIDTH 10
 #define GRID_HEIGHT 22
+#define GRID_ROW_FULL ((uint16_t) ((1 << GRID_WIDTH) - 1))
 
 #define PIECES_COUNT 7
 #define BLOCKS_PER_PIECE 4
@@ -86,6 +87,15 @@ typedef enum {
 typedef struct {
     tetris_options_t options;
     tetris_piece grid[GRID_WIDTH][GRID_HEIGHT];
+    // Occupancy of each grid row by locked blocks (bit N for column N). This excludes
+    // the current piece and the ghost piece, which only appear in the grid.
+    uint16_t rows[GRID_HEIGHT];
+    // Height of the locked blocks in each grid column (row above the highest block).
+    uint8_t heights[GRID_WIDTH];
+    // Ghost piece blocks, as indices in the grid data (x * GRID_HEIGHT + y).
+    uint8_t ghost_blocks[BLOCKS_PER_PIECE];
+    // Bit field of grid rows in which a block changed since the renderer last cleared it.
+    uint32_t changed_rows;
 
     uint8_t flags;
 
@@ -117,6 +127,23 @@ typedef struct {
 
 extern tetris_t tetris;
 
+#ifdef TETRIS_PROFILE
+/**
+ * Number of calls and total time in nanoseconds spent in some engine functions.
+ * Only available on host builds with `TETRIS_PROFILE` defined, used for benchmarking.
+ */
+typedef struct {
+    uint64_t can_place_piece_calls;
+    uint64_t can_place_piece_time;
+    uint64_t detect_tspin_calls;
+    uint64_t detect_tspin_time;
+    uint64_t update_score_calls;
+    uint64_t update_score_time;
+} tetris_profile_t;
+
+extern tetris_profile_t tetris_profile;
+#endif //TETRIS_PROFILE
+
 /** Initialize the tetris state and start the game. */
 void tetris_init(void);
 
@@ -61,14 +61,13 @@ void callback_setup(void) {
 }
 
 bool callback_loop(void) {
-    // wait until at least one game tick has passed since last loop
+    // wait until at least one game tick has passed since last loop, the CPU idles in between.
     // if display was refreshed, dt will be greater than 1, otherwise it will probably be 1.
-    systime_t time;
-    uint8_t dt;
-    do {
-        time = time_get();
-        dt = (time - last_tick_time) / GAME_TICK;
-    } while (dt == 0);
+    const systime_t time = time_get();
+    uint8_t dt = (time - last_tick_time) / GAME_TICK;
+    if (dt == 0) {
+        return false;
+    }
     if (dt > MAX_DELTA_TIME) {
         dt = MAX_DELTA_TIME;
     }
@@ -82,7 +81,11 @@ bool callback_loop(void) {
     game_music_update_tempo();
     game.state = game_state_update(dt);
 
-    return (systime_t) (time - last_draw_time) > millis_to_ticks(1000.0 / DISPLAY_MAX_FPS);
+    if ((systime_t) (time - last_draw_time) > millis_to_ticks(1000.0 / DISPLAY_MAX_FPS)) {
+        // only draw if something changed since last frame.
+        return set_game_dirty_rows();
+    }
+    return false;
 }
 
 void callback_draw(void) {
@@ -24,23 +24,16 @@
 #include <core/app.h>
 #include <core/dialog.h>
 
-// mask indicating buttons which should be considered not pressed until released.
-static uint8_t input_wait_released;
-// indicates pressed buttons for which click event has been processed.
-static uint8_t click_processed;
-// time since buttons was pressed, in game ticks.
-static uint8_t button_hold_time[BUTTONS_COUNT];
-// mask indicating for which buttons DAS is currently enabled.
-static uint8_t delayed_auto_shift;
-
-static uint8_t preprocess_input_state() {
-    uint8_t state = input_get_state();
-    // if any button was released, update wait mask.
-    input_wait_released &= state;
-    // consider any buttons on wait mask as not pressed.
-    state &= ~input_wait_released;
-    return state;
-}
+static const uint8_t KEY_COMBOS[] = {BUTTON_HARD_DROP, BUTTON_PAUSE};
+
+static const input_keys_config_t KEYS_CONFIG = {
+        .repeat_mask = DAS_MASK,
+        .repeat_delay = DAS_DELAY * GAME_TICK,
+        .repeat_rate = AUTO_REPEAT_RATE * GAME_TICK,
+        .combo_delay = BUTTON_COMBINATION_DELAY * GAME_TICK,
+        .combo_count = sizeof KEY_COMBOS,
+        .combos = KEY_COMBOS,
+};
 
 game_state_t game_handle_input_dialog(void) {
     dialog_result_t res = dialog_handle_input();
@@ -130,102 +123,37 @@ game_state_t game_handle_input_dialog(void) {
 }
 
 game_state_t game_handle_input_tetris(void) {
-    uint8_t curr_state = preprocess_input_state();
-
-    // update buttons hold time
-    // use hold time to determine which buttons were recently clicked.
-    uint8_t mask = BUTTON0;
-    uint8_t clicked = 0;        // clicked buttons (pressed and click wasn't processed)
-    uint8_t das_triggered = 0;  // DAS triggered on this frame
-    uint8_t pressed_count = 0;  // number of pressed buttons
-    uint8_t last_hold_time = 0;
-    for (uint8_t i = 0; i < BUTTONS_COUNT; ++i) {
-        uint8_t hold_time = button_hold_time[i];
-        if (curr_state & mask) {
-            // button pressed or held
-            if (hold_time != UINT8_MAX) {
-                ++hold_time;
-
-                // delayed auto shift: enable if button is pressed long enough, then
-                // holding button will result in a repeated click at a fixed interval.
-                if (delayed_auto_shift & mask) {
-                    // DAS enabled for that button, trigger it if auto repeat delay passed.
-                    if (hold_time >= DAS_DELAY + AUTO_REPEAT_RATE) {
-                        hold_time = DAS_DELAY;
-                        das_triggered |= mask;
-                    }
-                } else if (hold_time >= DAS_DELAY && (DAS_MASK & mask)) {
-                    delayed_auto_shift |= mask;
-                    if ((delayed_auto_shift & DAS_DISALLOWED) == DAS_DISALLOWED) {
-                        // disallowed combination of active DAS, disable them all.
-                        delayed_auto_shift = 0;
-                    } else {
-                        das_triggered |= mask;
-                        hold_time = DAS_DELAY;
-                    }
-                } else if (!(click_processed & mask)) {
-                    // button is pressed and click wasn't processed yet: trigger a click.
-                    last_hold_time = hold_time;
-                    clicked |= mask;
-                }
-            }
-            ++pressed_count;
-        } else {
-            // button released
-            hold_time = 0;
-            click_processed &= ~mask;
-            delayed_auto_shift &= ~mask;
-        }
-        button_hold_time[i] = hold_time;
-        mask <<= 1;
-    }
-
-    if (!das_triggered && pressed_count == 1 && last_hold_time <= BUTTON_COMBINATION_DELAY) {
-        // Single button pressed, wait minimum time for other button to be pressed and
-        // create a two buttons combination. After that delay, treat as single button click.
-        return GAME_STATE_PLAY;
-    }
-
-    uint8_t clicked_or_das = clicked | das_triggered;
-    if (clicked_or_das) {
-        // process the click action
-        if ((clicked & BUTTON_PAUSE) == BUTTON_PAUSE) {
-            click_processed |= BUTTON_PAUSE;
+    uint8_t key;
+    while ((key = input_get_key()) != 0) {
+        const uint8_t buttons = key & ~INPUT_KEY_REPEAT;
+        if (buttons == BUTTON_PAUSE) {
             return GAME_STATE_PAUSE;
 
-        } else if ((clicked & BUTTON_HARD_DROP) == BUTTON_HARD_DROP) {
+        } else if (buttons == BUTTON_HARD_DROP) {
             tetris_hard_drop();
-            click_processed |= BUTTON_HARD_DROP;
-
-        } else if ((clicked_or_das & BUTTON_LEFT) == BUTTON_LEFT) {
-            // if DAS is enabled for right button, don't move left, it looks weird.
-            if (!(delayed_auto_shift & BUTTON_RIGHT)) {
-                tetris_move_left();
-            }
-            click_processed |= BUTTON_LEFT;
-
-        } else if ((clicked_or_das & BUTTON_RIGHT) == BUTTON_RIGHT) {
-            // if DAS is enabled for left button, don't move right, it looks weird.
-            if (!(delayed_auto_shift & BUTTON_LEFT)) {
-                tetris_move_right();
-            }
-            click_processed |= BUTTON_RIGHT;
-
-        } else if ((clicked_or_das & BUTTON_DOWN) == BUTTON_DOWN) {
+
+        } else if ((key & INPUT_KEY_REPEAT) &&
+                   (input_get_state() & DAS_DISALLOWED) == DAS_DISALLOWED) {
+            // left and right are both held, don't auto shift in any direction, it looks weird.
+            continue;
+
+        } else if (buttons == BUTTON_LEFT) {
+            tetris_move_left();
+
+        } else if (buttons == BUTTON_RIGHT) {
+            tetris_move_right();
+
+        } else if (buttons == BUTTON_DOWN) {
             tetris_move_down();
-            click_processed |= BUTTON_DOWN;
 
-        } else if ((clicked & BUTTON_ROT_CW) == BUTTON_ROT_CW) {
+        } else if (buttons == BUTTON_ROT_CW) {
             tetris_rotate_piece(TETRIS_DIR_CW);
-            click_processed |= BUTTON_ROT_CW;
 
-        } else if ((clicked & BUTTON_ROT_CCW) == BUTTON_ROT_CCW) {
+        } else if (buttons == BUTTON_ROT_CCW) {
             tetris_rotate_piece(TETRIS_DIR_CCW);
-            click_processed |= BUTTON_ROT_CCW;
 
-        } else if ((clicked & BUTTON_HOLD) == BUTTON_HOLD) {
+        } else if (buttons == BUTTON_HOLD) {
             tetris_hold_or_swap_piece();
-            click_processed |= BUTTON_HOLD;
         }
     }
 
@@ -233,5 +161,5 @@ game_state_t game_handle_input_tetris(void) {
 }
 
 void game_ignore_current_input(void) {
-    input_wait_released = input_get_state();
+    input_keys_init(&KEYS_CONFIG);
 }
@@ -27,10 +27,15 @@ static sound_t loop_music;
 static uint8_t music_start_delay;
 
 // Encoded tempo value for each level, this corresponds to 60 BPM for first level and
-// 120 BPM for last level, with 3 BPM increase by level, as much as encoding allows.
-static const uint8_t LEVEL_TEMPO[] = {
-        16, 15, 15, 14, 13, 13, 12, 12, 11, 11,
-        11, 10, 10, 10, 9, 9, 9, 9, 8, 8, 8,
+// 120 BPM for last level, with 3 BPM increase by level.
+static const uint16_t LEVEL_TEMPO[] = {
+        encode_bpm_tempo_fine(60), encode_bpm_tempo_fine(63), encode_bpm_tempo_fine(66),
+        encode_bpm_tempo_fine(69), encode_bpm_tempo_fine(72), encode_bpm_tempo_fine(75),
+        encode_bpm_tempo_fine(78), encode_bpm_tempo_fine(81), encode_bpm_tempo_fine(84),
+        encode_bpm_tempo_fine(87), encode_bpm_tempo_fine(90), encode_bpm_tempo_fine(93),
+        encode_bpm_tempo_fine(96), encode_bpm_tempo_fine(99), encode_bpm_tempo_fine(102),
+        encode_bpm_tempo_fine(105), encode_bpm_tempo_fine(108), encode_bpm_tempo_fine(111),
+        encode_bpm_tempo_fine(114), encode_bpm_tempo_fine(117), encode_bpm_tempo_fine(120),
 };
 
 void game_music_start(sound_t music, uint8_t flags) {
@@ -84,11 +89,11 @@ void game_music_update(uint8_t dt) {
 }
 
 void game_music_update_tempo(void) {
-    uint8_t tempo;
+    uint16_t tempo;
     if (game.state == GAME_STATE_PLAY) {
         tempo = LEVEL_TEMPO[tetris.level > 20 ? 20 : tetris.level];
     } else {
-        tempo = encode_bpm_tempo(ASSET_SOUND_TEMPO);
+        tempo = encode_bpm_tempo_fine(ASSET_SOUND_TEMPO);
     }
-    sound_set_tempo(tempo);
+    sound_set_tempo_fine(tempo);
 }
@@ -24,8 +24,11 @@
 #include <core/graphics.h>
 #include <core/sysui.h>
 #include <core/dialog.h>
+#include <core/display.h>
+#include <core/math.h>
 
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 
 #define STR1(x) #x
@@ -36,6 +39,29 @@
 
 #define CONTROLS_COUNT 8
 
+// Last row covered by the score text.
+#define SCORE_BOTTOM 8
+
+// Game info drawn next to the grid, other than the score.
+typedef struct {
+    uint24_t last_points;
+    uint16_t lines;
+    uint16_t level;
+    uint8_t combo_count;
+    uint8_t last_lines_cleared;
+    uint8_t last_perfect;
+    uint8_t last_tspin;
+    uint8_t bag_pos;
+    uint8_t hold_piece;
+} PACK_STRUCT game_info_t;
+
+// Game state on the last frame, used to only refresh the grid rows that changed.
+static struct {
+    bool valid;
+    uint32_t score;
+    game_info_t info;
+} last_game_frame;
+
 // outer color (low nibble), inner color (high nibble), tile I to Z
 static const disp_color_t TILE_COLORS[PIECES_COUNT] = {
         0x1f,  // I
@@ -159,7 +185,7 @@ static void format_points(char buf[9], uint32_t pts, char pad) {
         // can't fit in 8 digits, use exponent
         uint8_t exponent = 0;
         while (pts >= 1000000) {
-            pts /= 10;
+            pts = math_div10_u32(pts);
             ++exponent;
         }
         ptr -= 2;
@@ -168,8 +194,9 @@ static void format_points(char buf[9], uint32_t pts, char pad) {
     }
     // format number (or mantissa)
     do {
-        *(--ptr) = (char) (pts % 10 + '0');
-        pts /= 10;
+        const uint32_t q = math_div10_u32(pts);
+        *(--ptr) = (char) (pts - q * 10 + '0');
+        pts = q;
     } while (pts);
     // pad
     while (ptr != buf) {
@@ -339,6 +366,75 @@ static void draw_main_menu(void) {
     graphics_image_4bit_mixed(ASSET_IMAGE_MENU, 0, 0);
 }
 
+static void get_game_info(game_info_t* info) {
+    info->last_points = tetris.last_points;
+    info->lines = tetris.lines;
+    info->level = tetris.level;
+    info->combo_count = tetris.combo_count;
+    info->last_lines_cleared = tetris.last_lines_cleared;
+    info->last_perfect = (tetris.flags & TETRIS_FLAG_LAST_PERFECT) != 0;
+    info->last_tspin = tetris.last_tspin;
+    info->bag_pos = tetris.bag_pos;
+    info->hold_piece = tetris.hold_piece;
+}
+
+bool set_game_dirty_rows(void) {
+    if (game.dialog_shown && game.state >= GAME_STATE_OPTIONS_PLAY) {
+        // the game is paused behind the dialog, it's drawn once and then only the dialog
+        // is refreshed when it changes.
+        last_game_frame.valid = false;
+        return dialog_set_dirty_rows();
+    }
+
+    game_info_t info;
+    get_game_info(&info);
+
+    // Only the game screen can be partially refreshed, when no dialog is shown over it.
+    // Everything next to the grid must also be the same as on the last frame, except the score.
+    const bool can_refresh_partially = game.state == GAME_STATE_PLAY && !game.dialog_shown;
+    const bool last_valid = last_game_frame.valid;
+    const bool info_changed = memcmp(&info, &last_game_frame.info, sizeof info) != 0;
+    const bool score_changed = tetris.score != last_game_frame.score;
+    last_game_frame.valid = can_refresh_partially;
+    last_game_frame.info = info;
+    last_game_frame.score = tetris.score;
+    const uint32_t changed_rows = tetris.changed_rows;
+    tetris.changed_rows = 0;
+    if (!can_refresh_partially || !last_valid || info_changed) {
+        return true;
+    }
+
+    // Find the range of display rows covering the grid rows that changed.
+    // Grid rows are drawn from the bottom of the display, the top row is only partly shown.
+    disp_y_t ystart_dirty = DISPLAY_HEIGHT;
+    disp_y_t yend_dirty = 0;
+    int8_t y = DISPLAY_HEIGHT - TILE_HEIGHT;
+    for (uint8_t i = 0; i < GRID_HEIGHT; ++i) {
+        if (changed_rows & ((uint32_t) 1 << i)) {
+            if (yend_dirty == 0) {
+                yend_dirty = y + TILE_HEIGHT - 1;
+            }
+            ystart_dirty = y < 0 ? 0 : y;
+        }
+        y = (int8_t) (y - TILE_HEIGHT);
+    }
+
+    if (score_changed) {
+        // score is shown at the top of the screen.
+        ystart_dirty = 0;
+        if (yend_dirty < SCORE_BOTTOM) {
+            yend_dirty = SCORE_BOTTOM;
+        }
+    }
+
+    if (ystart_dirty == DISPLAY_HEIGHT) {
+        // nothing changed on the display.
+        return false;
+    }
+    display_set_dirty_rows(ystart_dirty, yend_dirty);
+    return true;
+}
+
 void draw(void) {
     graphics_clear(DISPLAY_COLOR_BLACK);
 
@@ -22,7 +22,9 @@
 #include <music.h>
 
 #include <core/eeprom.h>
+#include <core/fast_settings.h>
 #include <core/dialog.h>
+#include <core/scratch.h>
 
 #include <string.h>
 
@@ -46,28 +48,54 @@ static void set_default_options(void) {
 #define EEPROM_SAVE_SIZE (1 + sizeof game.options + sizeof tetris.options + sizeof game.leaderboard)
 #define EEPROM_GUARD_BYTE 0x55
 
-static SHARED_DISP_BUF uint8_t save_buf[EEPROM_SAVE_SIZE];
+// options are also kept in fast settings, so that changing them doesn't rewrite the leaderboard.
+#define FAST_SETTINGS_SAVE_SIZE (1 + sizeof game.options + sizeof tetris.options)
+#define FAST_SETTINGS_GUARD_BYTE 0x54
+
+static void load_fast_settings(void) {
+    uint8_t buf[FAST_SETTINGS_SAVE_SIZE];
+    fast_settings_read(0, sizeof buf, buf);
+    if (buf[0] != FAST_SETTINGS_GUARD_BYTE) {
+        // options were never saved to fast settings, keep those from EEPROM.
+        return;
+    }
+    memcpy(&game.options, &buf[1], sizeof game.options);
+    memcpy(&tetris.options, &buf[1 + sizeof game.options], sizeof tetris.options);
+}
+
+static void save_fast_settings(void) {
+    uint8_t buf[FAST_SETTINGS_SAVE_SIZE];
+    buf[0] = FAST_SETTINGS_GUARD_BYTE;
+    memcpy(&buf[1], &game.options, sizeof game.options);
+    memcpy(&buf[1 + sizeof game.options], &tetris.options, sizeof tetris.options);
+    fast_settings_write(0, sizeof buf, buf);
+}
 
 void load_from_eeprom(void) {
+    uint8_t* save_buf = scratch_acquire(EEPROM_SAVE_SIZE);
     eeprom_read(0, EEPROM_SAVE_SIZE, save_buf);
     uint8_t* buf = save_buf;
 
     // if first launch, guard byte isn't be set: set defaults, eeprom was never saved.
     if (*buf++ != EEPROM_GUARD_BYTE) {
+        scratch_release();
         set_default_options();
-        return;
+    } else {
+        memcpy(&game.options, buf, sizeof game.options);
+        buf += sizeof game.options;
+        memcpy(&tetris.options, buf, sizeof tetris.options);
+        buf += sizeof tetris.options;
+
+        memcpy(&game.leaderboard, buf, sizeof game.leaderboard);
+        //buf += sizeof game.leaderboard;
+        scratch_release();
     }
 
-    memcpy(&game.options, buf, sizeof game.options);
-    buf += sizeof game.options;
-    memcpy(&tetris.options, buf, sizeof tetris.options);
-    buf += sizeof tetris.options;
-
-    memcpy(&game.leaderboard, buf, sizeof game.leaderboard);
-    //buf += sizeof game.leaderboard;
+    load_fast_settings();
 }
 
 void save_to_eeprom(void) {
+    uint8_t* save_buf = scratch_acquire(EEPROM_SAVE_SIZE);
     uint8_t* buf = save_buf;
     *buf++ = EEPROM_GUARD_BYTE;
 
@@ -81,7 +109,8 @@ void save_to_eeprom(void) {
     memcpy(buf, &game.leaderboard, sizeof game.leaderboard);
     //buf += sizeof game.leaderboard;
 
-    eeprom_write(0, EEPROM_SAVE_SIZE, save_buf);
+    eeprom_write_changed(0, EEPROM_SAVE_SIZE, save_buf);
+    scratch_release();
 
 #ifdef SIMULATION
     sim_eeprom_save();
@@ -121,7 +150,7 @@ void save_dialog_options(void) {
 
     // contrast, volume and music enabled were already changed during preview
 
-    save_to_eeprom();
+    save_fast_settings();
 }
 
 void save_dialog_extra_options(void) {
@@ -143,7 +172,7 @@ void save_dialog_extra_options(void) {
     }
     tetris.options.features = features;
 
-    save_to_eeprom();
+    save_fast_settings();
 }
 
 void update_display_contrast(uint8_t value) {
@@ -22,6 +22,10 @@
 
 #include <string.h>
 
+#ifdef TETRIS_PROFILE
+#include <time.h>
+#endif
+
 #define MAX_WALL_KICKS 5
 #define LAST_ROT_NONE 0xff
 
@@ -86,39 +90,73 @@ const uint8_t TETRIS_PIECES_DATA[PIECES_COUNT * ROTATIONS_COUNT * BLOCKS_PER_PIE
         0x23, 0x12, 0x22, 0x11,
 };
 
-// offset data for rotation and wall kicking
-// each group of 4 bytes encodes offset data for a single offset from all rotations
-// (O, R, 2, L in order). there are MAX_WALL_KICKS groups, except for the O piece
-// which has only one offset since it is guaranteed to succeed.
-// each byte encodes the signed (X, Y) offset in its two nibbles (X=0xf0, Y=0x0f),
-// with each coordinate offset by +8 to allow for negative numbers.
-// note that the offset doesn't matter since the offsets are always taken as a diffential pair.
+// occupancy mask of each row of the 5x5 grid for each piece and rotation (bit N for X=N),
+// from bottom row to top row. this is the same data as TETRIS_PIECES_DATA, in a form that
+// can be tested against the grid row masks directly.
+static const uint8_t PIECES_ROW_MASKS[PIECES_COUNT * ROTATIONS_COUNT * PIECE_GRID_SIZE] = {
+        0x00, 0x00, 0x1e, 0x00, 0x00,
+        0x04, 0x04, 0x04, 0x04, 0x00,
+        0x00, 0x00, 0x0f, 0x00, 0x00,
+        0x00, 0x04, 0x04, 0x04, 0x04,
+        0x00, 0x00, 0x0e, 0x02, 0x00,
+        0x00, 0x04, 0x04, 0x0c, 0x00,
+        0x00, 0x08, 0x0e, 0x00, 0x00,
+        0x00, 0x06, 0x04, 0x04, 0x00,
+        0x00, 0x00, 0x0e, 0x08, 0x00,
+        0x00, 0x0c, 0x04, 0x04, 0x00,
+        0x00, 0x02, 0x0e, 0x00, 0x00,
+        0x00, 0x04, 0x04, 0x06, 0x00,
+        0x00, 0x00, 0x0c, 0x0c, 0x00,
+        0x00, 0x0c, 0x0c, 0x00, 0x00,
+        0x00, 0x06, 0x06, 0x00, 0x00,
+        0x00, 0x00, 0x06, 0x06, 0x00,
+        0x00, 0x00, 0x06, 0x0c, 0x00,
+        0x00, 0x08, 0x0c, 0x04, 0x00,
+        0x00, 0x06, 0x0c, 0x00, 0x00,
+        0x00, 0x04, 0x06, 0x02, 0x00,
+        0x00, 0x00, 0x0e, 0x04, 0x00,
+        0x00, 0x04, 0x0c, 0x04, 0x00,
+        0x00, 0x04, 0x0e, 0x00, 0x00,
+        0x00, 0x04, 0x06, 0x04, 0x00,
+        0x00, 0x00, 0x0c, 0x06, 0x00,
+        0x00, 0x04, 0x0c, 0x08, 0x00,
+        0x00, 0x0c, 0x06, 0x00, 0x00,
+        0x00, 0x02, 0x06, 0x04, 0x00,
+};
+
+// wall kick offsets for rotation, precomputed from the SRS offset data.
 // see [https://tetris.wiki/Super_Rotation_System#How_Guideline_SRS_Really_Works]
-static const uint8_t OFFSET_DATA_JLSTZ[MAX_WALL_KICKS * ROTATIONS_COUNT] = {
-        0x88, 0x88, 0x88, 0x88,
-        0x88, 0x98, 0x88, 0x78,
-        0x88, 0x97, 0x88, 0x77,
-        0x88, 0x8a, 0x88, 0x8a,
-        0x88, 0x9a, 0x88, 0x7a,
+// each group of 8 bytes encodes a single kick for all rotations and directions
+// (O, R, 2, L in order, each with CW then CCW). there are MAX_WALL_KICKS groups, except for
+// the O piece which has only one kick since it is guaranteed to succeed.
+// each byte encodes the signed (X, Y) offset to apply to the piece in its two nibbles
+// (X=0xf0, Y=0x0f), with each coordinate offset by +8 to allow for negative numbers.
+#define KICKS_PER_GROUP (ROTATIONS_COUNT * 2)
+static const uint8_t KICK_DATA_JLSTZ[MAX_WALL_KICKS * KICKS_PER_GROUP] = {
+        0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88,
+        0x78, 0x98, 0x98, 0x98, 0x98, 0x78, 0x78, 0x78,
+        0x79, 0x99, 0x97, 0x97, 0x99, 0x79, 0x77, 0x77,
+        0x86, 0x86, 0x8a, 0x8a, 0x86, 0x86, 0x8a, 0x8a,
+        0x76, 0x96, 0x9a, 0x9a, 0x96, 0x76, 0x7a, 0x7a,
 };
-static const uint8_t OFFSET_DATA_I[MAX_WALL_KICKS * ROTATIONS_COUNT] = {
-        0x88, 0x78, 0x79, 0x89,
-        0x78, 0x88, 0x99, 0x89,
-        0xa8, 0x88, 0x69, 0x89,
-        0x78, 0x89, 0x98, 0x87,
-        0xa8, 0x86, 0x68, 0x8a,
+static const uint8_t KICK_DATA_I[MAX_WALL_KICKS * KICKS_PER_GROUP] = {
+        0x98, 0x87, 0x87, 0x78, 0x78, 0x89, 0x89, 0x98,
+        0x78, 0x77, 0x77, 0x98, 0x98, 0x99, 0x99, 0x78,
+        0xa8, 0xa7, 0xa7, 0x68, 0x68, 0x69, 0x69, 0xa8,
+        0x77, 0x79, 0x79, 0x99, 0x99, 0x97, 0x97, 0x77,
+        0xaa, 0xa6, 0xa6, 0x66, 0x66, 0x6a, 0x6a, 0xaa,
 };
-static const uint8_t OFFSET_DATA_O[ROTATIONS_COUNT] = {
-        0x88, 0x87, 0x77, 0x78,
+static const uint8_t KICK_DATA_O[KICKS_PER_GROUP] = {
+        0x89, 0x98, 0x98, 0x87, 0x87, 0x78, 0x78, 0x89,
 };
-static const uint8_t* OFFSET_DATA[PIECES_COUNT] = {
-        OFFSET_DATA_I,
-        OFFSET_DATA_JLSTZ,
-        OFFSET_DATA_JLSTZ,
-        OFFSET_DATA_O,
-        OFFSET_DATA_JLSTZ,
-        OFFSET_DATA_JLSTZ,
-        OFFSET_DATA_JLSTZ,
+static const uint8_t* KICK_DATA[PIECES_COUNT] = {
+        KICK_DATA_I,
+        KICK_DATA_JLSTZ,
+        KICK_DATA_JLSTZ,
+        KICK_DATA_O,
+        KICK_DATA_JLSTZ,
+        KICK_DATA_JLSTZ,
+        KICK_DATA_JLSTZ,
 };
 
 // for detecting T-spins, positions of the 4 corners of the T piece for spawn rotation,
@@ -163,6 +201,25 @@ static const uint8_t* get_curr_piece_data(void) {
                                 tetris.curr_piece_rot) * BLOCKS_PER_PIECE];
 }
 
+static const uint8_t* get_curr_piece_row_masks(void) {
+    return &PIECES_ROW_MASKS[(tetris.curr_piece * ROTATIONS_COUNT +
+                              tetris.curr_piece_rot) * PIECE_GRID_SIZE];
+}
+
+static void mark_row_changed(uint8_t y) {
+    tetris.changed_rows |= (uint32_t) 1 << y;
+}
+
+#ifdef TETRIS_PROFILE
+tetris_profile_t tetris_profile;
+
+static uint64_t profile_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif //TETRIS_PROFILE
+
 /**
  * Update score for a number of lines cleared and a T-spin.
  * All info about the last points made is stored for printing it.
@@ -189,18 +246,11 @@ static void tetris_update_score(tetris_tspin tspin, uint8_t lines_cleared) {
     bool perfect_clear = false;
     if (lines_cleared > 0) {
         // check play field for perfect clear
-        perfect_clear = true;
-        for (uint8_t x = 0; x < GRID_WIDTH; ++x) {
-            for (uint8_t y = 0; y < GRID_HEIGHT; ++y) {
-                if (tetris.grid[x][y] != TETRIS_PIECE_NONE) {
-                    perfect_clear = false;
-                    break;
-                }
-            }
-            if (!perfect_clear) {
-                break;
-            }
+        uint16_t blocks = 0;
+        for (uint8_t y = 0; y < GRID_HEIGHT; ++y) {
+            blocks |= tetris.rows[y];
         }
+        perfect_clear = (blocks == 0);
 
         pts += TETRIS_LINE_CLEAR_PTS[lines_cleared - 1] * TETRIS_BONUS_MUL;
         if (perfect_clear) {
@@ -248,6 +298,16 @@ static void tetris_update_score(tetris_tspin tspin, uint8_t lines_cleared) {
     tetris.score += pts;
 }
 
+#ifdef TETRIS_PROFILE
+static void tetris_update_score_profiled(tetris_tspin tspin, uint8_t lines_cleared) {
+    const uint64_t start = profile_time();
+    tetris_update_score(tspin, lines_cleared);
+    tetris_profile.update_score_time += profile_time() - start;
+    ++tetris_profile.update_score_calls;
+}
+#define tetris_update_score tetris_update_score_profiled
+#endif //TETRIS_PROFILE
+
 /**
  * Returns the T-spin achieved once the piece is locked.
  */
@@ -266,7 +326,7 @@ static tetris_tspin tetris_detect_tspin(void) {
         int8_t y = (int8_t) (tetris.curr_piece_y + (pos & 0xf));
         // all blocks out of the grid are considered set
         bool has_corner = x < 0 || y < 0 || x >= GRID_WIDTH || y >= GRID_HEIGHT
-                          || tetris.grid[x][y] != TETRIS_PIECE_NONE;
+                          || (tetris.rows[y] & (1 << x));
         if (i < 2) {
             front_corners += has_corner;
         } else {
@@ -290,37 +350,122 @@ static tetris_tspin tetris_detect_tspin(void) {
     return TETRIS_TSPIN_NONE;
 }
 
+#ifdef TETRIS_PROFILE
+static tetris_tspin tetris_detect_tspin_profiled(void) {
+    const uint64_t start = profile_time();
+    const tetris_tspin tspin = tetris_detect_tspin();
+    tetris_profile.detect_tspin_time += profile_time() - start;
+    ++tetris_profile.detect_tspin_calls;
+    return tspin;
+}
+#define tetris_detect_tspin tetris_detect_tspin_profiled
+#endif //TETRIS_PROFILE
+
 /**
  * Returns true if the current piece can be placed on the grid without intersection.
- * The current piece and the ghost piece must be been removed first or this will fail.
+ * Only locked blocks are considered, so the current piece and the ghost piece don't matter.
  */
 static bool tetris_can_place_piece(void) {
+    const uint8_t* row_masks = get_curr_piece_row_masks();
+    const int8_t x = tetris.curr_piece_x;
+    int8_t y = tetris.curr_piece_y;
+    for (uint8_t i = 0; i < PIECE_GRID_SIZE; ++i, ++y) {
+        const uint8_t piece_mask = row_masks[i];
+        if (piece_mask == 0) {
+            continue;
+        }
+        if (y < 0 || y >= GRID_HEIGHT) {
+            // piece row is out of bounds.
+            return false;
+        }
+        uint16_t mask;
+        if (x >= 0) {
+            mask = (uint16_t) piece_mask << x;
+        } else {
+            mask = piece_mask >> -x;
+            if ((uint8_t) (mask << -x) != piece_mask) {
+                // piece block is out of bounds on the left.
+                return false;
+            }
+        }
+        if ((mask & ~GRID_ROW_FULL) || (tetris.rows[y] & mask)) {
+            // piece block is out of bounds on the right, or on top of an existing block.
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef TETRIS_PROFILE
+static bool tetris_can_place_piece_profiled(void) {
+    const uint64_t start = profile_time();
+    const bool can_place = tetris_can_place_piece();
+    tetris_profile.can_place_piece_time += profile_time() - start;
+    ++tetris_profile.can_place_piece_calls;
+    return can_place;
+}
+#define tetris_can_place_piece tetris_can_place_piece_profiled
+#endif //TETRIS_PROFILE
+
+/**
+ * Returns the number of rows the current piece can be dropped by from its position
+ * before it lands on a locked block or on the bottom of the grid.
+ */
+static uint8_t tetris_get_drop_distance(void) {
     const uint8_t* piece_data = get_curr_piece_data();
+    uint8_t distance = GRID_HEIGHT;
     for (uint8_t i = 0; i < BLOCKS_PER_PIECE; ++i) {
         uint8_t block = piece_data[i];
-        int8_t x = (int8_t) (tetris.curr_piece_x + (block >> 4));
-        int8_t y = (int8_t) (tetris.curr_piece_y + (block & 0xf));
-        if (x < 0 || x >= GRID_WIDTH || y < 0 || y >= GRID_HEIGHT ||
-            tetris.grid[x][y] != TETRIS_PIECE_NONE) {
-            // piece block is out of bounds, or on top of an existing block.
-            return false;
+        uint8_t x = tetris.curr_piece_x + (block >> 4);
+        uint8_t y = tetris.curr_piece_y + (block & 0xf);
+        uint8_t block_distance;
+        if (y >= tetris.heights[x]) {
+            // block is above all locked blocks in that column.
+            block_distance = y - tetris.heights[x];
+        } else {
+            // block is below an overhang, find the first locked block under it.
+            const uint16_t mask = 1 << x;
+            block_distance = 0;
+            while (y > 0 && !(tetris.rows[y - 1] & mask)) {
+                --y;
+                ++block_distance;
+            }
+        }
+        if (block_distance < distance) {
+            distance = block_distance;
         }
     }
-    return true;
+    return distance;
+}
+
+/**
+ * Update the height of all grid columns from the locked blocks.
+ */
+static void tetris_update_heights(void) {
+    for (uint8_t x = 0; x < GRID_WIDTH; ++x) {
+        const uint16_t mask = 1 << x;
+        uint8_t height = GRID_HEIGHT;
+        while (height > 0 && !(tetris.rows[height - 1] & mask)) {
+            --height;
+        }
+        tetris.heights[x] = height;
+    }
 }
 
 /**
  * Remove the ghost piece from the grid data.
+ * Blocks of the ghost piece that were covered by the current piece are left untouched.
  */
 static void tetris_remove_ghost_piece(void) {
     if (!(tetris.options.features & TETRIS_FEATURE_GHOST)) {
         return;
     }
-    for (uint8_t x = 0; x < GRID_WIDTH; ++x) {
-        for (uint8_t y = 0; y < GRID_HEIGHT; ++y) {
-            if (tetris.grid[x][y] == TETRIS_PIECE_GHOST) {
-                tetris.grid[x][y] = TETRIS_PIECE_NONE;
-            }
+    tetris_piece* grid_ptr = (tetris_piece*) tetris.grid;
+    for (uint8_t i = 0; i < BLOCKS_PER_PIECE; ++i) {
+        tetris_piece* block = &grid_ptr[tetris.ghost_blocks[i]];
+        if (*block == TETRIS_PIECE_GHOST) {
+            *block = TETRIS_PIECE_NONE;
+            mark_row_changed(tetris.ghost_blocks[i] % GRID_HEIGHT);
         }
     }
 }
@@ -334,24 +479,43 @@ static void tetris_lock_piece(void) {
 
     tetris_tspin tspin = tetris_detect_tspin();
 
+    // add blocks of current piece to the locked blocks.
+    const uint8_t* piece_data = get_curr_piece_data();
+    for (uint8_t i = 0; i < BLOCKS_PER_PIECE; ++i) {
+        uint8_t block = piece_data[i];
+        int8_t x = (int8_t) (tetris.curr_piece_x + (block >> 4));
+        int8_t y = (int8_t) (tetris.curr_piece_y + (block & 0xf));
+        tetris.rows[y] |= 1 << x;
+        if (y >= tetris.heights[x]) {
+            tetris.heights[x] = y + 1;
+        }
+    }
+
     // clear any full lines
     uint8_t lines_cleared = 0;
     for (uint8_t y = 0; y < GRID_HEIGHT; ++y) {
-        bool line_full = true;
-        for (uint8_t x = 0; x < GRID_WIDTH; ++x) {
-            tetris_piece block = tetris.grid[x][y];
-            if (block == TETRIS_PIECE_NONE) {
-                line_full = false;
+        const uint16_t row = tetris.rows[y];
+        if (lines_cleared > 0) {
+            // shift line to account for lines cleared below.
+            for (uint8_t x = 0; x < GRID_WIDTH; ++x) {
+                tetris_piece block = tetris.grid[x][y];
+                tetris.grid[x][y] = TETRIS_PIECE_NONE;
+                tetris.grid[x][y - lines_cleared] = block;
             }
-            // shift line block to account for lines cleared below.
-            tetris.grid[x][y] = TETRIS_PIECE_NONE;
-            tetris.grid[x][y - lines_cleared] = block;
+            tetris.rows[y] = 0;
+            tetris.rows[y - lines_cleared] = row;
         }
-        if (line_full) {
+        if (row == GRID_ROW_FULL) {
             ++lines_cleared;
         }
     }
 
+    if (lines_cleared > 0) {
+        tetris_update_heights();
+        // all rows above the first cleared line have moved.
+        tetris.changed_rows = UINT32_MAX;
+    }
+
     tetris_update_score(tspin, lines_cleared);
 
     // update level
@@ -378,18 +542,17 @@ static void tetris_place_piece(bool has_moved) {
 
     if (ghost_enabled) {
         // place ghost piece as low as possible
-        int8_t piece_y = tetris.curr_piece_y;
-        do {
-            --tetris.curr_piece_y;
-        } while (tetris_can_place_piece());
-        ++tetris.curr_piece_y;
+        const int8_t ghost_y = (int8_t) (tetris.curr_piece_y - tetris_get_drop_distance());
+        tetris_piece* grid_ptr = (tetris_piece*) tetris.grid;
         for (uint8_t i = 0; i < BLOCKS_PER_PIECE; ++i) {
             uint8_t block = piece_data[i];
             int8_t x = (int8_t) (tetris.curr_piece_x + (block >> 4));
-            int8_t y = (int8_t) (tetris.curr_piece_y + (block & 0xf));
-            tetris.grid[x][y] = TETRIS_PIECE_GHOST;
+            int8_t y = (int8_t) (ghost_y + (block & 0xf));
+            const uint8_t index = x * GRID_HEIGHT + y;
+            grid_ptr[index] = TETRIS_PIECE_GHOST;
+            tetris.ghost_blocks[i] = index;
+            mark_row_changed(y);
         }
-        tetris.curr_piece_y = piece_y;
     }
 
     bool piece_on_ghost = false;
@@ -404,8 +567,8 @@ static void tetris_place_piece(bool has_moved) {
             piece_on_ghost = true;
         }
         tetris.grid[x][y] = tetris.curr_piece;
-        if (y == 0 || (tetris.grid[x][y - 1] != TETRIS_PIECE_NONE &&
-                       tetris.grid[x][y - 1] != TETRIS_PIECE_GHOST)) {
+        mark_row_changed(y);
+        if (y == 0 || (tetris.rows[y - 1] & (1 << x))) {
             // piece data is encoded from top row to bottom row.
             // if there's a block below this one, that means the piece has reached the bottom.
             tetris.flags |= TETRIS_FLAG_PIECE_AT_BOTTOM;
@@ -445,6 +608,7 @@ static void tetris_remove_piece(void) {
         int8_t x = (int8_t) (tetris.curr_piece_x + (block >> 4));
         int8_t y = (int8_t) (tetris.curr_piece_y + (block & 0xf));
         tetris.grid[x][y] = TETRIS_PIECE_NONE;
+        mark_row_changed(y);
     }
     tetris_remove_ghost_piece();
 }
@@ -542,6 +706,9 @@ void tetris_init(void) {
             tetris.grid[x][y] = TETRIS_PIECE_NONE;
         }
     }
+    memset(tetris.rows, 0, sizeof tetris.rows);
+    memset(tetris.heights, 0, sizeof tetris.heights);
+    tetris.changed_rows = UINT32_MAX;
 
     tetris.flags = 0;
 
@@ -645,20 +812,15 @@ void tetris_hard_drop(void) {
         return;
     }
 
-    // move piece down until it can't be placed, at which point bottom is reached.
-    uint8_t cells_dropped = 0;
+    // move piece down to the bottom, then lock it.
     tetris_remove_piece();
-    do {
-        --tetris.curr_piece_y;
-        ++cells_dropped;
-    } while (tetris_can_place_piece());
+    const uint8_t cells_dropped = tetris_get_drop_distance();
+    tetris.curr_piece_y = (int8_t) (tetris.curr_piece_y - cells_dropped);
 
     game_sound_push(ASSET_SOUND_HARD_DROP);
 
-    // undo last drop and replace piece, then lock it.
-    ++tetris.curr_piece_y;
     tetris.last_rot_offset = LAST_ROT_NONE;
-    tetris.score += (cells_dropped - 1) * HARD_DROP_PTS_PER_CELL;
+    tetris.score += cells_dropped * HARD_DROP_PTS_PER_CELL;
     tetris_place_piece(true);
     tetris_lock_piece();
 }
@@ -683,20 +845,16 @@ void tetris_rotate_piece(tetris_rot_dir direction) {
     tetris.curr_piece_rot = new_rot;
 
     // do wall kicks: try a few offsets before failing to rotate.
-    // the first wall kick offsets are just the normal rotation.
-    const uint8_t* src_offset = &OFFSET_DATA[tetris.curr_piece][old_rot];
-    const uint8_t* dst_offset = &OFFSET_DATA[tetris.curr_piece][new_rot];
+    // the first wall kick offset is just the normal rotation.
+    const uint8_t* kick = &KICK_DATA[tetris.curr_piece][old_rot * 2 + direction];
     for (uint8_t i = 0; i < MAX_WALL_KICKS; ++i) {
-        int8_t ox = (int8_t) ((*src_offset >> 4) - (*dst_offset >> 4));
-        int8_t oy = (int8_t) ((*src_offset & 0xf) - (*dst_offset & 0xf));
-        tetris.curr_piece_x = (int8_t) (old_x + ox);
-        tetris.curr_piece_y = (int8_t) (old_y + oy);
+        tetris.curr_piece_x = (int8_t) (old_x + (*kick >> 4) - 8);
+        tetris.curr_piece_y = (int8_t) (old_y + (*kick & 0xf) - 8);
         if (tetris_try_move()) {
             tetris.last_rot_offset = i;
             return;
         }
-        src_offset += ROTATIONS_COUNT;
-        dst_offset += ROTATIONS_COUNT;
+        kick += KICKS_PER_GROUP;
 
         if (!(tetris.options.features & TETRIS_FEATURE_WALL_KICKS)) {
             // wall kicks disabled, only try basic rotation
@@ -1,2 +1,16 @@
 
 DEFINES += DIALOG_MAX_ITEMS=6
+
+ifeq ($(REPLAY),1)
+# The bot benchmark measures time spent in some engine functions.
+DEFINES += TETRIS_PROFILE
+endif
+
+ALL_TESTS := bot
+
+bot_test:
+	$(MAKE) compile TEST_NAME=bot
+
+# Optimized bot benchmark, run from app/tetris with build/replay/bot_replay.
+bot_replay:
+	$(MAKE) compile TEST_NAME=bot REPLAY=1
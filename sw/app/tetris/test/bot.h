@@ -0,0 +1,161 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TETRIS_TEST_BOT_H
+#define TETRIS_TEST_BOT_H
+
+#include <cstdint>
+#include <algorithm>
+
+extern "C" {
+#include <tetris.h>
+#include <core/random.h>
+}
+
+/**
+ * Simple placement bot playing through the game API. For each new piece, the bot tries all
+ * rotations and columns, drops the piece straight down on the locked blocks and chooses the
+ * placement with the best score (weighted aggregate height, holes, bumpiness, lines cleared).
+ * It then rotates and moves the piece to its place and hard drops it.
+ */
+class Bot {
+public:
+    /** Start a new game with all features enabled, with a random seed. */
+    static void start_game(uint16_t seed) {
+        random_seed(seed);
+        tetris.options.features = TETRIS_FEATURE_HOLD | TETRIS_FEATURE_GHOST |
+                                  TETRIS_FEATURE_WALL_KICKS | TETRIS_FEATURE_TSPINS;
+        tetris.options.preview_pieces = 3;
+        tetris_init();
+    }
+
+    static bool is_game_over() {
+        return (tetris.flags & TETRIS_FLAG_GAME_OVER) != 0;
+    }
+
+    /**
+     * Wait for the next piece to spawn, then place it. Returns false if the game is over.
+     */
+    static bool play_piece() {
+        while (tetris.curr_piece == TETRIS_PIECE_NONE && !is_game_over()) {
+            tetris_update(1);
+        }
+        if (is_game_over()) {
+            return false;
+        }
+
+        const Placement placement = find_best_placement();
+        for (uint8_t i = 0; i < placement.rotation; ++i) {
+            tetris_rotate_piece(TETRIS_DIR_CW);
+        }
+        for (uint8_t i = 0; i < GRID_WIDTH && tetris.curr_piece_x != placement.x; ++i) {
+            if (tetris.curr_piece_x < placement.x) {
+                tetris_move_right();
+            } else {
+                tetris_move_left();
+            }
+        }
+        tetris_hard_drop();
+        return true;
+    }
+
+private:
+    struct Placement {
+        uint8_t rotation;
+        int8_t x;
+    };
+
+    static const uint8_t* piece_data(uint8_t rotation) {
+        return &TETRIS_PIECES_DATA[(tetris.curr_piece * ROTATIONS_COUNT + rotation) *
+                                   BLOCKS_PER_PIECE];
+    }
+
+    static int evaluate(const uint16_t rows[GRID_HEIGHT]) {
+        int lines = 0;
+        int holes = 0;
+        int aggregate_height = 0;
+        int bumpiness = 0;
+        int last_height = -1;
+        for (uint8_t y = 0; y < GRID_HEIGHT; ++y) {
+            lines += rows[y] == GRID_ROW_FULL;
+        }
+        for (uint8_t x = 0; x < GRID_WIDTH; ++x) {
+            const uint16_t mask = 1 << x;
+            int height = GRID_HEIGHT;
+            while (height > 0 && !(rows[height - 1] & mask)) {
+                --height;
+            }
+            for (int y = 0; y < height; ++y) {
+                holes += !(rows[y] & mask);
+            }
+            aggregate_height += height;
+            if (last_height >= 0) {
+                bumpiness += std::abs(height - last_height);
+            }
+            last_height = height;
+        }
+        return 76 * lines - 51 * aggregate_height - 36 * holes - 18 * bumpiness;
+    }
+
+    static Placement find_best_placement() {
+        Placement best = {0, tetris.curr_piece_x};
+        int best_score = INT32_MIN;
+        for (uint8_t rotation = 0; rotation < ROTATIONS_COUNT; ++rotation) {
+            const uint8_t* data = piece_data(rotation);
+            for (int8_t x = -PIECE_GRID_SIZE; x < GRID_WIDTH; ++x) {
+                // find the lowest position on top of the locked blocks in each column.
+                int y = -PIECE_GRID_SIZE;
+                bool in_grid = true;
+                for (uint8_t i = 0; i < BLOCKS_PER_PIECE; ++i) {
+                    const int bx = x + (data[i] >> 4);
+                    const int by = data[i] & 0xf;
+                    if (bx < 0 || bx >= GRID_WIDTH) {
+                        in_grid = false;
+                        break;
+                    }
+                    y = std::max(y, tetris.heights[bx] - by);
+                }
+                if (!in_grid) {
+                    continue;
+                }
+
+                uint16_t rows[GRID_HEIGHT];
+                std::copy(std::begin(tetris.rows), std::end(tetris.rows), rows);
+                bool fits = true;
+                for (uint8_t i = 0; i < BLOCKS_PER_PIECE; ++i) {
+                    const int by = y + (data[i] & 0xf);
+                    if (by >= GRID_HEIGHT) {
+                        fits = false;
+                        break;
+                    }
+                    rows[by] |= 1 << (x + (data[i] >> 4));
+                }
+                if (!fits) {
+                    continue;
+                }
+
+                const int score = evaluate(rows);
+                if (score > best_score) {
+                    best_score = score;
+                    best = {rotation, x};
+                }
+            }
+        }
+        return best;
+    }
+};
+
+#endif //TETRIS_TEST_BOT_H
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark for the piece logic: a bot plays games as fast as possible, and the number of
+ * pieces played per second is reported, along with the time spent in some engine functions.
+ * This is built without sanitizers, with optimizations and with `TETRIS_PROFILE`,
+ * see the `bot_replay` target. Timing each profiled call adds a small overhead.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+#include "bot.h"
+
+constexpr uint32_t TOTAL_PIECES = 2000000;
+
+static void print_profile(const char* name, uint64_t calls, uint64_t time_ns, double elapsed) {
+    std::cout << std::left << std::setw(18) << name << std::right
+              << std::setw(12) << calls << " calls, "
+              << std::setprecision(3) << time_ns / 1e9 << " s ("
+              << std::setprecision(1) << time_ns / 1e7 / elapsed << "%), "
+              << std::setprecision(1) << (calls ? (double) time_ns / calls : 0.0)
+              << " ns/call" << std::endl;
+}
+
+int main() {
+    std::cout << "Playing " << TOTAL_PIECES << " pieces..." << std::endl;
+    const auto start_time = std::chrono::steady_clock::now();
+
+    uint32_t pieces = 0;
+    uint32_t games = 0;
+    uint64_t lines = 0;
+    while (pieces < TOTAL_PIECES) {
+        // game is restarted with a new seed on game over.
+        Bot::start_game(++games);
+        while (pieces < TOTAL_PIECES && Bot::play_piece()) {
+            ++pieces;
+        }
+        lines += tetris.lines;
+    }
+
+    const double elapsed = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start_time).count();
+    std::cout << pieces << " pieces in " << games << " games, " << lines << " lines, "
+              << std::fixed << std::setprecision(2) << elapsed << " s ("
+              << std::setprecision(0) << pieces / elapsed << " pieces/s)" << std::endl;
+
+    print_profile("can_place_piece", tetris_profile.can_place_piece_calls,
+                  tetris_profile.can_place_piece_time, elapsed);
+    print_profile("detect_tspin", tetris_profile.detect_tspin_calls,
+                  tetris_profile.detect_tspin_time, elapsed);
+    print_profile("update_score", tetris_profile.update_score_calls,
+                  tetris_profile.update_score_time, elapsed);
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "bot.h"
+
+// Number of pieces played per game in tests (games normally end earlier only on game over).
+constexpr uint32_t PIECES_PER_GAME = 2000;
+constexpr uint16_t GAMES_COUNT = 5;
+
+/**
+ * Check that the locked block masks and column heights match the grid data.
+ * This must be called when there is no current piece, after one was locked.
+ */
+static void check_locked_blocks() {
+    for (uint8_t y = 0; y < GRID_HEIGHT; ++y) {
+        for (uint8_t x = 0; x < GRID_WIDTH; ++x) {
+            const tetris_piece block = tetris.grid[x][y];
+            ASSERT_NE(block, TETRIS_PIECE_GHOST) << "ghost left at " << (int) x << "," << (int) y;
+            ASSERT_EQ((tetris.rows[y] >> x) & 1, block != TETRIS_PIECE_NONE)
+                                << "mask mismatch at " << (int) x << "," << (int) y;
+        }
+    }
+    for (uint8_t x = 0; x < GRID_WIDTH; ++x) {
+        uint8_t height = GRID_HEIGHT;
+        while (height > 0 && tetris.grid[x][height - 1] == TETRIS_PIECE_NONE) {
+            --height;
+        }
+        ASSERT_EQ(tetris.heights[x], height) << "height mismatch in column " << (int) x;
+    }
+}
+
+TEST(BotTest, locked_blocks_consistent) {
+    for (uint16_t seed = 1; seed <= GAMES_COUNT; ++seed) {
+        Bot::start_game(seed);
+        for (uint32_t i = 0; i < PIECES_PER_GAME && Bot::play_piece(); ++i) {
+            // wait for the piece to be locked and the next one to spawn.
+            if (tetris.curr_piece == TETRIS_PIECE_NONE) {
+                check_locked_blocks();
+                if (::testing::Test::HasFatalFailure()) {
+                    FAIL() << "in game " << seed << " after " << i << " pieces";
+                }
+            }
+        }
+    }
+}
+
+TEST(BotTest, clears_lines) {
+    uint32_t pieces = 0;
+    uint32_t lines = 0;
+    for (uint16_t seed = 1; seed <= GAMES_COUNT; ++seed) {
+        Bot::start_game(seed);
+        uint32_t i = 0;
+        while (i < PIECES_PER_GAME && Bot::play_piece()) {
+            ++i;
+        }
+        pieces += i;
+        lines += tetris.lines;
+    }
+    // each piece has 4 blocks and a line has 10, so at most 0.4 lines can be cleared per piece.
+    // the bot is far from perfect but should clear most of them.
+    EXPECT_GT(lines, pieces * 3 / 10);
+}
@@ -35,6 +35,8 @@
 
 extern const uint8_t ASSET_TILESET_MAP_BOTTOM[];
 extern const uint8_t ASSET_TILESET_MAP_TOP[];
+extern const uint8_t ASSET_TILESET_SPAN_BOTTOM[];
+extern const uint8_t ASSET_TILESET_ROWS_TOP[];
 
 #define ASSET_IMAGE_PACK_PROGRESS_SIZE 9
 #define ASSET_IMAGE_PACK_PROGRESS_ADDR 0x2ae4
@@ -140,6 +140,14 @@ typedef struct {
     level_idx_t current_level;
     uint16_t current_level_pos;
 
+    // current level information shown in the level info and level complete dialogs, read once
+    // when the dialog is opened instead of from flash and EEPROM on every page.
+    flash_t level_title;
+    // number of lines of the level title, 0 if not computed yet (done when first drawn).
+    uint8_t level_title_lines;
+    time_left_t best_level_time;
+    char level_password[LEVEL_PASSWORD_LENGTH];
+
     // misc
     uint8_t anim_state;
 } game_t;
@@ -18,6 +18,8 @@
 #ifndef TWORLD_RENDER_H
 #define TWORLD_RENDER_H
 
+#include <stdbool.h>
+
 #define LEVEL_PACKS_PER_SCREEN 4
 
 #define LEVELS_PER_SCREEN_H 4
@@ -40,4 +42,10 @@
 
 void draw(void);
 
+/**
+ * Set the display rows to refresh on the next frame if only part of the game map changed
+ * since the last frame. Returns false if nothing changed and the frame can be skipped.
+ */
+bool set_game_dirty_rows(void);
+
 #endif //TWORLD_RENDER_H
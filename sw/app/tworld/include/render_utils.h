@@ -21,6 +21,7 @@
 #include "tworld_tile.h"
 #include "tworld_actor.h"
 #include "tworld.h"
+#include "render.h"
 
 #include <core/graphics.h>
 
@@ -43,6 +44,11 @@ void format_time_left(char buf[static 4], time_left_t time);
  */
 grid_pos_t get_camera_pos(grid_pos_t pos);
 
+/**
+ * Returns true if a bottom tile is drawn differently depending on the animation state.
+ */
+bool bottom_tile_is_animated(tile_t tile);
+
 /**
  * Draw a 16x14 bottom tile at a position. Tiles must be drawn left to right.
  * Y position must be greater or equal to display page start and less than display page end.
@@ -58,11 +64,13 @@ void draw_bottom_tile(disp_x_t x, disp_y_t y, tile_t tile);
 void draw_top_tile(disp_x_t x, disp_y_t y, actor_t tile);
 
 /**
- * Draw a tile composed of a bottom and up to 2 top tiles for the given tile and actor.
- * Y position must be greater or equal to display page start and less than display page end.
- * X position must be even. This handles special cases like block, swimming chip, etc.
+ * Draw a row of game tiles from the left of the display, each composed of a bottom and up to
+ * 2 top tiles for the given tile and actors. The arrays are modified to handle special cases
+ * like block, swimming chip, etc. Y position must be greater or equal to display page start
+ * and less than display page end. Runs of the same bottom tile are only read once from flash.
  */
-void draw_game_tile(disp_x_t x, disp_y_t y, tile_t tile, actor_t actor0, actor_t actor1);
+void draw_game_row(disp_y_t y, tile_t tiles[static GAME_MAP_SIZE],
+                   actor_t actors0[static GAME_MAP_SIZE], actor_t actors1[static GAME_MAP_SIZE]);
 
 /**
  * Draw text in a box at top left coordinates and with specified dimensions,
@@ -49,6 +49,12 @@ time_left_t get_best_level_time(uint16_t pos);
  */
 void set_best_level_time(void);
 
+/**
+ * Read all level times from EEPROM at once, to be used by `fill_completed_levels_array`.
+ * The times are kept in display buffer memory, so this must be called again after drawing.
+ */
+void read_level_times(void);
+
 /**
  * For `info->total_levels` levels starting at `pos`, set a bit in the completed levels bitset to 1
  * when the level is completed. Sets the number of levels completed and the last unlocked
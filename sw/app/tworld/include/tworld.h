@@ -31,14 +31,17 @@
 // There are 16 ticks per actual second, making each in-game second actually 1.25 s.
 #define TICKS_PER_SECOND 20
 
+#ifdef TWORLD_UNPACKED_LAYERS
+// One byte per tile, for faster access on devices with more RAM (needs 512 more bytes per layer).
+#define LEVEL_LAYER_SIZE (32 * 32)
+#else
+// 6 bits per tile, 4 tiles in each block of 3 bytes.
 #define LEVEL_LAYER_SIZE (6 * 32 * 32 / 8)
+#endif
 #define LEVEL_KEY_COUNT 4
 
 #define LEVEL_LINKS_MAX_SIZE 32
 
-// Maximum teleporters in prebuilt list (if SCAN_TELEPORTERS flag is not set).
-#define LEVEL_MAX_TELEPORTERS 128
-
 #define GRID_WIDTH 32
 #define GRID_HEIGHT 32
 #define GRID_SIZE (GRID_WIDTH * GRID_HEIGHT)
@@ -75,6 +78,7 @@ typedef struct {
     // Next direction for random force floor.
     direction_t random_slide_dir;
     // Top and bottom layers, 6 bits per tile, row-major order and little-endian.
+    // If TWORLD_UNPACKED_LAYERS is defined, layers have one byte per tile instead.
     uint8_t bottom_layer[LEVEL_LAYER_SIZE];
     uint8_t top_layer[LEVEL_LAYER_SIZE];
     // Time left for level (time limit initially).
@@ -87,9 +91,24 @@ typedef struct {
     // This zero length field is only used to mark the start of zero-initialized field on init.
     uint8_t zero_init_start[0];
     // Actor list, bounded size.
+#ifdef TWORLD_SPLIT_ACTORS
+    // The list is split in the position bits and a byte with state and step of each actor,
+    // so that scans of the state don't touch or unpack positions (see `store_actor`).
+    uint16_t actor_positions[MAX_ACTORS_COUNT];
+    uint8_t actor_states[MAX_ACTORS_COUNT];
+#else
     active_actor_t actors[MAX_ACTORS_COUNT];
+#endif
     // Size of the actor buffer (some actors may be hidden).
     uint8_t actors_size;
+    // Bitset of actor list slots that can be reused by spawn_actor (hidden with no step left).
+    uint8_t free_actors[MAX_ACTORS_COUNT / 8];
+    // Bitset of grid rows in which a tile was set since the renderer last cleared it.
+    uint8_t changed_rows[GRID_HEIGHT / 8];
+#ifdef TWORLD_WALL_CACHE
+    // Bitset of monster acting walls on the bottom layer, one bit per tile in reading order.
+    uint8_t monster_walls[GRID_SIZE / 8];
+#endif
     // Last byte of current time, used with stepping.
     uint24_t current_time;
     // Game flags (FLAG_* constants in tworld.c).
@@ -145,23 +164,97 @@ typedef struct {
     position_t link;
 } PACK_STRUCT link_t;
 
+/**
+ * Links list, sorted by button position in reading order (see `LINK_POS_KEY`).
+ * Links with the same button keep their order from the level data.
+ */
 typedef struct {
     uint8_t size;
     link_t links[LEVEL_LINKS_MAX_SIZE];
 } links_t;
 
+// Sort key of a link button position, in reading order.
+#define LINK_POS_KEY(pos) ((uint16_t) ((uint16_t) (pos).y << 8 | (pos).x))
+
+/**
+ * Bitset of teleporter positions on the grid, one bit per tile in reading order.
+ * Tile at index N is bit (N % 8) of byte (N / 8).
+ */
 typedef struct {
-    uint8_t size;
-    position_t teleporters[LEVEL_MAX_TELEPORTERS];
+    uint8_t bits[GRID_SIZE / 8];
 } teleporters_t;
 
+#ifdef TWORLD_CONTEXT
+
+/**
+ * Engine context holding everything needed to simulate one level. When `TWORLD_CONTEXT` is
+ * defined (host builds only), all engine and level loading functions work on the context set
+ * for the current thread, so that several levels can be simulated at once, and a game state
+ * can be saved and restored by copying its context. Otherwise the engine uses global state.
+ */
+typedef struct {
+    level_t level;
+    links_t trap_links;
+    links_t cloner_links;
+    teleporters_t teleporters;
+} tworld_ctx_t;
+
+extern __thread tworld_ctx_t* tworld_ctx;
+
+#define trap_links (tworld_ctx->trap_links)
+#define cloner_links (tworld_ctx->cloner_links)
+#define teleporters (tworld_ctx->teleporters)
+
+/**
+ * Set the engine context used by the current thread.
+ * Note that level loading isn't thread-safe since it reads from flash.
+ */
+void tworld_set_context(tworld_ctx_t* ctx);
+
+#else
+
 extern links_t trap_links;
 extern links_t cloner_links;
 extern teleporters_t teleporters;
 
+#endif //TWORLD_CONTEXT
+
+#ifdef TWORLD_PROFILE
+
+/**
+ * Phases of `tworld_update`, timed separately by the profiler.
+ */
+typedef enum {
+    TWORLD_PHASE_STEP_CHECK,
+    TWORLD_PHASE_PRESTEP,
+    TWORLD_PHASE_CHOOSE_MOVES,
+    TWORLD_PHASE_PERFORM_MOVES,
+    TWORLD_PHASE_TELEPORT,
+    TWORLD_PHASE_COUNT,
+} tworld_phase_t;
+
+/**
+ * When `TWORLD_PROFILE` is defined (host test builds only), the engine counts calls to its
+ * hottest functions and measures the host time spent in each phase of `tworld_update`.
+ * Values accumulate until the profile is cleared by the caller.
+ */
+typedef struct {
+    // Number of calls to `tworld_update` that ran the phases.
+    uint32_t ticks;
+    uint32_t can_move_calls;
+    uint32_t lookup_actor_calls;
+    uint32_t get_tile_calls;
+    // Host time spent in each phase, in nanoseconds.
+    uint64_t phase_ns[TWORLD_PHASE_COUNT];
+} tworld_profile_t;
+
+extern tworld_profile_t tworld_profile;
+
+#endif //TWORLD_PROFILE
+
 /**
  * Initialize game state after some fields have been loaded from flash
- * (address, layer data, time limit, chips needed).
+ * (address, layer data, time limit, chips needed). The actor list is read from level data.
  */
 void tworld_init(void);
 
@@ -171,11 +264,6 @@ void tworld_init(void);
  */
 void tworld_update(void);
 
-/**
- * Scan the grid and cache teleporter positions.
- */
-void tworld_cache_teleporters(void);
-
 /**
  * Returns true if game is over (failed or completed).
  */
@@ -186,6 +274,11 @@ bool tworld_is_game_over(void);
  */
 position_t tworld_get_current_position(void);
 
+/**
+ * Returns the actor at an index in the actor list, for testing.
+ */
+active_actor_t tworld_get_actor(actor_idx_t idx);
+
 /**
  * Returns the tile at a position in the game grid.
  */
@@ -202,4 +295,14 @@ actor_t tworld_get_top_tile(position_t pos);
  */
 bool tworld_has_collided(void);
 
+/**
+ * Returns true if a tile was set in a row of the game grid since changed rows were last cleared.
+ */
+bool tworld_is_row_changed(grid_pos_t y);
+
+/**
+ * Clear changed rows, after they were used to refresh the display.
+ */
+void tworld_clear_changed_rows(void);
+
 #endif //TWORLD_TWORLD_H
@@ -90,12 +90,19 @@ typedef union {
 
 extern level_data_t tworld_data;
 
+#ifdef TWORLD_CONTEXT
+#define tworld (tworld_ctx->level)
+#else
 #define tworld tworld_data.level
+#endif
 #define tworld_packs tworld_data.packs
 
 /**
  * Load all the level packs.
  * The result is stored in `tworld_data.level_packs`.
+ * Since pack data shares memory with the level data, this must be called again after a level
+ * was played, it can't be updated in place when a level is completed. Level times are read from
+ * EEPROM in a single pass, so this only takes a few milliseconds.
  */
 void level_read_packs(void);
 
@@ -125,10 +132,24 @@ flash_t level_get_hint(void);
 
 /**
  * Copy trap and cloner links data from flash to global array.
+ * Links are sorted by button position in level data.
  * A level must be loaded before using this.
  */
 void level_get_links(void);
 
+/**
+ * Returns the address in flash of the initial actor list for current level.
+ * The list has a count byte followed by actor positions, with Chip first.
+ * The level address must be set before using this.
+ */
+flash_t level_get_actors(void);
+
+/**
+ * Copy the teleporter list from flash to the teleporter positions bitset.
+ * A level must be loaded before using this.
+ */
+void level_get_teleporters(void);
+
 /**
  * Set the current pack and current level for the entered password.
  * A level pack must be unlocked for the password to work for a level in it.
@@ -26,8 +26,9 @@ with p.group("sound"):
 
 # fonts
 with p.group("font"):
-    p.font("font5x7.png", name="5x7", glyph_width=5, glyph_height=7)
-    p.font("font7x7.png", name="7x7", glyph_width=7, glyph_height=7)
+    # text is drawn on every frame, row-aligned glyphs are faster to draw.
+    p.font("font5x7.png", name="5x7", glyph_width=5, glyph_height=7, row_aligned=True)
+    p.font("font7x7.png", name="7x7", glyph_width=7, glyph_height=7, row_aligned=True)
 
 # images
 with p.group("image"):
@@ -35,7 +36,8 @@ with p.group("image"):
     p.image("arrow-down.png")
     p.image("secret-level.png")
 
-    p.image("menu.png")
+    # drawn at the top of the display, index entries on page boundaries avoid skipping rows.
+    p.image("menu.png", index_granularity="0p")
 
     p.image("pack/pack-password.png")
     p.image("pack/pack-locked.png")
@@ -46,18 +48,26 @@ with p.group("image"):
 # tileset
 with p.group("tileset"):
     with p.array("bottom", ArrayType.REGULAR):
-        bottom_map = p.tileset("tileset-bottom-{}.png", name=f"bottom{i}",
-                               width=9, height=8, tile_width=14, variants=2)
+        bottom_map, bottom_spans = p.tileset("tileset-bottom-{}.png", name=f"bottom{i}",
+                                             width=9, height=8, tile_width=14, variants=2)
 
     with p.array("top", ArrayType.REGULAR):
-        top_map = p.tileset("tileset-top.png", name="top", width=8, height=8,
-                            tile_width=12, alpha=True)
+        top_map, top_rows = p.tileset("tileset-top.png", name="top", width=8, height=8,
+                               tile_width=12, alpha=True)
 
     with p.group("map", Location.INTERNAL):
         p.define("bottom_size", len(bottom_map))
         p.raw(bottom_map, name="bottom")
         p.raw(top_map, name="top")
 
+    # span rows mask of each bottom tile, read for every tile drawn.
+    with p.group("span", Location.INTERNAL):
+        p.raw(bottom_spans, name="bottom")
+
+    # rows extent of each top tile, read for every actor drawn.
+    with p.group("rows", Location.INTERNAL):
+        p.raw(top_rows, name="top")
+
 # death messages
 with p.array("end_cause", ArrayType.INDEXED_ABS):
     messages = [
@@ -145,4 +155,7 @@ with p.array("level_packs", ArrayType.INDEXED_ABS):
     p.level_pack("cclp3.dat", "CCLP3")
     p.level_pack("cclp4.dat", "CCLP4")
 
+# tiles and fonts are read on every frame during the game.
+p.co_access("tileset_bottom", "tileset_top", "font")
+
 p.pack()
@@ -28,6 +28,7 @@
 #include <core/graphics.h>
 #include <core/sound.h>
 #include <core/dialog.h>
+#include <core/framecache.h>
 #include <core/random.h>
 
 #ifdef SIMULATION
@@ -61,14 +62,13 @@ void callback_setup(void) {
 }
 
 bool callback_loop(void) {
-    // wait until at least one game tick has passed since last loop
+    // wait until at least one game tick has passed since last loop, the CPU idles in between.
     // if display was refreshed, dt will be greater than 1, otherwise it will probably be 1.
-    systime_t time;
-    uint8_t dt;
-    do {
-        time = time_get();
-        dt = (time - last_tick_time) / GAME_TICK;
-    } while (dt == 0);
+    const systime_t time = time_get();
+    uint8_t dt = (time - last_tick_time) / GAME_TICK;
+    if (dt == 0) {
+        return false;
+    }
     if (dt > MAX_DELTA_TIME) {
         dt = MAX_DELTA_TIME;
     }
@@ -83,6 +83,10 @@ bool callback_loop(void) {
                           millis_to_ticks(1000.0 / DISPLAY_MAX_FPS_GAME) :
                           millis_to_ticks(1000.0 / DISPLAY_MAX_FPS);
     if ((systime_t) (time - last_draw_time) >= frame_delay) {
+        if (!set_game_dirty_rows()) {
+            // nothing changed since last frame, don't draw it.
+            return false;
+        }
         // links are cached in display buffer memory, drawing will destroy them.
         game.flags &= ~FLAG_CACHE_VALID;
         last_draw_time = time_get();
@@ -136,7 +140,7 @@ static game_state_t update_tworld_state(uint8_t dt) {
         // cache position data if needed
         if (!(game.flags & FLAG_CACHE_VALID)) {
             level_get_links();
-            tworld_cache_teleporters();
+            level_get_teleporters();
             game.flags |= FLAG_CACHE_VALID;
         }
 
@@ -184,13 +188,21 @@ static game_state_t game_state_update(uint8_t dt) {
         return s;
     }
 
-    // Update animation counter for all tiles, except if waiting for user to start level.
-    game.anim_state += dt;
+    // Update animation counter for all tiles, except if waiting for user to start level,
+    // or while the game is paused behind a dialog, since only the dialog is refreshed then.
+    if (s != GAME_STATE_OPTIONS_PLAY && s != GAME_STATE_PAUSE) {
+        game.anim_state += dt;
+    }
 
     if (s == GAME_STATE_PLAY) {
         return update_tworld_state(dt);
     } else if (!(game.flags & FLAG_DIALOG_SHOWN)) {
         // all other states show a dialog, and it wasn't initialized yet.
+        if (s < GAME_SSEP_COVER_BG && !framecache_is_valid()) {
+            // the menu image is saved to the frame cache on the next frame, then restored
+            // from it. It stays valid until the app is exited, since nothing else uses it.
+            framecache_begin();
+        }
         if (s == GAME_STATE_MAIN_MENU) {
             open_main_menu_dialog();
         } else if (s == GAME_STATE_PASSWORD) {
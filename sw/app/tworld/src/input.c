@@ -32,14 +32,22 @@
 // Repeat initial delay before activation, in game ticks.
 #define VERTICAL_NAVIGATION_REPEAT_START 10
 
+static const input_keys_config_t VERTICAL_NAVIGATION_KEYS_CONFIG = {
+        .repeat_mask = BUTTONS_ALL,
+        .repeat_delay = VERTICAL_NAVIGATION_REPEAT_START * GAME_TICK,
+        .repeat_rate = VERTICAL_NAVIGATION_REPEAT_DELAY * GAME_TICK,
+};
+
+static const uint8_t PLAY_KEY_COMBOS[] = {BUTTON_PAUSE};
+
+static const input_keys_config_t PLAY_KEYS_CONFIG = {
+        .combo_delay = BUTTON_COMBINATION_DELAY * GAME_TICK,
+        .combo_count = sizeof PLAY_KEY_COMBOS,
+        .combos = PLAY_KEY_COMBOS,
+};
+
 // Mask indicating buttons which should be considered not pressed until released.
 static uint8_t input_wait_released;
-// Indicates pressed buttons for which click event has been processed.
-static uint8_t click_processed;
-// Time since buttons was pressed, in game ticks.
-static uint8_t button_hold_time[BUTTONS_COUNT];
-// In vertical navigation input, delay before next repeat.
-static uint8_t button_repeat_delay;
 
 static uint8_t preprocess_input_state() {
     uint8_t state = input_get_state();
@@ -62,11 +70,14 @@ static void apply_options_dialog_changes(void) {
     update_music_enabled();
 }
 
-static void reset_input_state() {
+static void reset_input_state(const input_keys_config_t* keys_config) {
     input_wait_released |= input_get_state();
-    click_processed = 0;
-    button_repeat_delay = 0;
-    memset(button_hold_time, 0, sizeof button_hold_time);
+    input_keys_init(keys_config);
+}
+
+static game_state_t start_play(void) {
+    reset_input_state(&PLAY_KEYS_CONFIG);
+    return GAME_STATE_PLAY;
 }
 
 static void handle_vertical_navigation_up(void) {
@@ -142,42 +153,24 @@ static dialog_result_t handle_vertical_navigation_enter(void) {
 }
 
 static dialog_result_t handle_vertical_navigation_input(void) {
-    uint8_t clicked = input_get_clicked();
-
-    // Update button hold time for repeating action.
-    uint8_t state = input_get_state();
-    uint8_t mask = BUTTON0;
-    for (uint8_t i = 0; i < BUTTONS_COUNT; ++i) {
-        if (state & mask) {
-            if (button_hold_time[i] != UINT8_MAX) {
-                ++button_hold_time[i];
+    // Keys are repeated while held, see VERTICAL_NAVIGATION_KEYS_CONFIG.
+    uint8_t key;
+    while ((key = input_get_key()) != 0) {
+        key &= ~INPUT_KEY_REPEAT;
+        if (key & BUTTON_LEFT) {
+            handle_vertical_navigation_left();
+        } else if (key & BUTTON_RIGHT) {
+            handle_vertical_navigation_right();
+        } else if (key & BUTTON_UP) {
+            handle_vertical_navigation_up();
+        } else if (key & BUTTON_DOWN) {
+            handle_vertical_navigation_down();
+        } else if (key & DIALOG_BUTTON_ENTER) {
+            const dialog_result_t res = handle_vertical_navigation_enter();
+            if (res != DIALOG_RESULT_NONE) {
+                return res;
             }
-            if (button_hold_time[i] >= VERTICAL_NAVIGATION_REPEAT_START
-                && button_repeat_delay == 0) {
-                // Button has been held long enough, start repeat action.
-                clicked |= mask;
-                button_repeat_delay = VERTICAL_NAVIGATION_REPEAT_DELAY;
-            }
-        } else {
-            button_hold_time[i] = 0;
         }
-        mask <<= 1;
-    }
-
-    if (button_repeat_delay > 0) {
-        --button_repeat_delay;
-    }
-
-    if (clicked & BUTTON_LEFT) {
-        handle_vertical_navigation_left();
-    } else if (clicked & BUTTON_RIGHT) {
-        handle_vertical_navigation_right();
-    } else if (clicked & BUTTON_UP) {
-        handle_vertical_navigation_up();
-    } else if (clicked & BUTTON_DOWN) {
-        handle_vertical_navigation_down();
-    } else if (clicked & DIALOG_BUTTON_ENTER) {
-        return handle_vertical_navigation_enter();
     }
 
     return DIALOG_RESULT_NONE;
@@ -190,7 +183,7 @@ static void setup_level_packs_selection(void) {
     game.pos_max_x = 0;
     game.pos_max_y = LEVEL_PACK_COUNT;
     game.pos_shown_y = LEVEL_PACKS_PER_SCREEN;
-    reset_input_state();
+    reset_input_state(&VERTICAL_NAVIGATION_KEYS_CONFIG);
 }
 
 static void setup_level_selection(const level_idx_t selection) {
@@ -209,7 +202,7 @@ static void setup_level_selection(const level_idx_t selection) {
         game.pos_first_y = max_first_y;
     }
 
-    reset_input_state();
+    reset_input_state(&VERTICAL_NAVIGATION_KEYS_CONFIG);
 }
 
 static void setup_help_selection(void) {
@@ -220,7 +213,7 @@ static void setup_help_selection(void) {
     game.pos_shown_y = 1;
     game.pos_first_y = 0;
 
-    reset_input_state();
+    reset_input_state(&VERTICAL_NAVIGATION_KEYS_CONFIG);
 }
 
 static bool show_hint_if_needed(void) {
@@ -238,14 +231,14 @@ static bool show_hint_if_needed(void) {
     game.pos_max_y = lines > HINT_LINES_PER_SCREEN ? lines - HINT_LINES_PER_SCREEN : 0;
     game.pos_shown_y = 1;
 
-    reset_input_state();
+    reset_input_state(&VERTICAL_NAVIGATION_KEYS_CONFIG);
     return true;
 }
 
 static game_state_t start_level(void) {
     level_read_level();
 
-    reset_input_state();
+    reset_input_state(&VERTICAL_NAVIGATION_KEYS_CONFIG);
 
     // don't immediately start updating the game state, wait for first input.
     game.flags &= ~FLAG_GAME_STARTED;
@@ -296,18 +289,17 @@ game_state_t game_handle_input_dialog(void) {
         return start_level();
 
     } else if (res == RESULT_START_LEVEL) {
-        return GAME_STATE_PLAY;
+        return start_play();
 
     } else if (res == RESULT_RESTART_LEVEL) {
         start_level();
-        return GAME_STATE_PLAY;
+        return start_play();
 
     } else if (res == RESULT_NEXT_LEVEL) {
         return next_level();
 
     } else if (res == RESULT_RESUME) {
-        reset_input_state();
-        return GAME_STATE_PLAY;
+        return start_play();
 
     } else if (res == RESULT_PAUSE) {
         return GAME_STATE_PAUSE;
@@ -424,52 +416,22 @@ static void handle_movement_input(const uint8_t curr_state) {
     }
 }
 
-static game_state_t handle_misc_input(const uint8_t curr_state) {
-    // update buttons hold time
-    // use hold time to determine which buttons were recently clicked.
-    uint8_t mask = BUTTON0;
-    uint8_t clicked = 0;  // clicked buttons (pressed and click wasn't processed)
-    uint8_t pressed_count = 0;  // number of pressed buttons
-    uint8_t last_hold_time = 0;
-    for (uint8_t i = 0; i < BUTTONS_COUNT; ++i) {
-        uint8_t hold_time = button_hold_time[i];
-        if (curr_state & mask) {
-            // button pressed or held
-            if (hold_time != UINT8_MAX) {
-                ++hold_time;
-                if (!(click_processed & mask)) {
-                    // button is pressed and click wasn't processed yet: trigger a click.
-                    last_hold_time = hold_time;
-                    clicked |= mask;
-                }
-            }
-            ++pressed_count;
-        } else {
-            // button released
-            hold_time = 0;
-            click_processed &= ~mask;
-        }
-        button_hold_time[i] = hold_time;
-        mask <<= 1;
-    }
-
-    if (clicked && (pressed_count > 1 || last_hold_time > BUTTON_COMBINATION_DELAY)) {
-        // If single button pressed, wait minimum time for other button to be pressed and
-        // create a two buttons combination. After that delay, treat as single button click.
-        if ((clicked & BUTTON_PAUSE) == BUTTON_PAUSE) {
-            click_processed |= BUTTON_PAUSE;
+static game_state_t handle_misc_input(void) {
+    // Keys are only created for the action and inventory buttons once the combination delay
+    // has passed without the other button being pressed, see PLAY_KEYS_CONFIG.
+    uint8_t key;
+    while ((key = input_get_key()) != 0) {
+        if (key == BUTTON_PAUSE) {
             game_hide_inventory();
             return GAME_STATE_PAUSE;
 
-        } else if ((clicked & BUTTON_ACTION) == BUTTON_ACTION) {
-            click_processed |= BUTTON_ACTION;
+        } else if (key == BUTTON_ACTION) {
             if (show_hint_if_needed()) {
                 game_hide_inventory();
                 return GAME_STATE_HINT;
             }
 
-        } else if ((clicked & BUTTON_INVENTORY) == BUTTON_INVENTORY) {
-            click_processed |= BUTTON_INVENTORY;
+        } else if (key == BUTTON_INVENTORY) {
             game.flags ^= FLAG_INVENTORY_SHOWN;  // toggle inventory
         }
     }
@@ -486,5 +448,5 @@ game_state_t game_handle_input_tworld(void) {
         game.flags |= FLAG_GAME_STARTED;
     }
 
-    return handle_misc_input(curr_state);
+    return handle_misc_input();
 }
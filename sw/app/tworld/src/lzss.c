@@ -16,8 +16,11 @@
 
 #include "lzss.h"
 
-#define BUFFER_SIZE 16
-#define BUFFER_FILL_SIZE 3
+#include <core/trace.h>
+
+#include <string.h>
+
+#define BUFFER_SIZE 32
 
 #define DISTANCE_BITS1 5
 #define DISTANCE_BITS2 8
@@ -31,58 +34,69 @@
 #define LENGTH_MASK1 ((1 << LENGTH_BITS1) - 1)
 #define LENGTH_MASK2 ((1 << LENGTH_BITS2) - 1)
 
+typedef struct {
+    uint8_t buf[BUFFER_SIZE];
+    uint8_t pos;
+} lzss_src_t;
+
+static uint8_t next_byte(lzss_src_t* src) {
+    if (src->pos == sizeof src->buf) {
+        // Source data buffer is empty, read more data. Since the stream stays open,
+        // this is only the SPI transfer, the read command doesn't have to be sent again.
+        flash_stream_read(sizeof src->buf, src->buf);
+        src->pos = 0;
+    }
+    return src->buf[src->pos++];
+}
+
 void lzss_decode(flash_t src, uint16_t length, void* dst) {
+    trace_spi_tag("lzss_decode");
     uint8_t* out = dst;
 
-    uint8_t buf[BUFFER_SIZE];
-    uint8_t buf_pos = sizeof buf;
+    lzss_src_t in;
+    in.pos = sizeof in.buf;
+
+    // source data is read as a single stream, instead of sending a new read command for each refill.
+    flash_stream_open(src);
 
     uint8_t type_byte = 0;
     uint8_t type_bits = 0;
     while (length) {
-        if (buf_pos > sizeof buf - BUFFER_FILL_SIZE) {
-            // Source data buffer is empty or almost empty, read more data.
-            // The buffer is filled even when there's still bytes left,
-            // because up to 3 bytes can be read in one iteration (type token + long backref token)
-            // Read (buf_pos) bytes and move (sizeof buf - buf_pos) bytes to the start of buffer.
-            uint8_t i = 0;
-            uint8_t pos = buf_pos;
-            while (pos < sizeof buf) {
-                buf[i++] = buf[pos++];
-            }
-            flash_read(src, buf_pos, buf + i);
-            src += buf_pos;
-            buf_pos = 0;
-        }
-
         if (type_bits == 0) {
             // type token (for next 8 data tokens)
-            type_byte = buf[buf_pos++];
+            type_byte = next_byte(&in);
             type_bits = 8;
             --length;
         }
 
-        uint8_t b = buf[buf_pos++];
+        uint8_t b = next_byte(&in);
         --length;
         if (type_byte & 1) {
             // back reference token
             uint8_t reflen;
-            const uint8_t *ref = out;
+            uint16_t distance;
             if (b & 0x1) {
                 // two bytes encoding
-                uint16_t backref = (uint16_t) (b | buf[buf_pos++] << 8) >> 1;
+                uint16_t backref = (uint16_t) (b | next_byte(&in) << 8) >> 1;
                 reflen = (backref & LENGTH_MASK2) + BREAKEVEN2;
-                ref -= backref >> LENGTH_BITS2;
+                distance = (backref >> LENGTH_BITS2) + 1;
                 --length;
             } else {
                 // single byte encoding
                 uint8_t backref = b >> 1;
                 reflen = (backref & LENGTH_MASK1) + BREAKEVEN1;
-                ref -= backref >> LENGTH_BITS1;
+                distance = (backref >> LENGTH_BITS1) + 1;
             }
-            --ref;
-            while (reflen--) {
-                *out++ = *ref++;
+            const uint8_t* ref = out - distance;
+            if (distance >= reflen) {
+                // reference doesn't overlap with output, copy in one go.
+                memcpy(out, ref, reflen);
+                out += reflen;
+            } else {
+                // overlapping reference repeats the last bytes, must be copied byte by byte.
+                while (reflen--) {
+                    *out++ = *ref++;
+                }
             }
 
         } else {
@@ -93,4 +107,6 @@ void lzss_decode(flash_t src, uint16_t length, void* dst) {
         type_byte >>= 1;
         --type_bits;
     }
+
+    flash_stream_close();
 }
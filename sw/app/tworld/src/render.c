@@ -26,7 +26,9 @@
 #include <core/graphics.h>
 #include <core/sysui.h>
 #include <core/dialog.h>
+#include <core/framecache.h>
 #include <core/utils.h>
+#include <core/display.h>
 #include <sys/display.h>
 
 #include <string.h>
@@ -58,6 +60,19 @@ static const uint8_t CONTROL_BUTTONS[CONTROLS_COUNT] = {
 
 #define display_ystart_for_page(page) ((page) * DISPLAY_PAGE_HEIGHT)
 
+// Last row covered by the low timer overlay.
+#define LOW_TIMER_OVERLAY_BOTTOM 10
+
+// Game map state on the last frame, used to only refresh the map rows that changed.
+static struct {
+    bool valid;
+    grid_pos_t xstart;
+    grid_pos_t ystart;
+    uint8_t anim_variant;
+    // Bit field indicating which map rows in view have an animated bottom tile.
+    uint16_t animated_rows;
+} last_game_frame;
+
 static void set_3x5_font(void) {
     graphics_set_font(ASSET_FONT_3X5_BUILTIN);
 }
@@ -146,7 +161,6 @@ static void draw_game(void) {
     grid_pos_t ystart = get_camera_pos(curr_pos.y);
 
     disp_y_t y = 1;
-    const uint8_t xend = xstart + GAME_MAP_SIZE;
     uint8_t yend = ystart + GAME_MAP_SIZE;
 
     bool inventory_shown = game.flags & FLAG_INVENTORY_SHOWN;
@@ -176,16 +190,18 @@ static void draw_game(void) {
             break;
         }
 
-        disp_x_t x = 0;
-        for (grid_pos_t px = xstart; px < xend; ++px) {
+        tile_t tiles[GAME_MAP_SIZE];
+        actor_t actors0[GAME_MAP_SIZE];
+        actor_t actors1[GAME_MAP_SIZE];
+        for (uint8_t i = 0; i < GAME_MAP_SIZE; ++i) {
+            const grid_pos_t px = xstart + i;
             const position_t pos = {px, py};
-            const tile_t tile = tworld_get_bottom_tile(pos);
-            const actor_t actor0 = tworld_has_collided() && curr_pos.x == px && curr_pos.y == py
-                                   ? tworld.collided_actor : ACTOR_NONE;
-            const actor_t actor1 = tworld_get_top_tile(pos);
-            draw_game_tile(x, y, tile, actor0, actor1);
-            x += GAME_TILE_SIZE;
+            tiles[i] = tworld_get_bottom_tile(pos);
+            actors0[i] = tworld_has_collided() && curr_pos.x == px && curr_pos.y == py
+                         ? tworld.collided_actor : ACTOR_NONE;
+            actors1[i] = tworld_get_top_tile(pos);
         }
+        draw_game_row(y, tiles, actors0, actors1);
 
         y += GAME_TILE_SIZE;
     }
@@ -200,10 +216,16 @@ static void draw_game(void) {
 }
 
 /**
- * Draw the main menu screen.
+ * Draw the main menu screen. The menu image is restored from the frame cache once saved,
+ * which is much faster than decoding it again on every frame.
  */
 static void draw_main_menu(void) {
-    graphics_image_4bit_mixed(ASSET_IMAGE_MENU, 0, 0);
+    if (framecache_is_valid()) {
+        framecache_restore_page();
+    } else {
+        graphics_image_4bit_mixed(ASSET_IMAGE_MENU, 0, 0);
+        framecache_save_page();
+    }
 }
 
 /**
@@ -329,6 +351,62 @@ static void draw_levels_overlay(void) {
     }
 }
 
+/**
+ * Returns the thumbnail color for a grid position, with one shade per tile class.
+ * Hidden and invisible walls are drawn as floor to not give them away.
+ */
+static uint8_t get_thumbnail_color(const position_t pos) {
+    const entity_t entity = actor_get_entity(tworld_get_top_tile(pos));
+    if (entity == ENTITY_CHIP) {
+        return DISPLAY_COLOR_WHITE;
+    } else if (entity != ENTITY_NONE) {
+        return 12;
+    }
+
+    const tile_t tile = tworld_get_bottom_tile(pos);
+    if (tile == TILE_WALL || tile == TILE_WALL_BLUE_REAL || tile == TILE_WALL_BLUE_FAKE ||
+        tile == TILE_TOGGLE_WALL) {
+        return 9;
+    } else if (tile == TILE_CHIP || tile == TILE_EXIT) {
+        return 14;
+    } else if (tile == TILE_WATER || tile == TILE_FIRE || tile == TILE_BOMB) {
+        return 5;
+    } else if (tile_is_ice(tile) || tile_is_slide(tile)) {
+        return 3;
+    } else if (tile_is_lock(tile) || tile == TILE_SOCKET || tile_is_thin_wall(tile)) {
+        return 7;
+    } else if (tile == TILE_FLOOR || tile == TILE_WALL_HIDDEN || tile == TILE_WALL_INVISIBLE) {
+        return DISPLAY_COLOR_BLACK;
+    }
+    return 2;
+}
+
+/**
+ * Draw an overview of the loaded level at a position, with one pixel per tile.
+ * Only the grid rows on the current display page are drawn.
+ */
+static void draw_level_thumbnail(const disp_x_t x, const disp_y_t y) {
+    graphics_set_color(6);
+    graphics_rect(x - 1, y - 1, GRID_WIDTH + 2, GRID_HEIGHT + 2);
+
+    position_t pos;
+    for (pos.y = 0; pos.y < GRID_HEIGHT; ++pos.y) {
+        const disp_y_t py = y + pos.y;
+        if (py < sys_display_page_ystart) {
+            continue;
+        } else if (py > sys_display_page_yend) {
+            break;
+        }
+        for (pos.x = 0; pos.x < GRID_WIDTH; ++pos.x) {
+            const uint8_t color = get_thumbnail_color(pos);
+            if (color != DISPLAY_COLOR_BLACK) {
+                graphics_set_color(color);
+                graphics_pixel(x + pos.x, py);
+            }
+        }
+    }
+}
+
 /**
  * Draw the content for the level info dialog.
  */
@@ -336,31 +414,35 @@ static void draw_level_info_overlay(void) {
     char buf[4];
 
     // level title, centered on 1-2 lines
-    const flash_t title = level_get_title();
-    const uint8_t lines = find_text_line_count(title, 122);
-    const disp_y_t y = lines == 2 ? 38 : 43;
+    if (game.level_title_lines == 0) {
+        // the title is measured with the current font, so it's done when first drawn.
+        game.level_title_lines = find_text_line_count(game.level_title, 122);
+    }
+    const disp_y_t y = game.level_title_lines == 2 ? 20 : 25;
     graphics_set_color(DISPLAY_COLOR_WHITE);
-    draw_text_wrap(3, y, 122, 2, title, true);
+    draw_text_wrap(3, y, 122, 2, game.level_title, true);
 
     graphics_set_color(10);
     set_3x5_font();
-    graphics_text(22, 60, "CHIPS NEEDED");
-    graphics_text(30, 69, "TIME LIMIT");
-    graphics_text(34, 78, "BEST TIME");
+    graphics_text(22, 42, "CHIPS NEEDED");
+    graphics_text(30, 51, "TIME LIMIT");
+    graphics_text(34, 60, "BEST TIME");
 
     graphics_set_color(12);
-    graphics_text(46, 31, "LEVEL");
+    graphics_text(46, 13, "LEVEL");
     uint16_to_str_zero_pad(buf, (uint8_t) (game.current_level + 1));
-    graphics_text(70, 31, buf);
+    graphics_text(70, 13, buf);
 
     graphics_set_color(DISPLAY_COLOR_WHITE);
     set_7x7_font();
     uint16_to_str_zero_pad(buf, tworld.chips_left);
-    graphics_text(74, 59, buf);
+    graphics_text(74, 41, buf);
     format_time_left(buf, tworld.time_left);
-    graphics_text(74, 68, buf);
-    format_time_left(buf, get_best_level_time(game.current_level_pos));
-    graphics_text(74, 77, buf);
+    graphics_text(74, 50, buf);
+    format_time_left(buf, game.best_level_time);
+    graphics_text(74, 59, buf);
+
+    draw_level_thumbnail(48, 70);
 }
 
 /**
@@ -387,15 +469,14 @@ static void draw_level_complete_overlay(void) {
     graphics_text(32, 64, "PASSWORD");
 
     set_7x7_font();
-    char buf[5];
+    char buf[4];
     format_time_left(buf, tworld.time_left);
     graphics_set_color(DISPLAY_COLOR_WHITE);
     graphics_text(74, 42, buf);
-    format_time_left(buf, get_best_level_time(game.current_level_pos));
+    format_time_left(buf, game.best_level_time);
     graphics_text(74, 51, buf);
-    level_get_password(buf);
     graphics_set_color(10);
-    graphics_text(68, 63, buf);
+    graphics_text(68, 63, game.level_password);
 }
 
 /**
@@ -472,6 +553,109 @@ static void draw_help_overlay(void) {
     }
 }
 
+/**
+ * Returns true if a row of the game map has an animated bottom tile in view.
+ */
+static bool is_game_row_animated(const grid_pos_t xstart, const grid_pos_t py) {
+    for (grid_pos_t px = xstart; px < xstart + GAME_MAP_SIZE; ++px) {
+        const position_t pos = {px, py};
+        if (bottom_tile_is_animated(tworld_get_bottom_tile(pos))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool set_game_dirty_rows(void) {
+    if ((game.flags & FLAG_DIALOG_SHOWN) &&
+        (game.state == GAME_STATE_OPTIONS_PLAY || game.state == GAME_STATE_PAUSE)) {
+        // the game is paused behind the dialog, it's drawn once and then only the dialog
+        // is refreshed when it changes. Tile animations are also paused (see game_state_update).
+        last_game_frame.valid = false;
+        return dialog_set_dirty_rows();
+    }
+
+    const position_t curr_pos = tworld_get_current_position();
+    const grid_pos_t xstart = get_camera_pos(curr_pos.x);
+    const grid_pos_t ystart = get_camera_pos(curr_pos.y);
+    const uint8_t anim_variant = game.anim_state & BOTTOM_ANIMATION_DELAY;
+
+    // Only the map can be partially refreshed, when nothing else is shown over it.
+    // The map must also be at the same position as on the last frame, with the same layout.
+    const bool can_refresh_partially = game.state == GAME_STATE_PLAY &&
+                                       (game.flags & FLAG_GAME_STARTED) &&
+                                       !(game.flags & (FLAG_DIALOG_SHOWN | FLAG_INVENTORY_SHOWN));
+    const bool last_valid = last_game_frame.valid;
+    last_game_frame.valid = can_refresh_partially;
+    if (!can_refresh_partially || !last_valid ||
+        xstart != last_game_frame.xstart || ystart != last_game_frame.ystart) {
+        last_game_frame.xstart = xstart;
+        last_game_frame.ystart = ystart;
+        last_game_frame.anim_variant = anim_variant;
+        // animated rows are only needed on the next frame for a partial refresh.
+        uint16_t animated_rows = 0;
+        if (can_refresh_partially) {
+            for (uint8_t i = 0; i < GAME_MAP_SIZE; ++i) {
+                if (is_game_row_animated(xstart, ystart + i)) {
+                    animated_rows |= 1 << i;
+                }
+            }
+        }
+        last_game_frame.animated_rows = animated_rows;
+        tworld_clear_changed_rows();
+        return true;
+    }
+
+    // Find the range of map rows that changed. When animated tiles change variant, the rows
+    // containing them also change (this includes Chip swimming, which is only shown on water).
+    // Rows that changed are scanned again for animated tiles, others keep the last result.
+    const bool anim_changed = anim_variant != last_game_frame.anim_variant;
+    last_game_frame.anim_variant = anim_variant;
+    uint16_t animated_rows = last_game_frame.animated_rows;
+    disp_y_t ystart_dirty = DISPLAY_HEIGHT;
+    disp_y_t yend_dirty = 0;
+    disp_y_t y = 1;
+    for (uint8_t i = 0; i < GAME_MAP_SIZE; ++i) {
+        const grid_pos_t py = ystart + i;
+        const uint16_t row_mask = 1 << i;
+        bool row_dirty = false;
+        if (tworld_is_row_changed(py)) {
+            row_dirty = true;
+            if (is_game_row_animated(xstart, py)) {
+                animated_rows |= row_mask;
+            } else {
+                animated_rows &= ~row_mask;
+            }
+        } else if (anim_changed && (animated_rows & row_mask)) {
+            row_dirty = true;
+        }
+        if (row_dirty) {
+            if (ystart_dirty == DISPLAY_HEIGHT) {
+                ystart_dirty = y;
+            }
+            yend_dirty = y + GAME_TILE_SIZE - 1;
+        }
+        y += GAME_TILE_SIZE;
+    }
+    last_game_frame.animated_rows = animated_rows;
+    tworld_clear_changed_rows();
+
+    if (tworld.time_left <= LOW_TIMER_THRESHOLD) {
+        // low timer overlay is shown in the top right corner, always refresh it.
+        ystart_dirty = 0;
+        if (yend_dirty < LOW_TIMER_OVERLAY_BOTTOM) {
+            yend_dirty = LOW_TIMER_OVERLAY_BOTTOM;
+        }
+    }
+
+    if (ystart_dirty == DISPLAY_HEIGHT) {
+        // nothing changed on the display.
+        return false;
+    }
+    display_set_dirty_rows(ystart_dirty, yend_dirty);
+    return true;
+}
+
 void draw(void) {
     game_state_t s = game.state;
     if (s >= GAME_SSEP_LEVEL_BG) {
@@ -16,22 +16,19 @@
 
 #include "render_utils.h"
 #include "render.h"
-#include "defs.h"
 #include "assets.h"
 #include "tworld_level.h"
 #include "game.h"
 
+#include <core/defs.h>
 #include <core/trace.h>
+#include <core/math.h>
 #include <sys/display.h>
 
 /**
- * Considering there's 4 bytes needed to transfer the command and address to the flash,
- * different buffer size result in the following efficiency:
- * - 8: 66.7%
- * - 16: 79.7%
- * - 24: 84.5% (chosen size for buffer)
- * - 32: 87.8%
- * No extra data is ever read for lines not drawn on current page.
+ * Number of tile rows read from flash at once. Tile data is read with a flash stream,
+ * so the command and address are only sent once per tile and the buffer size doesn't
+ * affect the transfer efficiency. No extra data is ever read for lines not drawn on current page.
  */
 #define TILE_BUFFER_SIZE 3
 
@@ -41,6 +38,18 @@
 #define TOP_TILE_ROW_SIZE (uint8_t) (TOP_TILE_COLS + 2)  // 2 extra bytes for alpha flags
 #define BOTTOM_TILE_ROW_SIZE BOTTOM_TILE_COLS
 
+// Bottom tile rows in which the middle blocks all have the same value are stored as
+// a span row: the first block, the value of middle blocks, and the last block.
+#define BOTTOM_TILE_SPAN_ROW_SIZE 3
+// The mask of span rows of each bottom tile (bit N being set for row N) is stored in
+// internal memory, indexed like the tiles, so that it doesn't have to be read from flash.
+
+// The first row with opaque pixels and the number of rows up to the last one of each top tile
+// are stored in internal memory in the low and high nibbles of a byte, indexed like the tiles.
+// Fully transparent rows above and below the actor are neither read nor drawn.
+#define TOP_TILE_FIRST_ROW_MASK 0xf
+#define TOP_TILE_ROW_COUNT_SHIFT 4
+
 #define TOP_TILE_BUFFER_SIZE (TILE_BUFFER_SIZE * TOP_TILE_ROW_SIZE)
 #define BOTTOM_TILE_BUFFER_SIZE (TILE_BUFFER_SIZE * BOTTOM_TILE_ROW_SIZE)
 
@@ -70,8 +79,9 @@ void uint16_to_str_zero_pad(char buf[static 4], uint16_t n) {
 
     char* ptr = &buf[3];
     do {
-        *(--ptr) = (char) (n % 10 + '0');
-        n /= 10;
+        const uint16_t q = math_div10_u16(n);
+        *(--ptr) = (char) (n - q * 10 + '0');
+        n = q;
     } while (n);
 }
 
@@ -110,6 +120,8 @@ grid_pos_t get_camera_pos(const grid_pos_t pos) {
  * - Tile size fixed to 16x14.
  * - Extra data is never read from flash.
  * - No header and no indexing needed.
+ * - Bottom tile rows with uniform middle blocks (most rows of floor and wall tiles) are stored
+ *   in 3 bytes instead of 8 and filled with a store loop.
  * - -O3 optimization instead of -Os
  *
  * Worst case performance analysis (with 100% tiles with a non-block actor):
@@ -125,6 +137,19 @@ grid_pos_t get_camera_pos(const grid_pos_t pos) {
  * - 140k cycles: send buffer to the display
  * - 25k cycles: misc
  * TOTAL: 443k cycles, ~18 FPS on a 8M cycles budget.
+ *
+ * Caching the most used bottom tiles in RAM was considered, since floor and wall tiles make up
+ * most of the map. However each decoded tile takes 112 bytes, and nothing can be freed for it
+ * while playing: both layers are the live level state (not a decoding buffer), the LZSS buffer is
+ * on the stack during level load only, and the display buffer shares memory with the link and
+ * teleporter caches. With the 3.9 kB available to the app, there's no room for even a few tiles
+ * without shrinking the display page, which would cost more in per-page overhead than it saves.
+ * Refreshing only the changed map rows (see `set_game_dirty_rows`) reduces the reads instead.
+ *
+ * Rows fully covered by an opaque top tile can't skip the bottom tile read, since the top tile is
+ * only 12 pixels wide and the first and last pixels of the bottom tile are always visible.
+ * Only a few top tile rows are fully opaque anyway. Instead, the transparent rows above and below
+ * each actor (about 13% of top tile rows) are skipped.
  */
 
 static void draw_checks(const disp_x_t x, const disp_y_t y) {
@@ -139,9 +164,16 @@ static void draw_checks(const disp_x_t x, const disp_y_t y) {
 #endif
 }
 
+bool bottom_tile_is_animated(const tile_t tile) {
+    return ASSET_TILESET_MAP_BOTTOM[tile] !=
+           ASSET_TILESET_MAP_BOTTOM[(uint8_t) (tile + ASSET_TILESET_MAP_BOTTOM_SIZE / BOTTOM_TILE_VARIANTS)];
+}
+
 // noinline to avoid inlining as part of -O3 optimization, which would give little benefit.
 __attribute__((noinline))
-AVR_OPTIMIZE void draw_bottom_tile(const disp_x_t x, const disp_y_t y, const tile_t tile) {
+AVR_OPTIMIZE(draw_bottom_tile) void draw_bottom_tile(
+        const disp_x_t x, const disp_y_t y, const tile_t tile) {
+    trace_spi_tag("draw_bottom_tile");
     draw_checks(x, y);
 
     // Bottom tiles can be animated by cycling through 2 variants, changing every 4 ticks.
@@ -159,57 +191,82 @@ AVR_OPTIMIZE void draw_bottom_tile(const disp_x_t x, const disp_y_t y, const til
     flash_t addr = asset_tileset_bottom(index);
     uint8_t buf[BOTTOM_TILE_BUFFER_SIZE];
     uint8_t* buf_ptr;
+    uint8_t fill_rows;
+
+    uint16_t span_rows = ASSET_TILESET_SPAN_BOTTOM[index * 2] |
+                         ASSET_TILESET_SPAN_BOTTOM[index * 2 + 1] << 8;
 
     // limit Y range to current display page
     int8_t ystart = (int8_t) (y - sys_display_page_ystart);
     disp_y_t yend = ystart + GAME_TILE_SIZE;
     if (ystart < 0) {
-        addr += (uint8_t) (BOTTOM_TILE_ROW_SIZE * (uint8_t) -ystart);
-        ystart = 0;
+        // skip rows above the page, the stream is opened after them to avoid reading them.
+        for (; ystart < 0; ++ystart) {
+            addr += (span_rows & 1) ? BOTTOM_TILE_SPAN_ROW_SIZE : BOTTOM_TILE_ROW_SIZE;
+            span_rows >>= 1;
+        }
     }
+    flash_stream_open(addr);
     if (yend > sys_display_curr_page_height) {
         yend = sys_display_curr_page_height;
     }
 
+    // 2 cycles per pixel, see below.
+    trace_cycles((yend - ystart) * BOTTOM_TILE_ROW_SIZE * 2 * 2);
+
     uint8_t* disp_buf = sys_display_buffer_at(x, ystart);
     disp_y_t py = ystart;
     goto start;
 
     for (; py < yend; ++py) {
-        if (buf_ptr == buf + BOTTOM_TILE_BUFFER_SIZE)
+        if (--fill_rows == 0)
 start:
             {
                 // Fill buffer for number of rows left (or full buffer).
-                // Each row in the buffer is 8 bytes and encodes the value for 2 pixels.
-                uint8_t fill_rows = yend - py;
-                uint8_t fill_bytes;
+                // Each row in the buffer is 8 bytes and encodes the value for 2 pixels,
+                // or 3 bytes for span rows.
+                fill_rows = yend - py;
                 if (fill_rows > TILE_BUFFER_SIZE) {
-                    fill_bytes = BOTTOM_TILE_BUFFER_SIZE;
-                } else {
-                    fill_bytes = fill_rows * BOTTOM_TILE_ROW_SIZE;
+                    fill_rows = TILE_BUFFER_SIZE;
+                }
+                uint8_t fill_bytes = 0;
+                uint16_t mask = span_rows;
+                for (uint8_t i = 0; i < fill_rows; ++i) {
+                    fill_bytes += (mask & 1) ? BOTTOM_TILE_SPAN_ROW_SIZE : BOTTOM_TILE_ROW_SIZE;
+                    mask >>= 1;
                 }
-                flash_read(addr, fill_bytes, buf);
-                addr += sizeof buf;
+                flash_stream_read(fill_bytes, buf);
                 buf_ptr = buf;
             }
 
         // Draw each pixel in the row.
-        // Fully unrolled, this loop takes 2 cycles per pixel.
+        // Fully unrolled, this loop takes 2 cycles per pixel, or less for span rows.
         // The tile data always has 0 on the first and last nibbles. The first block (of 2 pixels)
         // can be ORed with existing display data, and this isn't needed for the last block as we
         // assume the tiles will be drawn from left to right. Other blocks can be written directly.
         *disp_buf++ |= *buf_ptr++;
-        for (uint8_t i = 0; i < (BOTTOM_TILE_ROW_SIZE - 1); ++i) {
+        if (span_rows & 1) {
+            const uint8_t block = *buf_ptr++;
+            for (uint8_t i = 0; i < (BOTTOM_TILE_ROW_SIZE - 2); ++i) {
+                *disp_buf++ = block;
+            }
             *disp_buf++ = *buf_ptr++;
+        } else {
+            for (uint8_t i = 0; i < (BOTTOM_TILE_ROW_SIZE - 1); ++i) {
+                *disp_buf++ = *buf_ptr++;
+            }
         }
+        span_rows >>= 1;
 
         disp_buf += DISPLAY_NUM_COLS - BOTTOM_TILE_COLS;
     }
+    flash_stream_close();
 }
 
 // noinline to avoid inlining as part of -O3 optimization, which would give little benefit.
 __attribute__((noinline))
-AVR_OPTIMIZE void draw_top_tile(disp_x_t x, disp_y_t y, actor_t actor) {
+AVR_OPTIMIZE(draw_top_tile) void draw_top_tile(disp_x_t x, disp_y_t y, actor_t actor) {
+    trace_spi_tag("draw_top_tile");
     draw_checks(x, y);
 
     x += 2;
@@ -222,13 +279,15 @@ AVR_OPTIMIZE void draw_top_tile(disp_x_t x, disp_y_t y, actor_t actor) {
     }
 #endif
 
-    flash_t addr = asset_tileset_top(index);
+    const uint8_t rows = ASSET_TILESET_ROWS_TOP[index];
+    const uint8_t first_row = rows & TOP_TILE_FIRST_ROW_MASK;
+    flash_t addr = asset_tileset_top(index) + (uint8_t) (TOP_TILE_ROW_SIZE * first_row);
     uint8_t buf[TOP_TILE_BUFFER_SIZE];
     uint8_t* buf_ptr;
 
-    // limit Y range to current display page
-    int8_t ystart = (int8_t) (y - sys_display_page_ystart);
-    disp_y_t yend = ystart + GAME_TILE_SIZE;
+    // limit Y range to the tile rows with opaque pixels and to the current display page.
+    int16_t ystart = (int16_t) (y - sys_display_page_ystart) + first_row;
+    int16_t yend = ystart + (rows >> TOP_TILE_ROW_COUNT_SHIFT);
     if (ystart < 0) {
         addr += (uint8_t) (TOP_TILE_ROW_SIZE * (uint8_t) -ystart);
         ystart = 0;
@@ -236,9 +295,17 @@ AVR_OPTIMIZE void draw_top_tile(disp_x_t x, disp_y_t y, actor_t actor) {
     if (yend > sys_display_curr_page_height) {
         yend = sys_display_curr_page_height;
     }
+    if (ystart >= yend) {
+        // no rows with opaque pixels on this page.
+        return;
+    }
 
-    uint8_t* disp_buf = sys_display_buffer_at(x, ystart);
-    disp_y_t py = ystart;
+    // about 10 cycles per pixel, see below.
+    trace_cycles((yend - ystart) * TOP_TILE_COLS * 2 * 10);
+
+    uint8_t* disp_buf = sys_display_buffer_at(x, (disp_y_t) ystart);
+    disp_y_t py = (disp_y_t) ystart;
+    flash_stream_open(addr);
     goto start;
 
     for (; py < yend; ++py) {
@@ -257,8 +324,7 @@ start:
                 } else {
                     fill_bytes = fill_rows * TOP_TILE_ROW_SIZE;
                 }
-                flash_read(addr, fill_bytes, buf);
-                addr += sizeof buf;
+                flash_stream_read(fill_bytes, buf);
                 buf_ptr = buf;
             }
 
@@ -286,33 +352,81 @@ start:
 
         disp_buf += DISPLAY_NUM_COLS - TOP_TILE_COLS;
     }
+    flash_stream_close();
 }
 
-AVR_OPTIMIZE void draw_game_tile(const disp_x_t x, const disp_y_t y, const tile_t tile,
-                                 actor_t actor0, const actor_t actor1) {
-    tile_t bottom = tile;
-    actor_t top = actor1;
-
-    if (actor_is_block(actor1)) {
-        bottom = TILE_BLOCK;
-        top = ACTOR_NONE;
-        actor0 = ACTOR_NONE;  // hidden by block
-    } else if (actor_get_entity(actor1) == ENTITY_CHIP) {
-        if (tworld.end_cause != END_CAUSE_NONE && tworld.end_cause <= END_CAUSE_BOMBED) {
-            bottom = tile_make_dead_chip(tworld.end_cause);
-            top = ACTOR_NONE;
-        } else if (bottom == TILE_WATER) {
-            bottom = tile_make_swimming_chip(actor1);
-            top = ACTOR_NONE;
+/**
+ * Copy the bottom tile drawn at a position to the position of the next tile on the right.
+ * No top tile must have been drawn on the copied tile yet.
+ */
+static AVR_OPTIMIZE(copy_bottom_tile) void copy_bottom_tile(const disp_x_t x, const disp_y_t y) {
+    draw_checks(x, y);
+
+    // limit Y range to current display page
+    int8_t ystart = (int8_t) (y - sys_display_page_ystart);
+    disp_y_t yend = ystart + GAME_TILE_SIZE;
+    if (ystart < 0) {
+        ystart = 0;
+    }
+    if (yend > sys_display_curr_page_height) {
+        yend = sys_display_curr_page_height;
+    }
+
+    uint8_t* disp_buf = sys_display_buffer_at(x, ystart);
+    for (disp_y_t py = ystart; py < yend; ++py) {
+        // The next tile starts on the last block of this tile, which was written directly.
+        // The first block is shared with the previous tile: its high nibble (second pixel)
+        // is from this tile and its low nibble is always 0 in the tile data (see draw_bottom_tile).
+        const uint8_t last = disp_buf[BOTTOM_TILE_COLS - 1];
+        disp_buf[BOTTOM_TILE_COLS - 1] = last | (disp_buf[0] & 0xf0);
+        for (uint8_t i = 1; i < BOTTOM_TILE_COLS - 1; ++i) {
+            disp_buf[BOTTOM_TILE_COLS - 1 + i] = disp_buf[i];
         }
+        disp_buf[2 * BOTTOM_TILE_COLS - 2] = last;
+        disp_buf += DISPLAY_NUM_COLS;
     }
+}
 
-    draw_bottom_tile(x, y, bottom);
-    if (actor0 != ACTOR_NONE) {
-        draw_top_tile(x, y, actor0);
+AVR_OPTIMIZE(draw_game_row) void draw_game_row(const disp_y_t y,
+                                              tile_t tiles[static GAME_MAP_SIZE],
+                                              actor_t actors0[static GAME_MAP_SIZE],
+                                              actor_t actors1[static GAME_MAP_SIZE]) {
+    // Bottom tiles are all drawn first, so that a run of the same bottom tile can be copied
+    // from the previous tile in the display buffer instead of being read again from flash.
+    disp_x_t x = 0;
+    for (uint8_t i = 0; i < GAME_MAP_SIZE; ++i) {
+        const actor_t actor1 = actors1[i];
+        if (actor_is_block(actor1)) {
+            tiles[i] = TILE_BLOCK;
+            actors1[i] = ACTOR_NONE;
+            actors0[i] = ACTOR_NONE;  // hidden by block
+        } else if (actor_get_entity(actor1) == ENTITY_CHIP) {
+            if (tworld.end_cause != END_CAUSE_NONE && tworld.end_cause <= END_CAUSE_BOMBED) {
+                tiles[i] = tile_make_dead_chip(tworld.end_cause);
+                actors1[i] = ACTOR_NONE;
+            } else if (tiles[i] == TILE_WATER) {
+                tiles[i] = tile_make_swimming_chip(actor1);
+                actors1[i] = ACTOR_NONE;
+            }
+        }
+
+        if (i > 0 && tiles[i] == tiles[i - 1]) {
+            copy_bottom_tile(x - GAME_TILE_SIZE, y);
+        } else {
+            draw_bottom_tile(x, y, tiles[i]);
+        }
+        x += GAME_TILE_SIZE;
     }
-    if (actor_get_entity(top) != ACTOR_NONE) {
-        draw_top_tile(x, y, top);
+
+    x = 0;
+    for (uint8_t i = 0; i < GAME_MAP_SIZE; ++i) {
+        if (actors0[i] != ACTOR_NONE) {
+            draw_top_tile(x, y, actors0[i]);
+        }
+        if (actor_get_entity(actors1[i]) != ACTOR_NONE) {
+            draw_top_tile(x, y, actors1[i]);
+        }
+        x += GAME_TILE_SIZE;
     }
 }
 
@@ -394,24 +508,58 @@ start:
     return result;
 }
 
+// Maximum number of lines in the text layout cache.
+#define TEXT_LAYOUT_MAX_LINES HINT_LINES_PER_SCREEN
+
+// Layout of the last text drawn with `draw_text_wrap`. The text is drawn on every page
+// with the same layout, so lines are only measured on the first page drawing them.
+static struct {
+    flash_t text;
+    uint8_t width;
+    uint8_t lines;
+    line_width_result_t results[TEXT_LAYOUT_MAX_LINES];
+} text_layout;
+
 void draw_text_wrap(const disp_x_t x, disp_y_t y, const uint8_t width,
                     const uint8_t max_lines, flash_t text, const bool centered) {
+    if (text_layout.text != text || text_layout.width != width) {
+        text_layout.text = text;
+        text_layout.width = width;
+        text_layout.lines = 0;
+    }
+
     graphics_set_font(ASSET_FONT_5X7);
     char buf[24];
     for (uint8_t i = 0; i < max_lines; ++i) {
-        const line_width_result_t result = find_text_line_width(text, width);
+        if (y > sys_display_page_yend) {
+            // this line and the next ones are after the end of page.
+            break;
+        }
 
-        text += result.leading_spaces;
-        flash_read(text, result.width, buf);
-        buf[result.width] = '\0';
-        text += result.width;
+        line_width_result_t result;
+        if (i < text_layout.lines) {
+            result = text_layout.results[i];
+        } else {
+            result = find_text_line_width(text, width);
+            if (i < TEXT_LAYOUT_MAX_LINES) {
+                text_layout.results[i] = result;
+                text_layout.lines = i + 1;
+            }
+        }
 
-        disp_x_t px = x;
-        if (centered) {
-            const uint8_t line_width = (uint8_t) (result.width * (TEXT_UTILS_WIDTH + 1)) - 1;
-            px += (uint8_t) (width - line_width) / 2;
+        text += result.leading_spaces;
+        if (y + TEXT_UTILS_HEIGHT > sys_display_page_ystart) {
+            flash_read(text, result.width, buf);
+            buf[result.width] = '\0';
+
+            disp_x_t px = x;
+            if (centered) {
+                const uint8_t line_width = (uint8_t) (result.width * (TEXT_UTILS_WIDTH + 1)) - 1;
+                px += (uint8_t) (width - line_width) / 2;
+            }
+            graphics_text((int8_t) px, (int8_t) y, buf);
         }
-        graphics_text((int8_t) px, (int8_t) y, buf);
+        text += result.width;
 
         if (result.end_of_text) {
             break;
@@ -421,12 +569,33 @@ void draw_text_wrap(const disp_x_t x, disp_y_t y, const uint8_t width,
     }
 }
 
+// Last line start found by `find_text_line_start`. The same line is requested on every page
+// and every frame while the text is shown, and scrolling goes one line at a time, so wrapping
+// can resume from there instead of starting again from the start of the text.
+static struct {
+    flash_t text;
+    flash_t start;
+    uint8_t width;
+    uint8_t line;
+} last_line_start;
+
 flash_t find_text_line_start(flash_t text, uint8_t width, uint8_t line) {
+    uint8_t i = 0;
+    const flash_t start = text;
+    if (last_line_start.text == text && last_line_start.width == width &&
+        last_line_start.line <= line) {
+        text = last_line_start.start;
+        i = last_line_start.line;
+    }
     line_width_result_t result;
-    for (uint8_t i = 0; i < line; ++i) {
+    for (; i < line; ++i) {
         result = find_text_line_width(text, width);
         text += result.width + result.leading_spaces;
     }
+    last_line_start.text = start;
+    last_line_start.start = text;
+    last_line_start.width = width;
+    last_line_start.line = line;
     return text;
 }
 
@@ -21,6 +21,7 @@
 #include "music.h"
 
 #include <core/eeprom.h>
+#include <core/fast_settings.h>
 #include <core/dialog.h>
 #include <core/trace.h>
 
@@ -34,9 +35,14 @@
 
 #define EEPROM_GUARD_BYTE 0x43
 
+// options are also kept in fast settings, so that changing them doesn't need an EEPROM write.
+#define FAST_SETTINGS_SAVE_SIZE (1 + sizeof(game.options))
+#define FAST_SETTINGS_GUARD_BYTE 0x43
+
 #define save_time_block_address(pos) (SAVE_TIME_POS + (pos) / 4 * 5)
 
-static SHARED_DISP_BUF uint8_t save_buf[255];
+// Buffer for EEPROM data, large enough to hold all level times at once.
+static SHARED_DISP_BUF uint8_t save_buf[SAVE_TIME_SIZE];
 
 static void save_to_eeprom(void) {
     uint8_t* buf = save_buf;
@@ -46,13 +52,30 @@ static void save_to_eeprom(void) {
     memcpy(buf, &game.options, sizeof game.options);
     //buf += sizeof game.options;
 
-    eeprom_write(0, EEPROM_SAVE_SIZE, save_buf);
+    eeprom_write_changed(0, EEPROM_SAVE_SIZE, save_buf);
 
 #ifdef SIMULATION
     sim_eeprom_save();
 #endif
 }
 
+static void load_fast_settings(void) {
+    uint8_t buf[FAST_SETTINGS_SAVE_SIZE];
+    fast_settings_read(0, sizeof buf, buf);
+    if (buf[0] != FAST_SETTINGS_GUARD_BYTE) {
+        // options were never saved to fast settings, keep those from EEPROM.
+        return;
+    }
+    memcpy(&game.options, &buf[1], sizeof game.options);
+}
+
+static void save_fast_settings(void) {
+    uint8_t buf[FAST_SETTINGS_SAVE_SIZE];
+    buf[0] = FAST_SETTINGS_GUARD_BYTE;
+    memcpy(&buf[1], &game.options, sizeof game.options);
+    fast_settings_write(0, sizeof buf, buf);
+}
+
 static void set_default_options(void) {
     game.options = (game_options_t) {
             .features = GAME_FEATURE_MUSIC | GAME_FEATURE_SOUND_EFFECTS,
@@ -65,7 +88,7 @@ static void set_default_options(void) {
     uint16_t size = SAVE_TIME_SIZE;
     memset(save_buf, 0xff, sizeof save_buf);
     while (size) {
-        uint8_t block_size = sizeof save_buf;
+        uint8_t block_size = UINT8_MAX;
         if (block_size > size) {
             block_size = size;
         }
@@ -91,11 +114,12 @@ void load_from_eeprom(void) {
     // if first launch, guard byte isn't be set: set defaults, eeprom was never saved.
     if (*buf++ != EEPROM_GUARD_BYTE) {
         set_default_options();
-        return;
+    } else {
+        memcpy(&game.options, buf, sizeof game.options);
+        //buf += sizeof game.options;
     }
 
-    memcpy(&game.options, buf, sizeof game.options);
-    //buf += sizeof game.options;
+    load_fast_settings();
 }
 
 void save_dialog_options(void) {
@@ -116,7 +140,7 @@ void save_dialog_options(void) {
 
     // contrast, volume and music enabled were already changed during preview
 
-    save_to_eeprom();
+    save_fast_settings();
 }
 
 void update_display_contrast(uint8_t value) {
@@ -152,15 +176,21 @@ struct time_block {
     uint16_t time3 : 10;
 } PACK_STRUCT;
 
-static void read_level_time_block(eeprom_t addr, uint16_t times[4]) {
+static void decode_level_time_block(const struct time_block* block_ptr, uint16_t times[4]) {
     struct time_block block;
-    eeprom_read(addr, sizeof block, &block);
+    memcpy(&block, block_ptr, sizeof block);
     times[0] = block.time0;
     times[1] = block.time1;
     times[2] = block.time2;
     times[3] = block.time3;
 }
 
+static void read_level_time_block(eeprom_t addr, uint16_t times[4]) {
+    struct time_block block;
+    eeprom_read(addr, sizeof block, &block);
+    decode_level_time_block(&block, times);
+}
+
 time_left_t get_best_level_time(uint16_t pos) {
     const eeprom_t addr = save_time_block_address(pos);
     uint16_t times[4];
@@ -193,8 +223,9 @@ void set_best_level_time(void) {
     }
 
     // Save new time to EEPROM. Write the whole block, it's easier.
+    // The write is queued to avoid stalling the game, so the block must outlive this call.
+    static struct time_block block;
     const eeprom_t addr = save_time_block_address(pos);
-    struct time_block block;
     eeprom_read(addr, sizeof block, &block);
     switch (pos % 4) {
         case 0:
@@ -210,17 +241,22 @@ void set_best_level_time(void) {
             block.time3 = new_time;
             break;
     }
-    eeprom_write(addr, sizeof block, &block);
+    eeprom_write_async(addr, sizeof block, &block);
 
 #ifdef SIMULATION
     sim_eeprom_save();
 #endif
 }
 
+void read_level_times(void) {
+    eeprom_read(SAVE_TIME_POS, SAVE_TIME_SIZE, save_buf);
+}
+
 void fill_completed_levels_array(uint16_t pos, level_pack_info_t *info) {
     info->last_unlocked = 0;
     uint8_t *arr = info->completed_array - 1;
-    eeprom_t addr = save_time_block_address(pos);
+    const struct time_block* block = (const struct time_block*)
+            &save_buf[save_time_block_address(pos) - SAVE_TIME_POS];
     uint16_t times[4];
     uint8_t bit = 0;
     uint8_t mask = 1;
@@ -231,8 +267,8 @@ void fill_completed_levels_array(uint16_t pos, level_pack_info_t *info) {
     for (; i < info->total_levels; ++i) {
         if (block_pos == 0) {
 start:
-            read_level_time_block(addr, times);
-            addr += 5;
+            decode_level_time_block(block, times);
+            ++block;
         }
         if (bit == 0) {
             *(++arr) = 0;
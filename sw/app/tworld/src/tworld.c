@@ -16,8 +16,9 @@
 
 #include "tworld.h"
 #include "tworld_level.h"
-#include "defs.h"
 
+#include <core/defs.h>
+#include <core/flash.h>
 #include <core/trace.h>
 #include <core/random.h>
 #include <core/time.h>
@@ -32,9 +33,34 @@
 #define tworld_assert(cond, ...)
 #endif //RUNTIME_CHECKS
 
+#ifdef TWORLD_PROFILE
+
+#include <time.h>
+
+tworld_profile_t tworld_profile;
+
+static uint64_t profile_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#define profile_count(counter) (++tworld_profile.counter)
+#define profile_phase(phase, call) do { \
+        const uint64_t start = profile_time_ns(); \
+        call; \
+        tworld_profile.phase_ns[phase] += profile_time_ns() - start; \
+    } while (0)
+#else
+#define profile_count(counter)
+#define profile_phase(phase, call) call
+#endif //TWORLD_PROFILE
+
 #define CHIP_REST_DIRECTION DIR_SOUTH
 // Number of game ticks before Chip moves to rest position.
 #define CHIP_REST_TICKS 15
+// Number of positions read at once from the actor list.
+#define ACTORS_READ_SIZE 8
 
 enum {
     // Indicates toggle floor/wall (=0x1, this is important).
@@ -51,11 +77,6 @@ enum {
     FLAG_CHIP_STUCK = 1 << 5,
 };
 
-enum {
-    // Indicates that the grid will be scanned for teleporters and no list will be prebuilt.
-    LEVEL_FLAG_SCAN_TELEPORTERS = 1 << 0,
-};
-
 // Temporary extra state used to indicate that the actor has died and it's tile
 // Should be replaced by an animation tile.
 // Note: (ACTOR_STATE_DIED & ACTOR_STATE_MASK) == ACTOR_STATE_HIDDEN
@@ -79,9 +100,13 @@ typedef struct {
     direction_t direction;
 } moving_actor_t;
 
+#ifdef TWORLD_CONTEXT
+__thread tworld_ctx_t* tworld_ctx;
+#else
 SHARED_DISP_BUF links_t trap_links;
 SHARED_DISP_BUF links_t cloner_links;
 SHARED_DISP_BUF teleporters_t teleporters;
+#endif
 
 static direction_mask_t THIN_WALL_DIR_FROM[] = {
         DIR_NORTH_MASK,  // thin wall north
@@ -150,7 +175,7 @@ enum {
     CM_PUSH_BLOCKS_ALL = CM_PUSH_BLOCKS | CM_PUSH_BLOCKS_NOW
 };
 
-#define chip_actor() tworld.actors[0]
+#define chip_actor() get_actor(0)
 
 #define CHIP_NEW_POS_NONE 0xff
 
@@ -158,6 +183,26 @@ enum {
 #define WALKER_TURN 0xfe
 #define BLOB_TURN 0xfd
 
+// Turns relative to the current direction, direction values are counter-clockwise.
+#define TURN_FORWARD 0
+#define TURN_LEFT 1
+#define TURN_BACK 2
+#define TURN_RIGHT 3
+
+// Move choices of monsters in order of preference, indexed by entity from bug to walker.
+// Teeth go towards Chip instead and are handled separately.
+static const uint8_t MONSTER_TURNS[][4] = {
+        {TURN_LEFT, TURN_FORWARD, TURN_RIGHT, TURN_BACK},  // bug
+        {TURN_RIGHT, TURN_FORWARD, TURN_LEFT, TURN_BACK},  // paramecium
+        {TURN_FORWARD, TURN_LEFT, TURN_RIGHT, TURN_BACK},  // glider
+        {TURN_FORWARD, TURN_RIGHT, TURN_LEFT, TURN_BACK},  // fireball
+        {TURN_FORWARD, TURN_BACK, DIR_NONE, DIR_NONE},  // ball
+        {BLOB_TURN, DIR_NONE, DIR_NONE, DIR_NONE},  // blob
+        {TURN_FORWARD, DIR_NONE, DIR_NONE, DIR_NONE},  // tank
+        {TURN_FORWARD, DIR_NONE, DIR_NONE, DIR_NONE},  // tank reversed
+        {TURN_FORWARD, WALKER_TURN, DIR_NONE, DIR_NONE},  // walker
+};
+
 // ============== Testing functions ====================
 
 #ifdef TESTING
@@ -168,15 +213,26 @@ enum {
 
 // ============== All utility functions ====================
 
+#define nibble_swap(x) ((uint8_t) ((x) >> 4 | (x) << 4))
+
+#ifdef TWORLD_UNPACKED_LAYERS
+
+static uint8_t get_tile_in_tile_block(const position_t pos, const uint8_t* layer) {
+    profile_count(get_tile_calls);
+    return layer[pos.y * GRID_WIDTH + pos.x];
+}
+
+#else
+
 // there are 4 tiles per block of 3 bytes in the layer data arrays
 #define TILES_PER_BLOCK 4
 
-#define nibble_swap(x) ((uint8_t) ((x) >> 4 | (x) << 4))
-
-static AVR_OPTIMIZE uint8_t get_tile_in_tile_block(const position_t pos, const uint8_t* layer) {
+static AVR_OPTIMIZE(get_tile_in_tile_block) uint8_t get_tile_in_tile_block(
+        const position_t pos, const uint8_t* layer) {
     // note: this function was hand optimized to produce the best assembly output,
     // since it may be called a several thousand times per second.
     // execution time starting from get_x_tile: between 35 and 42 cycles.
+    profile_count(get_tile_calls);
     const uint8_t* block = &layer[(uint8_t) ((pos.y << 3) + (pos.x >> 2)) * 3];
     switch (pos.x % TILES_PER_BLOCK) {
         case 0:
@@ -195,6 +251,8 @@ static AVR_OPTIMIZE uint8_t get_tile_in_tile_block(const position_t pos, const u
     return 0;
 }
 
+#endif //TWORLD_UNPACKED_LAYERS
+
 /** Returns the tile on the bottom layer at a position. */
 static tile_t get_bottom_tile(const position_t pos) {
     return get_tile_in_tile_block(pos, tworld.bottom_layer);
@@ -205,7 +263,15 @@ static actor_t get_top_tile(const position_t pos) {
     return get_tile_in_tile_block(pos, tworld.top_layer);
 }
 
-static AVR_OPTIMIZE void set_tile_in_tile_block(
+#ifdef TWORLD_UNPACKED_LAYERS
+
+static void set_tile_in_tile_block(const position_t pos, const uint8_t value, uint8_t* layer) {
+    layer[pos.y * GRID_WIDTH + pos.x] = value;
+}
+
+#else
+
+static AVR_OPTIMIZE(set_tile_in_tile_block) void set_tile_in_tile_block(
         const position_t pos, const uint8_t value, uint8_t* layer) {
     // execution time starting from set_x_tile: between 38 and 48 cycles.
     uint8_t* block = &layer[(uint8_t) ((pos.y << 3) + (pos.x >> 2)) * 3];
@@ -237,14 +303,55 @@ static AVR_OPTIMIZE void set_tile_in_tile_block(
     }
 }
 
-/** Set the actor on the bottom layer at a position. */
+#endif //TWORLD_UNPACKED_LAYERS
+
+static void mark_row_changed(const grid_pos_t y) {
+    tworld.changed_rows[y / 8] |= 1 << (y % 8);
+}
+
+#ifdef TWORLD_WALL_CACHE
+
+/** Update the monster acting wall bit for a tile on the bottom layer. */
+static void update_wall_cache(const position_t pos, const tile_t tile) {
+    const uint16_t idx = pos.y * GRID_WIDTH + pos.x;
+    const uint8_t bit = 1 << (idx % 8);
+    if (tile_is_monster_acting_wall(tile)) {
+        tworld.monster_walls[idx / 8] |= bit;
+    } else {
+        tworld.monster_walls[idx / 8] &= ~bit;
+    }
+}
+
+/** Returns true if the tile on the bottom layer at a position is a monster acting wall. */
+static bool is_monster_wall(const position_t pos) {
+    const uint16_t idx = pos.y * GRID_WIDTH + pos.x;
+    return (tworld.monster_walls[idx / 8] & (1 << (idx % 8))) != 0;
+}
+
+static void build_wall_cache(void) {
+    for (grid_pos_t y = 0; y < GRID_HEIGHT; ++y) {
+        for (grid_pos_t x = 0; x < GRID_WIDTH; ++x) {
+            const position_t pos = {x, y};
+            update_wall_cache(pos, get_bottom_tile(pos));
+        }
+    }
+}
+
+#endif //TWORLD_WALL_CACHE
+
+/** Set the tile on the bottom layer at a position. */
 static void set_bottom_tile(const position_t pos, const tile_t tile) {
     set_tile_in_tile_block(pos, tile, tworld.bottom_layer);
+#ifdef TWORLD_WALL_CACHE
+    update_wall_cache(pos, tile);
+#endif
+    mark_row_changed(pos.y);
 }
 
 /** Set the actor on the top layer at a position. */
 static void set_top_tile(const position_t pos, const actor_t tile) {
     set_tile_in_tile_block(pos, tile, tworld.top_layer);
+    mark_row_changed(pos.y);
 }
 
 static bool has_water_boots(void) {
@@ -283,10 +390,60 @@ static active_actor_t act_actor_create(position_t pos, step_t step, actor_state_
            (uint16_t) ((uint8_t) (step + STEP_BIAS) << 12);
 }
 
-static bool act_actor_is_at_pos(active_actor_t a, position_t pos) {
-    return act_actor_get_x(a) == pos.x && act_actor_get_y(a) == pos.y;
+// Mask of the position bits in an active actor, see active_actor_t.
+#define ACT_ACTOR_POS_MASK 0x0f9f
+
+#ifdef TWORLD_SPLIT_ACTORS
+// Mask of the biased step in an actor state byte, see `store_actor`.
+#define ACT_ACTOR_STEP_MASK 0x0f
+
+static active_actor_t get_actor(const actor_idx_t idx) {
+    const uint8_t state = tworld.actor_states[idx];
+    return tworld.actor_positions[idx] | (state & ACTOR_STATE_MASK) |
+           (uint16_t) (state & ACT_ACTOR_STEP_MASK) << 12;
+}
+
+static void store_actor(const actor_idx_t idx, const active_actor_t act) {
+    // position bits are kept in place, the state byte has the state on the same bits as in
+    // active_actor_t and the biased step on the lower 4 bits.
+    tworld.actor_positions[idx] = act & ACT_ACTOR_POS_MASK;
+    tworld.actor_states[idx] = ((uint8_t) act & ACTOR_STATE_MASK) | (uint8_t) (act >> 12);
+}
+
+static actor_state_t get_actor_state(const actor_idx_t idx) {
+    return tworld.actor_states[idx] & ACTOR_STATE_MASK;
+}
+
+static step_t get_actor_step(const actor_idx_t idx) {
+    return (step_t) ((step_t) (tworld.actor_states[idx] & ACT_ACTOR_STEP_MASK) - STEP_BIAS);
+}
+
+static bool actor_is_at_pos(const actor_idx_t idx, const position_t pos) {
+    return tworld.actor_positions[idx] == (pos.x | (uint16_t) pos.y << 7);
+}
+#else
+static active_actor_t get_actor(const actor_idx_t idx) {
+    return tworld.actors[idx];
+}
+
+static void store_actor(const actor_idx_t idx, const active_actor_t act) {
+    tworld.actors[idx] = act;
 }
 
+static actor_state_t get_actor_state(const actor_idx_t idx) {
+    return act_actor_get_state(tworld.actors[idx]);
+}
+
+static step_t get_actor_step(const actor_idx_t idx) {
+    return act_actor_get_step(tworld.actors[idx]);
+}
+
+static bool actor_is_at_pos(const actor_idx_t idx, const position_t pos) {
+    // compare both coordinates at once, this is used in linear searches of the actor list.
+    return (tworld.actors[idx] & ACT_ACTOR_POS_MASK) == (pos.x | (uint16_t) pos.y << 7);
+}
+#endif //TWORLD_SPLIT_ACTORS
+
 static active_actor_t act_actor_set_step(active_actor_t a, step_t step) {
     tworld_assert(step >= -3 && step <= 12);
     return (a & 0x0fff) | (uint8_t) (step + STEP_BIAS) << 12;
@@ -297,12 +454,26 @@ static active_actor_t act_actor_set_state(active_actor_t a, actor_state_t state)
     return (a & ~ACTOR_STATE_MASK) | state;
 }
 
+/**
+ * Set the actor at an index in the actor list, keeping the free slots bitset up to date.
+ * Changes that may hide an actor or end its animation delay must go through this function.
+ */
+static void set_actor(const actor_idx_t idx, const active_actor_t act) {
+    store_actor(idx, act);
+    const uint8_t bit = 1 << (idx & 7);
+    if (act_actor_get_state(act) == ACTOR_STATE_HIDDEN && act_actor_get_step(act) == 0) {
+        tworld.free_actors[idx >> 3] |= bit;
+    } else {
+        tworld.free_actors[idx >> 3] &= ~bit;
+    }
+}
+
 /**
  * Create a 'moving actor' container for the actor at an index in the actor list.
  * Any changes to this container must be persisted through `destroy_moving_actor`.
  */
 static void create_moving_actor(moving_actor_t* mact, const actor_idx_t idx) {
-    const active_actor_t act = tworld.actors[idx];
+    const active_actor_t act = get_actor(idx);
     mact->index = idx;
     mact->pos = act_actor_get_pos(act);
     mact->step = act_actor_get_step(act);
@@ -317,8 +488,8 @@ static void create_moving_actor(moving_actor_t* mact, const actor_idx_t idx) {
  */
 static void destroy_moving_actor(const moving_actor_t* mact) {
     // ACTOR_STATE_DIED and ACTOR_STATE_GHOST become ACTOR_STATE_HIDDEN after masking.
-    tworld.actors[mact->index] = act_actor_create(
-            mact->pos, mact->step, mact->state & ACTOR_STATE_MASK);
+    set_actor(mact->index, act_actor_create(
+            mact->pos, mact->step, mact->state & ACTOR_STATE_MASK));
 
     actor_t tile = ACTOR_NONE;
     if (mact->state == ACTOR_STATE_DIED) {
@@ -362,12 +533,13 @@ static sposition_t get_new_actor_position(const moving_actor_t* mact, const dire
  * Any changes must be persisted through `destroy_moving_actor`.
  * Animated actors may be included in the search or not.
  */
-static bool lookup_actor(moving_actor_t* mact, const position_t pos, const bool include_animated) {
+static AVR_OPTIMIZE(lookup_actor) bool lookup_actor(
+        moving_actor_t* mact, const position_t pos, const bool include_animated) {
+    profile_count(lookup_actor_calls);
     for (actor_idx_t i = 0; i < tworld.actors_size; ++i) {
-        const active_actor_t act = tworld.actors[i];
-        if (act_actor_is_at_pos(act, pos)) {
-            if (act_actor_get_state(act) != ACTOR_STATE_HIDDEN ||
-                (include_animated && act_actor_get_step(act) != 0)) {
+        if (actor_is_at_pos(i, pos)) {
+            if (get_actor_state(i) != ACTOR_STATE_HIDDEN ||
+                (include_animated && get_actor_step(i) != 0)) {
                 create_moving_actor(mact, i);
                 return true;
             }
@@ -383,12 +555,17 @@ static bool lookup_actor(moving_actor_t* mact, const position_t pos, const bool
  * Returns true if actor was successfully spawned, false if maximum actors has been reached.
  */
 static bool spawn_actor(moving_actor_t* mact) {
-    // Reuse a hidden (dead) actor in the list if possible
+    // Reuse the first hidden (dead) actor in the list if possible
     const uint8_t count = tworld.actors_size;
-    for (actor_idx_t i = 0; i < count; ++i) {
-        const active_actor_t act = tworld.actors[i];
-        if (act_actor_get_state(act) == ACTOR_STATE_HIDDEN && act_actor_get_step(act) == 0) {
-            create_moving_actor(mact, i);
+    for (uint8_t i = 0; i < (uint8_t) (count + 7) / 8; ++i) {
+        uint8_t free = tworld.free_actors[i];
+        if (free) {
+            actor_idx_t idx = i * 8;
+            while (!(free & 1)) {
+                free >>= 1;
+                ++idx;
+            }
+            create_moving_actor(mact, idx);
             return true;
         }
     }
@@ -401,7 +578,7 @@ static bool spawn_actor(moving_actor_t* mact) {
     }
 
     // Add a new actor at the end of the list.
-    tworld.actors[count] = act_actor_create((position_t) {0, 0}, 0, ACTOR_STATE_HIDDEN);
+    set_actor(count, act_actor_create((position_t) {0, 0}, 0, ACTOR_STATE_HIDDEN));
     tworld.actors_size = count + 1;
     create_moving_actor(mact, count);
     return true;
@@ -412,8 +589,20 @@ static bool spawn_actor(moving_actor_t* mact) {
  * Returns a pointer to the link or 0 if the button isn't linked.
  */
 static const link_t* find_link_to(const position_t pos, const links_t* links) {
-    for (uint8_t i = 0; i < links->size; ++i) {
-        const link_t* link = &links->links[i];
+    // Binary search for the first link with a button at or after the position.
+    const uint16_t key = LINK_POS_KEY(pos);
+    uint8_t lo = 0;
+    uint8_t hi = links->size;
+    while (lo < hi) {
+        const uint8_t mid = (uint8_t) (lo + hi) / 2;
+        if (LINK_POS_KEY(links->links[mid].btn) < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < links->size) {
+        const link_t* link = &links->links[lo];
         if (link->btn.x == pos.x && link->btn.y == pos.y) {
             return link;
         }
@@ -436,45 +625,34 @@ static direction_t get_slide_direction(const tile_t tile, const bool advance) {
 }
 
 /**
- * Build actor list in reading order (monster list is not used).
- * Exclude all actors on static tiles, but don't exchange Chip with the first actor
- * if the first actor was made static by the conversion process.
+ * Read the actor list precomputed by the level converter. The list is in reading order with
+ * Chip swapped with the first actor, and actors on static tiles are excluded.
  */
 static void build_actor_list(void) {
-    actor_idx_t chip_index = ACTOR_INDEX_NONE;
-    uint8_t count = 0;
-    for (grid_pos_t y = 0; y < GRID_WIDTH; ++y) {
-        for (grid_pos_t x = 0; x < GRID_WIDTH; ++x) {
-            const position_t pos = {x, y};
-            const actor_t actor = get_top_tile(pos);
-            if (actor_get_entity(actor) == ENTITY_CHIP) {
-                chip_index = count;
-            } else if (!actor_is_on_actor_list(actor) || tile_is_static(get_bottom_tile(pos))) {
-                continue;
-            }
-            tworld.actors[count++] = act_actor_create(pos, 0, ACTOR_STATE_NONE);
-#ifdef RUNTIME_CHECKS
-            if (count == MAX_ACTORS_COUNT) {
-                tworld_error("too many actors in level");
-                return;
-            }
-#endif //RUNTIME_CHECKS
-        }
-    }
-    tworld.actors_size = count;
-
+    flash_t addr = level_get_actors();
+    uint8_t count;
+    flash_read(addr, 1, &count);
+    ++addr;
 #ifdef RUNTIME_CHECKS
-    if (chip_index == ACTOR_INDEX_NONE) {
+    if (count == 0) {
         tworld_error("no chip tile found in level");
         return;
+    } else if (count >= MAX_ACTORS_COUNT) {
+        tworld_error("too many actors in level");
+        return;
     }
 #endif //RUNTIME_CHECKS
+    tworld.actors_size = count;
 
-    // If needed, swap Chip with first actor on the list.
-    if (chip_index > 0) {
-        const uint16_t temp = chip_actor();
-        chip_actor() = tworld.actors[chip_index];
-        tworld.actors[chip_index] = temp;
+    actor_idx_t idx = 0;
+    while (idx < count) {
+        position_t buf[ACTORS_READ_SIZE];
+        const uint8_t n = count - idx < ACTORS_READ_SIZE ? count - idx : ACTORS_READ_SIZE;
+        flash_read(addr, n * sizeof(position_t), buf);
+        for (uint8_t i = 0; i < n; ++i) {
+            store_actor(idx++, act_actor_create(buf[i], 0, ACTOR_STATE_NONE));
+        }
+        addr += n * sizeof(position_t);
     }
 }
 
@@ -517,9 +695,8 @@ static move_result_t perform_move(moving_actor_t* act, uint8_t flags);
  */
 static void stop_death_animation(const position_t pos) {
     for (actor_idx_t i = 0; i < tworld.actors_size; ++i) {
-        const active_actor_t act = tworld.actors[i];
-        if (act_actor_is_at_pos(act, pos)) {
-            tworld.actors[i] = act_actor_set_step(act, 0);
+        if (actor_is_at_pos(i, pos)) {
+            set_actor(i, act_actor_set_step(get_actor(i), 0));
             return;
         }
     }
@@ -581,6 +758,7 @@ static bool can_push_block(moving_actor_t* block, const direction_t direction,
  */
 static bool can_move(const moving_actor_t* act, const direction_t direction,
                      const uint8_t flags) {
+    profile_count(can_move_calls);
     const sposition_t spos = get_new_actor_position(act, direction);
     if (spos.x < 0 || spos.x >= GRID_WIDTH || spos.y < 0 || spos.y >= GRID_HEIGHT) {
         // cannot exit map borders
@@ -588,6 +766,13 @@ static bool can_move(const moving_actor_t* act, const direction_t direction,
     }
 
     const position_t pos = {spos.x, spos.y};
+#ifdef TWORLD_WALL_CACHE
+    if (actor_is_monster(act->entity) && is_monster_wall(pos)) {
+        // Checked again below, but this answers most blocked monster moves without
+        // unpacking any tile. None of the checks before it have side effects for monsters.
+        return false;
+    }
+#endif
     const tile_t tile_from = get_bottom_tile(act->pos);
     const tile_t tile_to = get_bottom_tile(pos);
 
@@ -666,8 +851,8 @@ static bool can_move(const moving_actor_t* act, const direction_t direction,
                 if (!can_push_block(&other, direction, flags & ~CM_RELEASING)) {
                     if (other.entity == ENTITY_BLOCK_GHOST) {
                         // Ghost block just created can't be moved: hide it immediately.
-                        tworld.actors[other.index] = act_actor_set_state(
-                                tworld.actors[other.index], ACTOR_STATE_HIDDEN);
+                        set_actor(other.index, act_actor_set_state(
+                                get_actor(other.index), ACTOR_STATE_HIDDEN));
                     }
                     return false;
                 }
@@ -852,41 +1037,12 @@ static void choose_monster_move(moving_actor_t* act) {
             choices[1] = temp;
         }
         // at this point choices[1] may still be DIR_NONE.
-    } else if (act->entity == ENTITY_BLOB) {
-        // random direction
-        choices[0] = BLOB_TURN;
-    } else if (actor_is_tank(act->entity)) {
-        choices[0] = forward;
-    } else if (act->entity == ENTITY_WALKER) {
-        // forward and turn randomly if blocked.
-        choices[0] = forward;
-        choices[1] = WALKER_TURN;
     } else {
-        const direction_t back = direction_back(forward);
-        if (act->entity == ENTITY_BALL) {
-            choices[0] = forward;
-            choices[1] = back;
-        } else {
-            const direction_t left = direction_left(forward);
-            const direction_t right = direction_right(forward);
-            if (act->entity == ENTITY_BUG) {
-                choices[0] = left;
-                choices[1] = forward;
-                choices[2] = right;
-            } else if (act->entity == ENTITY_PARAMECIUM) {
-                choices[0] = right;
-                choices[1] = forward;
-                choices[2] = left;
-            } else if (act->entity == ENTITY_GLIDER) {
-                choices[0] = forward;
-                choices[1] = left;
-                choices[2] = right;
-            } else {  // FIREBALL is the only left at this point
-                choices[0] = forward;
-                choices[1] = right;
-                choices[2] = left;
-            }
-            choices[3] = back;
+        // Walker and blob turns are kept as is and resolved when attempted.
+        const uint8_t* turns = MONSTER_TURNS[(uint8_t) (act->entity - ENTITY_BUG) / 4];
+        for (uint8_t i = 0; i < 4; ++i) {
+            const uint8_t turn = turns[i];
+            choices[i] = turn <= TURN_RIGHT ? (direction_t) ((forward + turn) % 4) : turn;
         }
     }
 
@@ -1012,7 +1168,7 @@ static move_result_t start_movement(moving_actor_t* act, const uint8_t flags) {
         tworld.collided_actor = actor_create(act->entity, act->direction);
 
     } else if (act->entity == ENTITY_CHIP && tworld.collided_with != ACTOR_INDEX_NONE) {
-        const active_actor_t other = tworld.actors[tworld.collided_with];
+        const active_actor_t other = get_actor(tworld.collided_with);
         if (act_actor_get_state(other) != ACTOR_STATE_HIDDEN) {
             // Collision occured and creature has not died in the meantime.
             // This is a special case since the creature has actually moved by this time,
@@ -1053,7 +1209,7 @@ static move_result_t start_movement(moving_actor_t* act, const uint8_t flags) {
             // rest of the tick is processed as usual, but now the actor that has moved on Chip
             // took its place and may attempt to move again when Chip turn comes.
             // STATE_HIDDEN cannot be used because we want this actor to be shown in collision.
-            chip_actor() = act_actor_set_state(chip, ACTOR_STATE_NONE);
+            store_actor(0, act_actor_set_state(chip, ACTOR_STATE_NONE));
         }
     }
 
@@ -1108,12 +1264,11 @@ static void turn_tanks(moving_actor_t* trigger) {
         trigger->entity = actor_reverse_tank(trigger->entity);
     }
     for (actor_idx_t i = 0; i < tworld.actors_size; ++i) {
-        const active_actor_t actor = tworld.actors[i];
-        if (act_actor_get_state(actor) == ACTOR_STATE_HIDDEN) {
+        if (get_actor_state(i) == ACTOR_STATE_HIDDEN) {
             continue;
         }
 
-        const position_t pos = act_actor_get_pos(actor);
+        const position_t pos = act_actor_get_pos(get_actor(i));
         const tile_t top_tile = get_top_tile(pos);
         if (!actor_is_tank(top_tile)) {
             continue;
@@ -1282,6 +1437,29 @@ static void spring_trap(const position_t pos) {
     }
 }
 
+/**
+ * Returns the grid index of the previous teleporter before a grid index, in reverse reading
+ * order and wrapping around. The index itself is returned if there are no other teleporters.
+ * There must be at least one teleporter on the grid.
+ */
+static uint16_t find_previous_teleporter(uint16_t idx) {
+    while (true) {
+        idx = (idx > 0 ? idx : GRID_SIZE) - 1;
+        // keep only the bits at or before the index in this byte.
+        uint8_t bits = teleporters.bits[idx / 8] & (uint8_t) (0xff >> (7 - idx % 8));
+        if (bits) {
+            idx |= 7;
+            while (!(bits & 0x80)) {
+                bits <<= 1;
+                --idx;
+            }
+            return idx;
+        }
+        // skip to the previous byte.
+        idx &= ~7;
+    }
+}
+
 /**
  * Teleport an actor on a teleporter to another teleporter, in reverse reading order.
  * If all teleporters are blocked in the actor's direction, the actor becomes stuck.
@@ -1300,57 +1478,36 @@ static void teleport_actor(moving_actor_t* act) {
         set_top_tile(act->pos, ACTOR_NONE);
     }
 
-    const bool scan = tworld.level_flags & LEVEL_FLAG_SCAN_TELEPORTERS;
-    uint16_t idx_count;
-    uint16_t idx = 0;
-    if (scan) {
-        // Scan the map to find teleporters, start position is actor position.
-        idx = act->pos.x + act->pos.y * GRID_WIDTH;
-        idx_count = GRID_SIZE;
-    } else {
-        // Use the prebuilt list to find teleporters, get index of current teleporter in list.
-        while (!position_equals(teleporters.teleporters[idx], act->pos)) {
-            ++idx;
-        }
-        idx_count = teleporters.size;
-    }
-    const uint16_t orig_idx = idx;
-
+    const uint16_t orig_idx = act->pos.x + act->pos.y * GRID_WIDTH;
+    uint16_t idx = orig_idx;
     while (true) {
-        idx = (idx > 0 ? idx : idx_count) - 1;
+        idx = find_previous_teleporter(idx);
         position_t pos;
-        if (scan) {
-            pos.x = idx % GRID_WIDTH;
-            pos.y = idx / GRID_WIDTH;
-        } else {
-            pos = teleporters.teleporters[idx];
-        }
-
-        if (!scan || get_bottom_tile(pos) == TILE_TELEPORTER) {
-            act->pos = pos;
-            if (!actor_is_monster_or_block(get_top_tile(pos)) && can_move(act, act->direction, 0)) {
-                // Actor teleported successfully. Its position was changed just before so that
-                // `can_move` could be called correctly, keep it there so that the tile gets set
-                // when the actor is destroyed after this call.
-                // Also set the TELEPORTED state to force the move out of the teleporter later.
-                act->state = ACTOR_STATE_TELEPORTED;
-
-                const actor_t actor = get_top_tile(pos);
-                if (actor_get_entity(actor) == ENTITY_CHIP) {
-                    // Oops, teleporting on Chip (this is legal in TW, not a collision)
-                    // Chip tile will be lost after destruction, save it temporarily.
-                    // This happens when Chip goes in teleporter at the same time or after
-                    // a creature, but before that creature moves out of the teleporter.
-                    // A bit of a hack, but it only costs 1B of RAM.
-                    tworld.teleported_chip = actor;
-                }
-                return;
+        pos.x = idx % GRID_WIDTH;
+        pos.y = idx / GRID_WIDTH;
+
+        act->pos = pos;
+        if (!actor_is_monster_or_block(get_top_tile(pos)) && can_move(act, act->direction, 0)) {
+            // Actor teleported successfully. Its position was changed just before so that
+            // `can_move` could be called correctly, keep it there so that the tile gets set
+            // when the actor is destroyed after this call.
+            // Also set the TELEPORTED state to force the move out of the teleporter later.
+            act->state = ACTOR_STATE_TELEPORTED;
+
+            const actor_t actor = get_top_tile(pos);
+            if (actor_get_entity(actor) == ENTITY_CHIP) {
+                // Oops, teleporting on Chip (this is legal in TW, not a collision)
+                // Chip tile will be lost after destruction, save it temporarily.
+                // This happens when Chip goes in teleporter at the same time or after
+                // a creature, but before that creature moves out of the teleporter.
+                // A bit of a hack, but it only costs 1B of RAM.
+                tworld.teleported_chip = actor;
             }
+            return;
         }
 
         if (idx == orig_idx) {
             // no destination teleporter found, actor is stuck.
-            act->pos = pos;
             if (act->entity == ENTITY_CHIP) {
                 tworld.flags |= FLAG_CHIP_STUCK;
             }
@@ -1419,7 +1576,7 @@ static void step_check(void) {
 #ifdef RUNTIME_CHECKS
     // Check if corresponding tile for actor has an entity.
     for (actor_idx_t i = 0; i < tworld.actors_size; ++i) {
-        const active_actor_t actor = tworld.actors[i];
+        const active_actor_t actor = get_actor(i);
         const position_t pos = act_actor_get_pos(actor);
         if (actor_get_entity(get_top_tile(pos)) == ENTITY_NONE &&
             act_actor_get_state(actor) != ACTOR_STATE_HIDDEN) {
@@ -1459,8 +1616,7 @@ static void prestep(void) {
     // if needed, transform "reverse tanks" to normal tanks in the opposite direction.
     if (tworld.flags & FLAG_TURN_TANKS) {
         for (actor_idx_t i = 0; i < tworld.actors_size; ++i) {
-            const active_actor_t actor = tworld.actors[i];
-            if (act_actor_get_state(actor) == ACTOR_STATE_HIDDEN) {
+            if (get_actor_state(i) == ACTOR_STATE_HIDDEN) {
                 continue;
             }
 
@@ -1485,19 +1641,18 @@ static void prestep(void) {
 
 static void choose_all_moves(void) {
     for (actor_idx_t i = tworld.actors_size; i-- > 0;) {
-        const active_actor_t actor = tworld.actors[i];
-        const step_t step = act_actor_get_step(actor);
-        const actor_state_t state = act_actor_get_state(actor);
+        const step_t step = get_actor_step(i);
+        const actor_state_t state = get_actor_state(i);
 
         if (state == ACTOR_STATE_HIDDEN) {
             if (step > 0) {
                 // "animated" state delay
-                tworld.actors[i] = act_actor_set_step(actor, (step_t) (step - 1));
+                set_actor(i, act_actor_set_step(get_actor(i), (step_t) (step - 1)));
             }
             continue;
         }
 
-        tworld.actors[i] = act_actor_set_state(actor, ACTOR_STATE_NONE);
+        set_actor(i, act_actor_set_state(get_actor(i), ACTOR_STATE_NONE));
         if (step <= 0) {
             moving_actor_t mact;
             create_moving_actor(&mact, i);
@@ -1509,8 +1664,7 @@ static void choose_all_moves(void) {
 
 static void perform_all_moves(void) {
     for (actor_idx_t i = tworld.actors_size; i-- > 0;) {
-        const active_actor_t actor = tworld.actors[i];
-        if (act_actor_get_state(actor) == ACTOR_STATE_HIDDEN) {
+        if (get_actor_state(i) == ACTOR_STATE_HIDDEN) {
             continue;
         }
 
@@ -1543,12 +1697,11 @@ static void teleport_all(void) {
     }
 
     for (actor_idx_t i = tworld.actors_size; i-- > 0;) {
-        const active_actor_t actor = tworld.actors[i];
-        if (act_actor_get_state(actor) == ACTOR_STATE_HIDDEN || act_actor_get_step(actor) > 0) {
+        if (get_actor_state(i) == ACTOR_STATE_HIDDEN || get_actor_step(i) > 0) {
             continue;
         }
 
-        const position_t pos = act_actor_get_pos(actor);
+        const position_t pos = act_actor_get_pos(get_actor(i));
         if (get_bottom_tile(pos) == TILE_TELEPORTER) {
             moving_actor_t mact;
             create_moving_actor(&mact, i);
@@ -1580,6 +1733,9 @@ void tworld_init(void) {
 #endif //TEST
 
     build_actor_list();
+#ifdef TWORLD_WALL_CACHE
+    build_wall_cache();
+#endif
 }
 
 void tworld_update(void) {
@@ -1588,11 +1744,12 @@ void tworld_update(void) {
         return;
     }
 
-    step_check();
-    prestep();
-    choose_all_moves();
-    perform_all_moves();
-    teleport_all();
+    profile_phase(TWORLD_PHASE_STEP_CHECK, step_check());
+    profile_phase(TWORLD_PHASE_PRESTEP, prestep());
+    profile_phase(TWORLD_PHASE_CHOOSE_MOVES, choose_all_moves());
+    profile_phase(TWORLD_PHASE_PERFORM_MOVES, perform_all_moves());
+    profile_phase(TWORLD_PHASE_TELEPORT, teleport_all());
+    profile_count(ticks);
 
     ++tworld.current_time;
     if (tworld.time_left != TIME_LEFT_NONE) {
@@ -1600,26 +1757,6 @@ void tworld_update(void) {
     }
 }
 
-void tworld_cache_teleporters(void) {
-    if (tworld.level_flags & LEVEL_FLAG_SCAN_TELEPORTERS) {
-        // Do not prebuild list, too many teleporters presumably (or none).
-        return;
-    }
-    uint8_t size = 0;
-    position_t* list = teleporters.teleporters;
-    for (grid_pos_t y = 0; y < GRID_HEIGHT; ++y) {
-        for (grid_pos_t x = 0; x < GRID_WIDTH; ++x) {
-            const position_t pos = {x, y};
-            if (get_bottom_tile(pos) == TILE_TELEPORTER) {
-                *list++ = pos;
-                ++size;
-                tworld_assert(size <= LEVEL_MAX_TELEPORTERS, "too many teleporters to cache");
-            }
-        }
-    }
-    teleporters.size = size;
-}
-
 bool tworld_is_game_over(void) {
     return tworld.end_cause != END_CAUSE_NONE;
 }
@@ -1628,6 +1765,10 @@ position_t tworld_get_current_position(void) {
     return act_actor_get_pos(chip_actor());
 }
 
+active_actor_t tworld_get_actor(const actor_idx_t idx) {
+    return get_actor(idx);
+}
+
 tile_t tworld_get_bottom_tile(const position_t pos) {
     return get_bottom_tile(pos);
 }
@@ -1640,3 +1781,17 @@ bool tworld_has_collided(void) {
     return tworld.end_cause == END_CAUSE_COLLIDED_MONSTER ||
            tworld.end_cause == END_CAUSE_COLLIDED_BLOCK;
 }
+
+#ifdef TWORLD_CONTEXT
+void tworld_set_context(tworld_ctx_t* ctx) {
+    tworld_ctx = ctx;
+}
+#endif
+
+bool tworld_is_row_changed(const grid_pos_t y) {
+    return (tworld.changed_rows[y / 8] & (1 << (y % 8))) != 0;
+}
+
+void tworld_clear_changed_rows(void) {
+    memset(tworld.changed_rows, 0, sizeof tworld.changed_rows);
+}
@@ -29,13 +29,24 @@
 #define POS_FIRST_SECRET_LEVEL 3
 #define POS_LEVEL_INDEX 4
 
+// Size of a level index entry, the position of level data from the start of the level pack.
+#define LEVEL_INDEX_ENTRY_SIZE 3
+
+// Size of a password table entry, the level password followed by the level index.
+#define PASSWORD_ENTRY_SIZE 5
+
 // Field positions in level data.
 #define POS_PASSWORD 7
 #define POS_INDEX_TITLE 11
 #define POS_INDEX_HINT 13
 #define POS_INDEX_TRAP_LINKS 15
 #define POS_INDEX_CLONER_LINKS 17
-#define POS_LAYER_DATA 19
+#define POS_INDEX_ACTORS 19
+#define POS_INDEX_TELEPORTERS 21
+#define POS_LAYER_DATA 23
+
+// Number of positions read at once from the teleporter list.
+#define TELEPORTERS_READ_SIZE 8
 
 // Unlock threshold in ratio of previous level pack completed levels.
 // Format is UQ0.8 (divide by 256 to get actual value)
@@ -48,10 +59,19 @@ static flash_t get_level_pack_addr(level_pack_idx_t pack) {
     return asset_level_packs(pack);
 }
 
+static flash_t get_level_addr(level_pack_idx_t pack, level_idx_t level) {
+    const flash_t pack_addr = get_level_pack_addr(pack);
+    flash_t offset = 0;
+    flash_read(pack_addr + POS_LEVEL_INDEX + level * LEVEL_INDEX_ENTRY_SIZE,
+               LEVEL_INDEX_ENTRY_SIZE, &offset);
+    return pack_addr + offset;
+}
+
 void level_read_packs(void) {
     uint16_t pos = 0;
     level_pack_info_t* info = tworld_packs.packs;
     bool next_is_unlocked = true;
+    read_level_times();
     for (level_pack_idx_t i = 0; i < LEVEL_PACK_COUNT; ++i) {
         flash_t addr = get_level_pack_addr(i);
 
@@ -75,7 +95,7 @@ void level_read_packs(void) {
             info->flags |= LEVEL_PACK_FLAG_UNLOCKED;
         }
 
-        addr += count * 2 + POS_LEVEL_INDEX;
+        addr += count * (LEVEL_INDEX_ENTRY_SIZE + PASSWORD_ENTRY_SIZE) + POS_LEVEL_INDEX;
         flash_read(addr, LEVEL_PACK_NAME_MAX_LENGTH, &info->name);
         fill_completed_levels_array(pos, info);
         pos += count;
@@ -87,16 +107,34 @@ void level_read_packs(void) {
     }
 }
 
-void level_read_level(void) {
-    // Read level pack index to get the start address of the current level.
-    flash_t addr = get_level_pack_addr(game.current_pack);
-    flash_t index_addr = addr + POS_LEVEL_INDEX;
-    for (level_idx_t i = 0; i <= game.current_level; ++i) {
-        uint16_t offset;
-        flash_read(index_addr, 2, &offset);
-        addr += offset;
-        index_addr += 2;
+#ifdef TWORLD_UNPACKED_LAYERS
+
+// Offset of packed layers data in the unpacked layers, so that it ends at the same place.
+#define LEVEL_PACKED_LAYERS_OFFSET (2 * (LEVEL_LAYER_SIZE - LEVEL_PACKED_LAYER_SIZE))
+#define LEVEL_PACKED_LAYER_SIZE (6 * 32 * 32 / 8)
+
+/**
+ * Unpack both layers from 6 bits per tile to one byte per tile. The packed data is read
+ * from the end of the layers, each block is read before the tiles it unpacks to are written.
+ */
+static void unpack_layers(uint8_t* layers) {
+    const uint8_t* src = layers + LEVEL_PACKED_LAYERS_OFFSET;
+    uint8_t* dst = layers;
+    for (uint16_t i = 0; i < 2 * LEVEL_PACKED_LAYER_SIZE / 3; ++i) {
+        const uint8_t b0 = *src++;
+        const uint8_t b1 = *src++;
+        const uint8_t b2 = *src++;
+        *dst++ = b0 & 0x3f;
+        *dst++ = (b0 >> 6) | (b1 & 0x0f) << 2;
+        *dst++ = (b1 >> 4) | (b2 & 0x03) << 4;
+        *dst++ = b2 >> 2;
     }
+}
+
+#endif //TWORLD_UNPACKED_LAYERS
+
+void level_read_level(void) {
+    const flash_t addr = get_level_addr(game.current_pack, game.current_level);
     tworld.addr = addr;
 
     // Read data from flash
@@ -111,7 +149,14 @@ void level_read_level(void) {
     // bottom layer before top layer, row-major order and little-endian.
     // We only need to decompress it.
     uint16_t layer_data_size = buf[5] | buf[6] << 8;
+#ifdef TWORLD_UNPACKED_LAYERS
+    // Decode at the end of both layers, then unpack forward in place.
+    uint8_t* layers = tworld.bottom_layer;
+    lzss_decode(addr + POS_LAYER_DATA, layer_data_size, layers + LEVEL_PACKED_LAYERS_OFFSET);
+    unpack_layers(layers);
+#else
     lzss_decode(addr + POS_LAYER_DATA, layer_data_size, tworld.bottom_layer);
+#endif
 
     tworld_init();
 }
@@ -136,6 +181,7 @@ flash_t level_get_hint(void) {
 }
 
 static void get_links(links_t* links, uint8_t index_pos) {
+    // Links are sorted by button position in level data.
     flash_t addr = get_metadata_address(index_pos);
     uint8_t size;
     flash_read(addr, 1, &size);
@@ -150,31 +196,61 @@ void level_get_links(void) {
     get_links(&cloner_links, POS_INDEX_CLONER_LINKS);
 }
 
+flash_t level_get_actors(void) {
+    return get_metadata_address(POS_INDEX_ACTORS);
+}
+
+void level_get_teleporters(void) {
+    memset(teleporters.bits, 0, sizeof teleporters.bits);
+    flash_t addr = get_metadata_address(POS_INDEX_TELEPORTERS);
+    uint16_t count = 0;
+    flash_read(addr, 2, &count);
+    addr += 2;
+    while (count > 0) {
+        position_t buf[TELEPORTERS_READ_SIZE];
+        const uint8_t n = count < TELEPORTERS_READ_SIZE ? count : TELEPORTERS_READ_SIZE;
+        flash_read(addr, n * sizeof(position_t), buf);
+        for (uint8_t i = 0; i < n; ++i) {
+            const uint16_t idx = buf[i].y * GRID_WIDTH + buf[i].x;
+            teleporters.bits[idx / 8] |= 1 << (idx % 8);
+        }
+        addr += n * sizeof(position_t);
+        count -= n;
+    }
+}
+
 bool level_use_password(void) {
-    // Iterate over unlocked level packs and iterate over levels in the pack to
-    // find a level with a password matching the given password.
-    char buf[4];
+    // Iterate over unlocked level packs and do a binary search in the password table of each pack
+    // to find the first level with a password matching the given password.
+    uint8_t entry[PASSWORD_ENTRY_SIZE];
     for (level_pack_idx_t i = 0; i < LEVEL_PACK_COUNT; ++i) {
         const level_pack_info_t* info = &tworld_packs.packs[i];
-        if (info->flags & LEVEL_PACK_FLAG_UNLOCKED) {
-            flash_t addr = get_level_pack_addr(i);
-            flash_t index_addr = addr + POS_LEVEL_INDEX;
-            addr += POS_PASSWORD;
-
-            for (level_idx_t j = 0; j <= info->total_levels; ++j) {
-                uint16_t offset;
-                flash_read(index_addr, 2, &offset);
-                addr += offset;
-                index_addr += 2;
-                flash_read(addr, sizeof buf, buf);
-                if (memcmp(tworld_packs.password_buf, buf, sizeof buf) == 0) {
-                    // Level found matching password, go to it.
-                    game.current_pack = i;
-                    game.current_level = j;
-                    game.current_level_pos = info->pos + j;
-                    game.flags |= FLAG_PASSWORD_USED;
-                    return true;
-                }
+        if (!(info->flags & LEVEL_PACK_FLAG_UNLOCKED)) {
+            continue;
+        }
+        const flash_t table = get_level_pack_addr(i) + POS_LEVEL_INDEX +
+                              info->total_levels * LEVEL_INDEX_ENTRY_SIZE;
+        uint16_t lo = 0;
+        uint16_t hi = info->total_levels;
+        while (lo < hi) {
+            const uint16_t mid = (lo + hi) / 2;
+            flash_read(table + mid * PASSWORD_ENTRY_SIZE, PASSWORD_ENTRY_SIZE, entry);
+            if (memcmp(entry, tworld_packs.password_buf, LEVEL_PASSWORD_LENGTH - 1) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo < info->total_levels) {
+            flash_read(table + lo * PASSWORD_ENTRY_SIZE, PASSWORD_ENTRY_SIZE, entry);
+            if (memcmp(entry, tworld_packs.password_buf, LEVEL_PASSWORD_LENGTH - 1) == 0) {
+                // Level found matching password, go to it.
+                const level_idx_t level = entry[LEVEL_PASSWORD_LENGTH - 1];
+                game.current_pack = i;
+                game.current_level = level;
+                game.current_level_pos = info->pos + level;
+                game.flags |= FLAG_PASSWORD_USED;
+                return true;
             }
         }
     }
@@ -19,11 +19,19 @@
 #include "game.h"
 #include "assets.h"
 #include "tworld_level.h"
+#include "save.h"
 
 #include <core/dialog.h>
 
 static const char* const CHOICES_ON_OFF[] = {"OFF", "ON"};
 
+static void read_level_dialog_info(void) {
+    game.level_title = level_get_title();
+    game.level_title_lines = 0;
+    game.best_level_time = get_best_level_time(game.current_level_pos);
+    level_get_password(game.level_password);
+}
+
 void open_main_menu_dialog(void) {
     dialog_init_hcentered(54, 96, 56);
     if (game.last_state < GAME_SSEP_COVER_BG) {
@@ -56,10 +64,11 @@ void open_levels_dialog(void) {
 }
 
 void open_level_info_dialog(void) {
-    dialog_init_centered(126, 73);
+    dialog_init_centered(126, 109);
     dialog.pos_btn = "START";
     dialog.selection = DIALOG_SELECTION_POS;
     dialog.pos_result = RESULT_START_LEVEL;
+    read_level_dialog_info();
 }
 
 void open_password_dialog(void) {
@@ -150,4 +159,6 @@ void open_level_complete_dialog(void) {
 
     dialog_add_item_button("NEXT LEVEL", RESULT_NEXT_LEVEL);
     dialog_add_item_button("MAIN MENU", RESULT_OPEN_MAIN_MENU);
+
+    read_level_dialog_info();
 }
@@ -2,8 +2,43 @@
 DEFINES += DIALOG_MAX_ITEMS=5
 
 #DEFINES += FPS_MONITOR
+# Show the main loop phases bar with the FPS monitor (the bootloader must also define it).
+#DEFINES += LOOP_MONITOR
+# Count SPI traffic per device and per tag in simulation, saved to spi_stats.csv on exit.
+#DEFINES += SPI_MONITOR
+# Count rows and bytes changed per frame in simulation, saved to display_stats.csv on exit.
+#DEFINES += DISPLAY_MONITOR
+
+# Store one byte per tile in level layers instead of 6 bits, for faster tile access.
+# This needs 1 kB more RAM than available on the ATmega3208.
+#DEFINES += TWORLD_UNPACKED_LAYERS
+
+# Store actor state and step apart from positions, so that actor list scans skipping hidden
+# actors read a single byte per actor. This needs 128 bytes more RAM.
+#DEFINES += TWORLD_SPLIT_ACTORS
+
+# Cache monster acting walls of the bottom layer in a bitset, so that most blocked monster
+# moves are answered without unpacking tiles. This needs 128 bytes more RAM.
+#DEFINES += TWORLD_WALL_CACHE
+
+# Count engine calls and time the phases of each tick in regular test builds,
+# the level tests report them for each level.
+ifeq ($(PLATFORM),test)
+DEFINES += TWORLD_PROFILE
+endif
+
+ifeq ($(REPLAY),1)
+# Replay runs levels in parallel threads, each with its own engine context.
+DEFINES += TWORLD_CONTEXT
+endif
 
 ALL_TESTS := level
+# Level tests share global engine state, run them in one process per host core instead.
+SHARDS ?= $(shell nproc)
 
 level_test: assets
 	$(MAKE) compile TEST_NAME=level
+
+# Optimized replay of all level solutions, run from app/tworld with build/replay/level_replay.
+level_replay: assets
+	$(MAKE) compile TEST_NAME=level REPLAY=1
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Replays the solutions for all levels as fast as possible to validate them, and reports
+ * the number of game ticks simulated per second. This is built without sanitizers and with
+ * optimizations and with `TWORLD_CONTEXT`, see the `level_replay` target. Levels are replayed
+ * in parallel threads, each with its own engine context.
+ *
+ * The engine context is also snapshotted at regular intervals while replaying. Once a level
+ * is over, the state is rewound to the middle snapshot and the rest of the level is replayed
+ * from there, which must give the exact same end state as replaying from the start.
+ */
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+
+extern "C" {
+#include <boot/init.h>
+#include <sim/flash.h>
+#include <tworld_level.h>
+#include <game.h>
+}
+
+#include "solution.h"
+
+struct ReplayEntry {
+    level_pack_idx_t pack;
+    level_idx_t level;
+    Solution solution;
+};
+
+struct ReplayResult {
+    end_cause_t end_cause;
+    uint32_t ticks;
+    bool rewind_matches;
+};
+
+// Number of game ticks between engine context snapshots.
+static constexpr uint32_t SNAPSHOT_INTERVAL = 1024;
+
+struct Snapshot {
+    uint32_t tick;
+    tworld_ctx_t ctx;
+};
+
+// Level loading reads from the simulated flash, which isn't thread-safe.
+static std::mutex load_mutex;
+
+static bool is_blacklisted(level_pack_idx_t pack, level_idx_t level) {
+    return std::find(std::begin(TEST_BLACKLIST), std::end(TEST_BLACKLIST),
+                     std::make_tuple(pack, level)) != std::end(TEST_BLACKLIST);
+}
+
+static ReplayResult replay_level(const ReplayEntry& entry) {
+    tworld_ctx_t ctx;
+    tworld_set_context(&ctx);
+    {
+        std::lock_guard<std::mutex> lock(load_mutex);
+        game.current_pack = entry.pack;
+        game.current_level = entry.level;
+        level_read_level();
+        level_get_links();
+        level_get_teleporters();
+    }
+
+    const Solution& solution = entry.solution;
+    tworld.prng_value0 = solution.prng_seed;
+    tworld.stepping = solution.stepping;
+    tworld.random_slide_dir = solution.initial_random_slide_dir;
+
+    // The context is copied with memcpy so that padding bytes are the same in all copies.
+    std::vector<Snapshot> snapshots;
+    std::vector<direction_mask_t> inputs;
+    uint32_t ticks = 0;
+    auto update = [&](direction_mask_t input) {
+        if (ticks % SNAPSHOT_INTERVAL == 0) {
+            snapshots.emplace_back();
+            snapshots.back().tick = ticks;
+            std::memcpy(&snapshots.back().ctx, &ctx, sizeof ctx);
+        }
+        inputs.push_back(input);
+        tworld.input_state = input;
+        tworld_update();
+        ++ticks;
+    };
+    solution.iterate([&](direction_mask_t direction) -> bool {
+        if (tworld.error || tworld_is_game_over()) {
+            return false;
+        }
+        update(direction);
+        return true;
+    });
+    while (!tworld.error && !tworld_is_game_over() && tworld.current_time < solution.total_time) {
+        update(DIR_MASK_NONE);
+    }
+
+    // Rewind to the middle snapshot and replay the recorded inputs from there.
+    bool rewind_matches = true;
+    if (!snapshots.empty()) {
+        tworld_ctx_t end_ctx;
+        std::memcpy(&end_ctx, &ctx, sizeof ctx);
+        const Snapshot& snapshot = snapshots[snapshots.size() / 2];
+        std::memcpy(&ctx, &snapshot.ctx, sizeof ctx);
+        for (uint32_t i = snapshot.tick; i < ticks; ++i) {
+            tworld.input_state = inputs[i];
+            tworld_update();
+        }
+        rewind_matches = std::memcmp(&ctx, &end_ctx, sizeof ctx) == 0;
+    }
+
+    const ReplayResult result = {tworld.error ? END_CAUSE_ERROR : tworld.end_cause,
+                                 ticks, rewind_matches};
+    tworld_set_context(nullptr);
+    return result;
+}
+
+int main() {
+    // Simulator initialization, done once before starting workers.
+    sys_init();
+    sim_flash_load("assets.dat");
+    level_read_packs();
+
+    std::vector<ReplayEntry> entries;
+    std::vector<std::string> names;
+    for (level_pack_idx_t i = 0; i < LEVEL_PACK_COUNT; ++i) {
+        std::ifstream solution_stream(LEVEL_PACK_TWS[i]);
+        SolutionLoader loader(solution_stream);
+        const level_pack_info_t& info = tworld_packs.packs[i];
+        for (level_idx_t j = 0; j < info.total_levels; ++j) {
+            if (!is_blacklisted(i, j)) {
+                entries.push_back({i, j, loader.read_solution(j)});
+                names.push_back(std::string(info.name) + " level " + std::to_string(j + 1));
+            }
+        }
+    }
+
+    const unsigned workers = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "Replaying " << entries.size() << " levels with "
+              << workers << " workers..." << std::endl;
+    const auto start_time = std::chrono::steady_clock::now();
+
+    // Each worker takes the next level to replay until all levels are done.
+    std::vector<ReplayResult> results(entries.size());
+    std::atomic<size_t> next_entry = 0;
+    std::vector<std::thread> threads;
+    for (unsigned w = 0; w < workers; ++w) {
+        threads.emplace_back([&]() {
+            size_t i;
+            while ((i = next_entry++) < entries.size()) {
+                results[i] = replay_level(entries[i]);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    uint64_t total_ticks = 0;
+    size_t completed = 0;
+    size_t rewind_mismatches = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+        total_ticks += results[i].ticks;
+        if (results[i].end_cause == END_CAUSE_COMPLETE) {
+            ++completed;
+        } else {
+            std::cout << "FAILED: " << names[i] << " (end cause "
+                      << (int) results[i].end_cause << ")" << std::endl;
+        }
+        if (!results[i].rewind_matches) {
+            std::cout << "REWIND MISMATCH: " << names[i] << std::endl;
+            ++rewind_mismatches;
+        }
+    }
+
+    const double elapsed = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start_time).count();
+    std::cout << completed << "/" << entries.size() << " levels completed, "
+              << total_ticks << " ticks in " << std::fixed << std::setprecision(2) << elapsed
+              << " s (" << std::setprecision(0) << (double) total_ticks / elapsed
+              << " ticks/s)" << std::endl;
+
+    return completed == entries.size() && rewind_mismatches == 0 ? 0 : 1;
+}
@@ -20,6 +20,7 @@
 #include <fstream>
 #include <iterator>
 #include <filesystem>
+#include <iomanip>
 
 extern "C" {
 #include <boot/init.h>
@@ -30,212 +31,12 @@ extern "C" {
 #include <game.h>
 }
 
+#include "solution.h"
+
 // Whether to export a list of actors state for each time to a file for failing tests.
 constexpr bool EXPORT_ACTORS_FILE = true;
 constexpr const char* EXPORT_ACTORS_DIR = "test/dev/";
 
-// Path of TWS files for level packs declared in pack.py, in the same order.
-// The working directory should be app/tworld when running tests.
-constexpr const char* LEVEL_PACK_TWS[] = {
-        "test/tws/cclp1.tws",
-        "test/tws/cclp2.tws",
-        "test/tws/cclp3.tws",
-        "test/tws/cclp4.tws",
-};
-
-// Tests in this list should be solvable but no solution was made adapted to this implementation.
-// This is because of actor list changes causing minor solution incompatibilities, usually because
-// of ghost blocks that are always added last instead of were they should be at the start of level.
-// It's difficult to redo the solutions for these as there's no way to record them.
-constexpr std::tuple<level_pack_idx_t, level_idx_t> TEST_BLACKLIST[] = {
-        {3, 30},  // CCLP4 Level 31
-        {3, 64},  // CCLP4 Level 65
-};
-
-class Move {
-public:
-    uint32_t delta;
-    direction_mask_t direction;
-
-    Move(uint32_t delta, direction_mask_t direction)
-            : delta(delta), direction(direction) {}
-};
-
-class Solution {
-public:
-    uint32_t total_time;
-    uint8_t stepping;
-    direction_t initial_random_slide_dir;
-    uint32_t prng_seed;
-    std::vector<Move> moves;
-
-    Solution(uint32_t total_time, uint8_t stepping, direction_t initial_random_slide_dir,
-             uint32_t prng_seed, std::vector<Move> moves)
-            : total_time(total_time), stepping(stepping),
-              initial_random_slide_dir(initial_random_slide_dir),
-              prng_seed(prng_seed), moves(std::move(moves)) {}
-
-    template<typename T>
-    void iterate(T func) const {
-        uint32_t index = 0;
-        uint32_t time = 0;
-        while (true) {
-            if (time >= moves[index].delta) {
-                time -= moves[index].delta;
-                if (!func(moves[index].direction)) {
-                    return;
-                }
-                ++index;
-                if (index == moves.size()) {
-                    return;
-                }
-            } else if (!func(DIR_MASK_NONE)) {
-                return;
-            }
-            ++time;
-        }
-    }
-};
-
-/**
- * Used to load solutions from TWS files generated by Tile World. The file format is documented at:
- * https://github.com/Qalthos/Tile-World/blob/master/solution.c
- */
-class SolutionLoader {
-private:
-    std::vector<uint8_t> data;
-    size_t pos;
-
-public:
-    static constexpr direction_mask_t DIRECTIONS[] = {
-            DIR_NORTH_MASK,
-            DIR_WEST_MASK,
-            DIR_SOUTH_MASK,
-            DIR_EAST_MASK,
-            DIR_NORTHWEST_MASK,
-            DIR_SOUTHWEST_MASK,
-            DIR_NORTHEAST_MASK,
-            DIR_SOUTHEAST_MASK,
-    };
-
-    explicit SolutionLoader(std::ifstream& stream) : pos(0) {
-        data.insert(data.begin(), std::istreambuf_iterator<char>(stream),
-                    std::istreambuf_iterator<char>());
-
-        const std::array<uint8_t, 4> signature{0x35, 0x33, 0x9b, 0x99};
-        if (!std::equal(signature.begin(), signature.end(), data.begin())) {
-            throw std::runtime_error("Bad TWS signature");
-        }
-        if (data[4] != 1) {
-            throw std::runtime_error("Only Lynx ruleset supported");
-        }
-    }
-
-    Solution read_solution(level_idx_t level_number) {
-        pos = 8;
-        size_t end_pos;
-        bool found = false;
-        while (pos < data.size()) {
-            size_t offset = read(4);
-            if (offset == 0) {
-                continue;  // padding
-            }
-            end_pos = pos + offset;
-            uint16_t number = read(2);
-            if (number - 1 == level_number) {
-                found = true;
-                break;
-            }
-            pos = end_pos;
-        }
-        if (!found) {
-            throw std::runtime_error("level not found in TWS file");
-        }
-
-        pos += 5;
-        uint8_t initial_conditions = read(1);
-        auto initial_random_slide_dir = (direction_t) (initial_conditions & 0x7);
-        uint8_t stepping = (initial_conditions >> 3) & 0x7;
-
-        uint32_t prng_seed = read(4);
-        uint32_t total_time = read(4);
-        std::vector<Move> all_moves;
-        while (pos < end_pos) {
-            uint8_t b = data[pos];
-            std::vector<Move> moves;
-            if ((b & 0x3) == 0b00) {
-                auto new_moves = read_move_type3();
-                moves.insert(moves.end(), new_moves.begin(), new_moves.end());
-            } else if ((b & 0x3) == 0b01) {
-                moves.push_back(read_move_type1(1));
-            } else if ((b & 0x3) == 0b10) {
-                moves.push_back(read_move_type1(2));
-            } else if ((b & 0x10) == 0x10) {
-                moves.push_back(read_move_type4(((b >> 2) & 0x3) + 2));
-            } else if ((b & 0x10) == 0x00) {
-                moves.push_back(read_move_type2());
-            } else {
-                throw std::runtime_error("Unknown move encoding");
-            }
-
-            if (all_moves.empty()) {
-                // First move has -1 on delta
-                --moves[0].delta;
-            }
-            all_moves.insert(all_moves.end(), moves.begin(), moves.end());
-        }
-
-        if (pos != end_pos) {
-            throw std::runtime_error("Truncated move encoding");
-        }
-
-        return {total_time, stepping, initial_random_slide_dir, prng_seed,
-                std::move(all_moves)};
-    }
-
-private:
-    uint64_t read(size_t n) {
-        uint64_t val = 0;
-        for (size_t i = 0; i < n; ++i) {
-            val |= data[pos++] << (i * 8);
-        }
-        return val;
-    }
-
-    Move read_move_type1(size_t length) {
-        uint64_t move = read(length);
-        direction_mask_t direction = DIRECTIONS[(move >> 2) & 0x7];
-        uint32_t delta = (move >> 5) + 1;
-        return {delta, direction};
-    }
-
-    Move read_move_type2() {
-        uint64_t move = read(4);
-        direction_mask_t direction = DIRECTIONS[(move >> 2) & 0x3];
-        uint32_t delta = ((move >> 5) + 1) & 0x7fffff;
-        return {delta, direction};
-    }
-
-    std::array<Move, 3> read_move_type3() {
-        uint64_t move = read(1);
-        direction_mask_t direction0 = DIRECTIONS[(move >> 2) & 0x3];
-        direction_mask_t direction1 = DIRECTIONS[(move >> 4) & 0x3];
-        direction_mask_t direction2 = DIRECTIONS[(move >> 6) & 0x3];
-        return {Move(4, direction0), Move(4, direction1), Move(4, direction2)};
-    }
-
-    Move read_move_type4(size_t length) {
-        uint64_t move = read(length);
-        auto direction = (direction_mask_t) ((move >> 5) & 0x1ff);
-        if (std::find(std::begin(DIRECTIONS), std::end(DIRECTIONS),
-                      direction) == std::end(DIRECTIONS)) {
-            throw std::runtime_error("unsupported type 4 move encoding (mouse)");
-        }
-        uint32_t delta = (move >> 14) + 1;
-        return {delta, direction};
-    }
-};
-
 class LevelTestParam {
 public:
     level_pack_idx_t pack;
@@ -323,6 +124,42 @@ constexpr const char* DIRECTION_NAMES[] = {
         "east",
 };
 
+#ifdef TWORLD_PROFILE
+constexpr const char* PHASE_NAMES[] = {
+        "step_check",
+        "prestep",
+        "choose_moves",
+        "perform_moves",
+        "teleport",
+};
+
+/**
+ * Print the engine profile for a level: calls to the hottest engine functions per tick,
+ * and share of the host time spent in each phase of a tick.
+ */
+static void print_profile() {
+    const tworld_profile_t& profile = tworld_profile;
+    if (profile.ticks == 0) {
+        return;
+    }
+    uint64_t total_ns = 0;
+    for (uint64_t ns : profile.phase_ns) {
+        total_ns += ns;
+    }
+    const double ticks = profile.ticks;
+    std::cout << std::fixed << std::setprecision(1)
+              << "  " << profile.ticks << " ticks, " << (double) total_ns / ticks / 1000.0
+              << " us/tick; per tick: can_move " << profile.can_move_calls / ticks
+              << ", lookup_actor " << profile.lookup_actor_calls / ticks
+              << ", get_tile " << profile.get_tile_calls / ticks << ";";
+    for (int i = 0; i < TWORLD_PHASE_COUNT; ++i) {
+        std::cout << " " << PHASE_NAMES[i] << " "
+                  << (total_ns ? 100.0 * (double) profile.phase_ns[i] / (double) total_ns : 0.0) << "%";
+    }
+    std::cout << std::defaultfloat << std::endl;
+}
+#endif //TWORLD_PROFILE
+
 class LevelTest : public testing::TestWithParam<LevelTestParam> {
 };
 
@@ -341,7 +178,7 @@ static void do_state_update(std::optional<T>& out, direction_mask_t input) {
         std::ostream& stream = out.value();
         stream << "STEP TIME " << tworld.current_time << std::endl;
         for (actor_idx_t i = 0; i < tworld.actors_size; ++i) {
-            const active_actor_t act = tworld.actors[i];
+            const active_actor_t act = tworld_get_actor(i);
             const active_actor_t state = act_actor_get_state(act);
             const position_t pos = act_actor_get_pos(act);
             const actor_t tile = tworld_get_top_tile(pos);
@@ -375,7 +212,10 @@ TEST_P(LevelTest, level_test) {
 
     level_read_level();
     level_get_links();
-    tworld_cache_teleporters();
+    level_get_teleporters();
+#ifdef TWORLD_PROFILE
+    tworld_profile = tworld_profile_t{};
+#endif
 
     const Solution& solution = GetParam().solution;
     tworld.prng_value0 = solution.prng_seed;
@@ -408,6 +248,9 @@ TEST_P(LevelTest, level_test) {
 
     std::cout << "Level " << GetParam().pack_name << "/" << (GetParam().level + 1) << ": "
               << END_CAUSE_NAMES[tworld.end_cause] << std::endl;
+#ifdef TWORLD_PROFILE
+    print_profile();
+#endif
 
     if (EXPORT_ACTORS_FILE && tworld.end_cause != END_CAUSE_COMPLETE) {
         // Export actors file if test failed.
@@ -21,8 +21,11 @@ from assets.types import PackResult, DataObject, PackError
 # - [0..1]: signature, 0x5754 ('TW')
 # - [2]: number of levels (=N)
 # - [3]: index of first secret level.
-# - [4..(N*2)+1]: level index, with each entry being offset from previous level position.
-#     the first offset is from the start of level pack data
+# - [4..(N*3)+3]: level index, with each entry being the 3-byte position of level data
+#     from the start of level pack data, so that any level can be found with a single read.
+# - [(N*3)+4..(N*8)+3]: password table, with each entry being the 4 letters password of a level
+#     followed by the level index. Entries are sorted by password then level index, so that
+#     a password can be found with a binary search.
 # - level pack name: zero terminated string (max size 12 including terminator).
 # - level data:
 #     - [0]: level flags
@@ -30,12 +33,14 @@ from assets.types import PackResult, DataObject, PackError
 #     - [3..4]: required number of chips
 #     - [5..6]: layer data size in bytes
 #     - [7..10]: 4 letters password (only A-Z allowed)
-#     - [11..18]: index from the start position of level data to various chunks, in order:
+#     - [11..22]: index from the start position of level data to various chunks, in order:
 #         - [11..12]: title
 #         - [13..14]: hint (0 if none)
 #         - [15..16]: trap-button linkage
 #         - [17..18]: cloner-button linkage
-#     - [19..]: LZSS-compressed layer data. Uncompressed layout is:
+#         - [19..20]: initial actor list
+#         - [21..22]: teleporter list
+#     - [23..]: LZSS-compressed layer data. Uncompressed layout is:
 #         - [0..767]: bottom layer, 6-bit per tile
 #         - [768..1535]: top layer, 6-bit per tile
 #     - title: zero terminated string, max 40 chars
@@ -47,6 +52,17 @@ from assets.types import PackResult, DataObject, PackError
 #             - [1]: button y
 #             - [2]: trap/cloner x
 #             - [3]: trap/cloner y
+#         - links are sorted by button position in reading order, links with the same button
+#           keep their order from the original level.
+#     - initial actor list, in the order used by the game (Chip first, then reading order):
+#         - [0]: number of actors
+#         - [1..]: a list of actor positions, x then y.
+#     - teleporter list, in reading order:
+#         - [0..1]: number of teleporters
+#         - [2..]: a list of teleporter positions, x then y.
+#
+# The actor list, teleporter list and link order are all derived from the layers, they are
+# precomputed here so that the game doesn't have to scan the grid when a level is started.
 
 # All tiles are re-encoded in tworld from MS DAT IDs.
 # Not all tiles can appear on bottom and top layers.
@@ -344,13 +360,19 @@ class DatFileReader:
 
 class DatFileWriter:
     data: bytearray
+    fast_decode: bool
+    level_count: int
     levels_written: int
     warnings_count: int
-    _last_level_start: int
     _index_pos: int
+    _passwords: List[Tuple[bytes, int]]
+
+    INDEX_ENTRY_SIZE = 3
+    PASSWORD_ENTRY_SIZE = 5
 
-    def __init__(self, name: str, level_count: int):
+    def __init__(self, name: str, level_count: int, fast_decode: bool = False):
         self.data = bytearray()
+        self.fast_decode = fast_decode
         # signature
         self._write(0x5754, 2)
 
@@ -358,6 +380,7 @@ class DatFileWriter:
         if not (1 <= level_count <= 256):
             raise EncodeError(f"there must be between 1 and 256 levels (got {level_count})")
         self._write(level_count, 1)
+        self.level_count = level_count
 
         if level_count == 149:
             # "classic" level pack, first secret level is 145 (index 144).
@@ -368,10 +391,13 @@ class DatFileWriter:
 
         # index
         self.levels_written = 0
-        self._last_level_start = 0
         self._index_pos = len(self.data)
         for i in range(level_count):
-            self._write(0, 2)
+            self._write(0, DatFileWriter.INDEX_ENTRY_SIZE)
+
+        # password table, written once all levels are written.
+        self._passwords = []
+        self._write(0, level_count * DatFileWriter.PASSWORD_ENTRY_SIZE)
 
         # title
         name = name.upper()
@@ -704,7 +730,7 @@ class DatFileWriter:
         # compress data
         data = bottom_data
         data += top_data
-        compressed = lzss.encode(data)
+        compressed = lzss.encode(data, self.fast_decode)
         if lzss.decode(compressed) != data:
             raise EncodeError("compression error")
         self.data += compressed
@@ -718,12 +744,46 @@ class DatFileWriter:
         if len(linkage) > 32:
             raise EncodeError(f"there must be less than 32 links (got {len(linkage)})")
         self._write(len(linkage), 1)
-        for link in linkage:
+        # sort is stable, so the first link for a button stays first.
+        for link in sorted(linkage, key=lambda l: (l.btn_y, l.btn_x)):
             self._write(link.btn_x, 1)
             self._write(link.btn_y, 1)
             self._write(link.linked_x, 1)
             self._write(link.linked_y, 1)
 
+    def _write_actor_list(self, bottom_layer: List[Tile], top_layer: List[Actor]) -> None:
+        # Build actor list in reading order, excluding actors on static tiles, then swap Chip
+        # with the first actor. This must give the same list as the game used to build.
+        actors = []
+        chip_index = -1
+        for x, y in TileWorld.iterate_grid():
+            i = y * Level.GRID_WIDTH + x
+            entity = top_layer[i].entity()
+            if entity == Entity.CHIP:
+                chip_index = len(actors)
+            elif not entity.is_on_actor_list() or bottom_layer[i].is_static():
+                continue
+            actors.append((x, y))
+
+        if chip_index == -1:
+            raise EncodeError("no chip tile found in level")
+        if len(actors) > 255:
+            raise EncodeError(f"too many actors for actor list (got {len(actors)})")
+        actors[0], actors[chip_index] = actors[chip_index], actors[0]
+
+        self._write(len(actors), 1)
+        for x, y in actors:
+            self._write(x, 1)
+            self._write(y, 1)
+
+    def _write_teleporter_list(self, bottom_layer: List[Tile]) -> None:
+        teleporters = [(x, y) for x, y in TileWorld.iterate_grid()
+                       if bottom_layer[y * Level.GRID_WIDTH + x] == Tile.TELEPORTER]
+        self._write(len(teleporters), 2)
+        for x, y in teleporters:
+            self._write(x, 1)
+            self._write(y, 1)
+
     def write_level(self, level: MsLevelData) -> None:
         flags = 0
         bottom_layer, top_layer = self._convert_layers(level)
@@ -742,9 +802,8 @@ class DatFileWriter:
 
         # write index entry
         start_pos = len(self.data)
-        self._write(start_pos - self._last_level_start, 2,
-                    at=(self.levels_written * 2) + self._index_pos)
-        self._last_level_start = start_pos
+        self._write(start_pos, DatFileWriter.INDEX_ENTRY_SIZE,
+                    at=self.levels_written * DatFileWriter.INDEX_ENTRY_SIZE + self._index_pos)
 
         self._write(flags, 1)
         self._write(level.time_limit, 2)
@@ -754,8 +813,9 @@ class DatFileWriter:
         if not re.fullmatch(r"[A-Z]{4}", level.password):
             raise EncodeError("password must be 4 letters")
         self.data += level.password.encode("ascii")
+        self._passwords.append((level.password.encode("ascii"), self.levels_written))
 
-        self._write(0, 2 * 4)  # reserve space for index
+        self._write(0, 2 * 6)  # reserve space for index
 
         layer_data_size = self._write_layers(bottom_layer, top_layer)
         self._write(layer_data_size, 2, at=start_pos + 5)
@@ -781,7 +841,22 @@ class DatFileWriter:
         self._write(len(self.data) - start_pos, 2, at=start_pos + 17)
         self._write_linkage(level.cloner_linkage)
 
+        self._write(len(self.data) - start_pos, 2, at=start_pos + 19)
+        self._write_actor_list(bottom_layer, top_layer)
+
+        self._write(len(self.data) - start_pos, 2, at=start_pos + 21)
+        self._write_teleporter_list(bottom_layer)
+
         self.levels_written += 1
+        if self.levels_written == self.level_count:
+            self._write_password_table()
+
+    def _write_password_table(self) -> None:
+        pos = self._index_pos + self.level_count * DatFileWriter.INDEX_ENTRY_SIZE
+        for password, index in sorted(self._passwords):
+            self.data[pos:pos + 4] = password
+            self.data[pos + 4] = index
+            pos += DatFileWriter.PASSWORD_ENTRY_SIZE
 
     def write_file(self, filename: Path) -> None:
         try:
@@ -796,6 +871,8 @@ class Config:
     input_file: Path
     output_file: Path
     name: str
+    # favor faster decoding over smaller size when compressing layers.
+    fast_decode: bool
 
 
 def create_config(args: argparse.Namespace) -> Config:
@@ -809,7 +886,7 @@ def create_config(args: argparse.Namespace) -> Config:
     elif output_file.is_dir():
         output_file = Path(output_file, "output.dat")
 
-    return Config(input_file, output_file, input_file.stem)
+    return Config(input_file, output_file, input_file.stem, args.fast_decode)
 
 
 def readable_size(size: int) -> str:
@@ -826,7 +903,7 @@ def readable_size(size: int) -> str:
 
 def create_level_data(config: Config) -> bytes:
     levels = DatFileReader(config.input_file).read_levels()
-    writer = DatFileWriter(config.name, len(levels))
+    writer = DatFileWriter(config.name, len(levels), config.fast_decode)
     for i, level in enumerate(levels):
         print(f"LEVEL {config.name}/{level.number}")
         writer.write_level(level)
@@ -842,11 +919,18 @@ def create_level_data(config: Config) -> bytes:
 class LevelPackObject(DataObject):
     file: Path
     name: str
+    fast_decode: bool
 
     def pack(self) -> PackResult:
         try:
             with open(self.file, "rb") as file:
-                sha = sha256(file.read()).hexdigest()
+                sha = sha256(file.read())
+            # the result also depends on the converter, the compression encoder and its options.
+            for source in (__file__, lzss.__file__):
+                with open(source, "rb") as file:
+                    sha.update(file.read())
+            sha.update(bytes([self.fast_decode]))
+            sha = sha.hexdigest()
         except IOError as e:
             raise PackError(f"encoding error: could not read file: {e}")
 
@@ -858,7 +942,7 @@ class LevelPackObject(DataObject):
             with open(cached_file, "rb") as file:
                 return PackResult(file.read())
 
-        config = Config(self.file, cached_file, self.name)
+        config = Config(self.file, cached_file, self.name, self.fast_decode)
         try:
             data = create_level_data(config)
             return PackResult(data)
@@ -871,8 +955,8 @@ class LevelPackObject(DataObject):
 
 def register_builder(packer) -> None:
     @packer.file_builder
-    def level_pack(filename: Path, name: str):
-        yield LevelPackObject(filename, name)
+    def level_pack(filename: Path, name: str, fast_decode: bool = False):
+        yield LevelPackObject(filename, name, fast_decode)
 
 
 def main() -> None:
@@ -889,6 +973,10 @@ parser.add_argument(
 parser.add_argument(
     "-o", "--output", action="store", type=str, default="", dest="output_file",
     help=f"Output DAT file (output.dat by default)")
+parser.add_argument(
+    "-f", "--fast-decode", action="store_true", dest="fast_decode",
+    help="Compress layers with fewer and longer back references, for faster decoding "
+         "at the cost of a slightly larger size.")
 
 if __name__ == '__main__':
     try:
@@ -1,5 +1,3 @@
-from collections import deque
-
 # Simple LZSS implementation
 # - Token type is indicated by a byte, with a 0 bit indicating a raw byte and a 1 bit indicating
 #   a back reference. The first token of the stream is always a token type byte.
@@ -9,6 +7,7 @@ from collections import deque
 #    - 2 bytes: 8-bit distance (-1), 7-bit length (-3), 1-bit flag = 0x1
 #    - 1 byte:  5-bit distance (-1), 2-bit length (-2), 1-bit flag = 0x0
 # - 256 bytes window size
+# - The encoder uses an optimal parse, see `encode`.
 
 DISTANCE_BITS1 = 5
 DISTANCE_BITS2 = 8
@@ -30,10 +29,61 @@ MAX_LENGTH2 = 2 ** LENGTH_BITS2 - 1 + BREAKEVEN2
 LENGTH_MASK1 = 2 ** LENGTH_BITS1 - 1
 LENGTH_MASK2 = 2 ** LENGTH_BITS2 - 1
 
-def encode(data: bytes) -> bytes:
-    out = bytearray()
-    window = deque()
+# Size in bits of each token, including its bit in the token type byte.
+LITERAL_BITS = 9
+BACKREF_BITS1 = 9
+BACKREF_BITS2 = 17
+
+
+def encode(data: bytes, fast_decode: bool = False) -> bytes:
+    """Encode data with an optimal parse: the sequence of tokens is chosen by dynamic programming
+    to minimize the encoded size. If `fast_decode` is true, the number of tokens is minimized
+    first instead, favoring longer back references which are faster to decode, then the size.
+    The size is exact within a byte, since the type byte overhead is counted per token."""
+    n = len(data)
+    # weights of the size in bits and of the number of tokens in the cost of a parse.
+    # the weight of the primary criterion is larger than any value of the secondary one.
+    weight = BACKREF_BITS2 * (n + 1)
+    bits_weight, token_weight = (1, weight) if fast_decode else (weight, 1)
+    literal_cost = LITERAL_BITS * bits_weight + token_weight
+    backref_cost1 = BACKREF_BITS1 * bits_weight + token_weight
+    backref_cost2 = BACKREF_BITS2 * bits_weight + token_weight
+
+    # cost[i] is the cost of encoding data[i:], token[i] is the first token used for it,
+    # as (length, distance), with a distance of 0 for a raw byte.
+    cost = [0] * (n + 1)
+    token = [(1, 0)] * n
+
+    # lengths[d] is the match length at the current position for a distance of d.
+    # Since the decoder copies byte by byte, matches can overlap the current position.
+    lengths = [0] * (MAX_DISTANCE2 + 1)
+    for i in reversed(range(n)):
+        b = data[i]
+        max_distance = min(i, MAX_DISTANCE2)
+        lengths = [0] + [(l + 1 if l < MAX_LENGTH2 else l) if c == b else 0
+                         for l, c in zip(lengths[1:], data[i - max_distance:i][::-1])]
+
+        best_cost = cost[i + 1] + literal_cost
+        best_token = (1, 0)
+        if max_distance > 0:
+            # longest matches reachable with each encoding, any shorter length is also valid.
+            distance1 = max(range(1, min(max_distance, MAX_DISTANCE1) + 1),
+                            key=lengths.__getitem__)
+            distance2 = max(range(1, max_distance + 1), key=lengths.__getitem__)
+            for length in range(BREAKEVEN1, min(lengths[distance1], MAX_LENGTH1) + 1):
+                c = cost[i + length] + backref_cost1
+                if c < best_cost:
+                    best_cost = c
+                    best_token = (length, distance1)
+            for length in range(BREAKEVEN2, lengths[distance2] + 1):
+                c = cost[i + length] + backref_cost2
+                if c < best_cost:
+                    best_cost = c
+                    best_token = (length, distance2)
+        cost[i] = best_cost
+        token[i] = best_token
 
+    out = bytearray()
     type_bits = 8
     type_pos = 0
 
@@ -47,58 +97,22 @@ def encode(data: bytes) -> bytes:
         type_bits += 1
 
     i = 0
-
-    while i < len(data):
-        # find maximum subsequence length within window
-        max_seq_pos = -1
-        max_seq = 0
-        for j in reversed(range(len(window))):
-            start_pos = j
-            seq_len = 0
-            while window[j] == data[i]:
-                i += 1
-                j += 1
-                seq_len += 1
-                if seq_len == MAX_LENGTH2 or i == len(data):
-                    break
-                if j == len(window):
-                    j = start_pos
-            i -= seq_len
-            if seq_len > max_seq:
-                max_seq_pos = start_pos
-                max_seq = seq_len
-                if seq_len == len(data) - i:
-                    # reached end of data, no sequence will be longer
-                    break
-
-        distance = len(window) - max_seq_pos
-        single_byte_backref = max_seq <= MAX_LENGTH1 and distance <= MAX_DISTANCE1
-        if single_byte_backref and max_seq >= BREAKEVEN1 or max_seq >= BREAKEVEN2:
-            # append back ref token
-            append_token_type(1)
-            if single_byte_backref:
-                # single byte encoding
-                backref = (distance - 1) << (LENGTH_BITS1 + 1) | (max_seq - BREAKEVEN1) << 1 | 0x0
-                out.append(backref)
-            else:
-                # two bytes encoding
-                backref = (distance - 1) << (LENGTH_BITS2 + 1) | (max_seq - BREAKEVEN2) << 1 | 0x1
-                out += backref.to_bytes(2, "little")
-            # update window
-            for j in range(max_seq):
-                b = window[max_seq_pos + j]
-                window.append(b)
-            i += max_seq
-        else:
+    while i < n:
+        length, distance = token[i]
+        if distance == 0:
             # append byte token
             append_token_type(0)
-            b = data[i]
-            out.append(b)
-            # update window
-            window.append(b)
-            i += 1
-        while len(window) > WINDOW_SIZE:
-            window.popleft()
+            out.append(data[i])
+        elif length <= MAX_LENGTH1 and distance <= MAX_DISTANCE1:
+            # single byte encoding
+            append_token_type(1)
+            out.append((distance - 1) << (LENGTH_BITS1 + 1) | (length - BREAKEVEN1) << 1 | 0x0)
+        else:
+            # two bytes encoding
+            append_token_type(1)
+            backref = (distance - 1) << (LENGTH_BITS2 + 1) | (length - BREAKEVEN2) << 1 | 0x1
+            out += backref.to_bytes(2, "little")
+        i += length
 
     return out
 
@@ -26,6 +26,17 @@ TILE_WIDTH_TOP = 12
 TILE_WIDTH_BOTTOM = 16
 TILE_PADDING_BOTTOM = 1
 
+# bottom tile rows with the same value for all middle bytes are stored as span rows:
+# the first byte, the value of middle bytes, and the last byte.
+# The mask of span rows (bit N being set for row N) isn't part of the tile data, it's returned
+# by the tileset builder to be stored in internal memory, see `span_mask`.
+SPAN_MASK_SIZE = 2
+
+# top tile rows that are fully transparent above and below the actor aren't read nor drawn.
+# The first row and the number of rows left are stored in internal memory for each top tile,
+# in the low and high nibbles of a byte, see `rows_extent`. The tile data is unchanged so
+# that all tiles still have the same size.
+
 # bit position for alpha bits and color nibbles in top tiles (total size = 64 bits)
 TOP_COLOR_POS = [8,  12, 16, 20, 24, 28, 40, 44, 48, 52, 56, 60]
 TOP_ALPHA_POS = [0,  1,  2,  3,  4,  5,  32, 33, 34, 35, 36, 37]
@@ -35,6 +46,37 @@ def color_4bit(value: int) -> int:
     return math.floor((value / 256) * 16)
 
 
+def bottom_tile_row(image: Image, y: int) -> bytes:
+    row = 0
+    for x in range(TILE_WIDTH_BOTTOM):
+        px = x - TILE_PADDING_BOTTOM
+        color = image.getpixel((px, y)) \
+            if 0 <= px < TILE_WIDTH_BOTTOM - 2 * TILE_PADDING_BOTTOM else 0
+        row |= color_4bit(color) << (x * 4)
+    return row.to_bytes(TILE_WIDTH_BOTTOM // 2, "little")
+
+
+def is_span_row(row_data: bytes) -> bool:
+    return len(set(row_data[1:-1])) == 1
+
+
+def span_mask(image: Image) -> int:
+    """Returns the mask of span rows for a bottom tile image."""
+    mask = 0
+    for y in range(TILE_HEIGHT):
+        if is_span_row(bottom_tile_row(image, y)):
+            mask |= 1 << y
+    return mask
+
+
+def rows_extent(image: Image) -> int:
+    """Returns the rows extent byte for a top tile image: the first row with an opaque pixel
+    in the low nibble and the number of rows up to the last one in the high nibble."""
+    rows = [y for y in range(TILE_HEIGHT)
+            if any(image.getpixel((x, y))[1] > 128 for x in range(TILE_WIDTH_TOP))]
+    return rows[0] | (rows[-1] - rows[0] + 1) << 4
+
+
 @dataclass(frozen=True)
 class TileObject(DataObject):
     image: Image
@@ -43,24 +85,20 @@ class TileObject(DataObject):
     def pack(self) -> PackResult:
         data = bytearray()
         for y in range(TILE_HEIGHT):
-            row = 0
             if self.alpha:
+                row = 0
                 nibbles = TILE_WIDTH_TOP + 4  # +2 bytes for alpha
                 for x in range(TILE_WIDTH_TOP):
                     color = self.image.getpixel((x, y))
                     if color[1] > 128:
                         row |= 1 << TOP_ALPHA_POS[x]
                     row |= color_4bit(color[0]) << TOP_COLOR_POS[x]
+                data += row.to_bytes(nibbles // 2, "little")
             else:
-                nibbles = TILE_WIDTH_BOTTOM
-                for x in range(TILE_WIDTH_BOTTOM):
-                    px = x - TILE_PADDING_BOTTOM
-                    color = self.image.getpixel((px, y)) \
-                        if 0 <= px < TILE_WIDTH_BOTTOM - 2 * TILE_PADDING_BOTTOM else 0
-                    row |= color_4bit(color) << (x * 4)
-
-            data += row.to_bytes(nibbles // 2, "little")
-
+                row_data = bottom_tile_row(self.image, y)
+                if is_span_row(row_data):
+                    row_data = row_data[:2] + row_data[-1:]
+                data += row_data
         return PackResult(data)
 
     def get_type_name(self) -> str:
@@ -74,8 +112,12 @@ def register_builder(packer) -> None:
         # Create a data object for each tile in the tileset by cropping the image.
         # Also create a map to deduplicate the tiles. Each index in the map is a tile ID and
         # the value is the position in the generated tile objects array.
+        # For bottom tiles, the span rows mask of each tile object is also returned, as a
+        # little-endian table indexed by position, to be stored in internal memory.
+        # For top tiles, the rows extent of each tile object is returned instead.
         img_map = {}
         map_flat = []
+        rows_data = bytearray()
         pos = 0
 
         for i in range(1 if not variants else variants):
@@ -106,7 +148,11 @@ def register_builder(packer) -> None:
                     if data not in img_map:
                         img_map[data] = pos
                         yield TileObject(tile_img, alpha)
+                        if alpha:
+                            rows_data.append(rows_extent(tile_img))
+                        else:
+                            rows_data += span_mask(tile_img).to_bytes(SPAN_MASK_SIZE, "little")
                         pos += 1
                     map_flat.append(img_map[data])
 
-        return map_flat
+        return map_flat, rows_data
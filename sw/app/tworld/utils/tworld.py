@@ -1602,10 +1602,8 @@ class LevelLoader:
     def _read_index(self) -> None:
         self._index = []
         self._pos = 4
-        addr = 0
         for i in range(self.level_count):
-            addr += self._read(2)
-            self._index.append(addr)
+            self._index.append(self._read(3))
 
     def _read_linkage(self, pos: int) -> List[Link]:
         self._pos = pos
@@ -1619,6 +1617,16 @@ class LevelLoader:
             links.append(Link((btn_x, btn_y), (link_x, link_y)))
         return links
 
+    def _read_teleporters(self, pos: int) -> List[Position]:
+        self._pos = pos
+        count = self._read(2)
+        teleporters = []
+        for i in range(count):
+            x = self._read(1)
+            y = self._read(1)
+            teleporters.append((x, y))
+        return teleporters
+
     def load(self, level_number: int) -> Level:
         assert level_number > 0
         start_pos = self._index[level_number - 1]
@@ -1635,6 +1643,8 @@ class LevelLoader:
         hint_pos = start_pos + self._read(2)
         trap_link_pos = start_pos + self._read(2)
         cloner_link_pos = start_pos + self._read(2)
+        self._read(2)  # actor list, rebuilt from layers by the simulation
+        teleporters_pos = start_pos + self._read(2)
 
         grid_data_encoded = self._data[self._pos:self._pos + layer_data_size]
         grid_data = lzss.decode(grid_data_encoded)
@@ -1653,10 +1663,7 @@ class LevelLoader:
             bottom_layer.append(Tile(layer_data[i]))
             top_layer.append(Actor(layer_data[Level.GRID_SIZE + i]))
 
-        teleporters = []
-        for i in range(Level.GRID_SIZE):
-            if bottom_layer[i] == Tile.TELEPORTER:
-                teleporters.append((i % Level.GRID_WIDTH, i // Level.GRID_WIDTH))
+        teleporters = self._read_teleporters(teleporters_pos)
         if len(teleporters) > TileWorld.MAX_TELEPORTERS and \
                 not (flags & Level.FLAG_SCAN_TELEPORTERS):
             raise TWException("too many teleporters for prebuilt list")
@@ -1,16 +1,26 @@
-#!/usr/bin/env python3
-
 import argparse
+import hashlib
+import os
+import pickle
 import time
+from concurrent.futures import ProcessPoolExecutor
+from contextlib import nullcontext
 from pathlib import Path
-from typing import Optional, TextIO, Iterable
+from typing import Optional, TextIO, Iterable, List, Tuple
 
+import tworld
+import tworld_tws
 from tworld import TWException, LevelLoader, TileWorld, EndCause, Level, ActiveActor
 from tworld_tws import SolutionLoader, Solution
 
+# directory in which loaded levels and solutions are cached, in the working directory.
+CACHE_DIR = Path("build/tworld_test_cache")
+
 
-def validate_solution(level: Level, solution: Solution, export_file: TextIO) -> EndCause:
-    # step through the whole solution until done or game is over (should be both).
+def validate_solution(level: Level, solution: Solution,
+                      export_file: Optional[TextIO]) -> Tuple[EndCause, Optional[str]]:
+    """Step through the whole solution until done or game is over (should be both).
+    Returns the end cause and the error message if a check failed."""
     state = TileWorld(level, silent=True)
     state.stepping = solution.stepping
     state.initial_random_slide_dir = solution.initial_random_slide_dir
@@ -36,22 +46,29 @@ def validate_solution(level: Level, solution: Solution, export_file: TextIO) ->
         try:
             step(direction)
         except TWException as e:
-            print(f"check failed: {e}")
-            break
+            return state.end_cause, f"check failed: {e}"
     else:
         # step until the end of solution, with no input.
         while state.current_time < solution.total_time:
             step(0)
 
-    return state.end_cause
+    return state.end_cause, None
 
 
-def validate_solutions(level_file: Path, solution_file: Path,
-                       level_numbers: Optional[Iterable[int]],
-                       export_dir: Optional[Path]) -> None:
-    start_time = time.time()
+def load_pack(level_file: Path, solution_file: Path) -> Tuple[List[Level], List[Solution]]:
+    """Load all levels and solutions of a level pack. The result is cached in binary form,
+    keyed by the content of both files and of the loaders source."""
+    sha = hashlib.sha256()
+    for filename in (level_file, solution_file, tworld.__file__, tworld_tws.__file__):
+        with open(filename, "rb") as file:
+            sha.update(file.read())
+    cache_file = CACHE_DIR / f"{sha.hexdigest()}.pickle"
+    try:
+        with open(cache_file, "rb") as file:
+            return pickle.load(file)
+    except (IOError, pickle.PickleError, EOFError):
+        pass
 
-    # load all levels and solutions
     level_loader = LevelLoader(level_file)
     sol_loader = SolutionLoader(solution_file)
     levels = []
@@ -64,68 +81,102 @@ def validate_solutions(level_file: Path, solution_file: Path,
             print(f"bad solution for level {i} ({e})")
             solutions.append(None)
 
-    # load previous results for regression check
-    results_filename = Path(f"{level_file.stem}.txt")
-    if results_filename.exists():
-        with open(results_filename, "r") as file:
-            last_results = [int(line) == 1 for line in file.readlines()]
-    else:
-        last_results = [False] * level_loader.level_count
+    CACHE_DIR.mkdir(parents=True, exist_ok=True)
+    with open(cache_file, "wb") as file:
+        pickle.dump((levels, solutions), file)
+    return levels, solutions
 
-    if level_numbers is None:
-        level_numbers = range(level_loader.level_count)
 
-    success = 0
-    for i in level_numbers:
-        export_file = None
-        if export_dir:
-            export_file = open(export_dir / f"{level_file.stem.upper()}L{i + 1:03}.txt", "w")
+def validate_level(level: Level, solution: Optional[Solution],
+                   export_filename: Optional[Path]) -> Tuple[EndCause, Optional[str]]:
+    """Validate a single level, in a worker process."""
+    if not solution:
+        return EndCause.NONE, "no solution"
+    if not export_filename:
+        return validate_solution(level, solution, None)
+    with open(export_filename, "w") as export_file:
+        return validate_solution(level, solution, export_file)
 
-        end_cause = validate_solution(levels[i], solutions[i], export_file)
 
-        if export_file:
-            export_file.close()
-
-        passed = False
-        print(f"{level_file.name}/{i + 1}: ", end="")
-        if end_cause == EndCause.COMPLETE:
-            print("passed")
-            success += 1
-            passed = True
-        elif end_cause == EndCause.NONE:
-            print("failed, exit not reached")
+def results_filename(level_file: Path) -> Path:
+    return Path(f"{level_file.stem}.txt")
+
+
+def validate_solutions(packs: List[Tuple[Path, Path]],
+                       level_numbers: Optional[Iterable[int]],
+                       export_dir: Optional[Path], jobs: int) -> None:
+    start_time = time.time()
+
+    tasks = []
+    last_results = []
+    for pack, (level_file, solution_file) in enumerate(packs):
+        levels, solutions = load_pack(level_file, solution_file)
+
+        # load previous results for regression check
+        if results_filename(level_file).exists():
+            with open(results_filename(level_file), "r") as file:
+                last_results.append([int(line) == 1 for line in file.readlines()])
         else:
-            print(f"failed, unexpected end ({end_cause.name})")
+            last_results.append([False] * len(levels))
 
-        if last_results[i] and not passed:
-            print("--> REGRESSION")
-        last_results[i] |= passed
+        for i in range(len(levels)) if level_numbers is None else level_numbers:
+            export_filename = None
+            if export_dir:
+                export_filename = export_dir / f"{level_file.stem.upper()}L{i + 1:03}.txt"
+            tasks.append((pack, i, levels[i], solutions[i], export_filename))
+
+    # levels of all packs are validated in parallel, results are reported in order.
+    success = 0
+    with ProcessPoolExecutor(max_workers=jobs) if jobs > 1 else nullcontext() as executor:
+        if executor:
+            futures = [executor.submit(validate_level, *task[2:]) for task in tasks]
+            results = (future.result() for future in futures)
+        else:
+            results = (validate_level(*task[2:]) for task in tasks)
+        for (pack, i, *_), (end_cause, error) in zip(tasks, results):
+            if error:
+                print(error)
+
+            passed = False
+            print(f"{packs[pack][0].name}/{i + 1}: ", end="")
+            if end_cause == EndCause.COMPLETE:
+                print("passed")
+                success += 1
+                passed = True
+            elif end_cause == EndCause.NONE:
+                print("failed, exit not reached")
+            else:
+                print(f"failed, unexpected end ({end_cause.name})")
+
+            if last_results[pack][i] and not passed:
+                print("--> REGRESSION")
+            last_results[pack][i] |= passed
 
     print("===============")
-    print(f"{success} levels passed out of {len(level_numbers)}, "
-          f"{success / len(level_numbers):.1%} pass rate")
+    print(f"{success} levels passed out of {len(tasks)}, "
+          f"{success / len(tasks):.1%} pass rate")
     print(f"total time: {time.time() - start_time:.0f} seconds")
 
-    with open(results_filename, "w") as file:
-        file.writelines([f"{int(i)}\n" for i in last_results])
-        file.close()
+    for (level_file, _), results in zip(packs, last_results):
+        with open(results_filename(level_file), "w") as file:
+            file.writelines([f"{int(i)}\n" for i in results])
 
 
 def main() -> None:
     args = parser.parse_args()
 
-    # load level from level pack file
-    level_file = Path(args.level_pack)
-    if not level_file.exists():
-        raise TWException("level pack doesn't exist")
-
-    solution_file = Path(args.solution)
-    if not solution_file.exists():
-        raise TWException("solution file doesn't exist")
-
-    # validate all levels (used as unit testing)
-    if not solution_file:
-        raise TWException("--validate requires passing a solution file")
+    # level packs and solution files are given in pairs
+    if len(args.files) % 2 != 0:
+        raise TWException("each level pack must be followed by its solution file")
+    packs = []
+    for level_pack, solution in zip(args.files[::2], args.files[1::2]):
+        level_file = Path(level_pack)
+        if not level_file.exists():
+            raise TWException(f"level pack '{level_pack}' doesn't exist")
+        solution_file = Path(solution)
+        if not solution_file.exists():
+            raise TWException(f"solution file '{solution}' doesn't exist")
+        packs.append((level_file, solution_file))
 
     export_dir = args.export_dir
     if export_dir:
@@ -136,22 +187,22 @@ def main() -> None:
     if args.level:
         levels = [args.level - 1]
 
-    validate_solutions(level_file, solution_file, levels, export_dir)
+    validate_solutions(packs, levels, export_dir, args.jobs)
 
 
 parser = argparse.ArgumentParser(description="Tile world level pack validation")
 parser.add_argument(
-    "level_pack", action="store", type=str,
-    help="Level pack to validate")
-parser.add_argument(
-    "solution", action="store", type=str,
-    help="TWS solution file for level pack used for validation.")
+    "files", action="store", type=str, nargs="+", metavar="level_pack solution",
+    help="Level packs to validate, each followed by the TWS solution file used for validation.")
 parser.add_argument(
     "--export-dir", action="store", type=str, dest="export_dir",
     help="Directory in which to export state of actors on all steps, for all levels.")
 parser.add_argument(
     "--level", action="store", type=int, dest="level", default=None,
-    help="Specific level to validate, all levels by default.")
+    help="Specific level to validate in each pack, all levels by default.")
+parser.add_argument(
+    "-j", "--jobs", action="store", type=int, dest="jobs", default=os.cpu_count(),
+    help="Number of levels validated in parallel, the number of CPUs by default.")
 
 if __name__ == '__main__':
     try:
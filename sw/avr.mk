@@ -1,13 +1,38 @@
 
-PLATFORM := avr
+# Functions marked with AVR_OPTIMIZE are built with -O3 (see core/defs.h). With OPTIMIZE=none or
+# OPTIMIZE=all, none or all of them are, in a separate build directory, to measure the size of
+# each function both ways for utils/optimize_select.py. Otherwise, if the app has an optimize.h
+# header generated by that script, only the functions it selected are.
+ifeq ($(OPTIMIZE),none)
+  PLATFORM := avr-optimize-none
+  DEFINES += OPTIMIZE_NONE
+else ifeq ($(OPTIMIZE),all)
+  PLATFORM := avr-optimize-all
+else
+  PLATFORM := avr
+  ifneq ($(wildcard $(TARGET)/include/optimize.h),)
+    DEFINES += OPTIMIZE_AUTO
+  endif
+endif
 
 include common.mk
 include toolchain.mk
 
 # MCU definitions
-MCU := atmega3208
+MCU ?= atmega3208
 F_CPU := 10000000
 
+# The peripheral code in sys/ (clock, NVM programming, fuses) and the OUTPUT_ARCH of common.ld
+# target the ATmega3208 only, the firmware built for another MCU wouldn't run.
+ifneq ($(MCU),atmega3208)
+  $(error Unsupported MCU '$(MCU)', sys/ and common.ld must be ported to it first)
+endif
+
+# The full frame buffer takes 8 kB of RAM, more than the ATmega3208 has (see common.mk).
+ifeq ($(FULL_FRAME),1)
+  $(error Not enough RAM on $(MCU) for FULL_FRAME=1, it can only be used in the simulator)
+endif
+
 SRC_DIRS += sys
 
 # AVR compilation
@@ -27,7 +52,8 @@ DEFINES += F_CPU=$(F_CPU)
 CFLAGS += -mmcu=$(MCU) -Os -mcall-prologues \
           -ffunction-sections -fdata-sections -fshort-enums -flto \
           -B$(ATMEGA_DFP_DIR)gcc/dev/$(MCU) -Wl,-T,$(LINKER_SCRIPT)      \
-          -Wl,-Map=$(MAP_FILE) -Wl,--defsym=DISPLAY_PAGE_HEIGHT=$(display_page_height)
+          -Wl,-Map=$(MAP_FILE) -Wl,--defsym=DISPLAY_PAGE_HEIGHT=$(display_page_height) \
+          -Wl,--defsym=DISPLAY_MAX_PAGE_HEIGHT=$(display_max_page_height)
 
 OBJECTS += $(addprefix $(BUILD_DIR)/, $(ASOURCES:.S=.o))
 DEPS += $(addprefix $(BUILD_DIR)/, $(CSOURCES:.S=.d))
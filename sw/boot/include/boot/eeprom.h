@@ -26,4 +26,10 @@
  */
 void sys_eeprom_check_write(void);
 
+/**
+ * Advance the queued write by one step if the EEPROM isn't busy, without waiting.
+ * Each step writes at most one page. This is called on every main loop iteration.
+ */
+void sys_eeprom_update(void);
+
 #endif //BOOT_EEPROM_H
@@ -89,4 +89,11 @@ void sys_power_schedule_sleep_cancel(void);
  */
 void sys_power_enable_sleep(void);
 
+/**
+ * Idle the CPU until the next interrupt, unless `sys_power_skip_idle` was called since the last
+ * time this was called. Peripherals and timers keep running, the RTC interrupt for the system
+ * time wakes up the CPU at least 256 times per second.
+ */
+void sys_power_idle(void);
+
 #endif //BOOT_POWER_H
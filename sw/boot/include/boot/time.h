@@ -0,0 +1,26 @@
+
+/*
+ * Copyright 2021 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef BOOT_TIME_H
+#define BOOT_TIME_H
+
+/**
+ * Restore the normal system tick rate if tickless mode is active.
+ * This is called on any button edge so that input is sampled at the normal rate again.
+ */
+void sys_time_exit_tickless(void);
+
+#endif //BOOT_TIME_H
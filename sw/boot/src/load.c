@@ -22,6 +22,7 @@
 #include <sys/callback.h>
 #include <sys/display.h>
 #include <sys/app.h>
+#include <sys/ram.h>
 
 #include <core/graphics.h>
 #include <core/flash.h>
@@ -33,8 +34,10 @@
 #include <core/led.h>
 #include <core/input.h>
 #include <avr/io.h>
-#include <util/crc16.h>
 #include <util/delay.h>
+
+// start of the display buffer, the app data and stack are located after it (see app.ld).
+extern uint8_t __disp_buf_start;
 #endif
 
 #include <string.h>
@@ -56,10 +59,15 @@ typedef struct {
     eeprom_t eeprom_offset;
     uint16_t eeprom_size;
     flash_t address;
+    uint8_t target_fps;
+    uint8_t min_fps;
+    uint8_t align_bits;
 } PACK_STRUCT app_flash_t;
 
 static BOOTLOADER_ONLY app_flash_t _app_index[APP_INDEX_SIZE];
 static BOOTLOADER_ONLY uint8_t _app_count;
+// position of each app in the flash index.
+static BOOTLOADER_ONLY uint8_t _app_slot[APP_INDEX_SIZE];
 
 static BOOTLOADER_ONLY uint8_t _loaded_app_id[3];  // ID + full CRC
 static BOOTLOADER_ONLY uint8_t _loaded_app_index;
@@ -71,6 +79,10 @@ static void _load_app_setup(uint8_t id) {
     // latch input so that apps don't see a click immediately on startup.
     input_latch();
 
+    // paint all RAM past the shared data, so that the stack high-water mark reflects
+    // only the app usage. The app data is initialized over it by the setup callback.
+    sys_ram_paint_stack(&__disp_buf_start);
+
     __callback_setup();
 #endif
 }
@@ -79,25 +91,36 @@ void load_read_index(void) {
     _app_count = 0;
     _loaded_app_index = LOADED_APP_NONE;
 
-    // check signature
-    uint16_t signature;
-    sys_flash_read_absolute(0, sizeof signature, &signature);
+    // check signature and read the mask of used index entries along with it.
+    struct {
+        uint16_t signature;
+        uint32_t index_mask;
+    } PACK_STRUCT header;
+    sys_flash_read_absolute(0, sizeof header, &header);
 
-    if (signature == SYS_FLASH_SIGNATURE) {
+    if (header.signature == SYS_FLASH_SIGNATURE) {
         sys_eeprom_read_absolute(SYS_EEPROM_APP_ID_ADDR, sizeof _loaded_app_id, &_loaded_app_id);
 
-        // signature correct, read index
+        // signature correct, read used index entries (all of them if mask wasn't written).
+        uint32_t mask = header.index_mask;
+        if (mask == 0) {
+            mask = UINT32_MAX;
+        }
         uint16_t address = SYS_FLASH_INDEX_ADDR;
         app_flash_t *index = _app_index;
         for (uint8_t i = 0; i < APP_INDEX_SIZE; ++i) {
-            sys_flash_read_absolute(address, sizeof(app_flash_t), index);
-            if (index->id != SYS_APP_ID_NONE && index->boot_version == BOOT_VERSION) {
-                if (memcmp(index, _loaded_app_id, sizeof _loaded_app_id) == 0) {
-                    _loaded_app_index = _app_count;
+            if (mask & 1) {
+                sys_flash_read_absolute(address, sizeof(app_flash_t), index);
+                if (index->id != SYS_APP_ID_NONE && index->boot_version == BOOT_VERSION) {
+                    if (memcmp(index, _loaded_app_id, sizeof _loaded_app_id) == 0) {
+                        _loaded_app_index = _app_count;
+                    }
+                    _app_slot[_app_count] = i;
+                    ++index;
+                    ++_app_count;
                 }
-                ++index;
-                ++_app_count;
             }
+            mask >>= 1;
             address += SYS_FLASH_INDEX_ENTRY_SIZE;
         }
     }
@@ -108,6 +131,8 @@ void load_read_index(void) {
         // was bundled along with the bootloader and we can just jump to it directly.
         // note that this means the debug app must partially initialize itself (display page height),
         // and may not store any data in flash and eeprom since the offset hasn't been set.
+        // the app draws frames at its own rate, so the render scheduler is disabled.
+        sys_display_init_fps(0, 0);
         _load_app_setup(APP_ID_SYSTEM);
     }
 }
@@ -119,23 +144,16 @@ static bool _flash_app_code(app_flash_t *app) {
     return false;
 #else
     // read app code from flash and write internal flash memory.
-    // also do a CRC check after writing
+    // the CRC is computed as the code is received from flash, and each written page is read
+    // back from internal flash, so that a corrupt app or a failed write are both detected.
+    // pages that are already the same in internal flash aren't rewritten, this is faster when
+    // switching between app versions sharing code and saves some of the internal flash endurance.
     extern uint8_t __APP_START_ADDRESS;
     uint8_t* dst = &__APP_START_ADDRESS;
     flash_t src = app->address;
     uint16_t crc = 0xffff;
     const uint8_t code_pages = (app->code_size + CODE_PAGE_SIZE - 1) / CODE_PAGE_SIZE;
     for (uint8_t i = code_pages; i-- > 0;) {
-        // Read code page from flash and write it to flash directly.
-        // Note that the last page is written completely even if partial and that's fine.
-        sys_flash_read_absolute(src, CODE_PAGE_SIZE, dst);
-
-        _PROTECTED_WRITE_SPM(NVMCTRL.CTRLA, NVMCTRL_CMD_PAGEERASEWRITE_gc);
-        while (NVMCTRL.STATUS & NVMCTRL_FBUSY_bm);
-
-        src += CODE_PAGE_SIZE;
-
-        // update the CRC
         uint8_t page_size = 0;
         if (i == 0) {
             page_size = app->code_size % CODE_PAGE_SIZE;
@@ -144,15 +162,39 @@ static bool _flash_app_code(app_flash_t *app) {
             // either on last page, or last page is a full page.
             page_size = CODE_PAGE_SIZE;
         }
-        for (uint8_t j = 0; j < page_size; ++j) {
-            crc = _crc_ccitt_update(crc, *dst++);
+
+        // Read code page from flash and compare it with the resident page.
+        // Only the code is read and compared on the last page.
+        uint8_t page[CODE_PAGE_SIZE];
+        crc = sys_flash_read_crc(src, page_size, page, crc);
+
+        if (memcmp(page, dst, page_size) != 0) {
+            // copy to page buffer and write page.
+            memcpy(dst, page, page_size);
+            _PROTECTED_WRITE_SPM(NVMCTRL.CTRLA, NVMCTRL_CMD_PAGEERASEWRITE_gc);
+            while (NVMCTRL.STATUS & NVMCTRL_FBUSY_bm);
+            if ((NVMCTRL.STATUS & NVMCTRL_WRERROR_bm) || memcmp(page, dst, page_size) != 0) {
+                return false;
+            }
         }
+
+        src += CODE_PAGE_SIZE;
+        dst += CODE_PAGE_SIZE;
     }
 
     return crc == app->crc_code;
 #endif //SIMULATION
 }
 
+static flash_t _get_app_data_address(const app_flash_t* app) {
+    // code is padded so that data starts aligned like the image, if alignment is set.
+    const flash_t align_mask = ((flash_t) 1 << app->align_bits) - 1;
+    return app->address + (((flash_t) app->code_size + align_mask) & ~align_mask);
+}
+
+// Note that app RAM isn't preserved between launches: apps terminate with a software reset and
+// always start cold with the setup callback, so any state to keep must be saved to EEPROM.
+// Relaunching the last loaded app is still fast since its code is already in program memory.
 void _load_app(uint8_t index) {
     app_flash_t *app = &_app_index[index];
 
@@ -177,15 +219,25 @@ void _load_app(uint8_t index) {
     }
 
     sys_display_init_page(app->page_height);
-    sys_flash_set_offset(app->address + app->code_size);
+    sys_display_set_clear_on_send(false);
+    sys_display_init_fps(app->target_fps, app->min_fps);
+    sys_flash_set_offset(_get_app_data_address(app));
     sys_eeprom_set_location(app->eeprom_offset, app->eeprom_size);
 
+    // the flash data space location is only needed here, so it's not kept in the index copy.
+    struct {
+        flash_t address;
+        uint16_t sectors;
+    } PACK_STRUCT space;
+    sys_flash_read_absolute(SYS_FLASH_INDEX_ADDR + SYS_FLASH_INDEX_SPACE_POS +
+                            _app_slot[index] * SYS_FLASH_INDEX_ENTRY_SIZE, sizeof space, &space);
+    sys_flash_set_space_location(space.address, space.sectors);
+
     _load_app_setup(app->id);
 }
 
 graphics_image_t load_get_app_image(uint8_t index) {
-    app_flash_t *app = &_app_index[index];
-    return data_flash(app->address + app->code_size);
+    return data_flash(_get_app_data_address(&_app_index[index]));
 }
 
 uint8_t load_get_app_count(void) {
@@ -30,12 +30,14 @@
 #include <sys/power.h>
 #include <sys/display.h>
 #include <sys/app.h>
+#include <sys/time.h>
 
 #include <core/input.h>
 #include <core/sound.h>
 #include <core/sysui.h>
 #include <core/graphics.h>
 #include <core/time.h>
+#include <core/evtrace.h>
 
 #include <stdbool.h>
 
@@ -64,13 +66,17 @@
 #define IS_BOOTLOADER
 #endif
 
-#define DISPLAY_MAX_FPS 8
-
 #define APPS_PER_SCREEN 2
 #define APP_ITEM_HEIGHT 58
 
 #define ACTIVE_COLOR(cond) ((cond) ? 12 : 4)
 
+#ifdef LOOP_MONITOR
+#define SET_LOOP_PHASE(phase) (sys_loop_phase = SYS_LOOP_PHASE_##phase)
+#else
+#define SET_LOOP_PHASE(phase)
+#endif
+
 // boot-arrow-down.png, 5x3, 1-bit mixed, unindexed.
 static const uint8_t _ARROW_DOWN[] = {0xf1, 0x10, 0x04, 0x02, 0x7d, 0x62, 0x00};
 
@@ -79,7 +85,12 @@ static const uint8_t _ARROW_UP[] = {0xf1, 0x10, 0x04, 0x02, 0x11, 0x6f, 0x40};
 
 static BOOTLOADER_ONLY uint8_t _first_shown;
 static BOOTLOADER_ONLY uint8_t _selected_index;
-static BOOTLOADER_ONLY systime_t _last_draw_time;
+// key of the bootloader screen last drawn (see get_bootloader_screen), 0 to draw it again.
+static BOOTLOADER_ONLY uint32_t _drawn_screen;
+
+// render scheduler state, used by both the bootloader and the app.
+static systime_t _last_draw_time;
+static bool _frame_overrun;
 
 static void handle_input(void) {
     input_latch();
@@ -153,6 +164,18 @@ static void draw_bootloader(void) {
     sysui_battery_overlay();
 }
 
+/**
+ * Returns a key identifying what the bootloader screen shows: the selection, the battery overlay
+ * and whether the low battery screen is shown. The key is never zero.
+ */
+static uint32_t get_bootloader_screen(void) {
+    return (uint32_t) _first_shown | (uint32_t) _selected_index << 8 |
+           (uint32_t) power_get_battery_percent() << 16 |
+           (uint32_t) power_get_battery_status() << 24 |
+           (uint32_t) (power_get_scheduled_sleep_cause() == SLEEP_CAUSE_LOW_POWER) << 30 |
+           0x80000000UL;
+}
+
 static void draw(void) {
     if (power_get_scheduled_sleep_cause() == SLEEP_CAUSE_LOW_POWER) {
         // show low battery screen before sleeping.
@@ -169,17 +192,46 @@ static void draw(void) {
     }
 }
 
+/**
+ * Render scheduler, returns true if a frame requested by the loop callback should be drawn now.
+ * Frames are drawn at most once per frame period. A frame that took a bit longer than that
+ * is followed by the next one right away. If it took more than two frame periods, the next
+ * frame is skipped so that the loop keeps running at the same rate, unless the maximum
+ * period between frames has been reached.
+ */
+static bool schedule_draw(void) {
+    systime_t time = time_get();
+    systime_t elapsed = time - _last_draw_time;
+    if (elapsed < sys_display_frame_period) {
+        return false;
+    }
+    _last_draw_time = time;
+    if (_frame_overrun && elapsed < sys_display_max_frame_period) {
+        _frame_overrun = false;
+        ++sys_display_skipped_frames;
+        return false;
+    }
+    return true;
+}
+
 static void loop(void) {
+    SET_LOOP_PHASE(BATTERY);
     sys_power_update_battery_level(SYS_SLEEP_SCHEDULE_COUNTDOWN);
+    SET_LOOP_PHASE(SOUND);
     sys_sound_fill_track_buffers();
+    SET_LOOP_PHASE(OTHER);
     sys_input_dim_if_inactive();
+    sys_eeprom_update();
 
     bool is_sleep_due = sys_power_is_sleep_due();
 
     bool should_draw;
+    uint32_t screen = 0;
     if (sys_app_get_loaded_id() != SYS_APP_ID_NONE) {
         // app active
+        SET_LOOP_PHASE(LOOP);
         should_draw = __callback_loop();
+        SET_LOOP_PHASE(OTHER);
     } else {
         // bootloader active
         handle_input();
@@ -189,11 +241,14 @@ static void loop(void) {
             return;
         }
 
-        systime_t time = time_get();
-        should_draw = (time - _last_draw_time > millis_to_ticks(1000.0 / DISPLAY_MAX_FPS));
-        if (should_draw) {
-            _last_draw_time = time;
-        }
+        // the screen is only drawn when what it shows has changed, so that the bootloader
+        // idles instead of decoding the app images from flash on every frame.
+        screen = get_bootloader_screen();
+        should_draw = screen != _drawn_screen;
+    }
+
+    if (should_draw && sys_display_frame_period != 0) {
+        should_draw = schedule_draw();
     }
 
     if (is_sleep_due) {
@@ -201,13 +256,37 @@ static void loop(void) {
         // loop() callback will have been called once with sys_power_is_sleep_due()
         // returning true so that any last minute special actions can be taken.
         sys_power_enable_sleep();
+        // the display is cleared on wakeup.
+        _drawn_screen = 0;
     }
 
     if (should_draw) {
+        SET_LOOP_PHASE(DISPLAY);
+        evtrace(EVTRACE_FRAME_START, 0);
         sys_display_first_page();
         do {
+            SET_LOOP_PHASE(DRAW);
             draw();
+            if (sys_sound_refill_needed) {
+                // the flash is free between pages, fill track buffers now if they're running
+                // low rather than waiting until the end of the frame.
+                SET_LOOP_PHASE(SOUND);
+                sys_sound_fill_track_buffers();
+            }
+            SET_LOOP_PHASE(DISPLAY);
         } while (sys_display_next_page());
+        SET_LOOP_PHASE(OTHER);
+        // only skip the next frame if this one overran by more than a whole frame period.
+        const systime_t duration = time_get() - _last_draw_time;
+        const systime_t period = sys_display_frame_period;
+        _frame_overrun = duration > period && (systime_t) (duration - period) > period;
+        _drawn_screen = screen;
+        evtrace(EVTRACE_FRAME_END, _frame_overrun);
+    } else if (!sys_sound_refill_needed) {
+        // nothing was drawn and there's no work pending, idle until the next interrupt.
+        SET_LOOP_PHASE(IDLE);
+        sys_power_idle();
+        SET_LOOP_PHASE(OTHER);
     }
 }
 
@@ -240,12 +319,14 @@ static void* loop_thread(void* arg) {
     while (true) {
         loop();
 
+        // 1 ms sleep (fixes responsiveness issues with keyboard input)
 #ifdef SYS_UART_ENABLE
         sim_uart_listen();
-#endif
-
-        // 1 ms sleep (fixes responsiveness issues with keyboard input)
+        // wake up early when UART data is received, so that packets are handled immediately.
+        sim_uart_sleep(1000);
+#else
         sim_time_sleep(1000);
+#endif
     }
     return 0;
 }
@@ -259,6 +340,7 @@ static void* loop_thread(void* arg) {
 int main(void) {
     sys_init();
     sys_display_init_page(DISPLAY_PAGE_HEIGHT);
+    sys_display_init_fps(DISPLAY_TARGET_FPS, DISPLAY_MIN_FPS);
 
     // update last input state to prevent pushed button registered as clicked
     // immediately on launch, like when an app has an exit button.
@@ -20,9 +20,28 @@ DEFINES += BOOT_VERSION=$(boot_version)
 # App configuration file
 ifneq ($(wildcard $(TARGET_CONFIG_FILE)),)
   eeprom_space := 0
+  flash_space := 0
+  fast_settings_offset := 0
+  fast_settings_space := 0
+  display_target_fps := 0
+  display_min_fps := 0
   include $(TARGET_CONFIG_FILE)
-  DEFINES += DISPLAY_PAGE_HEIGHT=$(display_page_height) APP_ID=$(id) APP_VERSION=$(version) \
-             EEPROM_RESERVED_SPACE=$(eeprom_space)
+  ifeq ($(FULL_FRAME),1)
+    # Full frame mode, for MCUs with enough RAM to hold the whole display (simulator only,
+    # the ATmega3208 doesn't have enough, see avr.mk).
+    # A single page covers the display whatever the configured page height.
+    # The bootloader must also be built with it.
+    display_page_height := 128
+    display_max_page_height := 128
+    DEFINES += DISPLAY_FULL_FRAME
+  endif
+  display_max_page_height ?= $(display_page_height)
+  DEFINES += DISPLAY_PAGE_HEIGHT=$(display_page_height) \
+             DISPLAY_MAX_PAGE_HEIGHT=$(display_max_page_height) APP_ID=$(id) APP_VERSION=$(version) \
+             EEPROM_RESERVED_SPACE=$(eeprom_space) FLASH_RESERVED_SPACE=$(flash_space) \
+             DISPLAY_TARGET_FPS=$(display_target_fps) \
+             DISPLAY_MIN_FPS=$(display_min_fps) FAST_SETTINGS_OFFSET=$(fast_settings_offset) \
+             FAST_SETTINGS_SIZE=$(fast_settings_space)
 endif
 
 # Compilation
@@ -61,13 +80,16 @@ endif
 
 clean:
 	$(E)rm -rf $(BUILD_DIR)
+	$(E)rm -rf $(TARGET)/build/assets_cache
 	$(E)rm -f $(ASSETS_FILE)
 	$(E)rm -f $(APP_PACK_FILE)
 
 # Assets packing
 
 ifneq ($(TARGET),boot)
-$(ASSETS_FILE): $(TARGET)/pack.py $(wildcard $(TARGET)/assets/*) $(wildcard $(TARGET)/assets/*/*)
+# Packing again after profiling in the simulator updates the assets placed in internal memory.
+$(ASSETS_FILE): $(TARGET)/pack.py $(wildcard $(TARGET)/assets/*) $(wildcard $(TARGET)/assets/*/*) \
+                $(wildcard $(TARGET)/flash_reads.csv)
 	$(E)export PYTHONPATH="$(PWD)/utils":"$(PWD)/$(TARGET)/utils"; cd $(TARGET); python3 pack.py
 
 assets: $(ASSETS_FILE)
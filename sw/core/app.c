@@ -16,9 +16,12 @@
 
 #include <core/app.h>
 
+#include <sys/eeprom.h>
 #include <sys/reset.h>
 
 void app_terminate(void) {
+    // the queued EEPROM write must be complete before resetting.
+    sys_eeprom_flush();
     sys_reset_system();
 }
 
@@ -15,9 +15,74 @@
  */
 
 #include <core/data.h>
+#include <core/trace.h>
 
 #include <sys/data.h>
 
 void data_read(data_ptr_t address, uint16_t length, uint8_t dest[]) {
+    trace_spi_tag("data_read");
     sys_data_read(address, length, dest);
 }
+
+const uint8_t* data_get_pointer(data_ptr_t address) {
+    return sys_data_get_pointer(address);
+}
+
+void data_set_cache(data_cache_t* cache) {
+    if (cache) {
+#ifdef RUNTIME_CHECKS
+        if (cache->count == 0 || (cache->count & (cache->count - 1)) != 0) {
+            trace("data cache line count must be a power of two");
+            return;
+        }
+#endif
+        for (uint8_t i = 0; i < cache->count; ++i) {
+            // line addresses are aligned, so this never matches a read.
+            cache->lines[i].address = (flash_t) -1;
+        }
+        cache->hits = 0;
+        cache->misses = 0;
+    }
+    sys_data_cache = cache;
+}
+
+#ifdef BOOTLOADER
+
+#include <boot/defs.h>
+
+#include <string.h>
+
+SIM_THREAD_LOCAL data_cache_t* sys_data_cache;
+
+BOOTLOADER_NOINLINE
+void sys_data_read_flash(flash_t address, uint16_t length, uint8_t dest[]) {
+    data_cache_t* cache = sys_data_cache;
+    if (!cache || length > DATA_CACHE_LINE_SIZE) {
+        flash_read(address, length, dest);
+        return;
+    }
+    while (length) {
+        // the read may span two lines, copy the part in each line.
+        const flash_t line_address = address & ~(flash_t) (DATA_CACHE_LINE_SIZE - 1);
+        data_cache_line_t* line = &cache->lines[
+                (uint8_t) (line_address / DATA_CACHE_LINE_SIZE) & (cache->count - 1)];
+        if (line->address == line_address) {
+            ++cache->hits;
+        } else {
+            ++cache->misses;
+            flash_read(line_address, DATA_CACHE_LINE_SIZE, line->data);
+            line->address = line_address;
+        }
+        const uint8_t offset = address - line_address;
+        uint8_t count = DATA_CACHE_LINE_SIZE - offset;
+        if (count > length) {
+            count = length;
+        }
+        memcpy(dest, &line->data[offset], count);
+        dest += count;
+        address += count;
+        length -= count;
+    }
+}
+
+#endif //BOOTLOADER
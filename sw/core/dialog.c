@@ -15,6 +15,7 @@
  */
 
 #include <core/dialog.h>
+#include <core/display.h>
 #include <core/utils.h>
 #include <core/trace.h>
 #include <string.h>
@@ -37,7 +38,7 @@ static const char TEXT_FIELD_CHARS[] = " ABCDEFGHIJKLMNOPQRSTUVWXYZ-*!";
 #define TEXT_FIELD_CHARS_COUNT 30
 #endif
 
-dialog_t dialog;
+SIM_THREAD_LOCAL dialog_t dialog;
 
 void dialog_init(disp_x_t x, disp_y_t y, uint8_t width, uint8_t height) {
 #ifdef RUNTIME_CHECKS
@@ -78,6 +79,22 @@ void dialog_set_font(graphics_font_t title_font, graphics_font_t action_font) {
 }
 #endif //DIALOG_NO_ITEM_TEXT
 
+void dialog_invalidate_layout(void) {
+    dialog.flags &= ~(DIALOG_FLAG_LAYOUT_VALID | DIALOG_FLAG_DRAWN);
+}
+
+bool dialog_set_dirty_rows(void) {
+    if (!(dialog.flags & DIALOG_FLAG_SHOWN)) {
+        // first frame with this dialog, the background around it is drawn once.
+        return true;
+    }
+    if (dialog.flags & DIALOG_FLAG_DRAWN) {
+        return false;
+    }
+    display_set_dirty_rows(dialog.y, dialog.y + dialog.height - 1);
+    return true;
+}
+
 #ifdef RUNTIME_CHECKS
 
 static bool dialog_add_item_check(void) {
@@ -101,6 +118,7 @@ void dialog_add_item_button(const char* name, dialog_result_t result) {
     item->name = name;
     item->button.result = result;
     ++dialog.item_count;
+    dialog_invalidate_layout();
 }
 
 #ifndef DIALOG_NO_CHOICE
@@ -119,6 +137,7 @@ void dialog_add_item_choice(const char* const name, uint8_t selection,
     item->choice.selection = selection;
     item->choice.choices = choices;
     ++dialog.item_count;
+    dialog_invalidate_layout();
 }
 
 #endif //DIALOG_NO_CHOICE
@@ -144,6 +163,7 @@ void dialog_add_item_number(const char* name, uint8_t min, uint8_t max,
     item->number.max = max;
     item->number.mul = mul;
     ++dialog.item_count;
+    dialog_invalidate_layout();
 }
 
 #endif //DIALOG_NO_NUMBER
@@ -162,6 +182,7 @@ void dialog_add_item_text(const char* name, uint8_t max_length, char text[static
     item->text.max_length = max_length;
     item->text.text = text;
     ++dialog.item_count;
+    dialog_invalidate_layout();
 }
 
 static void trim_text_field(dialog_text_t* item) {
@@ -243,6 +264,8 @@ dialog_result_t dialog_handle_input(void) {
 
     uint8_t clicked = input_get_clicked();
     if (clicked) {
+        // the selection or an item value may change, the dialog must be drawn again.
+        dialog.flags &= ~DIALOG_FLAG_DRAWN;
         if (clicked & DIALOG_BUTTON_ENTER) {
             if (dialog.selection == DIALOG_SELECTION_POS) {
                 result = dialog.pos_result;
@@ -322,6 +345,8 @@ dialog_result_t dialog_handle_input(void) {
                 // there's a negative button on the left of the positive button, select it.
                 dialog.selection = DIALOG_SELECTION_NEG;
             } else if (curr_item) {
+                // current choice or number may change.
+                dialog_invalidate_layout();
 #ifndef DIALOG_NO_CHOICE
                 if (curr_item->type == DIALOG_ITEM_CHOICE) {
                     // go to previous choice in item or wrap around if on first choice.
@@ -357,6 +382,8 @@ dialog_result_t dialog_handle_input(void) {
                 // if there's a negative button there's necessarily a positive one too.
                 dialog.selection = DIALOG_SELECTION_POS;
             } else if (curr_item) {
+                // current choice or number may change.
+                dialog_invalidate_layout();
 #ifndef DIALOG_NO_CHOICE
                 if (curr_item->type == DIALOG_ITEM_CHOICE) {
                     // go to next choice in item or wrap around if on last choice.
@@ -393,8 +420,53 @@ dialog_result_t dialog_handle_input(void) {
     return result;
 }
 
+#ifndef DIALOG_NO_SPINNER
+
+static const char* get_spinner_text(const dialog_item_t* item, char buf[static 4]) {
+#ifndef DIALOG_NO_NUMBER
+    if (item->type == DIALOG_ITEM_NUMBER) {
+        return uint8_to_str(buf, item->number.value * item->number.mul);
+    }
+#endif //DIALOG_NO_NUMBER
+#ifndef DIALOG_NO_CHOICE
+    return item->choice.choices[item->choice.selection];
+#else
+    return "";
+#endif //DIALOG_NO_CHOICE
+}
+
+#endif //DIALOG_NO_SPINNER
+
+static void update_layout(void) {
+    if (dialog.title) {
+        graphics_set_font(dialog.title_font);
+        dialog.title_width = graphics_text_width(dialog.title);
+    }
+    graphics_set_font(dialog.action_font);
+    if (dialog.pos_btn) {
+        dialog.pos_btn_width = graphics_text_width(dialog.pos_btn);
+    }
+    if (dialog.neg_btn) {
+        dialog.neg_btn_width = graphics_text_width(dialog.neg_btn);
+    }
+    for (uint8_t i = 0; i < dialog.item_count; ++i) {
+        dialog_item_t* item = &dialog.items[i];
+        if (item->type == DIALOG_ITEM_BUTTON) {
+            item->width = graphics_text_width(item->name);
+        }
+#ifndef DIALOG_NO_SPINNER
+        else if (item->type != DIALOG_ITEM_TEXT) {
+            char buf[4];
+            item->width = graphics_text_width(get_spinner_text(item, buf));
+        }
+#endif //DIALOG_NO_SPINNER
+    }
+    dialog.flags |= DIALOG_FLAG_LAYOUT_VALID;
+}
+
 static void draw_action(disp_color_t color, disp_x_t x, disp_y_t y, uint8_t width,
-                        uint8_t height, const char* text, bool selected, bool inactive_frame) {
+                        uint8_t height, const char* text, uint8_t text_width,
+                        bool selected, bool inactive_frame) {
     if (selected) {
         graphics_set_color(color);
         graphics_fill_rect(x, y, width, height);
@@ -407,7 +479,6 @@ static void draw_action(disp_color_t color, disp_x_t x, disp_y_t y, uint8_t widt
             graphics_rect(x, y, width, height);
         }
     }
-    const uint8_t text_width = graphics_text_width(text);
     graphics_text((int8_t) (x + (width - text_width) / 2), (int8_t) (y + 2), text);
 }
 
@@ -435,6 +506,11 @@ static void draw_text_field(disp_x_t x, disp_y_t y, uint8_t width, dialog_text_t
 #endif
 
 void dialog_draw(void) {
+    if (!(dialog.flags & DIALOG_FLAG_LAYOUT_VALID)) {
+        update_layout();
+    }
+    dialog.flags |= DIALOG_FLAG_DRAWN | DIALOG_FLAG_SHOWN;
+
     // title frame & text
     disp_y_t y = dialog.y;
     int8_t height = (int8_t) dialog.height;
@@ -449,9 +525,8 @@ void dialog_draw(void) {
         graphics_fill_rect(dialog.x, dialog.y, dialog.width, h - 1);
         // title text
         graphics_set_color(DISPLAY_COLOR_BLACK);
-        uint8_t width = graphics_text_width(dialog.title);
-        graphics_text((int8_t) (dialog.x + (dialog.width - width) / 2), (int8_t) (dialog.y + 2),
-                      dialog.title);
+        graphics_text((int8_t) (dialog.x + (dialog.width - dialog.title_width) / 2),
+                      (int8_t) (dialog.y + 2), dialog.title);
         // line between title frame and dialog content
         graphics_hline(dialog.x, dialog.x + dialog.width, y - 1);
     }
@@ -486,14 +561,16 @@ void dialog_draw(void) {
             pos_btn_x += dialog.width / 2 + 1;
             pos_btn_width = pos_btn_width / 2 - 1;
             draw_action(11, dialog.x, btn_y, dialog.width / 2, action_height,
-                        dialog.neg_btn, dialog.selection == DIALOG_SELECTION_NEG, false);
+                        dialog.neg_btn, dialog.neg_btn_width,
+                        dialog.selection == DIALOG_SELECTION_NEG, false);
             // line between the two buttons
             graphics_set_color(DISPLAY_COLOR_BLACK);
             graphics_vline(btn_y, btn_y + action_height, pos_btn_x - 1);
         }
         // positive button
         draw_action(11, pos_btn_x, btn_y, pos_btn_width, action_height,
-                    dialog.pos_btn, dialog.selection == DIALOG_SELECTION_POS, false);
+                    dialog.pos_btn, dialog.pos_btn_width,
+                    dialog.selection == DIALOG_SELECTION_POS, false);
     }
 
     // button items, choice display (current font is action font)
@@ -503,7 +580,7 @@ void dialog_draw(void) {
         bool selected = (dialog.selection == i);
         if (item->type == DIALOG_ITEM_BUTTON) {
             draw_action(DISPLAY_COLOR_WHITE, dialog.x + 4, action_y, dialog.width - 8,
-                        action_height, item->name, selected, true);
+                        action_height, item->name, item->width, selected, true);
         }
 #ifndef DIALOG_NO_TEXT
         else if (item->type == DIALOG_ITEM_TEXT) {
@@ -513,25 +590,15 @@ void dialog_draw(void) {
 #endif //DIALOG_NO_TEXT
 #ifndef DIALOG_NO_SPINNER
         else {
-            const char* choice_str;
-#ifndef DIALOG_NO_NUMBER
             char buf[4];
-            if (item->type == DIALOG_ITEM_NUMBER) {
-                choice_str = uint8_to_str(buf, item->number.value * item->number.mul);
-            } else
-#endif //DIALOG_NO_NUMBER
-            {
-#ifndef DIALOG_NO_CHOICE
-                choice_str = item->choice.choices[item->choice.selection];
-#endif //DIALOG_NO_CHOICE
-            }
-
-            uint8_t choice_width = graphics_text_width(choice_str);
+            const char* choice_str = get_spinner_text(item, buf);
+            uint8_t choice_width = item->width;
             uint8_t arrow_right_x = dialog.x + dialog.width - 6;
             uint8_t action_x = arrow_right_x - choice_width - 3;
             // action text (number or choice)
             draw_action(DISPLAY_COLOR_WHITE, action_x, action_y,
-                        choice_width + 2, action_height, choice_str, selected, false);
+                        choice_width + 2, action_height, choice_str, choice_width,
+                        selected, false);
 
             // draw arrows on the left and right side of choice item.
             uint8_t arrow_y = action_y + (action_height - 5) / 2;
@@ -16,8 +16,16 @@
  */
 
 #include <core/display.h>
+#include <core/trace.h>
+
 #include <sys/display.h>
 
+// see core/graphics.h for the image format.
+#define IMAGE_SIGNATURE 0xf1
+#define IMAGE_HEADER_SIZE 4
+#define IMAGE_FLAGS_TYPE_MASK 0x70
+#define IMAGE_FLAGS_RAW_4BIT_OPAQUE 0x20
+
 void display_set_inverted(bool inverted) {
     sys_display_set_inverted(inverted);
 }
@@ -29,3 +37,55 @@ void display_set_contrast(uint8_t contrast) {
 uint8_t display_get_contrast(void) {
     return sys_display_get_contrast();
 }
+
+void display_set_dirty_rows(disp_y_t ystart, disp_y_t yend) {
+    sys_display_set_dirty_rows(ystart, yend);
+}
+
+void display_scroll(int8_t rows) {
+    sys_display_scroll(rows);
+}
+
+void display_set_palette(const disp_color_t palette[16]) {
+    sys_display_set_palette(palette);
+}
+
+void display_set_clear_on_send(bool enabled) {
+    sys_display_set_clear_on_send(enabled);
+}
+
+void display_set_page_height(uint8_t height) {
+#ifdef RUNTIME_CHECKS
+    if (height == 0 || height > DISPLAY_MAX_PAGE_HEIGHT) {
+        trace("page height out of bounds");
+        return;
+    }
+    // a call while drawing is only detected in simulation. On the game console, the page
+    // bounds would be advanced by the new height for the rest of the frame and become invalid.
+#endif
+    sys_display_init_page(height);
+}
+
+uint8_t display_get_page_height(void) {
+    return sys_display_page_height;
+}
+
+uint16_t display_take_skipped_frames(void) {
+    uint16_t count = sys_display_skipped_frames;
+    sys_display_skipped_frames = 0;
+    return count;
+}
+
+void display_stream_raw_image(data_ptr_t image) {
+#ifdef RUNTIME_CHECKS
+    uint8_t header[IMAGE_HEADER_SIZE];
+    data_read(image, sizeof header, header);
+    if (header[0] != IMAGE_SIGNATURE ||
+        (header[1] & IMAGE_FLAGS_TYPE_MASK) != IMAGE_FLAGS_RAW_4BIT_OPAQUE ||
+        header[2] != DISPLAY_WIDTH - 1 || header[3] != DISPLAY_HEIGHT - 1) {
+        trace("image must be an opaque 4-bit raw image the size of the display");
+        return;
+    }
+#endif
+    sys_display_write_frame(image + IMAGE_HEADER_SIZE);
+}
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <core/displist.h>
+#include <core/trace.h>
+
+#include <sys/display.h>
+
+static SIM_THREAD_LOCAL displist_cmd_t* _buffer;
+static SIM_THREAD_LOCAL uint8_t _size;
+static SIM_THREAD_LOCAL uint8_t _count;
+// set if a command didn't fit in the list during the current frame.
+static SIM_THREAD_LOCAL bool _overflow;
+// set while recording, on the first page of a frame.
+static SIM_THREAD_LOCAL bool _recording;
+
+void displist_init(displist_cmd_t* buffer, uint8_t size) {
+    _buffer = buffer;
+    _size = size;
+    _count = 0;
+}
+
+static void draw_command(const displist_cmd_t* cmd) {
+    graphics_set_color(cmd->color);
+    switch (cmd->type) {
+        case DISPLIST_FILL_RECT:
+            graphics_fill_rect(cmd->x, cmd->y, cmd->rect.width, cmd->rect.height);
+            break;
+        case DISPLIST_RECT:
+            graphics_rect(cmd->x, cmd->y, cmd->rect.width, cmd->rect.height);
+            break;
+        case DISPLIST_IMAGE_1BIT_RAW:
+            graphics_image_1bit_raw(cmd->image, cmd->x, cmd->y);
+            break;
+        case DISPLIST_IMAGE_1BIT_MIXED:
+            graphics_image_1bit_mixed(cmd->image, cmd->x, cmd->y);
+            break;
+        case DISPLIST_IMAGE_4BIT_RAW:
+            graphics_image_4bit_raw(cmd->image, cmd->x, cmd->y);
+            break;
+        case DISPLIST_IMAGE_4BIT_MIXED:
+            graphics_image_4bit_mixed(cmd->image, cmd->x, cmd->y);
+            break;
+        case DISPLIST_TEXT:
+            // reading the font header is costly, only set it when it changes.
+            if (graphics_get_font() != cmd->text.font) {
+                graphics_set_font(cmd->text.font);
+            }
+            graphics_text((int8_t) cmd->x, (int8_t) cmd->y, cmd->text.text);
+            break;
+        default:
+            break;
+    }
+}
+
+bool displist_begin(void) {
+    if (sys_display_page_ystart == sys_display_refresh_ystart) {
+        // first page of the frame.
+        _count = 0;
+        _overflow = false;
+        _recording = _buffer != 0;
+        return true;
+    }
+    _recording = false;
+    if (_buffer == 0 || _overflow) {
+        return true;
+    }
+
+    const disp_color_t color = graphics_get_color();
+    const graphics_font_t font = graphics_get_font();
+    const displist_cmd_t* cmd = _buffer;
+    for (uint8_t i = 0; i < _count; ++i, ++cmd) {
+        if (cmd->ystart <= sys_display_page_yend && cmd->yend >= sys_display_page_ystart) {
+            draw_command(cmd);
+        }
+    }
+    graphics_set_color(color);
+    if (graphics_get_font() != font) {
+        graphics_set_font(font);
+    }
+    return false;
+}
+
+/**
+ * Add a command touching rows `ystart` to `yend` to the list if recording, and return it,
+ * or return null if there's no room left in the list. Rows are clamped to the display.
+ */
+static displist_cmd_t* record(uint8_t type, uint8_t x, uint8_t y, int16_t ystart, int16_t yend) {
+    if (!_recording) {
+        return 0;
+    }
+    if (_count == _size) {
+        if (!_overflow) {
+            trace("display list full, falling back to drawing on every page");
+        }
+        _overflow = true;
+        return 0;
+    }
+    displist_cmd_t* cmd = &_buffer[_count++];
+    cmd->type = type;
+    cmd->color = graphics_get_color();
+    cmd->x = x;
+    cmd->y = y;
+    cmd->ystart = ystart < 0 ? 0 : (disp_y_t) ystart;
+    cmd->yend = yend < 0 ? 0 : yend >= DISPLAY_HEIGHT ? DISPLAY_HEIGHT - 1 : (disp_y_t) yend;
+    return cmd;
+}
+
+static void record_rect(uint8_t type, disp_x_t x, disp_y_t y, uint8_t width, uint8_t height) {
+    displist_cmd_t* cmd = record(type, x, y, y, y + height - 1);
+    if (cmd) {
+        cmd->rect.width = width;
+        cmd->rect.height = height;
+    }
+}
+
+void displist_fill_rect(disp_x_t x, disp_y_t y, uint8_t width, uint8_t height) {
+    record_rect(DISPLIST_FILL_RECT, x, y, width, height);
+    graphics_fill_rect(x, y, width, height);
+}
+
+void displist_rect(disp_x_t x, disp_y_t y, uint8_t width, uint8_t height) {
+    record_rect(DISPLIST_RECT, x, y, width, height);
+    graphics_rect(x, y, width, height);
+}
+
+static void record_image(uint8_t type, graphics_image_t image, disp_x_t x, disp_y_t y) {
+    if (!_recording) {
+        return;
+    }
+    // image header: signature, flags, width - 1, height - 1.
+    uint8_t header[4];
+    data_read(image, sizeof header, header);
+    displist_cmd_t* cmd = record(type, x, y, y, y + header[3]);
+    if (cmd) {
+        cmd->image = image;
+    }
+}
+
+void displist_image_1bit_raw(graphics_image_t image, disp_x_t x, disp_y_t y) {
+    record_image(DISPLIST_IMAGE_1BIT_RAW, image, x, y);
+    graphics_image_1bit_raw(image, x, y);
+}
+
+void displist_image_1bit_mixed(graphics_image_t image, disp_x_t x, disp_y_t y) {
+    record_image(DISPLIST_IMAGE_1BIT_MIXED, image, x, y);
+    graphics_image_1bit_mixed(image, x, y);
+}
+
+void displist_image_4bit_raw(graphics_image_t image, disp_x_t x, disp_y_t y) {
+    record_image(DISPLIST_IMAGE_4BIT_RAW, image, x, y);
+    graphics_image_4bit_raw(image, x, y);
+}
+
+void displist_image_4bit_mixed(graphics_image_t image, disp_x_t x, disp_y_t y) {
+    record_image(DISPLIST_IMAGE_4BIT_MIXED, image, x, y);
+    graphics_image_4bit_mixed(image, x, y);
+}
+
+void displist_text(int8_t x, int8_t y, const char* text) {
+    displist_cmd_t* cmd = record(DISPLIST_TEXT, x, y, y, y + graphics_text_max_height() - 1);
+    if (cmd) {
+        cmd->text.text = text;
+        cmd->text.font = graphics_get_font();
+    }
+    graphics_text(x, y, text);
+}
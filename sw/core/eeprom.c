@@ -16,23 +16,49 @@
  */
 
 #include <sys/eeprom.h>
+#include <sys/crc.h>
+#include <sys/spi.h>
 
 #include <core/defs.h>
 #include <core/trace.h>
+#include <core/evtrace.h>
+
+#include <string.h>
 
-void eeprom_read(eeprom_t address, uint8_t length, void* dest) {
+void eeprom_read(eeprom_t address, uint16_t length, void* dest) {
     sys_eeprom_read_relative(address, length, dest);
 }
 
+void eeprom_stream_open(eeprom_t address) {
+    sys_eeprom_stream_open_relative(address);
+}
+
+void eeprom_stream_read(uint16_t length, void* dest) {
+    sys_eeprom_stream_read(length, dest);
+}
+
+void eeprom_stream_close(void) {
+    sys_eeprom_stream_close();
+}
+
 void eeprom_write(eeprom_t address, uint8_t length, const void* src) {
     sys_eeprom_write_relative(address, length, src);
 }
 
+void eeprom_write_async(eeprom_t address, uint8_t length, const void* src) {
+    sys_eeprom_write_async_relative(address, length, src);
+}
+
+bool eeprom_is_write_done(void) {
+    return sys_eeprom_is_write_done();
+}
+
 #ifdef BOOTLOADER
 
 #include <boot/defs.h>
+#include <boot/eeprom.h>
 
-#include <sys/spi.h>
+#include <sys/time.h>
 
 #define INSTRUCTION_WREN 0x06
 #define INSTRUCTION_RDSR 0x05
@@ -41,67 +67,213 @@ void eeprom_write(eeprom_t address, uint8_t length, const void* src) {
 
 #define STATUS_BUSY_MASK 0x01
 
-#define PAGE_SIZE 32
-
 #endif //BOOTLOADER
 
+#define PAGE_SIZE 32
+
 // this buffer is located alongside the display buffer, but may not be at the same location
 // in the bootloader and in the app, so prefix it with '_' to not include it in the boot symbols.
-static SHARED_DISP_BUF uint8_t _eeprom_buf[255];
+static SIM_THREAD_LOCAL SHARED_DISP_BUF uint8_t _eeprom_buf[255];
 
 #ifdef BOOTLOADER
 
-BOOTLOADER_KEEP eeprom_t sys_eeprom_offset;
-BOOTLOADER_KEEP eeprom_t sys_eeprom_size;
+BOOTLOADER_KEEP SIM_THREAD_LOCAL eeprom_t sys_eeprom_offset;
+BOOTLOADER_KEEP SIM_THREAD_LOCAL eeprom_t sys_eeprom_size;
+
+// Steps of the asynchronous write, each writing at most one EEPROM page.
+enum {
+    WRITE_STEP_NONE,
+    WRITE_STEP_COPY_OLD,
+    WRITE_STEP_ADDRESS,
+    WRITE_STEP_SIZE,
+    WRITE_STEP_DATA,
+    WRITE_STEP_CLEAR_SIZE,
+    WRITE_STEP_WAIT,
+};
+
+// asynchronous write state, address is absolute.
+static SIM_THREAD_LOCAL uint8_t _write_step;
+static SIM_THREAD_LOCAL eeprom_t _write_address;
+static SIM_THREAD_LOCAL uint8_t _write_length;
+static SIM_THREAD_LOCAL uint8_t _write_pos;
+static SIM_THREAD_LOCAL const uint8_t* _write_src;
+
+/**
+ * Returns true if EEPROM status register indicates busy status.
+ */
+static bool _eeprom_is_busy(void) {
+    uint8_t rdsr_cmd[2];
+    sys_spi_select_eeprom();
+    rdsr_cmd[0] = INSTRUCTION_RDSR;
+    sys_spi_transceive(2, rdsr_cmd);
+    sys_spi_deselect_eeprom();
+    return rdsr_cmd[1] & STATUS_BUSY_MASK;
+}
 
 /**
  * Wait until EEPROM status register indicates ready status.
  */
 static void _eeprom_wait_ready(void) {
-    uint8_t rdsr_cmd[2];
-    do {
-        sys_spi_select_eeprom();
-        rdsr_cmd[0] = INSTRUCTION_RDSR;
-        sys_spi_transceive(2, rdsr_cmd);
-        sys_spi_deselect_eeprom();
-    } while (rdsr_cmd[1] & STATUS_BUSY_MASK);
+#ifdef EVENT_TRACE
+    if (!_eeprom_is_busy()) {
+        return;
+    }
+    const systime_t start = sys_time_counter;
+    while (_eeprom_is_busy());
+    const systime_t wait = sys_time_counter - start;
+    evtrace(EVTRACE_EEPROM_WAIT, wait > UINT8_MAX ? UINT8_MAX : wait);
+#else
+    while (_eeprom_is_busy());
+#endif
+}
+
+/**
+ * Start writing data within a single EEPROM page, without waiting for completion.
+ */
+static void _eeprom_write_page(eeprom_t address, uint8_t length, const void* src) {
+    const uint8_t wren_cmd = INSTRUCTION_WREN;
+    sys_spi_select_eeprom();
+    sys_spi_transmit(1, &wren_cmd);
+    sys_spi_deselect_eeprom();
+
+    uint8_t write_cmd[3];
+    write_cmd[0] = INSTRUCTION_WRITE;
+    write_cmd[1] = address >> 8;
+    write_cmd[2] = address & 0xff;
+    sys_spi_select_eeprom();
+    sys_spi_transmit(3, write_cmd);
+    sys_spi_transmit(length, src);
+    sys_spi_deselect_eeprom();
+}
+
+/**
+ * Do the next step of the asynchronous write. The EEPROM must not be busy.
+ */
+static void _eeprom_write_step(void) {
+    switch (_write_step) {
+        case WRITE_STEP_COPY_OLD: {
+            // copy old data to the buffer, one page at a time (the buffer is page-aligned).
+            uint8_t buf[PAGE_SIZE];
+            uint8_t page_length = _write_length - _write_pos;
+            if (page_length > PAGE_SIZE) {
+                page_length = PAGE_SIZE;
+            }
+            sys_eeprom_read_absolute(_write_address + _write_pos, page_length, buf);
+            _eeprom_write_page(SYS_EEPROM_WRITE_BUF_ADDR + _write_pos, page_length, buf);
+            _write_pos += page_length;
+            if (_write_pos == _write_length) {
+                _write_pos = 0;
+                _write_step = WRITE_STEP_ADDRESS;
+            }
+            break;
+        }
+        case WRITE_STEP_ADDRESS:
+            _eeprom_write_page(SYS_EEPROM_WRITE_ADDR_ADDR, 2, &_write_address);
+            _write_step = WRITE_STEP_SIZE;
+            break;
+        case WRITE_STEP_SIZE:
+            // from now on, old data is restored if the write doesn't complete.
+            _eeprom_write_page(SYS_EEPROM_WRITE_SIZE_ADDR, 1, &_write_length);
+            _write_step = WRITE_STEP_DATA;
+            break;
+        case WRITE_STEP_DATA: {
+            // copy new data, one page at a time.
+            const eeprom_t address = _write_address + _write_pos;
+            uint8_t page_length = PAGE_SIZE - address % PAGE_SIZE;
+            if (page_length > _write_length - _write_pos) {
+                page_length = _write_length - _write_pos;
+            }
+            _eeprom_write_page(address, page_length, _write_src + _write_pos);
+            _write_pos += page_length;
+            if (_write_pos == _write_length) {
+#if !defined(SIMULATION) || defined(SIM_MEMORY_ABSOLUTE)
+                _write_step = WRITE_STEP_CLEAR_SIZE;
+#else
+                _write_step = WRITE_STEP_WAIT;
+#endif
+            }
+            break;
+        }
+        case WRITE_STEP_CLEAR_SIZE: {
+            const uint8_t zero = 0;
+            _eeprom_write_page(SYS_EEPROM_WRITE_SIZE_ADDR, 1, &zero);
+            _write_step = WRITE_STEP_WAIT;
+            break;
+        }
+        default:
+            // last page write is complete.
+            _write_step = WRITE_STEP_NONE;
+            break;
+    }
+}
+
+BOOTLOADER_NOINLINE
+void sys_eeprom_update(void) {
+    if (_write_step != WRITE_STEP_NONE && !_eeprom_is_busy()) {
+        _eeprom_write_step();
+    }
 }
 
 BOOTLOADER_NOINLINE
-void sys_eeprom_read_absolute(eeprom_t address, uint8_t length, void* dest) {
+void sys_eeprom_flush(void) {
+    while (_write_step != WRITE_STEP_NONE) {
+        _eeprom_wait_ready();
+        _eeprom_write_step();
+    }
+}
+
+BOOTLOADER_NOINLINE
+bool sys_eeprom_is_write_done(void) {
+    return _write_step == WRITE_STEP_NONE;
+}
+
+BOOTLOADER_NOINLINE
+void sys_eeprom_write_async_absolute(eeprom_t address, uint8_t length, const void* src) {
+    // only one write can be queued at once, finish the previous one.
+    sys_eeprom_flush();
+    if (length == 0) {
+        return;
+    }
+    _write_address = address;
+    _write_length = length;
+    _write_pos = 0;
+    _write_src = src;
+#if !defined(SIMULATION) || defined(SIM_MEMORY_ABSOLUTE)
+    _write_step = WRITE_STEP_COPY_OLD;
+#else
+    _write_step = WRITE_STEP_DATA;
+#endif
+}
+
+BOOTLOADER_NOINLINE
+void sys_eeprom_stream_open_absolute(eeprom_t address) {
     uint8_t read_cmd[3];
     read_cmd[0] = INSTRUCTION_READ;
     read_cmd[1] = address >> 8;
     read_cmd[2] = address & 0xff;
     sys_spi_select_eeprom();
     sys_spi_transmit(3, read_cmd);
+}
+
+BOOTLOADER_NOINLINE
+void sys_eeprom_read_absolute(eeprom_t address, uint16_t length, void* dest) {
+    // the EEPROM reads sequentially across pages for as long as it stays selected.
+    sys_eeprom_stream_open_absolute(address);
     sys_spi_transceive(length, dest);
     sys_spi_deselect_eeprom();
 }
 
 BOOTLOADER_NOINLINE
-void sys_eeprom_write_absolute(eeprom_t address, uint8_t length, const void* src) {
-    const uint8_t wren_cmd = INSTRUCTION_WREN;
-    uint8_t write_cmd[3];
-    write_cmd[0] = INSTRUCTION_WRITE;
-
+void sys_eeprom_write_absolute(eeprom_t address, uint16_t length, const void* src) {
+    // the write enable latch is reset after each page write, and the next page can't be
+    // written until the previous one is done, so each page needs its own WREN and wait.
     while (length) {
         _eeprom_wait_ready();
-
-        sys_spi_select_eeprom();
-        sys_spi_transmit(1, &wren_cmd);
-        sys_spi_deselect_eeprom();
-
-        write_cmd[1] = address >> 8;
-        write_cmd[2] = address & 0xff;
-        sys_spi_select_eeprom();
-        sys_spi_transmit(3, write_cmd);
         uint8_t page_length = PAGE_SIZE - address % PAGE_SIZE;
         if (page_length > length) {
             page_length = length;
         }
-        sys_spi_transmit(page_length, src);
-        sys_spi_deselect_eeprom();
+        _eeprom_write_page(address, page_length, src);
 
         address += page_length;
         length -= page_length;
@@ -131,11 +303,31 @@ void sys_eeprom_set_location(eeprom_t address, uint16_t size) {
     sys_eeprom_size = size;
 }
 
-void sys_eeprom_read_relative(eeprom_t address, uint8_t length, void* dest) {
+void sys_eeprom_read_relative(eeprom_t address, uint16_t length, void* dest) {
+    // a queued write must be complete to read the new data.
+    sys_eeprom_flush();
     sys_eeprom_read_absolute(address + sys_eeprom_offset, length, dest);
 }
 
-void sys_eeprom_write_relative(eeprom_t address, uint8_t length, const void* src) {
+void sys_eeprom_stream_open_relative(eeprom_t address) {
+    sys_eeprom_flush();
+    sys_eeprom_stream_open_absolute(address + sys_eeprom_offset);
+}
+
+void sys_eeprom_stream_read(uint16_t length, void* dest) {
+    if (length != 0) {
+        sys_spi_transceive(length, dest);
+    }
+}
+
+void sys_eeprom_stream_close(void) {
+    sys_spi_deselect_eeprom();
+}
+
+/**
+ * Returns the length of a write at a relative address, truncated to the allocated space.
+ */
+static uint8_t _eeprom_write_length(eeprom_t address, uint8_t length) {
     if (address + length > sys_eeprom_size) {
         // write exceeds allocated space, truncate it.
 #ifdef RUNTIME_CHECKS
@@ -143,9 +335,51 @@ void sys_eeprom_write_relative(eeprom_t address, uint8_t length, const void* src
 #endif
         if (__builtin_sub_overflow(sys_eeprom_size, address, &length)) {
             // fully past allocated space, no write.
-            return;
+            return 0;
+        }
+    }
+    return length;
+}
+
+/**
+ * Compare data with the EEPROM content at an absolute address, so that only the changed bytes
+ * are written. Returns the offset of the first changed byte, and sets the length so that the
+ * write ends on the last changed byte. The length is set to 0 if nothing changed.
+ */
+static uint8_t _eeprom_trim_unchanged(eeprom_t address, uint8_t* length, const uint8_t* src) {
+    uint8_t buf[PAGE_SIZE];
+    bool changed = false;
+    uint8_t first = 0;
+    uint8_t last = 0;
+    uint8_t pos = 0;
+    while (pos < *length) {
+        uint8_t chunk = *length - pos;
+        if (chunk > sizeof buf) {
+            chunk = sizeof buf;
+        }
+        sys_eeprom_read_absolute(address + pos, chunk, buf);
+        for (uint8_t i = 0; i < chunk; ++i, ++pos) {
+            if (buf[i] != src[pos]) {
+                if (!changed) {
+                    changed = true;
+                    first = pos;
+                }
+                last = pos;
+            }
         }
     }
+    *length = changed ? last - first + 1 : 0;
+    return first;
+}
+
+void sys_eeprom_write_async_relative(eeprom_t address, uint8_t length, const void* src) {
+    length = _eeprom_write_length(address, length);
+    sys_eeprom_write_async_absolute(address + sys_eeprom_offset, length, src);
+}
+
+void sys_eeprom_write_relative(eeprom_t address, uint8_t length, const void* src) {
+    sys_eeprom_flush();
+    length = _eeprom_write_length(address, length);
     if (length == 0) {
         return;
     }
@@ -167,3 +401,142 @@ void sys_eeprom_write_relative(eeprom_t address, uint8_t length, const void* src
     sys_eeprom_write_absolute(addr_abs, length, src);
 #endif
 }
+
+/**
+ * Trim a write at a relative address to the range of bytes that changed, see
+ * `eeprom_write_changed`. Returns the offset of the first changed byte, and sets the length.
+ */
+static uint8_t _eeprom_trim_relative(eeprom_t address, uint8_t* length, const void* src) {
+    // a queued write must be complete to compare with the new data.
+    sys_eeprom_flush();
+    *length = _eeprom_write_length(address, *length);
+    return _eeprom_trim_unchanged(address + sys_eeprom_offset, length, src);
+}
+
+void eeprom_write_changed(eeprom_t address, uint8_t length, const void* src) {
+    const uint8_t offset = _eeprom_trim_relative(address, &length, src);
+    if (length != 0) {
+        sys_eeprom_write_relative(address + offset, length, (const uint8_t*) src + offset);
+    }
+}
+
+void eeprom_write_changed_async(eeprom_t address, uint8_t length, const void* src) {
+    const uint8_t offset = _eeprom_trim_relative(address, &length, src);
+    if (length != 0) {
+        sys_eeprom_write_async_relative(address + offset, length, (const uint8_t*) src + offset);
+    }
+}
+
+/**
+ * Read the header of a slot at an absolute address and check the CRC of its data.
+ * Returns true if the slot is valid, in which case the sequence number is set.
+ */
+static bool _eeprom_slot_check(eeprom_t address, uint8_t length, uint8_t* sequence) {
+    uint8_t header[EEPROM_SLOT_HEADER_SIZE];
+    sys_eeprom_read_absolute(address, sizeof header, header);
+    address += sizeof header;
+    uint16_t crc = _crc_ccitt_update(0xffff, header[0]);
+    // data is read by chunks to compute the CRC without a buffer as large as the data.
+    uint8_t buf[16];
+    while (length) {
+        uint8_t chunk = length > sizeof buf ? sizeof buf : length;
+        sys_eeprom_read_absolute(address, chunk, buf);
+        for (uint8_t i = 0; i < chunk; ++i) {
+            crc = _crc_ccitt_update(crc, buf[i]);
+        }
+        address += chunk;
+        length -= chunk;
+    }
+    *sequence = header[0];
+    return crc == (header[1] | header[2] << 8);
+}
+
+/**
+ * Returns the absolute address of the first slot for slots at a relative address.
+ * Slots start on a page boundary, so that a slot fitting in a page is written at once.
+ */
+static eeprom_t _eeprom_slot_start(eeprom_t address) {
+    address += sys_eeprom_offset;
+    return (address + EEPROM_SLOT_ALIGN - 1) & ~(eeprom_t) (EEPROM_SLOT_ALIGN - 1);
+}
+
+/**
+ * Returns the index of the newest valid slot (0 or 1), or -1 if no slot is valid.
+ */
+static int8_t _eeprom_slot_newest(eeprom_t address, uint8_t length, uint8_t* sequence) {
+    uint8_t seq0;
+    uint8_t seq1;
+    const bool valid0 = _eeprom_slot_check(address, length, &seq0);
+    const bool valid1 = _eeprom_slot_check(address + EEPROM_SLOT_SIZE(length), length, &seq1);
+    if (valid0 && (!valid1 || (int8_t) (seq0 - seq1) > 0)) {
+        *sequence = seq0;
+        return 0;
+    } else if (valid1) {
+        *sequence = seq1;
+        return 1;
+    }
+    return -1;
+}
+
+static bool _eeprom_slot_check_bounds(eeprom_t address, uint8_t length) {
+    if (address + EEPROM_SLOTS_SIZE(length) > sys_eeprom_size) {
+#ifdef RUNTIME_CHECKS
+        trace("EEPROM slots past the end of EEPROM reserved space.");
+#endif
+        return false;
+    }
+    return true;
+}
+
+bool eeprom_slot_read(eeprom_t address, uint8_t length, void* dest) {
+    if (!_eeprom_slot_check_bounds(address, length)) {
+        return false;
+    }
+    sys_eeprom_flush();
+    address = _eeprom_slot_start(address);
+    uint8_t sequence;
+    const int8_t slot = _eeprom_slot_newest(address, length, &sequence);
+    if (slot < 0) {
+        return false;
+    }
+    sys_eeprom_read_absolute(address + slot * EEPROM_SLOT_SIZE(length) + EEPROM_SLOT_HEADER_SIZE,
+                             length, dest);
+    return true;
+}
+
+void eeprom_slot_write(eeprom_t address, uint8_t length, const void* src) {
+    if (!_eeprom_slot_check_bounds(address, length)) {
+        return;
+    }
+    sys_eeprom_flush();
+    address = _eeprom_slot_start(address);
+
+    // write over the oldest slot (or the invalid one), with the next sequence number.
+    uint8_t sequence = 0;
+    const int8_t newest = _eeprom_slot_newest(address, length, &sequence);
+    ++sequence;
+    if (newest != 1) {
+        address += EEPROM_SLOT_SIZE(length);
+    }
+
+    uint16_t crc = _crc_ccitt_update(0xffff, sequence);
+    const uint8_t* data = src;
+    for (uint8_t i = 0; i < length; ++i) {
+        crc = _crc_ccitt_update(crc, data[i]);
+    }
+
+    // the header and the start of the data make up the first page of the slot.
+    uint8_t page[PAGE_SIZE];
+    page[0] = sequence;
+    page[1] = crc & 0xff;
+    page[2] = crc >> 8;
+    uint8_t first_length = PAGE_SIZE - EEPROM_SLOT_HEADER_SIZE;
+    if (first_length > length) {
+        first_length = length;
+    }
+    memcpy(&page[EEPROM_SLOT_HEADER_SIZE], data, first_length);
+
+    // if the write is interrupted, the CRC won't match and the other slot is still valid.
+    sys_eeprom_write_absolute(address, EEPROM_SLOT_HEADER_SIZE + first_length, page);
+    sys_eeprom_write_absolute(address + PAGE_SIZE, length - first_length, data + first_length);
+}
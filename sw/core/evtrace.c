@@ -0,0 +1,107 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <core/evtrace.h>
+
+#if defined(EVENT_TRACE) && defined(BOOTLOADER)
+
+#include <boot/defs.h>
+
+#include <sys/time.h>
+
+#ifdef SIMULATION
+
+#include <pthread.h>
+
+// events are recorded from both the loop thread and the systick thread.
+static SIM_THREAD_LOCAL pthread_mutex_t evtrace_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int evtrace_lock_mutex(void) {
+    pthread_mutex_lock(&evtrace_mutex);
+    return 1;
+}
+
+static void evtrace_unlock_mutex(int* arg) {
+    pthread_mutex_unlock(&evtrace_mutex);
+}
+
+#define ATOMIC_BLOCK_IMPL for (int __i __attribute__((cleanup(evtrace_unlock_mutex))) \
+                          = evtrace_lock_mutex(); __i; __i = 0)
+#else
+
+#include <util/atomic.h>
+
+#define ATOMIC_BLOCK_IMPL ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#endif
+
+// the buffer is in app RAM, only its state is in the data shared with the bootloader.
+static SIM_THREAD_LOCAL evtrace_entry_t* _buffer;
+static SIM_THREAD_LOCAL uint8_t _mask;
+// position of the next event to write, and number of events recorded since last taken.
+static SIM_THREAD_LOCAL uint8_t _pos;
+static SIM_THREAD_LOCAL uint8_t _count;
+static SIM_THREAD_LOCAL uint8_t _lost;
+
+BOOTLOADER_NOINLINE
+void evtrace_start(evtrace_entry_t* buffer, uint8_t size) {
+    ATOMIC_BLOCK_IMPL {
+        _buffer = buffer;
+        _mask = size - 1;
+        _pos = 0;
+        _count = 0;
+        _lost = 0;
+    }
+}
+
+BOOTLOADER_NOINLINE
+void evtrace(uint8_t event, uint8_t arg) {
+    ATOMIC_BLOCK_IMPL {
+        if (_buffer) {
+            evtrace_entry_t* entry = &_buffer[_pos];
+            entry->event = event;
+            entry->arg = arg;
+            entry->time = sys_time_counter;
+            _pos = (_pos + 1) & _mask;
+            if (_count > _mask) {
+                // buffer is full, oldest event was overwritten.
+                if (_lost != UINT8_MAX) {
+                    ++_lost;
+                }
+            } else {
+                ++_count;
+            }
+        }
+    }
+}
+
+BOOTLOADER_NOINLINE
+uint8_t evtrace_take(evtrace_entry_t* dst, uint8_t* lost) {
+    uint8_t count = 0;
+    ATOMIC_BLOCK_IMPL {
+        count = _count;
+        uint8_t pos = _pos - count;
+        for (uint8_t i = 0; i < count; ++i) {
+            *dst++ = _buffer[pos & _mask];
+            ++pos;
+        }
+        *lost = _lost;
+        _count = 0;
+        _lost = 0;
+    }
+    return count;
+}
+
+#endif //EVENT_TRACE && BOOTLOADER
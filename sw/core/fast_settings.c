@@ -0,0 +1,98 @@
+
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <core/fast_settings.h>
+#include <core/trace.h>
+
+#include <string.h>
+#include <stdbool.h>
+
+#if FAST_SETTINGS_OFFSET + FAST_SETTINGS_SIZE > FAST_SETTINGS_AREA_SIZE
+#error "Fast settings allocation exceeds the internal EEPROM area available to apps"
+#endif
+
+#ifdef SIMULATION
+
+// the internal EEPROM isn't persisted in simulation.
+static uint8_t _internal_eeprom[FAST_SETTINGS_AREA_START + FAST_SETTINGS_AREA_SIZE] = {
+        [0 ... FAST_SETTINGS_AREA_START + FAST_SETTINGS_AREA_SIZE - 1] = 0xff
+};
+
+#define FAST_SETTINGS_START (_internal_eeprom + FAST_SETTINGS_AREA_START + FAST_SETTINGS_OFFSET)
+#define PAGE_SIZE 32
+
+#define _eeprom_wait_ready()
+#define _eeprom_program_page()
+
+#else
+
+#include <avr/io.h>
+
+#define FAST_SETTINGS_START \
+        ((uint8_t*) (EEPROM_START + FAST_SETTINGS_AREA_START + FAST_SETTINGS_OFFSET))
+#define PAGE_SIZE EEPROM_PAGE_SIZE
+
+/**
+ * Wait until the last page write is done. The page buffer can't be written and the mapped
+ * EEPROM can't be read before that.
+ */
+static void _eeprom_wait_ready(void) {
+    while (NVMCTRL.STATUS & NVMCTRL_EEBUSY_bm);
+}
+
+/**
+ * Erase and write the bytes loaded in the page buffer, without waiting for completion.
+ */
+static void _eeprom_program_page(void) {
+    _PROTECTED_WRITE_SPM(NVMCTRL.CTRLA, NVMCTRL_CMD_PAGEERASEWRITE_gc);
+}
+
+#endif
+
+void fast_settings_read(uint8_t address, uint8_t length, void* dest) {
+    _eeprom_wait_ready();
+    memcpy(dest, FAST_SETTINGS_START + address, length);
+}
+
+void fast_settings_write(uint8_t address, uint8_t length, const void* src) {
+    if (address + length > FAST_SETTINGS_SIZE) {
+#ifdef RUNTIME_CHECKS
+        trace("Writing past the end of fast settings reserved space.");
+#endif
+        return;
+    }
+
+    uint8_t* dst = FAST_SETTINGS_START + address;
+    const uint8_t* s = src;
+    while (length) {
+        _eeprom_wait_ready();
+        // load the changed bytes of a page in the page buffer, then program only those bytes.
+        bool changed = false;
+        do {
+            if (*dst != *s) {
+                *dst = *s;
+                changed = true;
+            }
+            ++dst;
+            ++s;
+            --length;
+        } while (length && (uintptr_t) dst % PAGE_SIZE != 0);
+        if (changed) {
+            _eeprom_program_page();
+        }
+    }
+}
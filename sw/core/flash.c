@@ -16,27 +16,141 @@
  */
 
 #include <core/flash.h>
+#include <core/trace.h>
 
 #include <sys/flash.h>
+#include <sys/spi.h>
 #include <sys/defs.h>
 
 void flash_read(flash_t address, uint16_t length, void* dest) {
     sys_flash_read_relative(address, length, dest);
 }
 
+void flash_stream_open(flash_t address) {
+    sys_flash_stream_open_relative(address);
+}
+
+void flash_stream_read(uint16_t length, void* dest) {
+    sys_flash_stream_read(length, dest);
+}
+
+void flash_stream_close(void) {
+    sys_flash_stream_close();
+}
+
+flash_frame_stats_t flash_get_frame_stats(void) {
+#ifdef FLASH_MONITOR
+    return sys_flash_frame_stats;
+#else
+    return (flash_frame_stats_t) {0};
+#endif
+}
+
+flash_t flash_space_size(void) {
+    return (flash_t) sys_flash_space_sectors * FLASH_SECTOR_SIZE;
+}
+
+void flash_space_read(flash_t address, uint16_t length, void* dest) {
+    sys_flash_read_absolute(address + sys_flash_space_offset, length, dest);
+}
+
+void flash_space_write(flash_t address, uint16_t length, const void* src) {
+    if (address + length > flash_space_size()) {
+#ifdef RUNTIME_CHECKS
+        trace("Writing past the end of flash data space.");
+#endif
+        return;
+    }
+    address += sys_flash_space_offset;
+    const uint8_t* buffer = src;
+    while (length != 0) {
+        // program up to the end of the flash page, so that programming doesn't wrap around.
+        uint16_t chunk = FLASH_PAGE_SIZE - (uint8_t) address;
+        if (chunk > length) {
+            chunk = length;
+        }
+        sys_flash_program(address, chunk, buffer);
+        buffer += chunk;
+        address += chunk;
+        length -= chunk;
+    }
+}
+
+void flash_space_erase(flash_t address) {
+    if (address >= flash_space_size()) {
+#ifdef RUNTIME_CHECKS
+        trace("Erasing past the end of flash data space.");
+#endif
+        return;
+    }
+    sys_flash_erase_sector(address + sys_flash_space_offset);
+}
+
+bool flash_space_is_busy(void) {
+    return sys_flash_is_busy();
+}
+
+// flash status, see AT25SF081B datasheet. Used by both the bootloader and the app.
+#define INSTRUCTION_READ_STATUS 0x05
+#define STATUS_BUSY 0x01
+
 #ifdef BOOTLOADER
 
 #include <boot/defs.h>
-#include <sys/spi.h>
 
+// The normal read instruction is used even though the flash (AT25SF081B) supports faster ones.
+// The SPI clock is 5 MHz (see sys/init.c), far below the maximum clock for this instruction,
+// so Fast Read would only add a dummy byte to each read. Dual Output Read needs a second data
+// line that the SPI peripheral doesn't have.
 #define INSTRUCTION_READ 0x03
 #define INSTRUCTION_POWER_DOWN_ENABLE 0xb9
 #define INSTRUCTION_POWER_DOWN_DISABLE 0xab
 
-flash_t sys_flash_offset;
+SIM_THREAD_LOCAL bool sys_flash_write_pending;
+SIM_THREAD_LOCAL flash_t sys_flash_offset;
+SIM_THREAD_LOCAL flash_t sys_flash_space_offset;
+SIM_THREAD_LOCAL uint16_t sys_flash_space_sectors;
+
+#ifdef FLASH_MONITOR
+SIM_THREAD_LOCAL flash_frame_stats_t sys_flash_curr_stats;
+SIM_THREAD_LOCAL flash_frame_stats_t sys_flash_frame_stats;
+
+void sys_flash_start_frame(void) {
+    sys_flash_frame_stats = sys_flash_curr_stats;
+    sys_flash_curr_stats.bytes = 0;
+    sys_flash_curr_stats.reads = 0;
+#if defined(SIMULATION) && defined(FLASH_FRAME_BUDGET)
+    if (sys_flash_frame_stats.bytes > FLASH_FRAME_BUDGET) {
+        trace("frame read %u bytes from flash in %u reads, budget is %u bytes",
+              (unsigned) sys_flash_frame_stats.bytes, sys_flash_frame_stats.reads,
+              (unsigned) FLASH_FRAME_BUDGET);
+    }
+#endif
+}
+#endif
 
 BOOTLOADER_NOINLINE
-void sys_flash_read_absolute(flash_t address, uint16_t length, void* dest) {
+void sys_flash_wait_ready(void) {
+    sys_spi_select_flash();
+    sys_spi_transmit_single(INSTRUCTION_READ_STATUS);
+    uint8_t status;
+    do {
+        // the status register is output continuously until the CS line is released.
+        sys_spi_transceive(1, &status);
+    } while (status & STATUS_BUSY);
+    sys_spi_deselect_flash();
+    sys_flash_write_pending = false;
+}
+
+BOOTLOADER_NOINLINE
+void sys_flash_stream_open_absolute(flash_t address) {
+    if (sys_flash_write_pending) {
+        // the flash ignores reads while programming or erasing, the data read would be undefined.
+        sys_flash_wait_ready();
+    }
+#ifdef FLASH_MONITOR
+    ++sys_flash_curr_stats.reads;
+#endif
     uint8_t header[4];
     header[0] = INSTRUCTION_READ;
     header[1] = address >> 16;
@@ -44,11 +158,33 @@ void sys_flash_read_absolute(flash_t address, uint16_t length, void* dest) {
     header[3] = address & 0xff;
     sys_spi_select_flash();
     sys_spi_transceive(4, header);
+}
+
+BOOTLOADER_NOINLINE
+void sys_flash_read_absolute(flash_t address, uint16_t length, void* dest) {
+    sys_flash_stream_open_absolute(address);
     sys_spi_transceive(length, dest);
     sys_spi_deselect_flash();
+#ifdef FLASH_MONITOR
+    sys_flash_curr_stats.bytes += length;
+#endif
+}
+
+BOOTLOADER_NOINLINE
+uint16_t sys_flash_read_crc(flash_t address, uint16_t length, void* dest, uint16_t crc) {
+    sys_flash_stream_open_absolute(address);
+    crc = sys_spi_receive_crc(length, dest, crc);
+    sys_spi_deselect_flash();
+#ifdef FLASH_MONITOR
+    sys_flash_curr_stats.bytes += length;
+#endif
+    return crc;
 }
 
 void sys_flash_sleep(void) {
+    if (sys_flash_write_pending) {
+        sys_flash_wait_ready();
+    }
     sys_spi_select_flash();
     sys_spi_transmit_single(INSTRUCTION_POWER_DOWN_ENABLE);
     sys_spi_deselect_flash();
@@ -67,7 +203,84 @@ void sys_flash_set_offset(flash_t address) {
     sys_flash_offset = address;
 }
 
+ALWAYS_INLINE
+void sys_flash_set_space_location(flash_t address, uint16_t sectors) {
+    sys_flash_space_offset = address;
+    sys_flash_space_sectors = sectors;
+}
+
 ALWAYS_INLINE
 void sys_flash_read_relative(flash_t address, uint16_t length, void* dest) {
     sys_flash_read_absolute(address + sys_flash_offset, length, dest);
 }
+
+ALWAYS_INLINE
+void sys_flash_stream_open_relative(flash_t address) {
+    sys_flash_stream_open_absolute(address + sys_flash_offset);
+}
+
+ALWAYS_INLINE
+void sys_flash_stream_read(uint16_t length, void* dest) {
+    if (length != 0) {
+        sys_spi_transceive(length, dest);
+#ifdef FLASH_MONITOR
+        sys_flash_curr_stats.bytes += length;
+#endif
+    }
+}
+
+ALWAYS_INLINE
+void sys_flash_stream_close(void) {
+    sys_spi_deselect_flash();
+}
+
+// flash instructions used to write flash, see AT25SF081B datasheet.
+#define INSTRUCTION_PAGE_PROGRAM 0x02
+#define INSTRUCTION_WRITE_ENABLE 0x06
+#define INSTRUCTION_ERASE_4KB 0x20
+
+bool sys_flash_is_busy(void) {
+    if (!sys_flash_write_pending) {
+        return false;
+    }
+    sys_spi_select_flash();
+    sys_spi_transmit_single(INSTRUCTION_READ_STATUS);
+    uint8_t status;
+    sys_spi_transceive(1, &status);
+    sys_spi_deselect_flash();
+    if (status & STATUS_BUSY) {
+        return true;
+    }
+    sys_flash_write_pending = false;
+    return false;
+}
+
+/**
+ * Wait for the flash to be ready, enable writing, then send an instruction with an address.
+ * The flash is left selected.
+ */
+static void _flash_write_command(uint8_t instruction, flash_t address) {
+    sys_flash_wait_ready();
+    sys_spi_select_flash();
+    sys_spi_transmit_single(INSTRUCTION_WRITE_ENABLE);
+    sys_spi_deselect_flash();
+
+    sys_spi_select_flash();
+    sys_spi_transmit_single(instruction);
+    sys_spi_transmit_single(address >> 16);
+    sys_spi_transmit_single(address >> 8);
+    sys_spi_transmit_single(address);
+}
+
+void sys_flash_program(flash_t address, uint16_t length, const void* src) {
+    _flash_write_command(INSTRUCTION_PAGE_PROGRAM, address);
+    sys_spi_transmit(length, src);
+    sys_spi_deselect_flash();
+    sys_flash_write_pending = true;
+}
+
+void sys_flash_erase_sector(flash_t address) {
+    _flash_write_command(INSTRUCTION_ERASE_4KB, address);
+    sys_spi_deselect_flash();
+    sys_flash_write_pending = true;
+}
@@ -16,18 +16,107 @@
 
 #include <core/fpsmon.h>
 #include <core/graphics.h>
+#include <core/math.h>
 #include <core/utils.h>
 #include <core/time.h>
 #include <core/trace.h>
 
 #include <sys/display.h>
 
+#ifdef LOOP_MONITOR
+#include <sys/time.h>
+
+// Main loop phases bar, drawn above the FPS monitor, with one segment per phase.
+#define LOOP_BAR_Y 119
+#define LOOP_BAR_HEIGHT 2
+
+// bar segment color for each phase: other, battery, sound, loop, draw, display, idle.
+static const uint8_t LOOP_PHASE_COLORS[SYS_LOOP_PHASE_COUNT] = {4, 15, 6, 12, 9, 2, 0};
+#endif
+
+#ifdef SOUND_MONITOR
+#include <sys/sound.h>
+
+#ifdef F_CPU
+#define CPU_FREQUENCY F_CPU
+#else
+// not defined in simulation
+#define CPU_FREQUENCY 10000000
+#endif
+#endif
+
+#ifdef STACK_MONITOR
+#include <sys/ram.h>
+#endif
+
+#ifdef FLASH_MONITOR
+#include <core/flash.h>
+#endif
+
 #define MONITOR_PERIOD millis_to_ticks(1000)
-#define DISPLAY_PAGE_COUNT (uint8_t) ((DISPLAY_HEIGHT + DISPLAY_PAGE_HEIGHT - 1) / DISPLAY_PAGE_HEIGHT)
 
-static uint8_t frames_last_second;
-static uint8_t pages_this_second;
-static systime_t start_time;
+static SIM_THREAD_LOCAL uint8_t frames_last_second;
+static SIM_THREAD_LOCAL uint8_t pages_this_second;
+static SIM_THREAD_LOCAL systime_t start_time;
+#ifdef SOUND_MONITOR
+static SIM_THREAD_LOCAL uint8_t sound_load_last_second;
+#endif
+#ifdef STACK_MONITOR
+static SIM_THREAD_LOCAL uint16_t stack_high_water;
+#endif
+#ifdef LOOP_MONITOR
+static SIM_THREAD_LOCAL uint8_t loop_phase_widths[SYS_LOOP_PHASE_COUNT];
+
+static void update_loop_phase_widths(void) {
+    // share the display width between phases in proportion of the ticks sampled in each.
+    uint16_t samples[SYS_LOOP_PHASE_COUNT];
+    sys_time_take_loop_samples(samples);
+    uint16_t total = 0;
+    for (uint8_t i = 0; i < SYS_LOOP_PHASE_COUNT; ++i) {
+        total += samples[i];
+    }
+    if (total == 0) {
+        return;
+    }
+    for (uint8_t i = 0; i < SYS_LOOP_PHASE_COUNT; ++i) {
+        loop_phase_widths[i] = (uint8_t) ((uint32_t) samples[i] * DISPLAY_WIDTH / total);
+    }
+}
+
+static void draw_loop_phase_bar(void) {
+    disp_x_t x = 0;
+    for (uint8_t i = 0; i < SYS_LOOP_PHASE_COUNT; ++i) {
+        const uint8_t width = loop_phase_widths[i];
+        if (width != 0) {
+            graphics_set_color(LOOP_PHASE_COLORS[i]);
+            graphics_fill_rect(x, LOOP_BAR_Y, width, LOOP_BAR_HEIGHT);
+            x += width;
+        }
+    }
+    // fill the rounding remainder so that the bar always spans the display width.
+    if (x < DISPLAY_WIDTH) {
+        graphics_set_color(DISPLAY_COLOR_BLACK);
+        graphics_fill_rect(x, LOOP_BAR_Y, DISPLAY_WIDTH - x, LOOP_BAR_HEIGHT);
+    }
+}
+#endif
+
+#if defined(STACK_MONITOR) || defined(FLASH_MONITOR)
+static void draw_counter(disp_x_t x, uint8_t width, uint24_t value) {
+    graphics_set_color(DISPLAY_COLOR_BLACK);
+    graphics_fill_rect(x, 122, width, 6);
+    graphics_set_color(DISPLAY_COLOR_WHITE);
+    char buf[9];
+    char* ptr = &buf[8];
+    *ptr = '\0';
+    do {
+        const uint24_t q = math_div10_u32(value);
+        *(--ptr) = (char) (value - q * 10 + '0');
+        value = q;
+    } while (value);
+    graphics_text(x + 2, 123, ptr);
+}
+#endif
 
 void fpsmon_draw(void) {
     ++pages_this_second;
@@ -39,10 +128,25 @@ void fpsmon_draw(void) {
         if (diff >= MONITOR_PERIOD) {
             // account for time difference that may be greater than monitor period and
             // calculate frames rendered last second in tenths of frames.
+            // page height may be changed by the app between frames, the page count isn't constant.
+            const uint8_t page_count = (DISPLAY_HEIGHT + sys_display_page_height - 1) /
+                                       sys_display_page_height;
             frames_last_second = (uint24_t) ((uint16_t) pages_this_second * 10) * MONITOR_PERIOD /
-                                 (uint16_t) (diff * DISPLAY_PAGE_COUNT);
+                                 (uint16_t) (diff * page_count);
             pages_this_second = 0;
             start_time = time;
+#ifdef SOUND_MONITOR
+            // percentage of CPU time spent in channel timer interrupts last second.
+            const uint32_t cycles = (uint32_t) sys_sound_take_isr_count() *
+                                    SYS_SOUND_ISR_CYCLES * MONITOR_PERIOD / diff;
+            sound_load_last_second = cycles / (CPU_FREQUENCY / 100);
+#endif
+#ifdef LOOP_MONITOR
+            update_loop_phase_widths();
+#endif
+#ifdef STACK_MONITOR
+            stack_high_water = sys_ram_get_stack_high_water();
+#endif
         }
     }
 
@@ -53,15 +157,40 @@ void fpsmon_draw(void) {
     graphics_set_color(DISPLAY_COLOR_WHITE);
 
     // format frames in "XX.X" format
-    uint8_t frames = frames_last_second;
+    const uint8_t frames = frames_last_second;
+    const uint8_t frames_int = math_div10_u8(frames);
     char buf[6];
     buf[1] = ' ';
     buf[5] = '\0';
-    buf[4] = (char) ((frames % 10) + '0');
-    frames /= 10;
-    uint8_to_str(buf, frames);
+    buf[4] = (char) (frames - frames_int * 10 + '0');
+    uint8_to_str(buf, frames_int);
     buf[3] = '.';
 
     graphics_text(0, 123, buf + 1);
+
+#ifdef SOUND_MONITOR
+    // format sound load in "XX%" format, next to frames.
+    graphics_set_color(DISPLAY_COLOR_BLACK);
+    graphics_fill_rect(16, 122, 16, 6);
+    graphics_set_color(DISPLAY_COLOR_WHITE);
+    const char* load = uint8_to_str(buf, sound_load_last_second);
+    buf[3] = '%';
+    buf[4] = '\0';
+    graphics_text(18, 123, load);
+#endif
+
+#ifdef STACK_MONITOR
+    // stack high-water mark in bytes, right of sound load.
+    draw_counter(32, 18, stack_high_water);
+#endif
+
+#ifdef FLASH_MONITOR
+    // flash bytes read during the last frame, right of stack high-water mark.
+    draw_counter(50, 22, flash_get_frame_stats().bytes);
+#endif
+
+#ifdef LOOP_MONITOR
+    draw_loop_phase_bar();
+#endif
 }
 
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <core/framecache.h>
+#include <core/display.h>
+#include <core/trace.h>
+
+#include <sys/display.h>
+#include <sys/flash.h>
+
+enum {
+    STATE_INVALID,
+    // the cache was erased and pages are being saved.
+    STATE_SAVING,
+    STATE_VALID,
+};
+
+static SIM_THREAD_LOCAL uint8_t _state;
+
+void framecache_begin(void) {
+    for (flash_t address = SYS_FLASH_FRAME_CACHE_ADDR; address < SYS_FLASH_SIZE;
+         address += FLASH_SECTOR_SIZE) {
+        sys_flash_erase_sector(address);
+    }
+    sys_flash_wait_ready();
+    _state = STATE_SAVING;
+}
+
+void framecache_save_page(void) {
+#ifdef RUNTIME_CHECKS
+    if (_state == STATE_INVALID) {
+        trace("frame cache saved without being erased first");
+        return;
+    }
+#endif
+    if (_state != STATE_SAVING) {
+        return;
+    }
+    const uint8_t* buffer = sys_display_buffer_at(0, 0);
+    flash_t address = SYS_FLASH_FRAME_CACHE_ADDR + sys_display_page_ystart * DISPLAY_NUM_COLS;
+    uint16_t length = sys_display_curr_page_height * DISPLAY_NUM_COLS;
+    while (length != 0) {
+        // program up to the end of the flash page, so that programming doesn't wrap around.
+        uint16_t chunk = FLASH_PAGE_SIZE - (uint8_t) address;
+        if (chunk > length) {
+            chunk = length;
+        }
+        sys_flash_program(address, chunk, buffer);
+        buffer += chunk;
+        address += chunk;
+        length -= chunk;
+    }
+    sys_flash_wait_ready();
+    if (sys_display_page_yend == DISPLAY_HEIGHT - 1) {
+        _state = STATE_VALID;
+    }
+}
+
+void framecache_restore_page(void) {
+    sys_flash_read_absolute(SYS_FLASH_FRAME_CACHE_ADDR + sys_display_page_ystart * DISPLAY_NUM_COLS,
+                            sys_display_curr_page_height * DISPLAY_NUM_COLS,
+                            sys_display_buffer_at(0, 0));
+}
+
+bool framecache_is_valid(void) {
+    return _state == STATE_VALID;
+}
+
+void framecache_invalidate(void) {
+    _state = STATE_INVALID;
+}
@@ -19,6 +19,7 @@
 #include <core/trace.h>
 
 #include <core/data.h>
+#include <sys/data.h>
 #include <sys/display.h>
 
 #include <string.h>
@@ -53,6 +54,11 @@
 
 #define FONT_MAX_GLYPHS (FONT_RANGE0_LEN + FONT_RANGE1_LEN)
 #define FONT_MAX_Y_OFFSET_BITS 7
+#define FONT_OFFSET_BITS_MASK 0x7
+#define FONT_FLAG_ROW_ALIGNED (1 << 3)
+#define FONT_GLYPH_SIZE_MASK 0x3f
+#define FONT_FLAG_REMAP (1 << 7)
+#define FONT_REMAP_NONE 0xff
 #define FONT_MIN_GLYPH_SIZE 1
 #define FONT_MAX_GLYPH_SIZE 33
 #define FONT_MAX_LINE_SPACING 32
@@ -62,8 +68,14 @@
 #define IMAGE_INDEX_HEADER_SIZE 2
 #define IMAGE_TYPE_FLAGS (IMAGE_FLAG_BINARY | IMAGE_FLAG_RAW)
 
+#define IMAGE_LZ_SIGNATURE 0xf3
+#define IMAGE_LZ_MIN_MATCH 3
+// size of the LZ history window, window positions wrap around on 8 bits.
+#define IMAGE_LZ_WINDOW_SIZE 256
+
 #define IMAGE_INDEX_BUFFER_SIZE 8
 #define IMAGE_BUFFER_SIZE 16
+#define TILEMAP_BUFFER_SIZE 32
 
 #define IMAGE_ALPHA_COLOR_NONE 0xff
 #define IMAGE_BOTTOM_NONE 0xff
@@ -91,7 +103,7 @@ typedef struct {
 
 // currently selected color, black by default.
 #ifdef SIMULATION
-static disp_color_t color;
+static SIM_THREAD_LOCAL disp_color_t color;
 #else
 
 #include <avr/io.h>
@@ -100,7 +112,8 @@ static disp_color_t color;
 #endif
 
 #ifdef BOOTLOADER
-graphics_font_data_t graphics_font;
+SIM_THREAD_LOCAL graphics_font_data_t graphics_font;
+SIM_THREAD_LOCAL const uint8_t* graphics_static_header;
 
 const uint8_t GRAPHICS_BUILTIN_FONT_DATA[] = {
         0xf0, 0x3a, 0x02, 0x42, 0x00, 0x06, 0x0c, 0xdb, 0x00, 0xb4, 0xfa, 0xbe,
@@ -141,6 +154,16 @@ const uint8_t GRAPHICS_BUILTIN_FONT_DATA[] = {
         }                                   \
     } while (0);
 
+// masks of the display block pixels set by a pair of 1-bit pixels, indexed by the two bits,
+// with the leftmost pixel in the least significant bit (raw images) or in the most significant
+// bit (row-aligned glyphs). Used with `set_block_masked` to draw two pixels at a time.
+static const uint8_t BINARY_PAIR_MASK_LSB[4] = {0x00, 0x0f, 0xf0, 0xff};
+static const uint8_t BINARY_PAIR_MASK_MSB[4] = {0x00, 0xf0, 0x0f, 0xff};
+
+// set the pixels of a block in a mask to a block color (color in both nibbles).
+#define set_block_masked(block_color, mask, block) \
+    ((block) = ((block) & ~(mask)) | ((block_color) & (mask)))
+
 #define swap(T, a, b) do { \
         T temp = (a);      \
         (a) = (b);         \
@@ -152,27 +175,51 @@ const uint8_t GRAPHICS_BUILTIN_FONT_DATA[] = {
 
 #define saturate_sub(a, b) ((a) <= (b) ? 0 : ((a) - (b)))
 
+#ifdef __AVR__
+// avr-gcc fails to generate ld/st instructions with post-increment on the X register.
+// instead, it generates adiw/sbiw instructions to do it, which is pretty inefficient.
+// These macros force the compiler to use the correct instructions.
+#define LD_X(ptr, val) asm volatile("ld %0, %a1" : "=r" (val), "=x" (ptr) : "1" (ptr))
+#define ST_X_INC(ptr, val) asm volatile("st %a0+, %1" : "=x" (ptr) : "r" (val), "0" (ptr))
+#else
+#define LD_X(ptr, val) ((val) = *(ptr))
+#define ST_X_INC(ptr, val) (*(ptr)++ = (val))
+#endif
+
 
 
 #ifdef BOOTLOADER
 
 BOOTLOADER_NOINLINE
 void graphics_set_font(graphics_font_t f) {
-    // read font header to get its specs
+    // read font header to get its specs, unless given at build time.
+    const uint8_t* static_header = graphics_static_header;
+    graphics_static_header = 0;
     uint8_t header[FONT_HEADER_SIZE];
-    data_read(f, FONT_HEADER_SIZE, header);
+    if (static_header) {
+        memcpy(header, static_header, sizeof header);
+    } else {
+        data_read(f, sizeof header, header);
+    }
     if (header[0] != FONT_SIGNATURE) {
         trace("invalid font signature");
         return;
     }
     graphics_font.addr = f + FONT_HEADER_SIZE;
     graphics_font.glyph_count = header[1];
-    graphics_font.glyph_size = header[2];
+    graphics_font.glyph_size = header[2] & FONT_GLYPH_SIZE_MASK;
     graphics_font.width = (header[3] & 0xf) + 1;
     graphics_font.height = (header[3] >> 4) + 1;
-    graphics_font.offset_bits = header[4] & 0xf;
+    graphics_font.offset_bits = header[4] & FONT_OFFSET_BITS_MASK;
     graphics_font.offset_max = header[4] >> 4;
+    graphics_font.row_aligned = (header[4] & FONT_FLAG_ROW_ALIGNED) != 0;
     graphics_font.line_spacing = header[5];
+    graphics_font.cache_count = 0;
+    graphics_font.remap_count = 0;
+    if (header[2] & FONT_FLAG_REMAP) {
+        data_read(graphics_font.addr + graphics_font.glyph_count * graphics_font.glyph_size,
+                  1, &graphics_font.remap_count);
+    }
 
 #ifdef RUNTIME_CHECKS
     if (graphics_font.glyph_count > FONT_MAX_GLYPHS) {
@@ -184,7 +231,7 @@ void graphics_set_font(graphics_font_t f) {
     if (graphics_font.glyph_size < FONT_MIN_GLYPH_SIZE || graphics_font.glyph_size > FONT_MAX_GLYPH_SIZE) {
         trace("font glyph size out of bounds");
     }
-    if (graphics_font.offset_max >= (1 << graphics_font.offset_bits)) {
+    if (!graphics_font.row_aligned && graphics_font.offset_max >= (1 << graphics_font.offset_bits)) {
         trace("max offset not coherent with offset bits");
     }
     if (graphics_font.line_spacing > FONT_MAX_LINE_SPACING) {
@@ -201,9 +248,8 @@ void graphics_clear(disp_color_t c) {
         return;
     }
 #endif
-    c = nibble_copy(c);
-    uint8_t* buffer = sys_display_buffer_at(0, 0);
-    memset(buffer, c, sys_display_curr_page_height * DISPLAY_NUM_COLS);
+    // the page buffer is only written to if something is drawn over it afterwards.
+    sys_display_fill_page(nibble_copy(c));
 }
 
 BOOTLOADER_NOINLINE
@@ -297,8 +343,7 @@ void graphics_vline(disp_y_t y0, disp_y_t y1, const disp_x_t x) {
 BOOTLOADER_NOINLINE
 void graphics_rect(const disp_x_t x, const disp_y_t y, const uint8_t w, const uint8_t h) {
 #ifdef RUNTIME_CHECKS
-    if (x >= DISPLAY_WIDTH || y >= DISPLAY_HEIGHT ||
-        x + w > DISPLAY_WIDTH || y + h > DISPLAY_HEIGHT) {
+    if (x >= DISPLAY_WIDTH || y >= DISPLAY_HEIGHT || x + w > DISPLAY_WIDTH) {
         trace("outside of bounds");
         return;
     }
@@ -307,10 +352,17 @@ void graphics_rect(const disp_x_t x, const disp_y_t y, const uint8_t w, const ui
         return;
     }
 #endif
+    if (y > sys_display_page_yend || y + h <= sys_display_page_ystart) {
+        return;  // completely out of page
+    }
     const uint8_t right = x + w - 1;
-    const uint8_t bottom = y + h - 1;
+    uint8_t bottom = DISPLAY_HEIGHT - 1;
+    if (y + h <= DISPLAY_HEIGHT) {
+        // bottom side is on display, otherwise rectangle is clipped.
+        bottom = y + h - 1;
+        graphics_hline(x, right, bottom);
+    }
     graphics_hline(x, right, y);
-    graphics_hline(x, right, bottom);
     graphics_vline(y, bottom, x);
     graphics_vline(y, bottom, right);
 }
@@ -318,7 +370,7 @@ void graphics_rect(const disp_x_t x, const disp_y_t y, const uint8_t w, const ui
 BOOTLOADER_NOINLINE
 void graphics_fill_rect(const disp_x_t x, const disp_y_t y, const uint8_t w, const uint8_t h) {
 #ifdef RUNTIME_CHECKS
-    if (x + w > DISPLAY_WIDTH || y + h > DISPLAY_HEIGHT) {
+    if (x + w > DISPLAY_WIDTH || y >= DISPLAY_HEIGHT) {
         trace("outside of bounds");
         return;
     }
@@ -327,19 +379,58 @@ void graphics_fill_rect(const disp_x_t x, const disp_y_t y, const uint8_t w, con
         return;
     }
 #endif
-    uint8_t y1 = y + h;
-    if (y + h <= sys_display_page_ystart) {
+    if (y > sys_display_page_yend || y + h <= sys_display_page_ystart) {
         return;  // completely out of page
     }
-    // get coordinates within current page
+    // get coordinates within current page, clipping the part past the end of page.
     const uint8_t y0 = y <= sys_display_page_ystart ? 0 : y - sys_display_page_ystart;
-    y1 = y1 > sys_display_page_yend ? sys_display_curr_page_height : y1 - sys_display_page_ystart;
+    const uint8_t y1 = y + h > sys_display_page_yend ?
+                       sys_display_curr_page_height : y + h - sys_display_page_ystart;
+    if (w == DISPLAY_WIDTH && y0 == 0 && y1 == sys_display_curr_page_height) {
+        // rectangle covers the whole page, same as clearing it.
+        sys_display_fill_page(nibble_copy(color));
+        return;
+    }
     const uint8_t x1 = x + w - 1;
     for (uint8_t i = y0; i < y1; ++i) {
         graphics_hline_fast(x, x1, i);
     }
 }
 
+/**
+ * Index cursor for an indexed image, saved when the image is drawn on a page so that the
+ * index lookup on the next page can resume from there instead of iterating over all the
+ * previous pages again. Cursors are identified by the image address and drawn region,
+ * so image data at that address is assumed not to change between pages. Cursors are
+ * invalidated on the first page of every frame, and when RAM that may hold images is reused.
+ */
+typedef struct {
+    graphics_image_t image;
+    data_ptr_t data;
+    data_ptr_t index_pos;
+    uint8_t y;
+    uint8_t top;
+    uint8_t bottom;
+    // start Y coordinate of the page on which the cursor can be used.
+    uint8_t page_start;
+    uint8_t index_y;
+    uint8_t actual_top;
+} image_cursor_t;
+
+#define IMAGE_CURSOR_COUNT 2
+
+static SIM_THREAD_LOCAL image_cursor_t image_cursors[IMAGE_CURSOR_COUNT];
+// index of the cursor to replace when there's no cursor for an image yet (round-robin).
+static SIM_THREAD_LOCAL uint8_t image_cursor_next;
+
+BOOTLOADER_NOINLINE
+void graphics_image_invalidate_cursors(void) {
+    // cursors are only looked up when the page doesn't start at Y=0, so this never matches.
+    for (uint8_t i = 0; i < IMAGE_CURSOR_COUNT; ++i) {
+        image_cursors[i].page_start = 0;
+    }
+}
+
 /**
  * This function loads image parameters from the data space and computes the Y position
  * as well as the top and bottom position in the current display page.
@@ -363,6 +454,10 @@ BOOTLOADER_NOINLINE
 static bool graphics_create_context(image_context_t* ctx, graphics_image_t data,
                                     const disp_x_t x, const disp_y_t y,
                                     const uint8_t top, uint8_t bottom) {
+    // header given at build time only applies to a single call.
+    const uint8_t* static_header = graphics_static_header;
+    graphics_static_header = 0;
+
 #ifdef RUNTIME_CHECKS
     if (x >= DISPLAY_WIDTH || y >= DISPLAY_HEIGHT) {
         trace("out of bounds");
@@ -370,9 +465,19 @@ static bool graphics_create_context(image_context_t* ctx, graphics_image_t data,
     }
 #endif
 
+    if (y > sys_display_page_yend) {
+        // image starts after current page, no need to read header.
+        return false;
+    }
+    const graphics_image_t image = data;
+
     // read image header and index header (even if not indexed)
     uint8_t header[IMAGE_HEADER_SIZE + IMAGE_INDEX_HEADER_SIZE];
-    data_read(data, sizeof header, header);
+    if (static_header) {
+        memcpy(header, static_header, sizeof header);
+    } else {
+        data_read(data, sizeof header, header);
+    }
 #ifdef RUNTIME_CHECKS
     if (header[0] != IMAGE_SIGNATURE) {
         trace("invalid image signature");
@@ -402,13 +507,8 @@ static bool graphics_create_context(image_context_t* ctx, graphics_image_t data,
         bottom = height;
     }
 
-    if (y > sys_display_page_yend || (uint8_t) (y + (bottom - top)) < sys_display_page_ystart) {
-        // out of page, either completely before or after.
-        return false;
-    }
-
 #ifdef RUNTIME_CHECKS
-    if (x + width >= DISPLAY_WIDTH || y + bottom - top >= DISPLAY_HEIGHT) {
+    if (x + width >= DISPLAY_WIDTH) {
         trace("out of bounds");
         return false;
     }
@@ -426,6 +526,15 @@ static bool graphics_create_context(image_context_t* ctx, graphics_image_t data,
     }
 #endif //RUNTIME_CHECKS
 
+    if (y + (bottom - top) >= DISPLAY_HEIGHT) {
+        // clip the part of image past the bottom of display.
+        bottom = top + (DISPLAY_HEIGHT - 1 - y);
+    }
+    if (y + (bottom - top) < sys_display_page_ystart) {
+        // image ends before current page.
+        return false;
+    }
+
     // Find the image position and bounds for the current page
     uint8_t page_y;
     uint8_t page_top;
@@ -442,11 +551,31 @@ static bool graphics_create_context(image_context_t* ctx, graphics_image_t data,
 
         // To use the index, it's necessary to iterate over all pages that the image was drawn on
         // to know how many rows were drawn on those pages, in order to find the first row to draw
-        // on the current page.
+        // on the current page. If the image was drawn on the previous page, the cursor saved
+        // then is used to resume from the current page directly.
         uint8_t page_start = 0;
-        uint8_t page_end = sys_display_page_height - 1;
         uint8_t index_y = 0;
         uint8_t actual_top = top;
+        image_cursor_t* cursor = 0;
+        if (sys_display_page_ystart != 0) {
+            for (uint8_t i = 0; i < IMAGE_CURSOR_COUNT; ++i) {
+                image_cursor_t* c = &image_cursors[i];
+                if (c->page_start == sys_display_page_ystart && c->image == image &&
+                    c->y == y && c->top == top && c->bottom == bottom) {
+                    cursor = c;
+                    page_start = c->page_start;
+                    index_y = c->index_y;
+                    actual_top = c->actual_top;
+                    data = c->data;
+                    index_pos = c->index_pos;
+                    break;
+                }
+            }
+        }
+        uint8_t page_end = page_start + sys_display_page_height - 1;
+        if (page_end >= DISPLAY_HEIGHT) {
+            page_end = DISPLAY_HEIGHT - 1;
+        }
         while (true) {
             // If y is smaller than page end, then the current page is the one on which image starts.
             if (y <= page_end) {
@@ -472,12 +601,31 @@ static bool graphics_create_context(image_context_t* ctx, graphics_image_t data,
                 page_bottom = page_top + min((uint8_t) (page_end - page_start - page_y),
                                              (uint8_t) (bottom - actual_top));
 
+                uint8_t actual_bottom = index_y + page_bottom;
+                actual_top = actual_bottom + 1;
+
                 if (page_end == sys_display_page_yend) {
+                    if (page_end != DISPLAY_HEIGHT - 1 && actual_bottom < bottom) {
+                        // Image continues on the next page, save cursor for it.
+                        if (!cursor) {
+                            cursor = &image_cursors[image_cursor_next];
+                            if (++image_cursor_next == IMAGE_CURSOR_COUNT) {
+                                image_cursor_next = 0;
+                            }
+                            cursor->image = image;
+                            cursor->y = y;
+                            cursor->top = top;
+                            cursor->bottom = bottom;
+                        }
+                        cursor->page_start = page_end + 1;
+                        cursor->index_y = index_y;
+                        cursor->actual_top = actual_top;
+                        cursor->data = data;
+                        // unread entries in the index buffer will be read again.
+                        cursor->index_pos = index_pos - (sizeof index_buf - index_buf_pos);
+                    }
                     break;
                 }
-
-                uint8_t actual_bottom = index_y + page_bottom;
-                actual_top = actual_bottom + 1;
             }
 
             page_start += sys_display_page_height;
@@ -535,6 +683,7 @@ BOOTLOADER_NOINLINE
 static void graphics_image_1bit_mixed_internal(graphics_image_t data, const disp_x_t x,
                                                const disp_y_t y, const uint8_t top,
                                                const uint8_t bottom) {
+    trace_spi_tag("graphics_image_1bit_mixed");
     image_context_t ctx;
     if (!graphics_create_context(&ctx, data, x, y, top, bottom)) {
         return;
@@ -556,15 +705,17 @@ static void graphics_image_1bit_mixed_internal(graphics_image_t data, const disp
     uint8_t y_img = 0;
     // current coordinates within the page
     uint8_t x_page = ctx.x;
-    uint8_t y_page = ctx.y;
 
     uint8_t next_index_bound = ctx.index_gran;
 
-    uint8_t* buffer = sys_display_buffer_at(x_page, y_page);
+    // the page fill is checked once, rows are then reached by offsetting the first one.
+    uint8_t* row_start = sys_display_buffer_at(x_page, ctx.y);
+    uint8_t* buffer = row_start;
+    sys_data_stream_open(data);
     while (true) {
         if (buf_pos == sizeof buf) {
             // image data buffer is empty, read more data.
-            data_read(data, sizeof buf, buf);
+            sys_data_stream_read(data, sizeof buf, buf);
             data += sizeof buf;
             buf_pos = 0;
         }
@@ -594,10 +745,10 @@ static void graphics_image_1bit_mixed_internal(graphics_image_t data, const disp
                     x_page = ctx.x;
                     if (y_img == ctx.bottom) {
                         // bottom of image reached.
-                        return;
+                        goto done;
                     }
-                    ++y_page;
-                    buffer = sys_display_buffer_at(x_page, y_page);
+                    row_start += DISPLAY_NUM_COLS;
+                    buffer = row_start;
                 }
                 ++y_img;
                 if (y_img == next_index_bound) {
@@ -606,7 +757,7 @@ static void graphics_image_1bit_mixed_internal(graphics_image_t data, const disp
 #ifdef RUNTIME_CHECKS
                     if ((byte & 0x80) && pixels > 0) {
                         trace("decoding RLE on index bound");
-                        return;
+                        goto done;
                     }
 #endif //RUNTIME_CHECKS
                     next_index_bound += ctx.index_gran;
@@ -617,11 +768,89 @@ static void graphics_image_1bit_mixed_internal(graphics_image_t data, const disp
             }
         }
     }
+done:
+    sys_data_stream_close(data);
 }
 
 
 BOOTLOADER_NOINLINE
+/**
+ * Draw a glyph of a row-aligned font, where each row is stored on whole bytes, most significant
+ * bit first, after a Y offset byte if the font has an offset. `y` is relative to page start.
+ * Rows above the page are skipped without decoding them, and zero bits at the end of a row
+ * byte aren't iterated on.
+ */
+static void graphics_glyph_row_aligned(const int8_t x, int8_t y, const uint8_t* glyph) {
+    if (graphics_font.offset_max) {
+        y = (int8_t) (y + *glyph++);
+    }
+    const uint8_t row_bytes = (graphics_font.width + 7) / 8;
+    uint8_t rows = graphics_font.height;
+    if (y < 0) {
+        const uint8_t skipped = -y;
+        if (skipped >= rows) {
+            return;
+        }
+        glyph += skipped * row_bytes;
+        rows -= skipped;
+        y = 0;
+    }
+    // glyphs on an even X coordinate and fully on display are drawn two pixels at a time.
+    const bool aligned = !(x & 1) && x >= 0 && x + graphics_font.width <= DISPLAY_WIDTH;
+    const uint8_t block_color = nibble_copy(color);
+    uint8_t* row_start = aligned ? sys_display_buffer_at(x, y) : 0;
+    // unsigned so that the last row of a 128 rows page doesn't overflow.
+    for (uint8_t y_page = y; rows && y_page < sys_display_curr_page_height; --rows, ++y_page) {
+        if (aligned) {
+            uint8_t* buffer = row_start;
+            row_start += DISPLAY_NUM_COLS;
+            uint8_t cols_left = graphics_font.width;
+            for (uint8_t i = 0; i < row_bytes; ++i) {
+                uint8_t byte = *glyph++;
+                for (uint8_t j = 0; j < 4 && cols_left; ++j) {
+                    uint8_t mask = BINARY_PAIR_MASK_MSB[byte >> 6];
+                    if (cols_left == 1) {
+                        // odd last column, the right pixel of the block isn't part of the glyph.
+                        mask &= 0x0f;
+                    }
+                    if (mask) {
+                        set_block_masked(block_color, mask, *buffer);
+                    }
+                    ++buffer;
+                    byte <<= 2;
+                    cols_left = saturate_sub(cols_left, 2);
+                }
+            }
+            continue;
+        }
+        int16_t row_x = x;
+        for (uint8_t i = 0; i < row_bytes; ++i, row_x += 8) {
+            uint8_t byte = *glyph++;
+            int16_t curr_x = row_x;
+            while (byte) {
+                if ((byte & 0x80) && curr_x >= 0 && curr_x < DISPLAY_WIDTH) {
+                    graphics_pixel_fast(curr_x, y_page);
+                }
+                byte <<= 1;
+                ++curr_x;
+            }
+        }
+    }
+}
+
+BOOTLOADER_NOINLINE
+uint8_t graphics_font_remap(uint8_t pos) {
+    // the remap table follows the glyph data, after its length byte.
+    if (pos >= graphics_font.remap_count) {
+        return FONT_REMAP_NONE;
+    }
+    data_read(graphics_font.addr + graphics_font.glyph_count * graphics_font.glyph_size + 1 + pos,
+              1, &pos);
+    return pos;
+}
+
 void graphics_glyph(int8_t x, int8_t y, char c) {
+    trace_spi_tag("graphics_glyph");
 #ifdef RUNTIME_CHECKS
     if (graphics_font.addr == 0) {
         trace("no font set");
@@ -652,7 +881,10 @@ void graphics_glyph(int8_t x, int8_t y, char c) {
         // 0x21-0x7f
         pos -= FONT_RANGE0_START;
     }
-    if (pos > graphics_font.glyph_count) {
+    if (graphics_font.remap_count) {
+        pos = graphics_font_remap(pos);
+    }
+    if (pos >= graphics_font.glyph_count) {
         // Not encoded by the font data. This is the defined path for the space symbol notably,
         // but should probably be reported for non-blank other symbols.
 #ifdef RUNTIME_CHECKS
@@ -663,17 +895,33 @@ void graphics_glyph(int8_t x, int8_t y, char c) {
         return;
     }
 
-    // read all glyph data
-    data_ptr_t addr = graphics_font.addr + pos * graphics_font.glyph_size;
+    // read all glyph data, from the cache if possible.
     uint8_t buf[FONT_MAX_GLYPH_SIZE];
-    data_read(addr, graphics_font.glyph_size, buf);
+    const uint8_t* glyph = buf;
+    const uint8_t cache_pos = pos - graphics_font.cache_start;
+    if (cache_pos < graphics_font.cache_count) {
+        glyph = graphics_font.cache + cache_pos * graphics_font.glyph_size;
+    } else {
+        // fonts in program memory or RAM are read in place.
+        data_ptr_t addr = graphics_font.addr + pos * graphics_font.glyph_size;
+        glyph = data_get_pointer(addr);
+        if (!glyph) {
+            data_read(addr, graphics_font.glyph_size, buf);
+            glyph = buf;
+        }
+    }
+
+    if (graphics_font.row_aligned) {
+        graphics_glyph_row_aligned(x, curr_y, glyph);
+        return;
+    }
 
     uint8_t byte_pos = graphics_font.glyph_size - 1;
     uint8_t bits = 8;
     uint8_t line_left = graphics_font.width;
 
     // apply glyph offset
-    uint16_t first_byte = buf[byte_pos];
+    uint16_t first_byte = glyph[byte_pos];
     first_byte <<= graphics_font.offset_bits;
     curr_y = (int8_t) (curr_y + (first_byte >> 8));
     if (curr_y >= sys_display_curr_page_height) {
@@ -687,7 +935,7 @@ void graphics_glyph(int8_t x, int8_t y, char c) {
 
     while (byte_pos--) {
         bits = 8;
-        byte = buf[byte_pos];
+        byte = glyph[byte_pos];
 glyph_read:
         while (bits--) {
             if ((byte & 0x80) && curr_x >= 0 && curr_y >= 0) {
@@ -748,6 +996,7 @@ BOOTLOADER_NOINLINE
 static void graphics_image_4bit_mixed_internal(graphics_image_t data, const disp_x_t x,
                                                const disp_y_t y, const uint8_t top,
                                                const uint8_t bottom) {
+    trace_spi_tag("graphics_image_4bit_mixed");
     image_context_t ctx;
     if (!graphics_create_context(&ctx, data, x, y, top, bottom)) {
         return;
@@ -769,7 +1018,6 @@ static void graphics_image_4bit_mixed_internal(graphics_image_t data, const disp
     uint8_t y_img = 0;
     // current coordinates within the page
     uint8_t x_page = ctx.x;
-    uint8_t y_page = ctx.y;
 
     uint8_t next_index_bound = ctx.index_gran;
 
@@ -784,7 +1032,10 @@ static void graphics_image_4bit_mixed_internal(graphics_image_t data, const disp
     };
     uint8_t state = 0;
 
-    uint8_t* buffer = sys_display_buffer_at(x_page, y_page);
+    // the page fill is checked once, rows are then reached by offsetting the first one.
+    uint8_t* row_start = sys_display_buffer_at(x_page, ctx.y);
+    uint8_t* buffer = row_start;
+    sys_data_stream_open(data);
     while (true) {
         if (buf_pos >= sizeof buf - 1) {
             // Image data buffer is empty, read more data.
@@ -793,7 +1044,7 @@ static void graphics_image_4bit_mixed_internal(graphics_image_t data, const disp
             if (buf_pos == sizeof buf - 1) {
                 buf[0] = buf[sizeof buf - 1];
             }
-            data_read(data, buf_pos, buf + (sizeof buf - buf_pos));
+            sys_data_stream_read(data, buf_pos, buf + (sizeof buf - buf_pos));
             data += buf_pos;
             buf_pos = 0;
         }
@@ -859,10 +1110,10 @@ draw:
                     x_page = ctx.x;
                     if (y_img == ctx.bottom) {
                         // bottom of image reached.
-                        return;
+                        goto done;
                     }
-                    ++y_page;
-                    buffer = sys_display_buffer_at(x_page, y_page);
+                    row_start += DISPLAY_NUM_COLS;
+                    buffer = row_start;
                 }
                 ++y_img;
                 if (y_img == next_index_bound) {
@@ -874,7 +1125,7 @@ draw:
                         // length is actually twice the encoded value, and one nibble may be left
                         // unused on an index boundary (hence the !(state & HAS_RAW_COLOR)).
                         trace("index bound in middle of sequence");
-                        return;
+                        goto done;
                     }
 #endif //RUNTIME_CHECKS
                     state = 0;
@@ -887,6 +1138,8 @@ draw:
         } while (rle_seq_length-- > 0);
         rle_seq_length = 0;  // if it was already 0, undo overflow.
     }
+done:
+    sys_data_stream_close(data);
 }
 
 
@@ -903,6 +1156,8 @@ void graphics_image_1bit_mixed_internal(graphics_image_t, disp_x_t, disp_y_t y,
 
 void graphics_image_4bit_mixed_internal(graphics_image_t, disp_x_t, disp_y_t y, uint8_t, uint8_t);
 
+uint8_t graphics_font_remap(uint8_t pos);
+
 #endif  //BOOTLOADER
 
 void graphics_set_color(disp_color_t c) {
@@ -970,45 +1225,84 @@ void graphics_line(disp_x_t x0, disp_y_t y0, disp_x_t x1, disp_y_t y1) {
         if (swapxy) {
             // octants 2, 3, 6, 7
             const int8_t ystep = y1 > y0 ? 1 : -1;
-            for (; x0 <= x1 && x0 <= sys_display_page_yend; ++x0) {
-                if (x0 >= sys_display_page_ystart) {
-                    graphics_pixel_fast(y0, x0 - sys_display_page_ystart);
+            if (x0 < sys_display_page_ystart) {
+                // Skip the rows before the page: find the number of steps on the minor axis
+                // and the error after that many steps on the major axis directly.
+                const uint8_t steps = sys_display_page_ystart - x0;
+                int16_t e = (int16_t) (err - (int16_t) steps * dy);
+                if (e < 0) {
+                    const uint8_t minor_steps = (uint16_t) (-e + dx - 1) / (uint8_t) dx;
+                    e = (int16_t) (e + (int16_t) minor_steps * dx);
+                    y0 += ystep * minor_steps;
                 }
+                err = (int8_t) e;
+                x0 = sys_display_page_ystart;
+            }
+            for (; x0 <= x1 && x0 <= sys_display_page_yend; ++x0) {
+                graphics_pixel_fast(y0, x0 - sys_display_page_ystart);
                 err = (int8_t) (err - dy);
                 if (err < 0) {
                     y0 += ystep;
                     err = (int8_t) (err + dx);
                 }
             }
-        } else if (y1 > y0) {
+            return;
+        }
+
+        // octants 1, 4, 5, 8: find the number of steps on the major axis needed to reach
+        // the page on the minor axis, if line starts outside of it.
+        const bool y_increasing = y1 > y0;
+        uint8_t rows_before = 0;
+        if (y_increasing) {
+            if (y0 > sys_display_page_yend) {
+                return;
+            }
+            if (y0 < sys_display_page_ystart) {
+                rows_before = sys_display_page_ystart - y0;
+            }
+        } else {
+            if (y0 < sys_display_page_ystart) {
+                return;
+            }
+            if (y0 > sys_display_page_yend) {
+                rows_before = y0 - sys_display_page_yend;
+            }
+        }
+        if (rows_before != 0) {
+            // first step after which the minor axis has moved by the number of rows.
+            const uint16_t steps = (uint16_t) (err + (uint16_t) (rows_before - 1) * dx) /
+                                   (uint8_t) dy + 1;
+            if (steps > (uint8_t) (x1 - x0)) {
+                return;  // line ends before page
+            }
+            x0 += steps;
+            err = (int8_t) (err - (int16_t) steps * dy + (int16_t) rows_before * dx);
+            y0 = y_increasing ? sys_display_page_ystart : sys_display_page_yend;
+        }
+
+        if (y_increasing) {
             // octants 1, 4
-            if (y0 <= sys_display_page_yend) {
-                for (; x0 <= x1; ++x0) {
-                    if (y0 >= sys_display_page_ystart) {
-                        graphics_pixel_fast(x0, y0 - sys_display_page_ystart);
-                    }
-                    err = (int8_t) (err - dy);
-                    if (err < 0) {
-                        ++y0;
-                        if (y0 > sys_display_page_yend) {
-                            break; // out of page
-                        }
-                        err = (int8_t) (err + dx);
+            for (; x0 <= x1; ++x0) {
+                graphics_pixel_fast(x0, y0 - sys_display_page_ystart);
+                err = (int8_t) (err - dy);
+                if (err < 0) {
+                    ++y0;
+                    if (y0 > sys_display_page_yend) {
+                        break; // out of page
                     }
+                    err = (int8_t) (err + dx);
                 }
             }
-        } else if (y0 >= sys_display_page_ystart) {
+        } else {
             // octants 5, 8
             for (; x0 <= x1; ++x0) {
-                if (y0 <= sys_display_page_yend) {
-                    graphics_pixel_fast(x0, y0 - sys_display_page_ystart);
-                }
+                graphics_pixel_fast(x0, y0 - sys_display_page_ystart);
                 err = (int8_t) (err - dy);
                 if (err < 0) {
-                    --y0;
-                    if (y0 < sys_display_page_ystart) {
+                    if (y0 == sys_display_page_ystart) {
                         break; // out of page
                     }
+                    --y0;
                     err = (int8_t) (err + dx);
                 }
             }
@@ -1016,9 +1310,65 @@ void graphics_line(disp_x_t x0, disp_y_t y0, disp_x_t x1, disp_y_t y1) {
     }
 }
 
+/**
+ * Fast path for 1-bit raw images starting on an even X coordinate. Pixels are expanded in pairs,
+ * each pair of bits giving the mask of the block pixels set to the current color, so that
+ * the display buffer is written a byte at a time.
+ */
+static void graphics_image_1bit_raw_aligned(const image_context_t* ctx) {
+    uint8_t buf[IMAGE_BUFFER_SIZE];
+    data_ptr_t data = ctx->data;
+    const uint8_t block_color = nibble_copy(color);
+    const uint8_t row_blocks = ctx->width / 2 + 1;
+
+    // for raw images, the top coordinate is always 0.
+    uint8_t rows_left = ctx->bottom + 1;
+    uint8_t col_left = ctx->width + 1;
+    uint8_t* buffer = sys_display_buffer_at(ctx->x, ctx->y);
+    sys_data_stream_open(data);
+    while (true) {
+        // fill buffer
+        sys_data_stream_read(data, sizeof buf, buf);
+        data += sizeof buf;
+
+        const uint8_t* buf_ptr = buf;
+        uint8_t buf_left = sizeof buf;
+        while (buf_left--) {
+            uint8_t byte = *buf_ptr++;
+            for (uint8_t i = 0; i < 4; ++i) {
+                uint8_t mask = BINARY_PAIR_MASK_LSB[byte & 3];
+                if (col_left == 1) {
+                    // odd last column, the right pixel of the block isn't part of the image.
+                    mask &= 0x0f;
+                }
+                if (mask) {
+                    set_block_masked(block_color, mask, *buffer);
+                }
+                ++buffer;
+                byte >>= 2;
+                if (col_left <= 2) {
+                    // end of scan line, go to next line
+                    if (--rows_left == 0) {
+                        // bottom of image reached.
+                        goto done;
+                    }
+                    col_left = ctx->width + 1;
+                    buffer += DISPLAY_NUM_COLS - row_blocks;
+                    // data in byte cannot cross rows
+                    break;
+                }
+                col_left -= 2;
+            }
+        }
+    }
+done:
+    sys_data_stream_close(data);
+}
+
 static void graphics_image_1bit_raw_internal(graphics_image_t data, const disp_x_t x,
                                              const disp_y_t y, const uint8_t top,
                                              const uint8_t bottom) {
+    trace_spi_tag("graphics_image_1bit_raw");
     image_context_t ctx;
     if (!graphics_create_context(&ctx, data, x, y, top, bottom)) {
         return;
@@ -1031,6 +1381,11 @@ static void graphics_image_1bit_raw_internal(graphics_image_t data, const disp_x
     }
 #endif
 
+    if (!(ctx.x & 1)) {
+        graphics_image_1bit_raw_aligned(&ctx);
+        return;
+    }
+
     uint8_t buf[IMAGE_BUFFER_SIZE];
     data = ctx.data;
 
@@ -1039,12 +1394,14 @@ static void graphics_image_1bit_raw_internal(graphics_image_t data, const disp_x
     uint8_t y_img = 0;
     // current coordinates within the page
     uint8_t x_page = ctx.x;
-    uint8_t y_page = ctx.y;
 
-    uint8_t* buffer = sys_display_buffer_at(x_page, y_page);
+    // the page fill is checked once, rows are then reached by offsetting the first one.
+    uint8_t* row_start = sys_display_buffer_at(x_page, ctx.y);
+    uint8_t* buffer = row_start;
+    sys_data_stream_open(data);
     while (true) {
         // fill buffer
-        data_read(data, sizeof buf, buf);
+        sys_data_stream_read(data, sizeof buf, buf);
         data += sizeof buf;
 
         // draw all pixels in buffer
@@ -1068,10 +1425,10 @@ static void graphics_image_1bit_raw_internal(graphics_image_t data, const disp_x
                         x_page = ctx.x;
                         if (y_img == ctx.bottom) {
                             // bottom of image reached.
-                            return;
+                            goto done;
                         }
-                        ++y_page;
-                        buffer = sys_display_buffer_at(x_page, y_page);
+                        row_start += DISPLAY_NUM_COLS;
+                        buffer = row_start;
                     }
                     ++y_img;
                     // data in byte cannot cross rows
@@ -1082,6 +1439,8 @@ static void graphics_image_1bit_raw_internal(graphics_image_t data, const disp_x
             }
         }
     }
+done:
+    sys_data_stream_close(data);
 }
 
 void graphics_image_1bit_raw(graphics_image_t data, const disp_x_t x, const disp_y_t y) {
@@ -1102,9 +1461,63 @@ void graphics_image_1bit_mixed_region(graphics_image_t data, const disp_x_t x, c
     graphics_image_1bit_mixed_internal(data, x, y, top, bottom);
 }
 
+/**
+ * Fast path for 4-bit raw images starting on an even X coordinate and with an even width.
+ * Image data has the same layout as the display buffer in that case, with two pixels per byte
+ * and no padding at the end of rows, so it's copied a whole byte at a time.
+ * If the image has alpha, pixels with the alpha color are masked out of each byte.
+ */
+static void graphics_image_4bit_raw_aligned(const image_context_t* ctx) {
+    uint8_t buf[IMAGE_BUFFER_SIZE];
+    data_ptr_t data = ctx->data;
+    const uint8_t row_bytes = ctx->width / 2 + 1;
+    const uint8_t alpha_low = ctx->alpha_color;
+    const uint8_t alpha_high = nibble_swap(alpha_low) & 0xf0;
+
+    // for raw images, the top coordinate is always 0.
+    uint8_t rows_left = ctx->bottom + 1;
+    uint8_t col_left = row_bytes;
+    uint8_t* buffer = sys_display_buffer_at(ctx->x, ctx->y);
+    sys_data_stream_open(data);
+    while (true) {
+        // fill buffer
+        sys_data_stream_read(data, sizeof buf, buf);
+        data += sizeof buf;
+
+        const uint8_t* buf_ptr = buf;
+        uint8_t buf_left = sizeof buf;
+        while (buf_left--) {
+            uint8_t byte = *buf_ptr++;
+            if (alpha_low != IMAGE_ALPHA_COLOR_NONE) {
+                uint8_t block;
+                LD_X(buffer, block);
+                if ((byte & 0xf) == alpha_low) {
+                    byte = (byte & 0xf0) | (block & 0xf);
+                }
+                if ((byte & 0xf0) == alpha_high) {
+                    byte = (byte & 0xf) | (block & 0xf0);
+                }
+            }
+            ST_X_INC(buffer, byte);
+            if (--col_left == 0) {
+                // end of scan line, go to next line
+                if (--rows_left == 0) {
+                    // bottom of image reached.
+                    goto done;
+                }
+                col_left = row_bytes;
+                buffer += DISPLAY_NUM_COLS - row_bytes;
+            }
+        }
+    }
+done:
+    sys_data_stream_close(data);
+}
+
 static void graphics_image_4bit_raw_internal(graphics_image_t data, const disp_x_t x,
                                              const disp_y_t y, const uint8_t top,
                                              const uint8_t bottom) {
+    trace_spi_tag("graphics_image_4bit_raw");
     image_context_t ctx;
     if (!graphics_create_context(&ctx, data, x, y, top, bottom)) {
         return;
@@ -1117,6 +1530,15 @@ static void graphics_image_4bit_raw_internal(graphics_image_t data, const disp_x
     }
 #endif
 
+    if (!(ctx.x & 1) && (ctx.width & 1)) {
+        // image is aligned on display blocks (even X, and even width since width is minus one).
+        graphics_image_4bit_raw_aligned(&ctx);
+        return;
+    }
+
+    // estimated at 61 cycles/px, less the 8 cycles/px of image data read over SPI.
+    trace_cycles((uint32_t) (ctx.bottom - ctx.top + 1) * (ctx.width + 1) * 53);
+
     uint8_t buf[IMAGE_BUFFER_SIZE];
     data = ctx.data;
 
@@ -1125,12 +1547,14 @@ static void graphics_image_4bit_raw_internal(graphics_image_t data, const disp_x
     uint8_t y_img = 0;
     // current coordinates within the page
     uint8_t x_page = ctx.x;
-    uint8_t y_page = ctx.y;
 
-    uint8_t* buffer = sys_display_buffer_at(x_page, y_page);
+    // the page fill is checked once, rows are then reached by offsetting the first one.
+    uint8_t* row_start = sys_display_buffer_at(x_page, ctx.y);
+    uint8_t* buffer = row_start;
+    sys_data_stream_open(data);
     while (true) {
         // fill buffer
-        data_read(data, sizeof buf, buf);
+        sys_data_stream_read(data, sizeof buf, buf);
         data += sizeof buf;
 
         // draw all pixels in buffer
@@ -1155,10 +1579,10 @@ static void graphics_image_4bit_raw_internal(graphics_image_t data, const disp_x
                         x_page = ctx.x;
                         if (y_img == ctx.bottom) {
                             // bottom of image reached.
-                            return;
+                            goto done;
                         }
-                        ++y_page;
-                        buffer = sys_display_buffer_at(x_page, y_page);
+                        row_start += DISPLAY_NUM_COLS;
+                        buffer = row_start;
                     }
                     ++y_img;
                     // data in byte cannot cross rows
@@ -1169,6 +1593,8 @@ static void graphics_image_4bit_raw_internal(graphics_image_t data, const disp_x
             }
         }
     }
+done:
+    sys_data_stream_close(data);
 }
 
 
@@ -1190,6 +1616,371 @@ void graphics_image_4bit_mixed_region(graphics_image_t data, const disp_x_t x, c
     graphics_image_4bit_mixed_internal(data, x, y, top, bottom);
 }
 
+/**
+ * Draw a horizontal span of a raw image row on a page row, each pixel repeated `factor` times.
+ * The span starts at pixel `skip` of the first byte of `row` and is `width` + 1 pixels wide.
+ * Display blocks are written a byte at a time when the span starts on an even X coordinate,
+ * and either the factor is even, or the image is unscaled and its pixels pair up with blocks.
+ */
+static void graphics_image_raw_row(const uint8_t* row, const disp_x_t x, const uint8_t y_page,
+                                   const uint8_t skip, const uint8_t width, const uint8_t factor,
+                                   const uint8_t alpha_color, const bool binary) {
+    uint8_t* buffer = sys_display_buffer_at(x, y_page);
+    uint8_t x_page = x;
+    uint8_t pixels_left = width + 1;
+    if (!binary && factor == 1 && !(x & 1) && !skip) {
+        // image data has the same layout as the display buffer, copy pixel pairs as is.
+        for (; pixels_left >= 2; pixels_left -= 2) {
+            uint8_t byte = *row++;
+            if (alpha_color != IMAGE_ALPHA_COLOR_NONE) {
+                const uint8_t block = *buffer;
+                if ((byte & 0xf) == alpha_color) {
+                    byte = (byte & 0xf0) | (block & 0xf);
+                }
+                if ((byte >> 4) == alpha_color) {
+                    byte = (byte & 0xf) | (block & 0xf0);
+                }
+            }
+            *buffer++ = byte;
+        }
+        if (!pixels_left) {
+            return;
+        }
+        // odd last pixel is drawn below.
+        x_page += width;
+    } else if (binary && factor == 1 && !(x & 1) && !(skip & 1)) {
+        // pixels pair up with display blocks, expand them two at a time.
+        const uint8_t block_color = nibble_copy(color);
+        uint8_t byte = *row++ >> skip;
+        uint8_t pairs_left = (8 - skip) / 2;
+        while (true) {
+            uint8_t mask = BINARY_PAIR_MASK_LSB[byte & 3];
+            if (pixels_left == 1) {
+                mask &= 0x0f;
+            }
+            if (mask) {
+                set_block_masked(block_color, mask, *buffer);
+            }
+            ++buffer;
+            if (pixels_left <= 2) {
+                return;
+            }
+            pixels_left -= 2;
+            if (--pairs_left == 0) {
+                byte = *row++;
+                pairs_left = 4;
+            } else {
+                byte >>= 2;
+            }
+        }
+    }
+
+    const bool aligned = !(x_page & 1) && !(factor & 1);
+    const uint8_t bpp = binary ? 1 : 4;
+    uint8_t byte_left = 8 / bpp - skip;
+    uint8_t shift_reg = *row++ >> (skip * bpp);
+    while (true) {
+        uint8_t c;
+        bool opaque;
+        if (binary) {
+            c = color;
+            opaque = shift_reg & 1;
+        } else {
+            c = shift_reg & 0xf;
+            opaque = c != alpha_color;
+        }
+        if (aligned) {
+            const uint8_t block = nibble_copy(c);
+            for (uint8_t i = factor / 2; i > 0; --i) {
+                if (opaque) {
+                    *buffer = block;
+                }
+                ++buffer;
+            }
+        } else {
+            for (uint8_t i = factor; i > 0; --i) {
+                if (opaque) {
+                    set_buffer_pixel(c, x_page, buffer);
+                } else if (x_page & 1) {
+                    ++buffer;
+                }
+                ++x_page;
+            }
+        }
+        if (--pixels_left == 0) {
+            break;
+        }
+        if (--byte_left == 0) {
+            shift_reg = *row++;
+            byte_left = 8 / bpp;
+        } else {
+            shift_reg >>= bpp;
+        }
+    }
+}
+
+/**
+ * Read the next row span of a raw image, from the opened data stream if rows are read whole.
+ */
+static void graphics_image_raw_read_row(const data_ptr_t data, const uint8_t length,
+                                        uint8_t* row, const bool stream) {
+    if (stream) {
+        sys_data_stream_read(data, length, row);
+    } else {
+        data_read(data, length, row);
+    }
+}
+
+/**
+ * Draw a rectangular region of a raw image, with bounds inclusive, scaled up by `factor`.
+ * Bounds can be `IMAGE_BOTTOM_NONE` to extend to the right or bottom of the image.
+ * Only the image rows on the current page are read, and only the bytes in the region are read
+ * from each row, so a tile can be drawn from a large sheet without reading the whole sheet.
+ * Each image row is read once and drawn on all the display rows it covers.
+ */
+static void graphics_image_raw_rect_internal(graphics_image_t data, const disp_x_t x,
+                                             const disp_y_t y, const uint8_t left,
+                                             const uint8_t top, uint8_t right, uint8_t bottom,
+                                             const uint8_t factor, const bool binary) {
+    // header given at build time only applies to a single call.
+    const uint8_t* static_header = graphics_static_header;
+    graphics_static_header = 0;
+
+    if (y > sys_display_page_yend) {
+        // image starts after current page, no need to read header.
+        return;
+    }
+
+    uint8_t header[IMAGE_HEADER_SIZE];
+    if (static_header) {
+        memcpy(header, static_header, sizeof header);
+    } else {
+        data_read(data, sizeof header, header);
+    }
+    const uint8_t flags = header[1];
+    const uint8_t width = header[2];
+    const uint8_t height = header[3];
+    if (right == IMAGE_BOTTOM_NONE) {
+        right = width;
+    }
+    if (bottom == IMAGE_BOTTOM_NONE) {
+        bottom = height;
+    }
+
+#ifdef RUNTIME_CHECKS
+    if (header[0] != IMAGE_SIGNATURE) {
+        trace("invalid image signature");
+        return;
+    }
+    if ((flags & IMAGE_TYPE_FLAGS) != (binary ? IMAGE_FLAG_BINARY | IMAGE_FLAG_RAW : IMAGE_FLAG_RAW)) {
+        trace("wrong image type for call");
+        return;
+    }
+    if (factor == 0) {
+        trace("scale factor must not be zero");
+        return;
+    }
+    if (left > right || right > width || top > bottom || bottom > height) {
+        trace("region out of bounds");
+        return;
+    }
+    if (x + (right - left + 1) * factor > DISPLAY_WIDTH || y >= DISPLAY_HEIGHT) {
+        trace("out of bounds");
+        return;
+    }
+#endif
+
+    uint8_t alpha_color = IMAGE_ALPHA_COLOR_NONE;
+    if (flags & IMAGE_FLAG_ALPHA) {
+        alpha_color = flags & 0xf;
+    }
+
+    // find the display rows covered by the region on the current page, clipped at the bottom.
+    uint16_t last_y = y + (bottom - top + 1) * factor - 1;
+    if (last_y < sys_display_page_ystart) {
+        // image ends before current page.
+        return;
+    }
+    if (last_y > sys_display_page_yend) {
+        last_y = sys_display_page_yend;
+    }
+    const uint8_t first_y = max(sys_display_page_ystart, y);
+    const uint8_t first_row = top + (first_y - y) / factor;
+    // number of times the current image row is left to be drawn.
+    uint8_t row_left = factor - (first_y - y) % factor;
+
+    // rows are read whole with a single data stream, otherwise only the span in each row is read.
+    const uint8_t pixels_per_byte = binary ? 8 : 2;
+    const uint8_t row_bytes = width / pixels_per_byte + 1;
+    const uint8_t span_bytes = right / pixels_per_byte - left / pixels_per_byte + 1;
+    const uint8_t skip = left % pixels_per_byte;
+    const bool stream = span_bytes == row_bytes;
+    data += IMAGE_HEADER_SIZE + (uint16_t) first_row * row_bytes + left / pixels_per_byte;
+
+    uint8_t row[DISPLAY_NUM_COLS + 1];
+    if (stream) {
+        sys_data_stream_open(data);
+    }
+    graphics_image_raw_read_row(data, span_bytes, row, stream);
+    data += row_bytes;
+    uint8_t y_page = first_y - sys_display_page_ystart;
+    const uint8_t y_page_end = last_y - sys_display_page_ystart;
+    while (true) {
+        graphics_image_raw_row(row, x, y_page, skip, right - left, factor, alpha_color, binary);
+        if (y_page == y_page_end) {
+            break;
+        }
+        ++y_page;
+        if (--row_left == 0) {
+            graphics_image_raw_read_row(data, span_bytes, row, stream);
+            data += row_bytes;
+            row_left = factor;
+        }
+    }
+    if (stream) {
+        sys_data_stream_close(data);
+    }
+}
+
+void graphics_image_1bit_raw_rect(graphics_image_t data, const disp_x_t x, const disp_y_t y,
+                                  const uint8_t left, const uint8_t top,
+                                  const uint8_t right, const uint8_t bottom) {
+    trace_spi_tag("graphics_image_1bit_raw_rect");
+    graphics_image_raw_rect_internal(data, x, y, left, top, right, bottom, 1, true);
+}
+
+void graphics_image_4bit_raw_rect(graphics_image_t data, const disp_x_t x, const disp_y_t y,
+                                  const uint8_t left, const uint8_t top,
+                                  const uint8_t right, const uint8_t bottom) {
+    trace_spi_tag("graphics_image_4bit_raw_rect");
+    graphics_image_raw_rect_internal(data, x, y, left, top, right, bottom, 1, false);
+}
+
+void graphics_image_1bit_raw_scaled(graphics_image_t data, const disp_x_t x, const disp_y_t y,
+                                    const uint8_t factor) {
+    trace_spi_tag("graphics_image_1bit_raw_scaled");
+    graphics_image_raw_rect_internal(data, x, y, 0, 0, IMAGE_BOTTOM_NONE, IMAGE_BOTTOM_NONE,
+                                     factor, true);
+}
+
+void graphics_image_4bit_raw_scaled(graphics_image_t data, const disp_x_t x, const disp_y_t y,
+                                    const uint8_t factor) {
+    trace_spi_tag("graphics_image_4bit_raw_scaled");
+    graphics_image_raw_rect_internal(data, x, y, 0, 0, IMAGE_BOTTOM_NONE, IMAGE_BOTTOM_NONE,
+                                     factor, false);
+}
+
+/**
+ * Draw rows of a tile from a tileset, at a position in the current page.
+ * All visible rows of a tile are contiguous in tileset data, so they are read in as few
+ * reads as possible, limited by the buffer size.
+ */
+static void graphics_tile_rows(data_ptr_t addr, uint8_t* buffer, const uint8_t row_bytes,
+                               uint8_t rows, const uint8_t alpha_color) {
+    uint8_t buf[TILEMAP_BUFFER_SIZE];
+    const uint8_t alpha_high = nibble_swap(alpha_color) & 0xf0;
+    const uint8_t rows_per_read = sizeof buf / row_bytes;
+    while (rows) {
+        const uint8_t read_rows = rows < rows_per_read ? rows : rows_per_read;
+        data_read(addr, read_rows * row_bytes, buf);
+        addr += read_rows * row_bytes;
+        rows -= read_rows;
+
+        const uint8_t* buf_ptr = buf;
+        for (uint8_t i = 0; i < read_rows; ++i) {
+            for (uint8_t j = 0; j < row_bytes; ++j) {
+                uint8_t byte = *buf_ptr++;
+                if (alpha_color != IMAGE_ALPHA_COLOR_NONE) {
+                    uint8_t block;
+                    LD_X(buffer, block);
+                    if ((byte & 0xf) == alpha_color) {
+                        byte = (byte & 0xf0) | (block & 0xf);
+                    }
+                    if ((byte & 0xf0) == alpha_high) {
+                        byte = (byte & 0xf) | (block & 0xf0);
+                    }
+                }
+                ST_X_INC(buffer, byte);
+            }
+            buffer += DISPLAY_NUM_COLS - row_bytes;
+        }
+    }
+}
+
+void graphics_tilemap(graphics_image_t tileset, const uint8_t tile_height,
+                      graphics_tile_getter_t get_tile, const uint8_t map_col,
+                      const uint8_t map_row, const disp_x_t x, const disp_y_t y,
+                      const uint8_t cols, const uint8_t rows) {
+    trace_spi_tag("graphics_tilemap");
+    if (y > sys_display_page_yend || y + rows * tile_height <= sys_display_page_ystart) {
+        return;  // completely out of page
+    }
+
+    uint8_t header[IMAGE_HEADER_SIZE];
+    data_read(tileset, sizeof header, header);
+    const uint8_t flags = header[1];
+    const uint8_t row_bytes = header[2] / 2 + 1;
+    const uint8_t alpha_color = flags & IMAGE_FLAG_ALPHA ? flags & 0xf : IMAGE_ALPHA_COLOR_NONE;
+#ifdef RUNTIME_CHECKS
+    if (header[0] != IMAGE_SIGNATURE) {
+        trace("invalid image signature");
+        return;
+    }
+    if ((flags & IMAGE_TYPE_FLAGS) != IMAGE_FLAG_RAW) {
+        trace("tileset must be a 4-bit raw image");
+        return;
+    }
+    if ((x & 1) || !(header[2] & 1)) {
+        trace("tilemap X and tile width must be even");
+        return;
+    }
+    if (row_bytes > TILEMAP_BUFFER_SIZE) {
+        trace("tile width too large");
+        return;
+    }
+    if (tile_height == 0 || x + cols * (header[2] + 1) > DISPLAY_WIDTH) {
+        trace("tilemap out of bounds");
+        return;
+    }
+#endif
+    tileset += IMAGE_HEADER_SIZE;
+    const uint16_t tile_size = tile_height * row_bytes;
+
+    // find the first row of tiles on the current page, tile rows are clipped to the page once.
+    uint8_t row = 0;
+    uint8_t tile_y = y;
+    if (y < sys_display_page_ystart) {
+        row = (sys_display_page_ystart - y) / tile_height;
+        tile_y = y + row * tile_height;
+    }
+    for (; row < rows; ++row) {
+        // rows of the tile within the current page.
+        const uint8_t tile_top = tile_y < sys_display_page_ystart ?
+                                 sys_display_page_ystart - tile_y : 0;
+        uint8_t tile_rows = tile_height - tile_top;
+        const uint8_t page_y = tile_y + tile_top - sys_display_page_ystart;
+        if (page_y + tile_rows > sys_display_curr_page_height) {
+            tile_rows = sys_display_curr_page_height - page_y;
+        }
+        const data_ptr_t row_addr = tileset + tile_top * row_bytes;
+
+        uint8_t* buffer = sys_display_buffer_at(x, page_y);
+        for (uint8_t col = 0; col < cols; ++col) {
+            const uint8_t tile = get_tile(map_col + col, map_row + row);
+            if (tile != GRAPHICS_TILE_NONE) {
+                graphics_tile_rows(row_addr + tile * tile_size, buffer,
+                                   row_bytes, tile_rows, alpha_color);
+            }
+            buffer += row_bytes;
+        }
+
+        if (tile_y + tile_height > sys_display_page_yend) {
+            break;  // next row of tiles is on the next page, or past display bottom.
+        }
+        tile_y += tile_height;
+    }
+}
+
 void graphics_text_wrap(const int8_t x, const int8_t y, const uint8_t wrap_x, const char* text) {
 #ifdef RUNTIME_CHECKS
     if (graphics_font.addr == 0) {
@@ -1280,6 +2071,50 @@ uint8_t graphics_text_width(const char* text) {
     return width - GRAPHICS_GLYPH_SPACING;
 }
 
+uint8_t graphics_set_font_cache(uint8_t* buffer, const uint16_t size, const char first) {
+    trace_spi_tag("graphics_set_font_cache");
+    graphics_font.cache_count = 0;
+    if (size < graphics_font.glyph_size) {
+        return 0;
+    }
+#ifdef RUNTIME_CHECKS
+    if (graphics_font.addr == 0) {
+        trace("no font set");
+        return 0;
+    }
+#endif
+
+    // get the position of the first glyph, same as in graphics_glyph.
+    uint8_t pos = first;
+    if (pos >= FONT_RANGE1_START) {
+        pos -= FONT_RANGE1_START - FONT_RANGE0_LEN;
+    } else if (pos >= FONT_RANGE0_START && pos <= FONT_RANGE0_END) {
+        pos -= FONT_RANGE0_START;
+    } else {
+#ifdef RUNTIME_CHECKS
+        trace("first cached character is not encoded");
+#endif
+        return 0;
+    }
+    if (graphics_font.remap_count) {
+        pos = graphics_font_remap(pos);
+    }
+    if (pos >= graphics_font.glyph_count) {
+        return 0;
+    }
+
+    uint16_t count = size / graphics_font.glyph_size;
+    if (count > graphics_font.glyph_count - pos) {
+        count = graphics_font.glyph_count - pos;
+    }
+    data_read(graphics_font.addr + pos * graphics_font.glyph_size,
+              count * graphics_font.glyph_size, buffer);
+    graphics_font.cache = buffer;
+    graphics_font.cache_start = pos;
+    graphics_font.cache_count = count;
+    return count;
+}
+
 uint8_t graphics_glyph_width(void) {
     return graphics_font.width;
 }
@@ -1291,3 +2126,392 @@ uint8_t graphics_text_height(void) {
 uint8_t graphics_text_max_height(void) {
     return graphics_font.height + graphics_font.offset_max;
 }
+
+/**
+ * Sequential reader used to decode a whole image in the image cache, reading from a data stream.
+ */
+typedef struct {
+    data_ptr_t data;
+    uint8_t buf[IMAGE_BUFFER_SIZE];
+    uint8_t pos;
+} image_reader_t;
+
+static uint8_t graphics_image_read_byte(image_reader_t* reader) {
+    if (reader->pos == sizeof reader->buf) {
+        sys_data_stream_read(reader->data, sizeof reader->buf, reader->buf);
+        reader->data += sizeof reader->buf;
+        reader->pos = 0;
+    }
+    return reader->buf[reader->pos++];
+}
+
+static void graphics_image_cache_1bit(image_reader_t* reader, uint8_t* row, const uint8_t width,
+                                      const uint8_t height, const uint8_t index_gran) {
+    // same decoding as graphics_image_1bit_mixed_internal, but in a raw image buffer.
+    const uint8_t bytes_per_row = width / 8 + 1;
+    uint8_t x_img = 0;
+    uint8_t y_img = 0;
+    uint8_t next_index_bound = index_gran;
+    while (true) {
+        const uint8_t byte = graphics_image_read_byte(reader);
+        uint8_t pixels = byte & 0x80 ? (byte & 0x3f) + 8 : 7;
+        uint8_t shift_reg = byte;
+        while (pixels--) {
+            if (shift_reg & 0x40) {
+                row[x_img / 8] |= 1 << (x_img % 8);
+            }
+            if (!(byte & 0x80)) {
+                shift_reg <<= 1;
+            }
+            if (x_img == width) {
+                x_img = 0;
+                if (y_img == height) {
+                    return;
+                }
+                ++y_img;
+                row += bytes_per_row;
+                if (y_img == next_index_bound) {
+                    next_index_bound += index_gran;
+                    break;
+                }
+            } else {
+                ++x_img;
+            }
+        }
+    }
+}
+
+static void graphics_image_cache_4bit(image_reader_t* reader, uint8_t* row, const uint8_t width,
+                                      const uint8_t height, const uint8_t index_gran) {
+    // same decoding as graphics_image_4bit_mixed_internal, but in a raw image buffer.
+    const uint8_t bytes_per_row = width / 2 + 1;
+    uint8_t x_img = 0;
+    uint8_t y_img = 0;
+    uint8_t next_index_bound = index_gran;
+    uint8_t raw_left = 0;  // number of raw colors left in current raw sequence.
+    uint8_t raw_color = 0;
+    bool has_raw_color = false;  // raw color has a color left in high nibble.
+    uint8_t rle_color = 0;
+    bool has_rle_color = false;  // RLE color has a color left in high nibble.
+    while (true) {
+        uint8_t curr_color;
+        uint8_t run = 1;
+        if (has_raw_color) {
+            has_raw_color = false;
+            curr_color = raw_color >> 4;
+            --raw_left;
+        } else {
+            uint8_t byte = graphics_image_read_byte(reader);
+            if (raw_left == 0) {
+                if (byte & 0x80) {
+                    // RLE sequence byte
+                    run = (byte & 0x7f) + 3;
+                    if (has_rle_color) {
+                        has_rle_color = false;
+                        curr_color = rle_color >> 4;
+                    } else {
+                        rle_color = graphics_image_read_byte(reader);
+                        has_rle_color = true;
+                        curr_color = rle_color & 0xf;
+                    }
+                    goto write;
+                }
+                // raw sequence length byte
+                raw_left = 2 * ((byte & 0x7f) + 1);
+                byte = graphics_image_read_byte(reader);
+            }
+            raw_color = byte;
+            has_raw_color = true;
+            curr_color = byte & 0xf;
+            --raw_left;
+        }
+
+write:
+        while (run--) {
+            if (x_img & 1) {
+                row[x_img / 2] |= curr_color << 4;
+            } else {
+                row[x_img / 2] = curr_color;
+            }
+            if (x_img == width) {
+                x_img = 0;
+                if (y_img == height) {
+                    return;
+                }
+                ++y_img;
+                row += bytes_per_row;
+                if (y_img == next_index_bound) {
+                    // decoder state is reset on index bound.
+                    raw_left = 0;
+                    has_raw_color = false;
+                    has_rle_color = false;
+                    next_index_bound += index_gran;
+                }
+            } else {
+                ++x_img;
+            }
+        }
+    }
+}
+
+/**
+ * State of the LZ decoder, kept after drawing an LZ image on a page so that drawing it on the
+ * next page resumes from there, instead of decoding all the previous rows again.
+ * The state at a row boundary only depends on the image data, so it's identified by the image
+ * address and the next row to decode, whatever the position or region drawn. Image data at that
+ * address is assumed not to change. There's a single state because of the window size, so
+ * drawing another LZ image on a page makes the first one decoded from the start on next page.
+ */
+typedef struct {
+    graphics_image_t image;
+    // position of the next token or literal byte in image data.
+    data_ptr_t data;
+    // next image row to decode.
+    uint8_t row;
+    // position of the next decoded byte in the window.
+    uint8_t window_pos;
+    // number of bytes left in the current literal run or match, 0 if the next byte is a token.
+    uint8_t literal_left;
+    uint8_t match_left;
+    // distance of the current match, minus one.
+    uint8_t match_dist;
+    // history of the last decoded bytes, for matches.
+    uint8_t window[IMAGE_LZ_WINDOW_SIZE];
+} image_lz_state_t;
+
+static SIM_THREAD_LOCAL image_lz_state_t image_lz_state;
+
+static void graphics_image_lz_reset(image_lz_state_t* state, graphics_image_t data) {
+    state->image = data;
+    state->data = data + IMAGE_HEADER_SIZE;
+    state->row = 0;
+    state->window_pos = 0;
+    state->literal_left = 0;
+    state->match_left = 0;
+}
+
+/**
+ * Decode the next `length` bytes of LZ image data to a buffer, reading the tokens and literal
+ * bytes from the data stream. Tokens can span several rows, the decoder state is kept as is.
+ */
+static void graphics_image_lz_decode(image_lz_state_t* state, image_reader_t* reader,
+                                     uint8_t* dest, uint8_t length) {
+    uint8_t* window = state->window;
+    uint8_t window_pos = state->window_pos;
+    uint8_t literal_left = state->literal_left;
+    uint8_t match_left = state->match_left;
+    uint8_t match_dist = state->match_dist;
+    while (length--) {
+        if (literal_left == 0 && match_left == 0) {
+            const uint8_t token = graphics_image_read_byte(reader);
+            if (token & 0x80) {
+                match_left = (token & 0x7f) + IMAGE_LZ_MIN_MATCH;
+                match_dist = graphics_image_read_byte(reader);
+            } else {
+                literal_left = token + 1;
+            }
+        }
+        uint8_t byte;
+        if (literal_left) {
+            byte = graphics_image_read_byte(reader);
+            --literal_left;
+        } else {
+            byte = window[(uint8_t) (window_pos - match_dist - 1)];
+            --match_left;
+        }
+        window[window_pos++] = byte;
+        *dest++ = byte;
+    }
+    state->window_pos = window_pos;
+    state->literal_left = literal_left;
+    state->match_left = match_left;
+    state->match_dist = match_dist;
+}
+
+static void graphics_image_4bit_lz_internal(graphics_image_t data, const disp_x_t x,
+                                            const disp_y_t y, const uint8_t top, uint8_t bottom) {
+    trace_spi_tag("graphics_image_4bit_lz");
+    // header given at build time only applies to a single call.
+    const uint8_t* static_header = graphics_static_header;
+    graphics_static_header = 0;
+
+    if (y > sys_display_page_yend) {
+        // image starts after current page, no need to read header.
+        return;
+    }
+
+    uint8_t header[IMAGE_HEADER_SIZE];
+    if (static_header) {
+        memcpy(header, static_header, sizeof header);
+    } else {
+        data_read(data, sizeof header, header);
+    }
+    const uint8_t flags = header[1];
+    const uint8_t width = header[2];
+    const uint8_t height = header[3];
+    if (bottom == IMAGE_BOTTOM_NONE) {
+        bottom = height;
+    }
+
+#ifdef RUNTIME_CHECKS
+    if (header[0] != IMAGE_LZ_SIGNATURE) {
+        trace("invalid image signature");
+        return;
+    }
+    if (top > bottom || bottom > height) {
+        trace("region out of bounds");
+        return;
+    }
+    if (x + width >= DISPLAY_WIDTH || y >= DISPLAY_HEIGHT) {
+        trace("out of bounds");
+        return;
+    }
+#endif
+
+    uint8_t alpha_color = IMAGE_ALPHA_COLOR_NONE;
+    if (flags & IMAGE_FLAG_ALPHA) {
+        alpha_color = flags & 0xf;
+    }
+
+    // find the image rows on the current page, clipped at the bottom of the display.
+    uint16_t last_y = y + (bottom - top);
+    if (last_y < sys_display_page_ystart) {
+        // image ends before current page.
+        return;
+    }
+    if (last_y > sys_display_page_yend) {
+        last_y = sys_display_page_yend;
+    }
+    const uint8_t first_y = max(sys_display_page_ystart, y);
+    const uint8_t first_row = top + (first_y - y);
+    const uint8_t last_row = top + (last_y - y);
+
+    // resume from the state saved on the previous page if possible, otherwise the rows before
+    // the first row are decoded without being drawn.
+    image_lz_state_t* state = &image_lz_state;
+    if (state->image != data || state->row > first_row) {
+        graphics_image_lz_reset(state, data);
+    }
+    image_reader_t reader;
+    reader.data = state->data;
+    reader.pos = sizeof reader.buf;
+
+    const uint8_t row_bytes = width / 2 + 1;
+    uint8_t row[DISPLAY_NUM_COLS];
+    uint8_t row_num = state->row;
+    uint8_t y_page = first_y - sys_display_page_ystart;
+    sys_data_stream_open(reader.data);
+    while (true) {
+        graphics_image_lz_decode(state, &reader, row, row_bytes);
+        if (row_num >= first_row) {
+            graphics_image_raw_row(row, x, y_page, 0, width, 1, alpha_color, false);
+            ++y_page;
+        }
+        if (row_num == last_row) {
+            break;
+        }
+        ++row_num;
+    }
+    // unread bytes in the reader buffer will be read again.
+    state->data = reader.data - (sizeof reader.buf - reader.pos);
+    state->row = row_num + 1;
+    if (row_num == height) {
+        // whole image decoded, nothing to resume.
+        state->image = 0;
+    }
+    sys_data_stream_close(reader.data);
+}
+
+void graphics_image_4bit_lz(graphics_image_t data, const disp_x_t x, const disp_y_t y) {
+    graphics_image_4bit_lz_internal(data, x, y, 0, IMAGE_BOTTOM_NONE);
+}
+
+void graphics_image_4bit_lz_region(graphics_image_t data, const disp_x_t x, const disp_y_t y,
+                                   const uint8_t top, const uint8_t bottom) {
+    graphics_image_4bit_lz_internal(data, x, y, top, bottom);
+}
+
+static void graphics_image_cache_lz(image_reader_t* reader, uint8_t* dest, uint16_t length) {
+    // same decoding as graphics_image_lz_decode, but the decoded data is used as the history,
+    // so that the decoder state and its window aren't needed.
+    while (length) {
+        const uint8_t token = graphics_image_read_byte(reader);
+        if (token & 0x80) {
+            uint8_t count = (token & 0x7f) + IMAGE_LZ_MIN_MATCH;
+            const uint8_t* src = dest - graphics_image_read_byte(reader) - 1;
+            for (; count && length; --count, --length) {
+                *dest++ = *src++;
+            }
+        } else {
+            uint8_t count = token + 1;
+            for (; count && length; --count, --length) {
+                *dest++ = graphics_image_read_byte(reader);
+            }
+        }
+    }
+}
+
+graphics_image_t graphics_image_cache(graphics_image_t data, uint8_t* buffer, uint16_t size) {
+    // the buffer may have held another image, which a cursor could still refer to.
+    graphics_image_invalidate_cursors();
+    uint8_t header[IMAGE_HEADER_SIZE + IMAGE_INDEX_HEADER_SIZE];
+    data_read(data, sizeof header, header);
+    const bool lz = header[0] == IMAGE_LZ_SIGNATURE;
+#ifdef RUNTIME_CHECKS
+    if (header[0] != IMAGE_SIGNATURE && !lz) {
+        trace("invalid image signature");
+        return 0;
+    }
+#endif
+    const uint8_t flags = header[1];
+    const uint8_t width = header[2];
+    const uint8_t height = header[3];
+    const uint8_t bytes_per_row = width / (flags & IMAGE_FLAG_BINARY ? 8 : 2) + 1;
+    const uint16_t cache_size = IMAGE_HEADER_SIZE + bytes_per_row * (height + 1);
+#ifdef RUNTIME_CHECKS
+    if (size < cache_size) {
+        trace("image cache buffer too small");
+        return 0;
+    }
+#endif
+
+    // cached image has the same header, without index and with raw encoding.
+    buffer[0] = IMAGE_SIGNATURE;
+    buffer[1] = (flags & ~IMAGE_FLAG_INDEXED) | IMAGE_FLAG_RAW;
+    buffer[2] = width;
+    buffer[3] = height;
+    uint8_t* row = buffer + IMAGE_HEADER_SIZE;
+
+    data += IMAGE_HEADER_SIZE;
+    if (flags & IMAGE_FLAG_RAW) {
+        // already raw, only copy the data.
+        data_read(data, cache_size - IMAGE_HEADER_SIZE, row);
+    } else if (lz) {
+        image_reader_t reader;
+        reader.data = data;
+        reader.pos = sizeof reader.buf;
+        sys_data_stream_open(data);
+        graphics_image_cache_lz(&reader, row, cache_size - IMAGE_HEADER_SIZE);
+        sys_data_stream_close(data);
+    } else {
+        uint8_t index_gran = 0;
+        if (flags & IMAGE_FLAG_INDEXED) {
+            // data is decoded sequentially, the index is not needed, but state is reset on bounds.
+            index_gran = header[4];
+            data += IMAGE_INDEX_HEADER_SIZE + header[5];
+        }
+        image_reader_t reader;
+        reader.data = data;
+        reader.pos = sizeof reader.buf;
+        sys_data_stream_open(data);
+        if (flags & IMAGE_FLAG_BINARY) {
+            memset(row, 0, cache_size - IMAGE_HEADER_SIZE);
+            graphics_image_cache_1bit(&reader, row, width, height, index_gran);
+        } else {
+            graphics_image_cache_4bit(&reader, row, width, height, index_gran);
+        }
+        sys_data_stream_close(data);
+    }
+
+    return data_mcu(buffer);
+}
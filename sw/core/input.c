@@ -16,6 +16,9 @@
  */
 
 #include <sys/input.h>
+#include <sys/time.h>
+
+#include <core/trace.h>
 
 void input_latch(void) {
     sys_input_latch();
@@ -32,3 +35,153 @@ uint8_t input_get_last_state(void) {
 uint8_t input_get_clicked(void) {
     return sys_input_get_state() & ~sys_input_get_last_state();
 }
+
+bool input_get_event(input_event_t* event) {
+    return sys_input_get_event(event);
+}
+
+void input_clear_events(void) {
+    sys_input_clear_events();
+}
+
+// configuration used until `input_keys_init` is called: no repeat and no combination.
+static const input_keys_config_t _default_keys_config;
+
+static SIM_THREAD_LOCAL struct {
+    const input_keys_config_t* config;
+    // button waiting for the other button of a combination, or 0 if none.
+    uint8_t pending;
+    systime_t pending_time;
+    // held buttons for which the key is repeated.
+    uint8_t repeating;
+    // time of the next repeat for each button.
+    systime_t repeat_time[BUTTONS_COUNT];
+    uint8_t queue[INPUT_KEY_QUEUE_SIZE];
+    uint8_t queue_head;
+    uint8_t queue_size;
+} _keys = {.config = &_default_keys_config};
+
+static void keys_push(uint8_t key) {
+    if (_keys.queue_size < INPUT_KEY_QUEUE_SIZE) {
+        _keys.queue[(_keys.queue_head + _keys.queue_size) % INPUT_KEY_QUEUE_SIZE] = key;
+        ++_keys.queue_size;
+    } else {
+#ifdef RUNTIME_CHECKS
+        trace("key queue full, key dropped.");
+#endif
+    }
+}
+
+static bool keys_is_combo_part(uint8_t button) {
+    const input_keys_config_t* config = _keys.config;
+    for (uint8_t i = 0; i < config->combo_count; ++i) {
+        if (config->combos[i] & button) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool keys_is_combo(uint8_t buttons) {
+    const input_keys_config_t* config = _keys.config;
+    for (uint8_t i = 0; i < config->combo_count; ++i) {
+        if (config->combos[i] == buttons) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void keys_update_time(systime_t time) {
+    if (_keys.pending && (systime_t) (time - _keys.pending_time) >= _keys.config->combo_delay) {
+        // no combination was made in time, this is a single button press.
+        keys_push(_keys.pending);
+        _keys.pending = 0;
+    }
+
+    // At most one repeat is done per button per update, a repeat late by less than the repeat
+    // rate is caught up on the next update. The next repeat is never more than UINT8_MAX ticks
+    // ahead, since delays are 8-bit. Any time further ahead is a repeat time that was passed
+    // long ago, even if the time counter wrapped around since the last update.
+    uint8_t mask = BUTTON0;
+    for (uint8_t i = 0; i < BUTTONS_COUNT; ++i) {
+        const systime_t ahead = _keys.repeat_time[i] - time;
+        if ((_keys.repeating & mask) && (ahead == 0 || ahead > UINT8_MAX)) {
+            keys_push(mask | INPUT_KEY_REPEAT);
+            if ((systime_t) -ahead >= _keys.config->repeat_rate) {
+                // too late to catch up, skip the missed repeats instead of sending a burst.
+                _keys.repeat_time[i] = time;
+            }
+            _keys.repeat_time[i] += _keys.config->repeat_rate;
+        }
+        mask <<= 1;
+    }
+}
+
+static void keys_update_event(const input_event_t* event) {
+    keys_update_time(event->time);
+
+    const uint8_t released = event->released;
+    _keys.repeating &= ~released;
+    if (_keys.pending & released) {
+        // button released before the combination delay.
+        keys_push(_keys.pending);
+        _keys.pending = 0;
+    }
+
+    const uint8_t pressed = event->pressed;
+    uint8_t mask = BUTTON0;
+    for (uint8_t i = 0; i < BUTTONS_COUNT; ++i) {
+        if (pressed & mask) {
+            if (_keys.config->repeat_mask & mask) {
+                _keys.repeating |= mask;
+                _keys.repeat_time[i] = event->time + _keys.config->repeat_delay;
+            }
+            if (_keys.pending && keys_is_combo(_keys.pending | mask)) {
+                keys_push(_keys.pending | mask);
+                _keys.repeating &= ~(_keys.pending | mask);
+                _keys.pending = 0;
+            } else {
+                if (_keys.pending) {
+                    keys_push(_keys.pending);
+                    _keys.pending = 0;
+                }
+                if (keys_is_combo_part(mask)) {
+                    _keys.pending = mask;
+                    _keys.pending_time = event->time;
+                } else {
+                    keys_push(mask);
+                }
+            }
+        }
+        mask <<= 1;
+    }
+}
+
+void input_keys_init(const input_keys_config_t* config) {
+    // keys are only created on press events, so buttons currently pressed are ignored.
+    _keys.config = config;
+    _keys.pending = 0;
+    _keys.repeating = 0;
+    _keys.queue_size = 0;
+    sys_input_clear_events();
+}
+
+uint8_t input_get_key(void) {
+    if (_keys.queue_size == 0) {
+        input_event_t event;
+        while (_keys.queue_size == 0 && sys_input_get_event(&event)) {
+            keys_update_event(&event);
+        }
+        if (_keys.queue_size == 0) {
+            keys_update_time(sys_time_get());
+        }
+    }
+    if (_keys.queue_size == 0) {
+        return 0;
+    }
+    const uint8_t key = _keys.queue[_keys.queue_head];
+    _keys.queue_head = (_keys.queue_head + 1) % INPUT_KEY_QUEUE_SIZE;
+    --_keys.queue_size;
+    return key;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <core/math.h>
+#include <core/trace.h>
+
+uint8_t math_div10_u8(uint8_t n) {
+    trace_cycles(10);
+    // exact for n < 1029.
+    return (uint16_t) n * 205 >> 11;
+}
+
+uint16_t math_div10_u16(uint16_t n) {
+    trace_cycles(30);
+    // exact for all 16-bit values.
+    return (uint32_t) n * 0xcccd >> 19;
+}
+
+uint32_t math_div10_u32(uint32_t n) {
+    trace_cycles(70);
+    // approximate n * 0.8 then correct the result, see Hacker's Delight 10-17.
+    uint32_t q = (n >> 1) + (n >> 2);
+    q += q >> 4;
+    q += q >> 8;
+    q += q >> 16;
+    q >>= 3;
+    const uint32_t r = n - q * 10;
+    return q + (r > 9);
+}
+
+uint32_t math_to_bcd(uint32_t n) {
+    uint32_t bcd = 0;
+    for (uint8_t shift = 0; shift < 32; shift += 4) {
+        const uint32_t q = math_div10_u32(n);
+        bcd |= (n - q * 10) << shift;
+        n = q;
+        trace_cycles(8);
+    }
+    return bcd;
+}
+
+uint8_t math_sat_add_u8(uint8_t a, uint8_t b) {
+    const uint8_t sum = a + b;
+    return sum < a ? UINT8_MAX : sum;
+}
+
+uint8_t math_sat_sub_u8(uint8_t a, uint8_t b) {
+    return a > b ? a - b : 0;
+}
+
+uint16_t math_sat_add_u16(uint16_t a, uint16_t b) {
+    const uint16_t sum = a + b;
+    return sum < a ? UINT16_MAX : sum;
+}
+
+uint16_t math_sat_sub_u16(uint16_t a, uint16_t b) {
+    return a > b ? a - b : 0;
+}
@@ -30,3 +30,7 @@ uint8_t power_get_battery_percent(void) {
 sleep_cause_t power_get_scheduled_sleep_cause(void) {
     return sys_power_get_scheduled_sleep_cause();
 }
+
+void power_skip_idle(void) {
+    sys_power_skip_idle();
+}
@@ -16,10 +16,19 @@
  */
 
 #include <core/random.h>
+#include <core/defs.h>
 
-static uint16_t seed;
+#ifdef SIMULATION
+#include <sim/input.h>
+#endif
+
+static SIM_THREAD_LOCAL uint16_t seed;
 
 void random_seed(uint16_t s) {
+#ifdef SIMULATION
+    // seeds are part of the input log, see sim/input.h.
+    s = sim_input_log_seed(s);
+#endif
     seed = s;
 }
 
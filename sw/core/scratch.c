@@ -0,0 +1,79 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <core/scratch.h>
+#include <core/graphics.h>
+#include <core/trace.h>
+
+#include <sys/display.h>
+
+#ifdef SIMULATION
+#include <sim/display.h>
+#else
+// bounds of the display buffer and of the variables sharing it, see app.ld.
+extern uint8_t __disp_buf_start;
+extern uint8_t __shared_disp_buf_end;
+#endif
+
+static SIM_THREAD_LOCAL bool _acquired;
+
+static uint8_t* scratch_get_start(void) {
+#ifdef SIMULATION
+    // variables sharing the display buffer aren't actually located in it in simulation.
+    return sim_display_get_buffer();
+#else
+    return &__shared_disp_buf_end;
+#endif
+}
+
+uint16_t scratch_get_size(void) {
+#ifdef SIMULATION
+    const uint8_t* buf_start = sim_display_get_buffer();
+#else
+    const uint8_t* buf_start = &__disp_buf_start;
+#endif
+    const uint8_t* buf_end = buf_start + DISPLAY_MAX_PAGE_HEIGHT * DISPLAY_NUM_COLS;
+    const uint8_t* start = scratch_get_start();
+    return start < buf_end ? buf_end - start : 0;
+}
+
+void* scratch_acquire(uint16_t size) {
+    if (_acquired) {
+        trace("scratch memory already acquired.");
+        return 0;
+    }
+    if (size > scratch_get_size()) {
+        trace("scratch memory too small, %u bytes requested", size);
+        return 0;
+    }
+    _acquired = true;
+    // images previously drawn from scratch memory are about to be overwritten.
+    graphics_image_invalidate_cursors();
+    return scratch_get_start();
+}
+
+void scratch_release(void) {
+#ifdef RUNTIME_CHECKS
+    if (!_acquired) {
+        trace("scratch memory released but not acquired.");
+    }
+#endif
+    _acquired = false;
+}
+
+bool scratch_is_acquired(void) {
+    return _acquired;
+}
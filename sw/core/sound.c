@@ -18,9 +18,12 @@
 #include <core/sound.h>
 #include <core/trace.h>
 #include <core/data.h>
+#include <core/evtrace.h>
 
 #include <sys/sound.h>
 
+#include <string.h>
+
 #ifdef BOOTLOADER
 
 #include <boot/defs.h>
@@ -43,12 +46,19 @@
 // Worst case is ~4 notes of duration 1, which is 16 ms at highest tempo.
 // However highest tempo is never used, at 240 BPM this gives 63 ms loose.
 //
+// Buffers are filled once per loop, and also between display pages when a track reaches
+// this limit while playing, so that a long frame doesn't starve the tracks.
 // If buffer underruns become an issue, there are a few solutions:
-// - Call sound_fill_track_buffers() more often, e.g. in draw page loop.
 // - Reduce sound tempo. A tempo of 60 BPM gives at worst 250 ms loose.
 // - Increase this value.
 #define TRACK_BUFFER_MIN_SIZE 8
 
+#define TRACK_BUFFER_MASK (SOUND_TRACK_BUFFER_SIZE - 1)
+
+// Buffers are refilled by whole chunks, so that the buffer end stays a multiple of the chunk size
+// and a chunk never wraps around the ring buffer, each chunk being a single read.
+#define TRACK_CHUNK_SIZE (SOUND_TRACK_BUFFER_SIZE / 2)
+
 // Max note length is 3 bytes (1 byte for note, 2 for duration).
 #define TRACK_NOTE_MAX_LENGTH 3
 
@@ -63,7 +73,7 @@
 
 #include <pthread.h>
 
-static pthread_mutex_t sound_mutex;
+static SIM_THREAD_LOCAL pthread_mutex_t sound_mutex;
 
 static int sound_lock_mutex(void) {
     pthread_mutex_lock(&sound_mutex);
@@ -85,12 +95,17 @@ static void sound_unlock_mutex(int* arg) {
 
 #ifdef BOOTLOADER
 
-sound_track_t sys_sound_tracks[SYS_SOUND_CHANNELS];
-volatile uint8_t sys_sound_tracks_on;
-BOOTLOADER_KEEP uint8_t sys_sound_tempo;
+SIM_THREAD_LOCAL sound_track_t sys_sound_tracks[SYS_SOUND_CHANNELS];
+SIM_THREAD_LOCAL volatile uint8_t sys_sound_tracks_on;
+SIM_THREAD_LOCAL volatile bool sys_sound_refill_needed;
+BOOTLOADER_KEEP SIM_THREAD_LOCAL uint16_t sys_sound_tempo;
 
-// Delay in system ticks until next 1/16th of a beat is played on all tracks (minus one).
-static uint8_t sys_sound_delay;
+BOOTLOADER_KEEP SIM_THREAD_LOCAL uint8_t sys_sound_channel2_decay;
+BOOTLOADER_KEEP SIM_THREAD_LOCAL uint8_t sys_sound_channel2_decay_left;
+
+// Delay in system ticks until next 1/16th of a beat is played on all tracks (minus one),
+// in 8.8 fixed point. The fractional part carries over to the next beat.
+static SIM_THREAD_LOCAL uint16_t sys_sound_delay;
 
 /**
  * Read the next note in track data and set it as current note with its duration.
@@ -106,7 +121,7 @@ static void sys_sound_track_seek_note(sound_track_t* track, uint8_t track_playin
         return;
     }
 
-    uint8_t note = track->buffer[track->buffer_pos];
+    uint8_t note = track->buffer[track->buffer_pos & TRACK_BUFFER_MASK];
     if (note == TRACK_END) {
         // no more notes in track, done playing.
         track->note = SYS_SOUND_NO_NOTE;
@@ -115,10 +130,12 @@ static void sys_sound_track_seek_note(sound_track_t* track, uint8_t track_playin
         return;
     }
 
-    if (track->buffer_pos > SOUND_TRACK_BUFFER_SIZE - TRACK_NOTE_MAX_LENGTH) {
+    if (track->data != DATA_END &&
+        (uint8_t) (track->buffer_end - track->buffer_pos) < TRACK_NOTE_MAX_LENGTH) {
         // buffer underrun! track buffer wasn't filled recently.
         // keep playing the last note, this will produce a lagging effect.
         trace("buffer underrun on sound track");
+        evtrace(EVTRACE_SOUND_UNDERRUN, track - sys_sound_tracks);
         return;
     }
     ++track->buffer_pos;
@@ -131,14 +148,15 @@ static void sys_sound_track_seek_note(sound_track_t* track, uint8_t track_playin
         return;
     }
 
-    const uint8_t duration = track->buffer[track->buffer_pos];
+    const uint8_t duration = track->buffer[track->buffer_pos & TRACK_BUFFER_MASK];
     if (track->duration_repeat) {
         // last duration continues to be repeated.
         --track->duration_repeat;
     } else if (duration & 0x80) {
         if (duration & 0x40) {
             // two bytes duration encoding.
-            track->duration_total = (duration & 0x3f) << 8 | track->buffer[track->buffer_pos + 1];
+            track->duration_total = (duration & 0x3f) << 8 |
+                    track->buffer[(uint8_t) (track->buffer_pos + 1) & TRACK_BUFFER_MASK];
             track->buffer_pos += 2;
         } else {
             // last duration will be repeated a number of times.
@@ -174,6 +192,16 @@ static void sys_sound_tracks_seek_note(void) {
             if (track->duration_left == 0) {
                 sys_sound_track_seek_note(track, track_active_mask & TRACKS_PLAYING_ALL);
                 sys_sound_play_note(track->note, channel);
+                if (channel == 2 && sys_sound_channel2_decay && track->note != SYS_SOUND_NO_NOTE) {
+                    // start of decay envelope.
+                    sys_sound_set_channel_volume(2, SOUND_CHANNEL2_VOLUME1);
+                    sys_sound_channel2_decay_left = sys_sound_channel2_decay;
+                }
+                if (track->data != DATA_END &&
+                    (uint8_t) (track->buffer_end - track->buffer_pos) <= TRACK_BUFFER_MIN_SIZE) {
+                    // request a refill at the next safe point, without waiting for the next loop.
+                    sys_sound_refill_needed = true;
+                }
             } else {
                 --track->duration_left;
             }
@@ -195,51 +223,72 @@ void sys_sound_update_output_state(void) {
 }
 
 void sys_sound_update(void) {
-    if (sys_sound_delay == 0) {
-        sys_sound_delay = sys_sound_tempo;
+    if (sys_sound_channel2_decay_left != 0 && --sys_sound_channel2_decay_left == 0) {
+        // end of decay envelope.
+        sys_sound_set_channel_volume(2, SOUND_CHANNEL2_VOLUME0);
+    }
+    if (sys_sound_delay < 256) {
+        sys_sound_delay += sys_sound_tempo;
         sys_sound_tracks_seek_note();
     } else {
-        --sys_sound_delay;
+        sys_sound_delay -= 256;
     }
 }
 
 #endif //BOOTLOADER
 
 /**
- * Fill track data buffer starting from a position by reading from flash.
- * Must be called within an atomic block.
+ * Returns the track data address after a number of bytes were read from it,
+ * or DATA_END if the end of track data was reached. The number of bytes left is updated.
  */
-static void sys_sound_fill_track_buffer(sound_track_t* track, uint8_t start) {
-    const uint8_t read_len = SOUND_TRACK_BUFFER_SIZE - start;
-    data_read(track->data, read_len, &track->buffer[start]);
-    track->data += read_len;
-
-    // Look for end of track marker byte
-    for (uint8_t i = start; i < SOUND_TRACK_BUFFER_SIZE; ++i) {
-        if (track->buffer[i] == TRACK_END) {
-            track->data = 0;
-            break;
-        }
+static sound_t sys_sound_advance_track_data(sound_track_t* track, uint8_t length) {
+    if (track->data_left <= length) {
+        track->data_left = 0;
+        return DATA_END;
     }
+    track->data_left -= length;
+    return track->data + length;
+}
+
+/**
+ * Fill track data buffer with a number of chunks after the end of data, by reading from flash.
+ * The interrupt only reads bytes before the end of data, so this can be done outside of
+ * an atomic block. Returns the new track data address, the caller must then update the track
+ * data address and buffer end atomically.
+ */
+static sound_t sys_sound_fill_track_buffer(sound_track_t* track, uint8_t length) {
+    trace_spi_tag("sys_sound_fill_track_buffer");
+    const uint8_t start = track->buffer_end & TRACK_BUFFER_MASK;
+    uint8_t first_len = SOUND_TRACK_BUFFER_SIZE - start;
+    if (first_len > length) {
+        first_len = length;
+    }
+    sound_t data = track->data;
+    data_read(data, first_len, &track->buffer[start]);
+    if (first_len != length) {
+        // wrap around to the start of buffer, on a chunk boundary.
+        data_read(data + first_len, length - first_len, track->buffer);
+    }
+    return sys_sound_advance_track_data(track, length);
 }
 
 void sys_sound_fill_track_buffers(void) {
+    sys_sound_refill_needed = false;
     uint8_t track_active_mask = TRACK0_ACTIVE;
     for (uint8_t channel = 0; channel < SYS_SOUND_CHANNELS; ++channel) {
         if ((sys_sound_tracks_on & track_active_mask) == track_active_mask) {
             // Track is started & currently playing.
             sound_track_t* track = &sys_sound_tracks[channel];
-            ATOMIC_BLOCK_IMPL {
-                if (track->data != DATA_END &&
-                    track->buffer_pos >= SOUND_TRACK_BUFFER_SIZE - TRACK_BUFFER_MIN_SIZE) {
-                    // Not enough data to be guaranteed that next note can be decoded.
-                    // Move all remaining data to the start of buffer and fill the rest.
-                    uint8_t j = 0;
-                    for (uint8_t i = track->buffer_pos; i < SOUND_TRACK_BUFFER_SIZE; ++i, ++j) {
-                        track->buffer[j] = track->buffer[i];
-                    }
-                    track->buffer_pos = 0;
-                    sys_sound_fill_track_buffer(track, j);
+            const uint8_t available = track->buffer_end - track->buffer_pos;
+            if (track->data != DATA_END && available <= TRACK_BUFFER_MIN_SIZE) {
+                // Not enough data to be guaranteed that next note can be decoded.
+                // Fill the rest of the buffer, the data is only published after reading.
+                const uint8_t length = (SOUND_TRACK_BUFFER_SIZE - available) &
+                                       ~(TRACK_CHUNK_SIZE - 1);
+                const sound_t data = sys_sound_fill_track_buffer(track, length);
+                ATOMIC_BLOCK_IMPL {
+                    track->data = data;
+                    track->buffer_end += length;
                 }
             }
         }
@@ -248,32 +297,40 @@ void sys_sound_fill_track_buffers(void) {
 }
 
 void sound_load(sound_t address) {
-    uint8_t signature;
-    data_read(address, 1, &signature);
-    if (signature != SOUND_SIGNATURE) {
+    // The signature, each track header and the first data of each track are read together,
+    // so that each track is primed with a single read.
+    uint8_t buf[1 + TRACK_HEADER_SIZE + SOUND_TRACK_BUFFER_SIZE];
+    uint8_t* header = &buf[1];
+    data_read(address, sizeof buf, buf);
+    if (buf[0] != SOUND_SIGNATURE) {
         trace("invalid sound signature");
         return;
     }
     ++address;
     ATOMIC_BLOCK_IMPL {
-        uint8_t header[TRACK_HEADER_SIZE];
         uint8_t track_playing_mask = TRACK0_PLAYING;
         uint8_t new_tracks_on = 0;
         for (uint8_t i = 0; i < SYS_SOUND_CHANNELS; ++i) {
             sound_track_t* track = &sys_sound_tracks[i];
-            data_read(address, TRACK_HEADER_SIZE, header);
             if (header[0] == i) {
                 // Initialize track from header, fill buffer with first data.
                 const uint16_t track_length = header[1] | header[2] << 8;
-                track->data = address + TRACK_HEADER_SIZE;
                 track->immediate_pause = header[3];
                 track->duration_left = 0;
                 track->duration_total = 0;
                 track->duration_repeat = 0;
                 track->buffer_pos = 0;
-                sys_sound_fill_track_buffer(track, 0);
+                track->buffer_end = SOUND_TRACK_BUFFER_SIZE;
+                memcpy(track->buffer, &header[TRACK_HEADER_SIZE], SOUND_TRACK_BUFFER_SIZE);
+                // the end of track is known from its length, the data isn't scanned for it.
+                track->data = address + TRACK_HEADER_SIZE;
+                track->data_left = track_length - TRACK_HEADER_SIZE;
+                track->data = sys_sound_advance_track_data(track, SOUND_TRACK_BUFFER_SIZE);
                 new_tracks_on |= track_playing_mask;
                 address += (data_ptr_t) track_length;
+                if (i != SYS_SOUND_CHANNELS - 1) {
+                    data_read(address, TRACK_HEADER_SIZE + SOUND_TRACK_BUFFER_SIZE, header);
+                }
             }
             track_playing_mask <<= 1;
         }
@@ -298,7 +355,7 @@ void sound_start(uint8_t t) {
         // start playing current note on started tracks, if they are playing.
         uint8_t track = TRACK0_ACTIVE;
         for (uint8_t i = 0; i < SYS_SOUND_CHANNELS; ++i) {
-            if ((t & track) && (sys_sound_tracks_on & track)) {
+            if ((t & track) && (sys_sound_tracks_on & track & TRACKS_PLAYING_ALL)) {
                 sys_sound_play_note(sys_sound_tracks[i].note, i);
             }
             track <<= 1;
@@ -336,11 +393,31 @@ bool sound_check_tracks(uint8_t t) {
 }
 
 void sound_set_tempo(uint8_t t) {
-    sys_sound_tempo = t;
+    sound_set_tempo_fine(t << 8);
+}
+
+void sound_set_tempo_fine(uint16_t t) {
+#ifdef RUNTIME_CHECKS
+    if (t > 0xff00) {
+        trace("invalid tempo value");
+        return;
+    }
+#endif
+    ATOMIC_BLOCK_IMPL {
+        sys_sound_tempo = t;
+    }
 }
 
 uint8_t sound_get_tempo(void) {
-    return sys_sound_tempo;
+    return sound_get_tempo_fine() >> 8;
+}
+
+uint16_t sound_get_tempo_fine(void) {
+    uint16_t t;
+    ATOMIC_BLOCK_IMPL {
+        t = sys_sound_tempo;
+    }
+    return t;
 }
 
 void sound_set_volume(sound_volume_t volume) {
@@ -362,3 +439,10 @@ void sound_set_channel_volume(uint8_t channel, sound_channel_volume_t volume) {
 sound_channel_volume_t sound_get_channel_volume(uint8_t channel) {
     return sys_sound_get_channel_volume(channel);
 }
+
+void sound_set_channel2_decay(uint8_t ticks) {
+    ATOMIC_BLOCK_IMPL {
+        sys_sound_channel2_decay = ticks;
+        sys_sound_channel2_decay_left = 0;
+    }
+}
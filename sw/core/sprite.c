@@ -0,0 +1,150 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <core/sprite.h>
+#include <core/trace.h>
+
+#include <sys/display.h>
+
+// image header flags, see core/graphics.h.
+#define IMAGE_FLAG_BINARY (1 << 4)
+#define IMAGE_FLAG_RAW (1 << 5)
+
+static SIM_THREAD_LOCAL sprite_t* _sprites;
+static SIM_THREAD_LOCAL uint8_t _count;
+// first visible sprite in Y order.
+static SIM_THREAD_LOCAL uint8_t _head = SPRITE_NONE;
+// sprites before this one in Y order end above the current page and are skipped.
+static SIM_THREAD_LOCAL uint8_t _page_first;
+
+void sprite_init(sprite_t* sprites, uint8_t count) {
+    _sprites = sprites;
+    _count = count;
+    _head = SPRITE_NONE;
+    for (uint8_t i = 0; i < count; ++i) {
+        sprites[i].visible = false;
+        sprites[i].next = SPRITE_NONE;
+    }
+}
+
+static bool check_id(uint8_t id) {
+#ifdef RUNTIME_CHECKS
+    if (id >= _count) {
+        trace("invalid sprite ID");
+        return false;
+    }
+#endif
+    return true;
+}
+
+static void unlink_sprite(uint8_t id) {
+    uint8_t* link = &_head;
+    while (*link != id) {
+        link = &_sprites[*link].next;
+    }
+    *link = _sprites[id].next;
+}
+
+static void link_sprite(uint8_t id) {
+    // insert after all sprites starting on the same row or above.
+    const disp_y_t y = _sprites[id].y;
+    uint8_t* link = &_head;
+    while (*link != SPRITE_NONE && _sprites[*link].y <= y) {
+        link = &_sprites[*link].next;
+    }
+    _sprites[id].next = *link;
+    *link = id;
+}
+
+void sprite_show(uint8_t id, graphics_image_t image, disp_x_t x, disp_y_t y) {
+    if (!check_id(id)) {
+        return;
+    }
+    // image header: signature, flags, width - 1, height - 1.
+    uint8_t header[4];
+    data_read(image, sizeof header, header);
+    sprite_t* sprite = &_sprites[id];
+    sprite->image = image;
+    sprite->flags = header[1];
+    sprite->height = header[3];
+    if (sprite->visible) {
+        sprite_move(id, x, y);
+    } else {
+        sprite->x = x;
+        sprite->y = y;
+        sprite->visible = true;
+        link_sprite(id);
+    }
+}
+
+void sprite_move(uint8_t id, disp_x_t x, disp_y_t y) {
+    if (!check_id(id)) {
+        return;
+    }
+    sprite_t* sprite = &_sprites[id];
+    sprite->x = x;
+    if (!sprite->visible || sprite->y == y) {
+        sprite->y = y;
+        return;
+    }
+    unlink_sprite(id);
+    sprite->y = y;
+    link_sprite(id);
+}
+
+void sprite_hide(uint8_t id) {
+    if (!check_id(id) || !_sprites[id].visible) {
+        return;
+    }
+    unlink_sprite(id);
+    _sprites[id].visible = false;
+}
+
+void sprite_draw_page(void) {
+    if (sys_display_page_ystart == sys_display_refresh_ystart) {
+        // first page of the frame.
+        _page_first = _head;
+    }
+    while (_page_first != SPRITE_NONE &&
+           _sprites[_page_first].y + _sprites[_page_first].height < sys_display_page_ystart) {
+        _page_first = _sprites[_page_first].next;
+    }
+
+    for (uint8_t id = _page_first; id != SPRITE_NONE; id = _sprites[id].next) {
+        const sprite_t* sprite = &_sprites[id];
+        if (sprite->y > sys_display_page_yend) {
+            // this sprite and all the following ones start after the current page.
+            break;
+        }
+        if (sprite->y + sprite->height < sys_display_page_ystart) {
+            continue;
+        }
+        if (sprite->flags & IMAGE_FLAG_BINARY) {
+            if (sprite->flags & IMAGE_FLAG_RAW) {
+                graphics_image_1bit_raw(sprite->image, sprite->x, sprite->y);
+            } else {
+                graphics_image_1bit_mixed(sprite->image, sprite->x, sprite->y);
+            }
+        } else {
+            if (sprite->flags & IMAGE_FLAG_RAW) {
+                graphics_image_4bit_raw(sprite->image, sprite->x, sprite->y);
+            } else {
+                graphics_image_4bit_mixed(sprite->image, sprite->x, sprite->y);
+            }
+        }
+    }
+}
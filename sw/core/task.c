@@ -0,0 +1,72 @@
+
+/*
+ * Copyright 2021 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <core/task.h>
+
+#include <stddef.h>
+
+static SIM_THREAD_LOCAL task_t* task_list;
+
+void task_start(task_t* task, task_func_t func) {
+    task_stop(task);
+    task->func = func;
+    task->resume = 0;
+    task->next = task_list;
+    task_list = task;
+}
+
+void task_stop(task_t* task) {
+    task_t** link = &task_list;
+    while (*link) {
+        if (*link == task) {
+            *link = task->next;
+            return;
+        }
+        link = &(*link)->next;
+    }
+}
+
+bool task_is_running(const task_t* task) {
+    for (const task_t* t = task_list; t; t = t->next) {
+        if (t == task) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool task_run(systime_t budget) {
+    const systime_t start = time_get();
+    bool progress;
+    do {
+        // resume each task once, removing those that are done.
+        progress = false;
+        task_t** link = &task_list;
+        while (*link) {
+            task_t* task = *link;
+            task_result_t result = task->func(task);
+            if (result == TASK_DONE) {
+                *link = task->next;
+            } else {
+                if (result == TASK_YIELDED) {
+                    progress = true;
+                }
+                link = &task->next;
+            }
+        }
+    } while (progress && (systime_t) (time_get() - start) < budget);
+    return task_list != NULL;
+}
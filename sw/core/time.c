@@ -21,3 +21,11 @@
 systime_t time_get() {
     return sys_time_get();
 }
+
+systime_fine_t time_get_fine(void) {
+    return sys_time_get_fine();
+}
+
+void time_set_tickless(bool enabled) {
+    sys_time_set_tickless(enabled);
+}
@@ -17,6 +17,7 @@
 #ifdef BOOTLOADER
 
 #include <core/utils.h>
+#include <core/math.h>
 #include <boot/defs.h>
 
 BOOTLOADER_NOINLINE
@@ -24,8 +25,9 @@ char* uint8_to_str(char buf[static 4], uint8_t n) {
     char* ptr = &buf[3];
     *ptr = '\0';
     do {
-        *(--ptr) = (char) (n % 10 + '0');
-        n /= 10;
+        const uint8_t q = math_div10_u8(n);
+        *(--ptr) = (char) (n - q * 10 + '0');
+        n = q;
     } while (n);
     return ptr;
 }
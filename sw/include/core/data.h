@@ -19,6 +19,8 @@
 #define CORE_DATA_H
 
 #include <core/defs.h>
+#include <core/flash.h>
+
 #include <stdint.h>
 
 #define DATA_FLASH_MASK 0x800000
@@ -32,6 +34,27 @@ typedef uintptr_t data_ptr_t;
 typedef uint24_t data_ptr_t;
 #endif
 
+// Size in bytes of a data cache line, must be a power of two.
+#define DATA_CACHE_LINE_SIZE 16
+
+/** Data cache line, holding a copy of flash data at an address aligned to the line size. */
+typedef struct {
+    flash_t address;
+    uint8_t data[DATA_CACHE_LINE_SIZE];
+} data_cache_line_t;
+
+/**
+ * Data cache for small flash reads. The lines must be allocated by the app,
+ * the number of lines must be a power of two. Hits and misses are counted on each read
+ * and can be read and reset directly, to measure whether the cache is useful.
+ */
+typedef struct {
+    data_cache_line_t* lines;
+    uint8_t count;
+    uint16_t hits;
+    uint16_t misses;
+} data_cache_t;
+
 /**
  * Provides an unified interface for reading data from program memory,
  * RAM, internal EEPROM, external flash (but not external EEPROM).
@@ -41,4 +64,21 @@ typedef uint24_t data_ptr_t;
  */
 void data_read(data_ptr_t address, uint16_t length, uint8_t dest[]);
 
+/**
+ * Get a pointer to data in program memory or RAM, so that it can be read in place without
+ * being copied first. Program memory is mapped in the data space and reads like RAM.
+ * Returns null if the address is in external flash, in which case `data_read` must be used.
+ */
+const uint8_t* data_get_pointer(data_ptr_t address);
+
+/**
+ * Set a direct-mapped cache used for flash reads through this interface, or null to remove it.
+ * Only reads up to the line size are cached, like image and font headers, glyphs or sound
+ * track refills. These are the reads for which the flash command overhead matters the most.
+ * Longer reads go directly to flash to avoid evicting all cached lines.
+ * All lines are invalidated and the counters are reset. The cache must stay valid while set.
+ * Note that flash writes are not seen by the cache, it must be set again after writing.
+ */
+void data_set_cache(data_cache_t* cache);
+
 #endif //CORE_DATA_H
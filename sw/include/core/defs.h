@@ -37,6 +37,34 @@ typedef __int24 int24_t;
 #define SHARED_DISP_BUF __attribute__((section(".shared_disp_buf")))
 #endif
 
+// Used on the mutable global state of the core library and of the simulator.
+// With SIMULATION_THREAD_LOCAL (headless simulator only), each thread has its own copy of this
+// state, so that a process can run many simulated game consoles at once, one per thread.
+// Each thread then initializes its console with sys_init() and releases it with sim_deinit().
+#ifdef SIMULATION_THREAD_LOCAL
+#ifndef SIMULATION_HEADLESS
+#error "SIMULATION_THREAD_LOCAL can only be used in headless simulation"
+#endif
+#define SIM_THREAD_LOCAL __thread
+#else
+#define SIM_THREAD_LOCAL
+#endif
+
+// Used on hot functions to build them with -O3 while the rest of the app is built for size.
+// The function name is given so that, if the app has an `optimize.h` header generated from a
+// simulator profile by utils/optimize_select.py, only the functions selected within the program
+// memory budget are optimized (it must be generated again when marking other functions).
+// Otherwise, all marked functions are. With OPTIMIZE=none or OPTIMIZE=all, none or all are,
+// to measure the size of each function both ways (see avr.mk).
+#if defined(SIMULATION) || defined(OPTIMIZE_NONE)
+#define AVR_OPTIMIZE(name)
+#elif defined(OPTIMIZE_AUTO)
+#include <optimize.h>
+#define AVR_OPTIMIZE(name) AVR_OPTIMIZE_##name
+#else
+#define AVR_OPTIMIZE(name) __attribute__((optimize("O3")))
+#endif
+
 /**
  * To be used on structures stored in Flash or EEPROM and that are copied to RAM.
  * All structs are packed on 8-bit AVR, but they must be in simulator too.
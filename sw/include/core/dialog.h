@@ -111,6 +111,8 @@ typedef struct {
 typedef struct {
     dialog_item_type_t type;
     const char* name;
+    // width of the text in the item action (button name or current choice), see dialog layout.
+    uint8_t width;
     union {
         dialog_button_t button;
 #ifndef DIALOG_NO_CHOICE
@@ -128,6 +130,12 @@ typedef struct {
 enum {
     // if set, dialog can be dismissed and returns dismiss result.
     DIALOG_FLAG_DISMISSABLE = 1 << 0,
+    // set when the text widths in the dialog are up to date, see `dialog_invalidate_layout`.
+    DIALOG_FLAG_LAYOUT_VALID = 1 << 1,
+    // set when the dialog is drawn, cleared when it's changed, see `dialog_set_dirty_rows`.
+    DIALOG_FLAG_DRAWN = 1 << 2,
+    // set once the dialog has been drawn on a frame since it was initialized.
+    DIALOG_FLAG_SHOWN = 1 << 3,
 };
 
 typedef struct {
@@ -149,6 +157,11 @@ typedef struct {
     const char* pos_btn;
     const char* neg_btn;
 
+    // text widths, computed when the dialog is first drawn so they aren't measured on each page.
+    uint8_t title_width;
+    uint8_t pos_btn_width;
+    uint8_t neg_btn_width;
+
     dialog_result_t pos_result;
     dialog_result_t neg_result;
     dialog_result_t dismiss_result;
@@ -165,7 +178,7 @@ typedef struct {
  * This structure can be safely modified, however there are dedicated functions that should
  * be used for adding options and setting the font.
  */
-extern dialog_t dialog;
+extern SIM_THREAD_LOCAL dialog_t dialog;
 
 /**
  * Initialize a dialog with the dialog coordinates and size.
@@ -227,6 +240,24 @@ void dialog_add_item_number(const char* name, uint8_t min, uint8_t max, uint8_t
 void dialog_add_item_text(const char* name, uint8_t max_length, char text[static max_length + 1]);
 #endif
 
+/**
+ * Mark the dialog layout as changed, so that text widths are measured again on the next draw.
+ * This is done automatically when items are added or changed by `dialog_handle_input`, but
+ * must be called if the title, action buttons or items are changed directly once drawn.
+ */
+void dialog_invalidate_layout(void);
+
+/**
+ * Set the dirty rows for the next frame to the rows covered by the dialog, for when the
+ * background behind the dialog doesn't change while it's shown, like a paused game.
+ * The first frame after the dialog is initialized is a full refresh, so that the background
+ * is drawn once. After that, only the pages covering the dialog are drawn again, and only if
+ * the dialog changed since it was last drawn. Returns false if the frame doesn't need to be
+ * drawn, in which case the dirty rows aren't set. Anything drawn outside of the dialog rows
+ * (like the battery overlay) isn't refreshed until the next full refresh.
+ */
+bool dialog_set_dirty_rows(void);
+
 /**
  * Handle buttons input to navigate the dialog (using `input_get_clicked` function).
  * If a button item or action button is clicked, its result code is returned.
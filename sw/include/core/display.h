@@ -18,6 +18,8 @@
 #ifndef CORE_DISPLAY_H
 #define CORE_DISPLAY_H
 
+#include <core/data.h>
+
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -56,6 +58,82 @@ void display_set_contrast(uint8_t contrast);
  */
 uint8_t display_get_contrast(void);
 
+/**
+ * Set the range of rows to refresh on the next frame, from `ystart` to `yend` inclusively.
+ * The range is extended to page bounds and only the pages covering it are drawn and sent
+ * to the display, the rest of the display keeps its content. This is useful when only a
+ * small part of the screen changes, like a timer or a score, to save on transfer time.
+ * The whole display is refreshed again on the frame after that unless this is called again.
+ */
+void display_set_dirty_rows(disp_y_t ystart, disp_y_t yend);
+
+/**
+ * Scroll the display content up by a number of rows (down if negative), using the display
+ * start line so that the content already on the display doesn't need to be redrawn.
+ * The next frame only refreshes the rows scrolled into view, so the app must draw
+ * everything at its new position on that frame. The scroll is applied on the display
+ * when that frame starts, before the rows scrolled into view are sent. If dirty rows were
+ * already set for the next frame, or if scrolling twice before a frame, the whole display
+ * is refreshed on the next frame.
+ */
+void display_scroll(int8_t rows);
+
+/**
+ * Set a palette to remap all colors when the display is refreshed, or null to remove it.
+ * The palette is an array of 16 colors giving the color shown for each color drawn, it must
+ * stay valid while set. This makes fades, inversion or greying out the whole display cheap
+ * compared to drawing again with different colors. Note that the page buffer is remapped in
+ * place when sent, so its content must not be kept from a page to the next (it is normally
+ * cleared on each page anyway). This takes an additional pass over each page while set.
+ */
+void display_set_palette(const disp_color_t palette[16]);
+
+/**
+ * Set whether the page buffer is cleared while it's sent to the display. Each byte is replaced
+ * with the last clear color while waiting on the transfer, so that clearing the next page with
+ * the same color doesn't take a pass over the page buffer. The app must still clear each page.
+ * The first page of a frame is always cleared in full, since variables sharing the page buffer
+ * (`SHARED_DISP_BUF`) and scratch memory may have overwritten it between frames. Nothing is
+ * cleared on the frames where the average display color is computed. This is disabled when
+ * the app is loaded.
+ */
+void display_set_clear_on_send(bool enabled);
+
+/**
+ * Set the display page height, from 1 to `DISPLAY_MAX_PAGE_HEIGHT`. This must be called
+ * between frames, not while drawing (this is only checked in simulation). Taller pages mean
+ * fewer pages to draw per frame, so a screen with little else in RAM (like a menu) can use
+ * a taller page than gameplay.
+ * The page buffer is sized for `display_max_page_height` set in the app configuration,
+ * which defaults to `display_page_height`, the height set when the app is loaded.
+ * This has no effect in full frame mode (`DISPLAY_FULL_FRAME`), where a single page is used.
+ */
+void display_set_page_height(uint8_t height);
+
+/**
+ * Returns the current display page height.
+ */
+uint8_t display_get_page_height(void);
+
+/**
+ * Returns the number of frames skipped by the render scheduler since the last call,
+ * and reset the count. The scheduler is only enabled if `display_target_fps` is set
+ * in the app configuration. A frame is skipped when drawing the last one took longer than
+ * twice the target frame period, to keep the loop callback running at the same rate.
+ */
+uint16_t display_take_skipped_frames(void);
+
+/**
+ * Write a full screen image directly to the display, without drawing a frame. The image must be
+ * a 128x128 opaque 4-bit raw image (see core/graphics.h), which has the same layout as the
+ * display data. Rows are read in a small buffer and written right away, so this takes about the
+ * time to transfer the image, with no decoding and without using the page buffer.
+ * This must be called between frames, for example from the loop callback for a splash screen.
+ * The image stays on the display until the next frame is drawn. The palette is applied if set.
+ * If the display was scrolled since the last frame, the image is shown after the next frame.
+ */
+void display_stream_raw_image(data_ptr_t image);
+
 #include <sim/display.h>
 
 #endif //CORE_DISPLAY_H
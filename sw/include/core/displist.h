@@ -0,0 +1,114 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CORE_DISPLIST_H
+#define CORE_DISPLIST_H
+
+#include <core/graphics.h>
+
+#include <stdbool.h>
+
+/*
+ * The display list records draw commands on the first page of a frame and replays them on the
+ * following pages, so that the app's draw logic (layout, formatting, culling) runs once per
+ * frame instead of once per page. Each command keeps the range of rows it touches, and only
+ * the commands touching the current page are replayed. Usage in the draw callback:
+ *
+ *     graphics_clear(DISPLAY_COLOR_BLACK);
+ *     if (displist_begin()) {
+ *         graphics_set_color(DISPLAY_COLOR_WHITE);
+ *         displist_fill_rect(0, 0, 10, 10);
+ *         displist_text(0, 20, text);
+ *     }
+ *
+ * Commands are drawn immediately while recording, and use the color and font current when
+ * recorded. Text isn't copied, the pointer must stay valid until the frame is done drawing
+ * (not a buffer on the stack of the draw callback). If the list is full, the frame falls back to
+ * calling the draw commands on every page, as if there was no display list.
+ */
+
+enum {
+    DISPLIST_FILL_RECT,
+    DISPLIST_RECT,
+    DISPLIST_IMAGE_1BIT_RAW,
+    DISPLIST_IMAGE_1BIT_MIXED,
+    DISPLIST_IMAGE_4BIT_RAW,
+    DISPLIST_IMAGE_4BIT_MIXED,
+    DISPLIST_TEXT,
+};
+
+typedef struct {
+    uint8_t type;
+    disp_color_t color;
+    uint8_t x;
+    uint8_t y;
+    // first and last row touched by the command, inclusive.
+    disp_y_t ystart;
+    disp_y_t yend;
+    union {
+        struct {
+            uint8_t width;
+            uint8_t height;
+        } rect;
+        graphics_image_t image;
+        struct {
+            const char* text;
+            graphics_font_t font;
+        } text;
+    };
+} displist_cmd_t;
+
+/**
+ * Set the buffer used to record commands, holding up to `size` commands, or null to disable
+ * the display list. The buffer must stay valid while set. Scratch memory can't be used since
+ * it's overwritten while drawing.
+ */
+void displist_init(displist_cmd_t* buffer, uint8_t size);
+
+/**
+ * Must be called on each page before the draw commands. On the first page of a frame, the list
+ * is cleared and true is returned: the commands should be called, they're recorded and drawn.
+ * On other pages, the commands touching the page are replayed and false is returned, unless the
+ * list overflowed during the frame or isn't set, in which case true is always returned.
+ */
+bool displist_begin(void);
+
+/**
+ * Record and draw a rectangle, see `graphics_fill_rect` and `graphics_rect`.
+ */
+void displist_fill_rect(disp_x_t x, disp_y_t y, uint8_t width, uint8_t height);
+
+void displist_rect(disp_x_t x, disp_y_t y, uint8_t width, uint8_t height);
+
+/**
+ * Record and draw an image, see `graphics_image_*` functions. The image header is read once
+ * when recording to get the image height.
+ */
+void displist_image_1bit_raw(graphics_image_t image, disp_x_t x, disp_y_t y);
+
+void displist_image_1bit_mixed(graphics_image_t image, disp_x_t x, disp_y_t y);
+
+void displist_image_4bit_raw(graphics_image_t image, disp_x_t x, disp_y_t y);
+
+void displist_image_4bit_mixed(graphics_image_t image, disp_x_t x, disp_y_t y);
+
+/**
+ * Record and draw text with the current font, see `graphics_text`.
+ */
+void displist_text(int8_t x, int8_t y, const char* text);
+
+#endif //CORE_DISPLIST_H
@@ -19,6 +19,7 @@
 #define CORE_EEPROM_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /** Address in EEPROM. */
 typedef uint16_t eeprom_t;
@@ -28,7 +29,27 @@ typedef uint16_t eeprom_t;
  * allocated space. The bytes are copied to the destination buffer.
  * When reading past the end of allocated space, the read data is undefined.
  */
-void eeprom_read(eeprom_t address, uint8_t length, void* dest);
+void eeprom_read(eeprom_t address, uint16_t length, void* dest);
+
+/**
+ * Start reading EEPROM sequentially from an address relative to the start of allocated space.
+ * The EEPROM stays selected until the stream is closed, so that consecutive reads with
+ * `eeprom_stream_read` don't each need to send the read command and address again.
+ * A queued write is completed first. No other flash, EEPROM or display access can be done
+ * while the stream is open.
+ */
+void eeprom_stream_open(eeprom_t address);
+
+/**
+ * Read the next bytes from the stream opened with `eeprom_stream_open`.
+ * The bytes are copied to the destination buffer. Length can be zero.
+ */
+void eeprom_stream_read(uint16_t length, void* dest);
+
+/**
+ * Close the stream opened with `eeprom_stream_open`, releasing the SPI bus.
+ */
+void eeprom_stream_close(void);
 
 /**
  * Write a number of bytes to EEPROM starting at an address relative to the start of
@@ -37,10 +58,75 @@ void eeprom_read(eeprom_t address, uint8_t length, void* dest);
  *
  * This operation is atomic. Old data is first copied to a buffer, then new data is copied
  * to the specified location. If power goes out before end has finished, the old data will be
- * restored.
+ * restored. The length is limited to 255 bytes by the size of the buffer used for the old data.
  */
 void eeprom_write(eeprom_t address, uint8_t length, const void* src);
 
+/**
+ * Queue a write to EEPROM, with the same behavior as `eeprom_write` but without blocking.
+ * Writing to EEPROM takes a few milliseconds per 32 bytes page, and an atomic write needs
+ * about twice as many page writes as a plain write. Instead of waiting for each of these,
+ * the queued write is advanced by one page write on each main loop iteration.
+ * The source buffer isn't copied and must not be changed until the write is done.
+ * Only one write can be queued, queuing another one waits for the previous one to be done.
+ * Reading from and writing to EEPROM also waits for the queued write to be done.
+ * It is also done before going to sleep.
+ */
+void eeprom_write_async(eeprom_t address, uint8_t length, const void* src);
+
+/**
+ * Returns true if there's no queued write to EEPROM, i.e. the last queued write is done.
+ */
+bool eeprom_is_write_done(void);
+
+/**
+ * Same as `eeprom_write`, but the data is compared with the current content first, and only
+ * the range from the first to the last changed byte is written. Nothing is written if nothing
+ * changed. Whole structs can thus be saved even if only a field changed, at the cost of
+ * reading the old data first, which is wasted if most of the data usually changes.
+ */
+void eeprom_write_changed(eeprom_t address, uint8_t length, const void* src);
+
+/**
+ * Same as `eeprom_write_changed`, but the write is queued like with `eeprom_write_async`.
+ * The comparison is done immediately, only the write itself is queued.
+ */
+void eeprom_write_changed_async(eeprom_t address, uint8_t length, const void* src);
+
+/** Size in bytes of the header of each slot: sequence number and CRC. */
+#define EEPROM_SLOT_HEADER_SIZE 3
+
+/** Alignment of slots in EEPROM, the size of an EEPROM page. */
+#define EEPROM_SLOT_ALIGN 32
+
+/** Size in EEPROM taken by a single slot for data of a length, a whole number of pages. */
+#define EEPROM_SLOT_SIZE(length) (((length) + EEPROM_SLOT_HEADER_SIZE + EEPROM_SLOT_ALIGN - 1) \
+                                  / EEPROM_SLOT_ALIGN * EEPROM_SLOT_ALIGN)
+
+/**
+ * Size in EEPROM taken by a pair of slots for data of a length. This includes the padding
+ * needed to align the first slot, which depends on where the app's EEPROM space is placed.
+ */
+#define EEPROM_SLOTS_SIZE(length) (2 * EEPROM_SLOT_SIZE(length) + EEPROM_SLOT_ALIGN - 1)
+
+/**
+ * Read data saved with `eeprom_slot_write` at a relative address, from the newest valid slot.
+ * The space used is given by `EEPROM_SLOTS_SIZE(length)`, the length must always be the same.
+ * Returns false if no slot is valid, e.g. if data was never saved, in which case nothing is read.
+ */
+bool eeprom_slot_read(eeprom_t address, uint8_t length, void* dest);
+
+/**
+ * Write data at a relative address using two alternating slots instead of `eeprom_write`.
+ * Each slot has a sequence number and a CRC, the oldest slot is written each time, so that
+ * the data in the other slot is still valid if the write doesn't complete. This takes twice
+ * the space in EEPROM but the data is only written once, compared to about twice the data
+ * and a few small writes for an atomic write with `eeprom_write`. Slots start on EEPROM
+ * pages and the header is written along with the data, so data of up to 29 bytes is saved
+ * with a single page write.
+ */
+void eeprom_slot_write(eeprom_t address, uint8_t length, const void* src);
+
 #include <sim/eeprom.h>
 
 #endif //CORE_EEPROM_H
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CORE_EVTRACE_H
+#define CORE_EVTRACE_H
+
+#include <core/time.h>
+
+#include <stdint.h>
+
+/*
+ * When EVENT_TRACE is defined, timing-sensitive events are recorded in a ring buffer provided
+ * by the app, with the system time at which they occurred and a one byte argument. Since the
+ * events are recorded by the bootloader, both the bootloader and the app must be compiled with
+ * EVENT_TRACE. Recording an event takes a few cycles and can be done from interrupts.
+ * The trace is read by the system app with the EVENT_TRACE packet (see `gcprog.py trace`).
+ * Without EVENT_TRACE, `evtrace` is a no-op.
+ */
+
+/**
+ * Events recorded by the bootloader. Apps can record their own events from `EVTRACE_APP`.
+ */
+typedef enum {
+    // display frame started, no argument.
+    EVTRACE_FRAME_START = 0x01,
+    // display frame ended, argument is 1 if the frame took longer than the frame period.
+    EVTRACE_FRAME_END = 0x02,
+    // sound track buffer underrun, argument is the track number.
+    EVTRACE_SOUND_UNDERRUN = 0x03,
+    // waited for the EEPROM to be ready, argument is the wait in system ticks, saturated.
+    EVTRACE_EEPROM_WAIT = 0x04,
+    // first event number available to apps.
+    EVTRACE_APP = 0x80,
+} evtrace_event_t;
+
+typedef struct {
+    uint8_t event;
+    uint8_t arg;
+    systime_t time;
+} evtrace_entry_t;
+
+#ifdef EVENT_TRACE
+
+/**
+ * Start recording events to a buffer of `size` entries, which must be a power of two.
+ * Recording is stopped if the buffer is NULL. The buffer must stay valid while recording.
+ */
+void evtrace_start(evtrace_entry_t* buffer, uint8_t size);
+
+/**
+ * Record an event with an argument. Oldest events are overwritten when the buffer is full.
+ * Does nothing if recording wasn't started.
+ */
+void evtrace(uint8_t event, uint8_t arg);
+
+/**
+ * Copy events recorded since the last call to a buffer, oldest first, and clear them.
+ * The buffer must have the size given to `evtrace_start`. Returns the number of events copied.
+ * The number of events that were overwritten before being read is set in `lost`, saturated.
+ */
+uint8_t evtrace_take(evtrace_entry_t* dst, uint8_t* lost);
+
+#else
+#define evtrace(event, arg) // no-op
+#endif //EVENT_TRACE
+
+#endif //CORE_EVTRACE_H
@@ -0,0 +1,57 @@
+
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CORE_FAST_SETTINGS_H
+#define CORE_FAST_SETTINGS_H
+
+#include <stdint.h>
+
+/*
+ * Fast settings are kept in the MCU internal EEPROM instead of the external SPI EEPROM, for
+ * small settings that change often (volume, contrast, options). Each app can allocate a part of
+ * the internal EEPROM with `fast_settings_offset` and `fast_settings_space` in its target.cfg;
+ * allocations of the different apps must not overlap. The internal EEPROM is memory-mapped, so
+ * reading is as fast as copying RAM. Writing only programs the pages with changed bytes and
+ * doesn't wait for the last page to be programmed, but unlike `eeprom_write` it's not atomic:
+ * the settings should be validated when read and restored to defaults if invalid.
+ */
+
+// Start and size of the part of the internal EEPROM available to apps.
+// The first part is reserved for the system (battery calibration).
+#define FAST_SETTINGS_AREA_START 128
+#define FAST_SETTINGS_AREA_SIZE 128
+
+#ifndef FAST_SETTINGS_SIZE
+#define FAST_SETTINGS_OFFSET 0
+#define FAST_SETTINGS_SIZE 0
+#endif
+
+/**
+ * Read a number of bytes from the fast settings at an address relative to the start of the
+ * space allocated to the app. The bytes are copied to the destination buffer.
+ * Erased bytes read as 0xff.
+ */
+void fast_settings_read(uint8_t address, uint8_t length, void* dest);
+
+/**
+ * Write a number of bytes to the fast settings at an address relative to the start of the
+ * space allocated to the app. Only the bytes that changed are written.
+ * If writing past the end of allocated space, nothing will be written.
+ */
+void fast_settings_write(uint8_t address, uint8_t length, const void* src);
+
+#endif //CORE_FAST_SETTINGS_H
@@ -20,10 +20,24 @@
 
 #include <core/defs.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 /** Address in flash. */
 typedef uint24_t flash_t;
 
+/** Size of a flash page, the largest unit that can be programmed at once. */
+#define FLASH_PAGE_SIZE 256
+/** Size of a flash sector, the smallest unit that can be erased. */
+#define FLASH_SECTOR_SIZE 4096
+
+/** Flash reads counted during a frame, see `flash_get_frame_stats`. */
+typedef struct {
+    /** Number of data bytes read. */
+    uint24_t bytes;
+    /** Number of read transactions, each costs 4 more bytes for the instruction and address. */
+    uint16_t reads;
+} flash_frame_stats_t;
+
 /**
  * Read a number of bytes from flash starting from an address,
  * relative to the start of app data address.
@@ -32,6 +46,82 @@ typedef uint24_t flash_t;
  */
 void flash_read(flash_t address, uint16_t length, void* dest);
 
+/**
+ * Start reading flash sequentially from an address, relative to the start of app data address.
+ * The flash stays selected until the stream is closed, so that consecutive reads with
+ * `flash_stream_read` don't each need to send the read command and address again.
+ * No other flash, EEPROM or display access can be done while the stream is open.
+ */
+void flash_stream_open(flash_t address);
+
+/**
+ * Read the next bytes from the stream opened with `flash_stream_open`.
+ * The bytes are copied to the destination buffer. Length can be zero.
+ */
+void flash_stream_read(uint16_t length, void* dest);
+
+/**
+ * Close the stream opened with `flash_stream_open`, releasing the SPI bus.
+ */
+void flash_stream_close(void);
+
+/**
+ * Returns the flash reads counted during the last frame, from the first page of the frame
+ * to the first page of the next one, so this includes reads done by the loop callback.
+ * Reads are only counted if both the bootloader and the app are built with FLASH_MONITOR,
+ * otherwise this always returns zero. If FLASH_FRAME_BUDGET is defined to a number of bytes,
+ * the simulator traces a warning for each frame reading more than that.
+ */
+flash_frame_stats_t flash_get_frame_stats(void);
+
+/*
+ * The flash data space is a part of the external flash that the app can write at runtime, for
+ * data too large for EEPROM (caches, replays, snapshots). Its size is set with `flash_space` in
+ * target.cfg, in bytes and a multiple of `FLASH_SECTOR_SIZE`, and it's allocated by gcprog right
+ * after the app image. Its content is undefined after the app is installed and may be lost when
+ * the app is updated, so it should be validated when read.
+ *
+ * Like any flash, a byte can only be programmed from 1 bits to 0 bits, so a sector must be erased
+ * before being written again. Erasing a sector takes about 60 ms (up to 300 ms) and programming
+ * a page about 1 ms, during which the flash is busy: the erase is started without waiting, so
+ * that the main loop can do other work and poll `flash_space_is_busy`. While the flash is busy,
+ * no flash read can be done: any read, including app data reads, sound and drawing graphics from
+ * flash, waits for the flash to be ready first and so may block until the erase is done.
+ * Flash is rated for 100 000 erase cycles per sector.
+ */
+
+/**
+ * Returns the size in bytes of the flash data space allocated to the app, zero if none.
+ */
+flash_t flash_space_size(void);
+
+/**
+ * Read a number of bytes from the flash data space starting from an address relative to its
+ * start. The bytes are copied to the destination buffer.
+ * If reading past the end of the data space, the read data is undefined.
+ */
+void flash_space_read(flash_t address, uint16_t length, void* dest);
+
+/**
+ * Program a number of bytes to the flash data space starting from an address relative to its
+ * start. The bytes are copied from the source buffer, which can be reused on return, and must
+ * have been erased first. This blocks for about 1 ms per page, except for the last page.
+ * If writing past the end of the data space, nothing is written.
+ */
+void flash_space_write(flash_t address, uint16_t length, const void* src);
+
+/**
+ * Start erasing the sector of the flash data space containing an address relative to its start,
+ * without waiting for the erase to be done. All bytes of the sector are set to 0xff.
+ * If the address is past the end of the data space, nothing is erased.
+ */
+void flash_space_erase(flash_t address);
+
+/**
+ * Returns true if the flash is busy with a program or erase operation.
+ */
+bool flash_space_is_busy(void);
+
 #include <sim/flash.h>
 
 #endif //CORE_FLASH_H
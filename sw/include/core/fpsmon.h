@@ -22,6 +22,18 @@
  * Draw FPS monitor in the lower left corner of the display.
  * This also updates the monitor state when on the first display page.
  * The FPS monitor uses 4 bytes of RAM and around 240 bytes of program memory.
+ * If SOUND_MONITOR is defined, the percentage of CPU time spent in the sound channel timer
+ * interrupts is also shown. The bootloader must be compiled with SOUND_MONITOR too.
+ * The load is estimated from the number of interrupts, the system tick sound update isn't counted.
+ * If LOOP_MONITOR is defined, a bar spanning the display width is drawn above the monitor,
+ * showing the share of time spent in each main loop phase last second, from left to right:
+ * other, battery level update, sound buffers fill, loop callback, draw callback,
+ * display transfer and idle. Phases are sampled on each system tick, so the bootloader must be
+ * compiled with LOOP_MONITOR too.
+ * If STACK_MONITOR is defined, the stack high-water mark in bytes is also shown, updated
+ * every second (see `sys_ram_get_stack_high_water`). It's always zero in simulation.
+ * If FLASH_MONITOR is defined, the number of bytes read from flash during the last frame
+ * is also shown (see `flash_get_frame_stats`).
  */
 void fpsmon_draw(void);
 
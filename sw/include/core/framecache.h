@@ -0,0 +1,77 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CORE_FRAMECACHE_H
+#define CORE_FRAMECACHE_H
+
+#include <stdbool.h>
+
+/*
+ * The frame cache holds a full frame in an area at the end of the external flash (see
+ * sys/flash.h), to restore a static background with a single bulk read per page instead of
+ * drawing it again on every frame. The background is saved while it's drawn on a normal frame:
+ *
+ *     // in loop callback, when entering the screen:
+ *     framecache_begin();
+ *
+ *     // in draw callback:
+ *     if (framecache_is_valid()) {
+ *         framecache_restore_page();
+ *     } else {
+ *         draw_background();
+ *         framecache_save_page();
+ *     }
+ *     draw_overlay();
+ *
+ * The cache is valid once a whole frame has been saved, so the frame saving it must be a full
+ * refresh (no dirty rows set). Saving takes a few milliseconds per page to program flash.
+ * The area is shared by all apps and its content isn't kept when another app is loaded.
+ * Each `framecache_begin` erases 8 kB of flash, which is rated for 100 000 erase cycles,
+ * so the cache should only be saved on screen transitions, never on every frame.
+ */
+
+/**
+ * Erase the frame cache area and invalidate the cache, so that the next frame can save a new
+ * background. This must not be called while drawing. It blocks for the erase duration,
+ * about 60 ms for each of the two sectors, up to 300 ms.
+ */
+void framecache_begin(void);
+
+/**
+ * Save the rows of the current display page to the frame cache. The cache becomes valid once
+ * the last page of the frame has been saved.
+ */
+void framecache_save_page(void);
+
+/**
+ * Copy the rows of the current display page from the frame cache into the page buffer,
+ * replacing its content. This should be done first on each page, in place of clearing it.
+ */
+void framecache_restore_page(void);
+
+/**
+ * Returns true if the frame cache holds a whole frame saved since the last `framecache_begin`.
+ */
+bool framecache_is_valid(void);
+
+/**
+ * Invalidate the frame cache without erasing it. `framecache_begin` must be called again before
+ * saving a new background.
+ */
+void framecache_invalidate(void);
+
+#endif //CORE_FRAMECACHE_H
@@ -23,6 +23,7 @@
 #include <core/data.h>
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /**
  * Spacing in pixels between every glyph when text is drawn.
@@ -53,8 +54,10 @@
  *
  * Mixed encoding limits the worst case overhead (an image with no run lengths, only raw data) and
  * allows significant size savings on images with long run lengths.
- * "Real" compression is not really an option here since the image must be indexed and compression
- * algorithms often require continuous decoding, with a window for back references.
+ * "Real" compression is not really an option for these since the image must be indexed and
+ * compression algorithms often require continuous decoding, with a window for back references.
+ * A separate LZ encoding is provided for 4-bit images which compress poorly with run lengths
+ * (dithered or photographic images), see LZ ENCODING below.
  *
  * Raw encoding is provided mainly for 4-bit images, since the mixed decoding algorithm is
  * heavier than for 1-bit images and raw encoding will almost always outperform mixed encoding
@@ -144,6 +147,23 @@
  * No sequence can cross an index boundary. The RLE color byte is reset on index boundary.
  * A raw sequence can exceptionnally encode an odd number of pixels if crossing an index boundary.
  *
+ * LZ ENCODING
+ *
+ * 4-bit images can also be LZ compressed. The header is the same except for the signature, 0xf3,
+ * and the flags, which only have the alpha color and transparency flag. There is no index.
+ * The decoded data is the same as for the 4-bit raw encoding, and is made of tokens:
+ * - Literal run: the MSB is 0, the remaining bits indicate the number of bytes that follow and
+ *     are copied as is, minus one. Thus a literal run can have a length of 1 to 128.
+ * - Match: the MSB is 1, the remaining bits indicate the length of the match, minus 3.
+ *     The next byte is the distance back in the decoded data, minus one. Thus a match can
+ *     have a length of 3 to 130 bytes, and a distance of 1 to 256 bytes (the history window).
+ *     A match can overlap the data it produces.
+ * Tokens can cross rows. The image is decoded continuously from the start, and the decoder state
+ * is saved after drawing a page, so that the next page resumes from there (see
+ * `graphics_image_4bit_lz`). Only the image data for the rows on the page is read per page, like
+ * with an indexed image, and much less data is read for images that compress well.
+ * The decoder state takes 267 bytes of RAM, only in apps which draw LZ images.
+ *
  * BENCHMARKS
  *
  * Very rough benchmark done with tiger128.png & tiger-bin128.png, stored in external flash memory.
@@ -163,9 +183,11 @@ typedef data_ptr_t graphics_image_t;
  * [0]: signature byte, 0xf0
  * [8]: glyph count
  * [16]: bytes per char (1-33)
+ * [23]: remap flag
  * [24]: glyph width, minus one (0-15)
  * [28]: glyph height, minus one (0-15)
  * [32]: bits of Y offset per glyph (0-4)
+ * [35]: row-aligned flag
  * [36]: max Y offset (0-15)
  * [40]: line spacing (0-32)
  * [48+]: glyph data
@@ -187,6 +209,16 @@ typedef data_ptr_t graphics_image_t;
  * - Y offset can only be positive (Y positive goes down).
  * - Glyphs are drawn from their top left corner.
  * - Characters that are not encoded in font will appear blank (a notable example is the space).
+ * - If the row-aligned flag is set, glyph data is instead a Y offset byte if max Y offset isn't
+ *     zero, followed by each row from top to bottom, on ceil(width / 8) bytes, with the leftmost
+ *     pixel in the most significant bit. Bits of Y offset per glyph is zero. This takes more
+ *     space for most fonts but is faster to draw.
+ * - If the remap flag is set, the font only encodes a subset of the characters, and the glyph data
+ *     is followed by a remap table: a length byte N, then N bytes giving the glyph index for the
+ *     first N characters of the two ranges above, or 0xff if the character isn't encoded.
+ *     Characters past the table aren't encoded. This makes fonts smaller when an app only draws
+ *     a few characters (e.g. uppercase letters and digits), at the cost of reading one more byte
+ *     per glyph drawn. The glyph cache then holds glyphs in glyph data order.
  */
 typedef data_ptr_t graphics_font_t;
 
@@ -199,12 +231,19 @@ typedef struct {
     uint8_t line_spacing;
     uint8_t width;
     uint8_t height;
+    bool row_aligned;
+    // number of entries in the remap table, 0 if the font has no remap table.
+    uint8_t remap_count;
+    // glyph cache in RAM, set with `graphics_set_font_cache`.
+    const uint8_t* cache;
+    uint8_t cache_start;  // position of the first cached glyph in glyph data
+    uint8_t cache_count;
 } graphics_font_data_t;
 
 /**
  * The current font. There is no default value.
  */
-extern graphics_font_data_t graphics_font;
+extern SIM_THREAD_LOCAL graphics_font_data_t graphics_font;
 
 // 3x5 font, 2 bytes per char, encodes 0x21-0x5a, total size 122 bytes.
 // from https://github.com/olikraus/u8g2/wiki/fntgrpx11#micro, u8g2_font_micro_tr, modified
@@ -236,6 +275,18 @@ void graphics_set_font(graphics_font_t font);
  */
 graphics_font_t graphics_get_font(void);
 
+/**
+ * Cache glyph data for the current font in a RAM buffer, starting with the glyph for character
+ * `first` and for as many following glyphs as the buffer can contain, so that drawing these
+ * glyphs doesn't need to read the font data. The whole range is read at once.
+ * Useful for fonts in external flash, to cache the most used characters (e.g. digits & letters).
+ * For fonts with a remap table, the glyphs following `first` are in glyph data order.
+ * Returns the number of glyphs cached. The cache is cleared when the font is changed.
+ * The buffer must stay valid for as long as the font is used, or until the cache is cleared
+ * by setting a zero-size buffer.
+ */
+uint8_t graphics_set_font_cache(uint8_t* buffer, uint16_t size, char first);
+
 /**
  * Clear buffer with a color.
  */
@@ -266,67 +317,201 @@ void graphics_line(disp_x_t x1, disp_y_t y0, disp_x_t x2, disp_y_t y1);
 /**
  * Draw a one pixel thick rectangle with top left corner at (x, y),
  * with a width and a height in pixels.
+ * The rectangle may extend past the bottom of the display, in which case it is clipped.
  */
 void graphics_rect(disp_x_t x, disp_y_t y, uint8_t w, uint8_t h);
 
 /**
  * Draw a filled rectangle with top left corner at (x, y),
  * with a width and a height in pixels.
+ * The rectangle may extend past the bottom of the display, in which case it is clipped.
  */
 void graphics_fill_rect(disp_x_t x, disp_y_t y, uint8_t w, uint8_t h);
 
 /**
  * Draw a 1-bit raw image from unified data space, with top left corner at position (x, y),
- * using the current color. The image must fully fit within display bounds.
+ * using the current color. The image must fit horizontally within display bounds,
+ * it is clipped if it extends past the bottom of the display.
  */
 void graphics_image_1bit_raw(graphics_image_t data, disp_x_t x, disp_y_t y);
 
 /**
  * Same as `graphics_image_1bit_raw` but draws a vertical portion of the image.
- * The bottom coordinate is inclusive. The image region must fully fit within display bounds.
+ * The bottom coordinate is inclusive. The image region is clipped at the bottom of display.
  */
 void graphics_image_1bit_raw_region(graphics_image_t data, disp_x_t x, disp_y_t y,
                                     uint8_t top, uint8_t bottom);
 
 /**
  * Draw a 1-bit raw image from unified data space, with top left corner at position (x, y),
- * using the current color. The image must fully fit within display bounds.
+ * using the current color. The image must fit horizontally within display bounds,
+ * it is clipped if it extends past the bottom of the display.
  */
 void graphics_image_1bit_mixed(graphics_image_t data, disp_x_t x, disp_y_t y);
 
 /**
  * Same as `graphics_image_1bit_raw` but draws a vertical portion of the image.
- * The bottom coordinate is inclusive. The image region must fully fit within display bounds.
+ * The bottom coordinate is inclusive. The image region is clipped at the bottom of display.
  */
 void graphics_image_1bit_mixed_region(graphics_image_t data, disp_x_t x, disp_y_t y,
                                       uint8_t top, uint8_t bottom);
 
 /**
  * Draw a 1-bit raw image from unified data space, with top left corner at position (x, y),
- * using the current color. The image must fully fit within display bounds.
+ * using the current color. The image must fit horizontally within display bounds,
+ * it is clipped if it extends past the bottom of the display.
  */
 void graphics_image_4bit_raw(graphics_image_t data, disp_x_t x, disp_y_t y);
 
 /**
  * Same as `graphics_image_1bit_raw` but draws a vertical portion of the image.
- * The bottom coordinate is inclusive. The image region must fully fit within display bounds.
+ * The bottom coordinate is inclusive. The image region is clipped at the bottom of display.
  */
 void graphics_image_4bit_raw_region(graphics_image_t data, disp_x_t x, disp_y_t y,
                                     uint8_t top, uint8_t bottom);
 
 /**
  * Draw a 1-bit raw image from unified data space, with top left corner at position (x, y),
- * using the current color. The image must fully fit within display bounds.
+ * using the current color. The image must fit horizontally within display bounds,
+ * it is clipped if it extends past the bottom of the display.
  */
 void graphics_image_4bit_mixed(graphics_image_t data, disp_x_t x, disp_y_t y);
 
 /**
  * Same as `graphics_image_1bit_raw` but draws a vertical portion of the image.
- * The bottom coordinate is inclusive. The image region must fully fit within display bounds.
+ * The bottom coordinate is inclusive. The image region is clipped at the bottom of display.
  */
 void graphics_image_4bit_mixed_region(graphics_image_t data, disp_x_t x, disp_y_t y,
                                       uint8_t top, uint8_t bottom);
 
+/**
+ * Draw a 4-bit LZ image from unified data space, with top left corner at position (x, y).
+ * Transparency is supported. The image must fit horizontally within display bounds,
+ * it is clipped if it extends past the bottom of the display.
+ * The decoder state is kept for the next page, so an LZ image is decoded only once per frame
+ * as long as it's the only LZ image drawn. Drawing several LZ images on the same pages is
+ * supported, but each page then decodes the images from the start up to the current page.
+ */
+void graphics_image_4bit_lz(graphics_image_t data, disp_x_t x, disp_y_t y);
+
+/**
+ * Same as `graphics_image_4bit_lz` but draws a vertical portion of the image.
+ * The bottom coordinate is inclusive. The image region is clipped at the bottom of display.
+ * The rows above the region are decoded but not drawn, unless resuming from a previous page.
+ */
+void graphics_image_4bit_lz_region(graphics_image_t data, disp_x_t x, disp_y_t y,
+                                   uint8_t top, uint8_t bottom);
+
+/**
+ * Draw a rectangular region of a 1-bit raw image, with top left corner of the region at
+ * position (x, y), using the current color. The right and bottom coordinates are inclusive.
+ * The region must fit horizontally within display bounds, it is clipped if it extends past
+ * the bottom of the display.
+ * This allows drawing any sprite from a sheet stored as a single image: only the header and
+ * the bytes of the region in each row are read.
+ */
+void graphics_image_1bit_raw_rect(graphics_image_t data, disp_x_t x, disp_y_t y,
+                                  uint8_t left, uint8_t top, uint8_t right, uint8_t bottom);
+
+/**
+ * Same as `graphics_image_1bit_raw_rect` for a 4-bit raw image, transparency is supported.
+ * Drawing is faster with an even X coordinate and an even left bound.
+ */
+void graphics_image_4bit_raw_rect(graphics_image_t data, disp_x_t x, disp_y_t y,
+                                  uint8_t left, uint8_t top, uint8_t right, uint8_t bottom);
+
+/**
+ * Draw a 1-bit raw image scaled up by an integer factor (at least 2), with top left corner
+ * at position (x, y), using the current color. Each image pixel is drawn as a square of
+ * `factor` by `factor` pixels. The scaled image must fit horizontally within display bounds,
+ * it is clipped if it extends past the bottom of the display.
+ * This allows storing large, blocky images at a fraction of their displayed size.
+ */
+void graphics_image_1bit_raw_scaled(graphics_image_t data, disp_x_t x, disp_y_t y,
+                                    uint8_t factor);
+
+/**
+ * Same as `graphics_image_1bit_raw_scaled` for a 4-bit raw image, transparency is supported.
+ * Drawing is faster with an even X coordinate and an even factor.
+ */
+void graphics_image_4bit_raw_scaled(graphics_image_t data, disp_x_t x, disp_y_t y,
+                                    uint8_t factor);
+
+/**
+ * Header to use for the next image drawn or font set, instead of reading it from data.
+ * For images, this is the image and index headers (first 6 bytes of image data), and for fonts
+ * the 6-byte font header. This is reset after every image drawn or font set.
+ * `GRAPHICS_IMAGE_STATIC` and `GRAPHICS_FONT_STATIC` should be used instead of setting this.
+ */
+extern SIM_THREAD_LOCAL const uint8_t* graphics_static_header;
+
+/**
+ * Draw an image with one of the image functions, using a header known at build time.
+ * The assets packer generates a header table in `assets.c` and macros using this for each
+ * image, e.g. `ASSET_IMAGE_LOGO_DRAW(x, y)` and `ASSET_IMAGE_LOGO_DRAW_REGION(x, y, top, bottom)`,
+ * which also select the drawing function for the image format statically.
+ * This avoids reading the header on every call, notably for images in external flash.
+ */
+#define GRAPHICS_IMAGE_STATIC(func, data, header, ...) \
+    (graphics_static_header = (header), func(data, __VA_ARGS__))
+
+/**
+ * Set the current font using a header known at build time, see `GRAPHICS_IMAGE_STATIC`.
+ * The assets packer generates a macro using this for each font, e.g. `ASSET_FONT_5X7_SET()`.
+ */
+#define GRAPHICS_FONT_STATIC(font, header) \
+    (graphics_static_header = (header), graphics_set_font(font))
+
+/**
+ * Tile index for which nothing is drawn in a tilemap.
+ */
+#define GRAPHICS_TILE_NONE 0xff
+
+/**
+ * Callback used to get the tile index at a position in a tilemap, in tiles.
+ * `GRAPHICS_TILE_NONE` can be returned to draw nothing at that position.
+ */
+typedef uint8_t (*graphics_tile_getter_t)(uint8_t col, uint8_t row);
+
+/**
+ * Draw a grid of `cols` x `rows` tiles with top left corner at (x, y).
+ * The tileset is a 4-bit raw image with the tiles stacked vertically, so the tile width is
+ * the image width, and the tile with index N starts at row N * `tile_height` in the image.
+ * The tile at each grid position is given by `get_tile`, called with the grid position offset
+ * by (`map_col`, `map_row`), which is the position of the top left tile in the whole map.
+ * X and the tile width must be even. Tiles are copied a whole byte at a time, pixels with
+ * the image alpha color are not drawn. Only the rows of tiles on the current page are drawn,
+ * and rows past the bottom of the display are clipped.
+ */
+void graphics_tilemap(graphics_image_t tileset, uint8_t tile_height,
+                      graphics_tile_getter_t get_tile, uint8_t map_col, uint8_t map_row,
+                      disp_x_t x, disp_y_t y, uint8_t cols, uint8_t rows);
+
+/**
+ * Size in bytes of the buffer needed to cache an image with `graphics_image_cache`,
+ * for an image of a width and height in pixels, and a bit depth of 1 or 4.
+ */
+#define GRAPHICS_IMAGE_CACHE_SIZE(width, height, bits) \
+    (4 + ((width) * (bits) + 7) / 8 * (height))
+
+/**
+ * Decode an image from unified data space to a buffer in RAM, using the raw encoding.
+ * LZ images are also supported and don't use the LZ decoder state.
+ * The returned image has the same bit depth and can be drawn with `graphics_image_1bit_raw`
+ * or `graphics_image_4bit_raw` as many times as needed without reading the original data.
+ * This is useful for small images drawn on every frame, especially from external flash.
+ * The buffer should have a size of at least `GRAPHICS_IMAGE_CACHE_SIZE`, and must stay valid
+ * for as long as the returned image is used.
+ */
+graphics_image_t graphics_image_cache(graphics_image_t data, uint8_t* buffer, uint16_t size);
+
+/**
+ * Forget the index positions saved when an indexed image continues on the next page.
+ * This is done on the first page of every frame, and when caching an image or acquiring
+ * scratch memory. It must also be done if image data in RAM is changed in the middle of a frame.
+ */
+void graphics_image_invalidate_cursors(void);
+
 /**
  * Draw a single glyph using the current font and color.
  * The glyph can be drawn partially or completely outside of screen bounds.
@@ -18,7 +18,10 @@
 #ifndef CORE_INPUT_H
 #define CORE_INPUT_H
 
+#include <core/time.h>
+
 #include <stdint.h>
+#include <stdbool.h>
 
 #define BUTTONS_COUNT 6
 
@@ -31,6 +34,49 @@
 
 #define BUTTONS_ALL (BUTTON0 | BUTTON1 | BUTTON2 | BUTTON3 | BUTTON4 | BUTTON5)
 
+// Number of entries in the input event queue, must be a power of two.
+// One entry is kept free, so the queue holds one event less than this.
+#define INPUT_EVENT_QUEUE_SIZE 8
+
+/**
+ * Input event, queued by the system tick interrupt whenever the debounced state changes.
+ */
+typedef struct {
+    // system time at which the change was sampled.
+    systime_t time;
+    // buttons pressed since the last event.
+    uint8_t pressed;
+    // buttons released since the last event.
+    uint8_t released;
+} input_event_t;
+
+// Flag set on keys returned by `input_get_key` which are auto repeats of a held button.
+#define INPUT_KEY_REPEAT 0x80
+
+// Number of keys which can be waiting to be taken by `input_get_key`.
+#define INPUT_KEY_QUEUE_SIZE 4
+
+/**
+ * Key repeat and combination configuration, set with `input_keys_init`.
+ * Delays are in system ticks and are measured from the time of input events, not from the
+ * time at which keys are taken, so they don't depend on frame time.
+ */
+typedef struct {
+    // buttons for which the key is repeated while held.
+    uint8_t repeat_mask;
+    // delay after a button is pressed before the first repeat.
+    uint8_t repeat_delay;
+    // delay between repeats after the first.
+    uint8_t repeat_rate;
+    // delay during which a pressed button part of a combination waits for the other button.
+    uint8_t combo_delay;
+    // number of combinations in the array.
+    uint8_t combo_count;
+    // two buttons combinations, each a mask of both buttons. Buttons pressed as a combination
+    // are never repeated.
+    const uint8_t* combos;
+} input_keys_config_t;
+
 /**
  * Latch the current input state. This also updates the last input state.
  */
@@ -54,6 +100,36 @@ uint8_t input_get_last_state(void);
  */
 uint8_t input_get_clicked(void);
 
+/**
+ * Take the oldest event from the input event queue. Returns false if the queue is empty.
+ * Events are timestamped to the system tick, independently of when the state is latched,
+ * so presses and releases happening during a slow frame are neither delayed nor merged.
+ * If the app doesn't take events in time, new events are dropped once the queue is full.
+ */
+bool input_get_event(input_event_t* event);
+
+/**
+ * Discard all events in the input event queue.
+ */
+void input_clear_events(void);
+
+/**
+ * Set the key repeat and combination configuration and reset the key state.
+ * Currently pressed buttons are ignored until released, and queued input events are discarded.
+ * The configuration must stay valid until it is changed.
+ */
+void input_keys_init(const input_keys_config_t* config);
+
+/**
+ * Returns the next key from input events, or 0 if there is none. A key is the mask of the
+ * button pressed, or of both buttons for a combination, with the `INPUT_KEY_REPEAT` flag set if
+ * it's an auto repeat. This takes events from the input event queue, so `input_get_event`
+ * shouldn't be used at the same time. Keys should be taken until there are none on every loop.
+ * At most `INPUT_KEY_QUEUE_SIZE` keys are kept, further keys are dropped (traced with runtime
+ * checks). Repeats missed while keys weren't taken for longer than the repeat rate are skipped.
+ */
+uint8_t input_get_key(void);
+
 #include <sim/input.h>
 
 #endif //CORE_INPUT_H
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CORE_MATH_H
+#define CORE_MATH_H
+
+#include <core/defs.h>
+
+#include <stdint.h>
+
+/*
+ * Integer helpers for hot paths. The MCU has a hardware multiplier but no divider,
+ * so a division by a variable takes a few hundred cycles in the compiler runtime.
+ * Divisions by 10 are done with a multiplication by the reciprocal instead, and BCD
+ * conversion is built on them. The estimated cost on the device is given for each function
+ * and accounted for in the simulator cycle model (see sim/cycles.h).
+ */
+
+/**
+ * Returns `n / 10`. About 10 cycles.
+ */
+uint8_t math_div10_u8(uint8_t n);
+
+/**
+ * Returns `n / 10`. About 30 cycles.
+ */
+uint16_t math_div10_u16(uint16_t n);
+
+/**
+ * Returns `n / 10`, with shifts and additions only. About 70 cycles.
+ */
+uint32_t math_div10_u32(uint32_t n);
+
+/**
+ * Convert a number to packed BCD, one decimal digit per nibble with the least significant digit
+ * in the lowest nibble. Only the 8 lowest digits are kept if the number has more than that.
+ * About 8 cycles per digit plus a 32-bit division by 10 per digit.
+ */
+uint32_t math_to_bcd(uint32_t n);
+
+/**
+ * Returns `a + b`, saturated to the maximum value.
+ */
+uint8_t math_sat_add_u8(uint8_t a, uint8_t b);
+
+/**
+ * Returns `a - b`, saturated to zero.
+ */
+uint8_t math_sat_sub_u8(uint8_t a, uint8_t b);
+
+/**
+ * Returns `a + b`, saturated to the maximum value.
+ */
+uint16_t math_sat_add_u16(uint16_t a, uint16_t b);
+
+/**
+ * Returns `a - b`, saturated to zero.
+ */
+uint16_t math_sat_sub_u16(uint16_t a, uint16_t b);
+
+#endif //CORE_MATH_H
@@ -65,6 +65,14 @@ uint8_t power_get_battery_percent(void);
  */
 sleep_cause_t power_get_scheduled_sleep_cause(void);
 
+/**
+ * Request the loop callback to be called again right away. By default, when the loop callback
+ * returns without requesting a frame, the CPU is idled until the next interrupt, which is at
+ * most until the next system time tick. This should be called on every loop where more work
+ * is pending, for example while processing data in small chunks.
+ */
+void power_skip_idle(void);
+
 #include <sim/power.h>
 
 #endif //CORE_POWER_H
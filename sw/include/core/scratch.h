@@ -0,0 +1,54 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CORE_SCRATCH_H
+#define CORE_SCRATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Scratch memory is the part of the display page buffer not used by `SHARED_DISP_BUF`
+ * variables. It can hold temporary data between frames (decode buffers, caches, bulk EEPROM
+ * reads), but its content is lost as soon as a page is drawn. Scratch memory has a single
+ * owner at a time: it must be acquired before use and released before drawing starts.
+ * With RUNTIME_CHECKS, acquiring it twice, releasing it while not acquired, and drawing while
+ * it's acquired are reported.
+ */
+
+/**
+ * Returns the size of scratch memory in bytes, which depends on the maximum display page height.
+ */
+uint16_t scratch_get_size(void);
+
+/**
+ * Acquire `size` bytes of scratch memory and return a pointer to it.
+ * The content is undefined. Returns null if the size is larger than scratch memory or if it is
+ * already acquired.
+ */
+void* scratch_acquire(uint16_t size);
+
+/**
+ * Release scratch memory previously acquired.
+ */
+void scratch_release(void);
+
+/**
+ * Returns true if scratch memory is currently acquired.
+ */
+bool scratch_is_acquired(void);
+
+#endif //CORE_SCRATCH_H
@@ -28,6 +28,10 @@
  * Mostly taken from https://github.com/maltaisn/buzzer-midi, with slight adjustments:
  * - Tempo is given in 1/256th of a second slices to work with system time counter.
  * - All tracks can be loaded independantly, to support mixing sound effects & music.
+ *   There's one track per channel, and each channel is driven by one of the three TCB timers
+ *   (the ATmega3208 has no fourth one). Sound effects must take a channel from the music,
+ *   a software channel isn't possible since the system tick (256 Hz) is far below audible
+ *   frequencies and toggling an output at note frequencies needs a dedicated timer interrupt.
  * - Data is stored in unified data space instead of program memory.
  * - Data is buffered to limit number of accesses to external memory devices.
  *
@@ -43,6 +47,7 @@
  *       Must be greater than the channel number of previous tracks in sound data.
  * - 0x01-0x02:
  *       Track length, in bytes, including header (little endian).
+ *       This is how the end of track data is found when filling buffers, the data isn't scanned.
  * - 0x03:
  *       Immediate pause duration in 1/16th of a beat.
  * - 0x04-<duration_offset-1>:
@@ -64,7 +69,7 @@
  *                    duration = ((byte0 & 0x3f) << 8 | byte1)
  *
  * Example sound data:
- *   0x01, 0x05, 0x00, 0x00, 0xff, 0x03, 0x24, 0x00, 0x04, 0x18, 0x3f, 0x19,
+ *   0x01, 0x05, 0x00, 0x00, 0xff, 0x02, 0x24, 0x00, 0x04, 0x18, 0x3f, 0x19,
  *   0xc1, 0xf3, 0x24, 0x07, 0x25, 0x83, 0x26, 0x27, 0x28, 0x29, 0x82, 0x30,
  *   0x31, 0x6d, 0x0f, 0x6e, 0x80, 0x54, 0xc0, 0x83, 0xa9, 0x7e, 0xc0, 0x18,
  *   0x18, 0xff, 0xff, 0x00, 0xff, 0xff.
@@ -75,7 +80,7 @@
  *     - 0x00: immediate pauses have a duration of 1.
  *     - 0xff: last byte of note data.
  * - track 1 data:
- *     - 0x03: channel 2
+ *     - 0x02: channel 2
  *     - 0x24 0x00: length of track is 36 bytes.
  *     - 0x04: immediate pauses have a duration of 5.
  *     - track data (described in <note data> / <duration data> format, not necessarily in the original order):
@@ -93,6 +98,12 @@
  *         - 0xff: last byte of note data.
  * - track 2 data: not present hence track is unused.
  * - 0xff: last byte of sound data
+ *
+ * All note byte values are used, and durations are interleaved with notes in the same stream,
+ * so there's no repeat or pattern token. Following a jump would also need a flash read from the
+ * sound interrupt, which can't access flash. A track plays at a few bytes per second, so the
+ * flash bandwidth used by music is negligible. Repeated sections are usually better handled by
+ * loading the same sound again when it ends, as the apps do to loop music.
  */
 
 // Masks used to check whether a track is started.
@@ -113,6 +124,9 @@
 #define encode_bpm_tempo(bpm) ((uint8_t) \
     ((60.0 * SYSTICK_FREQUENCY) / ((bpm) * SOUND_RESOLUTION) - 0.5))
 
+#define encode_bpm_tempo_fine(bpm) ((uint16_t) \
+    ((60.0 * 256 * SYSTICK_FREQUENCY) / ((bpm) * SOUND_RESOLUTION) - 256 + 0.5))
+
 typedef enum {
     SOUND_VOLUME_0 = 0x00,
     SOUND_VOLUME_1 = 0x01,
@@ -135,6 +149,9 @@ typedef data_ptr_t sound_t;
  * Can be used to reinitialize tracks state for looping.
  * Tracks not present in the loaded data are not changed.
  * The "playing" state of the track is set for loaded tracks.
+ * The track buffers are filled immediately, so the first notes play on the next tick.
+ * Short sound effects that are retriggered often can be copied once to RAM with `data_read`
+ * and loaded with `data_mcu(buffer)`, so that loading them again needs no flash access.
  */
 void sound_load(sound_t address);
 
@@ -172,10 +189,26 @@ bool sound_check_tracks(uint8_t tracks);
 void sound_set_tempo(uint8_t tempo);
 
 /**
- * Returns the sound tempo value.
+ * Set the sound tempo value with a fractional number of system time counter ticks.
+ * The tempo is encoded the same way as for `sound_set_tempo`, but in 8.8 fixed point,
+ * so that `sound_set_tempo(t)` is the same as `sound_set_tempo_fine(t << 8)`.
+ * The `encode_bpm_tempo_fine(<bpm>)` macro can be used to calculate this value.
+ * Beats alternate between the two nearest tick counts to average the exact tempo,
+ * which gives less than 0.1% error under 200 BPM and allows smooth tempo changes.
+ * Maximum value is 0xff00, the same minimum tempo as `sound_set_tempo`.
+ */
+void sound_set_tempo_fine(uint16_t tempo);
+
+/**
+ * Returns the sound tempo value, rounded down to an integer number of ticks.
  */
 uint8_t sound_get_tempo(void);
 
+/**
+ * Returns the sound tempo value in 8.8 fixed point.
+ */
+uint16_t sound_get_tempo_fine(void);
+
 /**
  * Set the sound volume value.
  */
@@ -197,6 +230,15 @@ void sound_set_channel_volume(uint8_t channel, sound_channel_volume_t volume);
  */
 sound_channel_volume_t sound_get_channel_volume(uint8_t channel);
 
+/**
+ * Set a decay envelope on channel 2, the only channel with more than one volume level.
+ * Each note starts at `SOUND_CHANNEL2_VOLUME1` and drops to `SOUND_CHANNEL2_VOLUME0` after
+ * a number of system ticks. The envelope costs a single check per system tick and nothing in
+ * the channel timer interrupts. Zero disables the envelope, the volume then stays at
+ * its last level until set again with `sound_set_channel_volume`.
+ */
+void sound_set_channel2_decay(uint8_t ticks);
+
 #include <sim/sound.h>
 
 #endif //CORE_SOUND_H
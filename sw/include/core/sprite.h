@@ -0,0 +1,78 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CORE_SPRITE_H
+#define CORE_SPRITE_H
+
+#include <core/graphics.h>
+
+#include <stdbool.h>
+
+/*
+ * The sprite layer draws moving images without the app checking each of them on every page.
+ * Visible sprites are kept in a list sorted by their top row, updated when a sprite is shown,
+ * moved or hidden, so that each page only visits the sprites overlapping it. Sprites are drawn
+ * in order of their top row, so a lower sprite is drawn over a higher one. Transparency uses
+ * the alpha color of 4-bit images, 1-bit images are drawn with the current color.
+ *
+ * The app provides the sprite slots and calls `sprite_draw_page` on each page after drawing
+ * the background. Sprites must not be changed while drawing.
+ */
+
+#define SPRITE_NONE 0xff
+
+typedef struct {
+    graphics_image_t image;
+    disp_x_t x;
+    disp_y_t y;
+    // last row of the sprite relative to its top row (image height minus one).
+    uint8_t height;
+    // image flags byte from the image header.
+    uint8_t flags;
+    // next visible sprite in Y order, or SPRITE_NONE.
+    uint8_t next;
+    bool visible;
+} sprite_t;
+
+/**
+ * Set the slots used for sprites, `count` at most 255. All sprites are initially hidden.
+ * The slots must stay valid while the sprite layer is used.
+ */
+void sprite_init(sprite_t* sprites, uint8_t count);
+
+/**
+ * Show a sprite with an image at a position, or change its image and position if already shown.
+ * The image header is read to get its height and encoding.
+ */
+void sprite_show(uint8_t id, graphics_image_t image, disp_x_t x, disp_y_t y);
+
+/**
+ * Move a visible sprite. Only the sprite's place in the Y order is updated if its row changes.
+ */
+void sprite_move(uint8_t id, disp_x_t x, disp_y_t y);
+
+/**
+ * Hide a sprite, it's removed from the Y order. Nothing is done if the sprite is hidden.
+ */
+void sprite_hide(uint8_t id);
+
+/**
+ * Draw the visible sprites overlapping the current page.
+ */
+void sprite_draw_page(void);
+
+#endif //CORE_SPRITE_H
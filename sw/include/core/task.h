@@ -0,0 +1,132 @@
+
+/*
+ * Copyright 2021 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CORE_TASK_H
+#define CORE_TASK_H
+
+#include <core/time.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Cooperative scheduler for background work, with stackless tasks in the style of protothreads.
+ * A task is a function called repeatedly by `task_run`, which resumes where it last yielded.
+ * Since there's no stack per task, local variables are not kept across yields and must be stored
+ * in the task context. For the same reason, the task macros can only be used in the top-level
+ * function of the task and not in a switch statement. Example:
+ *
+ *     typedef struct {
+ *         task_t task;
+ *         uint8_t block;
+ *     } load_task_t;
+ *
+ *     static task_result_t load_task(task_t* task) {
+ *         load_task_t* t = (load_task_t*) task;
+ *         TASK_BEGIN(task);
+ *         for (t->block = 0; t->block < BLOCK_COUNT; ++t->block) {
+ *             load_block(t->block);
+ *             TASK_YIELD(task);
+ *         }
+ *         TASK_END(task);
+ *     }
+ *
+ * Tasks are run from the loop callback with `task_run(budget)`, which keeps resuming them in turns
+ * until the time budget is spent or there's nothing left to do.
+ */
+
+typedef enum {
+    // The task made progress and has more work to do, it should be resumed as soon as possible.
+    TASK_YIELDED,
+    // The task is waiting on a condition, it should only be resumed on the next `task_run` call.
+    TASK_WAITING,
+    // The task is finished and will be removed from the scheduler.
+    TASK_DONE,
+} task_result_t;
+
+typedef struct task task_t;
+
+typedef task_result_t (*task_func_t)(task_t* task);
+
+struct task {
+    task_func_t func;
+    // Line at which the task is resumed, or 0 to start from the beginning.
+    uint16_t resume;
+    // Next task in the scheduler list, NULL for the last task.
+    task_t* next;
+};
+
+/**
+ * Start of the task body, must be the first statement of the task function.
+ */
+#define TASK_BEGIN(task) switch ((task)->resume) { case 0:
+
+/**
+ * Yield control to other tasks, indicating that there's more work to do.
+ * The task resumes after this statement the next time it's run.
+ */
+#define TASK_YIELD(task) do { \
+    (task)->resume = __LINE__; \
+    return TASK_YIELDED; \
+    case __LINE__:; \
+} while (0)
+
+/**
+ * Yield control to other tasks until the condition is true. The condition is evaluated
+ * immediately and then once per `task_run` call until it's true.
+ */
+#define TASK_WAIT_UNTIL(task, cond) do { \
+    (task)->resume = __LINE__; \
+    case __LINE__: \
+    if (!(cond)) { \
+        return TASK_WAITING; \
+    } \
+} while (0)
+
+/**
+ * End of the task body, must be the last statement of the task function.
+ */
+#define TASK_END(task) } \
+    (task)->resume = 0; \
+    return TASK_DONE
+
+/**
+ * Add a task to the scheduler, it will start from the beginning on the next `task_run` call.
+ * The task structure must stay valid until the task is done or stopped.
+ * If the task is already running, it is restarted.
+ */
+void task_start(task_t* task, task_func_t func);
+
+/**
+ * Remove a task from the scheduler, does nothing if the task isn't running.
+ * Must not be called from within the task itself, which should end with `TASK_END` instead.
+ */
+void task_stop(task_t* task);
+
+/**
+ * Returns true if the task was started and isn't done or stopped yet.
+ */
+bool task_is_running(const task_t* task);
+
+/**
+ * Run scheduled tasks in turns, for up to `budget` system ticks. Each task is resumed at least
+ * once if at least one task is running, even if the budget is 0, so that tasks always progress.
+ * Returns early when all tasks are done or waiting.
+ * Returns true if there are tasks still running after the call.
+ */
+bool task_run(systime_t budget);
+
+#endif //CORE_TASK_H
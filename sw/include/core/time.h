@@ -21,6 +21,7 @@
 #include <core/defs.h>
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <math.h>
 
 #define SYSTICK_FREQUENCY 256
@@ -42,6 +43,23 @@
  */
 typedef uint16_t systime_t;
 
+/**
+ * Type used to store system time with sub-tick resolution, for profiling.
+ * The high 16 bits are the system time and the low 16 bits are the fraction of system tick,
+ * so this overflows at the same time as the system time and should also only be used as a
+ * difference of two values.
+ */
+typedef uint32_t systime_fine_t;
+
+// Number of fine system time units per second.
+#define SYSTIME_FINE_FREQUENCY (SYSTICK_FREQUENCY * 65536UL)
+
+/**
+ * Convert a difference of fine system time to microseconds.
+ * This uses 64-bit arithmetic, it's meant for reporting results, not for use in a time loop.
+ */
+#define fine_to_micros(n) ((uint32_t) ((uint64_t) (n) * 1000000 / SYSTIME_FINE_FREQUENCY))
+
 /**
  * Returns the system time value.
  * The system time is incremented every 1/256th second.
@@ -49,6 +67,25 @@ typedef uint16_t systime_t;
  */
 systime_t time_get();
 
+/**
+ * Returns the system time with sub-tick resolution. The resolution is one cycle of the
+ * 32.768 kHz RTC clock (about 31 us), and `time_get_fine() >> 16` is the system time.
+ * Interrupts aren't disabled to read the time, but it must not be called within an interrupt
+ * or with interrupts disabled, since it waits for a pending system tick to be counted.
+ */
+systime_fine_t time_get_fine(void);
+
+/**
+ * Enable or disable tickless mode, disabled by default and on wakeup.
+ * In tickless mode, the system tick interrupt is slowed down by a factor of 32 (8 Hz) whenever
+ * no sound track is started and the LED isn't blinking, which lets the CPU idle for much longer.
+ * The system time keeps counting but is only updated on each slowed down tick, which limits the
+ * frame rate accordingly. Any button press or release restores the normal tick rate immediately.
+ * Sound started in tickless mode may be delayed by up to a slowed down tick.
+ * This should only be enabled on static screens like menus.
+ */
+void time_set_tickless(bool enabled);
+
 #include <sim/time.h>
 
 #endif //CORE_TIME_H
@@ -27,9 +27,26 @@
 
 #include <stdio.h>
 
+#include <sim/cycles.h>
+
 #define trace(str, ...) printf("GC %s:%d:(%s) " str "\n", __FILE__, __LINE__, __func__, ##__VA_ARGS__)
+
+// Annotate the estimated number of CPU cycles taken on the device by a hot code section,
+// so that the simulator can estimate the on-device frame time (see sim/cycles.h).
+#define trace_cycles(cycles) sim_cycles_add(cycles)
 #else
 #define trace(str, ...) // no-op
+#define trace_cycles(cycles) // no-op
 #endif //SIMULATION
 
+#if defined(SIMULATION) && defined(SPI_MONITOR)
+#include <sim/spi.h>
+
+// Attribute SPI traffic to a tag until the end of the enclosing scope (see sim/spi.h).
+#define trace_spi_tag(tag) const char* trace_spi_last_tag_ \
+        __attribute__((cleanup(sim_spi_restore_tag), unused)) = sim_spi_set_tag(tag)
+#else
+#define trace_spi_tag(tag) // no-op
+#endif
+
 #endif //CORE_TRACE_H
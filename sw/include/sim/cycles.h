@@ -0,0 +1,69 @@
+
+/*
+ * Copyright 2021 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef SIMULATION
+
+#ifndef SIM_CYCLES_H
+#define SIM_CYCLES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * The simulator runs native code, so its frame time says nothing about the game console.
+ * Instead, the cycles that would be spent on the device are estimated from modeled costs:
+ * every byte transferred on the SPI bus, and cycles annotated with `trace_cycles` in hot
+ * functions. Code that isn't annotated is free in this model, so the estimate is a lower bound.
+ */
+
+// CPU frequency on the game console (F_CPU isn't defined in simulation).
+#define SIM_CPU_FREQUENCY 10000000
+// SPI clock prescaler set in sys_init (F_CPU/2).
+#define SIM_SPI_CLOCK_DIVIDER 2
+// CPU cycles needed to transfer a single byte on the SPI bus.
+#define SIM_SPI_BYTE_CYCLES (8 * SIM_SPI_CLOCK_DIVIDER)
+
+/**
+ * Add a number of estimated CPU cycles to the current frame.
+ */
+void sim_cycles_add(uint32_t cycles);
+
+/**
+ * Add the estimated CPU cycles for transferring a number of bytes on the SPI bus.
+ */
+void sim_cycles_add_spi(size_t length);
+
+/**
+ * Start measuring a frame, called when the first display page is started.
+ */
+void sim_cycles_start_frame(void);
+
+/**
+ * End the frame measurement, called when the last display page was sent.
+ */
+void sim_cycles_end_frame(void);
+
+/**
+ * Get the average real and estimated frame times in seconds, for the frames ended since the
+ * last call. Returns false if no frames were drawn during that time.
+ */
+bool sim_cycles_take_frame_times(double* real, double* estimated);
+
+#endif //SIM_CYCLES_H
+
+#endif //SIMULATION
@@ -35,6 +35,27 @@
 // gap in percent between pixels
 #define DISPLAY_PIXEL_GAP 0.0f
 
+/*
+ * When DISPLAY_MONITOR is defined, each frame is compared with the previous one and the
+ * number of rows and bytes changed is counted, to evaluate how much a partial refresh could save.
+ * Histograms are saved to a CSV file when the simulator exits.
+ */
+
+#define SIM_DISPLAY_STATS_FILE "display_stats.csv"
+
+/*
+ * Display frames can be captured to a Y4M video with a constant frame rate, where each frame
+ * is repeated for as long as it was shown, so that frame pacing and stutter can be reviewed
+ * frame by frame. The time at which each frame was completed is also written to a CSV file
+ * with the same name as the video with the `.csv` extension appended. With virtual time or in
+ * headless mode, the simulated time is used, not the time taken by the host.
+ * The capture is started on initialization if the SIM_DISPLAY_CAPTURE environment variable
+ * is set to the video file name.
+ */
+
+#define SIM_DISPLAY_CAPTURE_ENV "SIM_DISPLAY_CAPTURE"
+#define SIM_DISPLAY_CAPTURE_FPS 50
+
 /**
  * Draw the display on a frame where each pixel is 1x1.
  */
@@ -50,6 +71,27 @@ void sim_display_save(FILE* file);
  */
 const uint8_t* sim_display_data(void);
 
+/**
+ * Returns a pointer to the start of the display page buffer, used as scratch memory.
+ */
+uint8_t* sim_display_get_buffer(void);
+
+/**
+ * Save frame difference histograms to the CSV file.
+ */
+void sim_display_save_stats(void);
+
+/**
+ * Start capturing display frames to a Y4M file. Does nothing if a capture is in progress.
+ * The capture is ended automatically on exit.
+ */
+void sim_display_start_capture(const char* filename);
+
+/**
+ * End the display frames capture and close the files.
+ */
+void sim_display_end_capture(void);
+
 /**
  * Transceive SPI data by emulating display device.
  */
@@ -61,6 +61,25 @@ void sim_flash_spi_transceive(size_t length, uint8_t data[]);
  */
 void sim_flash_spi_reset(void);
 
+#ifdef SPI_MONITOR
+
+#define SIM_FLASH_READS_FILE "flash_reads.csv"
+
+/**
+ * Attribute estimated CPU cycles to the flash address last read. Cycles annotated with
+ * `trace_cycles` are typically spent decoding the data that was just read, so this gives
+ * an estimate of the decoding cost of each asset.
+ */
+void sim_flash_add_read_cycles(uint32_t cycles);
+
+/**
+ * Save the bytes read and cycles attributed per flash address to a CSV file,
+ * as averages over a number of frames. Only addresses that were read are saved.
+ */
+void sim_flash_save_read_stats(uint32_t frames);
+
+#endif
+
 #endif //SIM_FLASH_H
 
 #endif //SIMULATION
\ No newline at end of file
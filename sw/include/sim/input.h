@@ -20,12 +20,40 @@
 #ifndef SIM_INPUT_H
 #define SIM_INPUT_H
 
+#include <stdint.h>
+
+/*
+ * Input can be recorded to a text file and replayed later, to run an app on the same workload.
+ * The log has one line per input state change, with the systick count and the new state,
+ * and one line per random seed set with `random_seed`. During replay, the recorded seeds
+ * replace the ones given by the app, and keyboard input is ignored. In the GUI simulator,
+ * recording and replay are started with the SIM_INPUT_RECORD and SIM_INPUT_REPLAY environment
+ * variables. Replay is deterministic in headless mode and with virtual time.
+ */
+
 /**
  * Initialize keyboard callbacks for input module.
+ * Input recording or replay is also started if requested by environment variables.
  */
 void sim_input_init(void);
 
-#ifndef SIMULATION_HEADLESS
+/**
+ * Start recording input state changes and random seeds to a file.
+ */
+void sim_input_record(const char* filename);
+
+/**
+ * Replay input state changes and random seeds from a file written by `sim_input_record`.
+ */
+void sim_input_replay(const char* filename);
+
+/**
+ * Log a random seed when recording, or return the next recorded seed when replaying.
+ * Otherwise, the seed is returned unchanged.
+ */
+uint16_t sim_input_log_seed(uint16_t seed);
+
+#ifdef SIMULATION_HEADLESS
 
 /**
  * Set input state (headless only).
@@ -21,11 +21,19 @@
 #include <stdint.h>
 #include <stddef.h>
 
+/*
+ * Memory data is mapped to the memory file when loaded, so that loading is instant and saving
+ * only writes the pages that changed. The file isn't extended to the memory size: the part of
+ * the memory past the last full page of the file is kept in anonymous memory, and written back
+ * to the file on save, up to the last byte that isn't erased.
+ */
 typedef struct {
     size_t size;
     uint8_t initial;
     const char* filename;
-    uint8_t data[];
+    // number of bytes at the start of data that are mapped to the file.
+    size_t mapped_size;
+    uint8_t* data;
 } sim_mem_t;
 
 /**
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifdef SIMULATION
+
+#ifndef SIM_PROFILE_H
+#define SIM_PROFILE_H
+
+/*
+ * When built with FUNCTION_PROFILE, app and core functions are instrumented with
+ * `-finstrument-functions` to count calls to each function and the time spent in it, excluding
+ * the functions it calls. This native time is only a proxy for the time on the device, but it
+ * ranks the hot functions, which utils/optimize_select.py uses to choose which functions marked
+ * with AVR_OPTIMIZE are built with -O3 within the program memory budget.
+ */
+
+#ifdef FUNCTION_PROFILE
+
+#define SIM_FUNCTION_PROFILE_FILE "function_profile.csv"
+
+/**
+ * Save the calls and time spent per function to a CSV file. Functions are identified by their
+ * offset in the simulator executable, to be resolved with the symbols from `nm`.
+ */
+void sim_profile_save(void);
+
+#endif
+
+#endif //SIM_PROFILE_H
+
+#endif //SIMULATION
@@ -21,6 +21,7 @@
 #define SIM_SOUND_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 /**
  * Initialize sound output.
@@ -47,6 +48,16 @@ void sim_sound_close_stream(void);
  */
 bool sim_sound_is_output_enabled(void);
 
+#ifdef SIMULATION_HEADLESS
+/**
+ * Render a number of system ticks of sound to a mono 16-bit WAV file. The sound module is
+ * stepped at the system tick rate and track buffers are filled when needed, so the output
+ * is the same on every run and doesn't depend on the host. Returns false if the file can't
+ * be opened. Only available in headless mode, where time doesn't advance by itself.
+ */
+bool sim_sound_render_wav(const char* filename, uint32_t ticks);
+#endif //SIMULATION_HEADLESS
+
 #endif //SIM_SOUND_H
 
 #endif //SIMULATION
@@ -0,0 +1,67 @@
+
+/*
+ * Copyright 2021 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef SIMULATION
+
+#ifndef SIM_SPI_H
+#define SIM_SPI_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * When SPI_MONITOR is defined, bytes and transactions on the SPI bus are counted per device
+ * and per tag. Code that uses the SPI bus is tagged with `trace_spi_tag`, the innermost tag
+ * is used when tags are nested. Counters are saved to a CSV file when the simulator exits.
+ */
+
+#define SIM_SPI_STATS_FILE "spi_stats.csv"
+
+/**
+ * Returns the number of bytes transferred with the flash since the simulation started.
+ * This is counted even if SPI_MONITOR isn't defined.
+ */
+uint64_t sim_spi_get_flash_bytes(void);
+
+/**
+ * Set the tag used to attribute SPI traffic. Returns the previous tag.
+ */
+const char* sim_spi_set_tag(const char* tag);
+
+/**
+ * Restore a tag returned by `sim_spi_set_tag`, used as a cleanup function.
+ */
+void sim_spi_restore_tag(const char** tag);
+
+/**
+ * Count a display page transfer, which isn't done over SPI in simulation.
+ */
+void sim_spi_count_display(size_t length);
+
+/**
+ * Count a frame drawn, to give per-frame averages.
+ */
+void sim_spi_end_frame(void);
+
+/**
+ * Save SPI counters to the CSV file.
+ */
+void sim_spi_save_stats(void);
+
+#endif //SIM_SPI_H
+
+#endif //SIMULATION
@@ -18,11 +18,20 @@
 #ifndef SIM_UART_H
 #define SIM_UART_H
 
+#include <stdint.h>
+
 /**
  * Listen for client connection for the UART socket.
  */
 void sim_uart_listen(void);
 
+/**
+ * Sleep for a number of microseconds, or less if data is received on the UART in the meantime.
+ * This is used by the loop thread so that received packets are handled without delay.
+ * In virtual time, this is the same as `sim_time_sleep`.
+ */
+void sim_uart_sleep(uint32_t us);
+
 /**
  * Close the simulated UART pipe, after it has been initialized.
  */
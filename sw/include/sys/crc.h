@@ -0,0 +1,35 @@
+
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYS_CRC_H
+#define SYS_CRC_H
+
+#include <stdint.h>
+
+// CRC-CCITT update function, from avr-libc on the target and reimplemented for simulation.
+#ifdef SIMULATION
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data) {
+    // same as the avr-libc function.
+    data ^= crc & 0xff;
+    data ^= data << 4;
+    return ((uint16_t) data << 8 | crc >> 8) ^ (uint8_t) (data >> 4) ^ ((uint16_t) data << 3);
+}
+#else
+#include <util/crc16.h>
+#endif
+
+#endif //SYS_CRC_H
@@ -20,7 +20,35 @@
 
 #include <core/data.h>
 
+extern SIM_THREAD_LOCAL data_cache_t* sys_data_cache;
+
 // see documentation in core/data.h
 void sys_data_read(data_ptr_t address, uint16_t length, uint8_t dest[]);
 
+// see documentation in core/data.h
+const uint8_t* sys_data_get_pointer(data_ptr_t address);
+
+/**
+ * Read data from flash at a relative address through the data cache, if set.
+ */
+void sys_data_read_flash(flash_t address, uint16_t length, uint8_t dest[]);
+
+/**
+ * Start reading data sequentially from an address. If the address is in flash, a flash stream
+ * is opened so that the command and address aren't sent again on each read. The stream must
+ * be closed with `sys_data_stream_close` before any other SPI access.
+ */
+void sys_data_stream_open(data_ptr_t address);
+
+/**
+ * Read the next bytes from the stream opened at an address. The address must be the stream
+ * start address advanced by the number of bytes read since it was opened.
+ */
+void sys_data_stream_read(data_ptr_t address, uint16_t length, uint8_t dest[]);
+
+/**
+ * Close the stream opened with `sys_data_stream_open`, at any address in the same data space.
+ */
+void sys_data_stream_close(data_ptr_t address);
+
 #endif //SYS_DATA_H
@@ -35,9 +35,9 @@
 
 #ifdef SIMULATION
 /** First Y coordinate for current page (inclusive), must not be changed directly. */
-extern disp_y_t sys_display_page_ystart;
+extern SIM_THREAD_LOCAL disp_y_t sys_display_page_ystart;
 /** Last Y coordinate for current page (inclusive), must not be changed directly */
-extern disp_y_t sys_display_page_yend;
+extern SIM_THREAD_LOCAL disp_y_t sys_display_page_yend;
 #else
 #include <avr/io.h>
 #define sys_display_page_ystart (*((disp_y_t*) &GPIOR1))
@@ -48,21 +48,59 @@ extern disp_y_t sys_display_page_yend;
  * Height of current page in pixels.
  * This can be accessed directly.
  */
-extern uint8_t sys_display_curr_page_height;
+extern SIM_THREAD_LOCAL uint8_t sys_display_curr_page_height;
 
 /**
  * Maximum height for a display page in pixels.
  * All pages except the last one (and sometimes the last one too) have this height.
  * This can be accessed directly.
  */
-extern uint8_t sys_display_page_height;
+extern SIM_THREAD_LOCAL uint8_t sys_display_page_height;
+
+/**
+ * First and last Y coordinates of the rows refreshed by the current frame (inclusive).
+ * This is the whole display unless dirty rows were set for the frame.
+ */
+extern SIM_THREAD_LOCAL disp_y_t sys_display_refresh_ystart;
+extern SIM_THREAD_LOCAL disp_y_t sys_display_refresh_yend;
+
+/**
+ * Display RAM row shown on the first display row. The display RAM is written at rows offset
+ * by this value, wrapping around, so that display coordinates don't depend on the scroll.
+ */
+extern SIM_THREAD_LOCAL uint8_t sys_display_start_line;
+
+/**
+ * Palette used to remap the page buffer colors when it is transmitted, or null if none.
+ * Array of 16 colors indexed by the color drawn.
+ */
+extern SIM_THREAD_LOCAL const disp_color_t* sys_display_palette;
+
+/**
+ * Render scheduler frame period in system ticks, 0 if disabled.
+ * If enabled, frames are drawn at most once per period and a frame is skipped after
+ * a frame that overran its period, to avoid slowing down the app loop.
+ */
+extern SIM_THREAD_LOCAL uint16_t sys_display_frame_period;
+
+/**
+ * Maximum render scheduler period between two frames, even if a frame must be skipped.
+ */
+extern SIM_THREAD_LOCAL uint16_t sys_display_max_frame_period;
+
+/**
+ * Number of frames skipped by the render scheduler since the counter was last reset.
+ * This can be accessed and reset directly.
+ */
+extern SIM_THREAD_LOCAL uint16_t sys_display_skipped_frames;
 
 /**
  * The display page buffer. This buffer is assigned to a particular section and
  * its size is variable (despite the size fixed here, it may be different in all apps).
- * `sys_display_buffer_at()` should always be used to access this buffer.
+ * It's only accessed directly by the display driver, where a pending page fill is taken into
+ * account. Everywhere else, `sys_display_buffer_at()` must be used, since it applies the fill.
  */
-extern uint8_t sys_display_buffer[DISPLAY_PAGE_HEIGHT * DISPLAY_NUM_COLS];
+extern uint8_t sys_display_buffer[DISPLAY_MAX_PAGE_HEIGHT * DISPLAY_NUM_COLS];
 
 extern uint8_t sys_display_state;
 extern uint8_t sys_display_contrast;
@@ -87,12 +125,51 @@ bool sys_display_is_dimmed(void);
  */
 void sys_display_clear(disp_color_t c);
 
+// see core/display.h for documentation
+void sys_display_set_dirty_rows(disp_y_t ystart, disp_y_t yend);
+
+// see core/display.h for documentation
+void sys_display_scroll(int8_t rows);
+
+// see core/display.h for documentation
+void sys_display_set_palette(const disp_color_t palette[16]);
+
+// see core/display.h for documentation
+void sys_display_set_clear_on_send(bool enabled);
+
+/**
+ * Fill the current page buffer with a block value (two pixels).
+ * The buffer isn't actually written until it's accessed with `sys_display_buffer_at()`.
+ * If the page isn't drawn on afterwards, the block is transmitted directly without reading
+ * the buffer. The page buffer stays filled for the next pages until drawn on.
+ */
+void sys_display_fill_page(uint8_t block);
+
+/**
+ * Write the fill block set by `sys_display_fill_page()` to the page buffer.
+ * This is called automatically when accessing the buffer.
+ */
+void sys_display_apply_fill(void);
+
 /**
  * Initialize display page size.
  * This must be called prior to `display_first_page` and before starting the app.
  */
 void sys_display_init_page(uint8_t height);
 
+/**
+ * Initialize the render scheduler from the target and minimum frame rates.
+ * A target FPS of 0 disables the scheduler, a minimum FPS of 0 means no minimum.
+ * The skipped frames counter is also reset.
+ */
+void sys_display_init_fps(uint8_t target_fps, uint8_t min_fps);
+
+/**
+ * Write a whole frame of display data directly to the display, outside of the page loop.
+ * The data is 128 rows of `DISPLAY_NUM_COLS` bytes, in the same layout as the page buffer.
+ */
+void sys_display_write_frame(data_ptr_t data);
+
 /**
  * The display buffer used to write data for one page at a time before it is sent to the display.
  * The data in the buffer is in row-major order and only contains complete rows.
@@ -100,6 +177,9 @@ void sys_display_init_page(uint8_t height);
  * This functions returns a pointer to the display buffer at a page coordinate.
  * If X is odd, this returns a pointer to the pixel on the left, since there are two pixels per byte.
  * Page coordinate have the same x as display coordinates but a different y.
+ * This is the only way to access the buffer outside of the display driver, since it applies
+ * a pending page fill first. The returned pointer stays valid for the rest of the page, so
+ * drawing functions call this once and then move across rows by `DISPLAY_NUM_COLS` bytes.
  */
 uint8_t* sys_display_buffer_at(disp_x_t x, disp_y_t y);
 
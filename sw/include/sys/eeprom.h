@@ -19,7 +19,10 @@
 #define SYS_EEPROM_H
 
 #include <core/eeprom.h>
+#include <core/defs.h>
+
 #include <stdint.h>
+#include <stdbool.h>
 
 /*
  * EEPROM MEMORY LAYOUT
@@ -65,8 +68,8 @@
 #define SYS_EEPROM_WRITE_BUF_ADDR 192
 #define SYS_EEPROM_DATA_START_ADDR 448
 
-extern eeprom_t sys_eeprom_offset;
-extern eeprom_t sys_eeprom_size;
+extern SIM_THREAD_LOCAL eeprom_t sys_eeprom_offset;
+extern SIM_THREAD_LOCAL eeprom_t sys_eeprom_size;
 
 /**
  * Set the address and size of the allocated EEPROM section for the loaded app.
@@ -74,23 +77,57 @@ extern eeprom_t sys_eeprom_size;
 void sys_eeprom_set_location(eeprom_t address, uint16_t size);
 
 // see documentation in core/eeprom.h
-void sys_eeprom_read_relative(eeprom_t address, uint8_t length, void* dest);
+void sys_eeprom_read_relative(eeprom_t address, uint16_t length, void* dest);
+
+/**
+ * Start reading EEPROM sequentially from an address, absolute in the EEPROM memory space.
+ * A queued write must be complete. See `eeprom_stream_open` for more information.
+ */
+void sys_eeprom_stream_open_absolute(eeprom_t address);
+
+// see documentation in core/eeprom.h
+void sys_eeprom_stream_open_relative(eeprom_t address);
+
+// see documentation in core/eeprom.h
+void sys_eeprom_stream_read(uint16_t length, void* dest);
+
+// see documentation in core/eeprom.h
+void sys_eeprom_stream_close(void);
 
 // see documentation in core/eeprom.h
 void sys_eeprom_write_relative(eeprom_t address, uint8_t length, const void* src);
 
+/**
+ * Queue an atomic write to EEPROM at an absolute address, see `eeprom_write_async`.
+ * The write is advanced by `sys_eeprom_update`.
+ */
+void sys_eeprom_write_async_absolute(eeprom_t address, uint8_t length, const void* src);
+
+// see documentation in core/eeprom.h
+void sys_eeprom_write_async_relative(eeprom_t address, uint8_t length, const void* src);
+
+// see documentation in core/eeprom.h
+bool sys_eeprom_is_write_done(void);
+
+/**
+ * Finish the queued write if there's one, blocking until it is complete.
+ * This must be done before going to sleep or resetting.
+ */
+void sys_eeprom_flush(void);
+
 /**
  * Read a number of bytes from EEPROM starting from an address.
  * The bytes are copied to the destination buffer.
  * If reading past the end of EEPROM, the address will be wrapped around.
  */
-void sys_eeprom_read_absolute(eeprom_t address, uint8_t length, void* dest);
+void sys_eeprom_read_absolute(eeprom_t address, uint16_t length, void* dest);
 
 /**
  * Write a number of bytes to EEPROM starting at an address.
  * The bytes are copied from the source buffer.
+ * Consecutive pages are written one after the other, waiting for each to complete.
  * If writing past the end of EEPROM, the address will be wrapped around.
  */
-void sys_eeprom_write_absolute(eeprom_t address, uint8_t length, const void* src);
+void sys_eeprom_write_absolute(eeprom_t address, uint16_t length, const void* src);
 
 #endif //SYS_EEPROM_H
@@ -33,9 +33,17 @@
  * The index has a fixed size of 32 entries. Unused entries have an app ID of 0.
  *
  * [0..1]: flash signature (0x6367)
- * [2..31]: --reserved--
+ * [2..5]: mask of used index entries, bit N set if entry N is used (0 if unknown)
+ * [6..31]: --reserved--
  * [32..2079]: index entries
- * [2080..]: app data
+ * [2080..1040383]: app data
+ * [1040384..]: frame cache, written by apps at runtime (see core/framecache.h)
+ *
+ * App images are placed on flash page boundaries (256 bytes) and their code is padded so that
+ * the data also starts on a page, as recorded by the alignment field of the index entry.
+ * Apps with a flash data space (see `flash_space_write`) are placed on sector boundaries (4 kB)
+ * instead, and the data space starts on the first sector after the image. The total app size
+ * includes the data space.
  *
  * Each index entry has the following format:
  * [0]: app ID
@@ -48,7 +56,11 @@
  * [12..13]: start address of EEPROM data space (0 if none)
  * [14..15]: size of EEPROM data space (0 if none)
  * [16..18]: start address of image in flash
- * [19..26]: --reserved--
+ * [19]: render scheduler target FPS (0 if disabled)
+ * [20]: render scheduler minimum FPS (0 if none)
+ * [21]: log2 of image and data alignment in bytes (8 for flash pages, 0 if not aligned)
+ * [22..24]: start address of flash data space (0 if none)
+ * [25..26]: size of flash data space in 4 kB sectors (0 if none)
  * [27..29]: total app size in bytes
  * [30..31]: build date ([0..4]=day, [5..8]=month, [9..15]=year since 2020)
  * [32..47]: name, ASCII encoding
@@ -65,11 +77,22 @@
 
 #define SYS_FLASH_SIGNATURE 0x6367
 
+#define SYS_FLASH_INDEX_MASK_ADDR 2
 #define SYS_FLASH_INDEX_ADDR 32
 #define SYS_FLASH_INDEX_ENTRY_SIZE 64
+// position of the flash data space location within an index entry.
+#define SYS_FLASH_INDEX_SPACE_POS 22
 #define SYS_FLASH_DATA_START_ADDR 2080
 
-extern flash_t sys_flash_offset;
+// The frame cache takes the last two 4 kB sectors, for a full frame of 128x128 pixels.
+#define SYS_FLASH_FRAME_CACHE_ADDR (SYS_FLASH_SIZE - 8192)
+
+// Set when a program or erase operation was started and the flash may still be busy.
+// Reads wait for the flash to be ready first when set.
+extern SIM_THREAD_LOCAL bool sys_flash_write_pending;
+extern SIM_THREAD_LOCAL flash_t sys_flash_offset;
+extern SIM_THREAD_LOCAL flash_t sys_flash_space_offset;
+extern SIM_THREAD_LOCAL uint16_t sys_flash_space_sectors;
 
 /**
  * Set the offset to use for relative reads.
@@ -77,6 +100,11 @@ extern flash_t sys_flash_offset;
  */
 void sys_flash_set_offset(flash_t address);
 
+/**
+ * Set the address and size in sectors of the flash data space for the loaded app.
+ */
+void sys_flash_set_space_location(flash_t address, uint16_t sectors);
+
 /**
  * Read a number of bytes from flash starting from an address.
  * The address is absolute in the flash memory space.
@@ -85,6 +113,12 @@ void sys_flash_set_offset(flash_t address);
  */
 void sys_flash_read_absolute(flash_t address, uint16_t length, void* dest);
 
+/**
+ * Same as `sys_flash_read_absolute`, but also update a CRC-CCITT with the bytes read,
+ * computed while the bytes are received. Returns the updated CRC. Length must be at least 1.
+ */
+uint16_t sys_flash_read_crc(flash_t address, uint16_t length, void* dest, uint16_t crc);
+
 /**
  * Read a number of bytes from flash starting from an address.
  * The address is relative to the start of the app data space.
@@ -93,4 +127,57 @@ void sys_flash_read_absolute(flash_t address, uint16_t length, void* dest);
  */
 void sys_flash_read_relative(flash_t address, uint16_t length, void* dest);
 
+/**
+ * Start reading flash sequentially from an address, absolute in the flash memory space.
+ * See `flash_stream_open` for more information.
+ */
+void sys_flash_stream_open_absolute(flash_t address);
+
+/**
+ * Start reading flash sequentially from an address, relative to the start of the app data space.
+ */
+void sys_flash_stream_open_relative(flash_t address);
+
+// see core/flash.h for documentation
+void sys_flash_stream_read(uint16_t length, void* dest);
+
+// see core/flash.h for documentation
+void sys_flash_stream_close(void);
+
+/**
+ * Returns true if the flash is busy with a program or erase operation.
+ * The flash status is only read if an operation was started since the flash was last ready.
+ */
+bool sys_flash_is_busy(void);
+
+/**
+ * Wait until the flash is done with the last program or erase operation.
+ */
+void sys_flash_wait_ready(void);
+
+/**
+ * Start programming a number of bytes to flash starting from an absolute address, without
+ * waiting for completion. The bytes must all be within a single flash page.
+ * Waits for the flash to be ready first. Reads will wait for the programming to be done.
+ */
+void sys_flash_program(flash_t address, uint16_t length, const void* src);
+
+/**
+ * Start erasing the 4 kB sector containing an absolute address, without waiting for completion.
+ * Waits for the flash to be ready first. Reads will wait for the erase to be done.
+ */
+void sys_flash_erase_sector(flash_t address);
+
+#ifdef FLASH_MONITOR
+// Flash reads counted since the start of the current frame, and during the last frame.
+extern SIM_THREAD_LOCAL flash_frame_stats_t sys_flash_curr_stats;
+extern SIM_THREAD_LOCAL flash_frame_stats_t sys_flash_frame_stats;
+
+/**
+ * Save the flash reads counted during the last frame and reset the counters.
+ * This is called on the first display page of each frame.
+ */
+void sys_flash_start_frame(void);
+#endif
+
 #endif //SYS_FLASH_H
@@ -20,6 +20,7 @@
 
 #include <stdint.h>
 #include <core/defs.h>
+#include <core/input.h>
 
 extern uint8_t sys_input_state;
 extern uint8_t sys_input_curr_state;
@@ -33,4 +34,8 @@ uint8_t sys_input_get_state(void);
 
 uint8_t sys_input_get_last_state(void);
 
+bool sys_input_get_event(input_event_t* event);
+
+void sys_input_clear_events(void);
+
 #endif //SYS_INPUT_H
@@ -74,4 +74,7 @@ bool sys_power_is_sleep_enabled(void);
  */
 bool sys_power_is_sleep_due(void);
 
+// see core/power.h for documentation
+void sys_power_skip_idle(void);
+
 #endif //SYS_POWER_H
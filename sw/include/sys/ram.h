@@ -0,0 +1,48 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef SYS_RAM_H
+#define SYS_RAM_H
+
+#include <stdint.h>
+
+// Byte used to paint the RAM left for the stack, see `sys_ram_paint_stack`.
+#define SYS_RAM_STACK_PAINT 0xc5
+
+/**
+ * Fill RAM from `start` up to the stack pointer with `SYS_RAM_STACK_PAINT`.
+ * The bootloader does this on reset from the end of its data, and again before starting
+ * an app from the start of the display buffer, since the app data is initialized over it.
+ * Anything located in the painted range is lost.
+ */
+void sys_ram_paint_stack(uint8_t* start);
+
+/**
+ * Returns the maximum number of bytes used by the stack since RAM was last painted.
+ * RAM is scanned from the end of data up to the first byte that isn't paint anymore,
+ * so this takes longer the more RAM is unused and shouldn't be called on every frame.
+ * Always returns 0 in simulation.
+ */
+uint16_t sys_ram_get_stack_high_water(void);
+
+/**
+ * Returns the number of bytes of RAM left for the stack, from the end of data to the
+ * end of RAM. Always returns 0 in simulation.
+ */
+uint16_t sys_ram_get_stack_space(void);
+
+#endif //SYS_RAM_H
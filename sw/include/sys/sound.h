@@ -33,12 +33,25 @@
 
 // The size of each track buffer, to avoid reading from flash one byte at a time.
 // A buffer size of 16 should give about 2-4 seconds of equivalent playback time.
-#define SOUND_TRACK_BUFFER_SIZE 20
+// The buffer is a ring buffer, this must be a power of two.
+#define SOUND_TRACK_BUFFER_SIZE 16
 
 
+// Approximate number of CPU cycles taken by a channel timer interrupt, including entry and exit.
+#define SYS_SOUND_ISR_CYCLES 40
+
 extern sound_volume_t sys_sound_global_volume;
 extern sound_channel_volume_t sys_sound_channel2_volume;
 
+#ifdef SOUND_MONITOR
+/**
+ * Returns the number of channel timer interrupts since the last call and resets the count.
+ * Only available if both the bootloader and the app are compiled with SOUND_MONITOR,
+ * since the interrupts are part of the bootloader. Always returns 0 in simulation.
+ */
+uint16_t sys_sound_take_isr_count(void);
+#endif
+
 /**
  * Play current note of track on sound channel.
  * This function should never be used by app code.
@@ -79,6 +92,8 @@ typedef struct {
     // Current position in note data array, in unified data space.
     // TRACK_DATA_END_MASK is set when all data has been read for the track.
     sound_t data;
+    // Number of bytes of track data left to read from the data address, from the track length.
+    uint16_t data_left;
     // Pause duration used after note using immediate pause encoding.
     uint8_t immediate_pause;
     // Note being currently played (0-83).
@@ -90,14 +105,16 @@ typedef struct {
     uint16_t duration_total;
     // Number of times that the current note duration is to be repeated yet.
     uint8_t duration_repeat;
-    // Buffer used to store upcoming sound data.
+    // Ring buffer used to store upcoming sound data.
     uint8_t buffer[SOUND_TRACK_BUFFER_SIZE];
-    // Current position in buffer.
+    // Current read position and end of data in buffer. These are not wrapped to the buffer size,
+    // so that the difference is the number of bytes available.
     uint8_t buffer_pos;
+    uint8_t buffer_end;
 } sound_track_t;
 
 // Sound tracks, one per channel.
-extern sound_track_t sys_sound_tracks[SYS_SOUND_CHANNELS];
+extern SIM_THREAD_LOCAL sound_track_t sys_sound_tracks[SYS_SOUND_CHANNELS];
 
 // Bitfield indicating which tracks are currently started and playing.
 // - 0:2 indicate whether tracks have been started.
@@ -107,10 +124,19 @@ extern sound_track_t sys_sound_tracks[SYS_SOUND_CHANNELS];
 // 2. Not started & playing: track is stopped and was playing before being stopped -> no sound
 // 3. Started & not playing: track is started, but has no data or is finished -> no sound
 // 4. Started & playing: track is started and playing --> sound produced (aka "active")
-extern volatile uint8_t sys_sound_tracks_on;
+extern SIM_THREAD_LOCAL volatile uint8_t sys_sound_tracks_on;
+
+// Channel 2 decay envelope duration in system ticks, or 0 if disabled.
+extern SIM_THREAD_LOCAL uint8_t sys_sound_channel2_decay;
+
+// System ticks left until the end of the decay envelope for the current channel 2 note, 0 if none.
+extern SIM_THREAD_LOCAL uint8_t sys_sound_channel2_decay_left;
+
+// Current tempo value, in 8.8 fixed point.
+extern SIM_THREAD_LOCAL uint16_t sys_sound_tempo;
 
-// Current tempo value.
-extern uint8_t sys_sound_tempo;
+// Set when a playing track buffer is running low, cleared when track buffers are filled.
+extern SIM_THREAD_LOCAL volatile bool sys_sound_refill_needed;
 
 /**
  * Fill track buffers with sound data. This must be called periodically
@@ -27,6 +27,14 @@
  */
 void sys_spi_transceive(uint16_t length, uint8_t data[]);
 
+/**
+ * Receive data on the SPI bus and update a CRC-CCITT with the received bytes, returning
+ * the updated CRC. The transmitted bytes are unspecified. Length must be at least 1.
+ * The CS line for the selected peripheral should be driven low before and after.
+ * This should never be called in an interrupt, in case another transfer is in progress already.
+ */
+uint16_t sys_spi_receive_crc(uint16_t length, uint8_t data[], uint16_t crc);
+
 /**
  * Transmit data on the SPI bus. Length must be at least 1.
  * The CS line for the selected peripheral should be driven low before and after.
@@ -41,6 +49,15 @@ void sys_spi_transmit(uint16_t length, const uint8_t data[]);
  */
 void sys_spi_transmit_single(uint8_t byte);
 
+/**
+ * Start and end a transmit-only transfer written directly to the SPI data register.
+ * After starting, bytes can be written whenever the data register is empty (DREIF=1),
+ * without reading the received bytes. Ending waits for the transfer to be complete and
+ * discards the received bytes so that the next transfer starts with an empty receive buffer.
+ */
+void sys_spi_begin_transmit(void);
+void sys_spi_end_transmit(void);
+
 // Peripheral selection
 void sys_spi_select_flash(void);
 void sys_spi_select_eeprom(void);
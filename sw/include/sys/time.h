@@ -22,8 +22,43 @@
 
 extern volatile systime_t sys_time_counter;
 
+// Number of RTC clock cycles per system tick, the 32.768 kHz RTC clock isn't prescaled
+// so that the RTC counter gives the fraction of system tick.
+#define SYS_TIME_RTC_TICK_PERIOD 128
+#define SYS_TIME_RTC_TICK_PERIOD_BITS 7
+
 // see core/time.h for documentation
 
 systime_t sys_time_get();
 
+systime_fine_t sys_time_get_fine(void);
+
+void sys_time_set_tickless(bool enabled);
+
+#ifdef LOOP_MONITOR
+/**
+ * Main loop phases, sampled by the system tick interrupt to estimate where CPU time goes.
+ */
+typedef enum {
+    SYS_LOOP_PHASE_OTHER,
+    SYS_LOOP_PHASE_BATTERY,
+    SYS_LOOP_PHASE_SOUND,
+    SYS_LOOP_PHASE_LOOP,
+    SYS_LOOP_PHASE_DRAW,
+    SYS_LOOP_PHASE_DISPLAY,
+    SYS_LOOP_PHASE_IDLE,
+    SYS_LOOP_PHASE_COUNT,
+} sys_loop_phase_t;
+
+// Phase the main loop is currently in, set by the bootloader main loop.
+extern SIM_THREAD_LOCAL volatile uint8_t sys_loop_phase;
+
+/**
+ * Copy the number of system ticks during which the main loop was in each phase since the last
+ * call to `samples` and reset the counts. Only available if both the bootloader and the app
+ * are compiled with LOOP_MONITOR, since the sampling is done in the system tick interrupt.
+ */
+void sys_time_take_loop_samples(uint16_t samples[SYS_LOOP_PHASE_COUNT]);
+#endif
+
 #endif //SYS_TIME_H
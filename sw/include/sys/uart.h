@@ -64,6 +64,28 @@ void sys_uart_set_baud(uint16_t baud_calc);
  */
 void sys_uart_write(uint8_t c);
 
+/**
+ * Function called from the UART interrupt when the last byte of a buffer written with
+ * `sys_uart_write_buffer` has been moved to the UART.
+ */
+typedef void (*sys_uart_done_cb_t)(void);
+
+/**
+ * Write a buffer to the UART without copying it: the TX interrupt reads bytes straight from
+ * the buffer, after the bytes already in the TX buffer. This function returns immediately,
+ * unless a previous buffer is still being written, and the buffer must not be modified until
+ * it has been written. The `done` callback is called from the interrupt at that point, if not
+ * null. `sys_uart_write` waits until the buffer has been written to preserve ordering.
+ * Interrupts must be enabled when called.
+ */
+void sys_uart_write_buffer(const uint8_t* data, uint8_t length, sys_uart_done_cb_t done);
+
+/**
+ * Wait until the last buffer written with `sys_uart_write_buffer` has been written and can be
+ * modified. Interrupts must be enabled when this is called.
+ */
+void sys_uart_wait_buffer(void);
+
 /**
  * Read a byte from the UART. This function is blocking if buffer is empty.
  * If data is available to read and is not read, buffer will fill up and data will be lost.
@@ -78,6 +100,19 @@ uint8_t sys_uart_read(void);
  */
 bool sys_uart_available(void);
 
+/**
+ * Returns the number of bytes available to be read from the RX buffer.
+ * This is at most `SYS_UART_RX_BUFFER_SIZE - 1`, at which point the buffer is full and
+ * further data waits in the UART until a byte is read.
+ */
+uint8_t sys_uart_available_count(void);
+
+/**
+ * Returns a byte from the RX buffer without removing it, at an offset from the next byte to read.
+ * The offset must be less than the number of bytes available.
+ */
+uint8_t sys_uart_peek(uint8_t offset);
+
 /**
  * Wait until TX buffer is empty and last transmission is complete.
  * Interrupts must be enabled when this is called.
@@ -1,5 +1,11 @@
 
+# The release profile (PROFILE=release) builds the simulator optimized and without sanitizers,
+# with link time optimization, in a separate build directory.
+ifeq ($(PROFILE),release)
+PLATFORM := sim-release
+else
 PLATFORM := sim
+endif
 
 include common.mk
 
@@ -18,8 +24,26 @@ LIBS += m glut pthread portaudio png
 
 DEFINES += SIMULATION BOOTLOADER
 
+# In virtual time (VIRTUAL_TIME=1), time only advances when the simulation sleeps,
+# so it runs as fast as possible instead of in real time.
+ifeq ($(VIRTUAL_TIME),1)
+DEFINES += SIMULATION_VIRTUAL_TIME
+endif
+
+# With FUNCTION_PROFILE=1, app and core functions are instrumented to count calls and the time
+# spent in each function, saved to function_profile.csv on exit (see sim/profile.h).
+ifeq ($(FUNCTION_PROFILE),1)
+DEFINES += FUNCTION_PROFILE
+CFLAGS += -finstrument-functions -finstrument-functions-exclude-file-list=sim/,boot/
+LIBS += dl
+endif
+
+ifeq ($(PROFILE),release)
+CFLAGS += -Wno-unused-parameter -g -O2 -flto=auto -fshort-enums
+else
 CFLAGS += -Wno-unused-parameter -g3 -O0 -fshort-enums \
           -fsanitize=address -fno-omit-frame-pointer -fsanitize=undefined
+endif
 CFLAGS += ${shell pkg-config --cflags glu}
 LDFLAGS += ${shell pkg-config --libs glu}
 
@@ -0,0 +1,81 @@
+
+/*
+ * Copyright 2021 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sim/cycles.h>
+#include <sim/time.h>
+#include <sim/flash.h>
+
+#include <pthread.h>
+
+#ifdef SIMULATION_HEADLESS
+#define lock_cycles_mutex()
+#define unlock_cycles_mutex()
+#else
+// frame times are taken by the GLUT thread.
+static SIM_THREAD_LOCAL pthread_mutex_t cycles_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define lock_cycles_mutex() (pthread_mutex_lock(&cycles_mutex))
+#define unlock_cycles_mutex() (pthread_mutex_unlock(&cycles_mutex))
+#endif
+
+static SIM_THREAD_LOCAL struct {
+    // estimated cycles and real start time of the current frame.
+    uint64_t frame_cycles;
+    double frame_start;
+    // totals for the frames ended since frame times were last taken.
+    uint64_t total_cycles;
+    double total_time;
+    uint32_t frame_count;
+} cycles;
+
+void sim_cycles_add(uint32_t count) {
+    cycles.frame_cycles += count;
+#ifdef SPI_MONITOR
+    sim_flash_add_read_cycles(count);
+#endif
+}
+
+void sim_cycles_add_spi(size_t length) {
+    cycles.frame_cycles += (uint64_t) length * SIM_SPI_BYTE_CYCLES;
+}
+
+void sim_cycles_start_frame(void) {
+    cycles.frame_cycles = 0;
+    cycles.frame_start = sim_time_get();
+}
+
+void sim_cycles_end_frame(void) {
+    const double time = sim_time_get() - cycles.frame_start;
+    lock_cycles_mutex();
+    cycles.total_cycles += cycles.frame_cycles;
+    cycles.total_time += time;
+    ++cycles.frame_count;
+    unlock_cycles_mutex();
+}
+
+bool sim_cycles_take_frame_times(double* real, double* estimated) {
+    lock_cycles_mutex();
+    const uint32_t count = cycles.frame_count;
+    if (count != 0) {
+        *real = cycles.total_time / count;
+        *estimated = (double) cycles.total_cycles / count / SIM_CPU_FREQUENCY;
+        cycles.total_cycles = 0;
+        cycles.total_time = 0;
+        cycles.frame_count = 0;
+    }
+    unlock_cycles_mutex();
+    return count != 0;
+}
@@ -29,12 +29,43 @@ static __attribute__((no_sanitize_address)) void data_read_internal(
     }
 }
 
-void sys_data_read(data_ptr_t address, uint16_t length, uint8_t dest[static length]) {
+static bool data_is_flash(data_ptr_t address) {
     // not very portable but we'll assume the program memory isn't located in the range 0x000000 to
     // 0xffffff, and thus any addresses in that range must be either flash or EEPROM.
-    if ((address & ~0x1fffff) == DATA_FLASH_MASK) {
-        flash_read((flash_t) (address & ~DATA_FLASH_MASK), length, dest);
+    return (address & ~0x1fffff) == DATA_FLASH_MASK;
+}
+
+const uint8_t* sys_data_get_pointer(data_ptr_t address) {
+    if (data_is_flash(address)) {
+        return 0;
+    }
+    return (const uint8_t*) (uintptr_t) address;
+}
+
+void sys_data_read(data_ptr_t address, uint16_t length, uint8_t dest[static length]) {
+    if (data_is_flash(address)) {
+        sys_data_read_flash((flash_t) (address & ~DATA_FLASH_MASK), length, dest);
+    } else {
+        data_read_internal(address, length, dest);
+    }
+}
+
+void sys_data_stream_open(data_ptr_t address) {
+    if (data_is_flash(address)) {
+        flash_stream_open((flash_t) (address & ~DATA_FLASH_MASK));
+    }
+}
+
+void sys_data_stream_read(data_ptr_t address, uint16_t length, uint8_t dest[]) {
+    if (data_is_flash(address)) {
+        flash_stream_read(length, dest);
     } else {
         data_read_internal(address, length, dest);
     }
 }
+
+void sys_data_stream_close(data_ptr_t address) {
+    if (data_is_flash(address)) {
+        flash_stream_close();
+    }
+}
@@ -16,14 +16,22 @@
 
 #include <sim/display.h>
 #include <sim/time.h>
+#include <sim/cycles.h>
+#include <sim/spi.h>
 
+#include <sys/data.h>
 #include <sys/display.h>
+#include <sys/flash.h>
 #include <boot/display.h>
 
 #include <core/trace.h>
+#include <core/time.h>
+#include <core/graphics.h>
+#include <core/scratch.h>
 
 #include <memory.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <png.h>
 
 #ifndef SIMULATION_HEADLESS
@@ -32,10 +40,17 @@
 
 #endif
 
-disp_y_t sys_display_page_ystart;
-disp_y_t sys_display_page_yend;
-disp_y_t sys_display_page_height;
-disp_y_t sys_display_curr_page_height;
+SIM_THREAD_LOCAL disp_y_t sys_display_page_ystart;
+SIM_THREAD_LOCAL disp_y_t sys_display_page_yend;
+SIM_THREAD_LOCAL disp_y_t sys_display_page_height;
+SIM_THREAD_LOCAL disp_y_t sys_display_curr_page_height;
+SIM_THREAD_LOCAL disp_y_t sys_display_refresh_ystart;
+SIM_THREAD_LOCAL disp_y_t sys_display_refresh_yend;
+SIM_THREAD_LOCAL uint8_t sys_display_start_line;
+SIM_THREAD_LOCAL const disp_color_t* sys_display_palette;
+SIM_THREAD_LOCAL uint16_t sys_display_frame_period;
+SIM_THREAD_LOCAL uint16_t sys_display_max_frame_period;
+SIM_THREAD_LOCAL uint16_t sys_display_skipped_frames;
 
 #ifdef SIMULATION_HEADLESS
 #define lock_display_mutex()
@@ -48,11 +63,50 @@ static pthread_mutex_t display_mutex;
 
 #define GUARD_BYTE 0xfc
 
-static struct {
+#ifdef DISPLAY_MONITOR
+// bytes per bin in the changed bytes histogram, one display row.
+#define CHANGED_BYTES_BIN DISPLAY_NUM_COLS
+
+static SIM_THREAD_LOCAL struct {
+    uint8_t last_data[DISPLAY_SIZE];
+    bool has_last_frame;
+    uint32_t frame_count;
+    uint64_t changed_rows;
+    uint64_t changed_bytes;
+    uint64_t sent_rows;
+    // number of frames per number of rows changed.
+    uint32_t changed_rows_hist[DISPLAY_HEIGHT + 1];
+    // number of frames per number of bytes changed, binned.
+    uint32_t changed_bytes_hist[DISPLAY_SIZE / CHANGED_BYTES_BIN + 1];
+} display_stats;
+#endif
+
+static SIM_THREAD_LOCAL struct {
+    FILE* video_file;
+    FILE* times_file;
+    uint32_t frame_count;
+    uint32_t video_frame_count;
+    // offset added to the simulation time, which is reset when the simulator is reinitialized.
+    double time_offset;
+    double last_time;
+} capture;
+
+static SIM_THREAD_LOCAL struct {
     uint8_t buffer[DISPLAY_SIZE];
     size_t buffer_size;
     uint8_t data[DISPLAY_SIZE];
     uint8_t* data_ptr;
+    bool partial_refresh;
+    bool scrolled;
+    // start line for which display data is currently shown.
+    uint8_t data_start_line;
+    bool page_filled;
+    uint8_t fill_block;
+    bool clear_on_send;
+    // the page buffer already contains the fill block, only set along with page_filled.
+    bool page_cleared;
+    // number of rows at the start of the page buffer cleared when last sent.
+    disp_y_t cleared_rows;
     bool enabled;
     bool internal_vdd_enabled;
     bool inverted;
@@ -63,6 +117,7 @@ static struct {
 
 void sys_display_preinit(void) {
     display.contrast = DISPLAY_DEFAULT_CONTRAST;
+    sys_display_palette = 0;
 }
 
 void sys_display_init(void) {
@@ -71,6 +126,11 @@ void sys_display_init(void) {
     display.enabled = false;
     display.inverted = false;
     display.dimmed = false;
+    sys_display_start_line = 0;
+    display.data_start_line = 0;
+    display.scrolled = false;
+    display.clear_on_send = false;
+    display.page_cleared = false;
 
 #ifndef SIMULATION_HEADLESS
     pthread_mutex_init(&display_mutex, 0);
@@ -134,17 +194,127 @@ void sys_display_clear(disp_color_t color) {
 #endif
     lock_display_mutex();
     memset(display.data, color | color << 4, DISPLAY_SIZE);
+    display.page_filled = false;
+    display.page_cleared = false;
     unlock_display_mutex();
 }
 
+void sys_display_fill_page(uint8_t block) {
+    if (block != display.fill_block) {
+        display.page_cleared = false;
+    }
+    display.fill_block = block;
+    display.page_filled = true;
+}
+
+void sys_display_apply_fill(void) {
+    display.page_filled = false;
+    if (display.page_cleared) {
+        // the page buffer was already cleared when the last page was sent.
+        display.page_cleared = false;
+        return;
+    }
+    memset(display.buffer, display.fill_block, sys_display_curr_page_height * DISPLAY_NUM_COLS);
+}
+
+void sys_display_set_clear_on_send(bool enabled) {
+    display.clear_on_send = enabled;
+}
+
 void sys_display_init_page(uint8_t height) {
 #ifdef RUNTIME_CHECKS
     if (height == 0 || height > DISPLAY_HEIGHT) {
         trace("page height out of bounds");
         return;
     }
+    if (display.data_ptr != 0) {
+        trace("page height changed while drawing");
+        return;
+    }
 #endif
+#ifdef DISPLAY_FULL_FRAME
+    // same as on the game console, the whole display is always drawn at once.
+    sys_display_page_height = DISPLAY_HEIGHT;
+#else
     sys_display_page_height = height;
+#endif
+}
+
+void sys_display_init_fps(uint8_t target_fps, uint8_t min_fps) {
+    sys_display_frame_period = target_fps == 0 ? 0 : SYSTICK_FREQUENCY / target_fps;
+    sys_display_max_frame_period = min_fps == 0 ? UINT16_MAX : SYSTICK_FREQUENCY / min_fps;
+    sys_display_skipped_frames = 0;
+}
+
+void sys_display_set_dirty_rows(disp_y_t ystart, disp_y_t yend) {
+#ifdef RUNTIME_CHECKS
+    if (ystart > yend || yend >= DISPLAY_HEIGHT) {
+        trace("invalid dirty rows range");
+        return;
+    }
+#endif
+    // align the range on page bounds so that pages are the same as for a full refresh.
+    ystart -= ystart % sys_display_page_height;
+    yend += sys_display_page_height - 1 - yend % sys_display_page_height;
+    if (yend >= DISPLAY_HEIGHT) {
+        yend = DISPLAY_HEIGHT - 1;
+    }
+    sys_display_refresh_ystart = ystart;
+    sys_display_refresh_yend = yend;
+    display.partial_refresh = true;
+}
+
+void sys_display_scroll(int8_t rows) {
+    if (rows == 0) {
+        return;
+    }
+    sys_display_start_line = (uint8_t) (sys_display_start_line + rows) % DISPLAY_NUM_ROWS;
+    if (display.partial_refresh || display.scrolled) {
+        // rows were already set for the next frame, refresh the whole display instead.
+        display.partial_refresh = false;
+        display.scrolled = true;
+        return;
+    }
+    // only the rows scrolled into view need to be drawn.
+    if (rows > 0) {
+        sys_display_set_dirty_rows(DISPLAY_HEIGHT - rows, DISPLAY_HEIGHT - 1);
+    } else {
+        sys_display_set_dirty_rows(0, -rows - 1);
+    }
+    display.scrolled = true;
+}
+
+void sys_display_set_palette(const disp_color_t palette[16]) {
+#ifdef RUNTIME_CHECKS
+    for (uint8_t i = 0; palette && i < 16; ++i) {
+        if (palette[i] > DISPLAY_COLOR_WHITE) {
+            trace("invalid palette color");
+            return;
+        }
+    }
+#endif
+    sys_display_palette = palette;
+}
+
+static void sim_display_remap_page(void) {
+    // remap colors of the page buffer in place, like on the game console.
+    for (size_t i = 0; i < display.buffer_size; ++i) {
+        const uint8_t block = display.buffer[i];
+        display.buffer[i] = sys_display_palette[block >> 4] << 4 | sys_display_palette[block & 0xf];
+    }
+}
+
+static void sim_display_apply_start_line(void) {
+    // display data is kept in display order instead of display RAM order, so instead of
+    // offsetting the rows written, the rows already shown are rotated to their new position.
+    const size_t offset = (uint8_t) (sys_display_start_line - display.data_start_line) %
+                          DISPLAY_NUM_ROWS * DISPLAY_NUM_COLS;
+    uint8_t data[DISPLAY_SIZE];
+    memcpy(data, display.data + offset, DISPLAY_SIZE - offset);
+    memcpy(data + DISPLAY_SIZE - offset, display.data, offset);
+    memcpy(display.data, data, DISPLAY_SIZE);
+    display.data_start_line = sys_display_start_line;
+    display.scrolled = false;
 }
 
 void sys_display_first_page(void) {
@@ -153,15 +323,44 @@ void sys_display_first_page(void) {
         trace("display page has not been initialized.");
         return;
     }
+    if (scratch_is_acquired()) {
+        trace("drawing while scratch memory is acquired, its content will be lost.");
+    }
+#endif
+
+#ifdef FLASH_MONITOR
+    sys_flash_start_frame();
 #endif
 
     lock_display_mutex();
+    sim_cycles_start_frame();
+
+    if (display.scrolled) {
+        sim_display_apply_start_line();
+    }
+
+    if (display.partial_refresh) {
+        // dirty rows were set for this frame only.
+        display.partial_refresh = false;
+    } else {
+        sys_display_refresh_ystart = 0;
+        sys_display_refresh_yend = DISPLAY_HEIGHT - 1;
+    }
 
-    sys_display_page_ystart = 0;
-    sys_display_page_yend = sys_display_page_height - 1;
-    sys_display_curr_page_height = sys_display_page_height;
-    display.buffer_size = sys_display_page_height * DISPLAY_NUM_COLS;
-    display.data_ptr = display.data;
+    sys_display_page_ystart = sys_display_refresh_ystart;
+    sys_display_page_yend = sys_display_refresh_ystart + sys_display_page_height - 1;
+    if (sys_display_page_yend > sys_display_refresh_yend) {
+        sys_display_page_yend = sys_display_refresh_yend;
+    }
+    sys_display_curr_page_height = sys_display_page_yend - sys_display_page_ystart + 1;
+    // the first page doesn't start at Y=0 on a partial refresh, a cursor from the last frame
+    // could match it while the image data changed since.
+    graphics_image_invalidate_cursors();
+    if (display.cleared_rows < sys_display_curr_page_height) {
+        display.page_cleared = false;
+    }
+    display.buffer_size = sys_display_curr_page_height * DISPLAY_NUM_COLS;
+    display.data_ptr = display.data + sys_display_refresh_ystart * DISPLAY_NUM_COLS;
 
     // initialize guard bytes
     // the display buffer is the same size as the display to accomodate varying page height,
@@ -170,6 +369,134 @@ void sys_display_first_page(void) {
            sizeof display.buffer - display.buffer_size);
 }
 
+#ifdef DISPLAY_MONITOR
+static void sim_display_count_frame(void) {
+    // compare the frame shown with the previous one, in display order.
+    // the first frame is only used as a reference, since the initial display RAM is unknown.
+    if (display_stats.has_last_frame) {
+        uint16_t changed_rows = 0;
+        uint16_t changed_bytes = 0;
+        const uint8_t* curr = display.data;
+        const uint8_t* last = display_stats.last_data;
+        for (disp_y_t y = 0; y < DISPLAY_HEIGHT; ++y) {
+            uint8_t row_changed_bytes = 0;
+            for (disp_x_t col = 0; col < DISPLAY_NUM_COLS; ++col) {
+                if (*curr++ != *last++) {
+                    ++row_changed_bytes;
+                }
+            }
+            if (row_changed_bytes) {
+                ++changed_rows;
+                changed_bytes += row_changed_bytes;
+            }
+        }
+        ++display_stats.frame_count;
+        display_stats.changed_rows += changed_rows;
+        display_stats.changed_bytes += changed_bytes;
+        display_stats.sent_rows += sys_display_refresh_yend - sys_display_refresh_ystart + 1;
+        ++display_stats.changed_rows_hist[changed_rows];
+        ++display_stats.changed_bytes_hist[(changed_bytes + CHANGED_BYTES_BIN - 1) /
+                                           CHANGED_BYTES_BIN];
+    }
+    memcpy(display_stats.last_data, display.data, DISPLAY_SIZE);
+    display_stats.has_last_frame = true;
+}
+
+void sim_display_save_stats(void) {
+    FILE* file = fopen(SIM_DISPLAY_STATS_FILE, "w");
+    if (!file) {
+        trace("could not open display stats file");
+        return;
+    }
+    // histograms of the number of frames per rows changed and per bytes changed.
+    // for bytes, each bin counts frames with changes up to the bin value, from the previous bin.
+    fprintf(file, "metric,value,frames\n");
+    for (size_t i = 0; i <= DISPLAY_HEIGHT; ++i) {
+        if (display_stats.changed_rows_hist[i]) {
+            fprintf(file, "changed_rows,%zu,%u\n", i, display_stats.changed_rows_hist[i]);
+        }
+    }
+    for (size_t i = 0; i <= DISPLAY_SIZE / CHANGED_BYTES_BIN; ++i) {
+        if (display_stats.changed_bytes_hist[i]) {
+            fprintf(file, "changed_bytes,%zu,%u\n", i * CHANGED_BYTES_BIN,
+                    display_stats.changed_bytes_hist[i]);
+        }
+    }
+    fclose(file);
+
+    const uint32_t frames = display_stats.frame_count;
+    if (frames) {
+        trace("display stats for %u frames saved to " SIM_DISPLAY_STATS_FILE ": "
+              "%.1f rows sent, %.1f rows changed, %.1f bytes changed per frame", frames,
+              (double) display_stats.sent_rows / frames,
+              (double) display_stats.changed_rows / frames,
+              (double) display_stats.changed_bytes / frames);
+    }
+}
+#endif
+
+static void sim_display_capture_frame(void) {
+    // the video has a constant frame rate: the frame is repeated until the capture catches up
+    // with the current time, so frames that take longer to draw last longer in the video.
+    double time = sim_time_get() + capture.time_offset;
+    if (time < capture.last_time) {
+        capture.time_offset += capture.last_time - time;
+        time = capture.last_time;
+    }
+    capture.last_time = time;
+    uint8_t frame[DISPLAY_WIDTH * DISPLAY_HEIGHT];
+    for (size_t i = 0; i < DISPLAY_SIZE; ++i) {
+        const uint8_t block = display.data[i];
+        frame[i * 2] = (block & 0xf) * 0x11;
+        frame[i * 2 + 1] = (block >> 4) * 0x11;
+    }
+    const uint32_t first_video_frame = capture.video_frame_count;
+    while (capture.video_frame_count <= time * SIM_DISPLAY_CAPTURE_FPS) {
+        fputs("FRAME\n", capture.video_file);
+        fwrite(frame, 1, sizeof frame, capture.video_file);
+        ++capture.video_frame_count;
+    }
+    fprintf(capture.times_file, "%u,%.3f,%u,%u\n", capture.frame_count, time * 1000,
+            first_video_frame, capture.video_frame_count - first_video_frame);
+    ++capture.frame_count;
+}
+
+void sim_display_start_capture(const char* filename) {
+    if (capture.video_file) {
+        return;
+    }
+    char times_filename[256];
+    snprintf(times_filename, sizeof times_filename, "%s.csv", filename);
+    capture.video_file = fopen(filename, "wb");
+    capture.times_file = fopen(times_filename, "w");
+    if (!capture.video_file || !capture.times_file) {
+        trace("could not open capture file '%s'", filename);
+        sim_display_end_capture();
+        return;
+    }
+    fprintf(capture.video_file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 Cmono XCOLORRANGE=FULL\n",
+            DISPLAY_WIDTH, DISPLAY_HEIGHT, SIM_DISPLAY_CAPTURE_FPS);
+    fprintf(capture.times_file, "frame,time_ms,video_frame,video_frames\n");
+    capture.frame_count = 0;
+    // start the video at the current time, a capture could be started after the simulation.
+    capture.time_offset = 0;
+    capture.last_time = sim_time_get();
+    capture.video_frame_count = (uint32_t) (capture.last_time * SIM_DISPLAY_CAPTURE_FPS);
+    atexit(sim_display_end_capture);
+    trace("capturing display frames to '%s'", filename);
+}
+
+void sim_display_end_capture(void) {
+    if (capture.video_file) {
+        fclose(capture.video_file);
+        capture.video_file = 0;
+    }
+    if (capture.times_file) {
+        fclose(capture.times_file);
+        capture.times_file = 0;
+    }
+}
+
 bool sys_display_next_page(void) {
     if (display.data_ptr == 0) {
         trace("next page called before first page");
@@ -187,30 +514,68 @@ bool sys_display_next_page(void) {
     }
 
     // copy buffer to main display data
-    size_t bytes_left = (DISPLAY_SIZE - (display.data_ptr - display.data));
-    if (display.buffer_size > bytes_left) {
-        display.buffer_size = bytes_left;
+    if (display.page_filled) {
+        // page buffer hasn't been drawn on since being filled, it stays filled for the next page.
+        uint8_t block = display.fill_block;
+        if (sys_display_palette) {
+            block = sys_display_palette[block >> 4] << 4 | sys_display_palette[block & 0xf];
+        }
+        memset(display.data_ptr, block, display.buffer_size);
+    } else {
+        if (sys_display_palette) {
+            sim_display_remap_page();
+        }
+        memcpy(display.data_ptr, display.buffer, display.buffer_size);
+        if (display.clear_on_send) {
+            // same as on the game console, the page buffer is cleared while sent.
+            memset(display.buffer, display.fill_block, display.buffer_size);
+            display.cleared_rows = sys_display_curr_page_height;
+            display.page_filled = true;
+            display.page_cleared = true;
+        }
     }
-    memcpy(display.data_ptr, display.buffer, display.buffer_size);
+    // the page buffer isn't sent over SPI in simulation, account for it here.
+    sim_cycles_add_spi(display.buffer_size);
+#ifdef SPI_MONITOR
+    sim_spi_count_display(display.buffer_size);
+#endif
     display.data_ptr += display.buffer_size;
 
-    // reset guard for new buffer size
-    memset(display.buffer + display.buffer_size,
-           GUARD_BYTE, sizeof display.buffer - display.buffer_size);
-
     // update page bounds
     sys_display_page_ystart += sys_display_page_height;
     sys_display_page_yend += sys_display_page_height;
-    if (sys_display_page_yend >= DISPLAY_HEIGHT) {
-        sys_display_page_yend = DISPLAY_HEIGHT - 1;
+    if (sys_display_page_yend > sys_display_refresh_yend) {
+        sys_display_page_yend = sys_display_refresh_yend;
     }
     sys_display_curr_page_height = sys_display_page_yend - sys_display_page_ystart + 1;
+    if (display.cleared_rows < sys_display_curr_page_height) {
+        display.page_cleared = false;
+    }
 
-    bool has_next_page = sys_display_page_ystart < DISPLAY_HEIGHT;
+    bool has_next_page = sys_display_page_ystart <= sys_display_refresh_yend;
+    if (has_next_page) {
+        // reset guard for new buffer size
+        display.buffer_size = sys_display_curr_page_height * DISPLAY_NUM_COLS;
+        memset(display.buffer + display.buffer_size,
+               GUARD_BYTE, sizeof display.buffer - display.buffer_size);
+    }
     if (!has_next_page) {
         display.data_ptr = 0;
+        // variables sharing the page buffer and scratch memory can overwrite it until
+        // the next frame, the fill must be written again.
+        display.page_cleared = false;
+#ifdef DISPLAY_MONITOR
+        sim_display_count_frame();
+#endif
+        if (capture.video_file) {
+            sim_display_capture_frame();
+        }
 
         unlock_display_mutex();
+        sim_cycles_end_frame();
+#ifdef SPI_MONITOR
+        sim_spi_end_frame();
+#endif
 
         // sleep to simulate update delay
         // maximum FPS on game console is about 50
@@ -219,23 +584,103 @@ bool sys_display_next_page(void) {
     return has_next_page;
 }
 
+void sys_display_write_frame(data_ptr_t data) {
+#ifdef RUNTIME_CHECKS
+    if (display.data_ptr) {
+        trace("frame written directly while drawing a frame");
+        return;
+    }
+#endif
+    lock_display_mutex();
+    // display data is in display order for the start line currently shown, rows are placed
+    // where they end up once a pending scroll is applied, like in display RAM on the console.
+    uint8_t row[DISPLAY_NUM_COLS];
+    for (uint8_t y = 0; y < DISPLAY_HEIGHT; ++y) {
+        sys_data_read(data, DISPLAY_NUM_COLS, row);
+        if (sys_display_palette) {
+            for (uint8_t i = 0; i < DISPLAY_NUM_COLS; ++i) {
+                row[i] = sys_display_palette[row[i] >> 4] << 4 | sys_display_palette[row[i] & 0xf];
+            }
+        }
+        const uint8_t row_pos = (uint8_t) (y + sys_display_start_line - display.data_start_line) %
+                                DISPLAY_NUM_ROWS;
+        memcpy(display.data + row_pos * DISPLAY_NUM_COLS, row, DISPLAY_NUM_COLS);
+        data += DISPLAY_NUM_COLS;
+    }
+    sim_cycles_add_spi(DISPLAY_SIZE);
+#ifdef SPI_MONITOR
+    sim_spi_count_display(DISPLAY_SIZE);
+#endif
+    unlock_display_mutex();
+}
+
 uint8_t* sys_display_buffer_at(disp_x_t x, disp_y_t y) {
+    if (display.page_filled) {
+        sys_display_apply_fill();
+    }
     return &display.buffer[y * DISPLAY_NUM_COLS + x / 2];
 }
 
 #ifndef SIMULATION_HEADLESS
 
-static float get_pixel_opacity(disp_color_t color) {
-    if (display.inverted) {
+// number of texels on each side of a pixel in the pixel gap mask.
+#define PIXEL_GAP_MASK_SIZE 16
+
+// textures are created on first draw, since a GL context is needed.
+static GLuint display_texture;
+static GLuint pixel_gap_texture;
+
+static float get_pixel_opacity(disp_color_t color, bool inverted, bool dimmed, uint8_t contrast) {
+    if (inverted) {
         color = DISPLAY_COLOR_WHITE - color;
     }
     float color_factor = (float) color / DISPLAY_COLOR_WHITE;
-    float effective_contrast = (float) display.contrast / (display.dimmed ? 2.0f : 1.0f);
+    float effective_contrast = (float) contrast / (dimmed ? 2.0f : 1.0f);
     float contrast_factor = effective_contrast / DISPLAY_MAX_CONTRAST * 0.8f + 0.2f;
     if (contrast_factor > 1.0f) contrast_factor = 1.0f;
     return color_factor * contrast_factor;
 }
 
+static GLuint create_texture(GLint wrap) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+    return texture;
+}
+
+static void create_pixel_gap_texture(void) {
+    // opaque where the pixel is, transparent in the gap around it, repeated for each pixel.
+    uint8_t mask[PIXEL_GAP_MASK_SIZE * PIXEL_GAP_MASK_SIZE];
+    const float gap = DISPLAY_PIXEL_GAP / 2 * PIXEL_GAP_MASK_SIZE;
+    for (int y = 0; y < PIXEL_GAP_MASK_SIZE; ++y) {
+        for (int x = 0; x < PIXEL_GAP_MASK_SIZE; ++x) {
+            const bool in_gap = x + 0.5f < gap || x + 0.5f > PIXEL_GAP_MASK_SIZE - gap ||
+                                y + 0.5f < gap || y + 0.5f > PIXEL_GAP_MASK_SIZE - gap;
+            mask[y * PIXEL_GAP_MASK_SIZE + x] = in_gap ? 0 : 0xff;
+        }
+    }
+    pixel_gap_texture = create_texture(GL_REPEAT);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, PIXEL_GAP_MASK_SIZE, PIXEL_GAP_MASK_SIZE, 0,
+                 GL_ALPHA, GL_UNSIGNED_BYTE, mask);
+}
+
+static void draw_textured_quad(float tex_width, float tex_height) {
+    glBegin(GL_QUADS);
+    glTexCoord2f(0, 0);
+    glVertex2f(0, 0);
+    glTexCoord2f(0, tex_height);
+    glVertex2f(0, DISPLAY_HEIGHT);
+    glTexCoord2f(tex_width, tex_height);
+    glVertex2f(DISPLAY_WIDTH, DISPLAY_HEIGHT);
+    glTexCoord2f(tex_width, 0);
+    glVertex2f(DISPLAY_WIDTH, 0);
+    glEnd();
+}
+
 #endif
 
 void sim_display_draw(void) {
@@ -246,35 +691,47 @@ void sim_display_draw(void) {
         return;
     }
 
-    const float pixel_size = 1 - DISPLAY_PIXEL_GAP;
-
-    glPushMatrix();
-    glTranslatef(DISPLAY_PIXEL_GAP / 2, DISPLAY_PIXEL_GAP / 2, 0);
+    // only copy the display data while the mutex is held, the app can draw during conversion.
+    uint8_t data[DISPLAY_SIZE];
     lock_display_mutex();
-    const uint8_t* data_ptr = display.data;
-    for (disp_y_t row = 0; row < DISPLAY_NUM_ROWS; ++row) {
-        glBegin(GL_QUADS);
-        disp_x_t x = 0;
-        for (disp_x_t col = 0; col < DISPLAY_NUM_COLS; ++col) {
-            const uint8_t block = *data_ptr++;
-            for (int nib = 0; nib < 2; ++nib, ++x) {
-                const disp_color_t color = nib ? block >> 4 : block & 0xf;
-                const float opacity = get_pixel_opacity(color);
-                if (opacity != 0) {
-                    glColor4f(DISPLAY_COLOR_R, DISPLAY_COLOR_G, DISPLAY_COLOR_B, opacity);
-                    float xf = (float) x;
-                    glVertex2f(xf, 0);
-                    glVertex2f(xf, pixel_size);
-                    glVertex2f(xf + pixel_size, pixel_size);
-                    glVertex2f(xf + pixel_size, 0);
-                }
-            }
-        }
-        glEnd();
-        glTranslatef(0, 1, 0);
-    }
+    memcpy(data, display.data, DISPLAY_SIZE);
     unlock_display_mutex();
-    glPopMatrix();
+
+    // convert display data to a texture with the opacity of each pixel.
+    uint8_t alpha[16];
+    for (disp_color_t color = 0; color <= DISPLAY_COLOR_WHITE; ++color) {
+        alpha[color] = (uint8_t) (get_pixel_opacity(color, display.inverted,
+                                                    display.dimmed, display.contrast) * 255 + 0.5f);
+    }
+    uint8_t texels[DISPLAY_WIDTH * DISPLAY_HEIGHT];
+    for (size_t i = 0; i < DISPLAY_SIZE; ++i) {
+        const uint8_t block = data[i];
+        texels[i * 2] = alpha[block & 0xf];
+        texels[i * 2 + 1] = alpha[block >> 4];
+    }
+
+    if (!display_texture) {
+        display_texture = create_texture(GL_CLAMP_TO_EDGE);
+        create_pixel_gap_texture();
+    }
+
+    glEnable(GL_TEXTURE_2D);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, display_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, DISPLAY_WIDTH, DISPLAY_HEIGHT, 0,
+                 GL_ALPHA, GL_UNSIGNED_BYTE, texels);
+    glColor4f(DISPLAY_COLOR_R, DISPLAY_COLOR_G, DISPLAY_COLOR_B, 1);
+    draw_textured_quad(1, 1);
+
+    if (DISPLAY_PIXEL_GAP > 0) {
+        // multiply what was drawn by the gap mask, so that the display frame shows in the gaps.
+        glBlendFunc(GL_ZERO, GL_SRC_ALPHA);
+        glBindTexture(GL_TEXTURE_2D, pixel_gap_texture);
+        draw_textured_quad(DISPLAY_WIDTH, DISPLAY_HEIGHT);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    glDisable(GL_TEXTURE_2D);
 #endif //SIMULATION_HEADLESS
 }
 
@@ -314,6 +771,10 @@ const uint8_t* sim_display_data(void) {
     return display.data;
 }
 
+uint8_t* sim_display_get_buffer(void) {
+    return display.buffer;
+}
+
 void sim_display_spi_transceive(size_t length, uint8_t data[static length]) {
     // not implemented.
 }
@@ -50,10 +50,10 @@ enum {
     INSTRUCTION_WRITE = 0x02,
 };
 
-sim_mem_t* eeprom;
-pthread_mutex_t eeprom_mutex;
+SIM_THREAD_LOCAL sim_mem_t* eeprom;
+SIM_THREAD_LOCAL pthread_mutex_t eeprom_mutex;
 
-static struct {
+static SIM_THREAD_LOCAL struct {
     uint8_t status;
     uint8_t instr;
     eeprom_t address;
@@ -63,6 +63,8 @@ static struct {
 
 
 void sim_eeprom_init(void) {
+    // the simulator may be initialized again without being deinitialized in between.
+    sim_eeprom_free();
     eeprom = sim_mem_init(EEPROM_SIZE, ERASE_BYTE);
     // in simulation, EEPROM always starts at address 0, but has the correct size.
     sys_eeprom_set_location(0, EEPROM_SIZE);
@@ -82,14 +84,51 @@ void sim_eeprom_load(const char* filename) {
 }
 
 void sim_eeprom_save(void) {
+    // the queued write is saved too.
+    sys_eeprom_flush();
     pthread_mutex_lock(&eeprom_mutex);
     sim_mem_save(eeprom);
     pthread_mutex_unlock(&eeprom_mutex);
 }
 
+/**
+ * Read data from the current address until the end of a transfer,
+ * wrapping around at the end of the EEPROM like the real EEPROM device.
+ */
+static void read_data(uint8_t* data, size_t length) {
+    while (length > 0) {
+        size_t chunk = SYS_EEPROM_SIZE - spi_eeprom.address;
+        if (chunk > length) {
+            chunk = length;
+        }
+        sim_mem_read(eeprom, spi_eeprom.address, chunk, data);
+        spi_eeprom.address = (spi_eeprom.address + chunk) % SYS_EEPROM_SIZE;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+/**
+ * Write data at the current address until the end of a transfer, wrapping around within the page.
+ */
+static void write_data(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        size_t chunk = PAGE_MASK + 1 - (spi_eeprom.address & PAGE_MASK);
+        if (chunk > length) {
+            chunk = length;
+        }
+        sim_mem_write(eeprom, spi_eeprom.address, chunk, data);
+        spi_eeprom.address = (spi_eeprom.address & ~PAGE_MASK) |
+                             ((spi_eeprom.address + chunk) & PAGE_MASK);
+        data += chunk;
+        length -= chunk;
+    }
+}
+
 void sim_eeprom_spi_transceive(size_t length, uint8_t data[static length]) {
     pthread_mutex_lock(&eeprom_mutex);
     if (!eeprom) {
+        pthread_mutex_unlock(&eeprom_mutex);
         return;
     }
 
@@ -102,6 +141,19 @@ void sim_eeprom_spi_transceive(size_t length, uint8_t data[static length]) {
             spi_eeprom.instr = b;
         }
 
+        if (pos >= 3 && (spi_eeprom.instr == INSTRUCTION_READ ||
+                         spi_eeprom.instr == INSTRUCTION_WRITE)) {
+            // after the address, the rest of a read or write is handled at once.
+            const size_t count = length - i;
+            if (spi_eeprom.instr == INSTRUCTION_READ) {
+                read_data(&data[i], count);
+            } else if (spi_eeprom.writing) {
+                write_data(&data[i], count);
+            }
+            spi_eeprom.pos += count;
+            break;
+        }
+
         switch (spi_eeprom.instr) {
             case INSTRUCTION_WREN: {
                 spi_eeprom.status |= STATUS_WREN_MASK;
@@ -129,9 +181,6 @@ void sim_eeprom_spi_transceive(size_t length, uint8_t data[static length]) {
                 } else if (pos == 2) {
                     spi_eeprom.address |= b;
                     spi_eeprom.address %= SYS_EEPROM_SIZE;
-                } else if (pos >= 3) {
-                    data[i] = eeprom->data[spi_eeprom.address];
-                    spi_eeprom.address = (spi_eeprom.address + 1) % SYS_EEPROM_SIZE;
                 }
                 break;
             }
@@ -145,10 +194,6 @@ void sim_eeprom_spi_transceive(size_t length, uint8_t data[static length]) {
                 } else if (pos == 2) {
                     spi_eeprom.address |= b;
                     spi_eeprom.address %= SYS_EEPROM_SIZE;
-                } else if (spi_eeprom.writing) {
-                    eeprom->data[spi_eeprom.address] = b;
-                    spi_eeprom.address = (spi_eeprom.address & ~PAGE_MASK) |
-                                         ((spi_eeprom.address + 1) & PAGE_MASK);
                 }
                 break;
             }
@@ -23,6 +23,8 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <memory.h>
 #include <pthread.h>
 
@@ -54,10 +56,10 @@ enum {
 
 static const uint8_t MANUFACTURER_ID[] = {0x1f, 0x85, 0x01};
 
-sim_mem_t* flash;
-pthread_mutex_t flash_mutex;
+SIM_THREAD_LOCAL sim_mem_t* flash;
+SIM_THREAD_LOCAL pthread_mutex_t flash_mutex;
 
-static struct {
+static SIM_THREAD_LOCAL struct {
     uint8_t status;
     uint8_t instr;
     flash_t address;
@@ -65,25 +67,81 @@ static struct {
     bool writing;
     bool reset_enabled;
     bool power_down;
+    bool ignored;
 } spi_flash;
 
+#ifdef SPI_MONITOR
+static SIM_THREAD_LOCAL struct {
+    // bytes read and cycles attributed per flash address.
+    uint32_t* bytes;
+    uint32_t* cycles;
+    flash_t last_address;
+} read_stats;
+#endif
+
 void sim_flash_init(void) {
+    // the simulator may be initialized again without being deinitialized in between.
+    sim_flash_free();
     flash = sim_mem_init(SYS_FLASH_SIZE, ERASE_BYTE);
+    memset(&spi_flash, 0, sizeof spi_flash);
+    sys_flash_write_pending = false;
+#ifdef SPI_MONITOR
+    read_stats.bytes = calloc(SYS_FLASH_SIZE, sizeof *read_stats.bytes);
+    read_stats.cycles = calloc(SYS_FLASH_SIZE, sizeof *read_stats.cycles);
+#endif
 }
 
 void sim_flash_free(void) {
     pthread_mutex_lock(&flash_mutex);
     sim_mem_free(flash);
     flash = 0;
+#ifdef SPI_MONITOR
+    free(read_stats.bytes);
+    free(read_stats.cycles);
+    read_stats.bytes = 0;
+    read_stats.cycles = 0;
+#endif
     pthread_mutex_unlock(&flash_mutex);
 }
 
+#ifdef SPI_MONITOR
+void sim_flash_add_read_cycles(uint32_t cycles) {
+    if (read_stats.cycles) {
+        read_stats.cycles[read_stats.last_address] += cycles;
+    }
+}
+
+void sim_flash_save_read_stats(uint32_t frames) {
+    if (!read_stats.bytes || frames == 0) {
+        return;
+    }
+    FILE* file = fopen(SIM_FLASH_READS_FILE, "w");
+    if (!file) {
+        trace("could not open flash reads file");
+        return;
+    }
+    fprintf(file, "address,bytes_per_frame,cycles_per_frame\n");
+    for (flash_t addr = 0; addr < SYS_FLASH_SIZE; ++addr) {
+        if (read_stats.bytes[addr] != 0 || read_stats.cycles[addr] != 0) {
+            fprintf(file, "0x%06x,%.3f,%.1f\n", (unsigned) addr,
+                    (double) read_stats.bytes[addr] / frames,
+                    (double) read_stats.cycles[addr] / frames);
+        }
+    }
+    fclose(file);
+    trace("flash reads for %u frames saved to " SIM_FLASH_READS_FILE, frames);
+}
+#endif
+
 void sim_flash_load(const char* filename) {
     pthread_mutex_lock(&flash_mutex);
     sim_mem_load(flash, filename);
     pthread_mutex_unlock(&flash_mutex);
-    // in simulation, flash always starts at address 0
+    // in simulation, flash always starts at address 0,
+    // and the data space is placed right before the frame cache.
     sys_flash_set_offset(0);
+    sys_flash_set_space_location(SYS_FLASH_FRAME_CACHE_ADDR - FLASH_RESERVED_SPACE,
+                                 FLASH_RESERVED_SPACE / FLASH_SECTOR_SIZE);
 }
 
 void sim_flash_save(void) {
@@ -92,9 +150,56 @@ void sim_flash_save(void) {
     pthread_mutex_unlock(&flash_mutex);
 }
 
+/**
+ * Read data from the current address until the end of a transfer,
+ * wrapping around at the end of the flash like the real flash device.
+ */
+static void read_data(uint8_t* data, size_t length) {
+    while (length > 0) {
+        size_t chunk = SYS_FLASH_SIZE - spi_flash.address;
+        if (chunk > length) {
+            chunk = length;
+        }
+        sim_mem_read(flash, spi_flash.address, chunk, data);
+#ifdef SPI_MONITOR
+        if (read_stats.bytes) {
+            for (size_t i = 0; i < chunk; ++i) {
+                ++read_stats.bytes[spi_flash.address + i];
+            }
+            read_stats.last_address = spi_flash.address + chunk - 1;
+        }
+#endif
+        spi_flash.address = (spi_flash.address + chunk) % SYS_FLASH_SIZE;
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+/**
+ * Program data at the current address until the end of a transfer, wrapping around
+ * within the page. Data is ANDed with existing data like the real flash device.
+ */
+static void program_data(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        size_t chunk = PAGE_MASK + 1 - (spi_flash.address & PAGE_MASK);
+        if (chunk > length) {
+            chunk = length;
+        }
+        uint8_t* dst = &flash->data[spi_flash.address];
+        for (size_t i = 0; i < chunk; ++i) {
+            dst[i] &= data[i];
+        }
+        spi_flash.address = (spi_flash.address & ~PAGE_MASK) |
+                            ((spi_flash.address + chunk) & PAGE_MASK);
+        data += chunk;
+        length -= chunk;
+    }
+}
+
 void sim_flash_spi_transceive(size_t length, uint8_t data[static length]) {
     pthread_mutex_lock(&flash_mutex);
     if (!flash) {
+        pthread_mutex_unlock(&flash_mutex);
         return;
     }
 
@@ -102,16 +207,41 @@ void sim_flash_spi_transceive(size_t length, uint8_t data[static length]) {
         uint8_t b = data[i];
         size_t pos = spi_flash.pos;
 
+        if (spi_flash.ignored) {
+            // the data output isn't driven, the data read is undefined.
+            memset(&data[i], 0, length - i);
+            break;
+        }
+
         if (spi_flash.instr == 0 && pos == 0) {
             if (spi_flash.power_down && b != INSTRUCTION_POWER_DOWN_DISABLE) {
                 // flash is in deep power-down, all commands ignored except wakeup.
                 trace("instruction 0x%02x ignored in power-down mode.", b);
-                return;
+                break;
+            }
+            if ((spi_flash.status & STATUS_BUSY_MASK) && b == INSTRUCTION_READ) {
+                // flash is programming or erasing, reads are ignored until the status was read.
+                trace("flash read ignored while busy.");
+                spi_flash.ignored = true;
+                continue;
             }
             // set new instruction
             spi_flash.instr = b;
         }
 
+        if (pos >= 4 && (spi_flash.instr == INSTRUCTION_READ ||
+                         spi_flash.instr == INSTRUCTION_WRITE)) {
+            // after the address, the rest of a read or page program is handled at once.
+            const size_t count = length - i;
+            if (spi_flash.instr == INSTRUCTION_READ) {
+                read_data(&data[i], count);
+            } else if (spi_flash.writing) {
+                program_data(&data[i], count);
+            }
+            spi_flash.pos += count;
+            break;
+        }
+
         switch (spi_flash.instr) {
             case INSTRUCTION_READ: {
                 if (pos == 1) {
@@ -121,9 +251,6 @@ void sim_flash_spi_transceive(size_t length, uint8_t data[static length]) {
                 } else if (pos == 3) {
                     spi_flash.address |= b;
                     spi_flash.address %= SYS_FLASH_SIZE;
-                } else if (pos >= 4) {
-                    data[i] = flash->data[spi_flash.address];
-                    spi_flash.address = (spi_flash.address + 1) % SYS_FLASH_SIZE;
                 }
                 break;
             }
@@ -139,11 +266,6 @@ void sim_flash_spi_transceive(size_t length, uint8_t data[static length]) {
                 } else if (pos == 3) {
                     spi_flash.address |= b;
                     spi_flash.address %= SYS_FLASH_SIZE;
-                } else if (spi_flash.writing) {
-                    // data AND with existing data like the real flash device.
-                    flash->data[spi_flash.address] &= b;
-                    spi_flash.address = (spi_flash.address & ~PAGE_MASK) |
-                                        ((spi_flash.address + 1) & PAGE_MASK);
                 }
                 break;
             }
@@ -195,7 +317,8 @@ void sim_flash_spi_transceive(size_t length, uint8_t data[static length]) {
                 break;
             }
             case INSTRUCTION_READ_STATUS: {
-                if (pos == 1) {
+                if (pos >= 1) {
+                    // status is output continuously until the CS line is released.
                     data[i] = spi_flash.status;
                     // after write, status will read as busy once, then ready.
                     spi_flash.status &= ~STATUS_BUSY_MASK;
@@ -251,4 +374,5 @@ void sim_flash_spi_reset(void) {
     spi_flash.address = 0;
     spi_flash.pos = 0;
     spi_flash.writing = false;
+    spi_flash.ignored = false;
 }
@@ -22,6 +22,7 @@
 #include <sim/led.h>
 #include <sim/power.h>
 #include <sim/init.h>
+#include <sim/cycles.h>
 
 #include <core/display.h>
 #include <core/trace.h>
@@ -32,6 +33,10 @@
 
 #define PI 3.141592654f
 
+#define WINDOW_TITLE "Game console simulator"
+// number of redisplays between frame time updates in the window title.
+#define FRAME_TIME_PERIOD DISPLAY_FPS
+
 #define LED_SEGMENTS 30
 #define LED_RADIUS 7.5f
 
@@ -122,8 +127,23 @@ static void callback_mouse(int button, int state, int x, int y) {
     }
 }
 
+static void update_frame_time(void) {
+    // show the real frame time next to the one estimated for the game console.
+    double real, estimated;
+    if (sim_cycles_take_frame_times(&real, &estimated)) {
+        char title[96];
+        snprintf(title, sizeof title, WINDOW_TITLE " - frame %.1f ms (device est. %.1f ms)",
+                 real * 1000.0, estimated * 1000.0);
+        glutSetWindowTitle(title);
+    }
+}
+
 static void callback_redisplay_timer(int arg) {
-    glutTimerFunc((unsigned int) (1000.0 / DISPLAY_FPS + 0.5), callback_redisplay_timer, 0);
+    glutTimerFunc((unsigned int) (1000.0 / DISPLAY_FPS + 0.5), callback_redisplay_timer,
+                  (arg + 1) % FRAME_TIME_PERIOD);
+    if (arg == 0) {
+        update_frame_time();
+    }
     glutPostRedisplay();
 }
 
@@ -135,7 +155,7 @@ void glut_init(void) {
     // double buffered, RGB display.
     glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE);
     glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
-    glutCreateWindow("Game console simulator");
+    glutCreateWindow(WINDOW_TITLE);
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
     glutDisplayFunc(callback_display);
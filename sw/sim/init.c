@@ -24,17 +24,28 @@
 #include <sys/led.h>
 #include <sys/spi.h>
 #include <sys/display.h>
+#include <sys/eeprom.h>
 
 #include <sim/time.h>
 #include <sim/sound.h>
 #include <sim/flash.h>
 #include <sim/eeprom.h>
 #include <sim/uart.h>
+#include <sim/spi.h>
+#include <sim/display.h>
+#include <sim/profile.h>
+
+#include <stdlib.h>
 
 void sys_init(void) {
     sim_time_init();
     sim_sound_init();
 
+    const char* capture_filename = getenv(SIM_DISPLAY_CAPTURE_ENV);
+    if (capture_filename) {
+        sim_display_start_capture(capture_filename);
+    }
+
     sim_eeprom_init();
     sim_flash_init();
 
@@ -43,6 +54,8 @@ void sys_init(void) {
 }
 
 void sys_init_sleep(void) {
+    sys_eeprom_flush();
+
     // disable all peripherals to reduce current consumption
     sim_time_stop();
     sys_power_set_15v_reg_enabled(false);
@@ -56,12 +69,14 @@ void sys_init_sleep(void) {
 }
 
 void sys_init_wakeup(void) {
+    // start checking battery level, in parallel with the display initialization.
+    sys_power_start_sampling();
+    sys_flash_wakeup();
+
     // initialize display
     sys_display_init();
     sys_display_clear(DISPLAY_COLOR_BLACK);
 
-    // check battery level
-    sys_power_start_sampling();
     sys_power_wait_for_sample();
     // note: at this point display color is 0, so load should be about 0 too.
     // the first measurement isn't terribly precise, it's mostly an undervoltage protection.
@@ -79,11 +94,18 @@ void sys_init_wakeup(void) {
     // initialize sound output
     sys_sound_set_output_enabled(true);
     sim_sound_open_stream();
-
-    sys_flash_wakeup();
 }
 
 void sim_deinit(void) {
+#ifdef SPI_MONITOR
+    sim_spi_save_stats();
+#endif
+#ifdef DISPLAY_MONITOR
+    sim_display_save_stats();
+#endif
+#ifdef FUNCTION_PROFILE
+    sim_profile_save();
+#endif
 #ifdef SYS_UART_ENABLE
     sim_uart_end();
 #endif
@@ -20,6 +20,9 @@
 
 #include <sys/power.h>
 #include <sys/display.h>
+#include <sys/input.h>
+
+#include <sys/time.h>
 
 #include <sim/input.h>
 #include <sim/power.h>
@@ -30,15 +33,47 @@
 
 #include <GL/glut.h>
 
+#include <stdio.h>
+#include <stdlib.h>
+
 #define SPECIAL_MASK 0x80000000
 
 #define INACTIVITY_COUNTDOWN_START (SYS_POWER_INACTIVE_COUNTDOWN_SLEEP - SYS_POWER_SLEEP_COUNTDOWN)
 #define INACTIVITY_COUNTDOWN_DIM (SYS_POWER_INACTIVE_COUNTDOWN_DIM - SYS_POWER_SLEEP_COUNTDOWN)
 
-static uint8_t state;
-static uint8_t curr_state;
-static uint8_t last_state;
-static uint8_t inactive_countdown;
+static SIM_THREAD_LOCAL uint8_t state;
+static SIM_THREAD_LOCAL uint8_t curr_state;
+static SIM_THREAD_LOCAL uint8_t last_state;
+static SIM_THREAD_LOCAL uint8_t inactive_countdown;
+
+// input event queue, filled on each systick like on the device.
+static SIM_THREAD_LOCAL struct {
+    input_event_t events[INPUT_EVENT_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t tail;
+    // input state when the last event was queued.
+    uint8_t state;
+} input_queue;
+
+typedef struct {
+    uint32_t tick;
+    uint8_t state;
+} input_log_event_t;
+
+// When recording or replaying, the input state is sampled on each systick, so that the app
+// sees the same state at the same time on every run, like the debounced state on the device.
+static SIM_THREAD_LOCAL struct {
+    FILE* record_file;
+    bool replaying;
+    input_log_event_t* events;
+    size_t event_count;
+    size_t event_pos;
+    uint16_t* seeds;
+    size_t seed_count;
+    size_t seed_pos;
+    uint32_t systick;
+    uint8_t state;
+} input_log;
 
 static void reset_inactive_countdown(void) {
     if (inactive_countdown == 0) {
@@ -53,6 +88,12 @@ static void on_input_change(void) {
 }
 
 #ifndef SIMULATION_HEADLESS
+static void on_key_change(void) {
+    if (!input_log.replaying) {
+        on_input_change();
+    }
+}
+
 static void save_display(void) {
     FILE* file = fopen("screenshot.png", "wb");
     sim_display_save(file);
@@ -94,7 +135,7 @@ static uint8_t get_key_state_mask(unsigned int key) {
 
 static void input_on_key_down(unsigned char key, int x, int y) {
     state |= get_key_state_mask(key);
-    on_input_change();
+    on_key_change();
 
     if (key == 'p') {
         save_display();
@@ -117,21 +158,85 @@ static void input_on_key_down(unsigned char key, int x, int y) {
 
 static void input_on_key_up(unsigned char key, int x, int y) {
     state &= ~get_key_state_mask(key);
-    on_input_change();
+    on_key_change();
 }
 
 static void input_on_key_down_special(int key, int x, int y) {
     state |= get_key_state_mask(key | SPECIAL_MASK);
-    on_input_change();
+    on_key_change();
 }
 
 static void input_on_key_up_special(int key, int x, int y) {
     state &= ~get_key_state_mask(key | SPECIAL_MASK);
-    on_input_change();
+    on_key_change();
 }
 #endif //SIMULATION_HEADLESS
 
+void sim_input_record(const char* filename) {
+    input_log.record_file = fopen(filename, "w");
+    if (!input_log.record_file) {
+        trace("could not open input log file '%s'", filename);
+        return;
+    }
+    input_log.state = state;
+    fprintf(input_log.record_file, "i 0 %02x\n", state);
+    trace("recording input to '%s'", filename);
+}
+
+void sim_input_replay(const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        trace("could not open input log file '%s'", filename);
+        return;
+    }
+    // read all events, in the order they were recorded.
+    size_t event_capacity = 0;
+    size_t seed_capacity = 0;
+    char type;
+    unsigned int tick, value;
+    while (fscanf(file, " %c %u %x", &type, &tick, &value) == 3) {
+        if (type == 'i') {
+            if (input_log.event_count == event_capacity) {
+                event_capacity = event_capacity ? event_capacity * 2 : 256;
+                input_log.events = realloc(input_log.events,
+                                           event_capacity * sizeof *input_log.events);
+            }
+            input_log.events[input_log.event_count++] = (input_log_event_t) {tick, value};
+        } else if (type == 's') {
+            if (input_log.seed_count == seed_capacity) {
+                seed_capacity = seed_capacity ? seed_capacity * 2 : 16;
+                input_log.seeds = realloc(input_log.seeds,
+                                          seed_capacity * sizeof *input_log.seeds);
+            }
+            input_log.seeds[input_log.seed_count++] = value;
+        }
+    }
+    fclose(file);
+    input_log.replaying = true;
+    trace("replaying %zu input events from '%s'", input_log.event_count, filename);
+}
+
+uint16_t sim_input_log_seed(uint16_t seed) {
+    if (input_log.replaying) {
+        if (input_log.seed_pos < input_log.seed_count) {
+            seed = input_log.seeds[input_log.seed_pos++];
+        }
+    } else if (input_log.record_file) {
+        fprintf(input_log.record_file, "s %u %04x\n", input_log.systick, seed);
+        fflush(input_log.record_file);
+    }
+    return seed;
+}
+
 void sim_input_init(void) {
+    const char* record_filename = getenv("SIM_INPUT_RECORD");
+    const char* replay_filename = getenv("SIM_INPUT_REPLAY");
+    if (replay_filename) {
+        sim_input_replay(replay_filename);
+    } else if (record_filename) {
+        sim_input_record(record_filename);
+    }
+
 #ifndef SIMULATION_HEADLESS
     glutKeyboardFunc(input_on_key_down);
     glutKeyboardUpFunc(input_on_key_up);
@@ -141,9 +246,30 @@ void sim_input_init(void) {
 #endif //SIMULATION_HEADLESS
 }
 
+static uint8_t get_sampled_state(void) {
+    return input_log.record_file || input_log.replaying ? input_log.state : state;
+}
+
+static void queue_event(void) {
+    const uint8_t new_state = get_sampled_state();
+    const uint8_t changed = new_state ^ input_queue.state;
+    if (changed == 0) {
+        return;
+    }
+    const uint8_t next = (input_queue.head + 1) & (INPUT_EVENT_QUEUE_SIZE - 1);
+    if (next == input_queue.tail) {
+        // queue is full, drop the event.
+        return;
+    }
+    input_queue.events[input_queue.head] = (input_event_t) {
+            sys_time_get(), changed & new_state, changed & ~new_state};
+    input_queue.head = next;
+    input_queue.state = new_state;
+}
+
 void sys_input_latch(void) {
     last_state = curr_state;
-    curr_state = state;
+    curr_state = get_sampled_state();
 }
 
 uint8_t sys_input_get_state(void) {
@@ -154,13 +280,47 @@ uint8_t sys_input_get_last_state(void) {
     return last_state;
 }
 
+bool sys_input_get_event(input_event_t* event) {
+    if (input_queue.tail == input_queue.head) {
+        return false;
+    }
+    *event = input_queue.events[input_queue.tail];
+    input_queue.tail = (input_queue.tail + 1) & (INPUT_EVENT_QUEUE_SIZE - 1);
+    return true;
+}
+
+void sys_input_clear_events(void) {
+    input_queue.tail = input_queue.head;
+}
+
 void sys_input_update_state(void) {
-    // no-op, glut callbacks are used instead.
+    // glut callbacks are used to update the state, it's only sampled here for the input log.
+    if (input_log.replaying) {
+        const uint8_t last = input_log.state;
+        while (input_log.event_pos < input_log.event_count &&
+               input_log.events[input_log.event_pos].tick <= input_log.systick) {
+            input_log.state = input_log.events[input_log.event_pos++].state;
+            if (input_log.event_pos == input_log.event_count) {
+                trace("input replay done");
+            }
+        }
+        if (input_log.state != last) {
+            on_input_change();
+        }
+    } else if (input_log.record_file && input_log.state != state) {
+        input_log.state = state;
+        fprintf(input_log.record_file, "i %u %02x\n", input_log.systick, state);
+        fflush(input_log.record_file);
+    }
+    queue_event();
+    ++input_log.systick;
 }
 
 void sys_input_update_state_immediate(void) {
     sys_input_latch();
     // no debouncing so nothing to do about that here.
+    input_queue.state = curr_state;
+    sys_input_clear_events();
 }
 
 void sys_input_dim_if_inactive(void) {
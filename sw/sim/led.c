@@ -16,11 +16,12 @@
 
 #include <sys/led.h>
 #include <core/led.h>
+#include <core/defs.h>
 #include <stdbool.h>
 
-static bool led_on;
-static uint8_t blink_period;
-static uint8_t blink_counter;
+static SIM_THREAD_LOCAL bool led_on;
+static SIM_THREAD_LOCAL uint8_t blink_period;
+static SIM_THREAD_LOCAL uint8_t blink_counter;
 
 void sys_led_set(void) {
     led_on = true;
@@ -24,95 +24,114 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <malloc.h>
-
-#define READ_BUFFER_SIZE 8192
-#define WRITE_BUFFER_SIZE 8192
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static bool map_anonymous(sim_mem_t* mem) {
+    void* data = mmap(0, mem->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    memset(data, mem->initial, mem->size);
+    mem->data = data;
+    mem->mapped_size = 0;
+    return true;
+}
 
 sim_mem_t* sim_mem_init(size_t size, uint8_t initial) {
-    size_t mem_size = sizeof(sim_mem_t) + size;
-    sim_mem_t* mem = malloc(mem_size);
+    sim_mem_t* mem = malloc(sizeof(sim_mem_t));
     if (mem == 0) {
         trace("out of memory");
         return 0;
     }
-    memset(mem, initial, mem_size);
     mem->size = size;
     mem->initial = initial;
     mem->filename = 0;
+    if (!map_anonymous(mem)) {
+        trace("out of memory");
+        free(mem);
+        return 0;
+    }
     return mem;
 }
 
 void sim_mem_load(sim_mem_t* mem, const char* filename) {
     mem->filename = filename;
-    FILE* file = fopen(filename, "rb");
-    if (!file || ferror(file)) {
-        trace("could not read memory file '%s'", filename);
-        return;
+    if (mem->mapped_size != 0) {
+        // memory was already loaded from a file, start over with erased memory.
+        munmap(mem->data, mem->size);
+        if (!map_anonymous(mem)) {
+            trace("out of memory");
+            return;
+        }
+    } else {
+        memset(mem->data, mem->initial, mem->size);
     }
 
-    uint8_t* ptr = mem->data;
-    while (true) {
-        size_t n = READ_BUFFER_SIZE;
-        if (ptr + n >= mem->data + mem->size) {
-            n = (size_t) (mem->size - (ptrdiff_t) ptr + mem->data);
-        }
-        size_t read = fread(ptr, 1, n, file);
-        ptr += read;
-        if (read < READ_BUFFER_SIZE) {
-            // end of file reached, short count.
-            break;
+    int fd = open(filename, O_RDWR);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        trace("could not read memory file '%s'", filename);
+        if (fd >= 0) {
+            close(fd);
         }
-        if (ptr >= mem->data + mem->size) {
-            // end of memory reached.
-            break;
+        return;
+    }
+    const size_t file_size = (size_t) st.st_size < mem->size ? (size_t) st.st_size : mem->size;
+
+    // map the full pages of the file over the start of memory. The mapping stays valid
+    // after the file is closed, and changes are written back to the file by the kernel.
+    const size_t mapped_size = file_size - file_size % sysconf(_SC_PAGESIZE);
+    if (mapped_size != 0) {
+        if (mmap(mem->data, mapped_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            trace("could not map memory file '%s'", filename);
+            close(fd);
+            return;
         }
+        mem->mapped_size = mapped_size;
     }
 
-    // erase the rest of memory
-    memset(ptr, mem->initial, mem->size - (ptr - mem->data));
+    // read the rest of the file, which doesn't fill a page.
+    if (file_size > mapped_size &&
+        pread(fd, mem->data + mapped_size, file_size - mapped_size, (off_t) mapped_size) < 0) {
+        trace("could not read memory file '%s'", filename);
+    }
 
-    fclose(file);
+    close(fd);
 }
 
-
 void sim_mem_save(sim_mem_t* mem) {
     if (!mem->filename) {
         return;
     }
 
-    FILE* file = fopen(mem->filename, "wb");
-    if (!file || ferror(file)) {
-        return;
+    // write back the mapped part, only the pages that changed are written.
+    if (mem->mapped_size != 0) {
+        msync(mem->data, mem->mapped_size, MS_SYNC);
     }
 
-    // check up to which point to write.
+    // check up to which point to write the part that isn't mapped.
     // all the uninitialized part at the end is not written.
-    size_t write_size = 0;
-    for (size_t i = 0; i < mem->size; ++i) {
+    size_t write_size = mem->mapped_size;
+    for (size_t i = mem->mapped_size; i < mem->size; ++i) {
         if (mem->data[i] != mem->initial) {
             write_size = i + 1;
         }
     }
 
-    uint8_t* ptr = mem->data;
-    while (true) {
-        size_t n = WRITE_BUFFER_SIZE;
-        if (ptr + n >= mem->data + write_size) {
-            n = (size_t) (write_size - (ptrdiff_t) ptr + mem->data);
-        }
-        size_t written = fwrite(ptr, 1, n, file);
-        if (written < WRITE_BUFFER_SIZE) {
-            // short count, unknown error occured.
-            break;
-        }
-        ptr += written;
-        if (ptr >= mem->data + mem->size) {
-            // end of EEPROM reached.
-            break;
-        }
+    int fd = open(mem->filename, O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        return;
     }
-
-    fclose(file);
+    const size_t length = write_size - mem->mapped_size;
+    if (pwrite(fd, mem->data + mem->mapped_size, length, (off_t) mem->mapped_size) < 0 ||
+        ftruncate(fd, (off_t) write_size) != 0) {
+        trace("could not write memory file '%s'", mem->filename);
+    }
+    close(fd);
 }
 
 void sim_mem_read(sim_mem_t *mem, size_t address, size_t length, void* dest) {
@@ -134,5 +153,8 @@ void sim_mem_write(sim_mem_t *mem, size_t address, size_t length, const void* sr
 }
 
 void sim_mem_free(sim_mem_t* mem) {
-    free(mem);
+    if (mem) {
+        munmap(mem->data, mem->size);
+        free(mem);
+    }
 }
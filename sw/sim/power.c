@@ -28,6 +28,7 @@
 #include <sys/callback.h>
 #include <sys/power.h>
 
+#include <core/defs.h>
 #include <core/trace.h>
 
 #include <stdio.h>
@@ -41,17 +42,17 @@
 
 #define BATTERY_PERCENT_UNKNOWN 0xff
 
-static battery_status_t battery_status = BATTERY_DISCHARGING;
-static uint8_t battery_percent = 100;
-static bool reg_15v_enabled = false;
-static bool sleep_enabled = true;
-static bool sleep_scheduled = false;
+static SIM_THREAD_LOCAL battery_status_t battery_status = BATTERY_DISCHARGING;
+static SIM_THREAD_LOCAL uint8_t battery_percent = 100;
+static SIM_THREAD_LOCAL bool reg_15v_enabled = false;
+static SIM_THREAD_LOCAL bool sleep_enabled = true;
+static SIM_THREAD_LOCAL bool sleep_scheduled = false;
 
-static bool sleep_allow_wakeup;
-static sleep_cause_t sleep_cause;
-static uint8_t sleep_countdown;
+static SIM_THREAD_LOCAL bool sleep_allow_wakeup;
+static SIM_THREAD_LOCAL sleep_cause_t sleep_cause;
+static SIM_THREAD_LOCAL uint8_t sleep_countdown;
 
-static volatile atomic_bool sleeping = false;
+static SIM_THREAD_LOCAL volatile atomic_bool sleeping = false;
 
 void sys_power_start_sampling(void) {
     // no-op
@@ -162,6 +163,14 @@ bool sys_power_is_sleep_due(void) {
     return sleep_scheduled && sleep_countdown == 0;
 }
 
+void sys_power_skip_idle(void) {
+    // the simulator loop always waits a bit between loops, there's no idling.
+}
+
+void sys_power_idle(void) {
+    // see sys_power_skip_idle.
+}
+
 void sys_power_enable_sleep(void) {
     __callback_sleep();
 
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <sim/profile.h>
+
+#include <core/defs.h>
+#include <core/trace.h>
+
+#include <dlfcn.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifdef FUNCTION_PROFILE
+
+// number of entries in the function table, a power of two larger than the number of functions.
+#define FUNCTIONS_SIZE 4096
+// maximum call depth tracked, deeper calls are counted but their time goes to the caller.
+#define STACK_SIZE 256
+
+#define NO_INSTRUMENT __attribute__((no_instrument_function))
+
+typedef struct {
+    void* function;
+    uint64_t calls;
+    // time spent in the function itself, in nanoseconds.
+    uint64_t self_time;
+} function_stats_t;
+
+static SIM_THREAD_LOCAL struct {
+    // open addressing hash table of functions called.
+    function_stats_t functions[FUNCTIONS_SIZE];
+    // called functions, and time at which the function on top of the stack was last resumed.
+    function_stats_t* stack[STACK_SIZE];
+    uint16_t depth;
+    uint64_t resume_time;
+} profile;
+
+static NO_INSTRUMENT uint64_t get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static NO_INSTRUMENT function_stats_t* get_function_stats(void* function) {
+    uintptr_t i = (uintptr_t) function >> 2;
+    while (true) {
+        i &= FUNCTIONS_SIZE - 1;
+        function_stats_t* stats = &profile.functions[i];
+        if (stats->function == function) {
+            return stats;
+        } else if (!stats->function) {
+            stats->function = function;
+            return stats;
+        }
+        ++i;
+    }
+}
+
+// time since the function on top of the stack was resumed is added to that function.
+static NO_INSTRUMENT uint64_t pause_top(void) {
+    const uint64_t time = get_time();
+    if (profile.depth > 0 && profile.depth <= STACK_SIZE) {
+        profile.stack[profile.depth - 1]->self_time += time - profile.resume_time;
+    }
+    return time;
+}
+
+NO_INSTRUMENT void __cyg_profile_func_enter(void* function, void* call_site) {
+    const uint64_t time = pause_top();
+    function_stats_t* stats = get_function_stats(function);
+    ++stats->calls;
+    if (profile.depth < STACK_SIZE) {
+        profile.stack[profile.depth] = stats;
+    }
+    ++profile.depth;
+    profile.resume_time = time;
+}
+
+NO_INSTRUMENT void __cyg_profile_func_exit(void* function, void* call_site) {
+    const uint64_t time = pause_top();
+    if (profile.depth > 0) {
+        --profile.depth;
+    }
+    profile.resume_time = time;
+}
+
+void sim_profile_save(void) {
+    FILE* file = fopen(SIM_FUNCTION_PROFILE_FILE, "w");
+    if (!file) {
+        trace("could not open function profile file");
+        return;
+    }
+    fprintf(file, "offset,calls,self_time_us\n");
+    unsigned count = 0;
+    for (unsigned i = 0; i < FUNCTIONS_SIZE; ++i) {
+        const function_stats_t* stats = &profile.functions[i];
+        Dl_info info;
+        if (stats->function && dladdr(stats->function, &info) && info.dli_fbase) {
+            fprintf(file, "0x%lx,%lu,%.1f\n",
+                    (unsigned long) ((uintptr_t) stats->function - (uintptr_t) info.dli_fbase),
+                    (unsigned long) stats->calls, (double) stats->self_time / 1000);
+            ++count;
+        }
+    }
+    fclose(file);
+    trace("profile of %u functions saved to " SIM_FUNCTION_PROFILE_FILE, count);
+}
+
+#endif
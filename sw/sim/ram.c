@@ -1,4 +1,3 @@
-
 /*
  * Copyright 2022 Nicolas Maltais
  *
@@ -15,13 +14,19 @@
  * limitations under the License.
  */
 
-#ifndef TWORLD_DEFS_H
-#define TWORLD_DEFS_H
 
-#ifdef SIMULATION
-#define AVR_OPTIMIZE
-#else
-#define AVR_OPTIMIZE __attribute__((optimize("O3")))
-#endif
+#include <sys/ram.h>
+
+// there's no stack to measure in simulation, the host stack is used.
+
+void sys_ram_paint_stack(uint8_t* start) {
+    // no-op
+}
+
+uint16_t sys_ram_get_stack_high_water(void) {
+    return 0;
+}
 
-#endif //TWORLD_DEFS_H
+uint16_t sys_ram_get_stack_space(void) {
+    return 0;
+}
@@ -30,12 +30,30 @@
 
 static PaStream* stream;
 
+// flag used to synchronize access to the channels data.
+// the audio output stream callback is called from another thread,
+// and should not rely on OS mecanisms (mutexes).
+// http://www.portaudio.com/docs/v19-doxydocs/writing_a_callback.html
+static atomic_flag channels_lock;
+
+#define channels_lock_acquire() while (atomic_flag_test_and_set(&channels_lock))
+#define channels_lock_release() atomic_flag_clear(&channels_lock)
+
+#else
+#include <boot/sound.h>
+#include <core/time.h>
+
+// in headless mode, sound is only rendered from the thread calling sim_sound_render_wav.
+#define channels_lock_acquire()
+#define channels_lock_release()
+#endif //SIMULATION_HEADLESS
 
 // The sound playback in the simulator is made using PortAudio.
 // The sound_play_note callback is called by the sound module to update the state of each channel.
 // When the portaudio callback is called, the output buffer is filled with frames generated using
 // the current state of each channel. The phase of each channel square wave is updated each time
 // to allow the generation of a square wave of the correct frequency.
+// In headless mode, the same frames are generated offline instead, see sim_sound_render_wav.
 
 #define SAMPLE_RATE 44100
 
@@ -52,16 +70,8 @@ static const float CHANNEL_VOLUME_LEVELS[] = {
         1.0f,
 };
 
-// flag used to synchronize access to the channels data.
-// the audio output stream callback is called from another thread,
-// and should not rely on OS mecanisms (mutexes).
-// http://www.portaudio.com/docs/v19-doxydocs/writing_a_callback.html
-static atomic_flag channels_lock;
-
-#endif //SIMULATION_HEADLESS
-
-static sound_volume_t global_volume;
-static bool output_enabled;
+static SIM_THREAD_LOCAL sound_volume_t global_volume;
+static SIM_THREAD_LOCAL bool output_enabled;
 
 typedef struct {
     uint8_t note;
@@ -70,7 +80,7 @@ typedef struct {
     uint16_t phase;
 } channel_t;
 
-static channel_t channels[SYS_SOUND_CHANNELS];
+static SIM_THREAD_LOCAL channel_t channels[SYS_SOUND_CHANNELS];
 
 void sys_sound_set_output_enabled(bool enabled) {
     output_enabled = enabled;
@@ -103,13 +113,12 @@ sound_channel_volume_t sys_sound_get_channel_volume(uint8_t channel) {
 
 void sys_sound_play_note(uint8_t note, uint8_t channel) {
     // update channel fields for new note
-#ifndef SIMULATION_HEADLESS
     channel_t *ch = &channels[channel];
     if (note == ch->note) {
         // no change
         return;
     } else {
-        while (atomic_flag_test_and_set(&channels_lock));
+        channels_lock_acquire();
         ch->note = note;
         ch->phase = 0;
         if (note == SYS_SOUND_NO_NOTE) {
@@ -119,36 +128,22 @@ void sys_sound_play_note(uint8_t note, uint8_t channel) {
             float freq = 440 * powf(2.0f, (float) ((int) note - 33) / 12.0f);
             ch->samples_per_period = lroundf((float) SAMPLE_RATE / freq);
         }
-        atomic_flag_clear(&channels_lock);
+        channels_lock_release();
     }
-#endif //SIMULATION_HEADLESS
-}
-
-#ifndef SIMULATION_HEADLESS
-static bool handle_pa_error(PaError err) {
-    if (err != paNoError) {
-        trace("error occurred with the portaudio stream: [%d] %s", err, Pa_GetErrorText(err));
-        Pa_Terminate();
-        stream = 0;
-        return true;
-    }
-    return false;
 }
 
-static int patestCallback(const void* input_buffer, void* output_buffer,
-                          unsigned long frames_per_buffer,
-                          const PaStreamCallbackTimeInfo* time_info,
-                          PaStreamCallbackFlags status_flags,
-                          void* user_data) {
-    float* out = (float*) output_buffer;
+/**
+ * Generate a number of frames using the current state of each channel.
+ * The channels lock must be held.
+ */
+static void sim_sound_generate(float* out, size_t count) {
     const sound_volume_t vol = global_volume;
     if (vol == SOUND_VOLUME_OFF || !output_enabled) {
-        memset(out, 0, frames_per_buffer * sizeof(float));
-        return paContinue;
+        memset(out, 0, count * sizeof(float));
+        return;
     }
 
-    while (atomic_flag_test_and_set(&channels_lock));
-    for (size_t i = 0; i < frames_per_buffer; ++i) {
+    for (size_t i = 0; i < count; ++i) {
         // update the phase for all channels and count how many channels are on the
         // high side of the square wave.
         float level = 0;
@@ -171,8 +166,27 @@ static int patestCallback(const void* input_buffer, void* output_buffer,
         float sample = level / SYS_SOUND_CHANNELS * GLOBAL_VOLUME_LEVELS[vol];
         *out++ = sample;
     }
+}
+
+#ifndef SIMULATION_HEADLESS
+static bool handle_pa_error(PaError err) {
+    if (err != paNoError) {
+        trace("error occurred with the portaudio stream: [%d] %s", err, Pa_GetErrorText(err));
+        Pa_Terminate();
+        stream = 0;
+        return true;
+    }
+    return false;
+}
 
-    atomic_flag_clear(&channels_lock);
+static int patestCallback(const void* input_buffer, void* output_buffer,
+                          unsigned long frames_per_buffer,
+                          const PaStreamCallbackTimeInfo* time_info,
+                          PaStreamCallbackFlags status_flags,
+                          void* user_data) {
+    channels_lock_acquire();
+    sim_sound_generate((float*) output_buffer, frames_per_buffer);
+    channels_lock_release();
     return paContinue;
 }
 #endif //SIMULATION_HEADLESS
@@ -188,6 +202,7 @@ void sim_sound_init(void) {
 
     for (int i = 0; i < SYS_SOUND_CHANNELS; ++i) {
         channels[i].volume = 1;
+        channels[i].note = SYS_SOUND_NO_NOTE;
     }
 }
 
@@ -243,3 +258,67 @@ void sim_sound_close_stream(void) {
 bool sim_sound_is_output_enabled(void) {
     return output_enabled;
 }
+
+#ifdef SOUND_MONITOR
+uint16_t sys_sound_take_isr_count(void) {
+    // there are no channel timer interrupts in simulation.
+    return 0;
+}
+#endif
+
+#ifdef SIMULATION_HEADLESS
+
+static void write_le(FILE* file, uint32_t value, uint8_t size) {
+    while (size--) {
+        fputc((int) (value & 0xff), file);
+        value >>= 8;
+    }
+}
+
+bool sim_sound_render_wav(const char* filename, uint32_t ticks) {
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        trace("could not open sound output file");
+        return false;
+    }
+
+    // number of frames rendered per tick isn't an integer, the remainder carries over.
+    const uint32_t total_frames = (uint32_t) ((uint64_t) ticks * SAMPLE_RATE / SYSTICK_FREQUENCY);
+    const uint32_t data_size = total_frames * 2;
+
+    // WAV header, mono 16-bit PCM.
+    fwrite("RIFF", 1, 4, file);
+    write_le(file, 36 + data_size, 4);
+    fwrite("WAVEfmt ", 1, 8, file);
+    write_le(file, 16, 4);
+    write_le(file, 1, 2);
+    write_le(file, 1, 2);
+    write_le(file, SAMPLE_RATE, 4);
+    write_le(file, SAMPLE_RATE * 2, 4);
+    write_le(file, 2, 2);
+    write_le(file, 16, 2);
+    fwrite("data", 1, 4, file);
+    write_le(file, data_size, 4);
+
+    float samples[SAMPLE_RATE / SYSTICK_FREQUENCY + 1];
+    uint32_t frames_done = 0;
+    for (uint32_t tick = 1; tick <= ticks; ++tick) {
+        // step the sound module like the RTC interrupt, and fill buffers like the main loop would.
+        sys_sound_update();
+        if (sys_sound_refill_needed) {
+            sys_sound_fill_track_buffers();
+        }
+        const uint32_t frames_end = (uint32_t) ((uint64_t) tick * SAMPLE_RATE / SYSTICK_FREQUENCY);
+        const size_t count = frames_end - frames_done;
+        sim_sound_generate(samples, count);
+        for (size_t i = 0; i < count; ++i) {
+            write_le(file, (uint16_t) (int16_t) lroundf(samples[i] * INT16_MAX), 2);
+        }
+        frames_done = frames_end;
+    }
+
+    fclose(file);
+    return true;
+}
+
+#endif //SIMULATION_HEADLESS
@@ -19,10 +19,17 @@
 #include <sys/flash.h>
 #include <sys/eeprom.h>
 #include <sys/display.h>
+#include <sys/crc.h>
+
+#include <sim/cycles.h>
+#include <sim/flash.h>
+#include <sim/spi.h>
 
 #include <core/trace.h>
 
 #include <memory.h>
+#include <stdio.h>
+#include <string.h>
 
 typedef enum {
     DEVICE_NONE,
@@ -31,15 +38,108 @@ typedef enum {
     DEVICE_DISPLAY,
 } spi_device_t;
 
-spi_device_t selected_device;
+SIM_THREAD_LOCAL spi_device_t selected_device;
+
+static SIM_THREAD_LOCAL uint64_t flash_bytes;
+
+#ifdef SPI_MONITOR
+#define SPI_STATS_MAX_TAGS 32
+#define SPI_DEVICE_COUNT 3
+
+static const char* SPI_DEVICE_NAMES[SPI_DEVICE_COUNT] = {"flash", "eeprom", "display"};
+
+typedef struct {
+    const char* tag;
+    uint32_t transactions[SPI_DEVICE_COUNT];
+    uint64_t bytes[SPI_DEVICE_COUNT];
+} spi_tag_stats_t;
+
+static SIM_THREAD_LOCAL struct {
+    const char* tag;
+    spi_tag_stats_t tags[SPI_STATS_MAX_TAGS];
+    uint8_t tag_count;
+    uint32_t frame_count;
+} spi_stats;
+
+static spi_tag_stats_t* get_tag_stats(void) {
+    const char* tag = spi_stats.tag ? spi_stats.tag : "untagged";
+    for (uint8_t i = 0; i < spi_stats.tag_count; ++i) {
+        if (strcmp(spi_stats.tags[i].tag, tag) == 0) {
+            return &spi_stats.tags[i];
+        }
+    }
+    if (spi_stats.tag_count == SPI_STATS_MAX_TAGS) {
+        // all tags used, count with the last tag.
+        return &spi_stats.tags[SPI_STATS_MAX_TAGS - 1];
+    }
+    spi_tag_stats_t* stats = &spi_stats.tags[spi_stats.tag_count++];
+    stats->tag = tag;
+    return stats;
+}
+
+const char* sim_spi_set_tag(const char* tag) {
+    const char* last = spi_stats.tag;
+    spi_stats.tag = tag;
+    return last;
+}
+
+void sim_spi_restore_tag(const char** tag) {
+    spi_stats.tag = *tag;
+}
+
+void sim_spi_count_display(size_t length) {
+    // the display page is sent by the display driver, whatever the current tag is.
+    const char* last = sim_spi_set_tag("sys_display_next_page");
+    spi_tag_stats_t* stats = get_tag_stats();
+    ++stats->transactions[DEVICE_DISPLAY - DEVICE_FLASH];
+    stats->bytes[DEVICE_DISPLAY - DEVICE_FLASH] += length;
+    spi_stats.tag = last;
+}
+
+void sim_spi_end_frame(void) {
+    ++spi_stats.frame_count;
+}
+
+void sim_spi_save_stats(void) {
+    FILE* file = fopen(SIM_SPI_STATS_FILE, "w");
+    if (!file) {
+        trace("could not open SPI stats file");
+        return;
+    }
+    const uint32_t frames = spi_stats.frame_count;
+    fprintf(file, "device,tag,transactions,bytes,bytes_per_frame\n");
+    for (uint8_t i = 0; i < spi_stats.tag_count; ++i) {
+        const spi_tag_stats_t* stats = &spi_stats.tags[i];
+        for (uint8_t j = 0; j < SPI_DEVICE_COUNT; ++j) {
+            if (stats->transactions[j] == 0 && stats->bytes[j] == 0) {
+                continue;
+            }
+            fprintf(file, "%s,%s,%u,%lu,%.1f\n", SPI_DEVICE_NAMES[j], stats->tag,
+                    stats->transactions[j], (unsigned long) stats->bytes[j],
+                    frames ? (double) stats->bytes[j] / frames : 0.0);
+        }
+    }
+    fclose(file);
+    trace("SPI stats for %u frames saved to " SIM_SPI_STATS_FILE, frames);
+
+    sim_flash_save_read_stats(frames);
+}
+#endif
 
 void sys_spi_transceive(uint16_t length, uint8_t data[static length]) {
     if (length == 0) {
         trace("SPI transfer with zero length");
         return;
     }
+    sim_cycles_add_spi(length);
+#ifdef SPI_MONITOR
+    if (selected_device != DEVICE_NONE) {
+        get_tag_stats()->bytes[selected_device - DEVICE_FLASH] += length;
+    }
+#endif
     switch (selected_device) {
         case DEVICE_FLASH:
+            flash_bytes += length;
             sim_flash_spi_transceive(length, data);
             break;
         case DEVICE_EEPROM:
@@ -54,6 +154,19 @@ void sys_spi_transceive(uint16_t length, uint8_t data[static length]) {
     }
 }
 
+uint64_t sim_spi_get_flash_bytes(void) {
+    return flash_bytes;
+}
+
+uint16_t sys_spi_receive_crc(uint16_t length, uint8_t data[], uint16_t crc) {
+    memset(data, 0, length);
+    sys_spi_transceive(length, data);
+    for (uint16_t i = 0; i < length; ++i) {
+        crc = _crc_ccitt_update(crc, data[i]);
+    }
+    return crc;
+}
+
 void sys_spi_transmit(uint16_t length, const uint8_t data[static length]) {
     // copy data locally to use be able to transceive normally.
     uint8_t local_data[length];
@@ -75,6 +188,9 @@ static bool select_spi_device(spi_device_t device) {
         return false;
     }
     selected_device = device;
+#ifdef SPI_MONITOR
+    ++get_tag_stats()->transactions[device - DEVICE_FLASH];
+#endif
     return true;
 }
 
@@ -22,10 +22,13 @@
 #include <boot/sound.h>
 #include <boot/led.h>
 
+#include <string.h>
+
 #ifndef SIMULATION_HEADLESS
 
 #include <time.h>
 #include <math.h>
+#include <stdatomic.h>
 
 #endif
 
@@ -33,33 +36,47 @@
 #define SYSTICK_RATE (1.0 / SYSTICK_FREQUENCY)
 #define POWER_MONITOR_RATE 1.0
 
-static bool rtc_enabled;
-static bool power_monitor_enabled;
+static SIM_THREAD_LOCAL bool rtc_enabled;
+static SIM_THREAD_LOCAL bool power_monitor_enabled;
+
+static SIM_THREAD_LOCAL double last_time_update;
+static SIM_THREAD_LOCAL double last_power_monitor_update;
 
-static double last_time_update;
-static double last_power_monitor_update;
+#ifdef LOOP_MONITOR
+SIM_THREAD_LOCAL volatile uint8_t sys_loop_phase;
+static SIM_THREAD_LOCAL uint16_t loop_samples[SYS_LOOP_PHASE_COUNT];
+
+void sys_time_take_loop_samples(uint16_t samples[SYS_LOOP_PHASE_COUNT]) {
+    memcpy(samples, loop_samples, sizeof loop_samples);
+    memset(loop_samples, 0, sizeof loop_samples);
+}
+#endif
 
 static void sim_time_update_single(void) {
+#ifdef LOOP_MONITOR
+    ++loop_samples[sys_loop_phase];
+#endif
     sys_input_update_state();
     sys_sound_update();
     sys_led_blink_update();
 }
 
-void sim_time_update(void) {
-#ifdef SIMULATION_HEADLESS
-    sim_time_update_single();
-#else
+#ifndef SIMULATION_HEADLESS
+static void sim_time_update_elapsed(void) {
     const double time = sim_time_get();
 
     // RTC update
     // Of course the OS can't keep up at the 256 Hz rate, make up for any missed updates
     // by calling sim_time_update() multiple times.
     long systick_elapsed = (long) ((time - last_time_update) / SYSTICK_RATE);
+#ifndef SIMULATION_VIRTUAL_TIME
+    // (in virtual time, updates are never missed, they're only done late.)
     if (systick_elapsed > 10) {
         // If 10 updates were missed it's probably not normal, do a single update.
         systick_elapsed = 1;
         last_time_update = time - SYSTICK_RATE;
     }
+#endif
     if (systick_elapsed > 0) {
         while (systick_elapsed--) {
             if (rtc_enabled) {
@@ -76,7 +93,20 @@ void sim_time_update(void) {
         }
         last_power_monitor_update = time;
     }
+}
 #endif //SIMULATION_HEADLESS
+
+void sim_time_update(void) {
+#ifdef SIMULATION_HEADLESS
+    sim_time_update_single();
+#elif !defined(SIMULATION_VIRTUAL_TIME)
+    sim_time_update_elapsed();
+#endif
+    // in virtual time, updates are done by the loop thread when time advances.
+}
+
+void sys_time_set_tickless(bool enabled) {
+    // the tick rate isn't changed in simulation.
 }
 
 void sim_time_start(void) {
@@ -93,6 +123,45 @@ void sim_time_stop(void) {
 
 #ifndef SIMULATION_HEADLESS
 
+systime_t sys_time_get() {
+    return (systime_t) (lround(sim_time_get() * SYSTICK_FREQUENCY)) & SYSTICK_MAX;
+}
+
+systime_fine_t sys_time_get_fine(void) {
+    return (systime_fine_t) llround(sim_time_get() * SYSTIME_FINE_FREQUENCY);
+}
+
+static void sleep_real_time(uint32_t us) {
+    struct timespec remaining, request = {0, us * 1000};
+    nanosleep(&request, &remaining);
+}
+
+#ifdef SIMULATION_VIRTUAL_TIME
+
+// Virtual time only advances when the loop thread sleeps, so the simulation runs as fast as
+// the loop can. Systick updates are done by the loop thread, so they happen at the same
+// points of the loop on every run, whatever the host speed.
+static atomic_uint_fast64_t virtual_time_us;
+
+void sim_time_init(void) {
+    virtual_time_us = 0;
+}
+
+double sim_time_get(void) {
+    return (double) virtual_time_us / 1e6;
+}
+
+void sim_time_sleep(uint32_t us) {
+    virtual_time_us += us;
+    sim_time_update_elapsed();
+    if (!rtc_enabled) {
+        // the device is sleeping, wait for wakeup in real time.
+        sleep_real_time(us);
+    }
+}
+
+#else
+
 static struct timespec start_time;
 
 static double get_elapsed_time(const struct timespec* start, const struct timespec* end) {
@@ -100,10 +169,6 @@ static double get_elapsed_time(const struct timespec* start, const struct timesp
            (double) (end->tv_nsec - start->tv_nsec) / 1e9;
 }
 
-systime_t sys_time_get() {
-    return (systime_t) (lround(sim_time_get() * SYSTICK_FREQUENCY)) & SYSTICK_MAX;
-}
-
 void sim_time_init(void) {
     clock_gettime(CLOCK_MONOTONIC, &start_time);
 }
@@ -115,28 +180,33 @@ double sim_time_get(void) {
 }
 
 void sim_time_sleep(uint32_t us) {
-    struct timespec remaining, request = {0, us * 1000};
-    nanosleep(&request, &remaining);
+    sleep_real_time(us);
 }
 
+#endif //SIMULATION_VIRTUAL_TIME
+
 #else
 
-static systime_t systick;
+static SIM_THREAD_LOCAL uint64_t time_us;
 
 void sim_time_init(void) {
-    systick = 0;
+    time_us = 0;
 }
 
 systime_t sys_time_get() {
-    return systick & SYSTICK_MAX;
+    return (systime_t) (time_us * SYSTICK_FREQUENCY / 1000000) & SYSTICK_MAX;
+}
+
+systime_fine_t sys_time_get_fine(void) {
+    return (systime_fine_t) (time_us * SYSTIME_FINE_FREQUENCY / 1000000);
 }
 
 double sim_time_get(void) {
-    return ((double) systick / SYSTICK_FREQUENCY);
+    return (double) time_us / 1e6;
 }
 
 void sim_time_sleep(uint32_t us) {
-    systick += us;
+    time_us += us;
 }
 
 #endif //SIMULATION_HEADLESS
\ No newline at end of file
@@ -18,21 +18,38 @@
 #ifdef SYS_UART_ENABLE
 
 #include <sim/uart.h>
+#include <sim/time.h>
 #include <sys/uart.h>
 
 #include <core/trace.h>
 
 #include <stdio.h>
 #include <sys/socket.h>
-#include <sys/ioctl.h>
+#include <sys/epoll.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
 
 static const char* SOCKET_NAME = "/tmp/gcsim";
 
+// Data is buffered in both directions so that a packet takes a few system calls instead of
+// one per byte. Received data is limited to what the RX buffer on the game console can hold.
+#define RX_CAPACITY (SYS_UART_RX_BUFFER_SIZE - 1)
+#define TX_BUFFER_SIZE 256
+
 int socket_fd = -1;
 int connected_fd = -1;
+// epoll instance notified when new data is received on the connection (edge-triggered).
+static int epoll_fd = -1;
+// whether data was received since the connection was last checked.
+static bool received_data;
+
+static uint8_t rx_buffer[RX_CAPACITY];
+static uint16_t rx_pos;
+static uint16_t rx_len;
+
+static uint8_t tx_buffer[TX_BUFFER_SIZE];
+static uint16_t tx_len;
 
 void sys_uart_init(uint16_t baud_calc) {
     socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
@@ -61,34 +78,120 @@ void sys_uart_set_baud(uint16_t baud_calc) {
     trace("UART baud rate set to %d", baud_calc * 100);
 }
 
+static void tx_flush(void) {
+    const uint8_t* data = tx_buffer;
+    while (tx_len > 0 && connected_fd >= 0) {
+        const ssize_t sent = send(connected_fd, data, tx_len, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            // connection lost, data will be lost.
+            break;
+        }
+        data += sent;
+        tx_len -= sent;
+    }
+    tx_len = 0;
+}
+
+/**
+ * Receive data into the RX buffer until it's full or no more data is available,
+ * blocking until the buffer holds at least `min_len` bytes.
+ */
+static void rx_fill(uint16_t min_len) {
+    if (connected_fd < 0) {
+        return;
+    }
+    if (rx_pos > 0) {
+        memmove(rx_buffer, &rx_buffer[rx_pos], rx_len);
+        rx_pos = 0;
+    }
+    if (min_len > rx_len) {
+        // reading will block, the other side may be waiting for data written before.
+        tx_flush();
+    }
+    while (rx_len < RX_CAPACITY) {
+        const ssize_t count = recv(connected_fd, &rx_buffer[rx_len], RX_CAPACITY - rx_len,
+                                   rx_len < min_len ? 0 : MSG_DONTWAIT);
+        if (count <= 0) {
+            break;
+        }
+        rx_len += count;
+    }
+}
+
 void sys_uart_write(uint8_t c) {
     if (connected_fd < 0) {
         // data will be lost
         return;
     }
-    send(connected_fd, &c, 1, MSG_NOSIGNAL);
+    tx_buffer[tx_len++] = c;
+    if (tx_len == TX_BUFFER_SIZE) {
+        tx_flush();
+    }
+}
+
+void sys_uart_write_buffer(const uint8_t* data, uint8_t length, sys_uart_done_cb_t done) {
+    // written immediately, so the buffer can be modified as soon as this returns.
+    while (length--) {
+        sys_uart_write(*data++);
+    }
+    if (done) {
+        done();
+    }
+}
+
+void sys_uart_wait_buffer(void) {
+    // buffers are written immediately.
 }
 
 uint8_t sys_uart_read(void) {
-    if (connected_fd < 0) {
-        return 0;
+    if (rx_len == 0) {
+        rx_fill(1);
+        if (rx_len == 0) {
+            return 0;
+        }
     }
-    uint8_t c;
-    recv(connected_fd, &c, 1, MSG_WAITALL);
-    return c;
+    --rx_len;
+    return rx_buffer[rx_pos++];
 }
 
 bool sys_uart_available(void) {
-    if (connected_fd < 0) {
-        return false;
+    if (rx_len == 0) {
+        rx_fill(0);
+    }
+    return rx_len > 0;
+}
+
+uint8_t sys_uart_available_count(void) {
+    rx_fill(0);
+    return rx_len;
+}
+
+uint8_t sys_uart_peek(uint8_t offset) {
+    if (rx_len <= offset) {
+        rx_fill(offset + 1);
+        if (rx_len <= offset) {
+            return 0;
+        }
     }
-    int count;
-    ioctl(connected_fd, FIONREAD, &count);
-    return count > 0;
+    return rx_buffer[rx_pos + offset];
 }
 
 void sys_uart_flush(void) {
-    // no buffer, no-op
+    tx_flush();
+}
+
+static void close_connection(void) {
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+    if (connected_fd >= 0) {
+        close(connected_fd);
+        connected_fd = -1;
+    }
+    rx_pos = 0;
+    rx_len = 0;
+    tx_len = 0;
 }
 
 void sim_uart_listen(void) {
@@ -96,12 +199,18 @@ void sim_uart_listen(void) {
         return;
     }
 
-    if (connected_fd > 0) {
+    if (connected_fd >= 0) {
+        tx_flush();
+        if (received_data) {
+            // connection is alive, no need to check it.
+            received_data = false;
+            return;
+        }
         // check if socket connection is still alive by pinging with a 0x00 byte
         // this byte should be ignored by the client.
         uint8_t c = 0;
         if (send(connected_fd, &c, 1, MSG_DONTWAIT | MSG_NOSIGNAL) < 0 && errno != EAGAIN) {
-            connected_fd = -1;
+            close_connection();
             trace("UART server lost connection.");
             sim_uart_connection_lost_callback();
         } else {
@@ -110,16 +219,34 @@ void sim_uart_listen(void) {
     }
 
     connected_fd = accept(socket_fd, 0, 0);
-    if (connected_fd > 0) {
+    if (connected_fd >= 0) {
         trace("UART server established connection.");
+        epoll_fd = epoll_create1(0);
+        struct epoll_event event = {.events = EPOLLIN | EPOLLET};
+        if (epoll_fd >= 0 && epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connected_fd, &event) < 0) {
+            close(epoll_fd);
+            epoll_fd = -1;
+        }
     }
 }
 
-void sim_uart_end(void) {
-    if (connected_fd > 0) {
-        close(connected_fd);
+void sim_uart_sleep(uint32_t us) {
+#if !defined(SIMULATION_VIRTUAL_TIME) && !defined(SIMULATION_HEADLESS)
+    if (epoll_fd >= 0) {
+        tx_flush();
+        struct epoll_event event;
+        if (epoll_wait(epoll_fd, &event, 1, (int) ((us + 999) / 1000)) > 0) {
+            received_data = true;
+        }
+        return;
     }
-    if (socket_fd > 0) {
+#endif
+    sim_time_sleep(us);
+}
+
+void sim_uart_end(void) {
+    close_connection();
+    if (socket_fd >= 0) {
         close(socket_fd);
     }
 }
@@ -129,4 +256,4 @@ void sim_uart_connection_lost_callback(void) {
     // do nothing by default.
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -14,22 +14,56 @@
  * limitations under the License.
  */
 
-#ifdef BOOTLOADER
-
 #include <core/data.h>
 #include <core/flash.h>
+#include <sys/data.h>
+#include <sys/defs.h>
 
 #include <string.h>
 
+#ifdef BOOTLOADER
+
 #include <boot/defs.h>
 
 BOOTLOADER_NOINLINE
 void sys_data_read(data_ptr_t address, uint16_t length, uint8_t dest[static length]) {
     if (address & DATA_FLASH_MASK) {
-        flash_read((flash_t) (address & ~DATA_FLASH_MASK), length, dest);
+        sys_data_read_flash((flash_t) (address & ~DATA_FLASH_MASK), length, dest);
     } else {
         memcpy(dest, (const uint8_t*) (uintptr_t) address, length);
     }
 }
 
+BOOTLOADER_NOINLINE
+void sys_data_stream_open(data_ptr_t address) {
+    if (address & DATA_FLASH_MASK) {
+        flash_stream_open((flash_t) (address & ~DATA_FLASH_MASK));
+    }
+}
+
+BOOTLOADER_NOINLINE
+void sys_data_stream_read(data_ptr_t address, uint16_t length, uint8_t dest[]) {
+    if (address & DATA_FLASH_MASK) {
+        // the address is only needed for reading from other data spaces, flash is sequential.
+        flash_stream_read(length, dest);
+    } else {
+        memcpy(dest, (const uint8_t*) (uintptr_t) address, length);
+    }
+}
+
+BOOTLOADER_NOINLINE
+void sys_data_stream_close(data_ptr_t address) {
+    if (address & DATA_FLASH_MASK) {
+        flash_stream_close();
+    }
+}
+
 #endif  //BOOTLOADER
+
+ALWAYS_INLINE
+const uint8_t* sys_data_get_pointer(data_ptr_t address) {
+    if (address & DATA_FLASH_MASK) {
+        return 0;
+    }
+    return (const uint8_t*) (uintptr_t) address;
+}
@@ -15,21 +15,39 @@
  */
 
 #include <sys/display.h>
+#include <sys/data.h>
 #include <sys/spi.h>
+#include <sys/flash.h>
 #include <sys/defs.h>
 
+#include <avr/io.h>
+
 enum {
     STATE_DIMMED = 1 << 0,
     STATE_AVERAGING_COLOR = 1 << 1,
+    STATE_PARTIAL_REFRESH = 1 << 2,
+    STATE_PAGE_FILLED = 1 << 3,
+    STATE_START_LINE_CHANGED = 1 << 4,
+    // the page buffer is cleared with the fill block while sent, see sys_display_write_data_clear.
+    STATE_CLEAR_ON_SEND = 1 << 6,
+    // the page buffer already contains the fill block, only set along with STATE_PAGE_FILLED.
+    STATE_PAGE_CLEARED = 1 << 7,
 };
 
+ALWAYS_INLINE
+static void sys_display_set_dc(void) {
+    VPORTC.OUT |= PIN3_bm;
+}
+
 #ifdef BOOTLOADER
 
 #include <boot/defs.h>
 #include <boot/display.h>
 #include <boot/power.h>
 
-#include <avr/io.h>
+#include <core/time.h>
+#include <core/graphics.h>
+
 #include <util/delay.h>
 
 // Fundamental Command Table, p. 33
@@ -75,10 +93,25 @@ __attribute__((section(".disp_buf"))) uint8_t sys_display_buffer[];
 
 disp_y_t sys_display_page_height;
 disp_y_t sys_display_curr_page_height;
+disp_y_t sys_display_refresh_ystart;
+disp_y_t sys_display_refresh_yend;
+uint8_t sys_display_start_line;
+
+uint16_t sys_display_frame_period;
+uint16_t sys_display_max_frame_period;
+uint16_t sys_display_skipped_frames;
 
 uint8_t sys_display_state;
 uint8_t sys_display_contrast;
 
+// block value the page buffer is filled with if STATE_PAGE_FILLED is set.
+uint8_t sys_display_fill_block;
+
+// number of rows at the start of the page buffer cleared with the fill block when last sent.
+static disp_y_t _cleared_rows;
+
+const disp_color_t* sys_display_palette;
+
 // used for averaging display color once in a while.
 // 24 bits of which 22 are used, lower 4 bits are always 0 and average is located at [21:18].
 union {
@@ -89,6 +122,10 @@ union {
 #define color_accumulator_upper (_color_accumulator.bytes[2])
 #define color_accumulator_full (_color_accumulator.value)
 
+// Only one row in this number is summed when averaging the display color.
+// Must be a power of two.
+#define COLOR_SAMPLE_ROWS 4
+
 // Initialization sequence, see datasheet and examples
 // OLED display model number is ER-OLED015-3, with a SSD1327 controller.
 // Commented out lines correspond to values set at reset and thus not required to be set.
@@ -113,21 +150,11 @@ static const uint8_t _INIT_SEQUENCE[] = {
 //      DISPLAY_GPIO, 0x02,
 };
 
-static const uint8_t _RESET_CURSOR_SEQUENCE[] = {
-        DISPLAY_SET_COLUMN_ADDR, 0x00, DISPLAY_NUM_COLS - 1,
-        DISPLAY_SET_ROW_ADDR, 0x00, DISPLAY_NUM_ROWS - 1,
-};
-
 ALWAYS_INLINE
 static void sys_display_clear_dc(void) {
     VPORTC.OUT &= ~PIN3_bm;
 }
 
-ALWAYS_INLINE
-static void sys_display_set_dc(void) {
-    VPORTC.OUT |= PIN3_bm;
-}
-
 static void sys_display_reset(void) {
     VPORTC.OUT |= PIN2_bm;
     for (uint8_t i = 0; i < 2; ++i) {
@@ -137,11 +164,14 @@ static void sys_display_reset(void) {
 
     // reset state to remove dimmed status as it isn't restored.
     sys_display_state = 0;
+    // start line is reset to zero too.
+    sys_display_start_line = 0;
 
     // resetting also resets internal contrast value but we won't set
     // sys_display_contrast here as we'd like to restore it afterwards.
 }
 
+BOOTLOADER_NOINLINE
 static void sys_display_write_data(uint16_t length, const uint8_t data[static length]) {
     sys_spi_select_display();
     sys_spi_transmit(length, data);
@@ -169,6 +199,7 @@ static void sys_display_set_contrast_internal(uint8_t contrast) {
 void sys_display_preinit(void) {
     // to avoid creating a .data section for the bootloader.
     sys_display_contrast = DISPLAY_DEFAULT_CONTRAST;
+    sys_display_palette = 0;
 }
 
 void sys_display_init(void) {
@@ -216,9 +247,18 @@ void sys_display_set_gpio(sys_display_gpio_t mode) {
     sys_display_write_command2(DISPLAY_SET_GPIO, mode);
 }
 
-static void sys_display_reset_cursor(void) {
+BOOTLOADER_NOINLINE
+static void sys_display_set_window(disp_y_t ystart, disp_y_t yend) {
+    // set the display RAM window to all columns and the range of rows, with the cursor at its start.
+    uint8_t data[6];
+    data[0] = DISPLAY_SET_COLUMN_ADDR;
+    data[1] = 0x00;
+    data[2] = DISPLAY_NUM_COLS - 1;
+    data[3] = DISPLAY_SET_ROW_ADDR;
+    data[4] = ystart;
+    data[5] = yend;
     sys_display_clear_dc();
-    sys_display_write_data(sizeof _RESET_CURSOR_SEQUENCE, _RESET_CURSOR_SEQUENCE);
+    sys_display_write_data(sizeof data, data);
 }
 
 BOOTLOADER_NOINLINE
@@ -231,59 +271,266 @@ void sys_display_clear(disp_color_t color) {
     } while (i != 0);
 
     // write buffer until whole display has been cleared
-    sys_display_reset_cursor();
+    sys_display_set_window(0, DISPLAY_NUM_ROWS - 1);
     sys_display_set_dc();
     for (i = 0; i < DISPLAY_SIZE / 256; ++i) {
         sys_display_write_data(256, sys_display_buffer);
     }
 
     color_accumulator_upper = 0;
+    sys_display_state &= ~(STATE_PAGE_FILLED | STATE_PAGE_CLEARED);
+}
+
+BOOTLOADER_NOINLINE
+void sys_display_fill_page(uint8_t block) {
+    if (block != sys_display_fill_block) {
+        // the page buffer was cleared with another block.
+        sys_display_state &= ~STATE_PAGE_CLEARED;
+    }
+    sys_display_fill_block = block;
+    sys_display_state |= STATE_PAGE_FILLED;
+}
+
+BOOTLOADER_NOINLINE
+void sys_display_apply_fill(void) {
+    if (sys_display_state & STATE_PAGE_CLEARED) {
+        // the page buffer was already cleared when the last page was sent.
+        sys_display_state &= ~(STATE_PAGE_FILLED | STATE_PAGE_CLEARED);
+        return;
+    }
+    sys_display_state &= ~STATE_PAGE_FILLED;
+    uint8_t* buf_ptr = sys_display_buffer;
+    uint16_t length = sys_display_curr_page_height * DISPLAY_NUM_COLS;
+    const uint8_t block = sys_display_fill_block;
+    while (length--) {
+        *buf_ptr++ = block;
+    }
+}
+
+static uint8_t sys_display_remap_block(uint8_t block) {
+    const disp_color_t* palette = sys_display_palette;
+    return palette[block >> 4] << 4 | palette[block & 0xf];
+}
+
+static void sys_display_remap_rows(uint8_t row, uint8_t count) {
+    // remap colors of the page buffer rows in place before transmitting them.
+    uint8_t* buf_ptr = &sys_display_buffer[row * DISPLAY_NUM_COLS];
+    uint16_t length = count * DISPLAY_NUM_COLS;
+    while (length--) {
+        *buf_ptr = sys_display_remap_block(*buf_ptr);
+        ++buf_ptr;
+    }
+}
+
+static void sys_display_write_fill(uint8_t block, uint16_t length) {
+    // Same as sys_spi_transmit, but always transmitting the fill block instead of the buffer.
+    uint16_t count = length;
+    sys_spi_select_display();
+    sys_spi_begin_transmit();
+    do {
+        while (!(SPI0.INTFLAGS & SPI_DREIF_bm));
+        SPI0.DATA = block;
+    } while (--count);
+    sys_spi_end_transmit();
+    sys_spi_deselect_display();
+
+    if (sys_display_state & STATE_AVERAGING_COLOR) {
+        // all pixels have the same color, the sum doesn't need to be done for every byte.
+        const uint8_t block_swap = nibble_swap(block);
+        const uint16_t block_sum_x16 = (block & 0xf0) + (block_swap & 0xf0);
+        color_accumulator_full += (uint24_t) block_sum_x16 * length;
+    }
+}
+
+static void sys_display_write_data_clear(uint8_t* buf_ptr, uint16_t length) {
+    // Same as sys_spi_transmit, but each byte of the buffer is replaced with the fill block
+    // once loaded in the data register, while the previous byte is being shifted out.
+    // This clears the page buffer for the next page without a separate pass over it.
+    const uint8_t block = sys_display_fill_block;
+    sys_spi_select_display();
+    sys_spi_begin_transmit();
+    do {
+        const uint8_t data = *buf_ptr;
+        while (!(SPI0.INTFLAGS & SPI_DREIF_bm));
+        SPI0.DATA = data;
+        *buf_ptr++ = block;
+    } while (--length);
+    sys_spi_end_transmit();
+    sys_spi_deselect_display();
 }
 
 void sys_display_first_page(void) {
-    sys_display_reset_cursor();
+#ifdef FLASH_MONITOR
+    sys_flash_start_frame();
+#endif
+    if (sys_display_state & STATE_PARTIAL_REFRESH) {
+        // dirty rows were set for this frame only. The average color can't be computed
+        // on a partial frame, it will be on the next full refresh.
+        sys_display_state &= ~STATE_PARTIAL_REFRESH;
+    } else {
+        sys_display_refresh_ystart = 0;
+        sys_display_refresh_yend = DISPLAY_HEIGHT - 1;
+        if (sys_power_should_compute_display_color()) {
+            sys_display_state |= STATE_AVERAGING_COLOR;
+            color_accumulator_full = 0;
+        }
+    }
 
-    sys_display_page_ystart = 0;
-    sys_display_page_yend = sys_display_page_height - 1;
-    sys_display_curr_page_height = sys_display_page_height;
+    if (sys_display_state & STATE_START_LINE_CHANGED) {
+        // Show the new start line before writing the frame. The rows scrolled into view are
+        // written to RAM rows shown at the other end of the display with the old start line,
+        // so writing them first would briefly show them there. This way, only the rows
+        // scrolled into view show stale content until their page is sent.
+        sys_display_state &= ~STATE_START_LINE_CHANGED;
+        sys_display_write_command2(DISPLAY_SET_START_LINE, sys_display_start_line);
+    }
+
+    uint8_t ram_ystart = (sys_display_refresh_ystart + sys_display_start_line) % DISPLAY_NUM_ROWS;
+    uint8_t ram_yend = (sys_display_refresh_yend + sys_display_start_line) % DISPLAY_NUM_ROWS;
+    if (ram_yend < ram_ystart) {
+        // refreshed rows wrap around the end of display RAM, the window is set again
+        // for the rest of the rows when reaching it.
+        ram_yend = DISPLAY_NUM_ROWS - 1;
+    }
+    sys_display_set_window(ram_ystart, ram_yend);
 
-    if (sys_power_should_compute_display_color()) {
-        sys_display_state |= STATE_AVERAGING_COLOR;
-        color_accumulator_full = 0;
+    sys_display_page_ystart = sys_display_refresh_ystart;
+    sys_display_page_yend = sys_display_refresh_ystart + sys_display_page_height - 1;
+    if (sys_display_page_yend > sys_display_refresh_yend) {
+        sys_display_page_yend = sys_display_refresh_yend;
+    }
+    sys_display_curr_page_height = sys_display_page_yend - sys_display_page_ystart + 1;
+    // the first page doesn't start at Y=0 on a partial refresh, a cursor from the last frame
+    // could match it while the image data changed since.
+    graphics_image_invalidate_cursors();
+    if (_cleared_rows < sys_display_curr_page_height) {
+        // last page of the previous frame was shorter, the rest of the buffer isn't cleared.
+        sys_display_state &= ~STATE_PAGE_CLEARED;
+    }
+}
+
+static void sys_display_write_row_averaging(const uint8_t* buf_ptr) {
+    // Same as sys_spi_transmit for a single row, but the colors of all pixels in the row are
+    // summed while waiting for each byte to be shifted out. The row sum fits on 16 bits.
+    uint16_t sum = 0;
+    uint8_t length = DISPLAY_NUM_COLS;
+    sys_spi_select_display();
+    sys_spi_begin_transmit();
+    do {
+        const uint8_t block = *buf_ptr++;
+        while (!(SPI0.INTFLAGS & SPI_DREIF_bm));
+        SPI0.DATA = block;
+        const uint8_t block_swap = nibble_swap(block);
+        sum += (block & 0xf0) + (block_swap & 0xf0);
+    } while (--length);
+    sys_spi_end_transmit();
+    sys_spi_deselect_display();
+
+    // only one row in COLOR_SAMPLE_ROWS is sampled, count it for all of them.
+    color_accumulator_full += (uint24_t) sum * COLOR_SAMPLE_ROWS;
+}
+
+static void sys_display_write_page_averaging(uint8_t row, uint8_t count) {
+    // The average color is only an estimate for the battery load, so it's computed on a sample
+    // of the rows. This keeps the work done per byte in the transmit loop to a minimum.
+    const uint8_t* buf_ptr = &sys_display_buffer[row * DISPLAY_NUM_COLS];
+    disp_y_t y = sys_display_page_ystart + row;
+    do {
+        if (y % COLOR_SAMPLE_ROWS == 0) {
+            sys_display_write_row_averaging(buf_ptr);
+        } else {
+            sys_display_write_data(DISPLAY_NUM_COLS, buf_ptr);
+        }
+        buf_ptr += DISPLAY_NUM_COLS;
+        ++y;
+    } while (--count);
+}
+
+static void sys_display_write_rows(uint8_t row, uint8_t count) {
+    // write a number of rows of the page buffer, starting from a row in the page.
+    const uint16_t length = count * DISPLAY_NUM_COLS;
+    sys_display_set_dc();
+    if (sys_display_state & STATE_PAGE_FILLED) {
+        // page buffer hasn't been drawn on since being filled, no need to read it.
+        // the page buffer stays filled for the next page, it isn't cleared after transmission.
+        uint8_t block = sys_display_fill_block;
+        if (sys_display_palette) {
+            block = sys_display_remap_block(block);
+        }
+        sys_display_write_fill(block, length);
+        return;
+    }
+    if (sys_display_palette) {
+        sys_display_remap_rows(row, count);
+    }
+    if (sys_display_state & STATE_AVERAGING_COLOR) {
+        // sum pixel colors in this page while transmitting it.
+        sys_display_write_page_averaging(row, count);
+    } else if (sys_display_state & STATE_CLEAR_ON_SEND) {
+        // the page buffer is marked as filled once the whole page has been sent.
+        sys_display_write_data_clear(&sys_display_buffer[row * DISPLAY_NUM_COLS], length);
+        _cleared_rows = row + count;
+        sys_display_state |= STATE_PAGE_CLEARED;
+    } else {
+        sys_display_write_data(length, &sys_display_buffer[row * DISPLAY_NUM_COLS]);
+    }
+}
+
+static void sys_display_write_page(void) {
+    // display row written at the start of display RAM, if within the page the RAM window
+    // must be set again at the start of RAM for the rest of the rows. (no wrap if start line is 0)
+    const disp_y_t wrap_y = DISPLAY_HEIGHT - sys_display_start_line;
+    if (wrap_y > sys_display_refresh_ystart &&
+        wrap_y >= sys_display_page_ystart && wrap_y <= sys_display_page_yend) {
+        const uint8_t rows_before = wrap_y - sys_display_page_ystart;
+        if (rows_before != 0) {
+            sys_display_write_rows(0, rows_before);
+        }
+        sys_display_set_window(0, sys_display_refresh_yend - wrap_y);
+        sys_display_write_rows(rows_before, sys_display_curr_page_height - rows_before);
+    } else {
+        sys_display_write_rows(0, sys_display_curr_page_height);
     }
 }
 
 BOOTLOADER_NOINLINE
 bool sys_display_next_page(void) {
-    uint16_t data_length = sys_display_curr_page_height * DISPLAY_NUM_COLS;
-    sys_display_set_dc();
-    sys_display_write_data(data_length, sys_display_buffer);
+    sys_display_write_page();
+    if (sys_display_state & STATE_PAGE_CLEARED) {
+        // the page buffer was cleared while sent, it's now filled for the next page.
+        sys_display_state |= STATE_PAGE_FILLED;
+    }
 
     sys_display_page_ystart += sys_display_page_height;
     sys_display_page_yend += sys_display_page_height;
 
-    if (sys_display_state & STATE_AVERAGING_COLOR) {
-        // sum all pixel colors in this page
-        const uint8_t* buf_ptr = sys_display_buffer;
-        while (data_length--) {
-            uint8_t block = *buf_ptr++;
-            uint8_t block_swap = block >> 4 | block << 4;
-            uint16_t block_sum_x16 = (block & 0xf0) + (block_swap & 0xf0);
-            color_accumulator_full += block_sum_x16;
-        }
-        if (sys_display_page_ystart >= DISPLAY_HEIGHT) {
-            // last page transmitted, exit averaging mode and notify power module.
-            sys_display_state &= ~STATE_AVERAGING_COLOR;
-            sys_power_on_display_color_computed();
-        }
+    if ((sys_display_state & STATE_AVERAGING_COLOR) && sys_display_page_ystart >= DISPLAY_HEIGHT) {
+        // last page transmitted, exit averaging mode and notify power module.
+        sys_display_state &= ~STATE_AVERAGING_COLOR;
+        sys_power_on_display_color_computed();
     }
 
-    if (sys_display_page_yend >= DISPLAY_HEIGHT) {
-        sys_display_page_yend = DISPLAY_HEIGHT - 1;
+    if (sys_display_page_yend > sys_display_refresh_yend) {
+        sys_display_page_yend = sys_display_refresh_yend;
     }
     sys_display_curr_page_height = sys_display_page_yend - sys_display_page_ystart + 1;
+    if (_cleared_rows < sys_display_curr_page_height) {
+        sys_display_state &= ~STATE_PAGE_CLEARED;
+    }
+
+    if (sys_display_page_ystart > sys_display_refresh_yend) {
+        // last page transmitted. variables sharing the page buffer and scratch memory can
+        // overwrite it until the next frame, the fill must be written again.
+        sys_display_state &= ~STATE_PAGE_CLEARED;
+        return false;
+    }
+    return true;
+}
 
-    return sys_display_page_ystart < DISPLAY_HEIGHT;
+void sys_display_init_fps(uint8_t target_fps, uint8_t min_fps) {
+    sys_display_frame_period = target_fps == 0 ? 0 : SYSTICK_FREQUENCY / target_fps;
+    sys_display_max_frame_period = min_fps == 0 ? UINT16_MAX : SYSTICK_FREQUENCY / min_fps;
+    sys_display_skipped_frames = 0;
 }
 
 uint8_t sys_display_get_average_color(void) {
@@ -292,8 +539,40 @@ uint8_t sys_display_get_average_color(void) {
 
 #else
 void sys_display_set_contrast_internal(uint8_t);
+
+void sys_display_write_data(uint16_t length, const uint8_t data[static length]);
+
+void sys_display_set_window(disp_y_t ystart, disp_y_t yend);
 #endif //BOOTLOADER
 
+void sys_display_write_frame(data_ptr_t data) {
+    // Rows are read one at a time in a small buffer and written to the display, since the
+    // flash and the display share the SPI bus. The RAM window is set again at the start of
+    // RAM when reaching its end, like for pages (no wrap if start line is 0).
+    uint8_t buf[DISPLAY_NUM_COLS];
+    const disp_y_t wrap_y = DISPLAY_HEIGHT - sys_display_start_line;
+    sys_display_set_window(sys_display_start_line, DISPLAY_NUM_ROWS - 1);
+    for (disp_y_t y = 0; y < DISPLAY_HEIGHT; ++y) {
+        if (y == wrap_y) {
+            sys_display_set_window(0, sys_display_start_line - 1);
+        }
+        const uint8_t* row = sys_data_get_pointer(data);
+        if (!row || sys_display_palette) {
+            sys_data_read(data, DISPLAY_NUM_COLS, buf);
+            row = buf;
+        }
+        if (sys_display_palette) {
+            const disp_color_t* palette = sys_display_palette;
+            for (uint8_t i = 0; i < DISPLAY_NUM_COLS; ++i) {
+                buf[i] = palette[buf[i] >> 4] << 4 | palette[buf[i] & 0xf];
+            }
+        }
+        sys_display_set_dc();
+        sys_display_write_data(DISPLAY_NUM_COLS, row);
+        data += DISPLAY_NUM_COLS;
+    }
+}
+
 void sys_display_set_contrast(uint8_t contrast) {
     if (contrast == sys_display_contrast) {
         return;
@@ -315,6 +594,51 @@ bool sys_display_is_dimmed(void) {
     return (sys_display_state & STATE_DIMMED) != 0;
 }
 
+void sys_display_set_dirty_rows(disp_y_t ystart, disp_y_t yend) {
+    // align the range on page bounds so that pages are the same as for a full refresh.
+    ystart -= ystart % sys_display_page_height;
+    yend += sys_display_page_height - 1 - yend % sys_display_page_height;
+    if (yend >= DISPLAY_HEIGHT) {
+        yend = DISPLAY_HEIGHT - 1;
+    }
+    sys_display_refresh_ystart = ystart;
+    sys_display_refresh_yend = yend;
+    sys_display_state |= STATE_PARTIAL_REFRESH;
+}
+
+void sys_display_scroll(int8_t rows) {
+    if (rows == 0) {
+        return;
+    }
+    sys_display_start_line = (uint8_t) (sys_display_start_line + rows) % DISPLAY_NUM_ROWS;
+    if (sys_display_state & (STATE_PARTIAL_REFRESH | STATE_START_LINE_CHANGED)) {
+        // rows were already set for the next frame, refresh the whole display instead.
+        sys_display_state = (sys_display_state & ~STATE_PARTIAL_REFRESH) | STATE_START_LINE_CHANGED;
+        return;
+    }
+    // only the rows scrolled into view need to be drawn.
+    if (rows > 0) {
+        sys_display_set_dirty_rows(DISPLAY_HEIGHT - rows, DISPLAY_HEIGHT - 1);
+    } else {
+        sys_display_set_dirty_rows(0, -rows - 1);
+    }
+    sys_display_state |= STATE_START_LINE_CHANGED;
+}
+
+ALWAYS_INLINE
+void sys_display_set_palette(const disp_color_t palette[16]) {
+    sys_display_palette = palette;
+}
+
+ALWAYS_INLINE
+void sys_display_set_clear_on_send(bool enabled) {
+    if (enabled) {
+        sys_display_state |= STATE_CLEAR_ON_SEND;
+    } else {
+        sys_display_state &= ~STATE_CLEAR_ON_SEND;
+    }
+}
+
 ALWAYS_INLINE
 void sys_display_init_page(uint8_t height) {
     sys_display_page_height = height;
@@ -322,5 +646,9 @@ void sys_display_init_page(uint8_t height) {
 
 ALWAYS_INLINE
 uint8_t* sys_display_buffer_at(disp_x_t x, disp_y_t y) {
+    if (sys_display_state & STATE_PAGE_FILLED) {
+        // buffer is about to be drawn on, the fill must actually be done now.
+        sys_display_apply_fill();
+    }
     return &sys_display_buffer[y * DISPLAY_NUM_COLS + x / 2];
 }
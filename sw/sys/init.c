@@ -26,14 +26,20 @@
 #include <sys/sound.h>
 #include <sys/spi.h>
 #include <sys/display.h>
+#include <sys/eeprom.h>
 #include <sys/led.h>
+#include <sys/ram.h>
 #include <sys/reset.h>
+#include <sys/time.h>
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/sleep.h>
 #include <util/delay.h>
 
+// end of bootloader data in RAM, see boot.ld.
+extern uint8_t __bss_end;
+
 FUSES = {
         .WDTCFG = FUSE_WDTCFG_DEFAULT,
         .BODCFG = BOD_LVL_BODLEVEL0_gc | BOD_SAMPFREQ_1KHZ_gc |
@@ -78,6 +84,8 @@ static void sys_init_registers(void) {
 
     // ====== SPI ======
     // master, 5 MHz SCK, mode 0, MSB first, buffered, no interrupts.
+    // This is the fastest SCK available (F_CPU/2) and all devices on the bus (display, flash
+    // and EEPROM) support it, so the clock is never changed when selecting a device.
     SPI0.CTRLB = SPI_BUFEN_bm | SPI_MODE_0_gc | SPI_SSD_bm;
     SPI0.CTRLA = SPI_MASTER_bm | SPI_CLK2X_bm | SPI_PRESC_DIV4_gc | SPI_ENABLE_bm;
 
@@ -104,7 +112,7 @@ static void sys_init_registers(void) {
     // ====== RTC ======
     // interrupt every 1/256th s using 32.768 kHz internal clock for system time.
     while (RTC.STATUS != 0);
-    RTC.PER = 0;
+    RTC.PER = SYS_TIME_RTC_TICK_PERIOD - 1;
     RTC.INTCTRL = RTC_OVF_bm;
     RTC.CLKSEL = RTC_CLKSEL_INT32K_gc;
     //RTC.CTRLA is set in sys_init_wakeup()
@@ -142,12 +150,20 @@ void sys_init(void) {
     }
     RSTCTRL.RSTFR = reset_flags;
 
+    // paint the RAM left for the stack to measure its usage later.
+    sys_ram_paint_stack(&__bss_end);
+
     sys_init_registers();
     sys_display_preinit();
     sys_init_wakeup();
 }
 
 void sys_init_sleep(void) {
+    // the queued EEPROM write must be complete before the device can be turned off.
+    sys_eeprom_flush();
+
+    // tickless mode is disabled on wakeup.
+    sys_time_set_tickless(false);
     RTC.CTRLA = 0;
     RTC.PITCTRLA = 0;
 
@@ -162,13 +178,19 @@ void sys_init_sleep(void) {
 }
 
 void sys_init_wakeup(void) {
+    // start checking battery level, the sample is taken by the ADC interrupt
+    // in parallel with the display initialization.
+    ADC0.CTRLA = ADC_RESSEL_10BIT_gc | ADC_ENABLE_bm;
+    sys_power_start_sampling();
+
+    // the flash takes a few microseconds to leave power down mode, wake it up early
+    // so that it's ready by the time the app needs it.
+    sys_flash_wakeup();
+
     // initialize display
     sys_display_init();
     sys_display_clear(DISPLAY_COLOR_BLACK);
 
-    // check battery level
-    ADC0.CTRLA = ADC_RESSEL_10BIT_gc | ADC_ENABLE_bm;
-    sys_power_start_sampling();
     sys_power_wait_for_sample();
     // note: at this point display color is 0, so load should be about 0 too.
     // the first measurement isn't terribly precise, it's mostly an undervoltage protection.
@@ -187,10 +209,8 @@ void sys_init_wakeup(void) {
     sys_sound_update_output_state();
     sys_sound_set_channel_volume(2, SOUND_CHANNEL2_VOLUME0);
 
-    sys_flash_wakeup();
-
     while (RTC.STATUS & RTC_CTRLABUSY_bm);
-    RTC.CTRLA = RTC_PRESCALER_DIV128_gc | RTC_RTCEN_bm;
+    RTC.CTRLA = RTC_PRESCALER_DIV1_gc | RTC_RTCEN_bm;
 }
 
 #endif //BOOTLOADER
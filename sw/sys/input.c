@@ -23,6 +23,7 @@
 #include <boot/display.h>
 #include <boot/power.h>
 #include <boot/defs.h>
+#include <boot/time.h>
 
 #include <sys/time.h>
 #include <sys/power.h>
@@ -50,9 +51,31 @@ static uint8_t _state1;
 // not volatile since read modify write never occurs outside interrupt
 static uint8_t _inactive_countdown;
 
+// input event queue, a ring buffer with a single writer on each end so no locking is needed:
+// the head is only written by the system tick interrupt, and the tail only by the app.
+static input_event_t _events[INPUT_EVENT_QUEUE_SIZE];
+static volatile uint8_t _events_head;
+static volatile uint8_t _events_tail;
+
+static void _queue_event(uint8_t state) {
+    const uint8_t changed = state ^ sys_input_state;
+    if (changed == 0) {
+        return;
+    }
+    const uint8_t head = _events_head;
+    const uint8_t next = (head + 1) & (INPUT_EVENT_QUEUE_SIZE - 1);
+    if (next == _events_tail) {
+        // queue is full, drop the event.
+        return;
+    }
+    _events[head] = (input_event_t) {sys_time_counter, changed & state, changed & ~state};
+    _events_head = next;
+}
+
 ISR(PORTD_PORT_vect) {
     // this interrupt is triggered whenever the user presses a button.
     VPORTD.INTFLAGS = BUTTONS_ALL;
+    sys_time_exit_tickless();
     if (_inactive_countdown == 0) {
         // sleep is currently scheduled, cancel it.
         sys_power_schedule_sleep_cancel();
@@ -64,9 +87,11 @@ void sys_input_update_state(void) {
     // 2 levels debouncing: new value is most common value among last two and new.
     // this is probably overkill since the buttons don't even bounce...
     const uint8_t port = VPORTD.IN & BUTTONS_ALL;
-    sys_input_state = (_state0 & port) |
-                      (_state1 & port) |
-                      (_state0 & _state1);
+    const uint8_t state = (_state0 & port) |
+                          (_state1 & port) |
+                          (_state0 & _state1);
+    _queue_event(state);
+    sys_input_state = state;
     _state1 = _state0;
     _state0 = port;
 }
@@ -78,6 +103,7 @@ void sys_input_update_state_immediate(void) {
     sys_input_last_state = port;
     _state0 = port;
     _state1 = port;
+    _events_tail = _events_head;
 }
 
 void sys_input_dim_if_inactive(void) {
@@ -105,6 +131,22 @@ void sys_input_latch(void) {
     sys_input_curr_state = sys_input_state;
 }
 
+BOOTLOADER_NOINLINE
+bool sys_input_get_event(input_event_t* event) {
+    const uint8_t tail = _events_tail;
+    if (tail == _events_head) {
+        return false;
+    }
+    *event = _events[tail];
+    _events_tail = (tail + 1) & (INPUT_EVENT_QUEUE_SIZE - 1);
+    return true;
+}
+
+BOOTLOADER_NOINLINE
+void sys_input_clear_events(void) {
+    _events_tail = _events_head;
+}
+
 #endif //BOOTLOADER
 
 uint8_t sys_input_get_state(void) {
@@ -71,6 +71,8 @@ enum {
     STATE_COLOR_PENDING = 1 << 3,
     // the battery level monitor is ready to update the battery level.
     STATE_UPDATE_BATTERY_LEVEL = 1 << 4,
+    // the CPU shouldn't be idled after the current loop.
+    STATE_IDLE_SKIPPED = 1 << 5,
 };
 
 #ifdef BOOTLOADER
@@ -161,8 +163,15 @@ ISR(RTC_PIT_vect) {
         _sleep_countdown = countdown - 1;
     }
 
-    // indicate that a display color should be computed soon.
-    sys_power_state = state | STATE_COLOR_PENDING;
+    if (_battery_level_update == 0 && sys_power_battery_status == BATTERY_DISCHARGING) {
+        // the next sample will be used to update the battery level, the load estimate for it
+        // needs a display color, indicate that one should be computed soon.
+        sys_power_state = state | STATE_COLOR_PENDING;
+    } else {
+        // only the battery status is needed from this sample, take it right away
+        // instead of waiting for a full frame to compute the display color.
+        sys_power_start_sampling();
+    }
 }
 
 void sys_power_start_sampling(void) {
@@ -406,6 +415,22 @@ void sys_power_enable_sleep(void) {
     }
 }
 
+void sys_power_idle(void) {
+    cli();
+    if (sys_power_state & STATE_IDLE_SKIPPED) {
+        sys_power_state &= ~STATE_IDLE_SKIPPED;
+        sei();
+        return;
+    }
+    // the sleep mode is power down by default, for sys_power_enable_sleep.
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    // the instruction following sei is always executed before any pending interrupt,
+    // so an interrupt occurring after the check can't be missed until the next one.
+    sei();
+    sleep_cpu();
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+}
+
 BOOTLOADER_NOINLINE
 uint8_t sys_power_get_battery_percent(void) {
     // percent = ceil(level / 255 * 20) * 5 = ((level * 20 + 255) >> 8) * 5
@@ -425,6 +450,12 @@ void sys_power_set_sleep_enabled(bool enabled) {
     }
 }
 
+void sys_power_skip_idle(void) {
+    ATOMIC_BLOCK(ATOMIC_FORCEON) {
+        sys_power_state |= STATE_IDLE_SKIPPED;
+    }
+}
+
 ALWAYS_INLINE
 bool sys_power_is_sleep_enabled(void) {
     return (sys_power_state & STATE_SLEEP_DISABLE) == 0;
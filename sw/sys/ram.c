@@ -0,0 +1,49 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <sys/ram.h>
+#include <sys/defs.h>
+
+#include <avr/io.h>
+
+// end of data in RAM, the stack can grow down to this address (see app.ld and boot.ld).
+extern uint8_t __bss_end;
+
+#ifdef BOOTLOADER
+
+void sys_ram_paint_stack(uint8_t* start) {
+    uint8_t* end = (uint8_t*) SP;
+    while (start < end) {
+        *start++ = SYS_RAM_STACK_PAINT;
+    }
+}
+
+#endif //BOOTLOADER
+
+ALWAYS_INLINE
+uint16_t sys_ram_get_stack_high_water(void) {
+    const uint8_t* ptr = &__bss_end;
+    while (ptr <= (const uint8_t*) RAMEND && *ptr == SYS_RAM_STACK_PAINT) {
+        ++ptr;
+    }
+    return RAMEND + 1 - (uint16_t) ptr;
+}
+
+ALWAYS_INLINE
+uint16_t sys_ram_get_stack_space(void) {
+    return RAMEND + 1 - (uint16_t) &__bss_end;
+}
@@ -19,6 +19,7 @@
 #include <sys/defs.h>
 
 #include <avr/io.h>
+#include <util/atomic.h>
 
 #ifdef BOOTLOADER
 #include <boot/defs.h>
@@ -190,8 +191,31 @@ void sys_sound_play_note(uint8_t note, uint8_t channel) {
 // TCB interrupts:
 // - update channel output level bit field
 // - update TCA0 PWM duty cycle
+//
+// The output can't be driven by hardware waveform generation with no interrupt, even for a single
+// channel. The buzzer pin (PA3) is only a waveform output for TCA0 in split mode, where the period
+// is 8-bit: at the prescaler needed for the lowest notes (65 Hz), the highest notes would only be
+// a few counts long and badly out of tune. TCB 16-bit modes that can produce note frequencies
+// don't drive an output pin, and a direct square wave would also lose the volume levels.
+
+#ifdef SOUND_MONITOR
+static volatile uint16_t _isr_count;
+#define COUNT_ISR() (++_isr_count)
+
+uint16_t sys_sound_take_isr_count(void) {
+    uint16_t count;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        count = _isr_count;
+        _isr_count = 0;
+    }
+    return count;
+}
+#else
+#define COUNT_ISR()
+#endif
 
 ISR(TCB0_INT_vect) {
+    COUNT_ISR();
     uint8_t level = out_level;
     level ^= SOUND_CHANNEL0_VOLUME0;
     TCA0.SPLIT.HCMP0 = _PWM_LEVELS[level];
@@ -200,6 +224,7 @@ ISR(TCB0_INT_vect) {
 }
 
 ISR(TCB1_INT_vect) {
+    COUNT_ISR();
     uint8_t level = out_level;
     level ^= SOUND_CHANNEL1_VOLUME0;
     TCA0.SPLIT.HCMP0 = _PWM_LEVELS[level];
@@ -208,6 +233,7 @@ ISR(TCB1_INT_vect) {
 }
 
 ISR(TCB2_INT_vect) {
+    COUNT_ISR();
     uint8_t level = out_level;
     level ^= sys_sound_channel2_volume;
     TCA0.SPLIT.HCMP0 = _PWM_LEVELS[level];
@@ -232,7 +258,12 @@ sound_volume_t sys_sound_get_volume(void) {
 ALWAYS_INLINE
 void sys_sound_set_channel_volume(uint8_t channel, sound_channel_volume_t volume) {
     if (channel == 2) {
-        sys_sound_channel2_volume = volume;
+        // clear the channel output level so that the TCB2 interrupt never toggles a mask
+        // different from the one that was set, this can happen during a note.
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            out_level &= ~(SOUND_CHANNEL2_VOLUME0 | SOUND_CHANNEL2_VOLUME1);
+            sys_sound_channel2_volume = volume;
+        }
     }
     // only one supported level for other channels
 }
@@ -17,36 +17,127 @@
 #include <sys/time.h>
 #include <sys/defs.h>
 
+#include <avr/io.h>
 #include <util/atomic.h>
 
 #ifdef BOOTLOADER
 
+#include <boot/defs.h>
 #include <boot/input.h>
 #include <boot/sound.h>
 #include <boot/led.h>
 
-#include <avr/io.h>
+#include <sys/sound.h>
+#include <sys/led.h>
+
+#include <core/sound.h>
+#include <core/led.h>
+
 #include <avr/interrupt.h>
 
+#include <string.h>
+
 volatile systime_t sys_time_counter;
 
+#ifdef LOOP_MONITOR
+volatile uint8_t sys_loop_phase;
+static uint16_t _loop_samples[SYS_LOOP_PHASE_COUNT];
+#define SAMPLE_LOOP_PHASE() (++_loop_samples[sys_loop_phase])
+
+BOOTLOADER_NOINLINE
+void sys_time_take_loop_samples(uint16_t samples[SYS_LOOP_PHASE_COUNT]) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        memcpy(samples, _loop_samples, sizeof _loop_samples);
+        memset(_loop_samples, 0, sizeof _loop_samples);
+    }
+}
+#else
+#define SAMPLE_LOOP_PHASE()
+#endif
+
+// number of system ticks per RTC period in tickless mode.
+#define TICKLESS_PERIOD 32
+
+static bool _tickless_enabled;
+// number of system ticks per RTC period, either 1 or TICKLESS_PERIOD.
+static uint8_t _tick_period = 1;
+
+static void set_rtc_period(uint8_t period) {
+    while (RTC.STATUS & RTC_PERBUSY_bm);
+    RTC.PER = period * SYS_TIME_RTC_TICK_PERIOD - 1;
+    _tick_period = period;
+}
+
+BOOTLOADER_NOINLINE
+void sys_time_exit_tickless(void) {
+    if (_tick_period == 1) {
+        return;
+    }
+    // account for the ticks elapsed in the current period, the counter must be reset before the
+    // period is shortened, otherwise it would count up to the maximum value before overflowing.
+    // The fraction of tick is kept so that the tick phase is unchanged.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        while (RTC.STATUS & RTC_CNTBUSY_bm);
+        const uint16_t cnt = RTC.CNT;
+        sys_time_counter += cnt >> SYS_TIME_RTC_TICK_PERIOD_BITS;
+        RTC.CNT = cnt & (SYS_TIME_RTC_TICK_PERIOD - 1);
+        set_rtc_period(1);
+    }
+}
+
+BOOTLOADER_NOINLINE
+void sys_time_set_tickless(bool enabled) {
+    _tickless_enabled = enabled;
+    if (!enabled) {
+        sys_time_exit_tickless();
+    }
+}
+
 ISR(RTC_CNT_vect) {
-    // called 256 times per second
+    // called 256 times per second, or 8 times per second in tickless mode.
     RTC.INTFLAGS = RTC_OVF_bm;
 
-    ++sys_time_counter;
+    sys_time_counter += _tick_period;
+    SAMPLE_LOOP_PHASE();
 
     sys_input_update_state();
     sys_sound_update();
     sys_led_blink_update();
+
+    const bool can_be_tickless = _tickless_enabled &&
+                                 (sys_sound_tracks_on & TRACKS_STARTED_ALL) == 0 &&
+                                 sys_led_blink_period == LED_BLINK_NONE;
+    if (can_be_tickless) {
+        if (_tick_period == 1) {
+            set_rtc_period(TICKLESS_PERIOD);
+        }
+    } else if (_tick_period != 1) {
+        set_rtc_period(1);
+    }
 }
 
 #endif // BOOTLOADER
 
 ALWAYS_INLINE
 systime_t sys_time_get() {
-    ATOMIC_BLOCK(ATOMIC_FORCEON) {
-        return sys_time_counter;
+    // the counter is read twice instead of disabling interrupts, if both reads are equal,
+    // the first wasn't interrupted by a tick (which always changes the low byte).
+    systime_t time;
+    do {
+        time = sys_time_counter;
+    } while (time != sys_time_counter);
+    return time;
+}
+
+systime_fine_t sys_time_get_fine(void) {
+    while (true) {
+        const systime_t time = sys_time_get();
+        const uint16_t cnt = RTC.CNT;
+        // if the overflow interrupt is pending or was handled in the meantime,
+        // the RTC counter was reset but the tick may not be counted yet, try again.
+        if (!(RTC.INTFLAGS & RTC_OVF_bm) && time == sys_time_get()) {
+            return ((systime_fine_t) time << 16) +
+                   ((systime_fine_t) cnt << (16 - SYS_TIME_RTC_TICK_PERIOD_BITS));
+        }
     }
-    return 0;
 }
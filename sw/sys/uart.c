@@ -57,6 +57,13 @@ static struct {
     volatile uint8_t tail;
 } tx_buf;
 
+// buffer written by the TX interrupt once the TX buffer is empty, see sys_uart_write_buffer.
+static struct {
+    const uint8_t* ptr;
+    volatile uint8_t length;
+    sys_uart_done_cb_t done;
+} tx_data;
+
 static struct {
     uint8_t data[SYS_UART_RX_BUFFER_SIZE];
     volatile uint8_t head;
@@ -66,11 +73,22 @@ static struct {
 __attribute__((signal))
 void __vector_uart_dre(void) {
     uint8_t tail = tx_buf.tail;
-    USART0.TXDATAL = tx_buf.data[tail];
-    tail = (tail + 1) % SYS_UART_TX_BUFFER_SIZE;
-    tx_buf.tail = tail;
-    if (tail == tx_buf.head) {
-        USART0.CTRLA &= ~USART_DREIE_bm;
+    if (tail != tx_buf.head) {
+        USART0.TXDATAL = tx_buf.data[tail];
+        tail = (tail + 1) % SYS_UART_TX_BUFFER_SIZE;
+        tx_buf.tail = tail;
+        if (tail == tx_buf.head && tx_data.length == 0) {
+            USART0.CTRLA &= ~USART_DREIE_bm;
+        }
+    } else {
+        // TX buffer is empty, so there's a buffer being written.
+        USART0.TXDATAL = *tx_data.ptr++;
+        if (--tx_data.length == 0) {
+            USART0.CTRLA &= ~USART_DREIE_bm;
+            if (tx_data.done) {
+                tx_data.done();
+            }
+        }
     }
 }
 
@@ -101,6 +119,7 @@ void sys_uart_set_baud(uint16_t baud_calc) {
 }
 
 void sys_uart_write(uint8_t c) {
+    sys_uart_wait_buffer();
     state |= STATE_TRANSMITTED;
     if (tx_buf.tail == tx_buf.head && (USART0.STATUS & USART_DREIF_bm)) {
         // TX data register empty and buffer empty, transmit directly.
@@ -116,6 +135,26 @@ void sys_uart_write(uint8_t c) {
     }
 }
 
+void sys_uart_write_buffer(const uint8_t* data, uint8_t length, sys_uart_done_cb_t done) {
+    sys_uart_wait_buffer();
+    if (length == 0) {
+        if (done) {
+            done();
+        }
+        return;
+    }
+    state |= STATE_TRANSMITTED;
+    tx_data.ptr = data;
+    tx_data.done = done;
+    // the length is set last, the interrupt only reads the buffer when it's not zero.
+    tx_data.length = length;
+    USART0.CTRLA |= USART_DREIE_bm;
+}
+
+void sys_uart_wait_buffer(void) {
+    while (tx_data.length != 0);  // wait for interrupt to write buffer.
+}
+
 uint8_t sys_uart_read(void) {
     while (rx_buf.tail == rx_buf.head);  // wait for interrupt to fill buffer.
     const uint8_t c = rx_buf.data[rx_buf.tail];
@@ -128,6 +167,15 @@ bool sys_uart_available(void) {
     return rx_buf.tail != rx_buf.head;
 }
 
+uint8_t sys_uart_available_count(void) {
+    return (uint16_t) (rx_buf.head + SYS_UART_RX_BUFFER_SIZE - rx_buf.tail) %
+           SYS_UART_RX_BUFFER_SIZE;
+}
+
+uint8_t sys_uart_peek(uint8_t offset) {
+    return rx_buf.data[(uint16_t) (rx_buf.tail + offset) % SYS_UART_RX_BUFFER_SIZE];
+}
+
 void sys_uart_flush(void) {
     if (!(state & STATE_TRANSMITTED)) {
         // nothing was transmitted, TXCIF bit will not be set.
@@ -2,7 +2,18 @@
 # This file is mostly copied from sim.mk, with some modifications
 # to integrate Google Test and to compile C++ code.
 
+# Replay builds (REPLAY=1) are optimized and not instrumented, to run long simulations faster.
+# They are built separately, and the test source file has a _replay suffix instead of _test.
+# The release profile (PROFILE=release) builds the regular tests the same way, in a separate
+# build directory. Replay builds always use it.
+ifeq ($(REPLAY),1)
+PROFILE := release
+PLATFORM := replay
+else ifeq ($(PROFILE),release)
+PLATFORM := test-release
+else
 PLATFORM := test
+endif
 
 include common.mk
 
@@ -19,7 +30,11 @@ LIB_DIRS += $(GTEST_DIR_LIB)
 
 ALL_TESTS =  # to be set in target.mk
 TEST_SRC_DIR := $(TARGET)/test
+ifeq ($(REPLAY),1)
+TEST_NAME_P = $(TEST_NAME)_replay
+else
 TEST_NAME_P = $(TEST_NAME)_test
+endif
 
 CC := gcc
 CXX := g++
@@ -28,8 +43,12 @@ CXX := g++
 # the simulator will have no GUI, produce no sound, and time will be controllable.
 DEFINES += SIMULATION SIMULATION_HEADLESS BOOTLOADER TESTING
 
+ifeq ($(PROFILE),release)
+CFLAGS += -Wno-unused-parameter -g -O2 -flto=auto -fshort-enums -pthread
+else
 CFLAGS += -Wno-unused-parameter -g3 -O0 -fshort-enums \
           -fsanitize=address -fno-omit-frame-pointer -fsanitize=undefined -pthread
+endif
 
 CXX_FLAGS += -std=c++17
 
@@ -61,6 +80,11 @@ compile: $(BUILD_DIR)/$(TEST_NAME_P)
 all:
 	$(error Use the 'test' target instead to run all tests)
 
+# With SHARDS=<n>, each test binary is run in n processes using Google Test sharding,
+# and the results are merged (see utils/gtest_shards.py).
+# All test binaries are run even if one fails, the target fails if any of them did.
 test:
 	$(MAKE) $(addsuffix _test, $(ALL_TESTS))
-	cd $(TARGET); $(foreach t,$(ALL_TESTS),build/test/$(t)_test;)
+	cd $(TARGET) || exit 1; status=0; $(foreach t,$(ALL_TESTS),$(if $(SHARDS),\
+		python3 $(PWD)/utils/gtest_shards.py build/$(PLATFORM)/$(t)_test $(SHARDS),\
+		build/$(PLATFORM)/$(t)_test) || status=1;) exit $$status
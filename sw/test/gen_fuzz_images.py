@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+
+#  Copyright 2022 Nicolas Maltais
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+
+# Generate random images encoded with the image_gen encoders, for the differential graphics
+# test in test/graphics_test.cpp, which draws them with the core graphics functions and compares
+# the result with a per-pixel reference renderer. The images are generated when building the
+# graphics test, they can also be generated by running from the test directory:
+#   PYTHONPATH=../utils ./gen_fuzz_images.py
+#
+# File format, for each image:
+# - 0x00: width
+# - 0x01: height
+# - 0x02: number of encodings
+# - width * height bytes: pixel colors by row, 0xff for transparent. Binary images use 0 and 1.
+# - for each encoding: length (2 bytes, little endian), encoded image data.
+
+import random
+import struct
+from pathlib import Path
+from typing import List, Tuple
+
+from assets.image_gen import EncodeError, ImageEncoder, ImageEncoderBinaryMixed, \
+    ImageEncoderBinaryRaw, ImageEncoderGrayLz, ImageEncoderGrayMixed, ImageEncoderGrayRaw, \
+    IndexGranularity, IndexGranularityMode, TRANSPARENT_COLOR
+
+OUTPUT_FILE = Path("assets/fuzz-images.dat")
+
+SEED = 0x5eed
+IMAGES_COUNT = 32
+MAX_WIDTH = 48
+MAX_HEIGHT = 72
+
+
+class PixelImage:
+    """Grayscale image with alpha, with only the attributes used by the encoders."""
+
+    def __init__(self, width: int, height: int, pixels: List[int], levels: int):
+        self.width = width
+        self.height = height
+        self.pixels = pixels
+        self.levels = levels
+
+    def getpixel(self, pos: Tuple[int, int]) -> Tuple[int, int]:
+        color = self.pixels[pos[1] * self.width + pos[0]]
+        if color == TRANSPARENT_COLOR:
+            return 0, 0
+        # middle of the color range, which the encoders map back to the same level.
+        return (color * 2 + 1) * 128 // self.levels, 255
+
+
+def random_pixels(rng: random.Random, width: int, height: int, colors: List[int]) -> List[int]:
+    """Random runs of random colors, with both short and long runs to exercise run lengths
+    and raw sequences in the mixed encodings."""
+    pixels = []
+    while len(pixels) < width * height:
+        length = rng.choice([1, 1, 2, 3, rng.randint(4, 40), rng.randint(40, 300)])
+        pixels += [rng.choice(colors)] * length
+    return pixels[:width * height]
+
+
+def encode(image: PixelImage, encoder_cls, alpha_color: int, granularity: int) -> bytes:
+    encoder = encoder_cls(image)
+    encoder.alpha_color = alpha_color
+    # raw images are implicitly indexed on every row, which is what aligns rows on bytes.
+    encoder.indexed = granularity != 0 or \
+        encoder_cls in (ImageEncoderBinaryRaw, ImageEncoderGrayRaw)
+    if granularity:
+        encoder.index_granularity = IndexGranularity(IndexGranularityMode.ROW_COUNT, granularity)
+    return bytes(encoder.encode().encode())
+
+
+def generate_image(rng: random.Random, binary: bool) -> bytes:
+    width = rng.randint(1, MAX_WIDTH)
+    height = rng.randint(1, MAX_HEIGHT)
+    alpha_color = ImageEncoder.ALPHA_COLOR_NONE
+    if binary:
+        colors = [0, 1]
+        image = PixelImage(width, height, random_pixels(rng, width, height, colors), 2)
+        encoders = [ImageEncoderBinaryRaw, ImageEncoderBinaryMixed]
+    else:
+        colors = rng.sample(range(16), rng.randint(1, 15))
+        if rng.random() < 0.5:
+            # one of the colors left unused is the alpha color.
+            alpha_color = rng.choice([c for c in range(16) if c not in colors])
+            colors.append(TRANSPARENT_COLOR)
+        image = PixelImage(width, height, random_pixels(rng, width, height, colors), 16)
+        encoders = [ImageEncoderGrayRaw, ImageEncoderGrayMixed]
+
+    encodings = [encode(image, encoders[0], alpha_color, 0),
+                 encode(image, encoders[1], alpha_color, 0)]
+    try:
+        encodings.append(encode(image, encoders[1], alpha_color, rng.randint(1, 8)))
+    except EncodeError:
+        # too many bytes between index entries.
+        pass
+    if not binary:
+        encodings.append(encode(image, ImageEncoderGrayLz, alpha_color, 0))
+
+    data = bytearray([width, height, len(encodings)])
+    data += bytes(image.pixels)
+    for encoding in encodings:
+        data += struct.pack("<H", len(encoding))
+        data += encoding
+    return data
+
+
+def main():
+    rng = random.Random(SEED)
+    data = bytearray()
+    for i in range(IMAGES_COUNT):
+        data += generate_image(rng, i % 2 == 0)
+    OUTPUT_FILE.write_bytes(data)
+    print(f"{IMAGES_COUNT} images written to {OUTPUT_FILE}, {len(data)} bytes")
+
+
+if __name__ == '__main__':
+    main()
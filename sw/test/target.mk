@@ -1,7 +1,36 @@
 
-DEFINES += EEPROM_RESERVED_SPACE=0
+# Simulator state is per thread, to run several consoles in parallel in a test.
+DEFINES += SIMULATION_THREAD_LOCAL
 
-ALL_TESTS := graphics
+ALL_TESTS := graphics flash data eeprom sound input
 
-graphics_test:
+# Random images for the graphics fuzz tests, generated from a fixed seed.
+FUZZ_IMAGES_FILE := $(TARGET)/assets/fuzz-images.dat
+
+$(FUZZ_IMAGES_FILE): $(TARGET)/gen_fuzz_images.py utils/assets/image_gen.py
+	$(E)export PYTHONPATH="$(PWD)/utils"; cd $(TARGET); python3 gen_fuzz_images.py
+
+graphics_test: $(FUZZ_IMAGES_FILE)
 	$(MAKE) compile TEST_NAME=graphics
+
+flash_test:
+	$(MAKE) compile TEST_NAME=flash
+
+data_test:
+	$(MAKE) compile TEST_NAME=data
+
+eeprom_test:
+	$(MAKE) compile TEST_NAME=eeprom
+
+sound_test:
+	$(MAKE) compile TEST_NAME=sound
+
+input_test:
+	$(MAKE) compile TEST_NAME=input
+
+# Optimized graphics benchmark, run from test with build/replay/graphics_replay.
+graphics_replay:
+	$(MAKE) compile TEST_NAME=graphics REPLAY=1
+
+bench: graphics_replay
+	cd $(TARGET); build/replay/graphics_replay
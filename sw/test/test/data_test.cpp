@@ -0,0 +1,69 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sim_test.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <algorithm>
+
+extern "C" {
+#include <core/data.h>
+#include <sim/memory.h>
+
+extern SIM_THREAD_LOCAL sim_mem_t* flash;
+}
+
+class DataTest : public SimTest {};
+
+TEST_F(DataTest, data_get_pointer) {
+    // internal data is read in place, flash data can't be.
+    static const uint8_t internal[4] = {1, 2, 3, 4};
+    EXPECT_EQ(data_get_pointer(data_mcu(internal)), internal);
+    EXPECT_EQ(data_get_pointer(data_flash(0x100)), nullptr);
+}
+
+TEST_F(DataTest, data_cache) {
+    // reads through the cache must give the same data as direct reads, for any alignment.
+    std::vector<uint8_t> data(256);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = (uint8_t) (i * 29 + 3);
+    }
+    sim_mem_write(flash, 0x2000, data.size(), data.data());
+    data_cache_line_t lines[4];
+    data_cache_t cache{lines, 4};
+    data_set_cache(&cache);
+    for (int pass = 0; pass < 2; ++pass) {
+        for (uint16_t pos : {0, 5, 14, 16, 70, 250}) {
+            for (uint16_t length : {1, 4, 16, 6}) {
+                uint8_t actual[16];
+                const uint16_t n = std::min<uint16_t>(length, data.size() - pos);
+                data_read(data_flash(0x2000 + pos), n, actual);
+                EXPECT_TRUE(std::equal(actual, actual + n, data.begin() + pos))
+                                    << "pos " << pos << ", length " << length;
+            }
+        }
+    }
+    EXPECT_GT(cache.hits, cache.misses);
+    // reads longer than a line are not cached.
+    const uint16_t misses = cache.misses;
+    std::vector<uint8_t> actual(data.size());
+    data_read(data_flash(0x2000), data.size(), actual.data());
+    EXPECT_EQ(data, actual);
+    EXPECT_EQ(misses, cache.misses);
+    data_set_cache(0);
+}
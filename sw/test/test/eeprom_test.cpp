@@ -0,0 +1,160 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sim_test.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+
+extern "C" {
+#include <core/eeprom.h>
+#include <boot/eeprom.h>
+#include <sys/eeprom.h>
+}
+
+class EepromTest : public SimTest {};
+
+TEST_F(EepromTest, eeprom_write_async) {
+    // a queued write must be advanced one step per update, and give the same data as a write.
+    std::vector<uint8_t> data(100);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = (uint8_t) (i * 17 + 1);
+    }
+    eeprom_write_async(10, data.size(), data.data());
+    EXPECT_FALSE(eeprom_is_write_done());
+    int updates = 0;
+    while (!eeprom_is_write_done()) {
+        sys_eeprom_update();
+        ++updates;
+        ASSERT_LT(updates, 100);
+    }
+    // 100 bytes at address 10 span 4 pages.
+    EXPECT_GE(updates, 4);
+    std::vector<uint8_t> actual(data.size());
+    eeprom_read(10, actual.size(), actual.data());
+    EXPECT_EQ(data, actual);
+
+    // reading waits for the queued write to be done.
+    std::reverse(data.begin(), data.end());
+    eeprom_write_async(10, data.size(), data.data());
+    eeprom_read(10, actual.size(), actual.data());
+    EXPECT_TRUE(eeprom_is_write_done());
+    EXPECT_EQ(data, actual);
+}
+
+TEST_F(EepromTest, eeprom_read_stream) {
+    // reads longer than 255 bytes and stream reads must cross page boundaries.
+    std::vector<uint8_t> data(EEPROM_RESERVED_SPACE);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = (uint8_t) (i * 13 + 7);
+    }
+    eeprom_write(0, data.size() / 2, &data[0]);
+    eeprom_write(data.size() / 2, data.size() / 2, &data[data.size() / 2]);
+    std::vector<uint8_t> actual(data.size());
+    eeprom_read(0, actual.size(), actual.data());
+    EXPECT_EQ(data, actual);
+
+    std::fill(actual.begin(), actual.end(), 0);
+    eeprom_stream_open(5);
+    eeprom_stream_read(0, actual.data());
+    eeprom_stream_read(100, actual.data());
+    eeprom_stream_read(actual.size() - 105, actual.data() + 100);
+    eeprom_stream_close();
+    EXPECT_TRUE(std::equal(data.begin() + 5, data.end(), actual.begin()));
+}
+
+TEST_F(EepromTest, eeprom_slot) {
+    // slots must always give the last data written, unless the write didn't complete.
+    constexpr uint8_t LENGTH = 40;
+    constexpr eeprom_t ADDRESS = 50;
+    std::vector<uint8_t> erased(EEPROM_SLOTS_SIZE(LENGTH), 0xff);
+    eeprom_write(ADDRESS, erased.size(), erased.data());
+    std::vector<uint8_t> actual(LENGTH);
+    EXPECT_FALSE(eeprom_slot_read(ADDRESS, LENGTH, actual.data()));
+
+    const auto data_for_write = [](int i) {
+        std::vector<uint8_t> data(LENGTH, (uint8_t) i);
+        data[i % LENGTH] = 0x55;
+        return data;
+    };
+    std::vector<uint8_t> data;
+    for (int i = 0; i < 300; ++i) {
+        data = data_for_write(i);
+        eeprom_slot_write(ADDRESS, LENGTH, data.data());
+        ASSERT_TRUE(eeprom_slot_read(ADDRESS, LENGTH, actual.data()));
+        ASSERT_EQ(data, actual) << "write " << i;
+    }
+
+    // slots start on EEPROM pages, and hold the last two writes.
+    const size_t first = (ADDRESS + sys_eeprom_offset + EEPROM_SLOT_ALIGN - 1) /
+                         EEPROM_SLOT_ALIGN * EEPROM_SLOT_ALIGN - sys_eeprom_offset - ADDRESS;
+    const size_t slot1 = first + EEPROM_SLOT_SIZE(LENGTH);
+    std::vector<uint8_t> slots(EEPROM_SLOTS_SIZE(LENGTH));
+    eeprom_read(ADDRESS, slots.size(), slots.data());
+    std::vector<std::vector<uint8_t>> slot_data;
+    for (size_t start : {first, slot1}) {
+        const auto slot_start = slots.begin() + start + EEPROM_SLOT_HEADER_SIZE;
+        slot_data.emplace_back(slot_start, slot_start + LENGTH);
+    }
+    EXPECT_EQ(slot_data[0], data_for_write(slots[first] == (uint8_t) 300 ? 299 : 298));
+    EXPECT_EQ(slot_data[1], data_for_write(slots[slot1] == (uint8_t) 300 ? 299 : 298));
+
+    // corrupt the newest slot, the previous data must be read.
+    const std::vector<uint8_t> previous = data;
+    data[3] ^= 0xff;
+    eeprom_slot_write(ADDRESS, LENGTH, data.data());
+    eeprom_read(ADDRESS, slots.size(), slots.data());
+    const size_t newest = (uint8_t) (slots[first] - slots[slot1]) == 1 ? first : slot1;
+    slots[newest + EEPROM_SLOT_HEADER_SIZE + 10] ^= 1;
+    eeprom_write(ADDRESS, slots.size(), slots.data());
+    ASSERT_TRUE(eeprom_slot_read(ADDRESS, LENGTH, actual.data()));
+    EXPECT_EQ(previous, actual);
+}
+
+TEST_F(EepromTest, eeprom_write_changed) {
+    // only the changed bytes are written, the result must be the same as writing everything.
+    std::vector<uint8_t> data(70);
+    std::iota(data.begin(), data.end(), 0);
+    eeprom_write(30, data.size(), data.data());
+    for (const auto& [first, last] : std::vector<std::pair<int, int>>{
+            {0, 0}, {69, 69}, {5, 40}, {0, 69}, {-1, -1}}) {
+        if (first >= 0) {
+            for (int i = first; i <= last; i += 7) {
+                data[i] ^= 0x81;
+            }
+            data[last] ^= 0x18;
+        }
+        eeprom_write_changed(30, data.size(), data.data());
+        std::vector<uint8_t> actual(data.size());
+        eeprom_read(30, actual.size(), actual.data());
+        EXPECT_EQ(data, actual) << "changed " << first << " to " << last;
+    }
+
+    // the queued variant gives the same result once the write is done.
+    data[50] ^= 0xff;
+    eeprom_write_changed_async(30, data.size(), data.data());
+    EXPECT_FALSE(eeprom_is_write_done());
+    std::vector<uint8_t> actual(data.size());
+    eeprom_read(30, actual.size(), actual.data());
+    EXPECT_EQ(data, actual);
+
+    // nothing is queued if nothing changed.
+    eeprom_write_changed_async(30, data.size(), data.data());
+    EXPECT_TRUE(eeprom_is_write_done());
+}
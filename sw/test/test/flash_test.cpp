@@ -0,0 +1,117 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sim_test.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+extern "C" {
+#include <core/flash.h>
+#include <sys/flash.h>
+#include <sim/memory.h>
+
+extern SIM_THREAD_LOCAL sim_mem_t* flash;
+}
+
+class FlashTest : public SimTest {};
+
+TEST_F(FlashTest, flash_stream) {
+    // reading a stream in chunks must give the same data as a single read.
+    std::vector<uint8_t> data(300);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = (uint8_t) (i * 13 + 7);
+    }
+    sim_mem_write(flash, 0x100, data.size(), data.data());
+    std::vector<uint8_t> actual(data.size());
+    flash_stream_open(0x100);
+    size_t pos = 0;
+    for (uint16_t length : {1, 0, 16, 3, 200, 80}) {
+        flash_stream_read(length, actual.data() + pos);
+        pos += length;
+    }
+    flash_stream_close();
+    EXPECT_EQ(data, actual);
+}
+
+TEST_F(FlashTest, flash_read_crc) {
+    // CRC computed while reading must match the CRC-16/MCRF4XX check value.
+    const char* data = "123456789";
+    sim_mem_write(flash, 0x200, 9, (const uint8_t*) data);
+    uint8_t actual[9];
+    uint16_t crc = sys_flash_read_crc(0x200, 4, actual, 0xffff);
+    crc = sys_flash_read_crc(0x204, 5, actual + 4, crc);
+    EXPECT_EQ(crc, 0x6f91);
+    EXPECT_EQ(memcmp(actual, data, 9), 0);
+}
+
+TEST_F(FlashTest, flash_space_write) {
+    // writes to the data space must cross pages and only be possible after an erase.
+    constexpr flash_t SPACE_ADDRESS = 0x10000;
+    sys_flash_set_space_location(SPACE_ADDRESS, 2);
+    EXPECT_EQ(flash_space_size(), 2 * FLASH_SECTOR_SIZE);
+
+    std::vector<uint8_t> data(600);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = (uint8_t) (i * 13 + 7);
+    }
+    flash_space_erase(FLASH_SECTOR_SIZE + 100);
+    flash_space_write(FLASH_SECTOR_SIZE + 100, data.size(), data.data());
+    std::vector<uint8_t> actual(data.size());
+    flash_space_read(FLASH_SECTOR_SIZE + 100, actual.size(), actual.data());
+    EXPECT_FALSE(flash_space_is_busy());
+    EXPECT_EQ(data, actual);
+
+    // erasing sets the whole sector to 0xff, writing past the end of the space does nothing.
+    flash_space_erase(FLASH_SECTOR_SIZE);
+    flash_space_write(2 * FLASH_SECTOR_SIZE - 10, data.size(), data.data());
+    flash_space_read(FLASH_SECTOR_SIZE + 100, actual.size(), actual.data());
+    EXPECT_EQ(std::vector<uint8_t>(data.size(), 0xff), actual);
+    sys_flash_set_space_location(0, 0);
+}
+
+TEST_F(FlashTest, flash_read_during_erase) {
+    // reads started right after an erase or a write must wait for the flash to be ready.
+    constexpr flash_t SPACE_ADDRESS = 0x10000;
+    sys_flash_set_space_location(SPACE_ADDRESS, 2);
+    std::vector<uint8_t> data(300);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = (uint8_t) (i * 13 + 7);
+    }
+    sim_mem_write(flash, 0x100, data.size(), data.data());
+
+    std::vector<uint8_t> actual(data.size());
+    flash_space_erase(0);
+    flash_read(0x100, actual.size(), actual.data());
+    EXPECT_EQ(data, actual);
+
+    std::fill(actual.begin(), actual.end(), 0);
+    flash_space_write(0, data.size(), data.data());
+    flash_stream_open(0x100);
+    flash_stream_read(actual.size(), actual.data());
+    flash_stream_close();
+    EXPECT_EQ(data, actual);
+
+    // polling the flash state doesn't prevent waiting before a read.
+    flash_space_erase(FLASH_SECTOR_SIZE);
+    EXPECT_TRUE(flash_space_is_busy());
+    EXPECT_FALSE(flash_space_is_busy());
+    EXPECT_FALSE(flash_space_is_busy());
+    flash_space_read(0, actual.size(), actual.data());
+    EXPECT_EQ(data, actual);
+    sys_flash_set_space_location(0, 0);
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark for the graphics module: each primitive is drawn on full frames for a few page
+ * heights and assets, and the host time and flash bytes read per frame are reported.
+ * Assets are read from the simulated flash, like on the game console. Results are printed and
+ * written to a CSV file, to compare optimizations of core/graphics.c against a baseline.
+ * This is built without sanitizers and with optimizations, see the `bench` target.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <core/graphics.h>
+
+#include <boot/init.h>
+#include <boot/display.h>
+
+#include <sys/display.h>
+
+#include <sim/memory.h>
+#include <sim/spi.h>
+
+extern SIM_THREAD_LOCAL sim_mem_t* flash;
+}
+
+// page heights benchmarked, from the smallest to the full display.
+static const std::vector<uint8_t> PAGE_HEIGHTS{8, 16, 32, 64, 128};
+
+// number of frames drawn for each case.
+constexpr uint32_t FRAMES = 200;
+
+// address at which the asset used by a case is written in flash.
+constexpr flash_t ASSET_ADDRESS = 0x10000;
+
+static const char* RESULTS_FILE = "output/graphics_bench.csv";
+
+// uppercase only, since some of the fonts have no lowercase letters.
+static const char* TEXT = "LOREM IPSUM DOLOR SIT AMET, CONSECTETUR ADIPISCING ELIT, SED DO "
+                          "EIUSMOD TEMPOR INCIDIDUNT UT LABORE ET DOLORE MAGNA ALIQUA. UT ENIM "
+                          "AD MINIM VENIAM, QUIS NOSTRUD EXERCITATION ULLAMCO LABORIS NISI UT "
+                          "ALIQUIP EX EA COMMODO CONSEQUAT.";
+
+struct BenchCase {
+    std::string primitive;
+    // asset written to flash before drawing, or empty if none.
+    std::string asset;
+    // draw the primitive on the current page, with the asset address.
+    std::function<void(graphics_image_t)> draw;
+};
+
+static std::vector<uint8_t> load_asset(const std::string& filename) {
+    std::ifstream in("assets/" + filename, std::ios::binary);
+    if (!in.good()) {
+        throw std::runtime_error("could not load asset file " + filename);
+    }
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+static std::vector<BenchCase> create_cases() {
+    std::vector<BenchCase> cases;
+    for (const char* asset: {"chess49x54.dat", "logo.dat", "logo-alpha.dat", "lena.dat"}) {
+        cases.push_back({"graphics_image_4bit_mixed", asset, [](graphics_image_t image) {
+            graphics_image_4bit_mixed(image, 3, 2);
+        }});
+    }
+    for (const char* asset: {"font5x7.dat", "font7x7.dat", "font16x16.dat"}) {
+        cases.push_back({"graphics_text_wrap", asset, [](graphics_image_t font) {
+            graphics_set_font(font);
+            graphics_text_wrap(0, 0, DISPLAY_WIDTH, TEXT);
+        }});
+    }
+    cases.push_back({"graphics_text_wrap", "builtin", [](graphics_image_t) {
+        graphics_set_font(GRAPHICS_BUILTIN_FONT);
+        graphics_text_wrap(0, 0, DISPLAY_WIDTH, TEXT);
+    }});
+    cases.push_back({"graphics_line", "", [](graphics_image_t) {
+        for (disp_x_t i = 0; i < DISPLAY_WIDTH; i += 8) {
+            graphics_line(i, 0, DISPLAY_WIDTH - 1 - i, DISPLAY_HEIGHT - 1);
+            graphics_line(0, i, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1 - i);
+        }
+    }});
+    cases.push_back({"graphics_fill_rect", "", [](graphics_image_t) {
+        for (disp_x_t i = 0; i < DISPLAY_WIDTH / 2; i += 8) {
+            graphics_set_color(i / 4);
+            graphics_fill_rect(i, i, DISPLAY_WIDTH - 2 * i, DISPLAY_HEIGHT - 2 * i);
+        }
+        graphics_set_color(DISPLAY_COLOR_WHITE);
+    }});
+    return cases;
+}
+
+int main() {
+    sys_init();
+    graphics_set_color(DISPLAY_COLOR_WHITE);
+
+    std::filesystem::create_directories("output/");
+    std::ofstream results(RESULTS_FILE);
+    results << "primitive,asset,page_height,frames,ns_per_frame,flash_bytes_per_frame\n";
+
+    for (const BenchCase& bench: create_cases()) {
+        graphics_image_t image = data_flash(ASSET_ADDRESS);
+        if (!bench.asset.empty() && bench.asset != "builtin") {
+            const auto data = load_asset(bench.asset);
+            sim_mem_write(flash, ASSET_ADDRESS, data.size(), data.data());
+        }
+
+        for (uint8_t page_height: PAGE_HEIGHTS) {
+            sys_display_init_page(page_height);
+            const uint64_t start_bytes = sim_spi_get_flash_bytes();
+            const auto start_time = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < FRAMES; ++i) {
+                sys_display_first_page();
+                do {
+                    graphics_clear(DISPLAY_COLOR_BLACK);
+                    bench.draw(image);
+                } while (sys_display_next_page());
+            }
+            const double elapsed = std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - start_time).count();
+            const double ns_per_frame = elapsed / FRAMES;
+            const double bytes_per_frame =
+                    (double) (sim_spi_get_flash_bytes() - start_bytes) / FRAMES;
+
+            std::cout << std::left << std::setw(26) << bench.primitive
+                      << std::setw(16) << bench.asset << std::right
+                      << " page " << std::setw(3) << (int) page_height << ": "
+                      << std::fixed << std::setprecision(1) << std::setw(10)
+                      << ns_per_frame / 1000 << " us/frame, " << std::setw(8)
+                      << bytes_per_frame << " flash bytes/frame" << std::endl;
+            results << std::fixed << bench.primitive << "," << bench.asset << "," << (int) page_height << ","
+                    << FRAMES << "," << std::setprecision(0) << ns_per_frame << ","
+                    << std::setprecision(1) << bytes_per_frame << "\n";
+        }
+    }
+
+    std::cout << "Results written to " << RESULTS_FILE << std::endl;
+    return 0;
+}
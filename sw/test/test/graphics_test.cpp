@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include "sim_test.h"
+
 #include <gtest/gtest.h>
 #include <zlib.h>
 #include <png.h>
@@ -24,18 +26,33 @@
 #include <string>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <filesystem>
 #include <algorithm>
 #include <numeric>
+#include <functional>
+#include <tuple>
+#include <random>
+#include <thread>
 
 extern "C" {
 #include <core/display.h>
+#include <core/displist.h>
+#include <core/framecache.h>
 #include <core/graphics.h>
+#include <core/sprite.h>
 
 #include <boot/init.h>
 #include <boot/display.h>
 
 #include <sys/display.h>
+#include <sys/flash.h>
+
+#include <sim/display.h>
+#include <sim/init.h>
+#include <sim/memory.h>
+
+extern SIM_THREAD_LOCAL sim_mem_t* flash;
 }
 
 // when set to true, test that have no reference frames will save them and skip the test.
@@ -188,6 +205,10 @@ protected:
         sys_init();
     }
 
+    static void TearDownTestSuite() {
+        sim_deinit();
+    }
+
     void SetUp() override {
         if (SAVE_REFERENCE) {
             no_reference = true;
@@ -309,6 +330,19 @@ static std::vector<uint8_t> load_asset(const std::string& filename) {
     return data;
 }
 
+class DisplayTest : public SimTest {};
+class GraphicsCacheTest : public SimTest {};
+class GraphicsClipTest : public SimTest {};
+class GraphicsDisplistTest : public SimTest {};
+class GraphicsFlashTest : public SimTest {};
+class GraphicsFontTest : public SimTest {};
+class GraphicsFuzzTest : public SimTest {};
+class GraphicsRectTest : public SimTest {};
+class GraphicsScaledTest : public SimTest {};
+class GraphicsSpriteTest : public SimTest {};
+class GraphicsStaticTest : public SimTest {};
+class GraphicsTilemapTest : public SimTest {};
+
 TEST_F(GraphicsTest, graphics_pixel) {
     graphics_test([&]() {
         do_test([=]() {
@@ -684,3 +718,994 @@ TEST_F(GraphicsTest, graphics_text_wrap) {
         }
     });
 }
+
+TEST_F(DisplayTest, display_dirty_rows) {
+    for (uint8_t page_height : PAGE_HEIGHTS) {
+        sys_display_init_page(page_height);
+        sys_display_first_page();
+        do {
+            graphics_clear(DISPLAY_COLOR_WHITE);
+        } while (sys_display_next_page());
+
+        // only the pages covering the dirty rows should be refreshed.
+        display_set_dirty_rows(40, 50);
+        size_t ystart = 40 / page_height * page_height;
+        size_t yend = std::min((size_t) (50 / page_height + 1) * page_height, (size_t) DISPLAY_HEIGHT);
+        sys_display_first_page();
+        do {
+            EXPECT_GE(sys_display_page_ystart, ystart);
+            graphics_clear(DISPLAY_COLOR_BLACK);
+        } while (sys_display_next_page());
+        for (size_t y = 0; y < DISPLAY_HEIGHT; ++y) {
+            uint8_t expected = (y >= ystart && y < yend) ? 0x00 : 0xff;
+            const uint8_t* row = sim_display_data() + y * DISPLAY_NUM_COLS;
+            ASSERT_TRUE(std::all_of(row, row + DISPLAY_NUM_COLS, [=](uint8_t b) {
+                return b == expected;
+            })) << "row " << y << ", with page height " << (int) page_height;
+        }
+
+        // the next frame is a full refresh again.
+        sys_display_first_page();
+        EXPECT_EQ(sys_display_page_ystart, 0);
+        while (sys_display_next_page()) {}
+    }
+}
+
+static Frame draw_frame(const std::function<void()>& draw) {
+    sys_display_first_page();
+    do {
+        graphics_clear(DISPLAY_COLOR_BLACK);
+        draw();
+    } while (sys_display_next_page());
+    Frame frame;
+    std::copy_n(sim_display_data(), DISPLAY_SIZE, frame.begin());
+    return frame;
+}
+
+TEST(SimulationTest, parallel_consoles) {
+    // each thread simulates its own console, so consoles drawing at the same time
+    // must give the same frames as when they're run one after the other.
+    constexpr size_t CONSOLES = 8;
+    constexpr size_t FRAMES = 16;
+    auto run_console = [](size_t i, std::vector<Frame>& frames) {
+        sys_init();
+        sys_display_init_page(PAGE_HEIGHTS[i % PAGE_HEIGHTS.size()]);
+        for (size_t j = 0; j < FRAMES; ++j) {
+            frames.push_back(draw_frame([=]() {
+                graphics_set_color((disp_color_t) (i * 2 + 1));
+                graphics_fill_rect(i * 4 + j, j * 2, 40, 30 + i);
+                graphics_set_color((disp_color_t) (15 - i));
+                graphics_line(0, i * 8, DISPLAY_WIDTH - 1 - j * 3, DISPLAY_HEIGHT - 1);
+            }));
+        }
+        sim_deinit();
+    };
+
+    std::vector<std::vector<Frame>> expected(CONSOLES);
+    for (size_t i = 0; i < CONSOLES; ++i) {
+        std::thread(run_console, i, std::ref(expected[i])).join();
+    }
+
+    std::vector<std::vector<Frame>> actual(CONSOLES);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < CONSOLES; ++i) {
+        threads.emplace_back(run_console, i, std::ref(actual[i]));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (size_t i = 0; i < CONSOLES; ++i) {
+        ASSERT_EQ(actual[i].size(), FRAMES);
+        for (size_t j = 0; j < FRAMES; ++j) {
+            EXPECT_TRUE(actual[i][j] == expected[i][j]) << "console " << i << ", frame " << j;
+        }
+    }
+}
+
+TEST_F(GraphicsCacheTest, graphics_image_cache) {
+    // cached images must be drawn exactly the same as the original images.
+    sys_display_init_page(PAGE_HEIGHTS[0]);
+    graphics_set_color(DISPLAY_COLOR_WHITE);
+    using image_func_t = void (*)(graphics_image_t, uint8_t, uint8_t);
+    const std::vector<std::tuple<std::string, image_func_t, image_func_t>> images{
+            {"castle-bin.dat", graphics_image_1bit_mixed, graphics_image_1bit_raw},
+            {"chess49x54-bin.dat", graphics_image_1bit_mixed, graphics_image_1bit_raw},
+            {"chess49x54.dat", graphics_image_4bit_mixed, graphics_image_4bit_raw},
+            {"logo.dat", graphics_image_4bit_mixed, graphics_image_4bit_raw},
+            {"logo-alpha.dat", graphics_image_4bit_mixed, graphics_image_4bit_raw},
+            {"lena.dat", graphics_image_4bit_mixed, graphics_image_4bit_raw},
+    };
+    for (const auto& [asset, func, cached_func]: images) {
+        const auto image = load_asset(asset);
+        const auto image_data = data_mcu(image.data());
+        std::vector<uint8_t> buffer(GRAPHICS_IMAGE_CACHE_SIZE(128, 128, 4));
+        const auto cached_data = graphics_image_cache(image_data, buffer.data(), buffer.size());
+        ASSERT_NE(cached_data, 0) << asset;
+
+        // odd and even X, the raw 4-bit image is copied by whole bytes if aligned.
+        for (uint8_t x : {1, 2}) {
+            const Frame expected = draw_frame([&]() { func(image_data, x, 2); });
+            const Frame actual = draw_frame([&]() { cached_func(cached_data, x, 2); });
+            EXPECT_EQ(expected, actual) << "cached image differs for " << asset << " at x=" << (int) x;
+        }
+    }
+}
+
+TEST_F(GraphicsCacheTest, graphics_image_4bit_raw_alpha) {
+    // 4x2 raw image with alpha color 5, both aligned and unaligned drawing.
+    sys_display_init_page(PAGE_HEIGHTS[0]);
+    const uint8_t image[] = {0xf1, 0x65, 3, 1, 0x15, 0x52, 0x53, 0x45};
+    const uint8_t pixels[2][4] = {{5, 1, 2, 5}, {3, 5, 5, 4}};
+    for (uint8_t x : {2, 3}) {
+        const auto draw_background = [&]() {
+            graphics_set_color(9);
+            graphics_fill_rect(0, 0, 16, 16);
+        };
+        const Frame expected = draw_frame([&]() {
+            draw_background();
+            for (uint8_t py = 0; py < 2; ++py) {
+                for (uint8_t px = 0; px < 4; ++px) {
+                    if (pixels[py][px] != 5) {
+                        graphics_set_color(pixels[py][px]);
+                        graphics_pixel(x + px, 7 + py);
+                    }
+                }
+            }
+        });
+        const Frame actual = draw_frame([&]() {
+            draw_background();
+            graphics_image_4bit_raw(data_mcu(image), x, 7);
+        });
+        EXPECT_EQ(expected, actual) << "x=" << (int) x;
+    }
+}
+
+TEST_F(GraphicsScaledTest, graphics_image_raw_scaled) {
+    // scaled images must be drawn the same as each pixel drawn as a square, on all page heights,
+    // both aligned and unaligned, and clipped at the bottom of display.
+    const uint8_t image_4bit[] = {0xf1, 0x65, 3, 1, 0x15, 0x52, 0x53, 0x45};
+    const uint8_t pixels_4bit[2][4] = {{5, 1, 2, 5}, {3, 5, 5, 4}};
+    const uint8_t image_1bit[] = {0xf1, 0x30, 8, 1, 0x5a, 0x01, 0xc3, 0x00};
+    for (uint8_t page_height : PAGE_HEIGHTS) {
+        sys_display_init_page(page_height);
+        for (uint8_t factor : {2, 3, 4}) {
+            for (uint8_t x : {2, 3}) {
+                for (uint8_t y : {7, 40, DISPLAY_HEIGHT - 5}) {
+                    const auto draw_background = [&]() {
+                        graphics_set_color(9);
+                        graphics_fill_rect(0, y - 2, 48, 20);
+                    };
+                    Frame expected = draw_frame([&]() {
+                        draw_background();
+                        for (uint8_t py = 0; py < 2; ++py) {
+                            for (uint8_t px = 0; px < 4; ++px) {
+                                if (pixels_4bit[py][px] != 5) {
+                                    graphics_set_color(pixels_4bit[py][px]);
+                                    graphics_fill_rect(x + px * factor, y + py * factor,
+                                                       factor, factor);
+                                }
+                            }
+                        }
+                    });
+                    Frame actual = draw_frame([&]() {
+                        draw_background();
+                        graphics_image_4bit_raw_scaled(data_mcu(image_4bit), x, y, factor);
+                    });
+                    EXPECT_EQ(expected, actual) << "4-bit, page height " << (int) page_height <<
+                        ", factor " << (int) factor << ", x=" << (int) x << ", y=" << (int) y;
+
+                    expected = draw_frame([&]() {
+                        draw_background();
+                        graphics_set_color(DISPLAY_COLOR_WHITE);
+                        for (uint8_t py = 0; py < 2; ++py) {
+                            for (uint8_t px = 0; px < 9; ++px) {
+                                if (image_1bit[4 + py * 2 + px / 8] & (1 << (px % 8))) {
+                                    graphics_fill_rect(x + px * factor, y + py * factor,
+                                                       factor, factor);
+                                }
+                            }
+                        }
+                    });
+                    actual = draw_frame([&]() {
+                        draw_background();
+                        graphics_set_color(DISPLAY_COLOR_WHITE);
+                        graphics_image_1bit_raw_scaled(data_mcu(image_1bit), x, y, factor);
+                    });
+                    EXPECT_EQ(expected, actual) << "1-bit, page height " << (int) page_height <<
+                        ", factor " << (int) factor << ", x=" << (int) x << ", y=" << (int) y;
+                }
+            }
+        }
+    }
+}
+
+TEST_F(GraphicsRectTest, graphics_image_raw_rect) {
+    // a region of a sheet must be drawn the same as its pixels, for odd and even bounds,
+    // including the whole sheet width which is read as a single stream.
+    constexpr uint8_t width = 21;
+    constexpr uint8_t height = 5;
+    std::vector<uint8_t> sheet_4bit{0xf1, 0x65, width - 1, height - 1};
+    std::vector<uint8_t> sheet_1bit{0xf1, 0x30, width - 1, height - 1};
+    const auto pixel_4bit = [](uint8_t px, uint8_t py) { return (uint8_t) ((px * 3 + py * 7) % 16); };
+    const auto pixel_1bit = [](uint8_t px, uint8_t py) { return ((px + py) % 3) == 0; };
+    for (uint8_t py = 0; py < height; ++py) {
+        for (uint8_t px = 0; px < width; px += 2) {
+            sheet_4bit.push_back(pixel_4bit(px, py) | (px + 1 < width ? pixel_4bit(px + 1, py) << 4 : 0));
+        }
+        for (uint8_t px = 0; px < width; px += 8) {
+            uint8_t byte = 0;
+            for (uint8_t i = 0; i < 8 && px + i < width; ++i) {
+                byte |= pixel_1bit(px + i, py) << i;
+            }
+            sheet_1bit.push_back(byte);
+        }
+    }
+    const std::vector<std::array<uint8_t, 4>> rects{{0, 0, width - 1, height - 1},
+                                                    {3, 1, 10, 3}, {4, 0, 9, 4}, {9, 2, 17, 2}};
+    for (uint8_t page_height : PAGE_HEIGHTS) {
+        sys_display_init_page(page_height);
+        for (const auto& [left, top, right, bottom] : rects) {
+            for (uint8_t x : {2, 3}) {
+                const auto draw_background = [&]() {
+                    graphics_set_color(9);
+                    graphics_fill_rect(0, 38, 32, 12);
+                };
+                Frame expected = draw_frame([&]() {
+                    draw_background();
+                    for (uint8_t py = top; py <= bottom; ++py) {
+                        for (uint8_t px = left; px <= right; ++px) {
+                            if (pixel_4bit(px, py) != 5) {
+                                graphics_set_color(pixel_4bit(px, py));
+                                graphics_pixel(x + px - left, 40 + py - top);
+                            }
+                        }
+                    }
+                });
+                Frame actual = draw_frame([&]() {
+                    draw_background();
+                    graphics_image_4bit_raw_rect(data_mcu(sheet_4bit.data()), x, 40,
+                                                 left, top, right, bottom);
+                });
+                EXPECT_EQ(expected, actual) << "4-bit, page height " << (int) page_height <<
+                    ", left " << (int) left << ", x=" << (int) x;
+
+                expected = draw_frame([&]() {
+                    draw_background();
+                    graphics_set_color(DISPLAY_COLOR_WHITE);
+                    for (uint8_t py = top; py <= bottom; ++py) {
+                        for (uint8_t px = left; px <= right; ++px) {
+                            if (pixel_1bit(px, py)) {
+                                graphics_pixel(x + px - left, 40 + py - top);
+                            }
+                        }
+                    }
+                });
+                actual = draw_frame([&]() {
+                    draw_background();
+                    graphics_set_color(DISPLAY_COLOR_WHITE);
+                    graphics_image_1bit_raw_rect(data_mcu(sheet_1bit.data()), x, 40,
+                                                 left, top, right, bottom);
+                });
+                EXPECT_EQ(expected, actual) << "1-bit, page height " << (int) page_height <<
+                    ", left " << (int) left << ", x=" << (int) x;
+            }
+        }
+    }
+}
+
+struct FuzzImage {
+    uint8_t width;
+    uint8_t height;
+    // color of each pixel by row, 0xff for transparent. binary images use 0 and 1.
+    std::vector<uint8_t> pixels;
+    // the image in each encoding, see gen_fuzz_images.py.
+    std::vector<std::vector<uint8_t>> encodings;
+};
+
+static std::vector<FuzzImage> load_fuzz_images(const std::string& filename) {
+    const auto data = load_asset(filename);
+    std::vector<FuzzImage> images;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        FuzzImage image;
+        image.width = data[pos];
+        image.height = data[pos + 1];
+        const uint8_t encodings = data[pos + 2];
+        pos += 3;
+        const size_t size = image.width * image.height;
+        image.pixels.assign(data.begin() + pos, data.begin() + pos + size);
+        pos += size;
+        for (uint8_t i = 0; i < encodings; ++i) {
+            const size_t length = data[pos] | data[pos + 1] << 8;
+            pos += 2;
+            image.encodings.emplace_back(data.begin() + pos, data.begin() + pos + length);
+            pos += length;
+        }
+        images.push_back(std::move(image));
+    }
+    return images;
+}
+
+TEST_F(GraphicsFuzzTest, graphics_image_differential) {
+    // images encoded with the assets packer encoders are drawn with random positions, regions,
+    // colors and page heights, from RAM and from flash, with every drawing function that applies
+    // to their encoding. The result must be the same as drawing each pixel with a straightforward
+    // reference renderer on the host. The seed is fixed so that a failure can be reproduced.
+    constexpr uint32_t SEED = 0x5eed;
+    constexpr size_t TRIALS_PER_ENCODING = 16;
+    constexpr flash_t FLASH_ADDRESS = 0x1234;
+    constexpr uint8_t FLAG_BINARY = 0x10;
+    constexpr uint8_t FLAG_RAW = 0x20;
+    constexpr uint8_t FLAG_ALPHA = 0x40;
+    constexpr uint8_t LZ_SIGNATURE = 0xf3;
+    enum { DRAW_FULL, DRAW_REGION, DRAW_RECT, DRAW_SCALED };
+    const char* DRAW_NAMES[] = {"full", "region", "rect", "scaled"};
+
+    std::mt19937 rng(SEED);
+    const auto random = [&](int min, int max) {
+        return (uint8_t) std::uniform_int_distribution<int>(min, max)(rng);
+    };
+    const auto images = load_fuzz_images("fuzz-images.dat");
+    ASSERT_FALSE(images.empty());
+
+    for (size_t n = 0; n < images.size(); ++n) {
+        const FuzzImage& image = images[n];
+        for (size_t e = 0; e < image.encodings.size(); ++e) {
+            const auto& encoding = image.encodings[e];
+            const uint8_t flags = encoding[1];
+            const bool lz = encoding[0] == LZ_SIGNATURE;
+            const bool binary = flags & FLAG_BINARY;
+            const bool raw = flags & FLAG_RAW;
+            const uint8_t alpha_color = flags & FLAG_ALPHA ? flags & 0xf : 0xff;
+            sim_mem_write(flash, FLASH_ADDRESS, encoding.size(), encoding.data());
+
+            for (size_t trial = 0; trial < TRIALS_PER_ENCODING; ++trial) {
+                const uint8_t page_height = PAGE_HEIGHTS[random(0, PAGE_HEIGHTS.size() - 1)];
+                const auto mode = random(DRAW_FULL, raw ? DRAW_SCALED : DRAW_REGION);
+                const bool from_flash = random(0, 1);
+                const uint8_t color = random(1, 15);
+                const uint8_t background = random(0, 15);
+
+                // region of the image drawn, bounds are inclusive.
+                uint8_t left = 0;
+                uint8_t top = 0;
+                uint8_t right = image.width - 1;
+                uint8_t bottom = image.height - 1;
+                uint8_t factor = 1;
+                if (mode == DRAW_REGION || mode == DRAW_RECT) {
+                    top = random(0, image.height - 1);
+                    bottom = random(top, image.height - 1);
+                }
+                if (mode == DRAW_RECT) {
+                    left = random(0, image.width - 1);
+                    right = random(left, image.width - 1);
+                }
+                if (mode == DRAW_SCALED) {
+                    factor = random(2, 4);
+                    while (factor > 1 && image.width * factor > DISPLAY_WIDTH) {
+                        --factor;
+                    }
+                }
+                const uint8_t drawn_width = (right - left + 1) * factor;
+                const uint8_t x = random(0, DISPLAY_WIDTH - drawn_width);
+                const uint8_t y = random(0, DISPLAY_HEIGHT - 1);
+
+                // reference: each pixel of the region drawn as a square, clipped at the bottom.
+                std::vector<uint8_t> pixels(DISPLAY_WIDTH * DISPLAY_HEIGHT, background);
+                for (uint8_t py = top; py <= bottom; ++py) {
+                    for (uint8_t px = left; px <= right; ++px) {
+                        uint8_t c = image.pixels[py * image.width + px];
+                        if (binary) {
+                            if (c == 0) {
+                                continue;
+                            }
+                            c = color;
+                        } else if (c == 0xff || c == alpha_color) {
+                            continue;
+                        }
+                        for (uint8_t i = 0; i < factor * factor; ++i) {
+                            const size_t dx = x + (px - left) * factor + i % factor;
+                            const size_t dy = y + (py - top) * factor + i / factor;
+                            if (dy < DISPLAY_HEIGHT) {
+                                pixels[dy * DISPLAY_WIDTH + dx] = c;
+                            }
+                        }
+                    }
+                }
+                Frame expected;
+                for (size_t i = 0; i < DISPLAY_SIZE; ++i) {
+                    expected[i] = pixels[i * 2] | pixels[i * 2 + 1] << 4;
+                }
+
+                sys_display_init_page(page_height);
+                const graphics_image_t data = from_flash ?
+                        data_flash(FLASH_ADDRESS) : data_mcu(encoding.data());
+                const Frame actual = draw_frame([&]() {
+                    graphics_set_color(background);
+                    graphics_fill_rect(0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT);
+                    graphics_set_color(color);
+                    if (lz) {
+                        if (mode == DRAW_FULL) {
+                            graphics_image_4bit_lz(data, x, y);
+                        } else {
+                            graphics_image_4bit_lz_region(data, x, y, top, bottom);
+                        }
+                    } else if (mode == DRAW_FULL) {
+                        (binary ? (raw ? graphics_image_1bit_raw : graphics_image_1bit_mixed) :
+                         (raw ? graphics_image_4bit_raw : graphics_image_4bit_mixed))(data, x, y);
+                    } else if (mode == DRAW_REGION) {
+                        (binary ? (raw ? graphics_image_1bit_raw_region :
+                                   graphics_image_1bit_mixed_region) :
+                         (raw ? graphics_image_4bit_raw_region :
+                          graphics_image_4bit_mixed_region))(data, x, y, top, bottom);
+                    } else if (mode == DRAW_RECT) {
+                        (binary ? graphics_image_1bit_raw_rect : graphics_image_4bit_raw_rect)(
+                                data, x, y, left, top, right, bottom);
+                    } else {
+                        (binary ? graphics_image_1bit_raw_scaled : graphics_image_4bit_raw_scaled)(
+                                data, x, y, factor);
+                    }
+                });
+                EXPECT_EQ(expected, actual) << "image " << n << " (" << (int) image.width << "x" <<
+                    (int) image.height << "), encoding " << e << ", trial " << trial << ": " <<
+                    DRAW_NAMES[mode] << " at (" << (int) x << ", " << (int) y << "), region (" <<
+                    (int) left << ", " << (int) top << ", " << (int) right << ", " <<
+                    (int) bottom << "), factor " << (int) factor << ", page height " <<
+                    (int) page_height << (from_flash ? ", from flash" : "");
+            }
+
+            if (lz) {
+                // decoded LZ data is the same as the raw encoding, which is the first one.
+                std::vector<uint8_t> cache(GRAPHICS_IMAGE_CACHE_SIZE(image.width, image.height, 4));
+                graphics_image_cache(data_flash(FLASH_ADDRESS), cache.data(), cache.size());
+                EXPECT_EQ(image.encodings[0], cache) << "image " << n << ", cached LZ image";
+            }
+        }
+    }
+}
+
+TEST_F(GraphicsFuzzTest, graphics_image_4bit_lz_interleaved) {
+    // LZ images drawn on the same pages replace each other's decoder state, and an image drawn
+    // twice resumes from the wrong row. Both must be decoded again from the start when needed.
+    const auto images = load_fuzz_images("fuzz-images.dat");
+    std::vector<const FuzzImage*> lz_images;
+    for (const FuzzImage& image : images) {
+        if (image.encodings.back()[0] == 0xf3 && image.height >= 32 && image.width <= 60) {
+            lz_images.push_back(&image);
+        }
+    }
+    ASSERT_GE(lz_images.size(), 2);
+    const FuzzImage& a = *lz_images[0];
+    const FuzzImage& b = *lz_images[1];
+    const auto draw = [&](size_t encoding) {
+        const auto a_data = data_mcu(a.encodings[encoding].data());
+        const auto b_data = data_mcu(b.encodings[encoding].data());
+        const bool lz = encoding != 0;
+        (lz ? graphics_image_4bit_lz : graphics_image_4bit_raw)(a_data, 0, 3);
+        (lz ? graphics_image_4bit_lz : graphics_image_4bit_raw)(b_data, 64, 10);
+        (lz ? graphics_image_4bit_lz : graphics_image_4bit_raw)(a_data, 64, 70);
+    };
+    for (const uint8_t page_height : PAGE_HEIGHTS) {
+        sys_display_init_page(page_height);
+        const Frame expected = draw_frame([&]() { draw(0); });
+        const Frame actual = draw_frame([&]() {
+            draw(a.encodings.size() - 1);
+        });
+        EXPECT_EQ(expected, actual) << "page height " << (int) page_height;
+    }
+}
+
+TEST_F(GraphicsCacheTest, graphics_font_cache) {
+    // glyphs drawn from the font cache must be the same as glyphs read from font data.
+    sys_display_init_page(PAGE_HEIGHTS[0]);
+    graphics_set_color(DISPLAY_COLOR_WHITE);
+    graphics_set_font(GRAPHICS_BUILTIN_FONT);
+    const char* text = "!09:AZ HELLO, WORLD";
+    const Frame expected = draw_frame([&]() { graphics_text(1, 60, text); });
+
+    // cache only part of the glyphs, others are still read from font data.
+    uint8_t buffer[32];
+    EXPECT_EQ(graphics_set_font_cache(buffer, sizeof buffer, '0'), 16);
+    const Frame actual = draw_frame([&]() { graphics_text(1, 60, text); });
+    EXPECT_EQ(expected, actual);
+
+    // cache is limited by the number of glyphs in font, and cleared when font is set.
+    EXPECT_EQ(graphics_set_font_cache(buffer, sizeof buffer, 'Y'), 2);
+    graphics_set_font(GRAPHICS_BUILTIN_FONT);
+    EXPECT_EQ(graphics_font.cache_count, 0);
+}
+
+TEST_F(GraphicsDisplistTest, displist_replay) {
+    // commands replayed from the display list must be drawn the same as when drawn directly.
+    graphics_set_font(GRAPHICS_BUILTIN_FONT);
+    const auto image = load_asset("chess49x54.dat");
+    const auto image_data = data_mcu(image.data());
+    static const char* text = "HELLO, WORLD";
+    const auto draw = [&](bool use_list) {
+        if (use_list && !displist_begin()) {
+            return;
+        }
+        graphics_set_color(7);
+        displist_fill_rect(3, 5, 100, 90);
+        graphics_set_color(DISPLAY_COLOR_WHITE);
+        displist_rect(0, 30, 128, 60);
+        displist_image_4bit_mixed(image_data, 40, 50);
+        displist_text(2, 120, text);
+        graphics_set_color(DISPLAY_COLOR_BLACK);
+        displist_text(10, -2, text);
+    };
+    for (uint8_t page_height : PAGE_HEIGHTS) {
+        sys_display_init_page(page_height);
+        displist_init(nullptr, 0);
+        const Frame expected = draw_frame([&]() { draw(false); });
+
+        displist_cmd_t buffer[8];
+        displist_init(buffer, 8);
+        const Frame actual = draw_frame([&]() { draw(true); });
+        EXPECT_EQ(expected, actual) << "page height " << (int) page_height;
+
+        // the frame is drawn normally if the list overflows.
+        displist_init(buffer, 2);
+        const Frame overflow = draw_frame([&]() { draw(true); });
+        EXPECT_EQ(expected, overflow) << "page height " << (int) page_height;
+    }
+    displist_init(nullptr, 0);
+}
+
+TEST_F(GraphicsSpriteTest, sprite_draw_page) {
+    // sprites must be drawn in Y order, like images drawn directly from top to bottom.
+    const auto image = load_asset("logo-alpha.dat");
+    const auto image_data = data_mcu(image.data());
+    sprite_t sprites[3];
+    sprite_init(sprites, 3);
+    sprite_show(0, image_data, 10, 70);
+    sprite_show(1, image_data, 20, 5);
+    sprite_show(2, image_data, 30, 40);
+    sprite_move(0, 15, 30);
+    sprite_hide(2);
+    sprite_show(2, image_data, 5, 60);
+    for (uint8_t page_height : PAGE_HEIGHTS) {
+        sys_display_init_page(page_height);
+        const Frame expected = draw_frame([&]() {
+            graphics_image_4bit_mixed(image_data, 20, 5);
+            graphics_image_4bit_mixed(image_data, 15, 30);
+            graphics_image_4bit_mixed(image_data, 5, 60);
+        });
+        const Frame actual = draw_frame(sprite_draw_page);
+        EXPECT_EQ(expected, actual) << "page height " << (int) page_height;
+    }
+}
+
+static std::vector<uint8_t> make_row_aligned_font(const std::vector<uint8_t>& font) {
+    // convert bit-packed glyph data to row-aligned glyph data, see graphics_font_t.
+    const uint8_t count = font[1];
+    const uint8_t size = font[2];
+    const uint8_t width = (font[3] & 0xf) + 1;
+    const uint8_t height = (font[3] >> 4) + 1;
+    const uint8_t offset_bits = font[4] & 0xf;
+    const uint8_t offset_max = font[4] >> 4;
+    const uint8_t row_bytes = (width + 7) / 8;
+
+    std::vector<uint8_t> result(font.begin(), font.begin() + 6);
+    result[2] = (offset_max ? 1 : 0) + height * row_bytes;
+    result[4] = 0x08 | offset_max << 4;
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* glyph = &font[6 + i * size];
+        size_t n = 0;
+        const auto next_bit = [&]() {
+            const uint8_t bit = glyph[size - 1 - n / 8] >> (7 - n % 8) & 1;
+            ++n;
+            return bit;
+        };
+        uint8_t offset = 0;
+        for (uint8_t j = 0; j < offset_bits; ++j) {
+            offset = offset << 1 | next_bit();
+        }
+        if (offset_max) {
+            result.push_back(offset);
+        }
+        for (uint8_t y = 0; y < height; ++y) {
+            std::vector<uint8_t> row(row_bytes, 0);
+            for (uint8_t x = 0; x < width; ++x) {
+                row[x / 8] |= next_bit() << (7 - x % 8);
+            }
+            result.insert(result.end(), row.begin(), row.end());
+        }
+    }
+    return result;
+}
+
+TEST_F(GraphicsFontTest, graphics_glyph_row_aligned) {
+    // glyphs of a row-aligned font must be the same as glyphs of the bit-packed font.
+    graphics_set_color(DISPLAY_COLOR_WHITE);
+    const std::vector<uint8_t> builtin(GRAPHICS_BUILTIN_FONT_DATA,
+                                       GRAPHICS_BUILTIN_FONT_DATA + 122);
+    for (const auto& font: {builtin, load_asset("font5x7.dat"), load_asset("font6x9.dat"),
+                            load_asset("font16x16.dat")}) {
+        const auto aligned = make_row_aligned_font(font);
+        const auto draw = [&]() {
+            // all glyphs in a grid, partially hidden on the display borders.
+            const int grid_width = graphics_glyph_width() + 1;
+            const int grid_height = graphics_text_max_height() + 1;
+            char c = '!';
+            for (int y = -grid_height / 2; y < DISPLAY_HEIGHT; y += grid_height) {
+                for (int x = -grid_width / 2; x < DISPLAY_WIDTH; x += grid_width) {
+                    graphics_glyph((int8_t) x, (int8_t) y, c);
+                    c = (char) (c == '\x7f' ? '\xa0' : c == '\xff' ? '!' : c + 1);
+                }
+            }
+        };
+        for (uint8_t page_height : PAGE_HEIGHTS) {
+            sys_display_init_page(page_height);
+            graphics_set_font(data_mcu(font.data()));
+            const Frame expected = draw_frame(draw);
+            graphics_set_font(data_mcu(aligned.data()));
+            EXPECT_TRUE(graphics_font.row_aligned);
+            const Frame actual = draw_frame(draw);
+            EXPECT_EQ(expected, actual) << "page height " << (int) page_height;
+        }
+    }
+}
+
+static std::vector<uint8_t> make_subset_font(const std::vector<uint8_t>& font, const std::string& chars) {
+    // keep only the glyphs for some characters and add a remap table, see graphics_font_t.
+    const uint8_t size = font[2];
+    const auto char_pos = [](uint8_t c) { return c >= 0xa0 ? c - 0xa0 + 0x5f : c - 0x21; };
+    std::vector<uint8_t> positions;
+    for (const char c : chars) {
+        positions.push_back(char_pos((uint8_t) c));
+    }
+    std::sort(positions.begin(), positions.end());
+    std::vector<uint8_t> result(font.begin(), font.begin() + 6);
+    result[1] = positions.size();
+    result[2] |= 0x80;
+    std::vector<uint8_t> remap(positions.back() + 1, 0xff);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        const auto glyph = font.begin() + 6 + positions[i] * size;
+        result.insert(result.end(), glyph, glyph + size);
+        remap[positions[i]] = i;
+    }
+    result.push_back(remap.size());
+    result.insert(result.end(), remap.begin(), remap.end());
+    return result;
+}
+
+TEST_F(GraphicsFontTest, graphics_glyph_subset) {
+    // glyphs of a subset font must be the same as glyphs of the full font, other characters
+    // (before, between and after the subset characters) are drawn blank.
+    graphics_set_color(DISPLAY_COLOR_WHITE);
+    const std::string chars = "0123456789ACEMPR";
+    const std::vector<std::string> lines = {"SCORE", "0123", "PACMAN", "9876 !~"};
+    const auto draw = [&](bool blank_others) {
+        int y = 0;
+        for (std::string line : lines) {
+            for (char& c : line) {
+                if (blank_others && chars.find(c) == std::string::npos) {
+                    c = ' ';
+                }
+            }
+            graphics_text(0, (int8_t) y, line.c_str());
+            y += graphics_font.line_spacing;
+        }
+    };
+    for (const auto& font: {load_asset("font5x7.dat"), load_asset("font16x16.dat")}) {
+        const auto subset = make_subset_font(font, chars);
+        EXPECT_LT(subset.size(), font.size());
+        for (uint8_t page_height : PAGE_HEIGHTS) {
+            sys_display_init_page(page_height);
+            graphics_set_font(data_mcu(font.data()));
+            const Frame expected = draw_frame([&]() { draw(true); });
+            graphics_set_font(data_mcu(subset.data()));
+            EXPECT_EQ(graphics_font.remap_count, 'R' - '!' + 1);
+            const Frame actual = draw_frame([&]() { draw(false); });
+            EXPECT_EQ(expected, actual) << "page height " << (int) page_height;
+        }
+
+        // cached glyphs follow glyph data order, the 10 digits and 'A' and 'C'.
+        uint8_t buffer[12 * 33];
+        graphics_set_font(data_mcu(subset.data()));
+        EXPECT_EQ(graphics_set_font_cache(buffer, 12 * graphics_font.glyph_size, '0'), 12);
+        const Frame actual = draw_frame([&]() { draw(false); });
+        graphics_set_font(data_mcu(font.data()));
+        const Frame expected = draw_frame([&]() { draw(true); });
+        EXPECT_EQ(expected, actual) << "cached";
+        graphics_set_font(data_mcu(subset.data()));
+        EXPECT_EQ(graphics_set_font_cache(buffer, sizeof buffer, 'B'), 0);
+    }
+}
+
+TEST_F(GraphicsClipTest, graphics_clip_bottom) {
+    // shapes extending past the bottom of display are clipped.
+    graphics_set_color(DISPLAY_COLOR_WHITE);
+    for (uint8_t page_height : PAGE_HEIGHTS) {
+        sys_display_init_page(page_height);
+        Frame expected = draw_frame([]() {
+            graphics_fill_rect(4, DISPLAY_HEIGHT - 8, 10, 8);
+            graphics_hline(20, 29, DISPLAY_HEIGHT - 8);
+            graphics_vline(DISPLAY_HEIGHT - 8, DISPLAY_HEIGHT - 1, 20);
+            graphics_vline(DISPLAY_HEIGHT - 8, DISPLAY_HEIGHT - 1, 29);
+        });
+        Frame actual = draw_frame([]() {
+            graphics_fill_rect(4, DISPLAY_HEIGHT - 8, 10, 200);
+            graphics_rect(20, DISPLAY_HEIGHT - 8, 10, 12);
+        });
+        EXPECT_EQ(expected, actual) << "page height " << (int) page_height;
+
+        const auto image = load_asset("chess49x54.dat");
+        const auto image_data = data_mcu(image.data());
+        std::vector<uint8_t> buffer(GRAPHICS_IMAGE_CACHE_SIZE(49, 54, 4));
+        const auto cached_data = graphics_image_cache(image_data, buffer.data(), buffer.size());
+        expected = draw_frame([&]() {
+            graphics_image_4bit_mixed_region(image_data, 2, DISPLAY_HEIGHT - 20, 0, 19);
+            graphics_image_4bit_raw_region(cached_data, 60, DISPLAY_HEIGHT - 20, 10, 29);
+        });
+        actual = draw_frame([&]() {
+            graphics_image_4bit_mixed(image_data, 2, DISPLAY_HEIGHT - 20);
+            graphics_image_4bit_raw_region(cached_data, 60, DISPLAY_HEIGHT - 20, 10, 53);
+        });
+        EXPECT_EQ(expected, actual) << "page height " << (int) page_height;
+    }
+}
+
+TEST_F(DisplayTest, display_scroll) {
+    // scrolling then drawing only the rows scrolled into view must give the same result
+    // as drawing the whole display at the new scroll position.
+    for (uint8_t page_height : PAGE_HEIGHTS) {
+        sys_display_init_page(page_height);
+        int scroll = 0;
+        const auto draw_content = [&]() {
+            for (int y = 0; y < DISPLAY_HEIGHT; ++y) {
+                graphics_set_color((y + scroll) * 7 % 16);
+                graphics_hline((y + scroll) % 32, 127 - (y + scroll) % 64, y);
+            }
+        };
+        draw_frame(draw_content);
+        for (int8_t rows : {5, -12, 40, -128, 127, 30}) {
+            scroll += rows;
+            display_scroll(rows);
+            if (rows == 127) {
+                // scrolling twice before a frame refreshes the whole display.
+                scroll += 3;
+                display_scroll(3);
+            }
+            const Frame actual = draw_frame(draw_content);
+            const Frame expected = draw_frame(draw_content);
+            EXPECT_EQ(expected, actual) << "scroll " << (int) rows <<
+                ", with page height " << (int) page_height;
+        }
+    }
+}
+
+TEST_F(GraphicsTilemapTest, graphics_tilemap) {
+    // tilemap must be drawn the same as drawing each tile separately, for all page heights.
+    // tileset of 3 tiles, 6x5 pixels, with alpha color 5.
+    constexpr uint8_t TILE_WIDTH = 6;
+    constexpr uint8_t TILE_HEIGHT = 5;
+    constexpr uint8_t TILE_COUNT = 3;
+    std::vector<uint8_t> tileset{0xf1, 0x65, TILE_WIDTH - 1, TILE_HEIGHT * TILE_COUNT - 1};
+    for (int i = 0; i < TILE_HEIGHT * TILE_COUNT * TILE_WIDTH / 2; ++i) {
+        tileset.push_back((uint8_t) (i * 37 + 11));
+    }
+    const auto tileset_data = data_mcu(tileset.data());
+    static const auto get_tile = [](uint8_t col, uint8_t row) -> uint8_t {
+        const uint8_t tile = (col * 3 + row * 7) % (TILE_COUNT + 1);
+        return tile == TILE_COUNT ? GRAPHICS_TILE_NONE : tile;
+    };
+    constexpr uint8_t COLS = 16;
+    constexpr uint8_t ROWS = 28;
+    for (uint8_t page_height : PAGE_HEIGHTS) {
+        sys_display_init_page(page_height);
+        const Frame expected = draw_frame([&]() {
+            graphics_set_color(9);
+            graphics_fill_rect(0, 0, 128, 128);
+            for (uint8_t row = 0; row < ROWS; ++row) {
+                for (uint8_t col = 0; col < COLS; ++col) {
+                    const uint8_t tile = get_tile(col + 2, row + 1);
+                    const int y = 3 + row * TILE_HEIGHT;
+                    if (tile != GRAPHICS_TILE_NONE && y < DISPLAY_HEIGHT) {
+                        graphics_image_4bit_raw_region(tileset_data, 4 + col * TILE_WIDTH, y,
+                                                       tile * TILE_HEIGHT,
+                                                       tile * TILE_HEIGHT + TILE_HEIGHT - 1);
+                    }
+                }
+            }
+        });
+        const Frame actual = draw_frame([&]() {
+            graphics_set_color(9);
+            graphics_fill_rect(0, 0, 128, 128);
+            graphics_tilemap(tileset_data, TILE_HEIGHT, get_tile, 2, 1, 4, 3, COLS, ROWS);
+        });
+        EXPECT_EQ(expected, actual) << "page height " << (int) page_height;
+    }
+}
+
+TEST_F(GraphicsStaticTest, graphics_static_header) {
+    // image drawn with a header given statically must not depend on the header in data.
+    sys_display_init_page(PAGE_HEIGHTS[0]);
+    auto image = load_asset("chess49x54.dat");
+    const Frame expected = draw_frame([&]() { graphics_image_4bit_mixed(data_mcu(image.data()), 3, 4); });
+    const std::vector<uint8_t> header(image.begin(), image.begin() + 6);
+    std::fill_n(image.begin(), 6, 0);
+    const Frame actual = draw_frame([&]() {
+        graphics_static_header = header.data();
+        graphics_image_4bit_mixed(data_mcu(image.data()), 3, 4);
+        EXPECT_EQ(graphics_static_header, nullptr);
+    });
+    EXPECT_EQ(expected, actual);
+}
+
+TEST_F(GraphicsStaticTest, graphics_font_static_header) {
+    // font set with a static header must not read the header from data.
+    std::vector<uint8_t> font(GRAPHICS_BUILTIN_FONT_DATA, GRAPHICS_BUILTIN_FONT_DATA + 122);
+    const std::vector<uint8_t> header(font.begin(), font.begin() + 6);
+    std::fill_n(font.begin(), 6, 0);
+    graphics_static_header = header.data();
+    graphics_set_font(data_mcu(font.data()));
+    EXPECT_EQ(graphics_static_header, nullptr);
+    EXPECT_EQ(graphics_font.glyph_count, header[1]);
+    EXPECT_EQ(graphics_font.line_spacing, header[5]);
+}
+
+TEST_F(DisplayTest, display_palette) {
+    // drawing with a palette must give the same result as drawing with the remapped colors.
+    disp_color_t palette[16];
+    disp_color_t identity[16];
+    for (int i = 0; i < 16; ++i) {
+        palette[i] = (i * 5 + 3) % 16;
+        identity[i] = i;
+    }
+    const auto draw_content = [](const disp_color_t* colors) {
+        graphics_clear(colors[DISPLAY_COLOR_BLACK]);
+        for (int y = 0; y < DISPLAY_HEIGHT; ++y) {
+            graphics_set_color(colors[y / 3 % 16]);
+            graphics_hline(y % 32, 127 - y % 64, y);
+        }
+    };
+    for (uint8_t page_height : PAGE_HEIGHTS) {
+        sys_display_init_page(page_height);
+        const Frame expected = draw_frame([&]() { draw_content(palette); });
+        display_set_palette(palette);
+        const Frame actual = draw_frame([&]() { draw_content(identity); });
+        // pages only filled are remapped too.
+        const Frame filled = draw_frame([]() {});
+        display_set_palette(0);
+        EXPECT_EQ(expected, actual) << "with page height " << (int) page_height;
+        EXPECT_TRUE(std::all_of(filled.begin(), filled.end(), [&](uint8_t b) {
+            return b == (palette[0] | palette[0] << 4);
+        })) << "with page height " << (int) page_height;
+    }
+}
+
+TEST_F(DisplayTest, display_clear_on_send) {
+    // clearing the page buffer while sending it must give the same frames as not doing it,
+    // when changing the clear color, the palette or the page height between frames, and when
+    // the page buffer is overwritten between frames (shared variables, scratch memory).
+    disp_color_t palette[16];
+    for (int i = 0; i < 16; ++i) {
+        palette[i] = 15 - i;
+    }
+    const auto draw_frames = [&](bool clear_on_send) {
+        display_set_clear_on_send(clear_on_send);
+        std::vector<Frame> frames;
+        for (size_t i = 0; i < PAGE_HEIGHTS.size() * 4; ++i) {
+            if (i % 4 == 0) {
+                sys_display_init_page(PAGE_HEIGHTS[i / 4]);
+            }
+            display_set_palette(i % 3 == 2 ? palette : 0);
+            const disp_color_t background = i % 4 < 2 ? DISPLAY_COLOR_BLACK : 5;
+            if (i % 2 == 1) {
+                std::memset(sim_display_get_buffer(), 0xa5,
+                            DISPLAY_MAX_PAGE_HEIGHT * DISPLAY_NUM_COLS);
+            }
+            frames.push_back(draw_frame([&]() {
+                graphics_clear(background);
+                // some pages are left only filled.
+                for (int y = 0; y < DISPLAY_HEIGHT; ++y) {
+                    if ((y / 20 + i) % 3 == 0) {
+                        graphics_set_color((y + i) % 16);
+                        graphics_hline(y % 32, 127 - y % 64, y);
+                    }
+                }
+            }));
+        }
+        display_set_palette(0);
+        display_set_clear_on_send(false);
+        return frames;
+    };
+    const std::vector<Frame> expected = draw_frames(false);
+    const std::vector<Frame> actual = draw_frames(true);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i], actual[i]) << "frame " << i;
+    }
+}
+
+TEST_F(DisplayTest, display_stream_raw_image) {
+    // a full screen raw image written directly to the display must give the same result as
+    // drawing it, with a palette and with a scroll pending too.
+    std::vector<uint8_t> image{0xf1, 0x20, DISPLAY_WIDTH - 1, DISPLAY_HEIGHT - 1};
+    std::mt19937 rng(1234);
+    for (size_t i = 0; i < DISPLAY_SIZE; ++i) {
+        image.push_back((uint8_t) rng());
+    }
+    constexpr flash_t FLASH_ADDRESS = 0x1234;
+    sim_mem_write(flash, FLASH_ADDRESS, image.size(), image.data());
+    disp_color_t palette[16];
+    for (int i = 0; i < 16; ++i) {
+        palette[i] = 15 - i;
+    }
+    const auto draw_image = [&]() { graphics_image_4bit_raw(data_mcu(image.data()), 0, 0); };
+    const auto stream_image = [&]() {
+        draw_frame([]() {});
+        display_stream_raw_image(data_flash(FLASH_ADDRESS));
+        Frame frame;
+        std::copy_n(sim_display_data(), DISPLAY_SIZE, frame.begin());
+        return frame;
+    };
+    for (uint8_t page_height : {PAGE_HEIGHTS[0], PAGE_HEIGHTS[1]}) {
+        sys_display_init_page(page_height);
+        const Frame expected = draw_frame(draw_image);
+        EXPECT_EQ(expected, stream_image()) << "with page height " << (int) page_height;
+
+        display_set_palette(palette);
+        const Frame expected_palette = draw_frame(draw_image);
+        EXPECT_EQ(expected_palette, stream_image()) << "with palette";
+        display_set_palette(0);
+
+        // the frame after the scroll only draws the rows scrolled into view.
+        stream_image();
+        display_scroll(5);
+        display_stream_raw_image(data_flash(FLASH_ADDRESS));
+        EXPECT_EQ(expected, draw_frame(draw_image)) << "with scroll pending";
+        display_scroll(-5);
+        draw_frame(draw_image);
+    }
+}
+
+TEST_F(DisplayTest, display_framecache) {
+    // a background saved to the frame cache must be restored the same, for any page height.
+    const auto draw_background = []() {
+        for (int y = 0; y < DISPLAY_HEIGHT; ++y) {
+            graphics_set_color((y * 7) % 16);
+            graphics_hline(y % 40, 127 - y % 50, y);
+        }
+    };
+    for (uint8_t page_height : PAGE_HEIGHTS) {
+        sys_display_init_page(page_height);
+        framecache_begin();
+        EXPECT_FALSE(framecache_is_valid());
+        const Frame expected = draw_frame([&]() {
+            graphics_clear(DISPLAY_COLOR_BLACK);
+            draw_background();
+            framecache_save_page();
+        });
+        ASSERT_TRUE(framecache_is_valid()) << "with page height " << (int) page_height;
+        EXPECT_EQ(expected, draw_frame([]() { framecache_restore_page(); }))
+                            << "with page height " << (int) page_height;
+        framecache_invalidate();
+    }
+}
+
+TEST_F(GraphicsFlashTest, graphics_image_flash) {
+    // images read from flash with a stream must be drawn the same as images read from memory.
+    graphics_set_color(DISPLAY_COLOR_WHITE);
+    using image_func_t = void (*)(graphics_image_t, uint8_t, uint8_t);
+    const std::vector<std::pair<std::string, image_func_t>> images{
+            {"castle-bin.dat", graphics_image_1bit_mixed},
+            {"chess49x54-bin.dat", graphics_image_1bit_mixed},
+            {"chess49x54.dat", graphics_image_4bit_mixed},
+            {"logo-alpha.dat", graphics_image_4bit_mixed},
+            {"lena.dat", graphics_image_4bit_mixed},
+    };
+    constexpr flash_t FLASH_ADDRESS = 0x1234;
+    for (const auto& [asset, func]: images) {
+        const auto image = load_asset(asset);
+        sim_mem_write(flash, FLASH_ADDRESS, image.size(), image.data());
+        for (uint8_t page_height : {PAGE_HEIGHTS[0], PAGE_HEIGHTS[2]}) {
+            sys_display_init_page(page_height);
+            const Frame expected = draw_frame([&]() { func(data_mcu(image.data()), 3, 2); });
+            const Frame actual = draw_frame([&]() { func(data_flash(FLASH_ADDRESS), 3, 2); });
+            EXPECT_EQ(expected, actual) << "image from flash differs for " << asset <<
+                ", with page height " << (int) page_height;
+        }
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sim_test.h"
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <core/input.h>
+#include <sim/input.h>
+#include <sim/time.h>
+}
+
+class InputTest : public SimTest {};
+
+static void input_wait_ticks(uint32_t ticks) {
+    sim_time_sleep(ticks * 1000000 / SYSTICK_FREQUENCY);
+    sim_time_update();
+}
+
+TEST_F(InputTest, input_key_repeat_after_long_hold) {
+    // repeats must resume after keys weren't taken for longer than half the time counter
+    // period, without a burst of missed repeats.
+    static const input_keys_config_t config = {
+            .repeat_mask = BUTTON1,
+            .repeat_delay = 50,
+            .repeat_rate = 10,
+    };
+    sim_input_set_state(0);
+    input_wait_ticks(1);
+    input_keys_init(&config);
+
+    sim_input_press(BUTTON1);
+    input_wait_ticks(1);
+    EXPECT_EQ(input_get_key(), BUTTON1);
+    EXPECT_EQ(input_get_key(), 0);
+    input_wait_ticks(config.repeat_delay);
+    EXPECT_EQ(input_get_key(), BUTTON1 | INPUT_KEY_REPEAT);
+    EXPECT_EQ(input_get_key(), 0);
+
+    sim_time_sleep(200 * 1000000);
+    EXPECT_EQ(input_get_key(), BUTTON1 | INPUT_KEY_REPEAT);
+    EXPECT_EQ(input_get_key(), 0);
+    input_wait_ticks(config.repeat_rate);
+    EXPECT_EQ(input_get_key(), BUTTON1 | INPUT_KEY_REPEAT);
+    EXPECT_EQ(input_get_key(), 0);
+
+    sim_input_release(BUTTON1);
+    input_wait_ticks(1);
+    input_wait_ticks(config.repeat_rate);
+    EXPECT_EQ(input_get_key(), 0);
+}
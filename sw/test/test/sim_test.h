@@ -0,0 +1,43 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TEST_SIM_TEST_H
+#define TEST_SIM_TEST_H
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <boot/init.h>
+#include <sim/init.h>
+}
+
+/**
+ * Fixture for tests using the simulated console. The console is initialized before each test
+ * and released after it, so that each test starts from the same state without leaking memory.
+ * Test suites derive from it with an empty class, to keep their own name.
+ */
+class SimTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        sys_init();
+    }
+
+    void TearDown() override {
+        sim_deinit();
+    }
+};
+
+#endif //TEST_SIM_TEST_H
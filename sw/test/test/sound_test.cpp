@@ -0,0 +1,79 @@
+/*
+ * Copyright 2022 Nicolas Maltais
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sim_test.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+
+extern "C" {
+#include <core/sound.h>
+#include <sys/sound.h>
+#include <sim/sound.h>
+}
+
+class SoundTest : public SimTest {};
+
+TEST_F(SoundTest, sound_load) {
+    // example data from core/sound.h, loaded from RAM.
+    static const uint8_t data[] = {
+            0xf2, 0x01, 0x05, 0x00, 0x00, 0xff, 0x02, 0x24, 0x00, 0x04, 0x18, 0x3f, 0x19,
+            0xc1, 0xf3, 0x24, 0x07, 0x25, 0x83, 0x26, 0x27, 0x28, 0x29, 0x82, 0x30,
+            0x31, 0x6d, 0x0f, 0x6e, 0x80, 0x54, 0xc0, 0x83, 0xa9, 0x7e, 0xc0, 0x18,
+            0x18, 0xff, 0xff, 0x00, 0xff, 0xff, 0xff,
+    };
+    sound_load(data_mcu(data));
+    EXPECT_EQ(sys_sound_tracks_on & TRACKS_PLAYING_ALL, TRACK1_PLAYING | TRACK2_PLAYING);
+    EXPECT_EQ(sys_sound_tracks[1].buffer[0], 0xff);
+    EXPECT_EQ(sys_sound_tracks[1].data, 0u);
+    EXPECT_EQ(sys_sound_tracks[2].immediate_pause, 0x04);
+    EXPECT_EQ(memcmp(sys_sound_tracks[2].buffer, &data[10], SOUND_TRACK_BUFFER_SIZE), 0);
+    EXPECT_EQ(sys_sound_tracks[2].data, data_mcu(&data[10 + SOUND_TRACK_BUFFER_SIZE]));
+    // end of track is known from the track length in header: 36 bytes, 4 for header.
+    EXPECT_EQ(sys_sound_tracks[2].data_left, 36 - 4 - SOUND_TRACK_BUFFER_SIZE);
+    sound_stop(TRACKS_STARTED_ALL);
+    sys_sound_tracks_on = 0;
+}
+
+TEST_F(SoundTest, sound_render_wav) {
+    // rendering the same sound twice must give the same output.
+    static const uint8_t data[] = {
+            0xf2, 0x02, 0x0a, 0x00, 0x00, 0x21, 0x07, 0x24, 0x83, 0x2d, 0xff, 0xff,
+    };
+    sound_set_volume(SOUND_VOLUME_3);
+    std::vector<char> outputs[2];
+    for (auto& output : outputs) {
+        sound_load(data_mcu(data));
+        sound_start(TRACKS_STARTED_ALL);
+        const std::string filename = std::filesystem::temp_directory_path() / "sound_test.wav";
+        ASSERT_TRUE(sim_sound_render_wav(filename.c_str(), 64));
+        std::ifstream file(filename, std::ios::binary);
+        output.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        std::filesystem::remove(filename);
+    }
+    EXPECT_EQ(outputs[0], outputs[1]);
+    ASSERT_EQ(outputs[0].size(), 44u + 64 * 44100 / 256 * 2);
+    // not silent.
+    EXPECT_TRUE(std::any_of(outputs[0].begin() + 44, outputs[0].end(),
+                            [](char c) { return c != 0; }));
+    sound_stop(TRACKS_STARTED_ALL);
+    sys_sound_tracks_on = 0;
+}
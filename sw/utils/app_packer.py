@@ -31,8 +31,9 @@ from pathlib import Path
 from typing import Dict
 
 import assets_packer
-from prog.app import App, DataLocation
-from utils import readable_size, PathLike, boot_crc16
+from prog.app import App, DataLocation, FLASH_ALIGN_BITS, FLASH_SECTOR_SIZE, \
+    FLASH_DATA_START, FLASH_DATA_END
+from utils import readable_size, PathLike, boot_crc16, align
 from hex_utils import read_hex_file
 
 # filename for the target configuration file
@@ -46,6 +47,9 @@ PACKED_ASSETS_FILE = assets_packer.ASSETS_FILE
 # output filename for this script
 PACKED_APP_FILE = "target.app"
 
+# size of the internal EEPROM area shared by the fast settings of all apps, see core/fast_settings.h
+FAST_SETTINGS_AREA_SIZE = 128
+
 
 class PackError(Exception):
     pass
@@ -58,7 +62,10 @@ class TargetConfig:
     title: str
     author: str
     eeprom_space: int
+    flash_space: int
     page_height: int
+    target_fps: int
+    min_fps: int
 
 
 def read_config_file(filename: PathLike) -> Dict[str, str]:
@@ -82,7 +89,13 @@ def read_target_config(target_path: Path) -> TargetConfig:
         title = config["title"]
         author = config["author"].upper()
         eeprom_space = int(config.get("eeprom_space", "0"), 0)
+        flash_space = int(config.get("flash_space", "0"), 0)
         page_height = int(config["display_page_height"], 0)
+        max_page_height = int(config.get("display_max_page_height", str(page_height)), 0)
+        target_fps = int(config.get("display_target_fps", "0"), 0)
+        min_fps = int(config.get("display_min_fps", "0"), 0)
+        fast_settings_offset = int(config.get("fast_settings_offset", "0"), 0)
+        fast_settings_space = int(config.get("fast_settings_space", "0"), 0)
     except KeyError as e:
         raise PackError(f"undefined value for {e} in {config_file}")
     except ValueError:
@@ -99,10 +112,23 @@ def read_target_config(target_path: Path) -> TargetConfig:
         raise PackError("author has an invalid format")
     if not (0 <= eeprom_space <= 0xffff):
         raise PackError(f"EEPROM space out of bounds")
+    if not (0 <= flash_space <= FLASH_DATA_END - FLASH_DATA_START) or \
+            flash_space % FLASH_SECTOR_SIZE != 0:
+        raise PackError(f"flash space must be a multiple of {FLASH_SECTOR_SIZE} bytes")
+    if not (0 <= fast_settings_offset and 0 <= fast_settings_space and
+            fast_settings_offset + fast_settings_space <= FAST_SETTINGS_AREA_SIZE):
+        raise PackError("fast settings allocation out of bounds")
     if not (0 <= page_height <= 128):
         raise PackError("display page height out of bounds")
+    if not (page_height <= max_page_height <= 128):
+        raise PackError("display maximum page height must be between page height and 128")
+    if not (0 <= target_fps <= 128):
+        raise PackError("display target FPS out of bounds")
+    if not (0 <= min_fps <= target_fps):
+        raise PackError("display minimum FPS must be between 0 and target FPS")
 
-    return TargetConfig(app_id, version, title, author, eeprom_space, page_height)
+    return TargetConfig(app_id, version, title, author, eeprom_space, flash_space, page_height,
+                        target_fps, min_fps)
 
 
 def read_boot_version() -> int:
@@ -157,26 +183,32 @@ def main() -> None:
     app_code = read_app_code(target_path)
     app_data = read_app_data(target_path)
 
-    # pack the app as it is stored in flash (code + data)
+    # pack the app as it is stored in flash (code + data). The code is padded so that data
+    # starts on a flash page, like the image start, so that reads of both line up with pages.
     packed_app = bytearray()
     packed_app += app_code
+    packed_app += b"\xff" * (align(len(app_code), 1 << FLASH_ALIGN_BITS) - len(app_code))
     packed_app += app_data
     app_size = len(packed_app)
+    if config.flash_space:
+        # the flash data space starts on the first sector after the image.
+        app_size = align(app_size, FLASH_SECTOR_SIZE) + config.flash_space
 
     # create the app object
     app_crc = boot_crc16(packed_app)
     code_crc = boot_crc16(app_code)
 
     app = App(config.app_id, app_crc, code_crc, config.version, boot_version, len(app_code),
-              config.page_height, DataLocation(0, app_size), DataLocation(0, config.eeprom_space),
-              datetime.today(), config.title, config.author)
+              config.page_height, config.target_fps, config.min_fps,
+              DataLocation(0, app_size), DataLocation(0, config.eeprom_space),
+              datetime.today(), config.title, config.author, align_bits=FLASH_ALIGN_BITS,
+              space_size=config.flash_space)
 
     # write the app image (header + code + data), as read by gcprog.
     image_data = bytearray()
     image_data += App.GC_SIGNATURE
     image_data += app.encode()
-    image_data += app_code
-    image_data += app_data
+    image_data += packed_app
 
     try:
         with open(target_path / PACKED_APP_FILE, "wb") as file:
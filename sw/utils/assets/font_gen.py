@@ -23,13 +23,14 @@
 # with only black and white colors.
 # Char ranges 0x20-0x7f, then 0xa0-0xff are located contiguously on image, with each
 # char separated by one pixel of whitespace.
+# A subset of the characters can be encoded with --chars, the font then has a remap table.
 
 import argparse
 import math
 import sys
 from dataclasses import dataclass, field
 from pathlib import Path
-from typing import List
+from typing import List, Optional
 
 from PIL import Image
 
@@ -54,6 +55,14 @@ parser.add_argument(
 parser.add_argument(
     "-s", "--line-spacing", action="store", type=int, dest="line_spacing", default=1,
     help="Extra line spacing in pixels (added to glyph height, default is 1)")
+parser.add_argument(
+    "-a", "--row-aligned", action="store_true", dest="row_aligned",
+    help="Store each glyph row on whole bytes, with the Y offset in a separate byte. "
+         "Takes more space for most fonts but is faster to draw.")
+parser.add_argument(
+    "-c", "--chars", action="store", type=str, dest="chars", default=None,
+    help="Only encode these characters, with a table to remap them to their glyph. "
+         "Other characters are drawn blank.")
 
 
 def range_repr(r: range) -> str:
@@ -75,6 +84,17 @@ class GlyphData:
         data <<= nb_bytes * 8 - bit_length
         return data.to_bytes(nb_bytes, "little", signed=False)
 
+    def encode_row_aligned(self, width: int, height: int, has_offset: bool) -> bytes:
+        row_bytes = (width - 1) // 8 + 1
+        data = bytearray()
+        if has_offset:
+            data.append(self.offset)
+        for y in range(height):
+            # first pixel of the row is the MSB of its first byte.
+            row = self.data >> ((height - y - 1) * width) & ((1 << width) - 1)
+            data += (row << (row_bytes * 8 - width)).to_bytes(row_bytes, "big", signed=False)
+        return data
+
 
 class EncodeError(Exception):
     pass
@@ -87,13 +107,21 @@ class FontData:
     width: int
     height: int
     line_spacing: int
+    # if true, each glyph row is stored on whole bytes, otherwise glyph data is bit-packed.
+    row_aligned: bool = field(default=False)
     glyphs: List[GlyphData] = field(default_factory=list, repr=False)
+    # if set, only these characters are encoded, with a remap table after glyph data.
+    chars: Optional[str] = field(default=None)
     bytes_per_glyph: int = field(default=0)
     max_offset: int = field(default=-1)
     offset_bits: int = field(default=0)
 
     SIGNATURE = 0xf0
 
+    FLAG_ROW_ALIGNED = 1 << 3
+    FLAG_REMAP = 1 << 7
+    REMAP_NONE = 0xff
+
     GLYPH_WIDTH_RANGE = range(1, 17)
     GLYPH_HEIGHT_RANGE = range(1, 17)
     MAX_OFFSET_RANGE = range(0, 16)
@@ -103,12 +131,50 @@ class FontData:
     RANGES = [range(0x21, 0x80), range(0xa0, 0x100)]
     MAX_GLYPHS = sum((len(r) for r in RANGES))
 
+    @staticmethod
+    def char_position(c: str) -> int:
+        """Position of a character in the glyph ranges, or -1 if it can't be encoded."""
+        pos = 0
+        for r in FontData.RANGES:
+            if ord(c) in r:
+                return pos + ord(c) - r.start
+            pos += len(r)
+        return -1
+
+    def remap_table(self) -> List[int]:
+        """Glyph index for each character position up to the last encoded character."""
+        positions = set()
+        for c in self.chars:
+            if c.isspace():
+                # blank characters are never encoded.
+                continue
+            pos = FontData.char_position(c)
+            if pos == -1:
+                raise EncodeError(f"character {c!r} can't be encoded")
+            if pos >= len(self.glyphs):
+                raise EncodeError(f"character {c!r} is not in the font image")
+            positions.add(pos)
+        if not positions:
+            raise EncodeError("no characters to encode")
+        table = [FontData.REMAP_NONE] * (max(positions) + 1)
+        for i, pos in enumerate(sorted(positions)):
+            table[pos] = i
+        return table
+
+    def encoded_glyphs(self) -> List[GlyphData]:
+        if self.chars is None:
+            return self.glyphs
+        return [self.glyphs[pos] for pos in sorted(set(
+            FontData.char_position(c) for c in self.chars if not c.isspace()))]
+
     def encode(self) -> bytes:
-        count = len(self.glyphs)
+        remap = None if self.chars is None else self.remap_table()
+        glyphs = self.encoded_glyphs()
+        count = len(glyphs)
         if count > FontData.MAX_GLYPHS:
             raise EncodeError(f"maximum {FontData.MAX_GLYPHS} glyphs allowed, got {count}.")
 
-        self.max_offset = max(self.glyphs, key=lambda g: g.offset).offset
+        self.max_offset = max(glyphs, key=lambda g: g.offset).offset
         if self.max_offset not in FontData.MAX_OFFSET_RANGE:
             raise EncodeError(f"Y offset of {self.max_offset} px is out of bounds, "
                               f"valid range is {range_repr(FontData.MAX_OFFSET_RANGE)}")
@@ -116,6 +182,13 @@ class FontData:
 
         glyph_bit_length = self.width * self.height + self.offset_bits
         self.bytes_per_glyph = ((glyph_bit_length - 1) // 8) + 1
+        flags = 0
+        if self.row_aligned:
+            # the offset is a whole byte, it's not encoded in bits.
+            self.offset_bits = 0
+            self.bytes_per_glyph = (1 if self.max_offset else 0) + \
+                                   ((self.width - 1) // 8 + 1) * self.height
+            flags |= FontData.FLAG_ROW_ALIGNED
         if self.bytes_per_glyph not in FontData.BYTES_PER_GLYPH_RANGE:
             raise EncodeError(f"font data glyph size of {self.bytes_per_glyph} bytes is out of "
                               f"bounds, valid range is {range_repr(FontData.BYTES_PER_GLYPH_RANGE)}")
@@ -123,14 +196,43 @@ class FontData:
         data = bytearray()
         data.append(FontData.SIGNATURE)
         data.append(count)
-        data.append(self.bytes_per_glyph)
+        data.append(self.bytes_per_glyph | (FontData.FLAG_REMAP if remap else 0))
         data.append((self.width - 1) | (self.height - 1) << 4)
-        data.append(self.offset_bits | self.max_offset << 4)
+        data.append(self.offset_bits | flags | self.max_offset << 4)
         data.append(self.line_spacing)
-        for glyph in self.glyphs:
-            data += glyph.encode(glyph_bit_length, self.offset_bits, self.bytes_per_glyph)
+        for glyph in glyphs:
+            if self.row_aligned:
+                data += glyph.encode_row_aligned(self.width, self.height, self.max_offset != 0)
+            else:
+                data += glyph.encode(glyph_bit_length, self.offset_bits, self.bytes_per_glyph)
+        if remap:
+            data.append(len(remap))
+            data += bytes(remap)
         return data
 
+    def ranges_repr(self) -> str:
+        """Encoded characters, as ranges of characters."""
+        glyph_count = len(self.glyphs)
+        if self.chars is not None:
+            chars = sorted(set(ord(c) for c in self.chars if not c.isspace()))
+            ranges = []
+            for c in chars:
+                if ranges and ranges[-1][1] == c - 1:
+                    ranges[-1][1] = c
+                else:
+                    ranges.append([c, c])
+            return ", ".join(f"{a:#02x}" if a == b else f"{a:#02x}-{b:#02x}" for a, b in ranges)
+        total = 0
+        ranges_str = []
+        for r in FontData.RANGES:
+            if total + len(r) > glyph_count:
+                ranges_str.append(f"{r.start:#02x}-{r.start + (glyph_count - total - 1):#02x}")
+                break
+            else:
+                ranges_str.append(f"{r.start:#02x}-{r.stop - 1:#02x}")
+                total += len(r)
+        return ", ".join(ranges_str)
+
 
 @dataclass
 class Config:
@@ -139,7 +241,9 @@ class Config:
     glyph_width: int
     glyph_height: int
     line_spacing: int
+    row_aligned: bool
     verbose: bool
+    chars: Optional[str] = None
 
 
 @dataclass(frozen=True)
@@ -148,19 +252,13 @@ class FontPackResult(PackResult):
 
     def __repr__(self) -> str:
         d = self.font_data
-        glyph_count = len(d.glyphs)
+        glyph_count = len(d.encoded_glyphs())
         s = super().__repr__()
-        s += f", {glyph_count} glyphs, {d.bytes_per_glyph} bytes per glyph,\n" \
-             f"{d.offset_bits} offset bits (max offset is {d.max_offset} px), encode ranges "
-        total = 0
-        for r in FontData.RANGES:
-            if total + len(r) > glyph_count:
-                s += f"{r.start:#02x}-{r.start + (glyph_count - total - 1):#02x}, "
-                break
-            else:
-                s += f"{r.start:#02x}-{r.stop - 1:#02x}, "
-                total += len(r)
-        return s[:-2]
+        s += f", {glyph_count} glyphs, {d.bytes_per_glyph} bytes per glyph" \
+             f"{' (row-aligned)' if d.row_aligned else ''},\n" \
+             f"{d.offset_bits} offset bits (max offset is {d.max_offset} px), " \
+             f"encode {'subset ' if d.chars is not None else 'ranges '}{d.ranges_repr()}"
+        return s
 
 
 @dataclass(frozen=True)
@@ -169,10 +267,12 @@ class FontObject(DataObject):
     glyph_width: int
     glyph_height: int
     line_spacing: int
+    row_aligned: bool
+    chars: Optional[str]
 
     def pack(self) -> PackResult:
         config = Config(self.file, "", self.glyph_width, self.glyph_height,
-                        self.line_spacing, False)
+                        self.line_spacing, self.row_aligned, False, self.chars)
         try:
             font_data = create_font_data(config)
             data = font_data.encode()
@@ -190,9 +290,9 @@ class FontObject(DataObject):
 def register_builder(packer) -> None:
     @packer.file_builder
     def font(filename: Path, *, glyph_width: int, glyph_height: int,
-             extra_line_spacing: int = 1):
+             extra_line_spacing: int = 1, row_aligned: bool = False, chars: str = None):
         yield FontObject(filename, glyph_width, glyph_height,
-                         glyph_height + extra_line_spacing)
+                         glyph_height + extra_line_spacing, row_aligned, chars)
 
 
 def create_config(args: argparse.Namespace) -> Config:
@@ -206,7 +306,7 @@ def create_config(args: argparse.Namespace) -> Config:
     verbose = output_file != STD_IO
 
     return Config(input_file, output_file, args.glyph_width, args.glyph_height,
-                  line_spacing, verbose)
+                  line_spacing, args.row_aligned, verbose, args.chars)
 
 
 def create_font_data(config: Config) -> FontData:
@@ -232,7 +332,8 @@ def create_font_data(config: Config) -> FontData:
     if config.glyph_height > height:
         raise EncodeError(f"glyph height is larger than image height")
 
-    font_data = FontData(config.glyph_width, config.glyph_height, config.line_spacing)
+    font_data = FontData(config.glyph_width, config.glyph_height, config.line_spacing,
+                         config.row_aligned, chars=config.chars)
     for x in range(0, width, config.glyph_width + 1):
         glyph = read_glyph(image, x, config.glyph_width, config.glyph_height)
         font_data.glyphs.append(glyph)
@@ -288,22 +389,13 @@ def main():
     data = font_data.encode()
 
     # show information on generated font
-    glyph_count = len(font_data.glyphs)
+    glyph_count = len(font_data.encoded_glyphs())
     if config.verbose:
         print(f"Done, total size is {len(data)} bytes, "
               f"{font_data.bytes_per_glyph} bytes per glyph, "
               f"{font_data.offset_bits} offset bits (max offset is {font_data.max_offset} px).")
-        total = 0
-        ranges_str = []
-        for r in FontData.RANGES:
-            if total + len(r) > glyph_count:
-                ranges_str.append(
-                    f"{r.start:#02x}-{r.start + (glyph_count - total - 1):#02x}")
-                break
-            else:
-                ranges_str.append(f"{r.start:#02x}-{r.stop - 1:#02x}")
-                total += len(r)
-        print(f"Font encodes ranges {', '.join(ranges_str)} ({glyph_count} chars)")
+        print(f"Font encodes {'subset' if config.chars is not None else 'ranges'} "
+              f"{font_data.ranges_repr()} ({glyph_count} chars)")
 
     try:
         if config.output_file == STD_IO:
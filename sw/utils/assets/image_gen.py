@@ -23,6 +23,7 @@ import abc
 import argparse
 import math
 import sys
+from collections import deque
 from dataclasses import dataclass, field
 from enum import Enum
 from pathlib import Path
@@ -43,6 +44,8 @@ class EncodeError(Exception):
 class IndexGranularityMode(Enum):
     ROW_COUNT = 0
     MAX_SIZE = 1
+    # index entries on display page boundaries, the value is the Y position the image is drawn at.
+    PAGE = 2
 
 
 @dataclass
@@ -57,19 +60,37 @@ class IndexGranularity:
             mode = IndexGranularityMode.MAX_SIZE
         elif s[-1] == 'r':
             mode = IndexGranularityMode.ROW_COUNT
+        elif s[-1] == 'p':
+            mode = IndexGranularityMode.PAGE
         else:
             raise ValueError("invalid mode")
         value = int(s[:-1])
         if mode == IndexGranularityMode.MAX_SIZE and \
                 not (0 < value <= ImageIndex.MAX_ENTRY) or \
                 mode == IndexGranularityMode.ROW_COUNT and \
-                not (0 < value < ImageEncoder.MAX_IMAGE_HEIGHT):
+                not (0 < value < ImageEncoder.MAX_IMAGE_HEIGHT) or \
+                mode == IndexGranularityMode.PAGE and \
+                not (0 <= value < DecodeCost.DISPLAY_HEIGHT):
             raise ValueError("value out of bounds")
 
         return IndexGranularity(mode, value)
 
     def __repr__(self):
-        return f"{self.value}{'b' if self.mode == IndexGranularityMode.MAX_SIZE else 'r'}"
+        suffix = {IndexGranularityMode.ROW_COUNT: 'r', IndexGranularityMode.MAX_SIZE: 'b',
+                  IndexGranularityMode.PAGE: 'p'}
+        return f"{self.value}{suffix[self.mode]}"
+
+    def for_page_height(self, page_height: int) -> List["IndexGranularity"]:
+        """Resolve page mode to row counts, for the image drawn at the Y position given by the
+        granularity value. Page boundaries fall every `page_height` rows in the image, starting
+        at an offset depending on that position. The row counts returned put index entries on all
+        boundaries, the first one is the largest and others are fallbacks in decreasing order,
+        to use if there are too many bytes between entries. Other modes are returned as is."""
+        if self.mode != IndexGranularityMode.PAGE:
+            return [self]
+        rows = math.gcd(page_height, self.value % page_height)
+        return [IndexGranularity(IndexGranularityMode.ROW_COUNT, n)
+                for n in range(rows, 0, -1) if rows % n == 0]
 
 
 @dataclass
@@ -130,16 +151,20 @@ class ImageData:
     data: bytes
 
     SIGNATURE = 0xf1
+    SIGNATURE_LZ = 0xf3
 
     FLAG_BINARY = 1 << 4
     FLAG_RAW = 1 << 5
     FLAG_ALPHA = 1 << 6
     FLAG_INDEXED = 1 << 7
+    # not part of the flags byte, LZ images have a different signature instead.
+    FLAG_LZ = 1 << 8
 
     def encode(self) -> bytes:
         alpha_color = self.alpha_color if self.flags & ImageData.FLAG_ALPHA else 0
         data = bytearray()
-        data.append(ImageData.SIGNATURE)
+        data.append(ImageData.SIGNATURE_LZ if self.flags & ImageData.FLAG_LZ
+                    else ImageData.SIGNATURE)
         data.append(self.flags & 0xf0 | alpha_color & 0xf)
         data.append(self.width - 1)
         data.append(self.height - 1)
@@ -155,6 +180,90 @@ class ImageEncoding:
     binary: Optional[bool]
     # whether the encoding is raw or mixed
     raw: bool
+    # whether to use the LZ encoding (4-bit only), or to consider it when optimizing for speed
+    lz: bool = False
+
+
+class Optimize(Enum):
+    # use the encoding and index granularity given, smallest size for these
+    SIZE = 0
+    # choose the encoding and index granularity with the lowest decode cost within a size budget
+    SPEED = 1
+
+
+# when optimizing for speed, default maximum size relative to the smallest encoding
+DEFAULT_SIZE_BUDGET = 2.0
+
+
+class DecodeCost:
+    """
+    Rough estimate of the CPU cycles needed to draw an image on the game console, used to
+    compare encodings when optimizing for speed. The image is assumed to be drawn in full at the
+    top of the display, on all pages. Costs are per frame and only meaningful relative to each
+    other: they count the context creation on each page, the index entries walked, the bytes
+    read from flash, and the pixels decoded, drawn or only skipped to reach the page top.
+    """
+    PAGE_SETUP = 300
+    INDEX_ENTRY = 12
+    # see SIM_SPI_BYTE_CYCLES in the simulator
+    FLASH_BYTE = 16
+    # per pixel drawn, by [binary][raw]
+    PIXEL = [[35, 25], [14, 8]]
+    # per pixel decoded but not drawn, for mixed encoding only
+    SKIPPED_PIXEL = [8, 4]
+    # per pixel drawn for the LZ encoding, decoding included.
+    PIXEL_LZ = 38
+
+    DISPLAY_HEIGHT = 128
+
+    @staticmethod
+    def estimate(data: "ImageData", page_height: int) -> int:
+        binary = bool(data.flags & ImageData.FLAG_BINARY)
+        raw = bool(data.flags & ImageData.FLAG_RAW)
+        drawn_height = min(data.height, DecodeCost.DISPLAY_HEIGHT)
+
+        if data.flags & ImageData.FLAG_LZ:
+            # the decoder state is kept between pages, so the drawn rows are decoded once.
+            pages = math.ceil(drawn_height / page_height)
+            read = len(data.data) * drawn_height / data.height
+            return round(pages * DecodeCost.PAGE_SETUP + read * DecodeCost.FLASH_BYTE +
+                         drawn_height * data.width * DecodeCost.PIXEL_LZ)
+
+        # size of the data for each index segment, the whole image is one segment if not indexed.
+        if data.flags & ImageData.FLAG_INDEXED:
+            granularity = data.index.granularity
+            segments = data.index.entries[1:]
+            segments.append(len(data.data) - sum(segments))
+        else:
+            granularity = data.height
+            segments = [len(data.data)]
+
+        def segment_bytes(seg: int, rows: int) -> float:
+            seg_rows = min(granularity, data.height - seg * granularity)
+            return segments[seg] * rows / seg_rows
+
+        cost = 0
+        for page_start in range(0, drawn_height, page_height):
+            page_end = min(page_start + page_height, drawn_height) - 1
+            rows = page_end - page_start + 1
+            cost += DecodeCost.PAGE_SETUP + rows * data.width * DecodeCost.PIXEL[binary][raw]
+            if raw:
+                bytes_per_row = math.ceil(data.width / (8 if binary else 2))
+                cost += rows * bytes_per_row * DecodeCost.FLASH_BYTE
+                continue
+            # decoding starts from the index entry before the page top.
+            first = page_start // granularity
+            last = page_end // granularity
+            skipped_rows = page_start - first * granularity
+            cost += skipped_rows * data.width * DecodeCost.SKIPPED_PIXEL[binary]
+            # skipped rows are read too, data is assumed to be evenly spread over segment rows.
+            read = sum(segments[first:last])
+            read += segment_bytes(last, page_end - last * granularity + 1)
+            cost += read * DecodeCost.FLASH_BYTE
+        if data.flags & ImageData.FLAG_INDEXED:
+            # with the cursor saved for each page, the index is only walked once per frame.
+            cost += (drawn_height - 1) // granularity * DecodeCost.INDEX_ENTRY
+        return round(cost)
 
 
 class ImageEncoder(abc.ABC):
@@ -550,6 +659,99 @@ class ImageEncoderGrayMixed(ImageEncoderGray):
         self.index = min_index
 
 
+class ImageEncoderGrayLz(ImageEncoderGrayRaw):
+    """
+    Image encoder for 4-bit gray images, LZ compression of the raw encoding data.
+    There are 2 defined token types:
+
+    - Literal run: the MSB is 0, the remaining bits indicate the number of bytes that follow,
+        minus one. Thus a literal run can have a length of 1 to 128.
+    - Match: the MSB is 1, the remaining bits indicate the match length, minus 3, and the next
+        byte is the distance back in the decoded data, minus one. Thus a match can have a length
+        of 3 to 130 bytes and a distance of 1 to 256 bytes. A match can overlap its own output.
+
+    Tokens can cross rows and the image isn't indexed, since the decoder keeps its state from one
+    page to the next. The parse is optimal for size, which also minimizes the bytes read per page.
+    """
+
+    MIN_MATCH = 3
+    MAX_MATCH = 127 + MIN_MATCH
+    MAX_LITERALS = 128
+    WINDOW_SIZE = 256
+
+    def encode(self) -> ImageData:
+        # rows of the raw encoding are aligned on bytes only if the image is indexed.
+        self.indexed = True
+        raw = super().encode()
+        return ImageData(raw.flags & ~ImageData.FLAG_RAW | ImageData.FLAG_LZ, raw.alpha_color,
+                         raw.width, raw.height, None, ImageEncoderGrayLz.compress(raw.data))
+
+    @staticmethod
+    def _find_matches(data: bytes) -> List[Tuple[int, int]]:
+        """Find the longest match at each position in data, as (length, distance),
+        with a length of 0 if there is none."""
+        matches = []
+        # positions in the window for each sequence of MIN_MATCH bytes.
+        chains = {}
+        for i in range(len(data)):
+            key = data[i:i + ImageEncoderGrayLz.MIN_MATCH]
+            if len(key) < ImageEncoderGrayLz.MIN_MATCH:
+                matches.append((0, 0))
+                continue
+            chain = chains.setdefault(key, deque())
+            while chain and i - chain[0] > ImageEncoderGrayLz.WINDOW_SIZE:
+                chain.popleft()
+            max_length = min(ImageEncoderGrayLz.MAX_MATCH, len(data) - i)
+            best = (0, 0)
+            for j in reversed(chain):
+                length = ImageEncoderGrayLz.MIN_MATCH
+                while length < max_length and data[j + length] == data[i + length]:
+                    length += 1
+                if length > best[0]:
+                    best = (length, i - j)
+                    if length == max_length:
+                        break
+            matches.append(best)
+            chain.append(i)
+        return matches
+
+    @staticmethod
+    def compress(data: bytes) -> bytes:
+        data = bytes(data)
+        matches = ImageEncoderGrayLz._find_matches(data)
+
+        # size of the smallest encoding of the data from each position, and the token used.
+        # any length up to the longest match at a position can be used, with the same distance.
+        size = [0] * (len(data) + 1)
+        tokens: List[Tuple[bool, int]] = [(False, 0)] * len(data)
+        for i in range(len(data) - 1, -1, -1):
+            best = None
+            for length in range(1, min(ImageEncoderGrayLz.MAX_LITERALS, len(data) - i) + 1):
+                cost = 1 + length + size[i + length]
+                if best is None or cost < best:
+                    best = cost
+                    tokens[i] = (False, length)
+            for length in range(ImageEncoderGrayLz.MIN_MATCH, matches[i][0] + 1):
+                cost = 2 + size[i + length]
+                if cost <= best:
+                    best = cost
+                    tokens[i] = (True, length)
+            size[i] = best
+
+        encoded = bytearray()
+        i = 0
+        while i < len(data):
+            is_match, length = tokens[i]
+            if is_match:
+                encoded.append(0x80 | (length - ImageEncoderGrayLz.MIN_MATCH))
+                encoded.append(matches[i][1] - 1)
+            else:
+                encoded.append(length - 1)
+                encoded += data[i:i + length]
+            i += length
+        return encoded
+
+
 @dataclass
 class Config:
     input_file: Path
@@ -560,6 +762,11 @@ class Config:
     encoding: ImageEncoding
     opaque: bool
     verbose: bool
+    optimize: Optimize
+    # display page height of the app, used to estimate decode cost
+    page_height: int
+    # when optimizing for speed, maximum size relative to the smallest encoding
+    size_budget: float
 
 
 @dataclass(frozen=True)
@@ -570,7 +777,10 @@ class ImagePackResult(PackResult):
         d = self.image_data
         s = super().__repr__()
         s += f", {d.width}x{d.height} px,\n"
-        s += ("raw" if d.flags & ImageData.FLAG_RAW else "mixed") + " "
+        if d.flags & ImageData.FLAG_LZ:
+            s += "LZ "
+        else:
+            s += ("raw" if d.flags & ImageData.FLAG_RAW else "mixed") + " "
         s += ("1-bit" if d.flags & ImageData.FLAG_BINARY else "4-bit")
         s += (" with alpha" if d.flags & ImageData.FLAG_ALPHA else "") + ", "
         if d.flags & ImageData.FLAG_INDEXED:
@@ -589,6 +799,9 @@ class ImageObject(DataObject):
     index_granularity: str
     encoding: ImageEncoding
     opaque: bool
+    optimize: Optimize
+    page_height: int
+    size_budget: float
 
     def pack(self) -> ImagePackResult:
         try:
@@ -596,7 +809,8 @@ class ImageObject(DataObject):
         except ValueError as e:
             raise PackError(f"invalid index granularity: {e}")
         config = Config(self.file, "", self.region, self.indexed,
-                        index_granularity, self.encoding, self.opaque, False)
+                        index_granularity, self.encoding, self.opaque, False,
+                        self.optimize, self.page_height, self.size_budget)
 
         try:
             image_data = create_image_data(config)
@@ -616,7 +830,9 @@ def register_builder(packer,
                      default_raw: bool = False,
                      default_indexed: bool = True,
                      default_index_gran: str =
-                     repr(ImageEncoder.DEFAULT_INDEX_GRANULARITY)) -> None:
+                     repr(ImageEncoder.DEFAULT_INDEX_GRANULARITY),
+                     default_optimize: str = "size",
+                     default_size_budget: float = DEFAULT_SIZE_BUDGET) -> None:
     @packer.file_builder
     def image(filename: Path, *,
               region: Optional[Tuple[int, int, int, int]] = None,
@@ -624,17 +840,27 @@ def register_builder(packer,
               binary: Optional[bool] = None,
               opaque: bool = False,
               indexed: bool = default_indexed,
-              index_granularity: str = default_index_gran):
+              index_granularity: str = default_index_gran,
+              optimize: str = default_optimize,
+              size_budget: float = default_size_budget,
+              lz: bool = False):
+        try:
+            optimize_mode = Optimize[optimize.upper()]
+        except KeyError:
+            raise PackError(f"invalid optimize mode '{optimize}'")
         yield ImageObject(filename, None if region is None else Rect(*region),
-                          indexed, index_granularity, ImageEncoding(binary, raw), opaque)
+                          indexed, index_granularity, ImageEncoding(binary, raw, lz), opaque,
+                          optimize_mode, packer.page_height, size_budget)
 
 
 def register_helper(packer) -> None:
     @packer.helper
     def set_image_defaults(raw: bool = False, indexed: bool = True,
-                           index_gran: str = repr(ImageEncoder.DEFAULT_INDEX_GRANULARITY)) -> None:
+                           index_gran: str = repr(ImageEncoder.DEFAULT_INDEX_GRANULARITY),
+                           optimize: str = "size",
+                           size_budget: float = DEFAULT_SIZE_BUDGET) -> None:
         # register builder again with different defaults
-        register_builder(packer, raw, indexed, index_gran)
+        register_builder(packer, raw, indexed, index_gran, optimize, size_budget)
 
 
 def create_config(args: argparse.Namespace) -> Config:
@@ -680,11 +906,20 @@ def create_config(args: argparse.Namespace) -> Config:
 
     if raw and index_granularity != ImageEncoder.DEFAULT_INDEX_GRANULARITY:
         raise EncodeError("cannot specify index granularity for raw image")
+    if args.lz and raw:
+        raise EncodeError("cannot specify both --lz (-L) and --raw (-R)")
 
     verbose = output_file != STD_IO
 
+    optimize = Optimize.SPEED if args.speed else Optimize.SIZE
+    if not (0 < args.page_height <= DecodeCost.DISPLAY_HEIGHT):
+        raise EncodeError("page height out of bounds")
+    if args.size_budget < 1:
+        raise EncodeError("size budget must be at least 1")
+
     return Config(input_file, output_file, region, not args.no_index,
-                  index_granularity, ImageEncoding(binary, raw), args.force_opaque, verbose)
+                  index_granularity, ImageEncoding(binary, raw, args.lz), args.force_opaque, verbose,
+                  optimize, args.page_height, args.size_budget)
 
 
 parser = argparse.ArgumentParser(description="Image encoding utility for game console")
@@ -703,7 +938,8 @@ parser.add_argument(
     help="Override index granularity with different value "
          "(can be ignored if it cannot be encoded). "
          "The granularity the number of rows between each index entry. "
-         "Can be a number of rows (<n>r) or a maximum number of bytes (<n>b). "
+         "Can be a number of rows (<n>r) or a maximum number of bytes (<n>b), or entries can be "
+         "placed on page boundaries for an image drawn at a Y position (<y>p, see --page-height). "
          f"Default is '{ImageEncoder.DEFAULT_INDEX_GRANULARITY}'.")
 parser.add_argument(
     "-I", "--no-index", action="store_true", dest="no_index",
@@ -720,9 +956,27 @@ parser.add_argument(
 parser.add_argument(
     "-R", "--raw", action="store_true", dest="force_raw",
     help="Force raw encoding (overrides default mixed encoding)")
+parser.add_argument(
+    "-L", "--lz", action="store_true", dest="lz",
+    help="Use LZ encoding, for 4-bit images only. Compresses images which compress poorly with "
+         "run lengths much better, but takes 267 bytes of RAM to draw. With --speed, the LZ "
+         "encoding is only considered along the others.")
 parser.add_argument(
     "-o", "--opaque", action="store_true", dest="force_opaque",
     help="Treat transparency as black if image has an alpha channel")
+parser.add_argument(
+    "-S", "--speed", action="store_true", dest="speed",
+    help="Choose the raw or mixed encoding and the index granularity with the lowest "
+         "estimated decode cost, within the size budget. Bit depth is chosen as usual.")
+parser.add_argument(
+    "-p", "--page-height", action="store", type=int, dest="page_height",
+    default=DecodeCost.DISPLAY_HEIGHT,
+    help="Display page height used to estimate decode cost with --speed.")
+parser.add_argument(
+    "-b", "--size-budget", action="store", type=float, dest="size_budget",
+    default=DEFAULT_SIZE_BUDGET,
+    help="Maximum size with --speed, relative to the smallest encoding "
+         f"(default is {DEFAULT_SIZE_BUDGET}).")
 
 
 def create_image_data(config: Config) -> ImageData:
@@ -751,6 +1005,11 @@ def create_image_data(config: Config) -> ImageData:
     levels = ImageEncoderGray.get_gray_levels()
     colors = set()
     has_alpha = False
+    if config.encoding.lz and config.optimize == Optimize.SIZE:
+        # LZ encoding is only available for 4-bit images.
+        if config.encoding.binary:
+            raise EncodeError("LZ encoding is only supported for 4-bit images")
+        config.encoding.binary = False
     auto_bit_depth = (config.encoding.binary is None)
     if auto_bit_depth:
         config.encoding.binary = True
@@ -769,24 +1028,62 @@ def create_image_data(config: Config) -> ImageData:
         if alpha_color is None:
             raise EncodeError("cannot pick color for alpha, all colors are used")
 
-    # choose encoder class for chosen encoding
-    if config.encoding.binary:
-        if config.encoding.raw:
-            encoder = ImageEncoderBinaryRaw(image)
-        else:
-            encoder = ImageEncoderBinaryMixed(image)
-    else:
-        if config.encoding.raw:
-            encoder = ImageEncoderGrayRaw(image)
+    def encode(raw: bool, indexed: bool, index_granularity: IndexGranularity,
+               lz: bool = False) -> ImageData:
+        # choose encoder class for chosen encoding
+        if lz:
+            encoder = ImageEncoderGrayLz(image)
+        elif config.encoding.binary:
+            if raw:
+                encoder = ImageEncoderBinaryRaw(image)
+            else:
+                encoder = ImageEncoderBinaryMixed(image)
         else:
-            encoder = ImageEncoderGrayMixed(image)
-
-    # encode image
-    encoder.region = config.region
-    encoder.index_granularity = config.index_granularity
-    encoder.indexed = config.indexed
-    encoder.alpha_color = alpha_color
-    return encoder.encode()
+            if raw:
+                encoder = ImageEncoderGrayRaw(image)
+            else:
+                encoder = ImageEncoderGrayMixed(image)
+
+        # encode image
+        encoder.region = config.region
+        encoder.index_granularity = index_granularity
+        encoder.indexed = indexed
+        encoder.alpha_color = alpha_color
+        return encoder.encode()
+
+    if config.optimize == Optimize.SIZE:
+        if config.encoding.lz:
+            return encode(False, False, config.index_granularity, True)
+        granularities = config.index_granularity.for_page_height(config.page_height)
+        for index_granularity in granularities[:-1]:
+            try:
+                return encode(config.encoding.raw, config.indexed, index_granularity)
+            except EncodeError:
+                # too many bytes between index entries, try with entries every fewer rows.
+                pass
+        return encode(config.encoding.raw, config.indexed, granularities[-1])
+
+    # try the raw encoding, and the mixed encoding not indexed, with the index granularity
+    # given, and with index entries every page or fraction of a page.
+    default_granularity = ImageEncoder.DEFAULT_INDEX_GRANULARITY
+    candidates = [encode(True, False, default_granularity),
+                  encode(False, False, default_granularity)]
+    height = config.region.height()
+    granularities = config.index_granularity.for_page_height(config.page_height)
+    for rows in sorted({config.page_height, config.page_height // 2, config.page_height // 4}):
+        if 0 < rows < height:
+            granularities.append(IndexGranularity(IndexGranularityMode.ROW_COUNT, rows))
+    for index_granularity in granularities:
+        try:
+            candidates.append(encode(False, True, index_granularity))
+        except EncodeError:
+            # too many bytes between index entries.
+            pass
+    if config.encoding.lz and not config.encoding.binary:
+        candidates.append(encode(False, False, default_granularity, True))
+    max_size = min(len(c.encode()) for c in candidates) * config.size_budget
+    return min((c for c in candidates if len(c.encode()) <= max_size),
+               key=lambda c: (DecodeCost.estimate(c, config.page_height), len(c.encode())))
 
 
 def main():
@@ -798,7 +1095,10 @@ def main():
     # print information on encoded image
     if config.verbose:
         nbit = 1 if config.encoding.binary else 4
-        raw_mixed = "raw" if image_data.flags & ImageData.FLAG_RAW else "mixed"
+        if image_data.flags & ImageData.FLAG_LZ:
+            raw_mixed = "LZ"
+        else:
+            raw_mixed = "raw" if image_data.flags & ImageData.FLAG_RAW else "mixed"
         alpha = " with alpha" if image_data.flags & ImageData.FLAG_ALPHA else ""
         print(f"Image is {config.region.width()} x {config.region.height()} px, "
               f"{raw_mixed} {nbit}-bit{alpha}, encoded in {len(data)} bytes")
@@ -11,9 +11,15 @@
 #  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 #  See the License for the specific language governing permissions and
 #  limitations under the License.
+import csv
+import hashlib
 import math
+import multiprocessing
 import os
+import pickle
 import re
+import sys
+from concurrent.futures import ProcessPoolExecutor, as_completed
 from contextlib import contextmanager
 from dataclasses import dataclass, field
 from enum import Enum
@@ -27,6 +33,8 @@ from assets.codegen import CodeGenerator
 from assets.types import DataObject, PackResult, PackError, Location
 # name of the file used to save packed assets data
 from utils import PathLike, print_progress_bar, readable_size
+from assets_report import ReportError, read_assets_map, attribute_reads
+from avr_size import LinkerMap, MapFileError
 
 # name of the generated packed assets file
 ASSETS_FILE = "assets.dat"
@@ -38,6 +46,24 @@ SOURCE_FILE = "src/assets.c"
 # name of the assets directory (that's the working directory when packing).
 ASSETS_DIR = "assets"
 
+# name of the target configuration file, in the working directory when packing.
+TARGET_CONFIG_FILE = "target.cfg"
+
+# directory in which pack results are cached between builds, in the working directory.
+CACHE_DIR = "build/assets_cache"
+
+# name of the generated assets map file, listing all objects with their address and size.
+# It can be combined with the simulator flash read statistics using assets_report.py.
+MAP_FILE = "build/assets_map.csv"
+
+# flash reads saved by the simulator built with SPI_MONITOR, in the working directory.
+FLASH_READS_FILE = "flash_reads.csv"
+# access profile of each asset, updated from the flash reads and kept between packings,
+# with the assets automatically placed in internal memory (see Packer.auto_internal).
+PROFILE_FILE = "build/assets_profile.csv"
+# linker map file of the last AVR build of the app, giving the free program memory.
+LINKER_MAP_FILE = "build/avr/main.map"
+
 
 class ArrayType(Enum):
     # Array with regularly spaced elements (address + single offset).
@@ -66,8 +92,13 @@ class PackObject:
     # these fields are set during packing
     result: Optional[PackResult] = field(default=None)
     address: int = field(default=0)
+    pad_before: int = field(default=0)
     pad_after: int = field(default=0)
 
+    @property
+    def full_name(self) -> str:
+        return f"{self.group}_{self.name}" if self.group else self.name
+
 
 @dataclass(frozen=True)
 class RawObject(DataObject):
@@ -102,6 +133,75 @@ def register_builtin_builders(packer) -> None:
         yield RawObject(data.encode(encoding) + b"\x00", unified_space)
 
 
+def pack_object(obj: DataObject) -> Union[PackResult, PackError]:
+    """Pack a single object, returning the error instead of raising it.
+    Used to pack objects in worker processes."""
+    try:
+        return obj.pack()
+    except PackError as e:
+        return e
+
+
+class PackCache:
+    """Cache of pack results, keyed by a hash of the data object, of the files it refers to,
+    and of the packing code. Entries not used during a packing are removed afterwards."""
+    directory: Path
+    code_hash: bytes
+    used: Set[str]
+
+    def __init__(self, directory: PathLike):
+        self.directory = Path(directory)
+        self.directory.mkdir(parents=True, exist_ok=True)
+        self.code_hash = PackCache._hash_code()
+        self.used = set()
+
+    @staticmethod
+    def _hash_code() -> bytes:
+        """Hash the source of all loaded modules from the packer utilities and from the app
+        directory, so that any change to an encoder invalidates the cache."""
+        h = hashlib.sha256()
+        dirs = (Path(__file__).resolve().parent, Path.cwd().resolve())
+        files = set()
+        for module in list(sys.modules.values()):
+            file = getattr(module, "__file__", None)
+            if file and file.endswith(".py") and \
+                    any(d in Path(file).resolve().parents for d in dirs):
+                files.add(file)
+        for file in sorted(files):
+            h.update(file.encode())
+            with open(file, "rb") as f:
+                h.update(f.read())
+        return h.digest()
+
+    def key(self, obj: DataObject) -> str:
+        h = hashlib.sha256(self.code_hash)
+        h.update(pickle.dumps(obj))
+        # content of files referred to by the object, which are read when packing.
+        for value in vars(obj).values():
+            if isinstance(value, Path) and value.is_file():
+                with open(value, "rb") as file:
+                    h.update(file.read())
+        return h.hexdigest()
+
+    def get(self, key: str) -> Optional[PackResult]:
+        self.used.add(key)
+        try:
+            with open(self.directory / key, "rb") as file:
+                return pickle.load(file)
+        except (IOError, pickle.UnpicklingError, EOFError, AttributeError):
+            return None
+
+    def put(self, key: str, result: PackResult) -> None:
+        with open(self.directory / key, "wb") as file:
+            pickle.dump(result, file)
+
+    def prune(self) -> None:
+        """Remove entries not used since the cache was created."""
+        for file in self.directory.iterdir():
+            if file.name not in self.used:
+                file.unlink()
+
+
 def uint_width_for_max(value: int) -> int:
     return math.ceil(math.log2(value) / 8)
 
@@ -160,10 +260,26 @@ class Packer:
     _curr_group: List[str]
     _is_in_array: bool
     _location: Location
+    _co_access: List[Tuple[str, ...]]
+    _flash_objects: List[PackObject]
+    _auto_internal: List[PackObject]
+
+    # display page height of the app, used to optimize assets decoded on each page
+    page_height: int
+
+    # whether to automatically place the most read assets in internal memory (see pack)
+    auto_internal: bool
 
     # byte value used for padding in regular arrays
     PADDING_BYTE = b"\xff"
 
+    # size of a flash page, to which objects accessed together are aligned
+    FLASH_PAGE_SIZE = 256
+
+    # program memory left free when automatically placing assets in internal memory,
+    # so that the app can still be linked after small code changes.
+    AUTO_INTERNAL_RESERVE = 512
+
     # dimensions in pixel of an app cover image
     APP_COVER_DIMENSIONS = (124, 54)
 
@@ -178,11 +294,17 @@ class Packer:
         self._curr_group = []
         self._is_in_array = False
         self._location = Location.FLASH
+        self._co_access = []
+        self._flash_objects = []
+        self._auto_internal = []
+        self.page_height = self._read_page_height()
+        self.auto_internal = True
 
         # register builders for built-in object types
         register_builtin_builders(self)
         font_gen.register_builder(self)
         image_gen.register_builder(self)
+        image_gen.register_helper(self)
         sound_gen.register_builder(self)
 
         # add cover image as first object
@@ -206,6 +328,18 @@ class Packer:
     def _warn(self, message: str) -> None:
         print(f"WARNING: {message}.")
 
+    def _read_page_height(self) -> int:
+        """Read the display page height from the target configuration file."""
+        try:
+            with open(TARGET_CONFIG_FILE, "r") as file:
+                for line in file:
+                    match = re.match(r"^\s*display_page_height\s*=\s*(\w+)", line)
+                    if match:
+                        return int(match.group(1), 0)
+        except (IOError, ValueError) as e:
+            self._error(f"could not read page height from {TARGET_CONFIG_FILE}: {e}")
+        self._error(f"display page height not defined in {TARGET_CONFIG_FILE}")
+
     def _check_name(self, name: str) -> str:
         name = name.strip().lower()
         if not name:
@@ -357,6 +491,16 @@ class Packer:
             full_name = Packer.PREFIX + full_name
         self._defines[full_name] = value
 
+    def co_access(self, *names: str) -> None:
+        """Declare that objects and groups with these names are accessed together, e.g. in the same
+        frame. Objects are matched by full name (group and name), or by the group they're in.
+        In flash, matched objects are placed contiguously in the order of the names given,
+        starting on a flash page boundary, so that they can be read with fewer commands.
+        Arrays are always kept whole and objects within an array aren't reordered."""
+        if not names:
+            self._error("co-access hint must have at least one name")
+        self._co_access.append(tuple(name.strip().lower() for name in names))
+
     # The following methods are implemented by registered builder (via a decorator),
     # but still declared here to get the types signature. The builder overrides these stubs.
     # ==========================
@@ -373,7 +517,8 @@ class Packer:
         pass  # implemented by registered builder
 
     def font(self, filename: PathLike, *, glyph_width: int, glyph_height: int,
-             extra_line_spacing: int = None, name: str = None) -> None:
+             extra_line_spacing: int = None, row_aligned: bool = None, chars: str = None,
+             name: str = None) -> None:
         pass  # implemented by registered builder
 
     def raw(self, data: Iterable[int], *, name: str, unified_space: bool = False) -> None:
@@ -390,12 +535,21 @@ class Packer:
     # ==========================
 
     def pack(self) -> None:
-        """Pack all assets"""
+        """Pack all assets.
+        If `auto_internal` is set, flash objects and arrays with the most bytes read per frame
+        and per byte are moved to internal memory, in the program memory left free by the last
+        AVR build of the app. Bytes read come from the simulator flash reads, they're attributed
+        to assets with the previous assets map and kept in a profile for the following builds.
+        Only objects addressed in the unified data space can be moved, since the code using them
+        is the same in both locations. Building and packing again converges on a placement."""
         self._pack_assets()
         self._process_regular_arrays()
+        if self.auto_internal:
+            self._place_hot_units()
         self._assign_addresses()
         self._process_flash_indexed_arrays()
         self._print_memory_map()
+        self._write_map_file()
         self._write_assets_file()
 
         gen = CodeGenerator(HEADER_FILE, SOURCE_FILE,
@@ -421,16 +575,43 @@ class Packer:
             yield self._objects[array_start:]
 
     def _pack_assets(self) -> None:
-        """Pack all objects and show progress."""
+        """Pack all objects and show progress. Results of objects unchanged since the last
+        packing are taken from the cache, others are packed in parallel in worker processes."""
+        cache = PackCache(CACHE_DIR)
+        keys = {}
+        to_pack = []
+        for obj in self._objects:
+            key = cache.key(obj.data)
+            obj.result = cache.get(key)
+            if obj.result is None:
+                keys[id(obj)] = key
+                to_pack.append(obj)
+
         n = len(self._objects)
+        done = n - len(to_pack)
         progress = print_progress_bar("Packing objects", " objects", lambda v: v)
-        for i, obj in enumerate(self._objects):
-            progress(i, n)
-            try:
-                obj.result = obj.data.pack()
-            except PackError as e:
-                self._error(e, obj)
-        progress(n, n)
+        progress(done, n)
+
+        def set_result(obj: PackObject, result: Union[PackResult, PackError]) -> None:
+            nonlocal done
+            if isinstance(result, PackError):
+                self._error(result, obj)
+            obj.result = result
+            cache.put(keys[id(obj)], result)
+            done += 1
+            progress(done, n)
+
+        # workers are forked so that builders registered by the packing script are available,
+        # pack sequentially where that's not supported.
+        if len(to_pack) > 1 and "fork" in multiprocessing.get_all_start_methods():
+            with ProcessPoolExecutor(mp_context=multiprocessing.get_context("fork")) as executor:
+                futures = {executor.submit(pack_object, obj.data): obj for obj in to_pack}
+                for future in as_completed(futures):
+                    set_result(futures[future], future.result())
+        else:
+            for obj in to_pack:
+                set_result(obj, pack_object(obj.data))
+        cache.prune()
         print()
 
     def _process_regular_arrays(self) -> None:
@@ -443,12 +624,152 @@ class Packer:
                 for obj in objects:
                     obj.pad_after = max_size - len(obj.result.data)
 
-    def _assign_addresses(self) -> None:
-        """Assign addresses to all objects in flash memory."""
-        addr = 0
+    def _flash_units(self) -> List[List[PackObject]]:
+        """Split objects in flash into units that must be placed contiguously:
+        either a whole array or a single object, in declaration order."""
+        units = []
         for obj in self._objects:
             if obj.location != Location.FLASH:
                 continue
+            if units and obj.group in self._array_types and obj.group == units[-1][0].group:
+                units[-1].append(obj)
+            else:
+                units.append([obj])
+        return units
+
+    def _read_profile(self) -> Tuple[Dict[str, float], Set[str]]:
+        """Read the bytes read per frame for each asset, and the assets placed in internal
+        memory by the last packing. The profile is updated first if there are flash reads newer
+        than the assets map, meaning they were measured with the current layout.
+        Assets in internal memory when measured keep their previous bytes read."""
+        reads = {}
+        placed = set()
+        try:
+            with open(PROFILE_FILE, "r", newline="") as file:
+                for row in csv.DictReader(file):
+                    reads[row["name"]] = float(row["bytes_per_frame"])
+                    if row["internal"] == "1":
+                        placed.add(row["name"])
+        except FileNotFoundError:
+            pass
+        except (IOError, KeyError, ValueError) as e:
+            self._warn(f"could not read assets profile: {e}")
+
+        reads_file = Path(FLASH_READS_FILE)
+        map_file = Path(MAP_FILE)
+        if reads_file.exists() and map_file.exists() and \
+                reads_file.stat().st_mtime > map_file.stat().st_mtime:
+            try:
+                assets = read_assets_map(map_file)
+                attribute_reads(assets, reads_file)
+            except ReportError as e:
+                self._warn(str(e))
+                return reads, placed
+            for asset in assets:
+                if asset.location == Location.FLASH.value:
+                    reads[asset.name] = asset.bytes_per_frame
+        return reads, placed
+
+    def _write_profile(self, reads: Dict[str, float], placed: Set[str]) -> None:
+        try:
+            Path(PROFILE_FILE).parent.mkdir(parents=True, exist_ok=True)
+            with open(PROFILE_FILE, "w", newline="") as file:
+                writer = csv.writer(file)
+                writer.writerow(["name", "bytes_per_frame", "internal"])
+                for name, bytes_per_frame in sorted(reads.items()):
+                    writer.writerow([name, bytes_per_frame, int(name in placed)])
+        except IOError as e:
+            self._error(f"could not write assets profile: {e}")
+
+    def _place_hot_units(self) -> None:
+        """Move the flash units with the most bytes read per frame and per byte to internal
+        memory, within the free program memory. The assets placed by the last packing are
+        part of the linked program, so their size is also available."""
+        if not Path(LINKER_MAP_FILE).exists():
+            return
+        try:
+            linker_map = LinkerMap(LINKER_MAP_FILE)
+            free_size = linker_map.flash_size - linker_map.flash_usage
+        except MapFileError as e:
+            self._warn(f"could not read free program memory: {e}")
+            return
+
+        reads, last_placed = self._read_profile()
+        units = []
+        for unit in self._flash_units()[1:]:
+            # the app cover image is always first in flash, where the launcher reads it.
+            if not all(obj.data.is_in_unified_data_space() for obj in unit) or \
+                    self._array_types.get(unit[0].group) == ArrayType.INDEXED_ABS_FLASH:
+                continue
+            names = [f"{obj.group}/{obj.name}" if obj.group else obj.name for obj in unit]
+            size = sum(len(obj.result.data) + obj.pad_after for obj in unit)
+            bytes_per_frame = sum(reads.get(name, 0) for name in names)
+            if any(name in last_placed for name in names):
+                free_size += size
+            if bytes_per_frame > 0:
+                units.append((bytes_per_frame / size, size, unit, names))
+
+        budget = free_size - Packer.AUTO_INTERNAL_RESERVE
+        placed = set()
+        units.sort(key=lambda u: -u[0])
+        for _, size, unit, names in units:
+            if size <= budget:
+                budget -= size
+                placed.update(names)
+                for obj in unit:
+                    obj.location = Location.INTERNAL
+                self._auto_internal += unit
+        if placed:
+            print(f"Placed {len(placed)} frequently read objects in internal memory, "
+                  f"{readable_size(free_size - Packer.AUTO_INTERNAL_RESERVE - budget)}.")
+        self._write_profile(reads, placed)
+
+    def _layout_flash_units(self) -> List[List[PackObject]]:
+        """Order flash units according to co-access hints, and align the first unit of each
+        cluster of co-accessed objects on a flash page. Other units keep the declaration order.
+        The app cover image always stays first."""
+        units = self._flash_units()
+        cover, units = units[:1], units[1:]
+
+        def matches(unit: List[PackObject], name: str) -> bool:
+            obj = unit[0]
+            return (obj.group == name or obj.group.startswith(name + "_") or
+                    len(unit) == 1 and obj.full_name == name)
+
+        # co-accessed objects may have been moved to internal memory (see pack).
+        internal = [[obj] for obj in self._auto_internal]
+
+        clusters = []
+        for names in self._co_access:
+            cluster = []
+            for name in names:
+                matched = [unit for unit in units if matches(unit, name)]
+                if not matched and not any(matches(unit, name) for unit in internal):
+                    self._error(f"no object or group matches co-access name '{name}' "
+                                f"(or it's already in another hint)")
+                for unit in matched:
+                    units.remove(unit)
+                cluster += matched
+            if cluster:
+                clusters.append(cluster)
+
+        layout = cover
+        addr = sum(len(obj.result.data) + obj.pad_after for obj in cover[0])
+        for cluster in clusters:
+            pad = -addr % Packer.FLASH_PAGE_SIZE
+            cluster[0][0].pad_before = pad
+            addr += pad
+            for unit in cluster:
+                addr += sum(len(obj.result.data) + obj.pad_after for obj in unit)
+            layout += cluster
+        return layout + units
+
+    def _assign_addresses(self) -> None:
+        """Assign addresses to all objects in flash memory, in layout order."""
+        self._flash_objects = [obj for unit in self._layout_flash_units() for obj in unit]
+        addr = 0
+        for obj in self._flash_objects:
+            addr += obj.pad_before
             obj.address = addr
             addr += len(obj.result.data) + obj.pad_after
 
@@ -463,8 +784,10 @@ class Packer:
                 index = ArrayIndexObject(arr_name, [obj.address for obj in objects])
                 obj = PackObject(f"{arr_name}.index", "", Location.FLASH, index)
                 obj.result = index.pack()
-                obj.address = self._objects[-1].address + len(self._objects[-1].result.data)
+                last = self._flash_objects[-1]
+                obj.address = last.address + len(last.result.data) + last.pad_after
                 self._objects.append(obj)
+                self._flash_objects.append(obj)
 
     def _print_memory_map(self) -> None:
         """Print a list of result for packed objects by location."""
@@ -486,24 +809,37 @@ class Packer:
                 print(f"{name}, {obj.data.get_type_name()}, {res_str}")
             print()
 
-        # group objects by location
-        by_location = {loc: [] for loc in Location}
-        for obj in self._objects:
-            by_location[obj.location].append(obj)
+        do_print([obj for obj in self._objects if obj.location == Location.INTERNAL],
+                 "internal", False)
+        do_print(self._flash_objects, "flash", True)
 
-        do_print(by_location[Location.INTERNAL], "internal", False)
-        do_print(by_location[Location.FLASH], "flash", True)
+    def _write_map_file(self) -> None:
+        """Write a CSV file listing all objects with their location, address and size."""
+        try:
+            Path(MAP_FILE).parent.mkdir(parents=True, exist_ok=True)
+            with open(MAP_FILE, "w", newline="") as file:
+                writer = csv.writer(file)
+                writer.writerow(["name", "type", "location", "address", "size", "description"])
+                objects = [obj for obj in self._objects if obj.location == Location.INTERNAL]
+                objects += self._flash_objects
+                for obj in objects:
+                    name = f"{obj.group}/{obj.name}" if obj.group else obj.name
+                    description = " ".join(repr(obj.result).split())
+                    address = f"0x{obj.address:06x}" if obj.location == Location.FLASH else ""
+                    writer.writerow([name, obj.data.get_type_name(), obj.location.value,
+                                     address, len(obj.result.data), description])
+        except IOError as e:
+            self._error(f"could not write assets map file: {e}")
 
     def _write_assets_file(self) -> None:
         """Place objects contiguously and write the result to a file."""
         print("Writing assets file... ", end="")
         try:
             with open(ASSETS_FILE, "wb") as file:
-                for obj in self._objects:
-                    if obj.location == Location.FLASH:
-                        file.write(obj.result.data)
-                        for i in range(obj.pad_after):
-                            file.write(Packer.PADDING_BYTE)
+                for obj in self._flash_objects:
+                    file.write(Packer.PADDING_BYTE * obj.pad_before)
+                    file.write(obj.result.data)
+                    file.write(Packer.PADDING_BYTE * obj.pad_after)
             print("DONE")
         except IOError as e:
             self._error(f"could not write assets file: {e}")
@@ -540,8 +876,37 @@ class Packer:
                 # generate define for the object address
                 gen.add_define(name, obj.address, True, location)
 
+            if isinstance(obj.result, (image_gen.ImagePackResult, font_gen.FontPackResult)):
+                self._write_static_header(gen, name, obj.result)
+
         gen.add_separator()
 
+    @staticmethod
+    def _write_static_header(gen: CodeGenerator, name: str, result: PackResult) -> None:
+        """Write the image or font header to a table in internal memory, and macros to draw
+        the image or set the font using that header instead of reading it (see graphics.h).
+        For images, the macros also select the drawing function for the image format."""
+        # image header + index header (read even if image isn't indexed), or font header.
+        header = result.data[:6].ljust(6, b"\0")
+        gen.add_array(f"{name}_header", 1, header)
+        name_u = name.upper()
+        if isinstance(result, font_gen.FontPackResult):
+            gen.add_macro(f"{name_u}_SET", [], f"GRAPHICS_FONT_STATIC({name_u}, {name_u}_HEADER)")
+            return
+
+        flags = result.image_data.flags
+        func = "graphics_image_"
+        func += "1bit" if flags & image_gen.ImageData.FLAG_BINARY else "4bit"
+        if flags & image_gen.ImageData.FLAG_LZ:
+            func += "_lz"
+        else:
+            func += "_raw" if flags & image_gen.ImageData.FLAG_RAW else "_mixed"
+        gen.add_macro(f"{name_u}_DRAW", ["x", "y"],
+                      f"GRAPHICS_IMAGE_STATIC({func}, {name_u}, {name_u}_HEADER, x, y)")
+        gen.add_macro(f"{name_u}_DRAW_REGION", ["x", "y", "top", "bottom"],
+                      f"GRAPHICS_IMAGE_STATIC({func}_region, {name_u}, {name_u}_HEADER, "
+                      f"x, y, top, bottom)")
+
     def _write_source_arrays(self, gen: CodeGenerator) -> None:
         for objects in self._iterate_arrays():
             first = objects[0]
@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+
+#  Copyright 2022 Nicolas Maltais
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+
+# Reports the runtime cost of each asset, by combining the assets map written by the packer
+# with the flash reads saved by the simulator when built with SPI_MONITOR. Bytes read from
+# flash are attributed to the asset they belong to. Cycles annotated with `trace_cycles` are
+# attributed to the asset last read, which is usually the one being decoded. Assets are listed
+# from the most to the least costly per frame, to find which ones should be re-encoded,
+# cached, or moved to internal memory.
+#
+# Usage (from the app directory, after running the simulator):
+#
+#   $ ./assets_report.py build/assets_map.csv [flash_reads.csv]
+#
+
+import argparse
+import bisect
+import csv
+import sys
+from dataclasses import dataclass
+from pathlib import Path
+from typing import List
+
+# CPU cycles needed to transfer a single byte on the SPI bus (see sim/cycles.h).
+SPI_BYTE_CYCLES = 16
+
+
+class ReportError(Exception):
+    pass
+
+
+@dataclass
+class Asset:
+    name: str
+    type: str
+    location: str
+    address: int
+    size: int
+    description: str
+    bytes_per_frame: float = 0
+    cycles_per_frame: float = 0
+
+    @property
+    def total_cycles(self) -> float:
+        return self.bytes_per_frame * SPI_BYTE_CYCLES + self.cycles_per_frame
+
+
+def read_assets_map(filename: Path) -> List[Asset]:
+    try:
+        with open(filename, "r", newline="") as file:
+            return [Asset(row["name"], row["type"], row["location"],
+                          int(row["address"], 0) if row["address"] else -1,
+                          int(row["size"]), row["description"])
+                    for row in csv.DictReader(file)]
+    except (IOError, KeyError, ValueError) as e:
+        raise ReportError(f"could not read assets map: {e}")
+
+
+def attribute_reads(assets: List[Asset], filename: Path) -> float:
+    """Attribute flash reads to assets in flash, each asset spanning up to the next one.
+    Returns the number of bytes per frame read outside of any asset."""
+    flash_assets = sorted((a for a in assets if a.address >= 0), key=lambda a: a.address)
+    starts = [a.address for a in flash_assets]
+    unattributed = 0
+    try:
+        with open(filename, "r", newline="") as file:
+            for row in csv.DictReader(file):
+                address = int(row["address"], 0)
+                i = bisect.bisect_right(starts, address) - 1
+                if i < 0 or i == len(starts) - 1 and \
+                        address >= flash_assets[i].address + flash_assets[i].size:
+                    unattributed += float(row["bytes_per_frame"])
+                    continue
+                flash_assets[i].bytes_per_frame += float(row["bytes_per_frame"])
+                flash_assets[i].cycles_per_frame += float(row["cycles_per_frame"])
+    except (IOError, KeyError, ValueError) as e:
+        raise ReportError(f"could not read flash reads: {e}")
+    return unattributed
+
+
+def main() -> None:
+    args = parser.parse_args()
+    assets = read_assets_map(Path(args.map_file))
+    unattributed = attribute_reads(assets, Path(args.reads_file))
+
+    assets.sort(key=lambda a: (-a.total_cycles, -a.size))
+    name_width = max(len(a.name) for a in assets)
+    type_width = max(len(a.type) for a in assets)
+    print(f"{'NAME':<{name_width}}  {'TYPE':<{type_width}}  {'LOCATION':<8}  {'SIZE':>7}  "
+          f"{'BYTES/FRAME':>11}  {'CYCLES/FRAME':>12}  DESCRIPTION")
+    for a in assets:
+        if a.location == "flash":
+            cost = f"{a.bytes_per_frame:>11.1f}  {a.total_cycles:>12.0f}"
+        else:
+            cost = f"{'-':>11}  {'-':>12}"
+        print(f"{a.name:<{name_width}}  {a.type:<{type_width}}  {a.location:<8}  {a.size:>7}  "
+              f"{cost}  {a.description}")
+
+    total_bytes = sum(a.bytes_per_frame for a in assets)
+    total_cycles = sum(a.total_cycles for a in assets)
+    print(f"\nTotal: {total_bytes:.1f} bytes and {total_cycles:.0f} cycles per frame "
+          f"({total_cycles * 100 / args.frame_cycles:.1f}% of a {args.frame_cycles} cycles frame).")
+    if unattributed:
+        print(f"{unattributed:.1f} bytes per frame read outside of assets.")
+
+
+parser = argparse.ArgumentParser(description="Report the runtime cost of each asset "
+                                             "from simulator flash reads")
+parser.add_argument(
+    "map_file", action="store", type=str,
+    help="Assets map file written by the packer (build/assets_map.csv in the app directory)")
+parser.add_argument(
+    "reads_file", action="store", type=str, nargs="?", default="flash_reads.csv",
+    help="Flash reads file saved by the simulator built with SPI_MONITOR "
+         "(default is flash_reads.csv)")
+parser.add_argument(
+    "-f", "--frame-cycles", action="store", type=int, dest="frame_cycles", default=625000,
+    help="CPU cycles available per frame, for the percentage of total cost "
+         "(default is 625000, 16 FPS at 10 MHz)")
+
+if __name__ == '__main__':
+    try:
+        main()
+    except ReportError as ex:
+        print(f"ERROR: {ex}", file=sys.stderr)
+        exit(1)
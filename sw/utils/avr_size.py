@@ -26,33 +26,52 @@
 
 import re
 import sys
-import colorama
 
 
 class MapFileError(Exception):
     pass
 
 
-def main() -> None:
-    colorama.init()
-
-    if len(sys.argv) != 2:
-        raise MapFileError("wrong number of arguments")
+class LinkerMap:
+    """Symbols of a linker map file, and the flash usage computed from them."""
 
-    try:
-        with open(sys.argv[1], "r") as file:
-            content = file.read()
-    except IOError as e:
-        raise MapFileError(f"Map file couldn't be opened: {e}")
+    def __init__(self, filename: str):
+        try:
+            with open(filename, "r") as file:
+                self.content = file.read()
+        except IOError as e:
+            raise MapFileError(f"Map file couldn't be opened: {e}")
 
-    def get_symbol_value(name: str) -> int:
-        match = re.search(r"0x([a-f\d]+)]?\s+" + name, content)
+    def get_symbol_value(self, name: str) -> int:
+        match = re.search(r"0x([a-f\d]+)]?\s+" + name, self.content)
         if not match:
             raise MapFileError(f"Symbol not found: {name}")
         return int(match.group(1)[2:], 16)
 
-    def get_section_size(name: str) -> int:
-        return get_symbol_value(f"{name}_end") - get_symbol_value(f"{name}_start")
+    def get_section_size(self, name: str) -> int:
+        return self.get_symbol_value(f"{name}_end") - self.get_symbol_value(f"{name}_start")
+
+    @property
+    def flash_usage(self) -> int:
+        return (self.get_section_size("__text") + self.get_section_size("__rodata") +
+                self.get_section_size("__data_load"))
+
+    @property
+    def flash_size(self) -> int:
+        return self.get_symbol_value("__TARGET_TEXT_LENGTH__")
+
+
+def main() -> None:
+    # imported here so that LinkerMap can be used without it (see assets_packer.py).
+    import colorama
+    colorama.init()
+
+    if len(sys.argv) != 2:
+        raise MapFileError("wrong number of arguments")
+
+    linker_map = LinkerMap(sys.argv[1])
+    get_symbol_value = linker_map.get_symbol_value
+    get_section_size = linker_map.get_section_size
 
     def print_section_usage(name: str, usage: int, size: int) -> None:
         print(f"{name:<16}   {usage:>7} B   {size:>9} B   {usage / size:>6.1%}")
@@ -93,8 +112,8 @@ def main() -> None:
     rodata_size = get_section_size("__rodata")
     data_load_size = get_section_size("__data_load")
 
-    flash_size = get_symbol_value("__TARGET_TEXT_LENGTH__")
-    flash_usage = text_size + rodata_size + data_load_size
+    flash_size = linker_map.flash_size
+    flash_usage = linker_map.flash_usage
     print_section_usage("Flash", flash_usage, flash_size)
     print_subsection_usage("Text", text_size)
     if rodata_size:
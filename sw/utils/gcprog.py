@@ -35,18 +35,29 @@
 import argparse
 import signal
 import sys
-from typing import Optional
+import time
+from typing import Optional, List
 
 import prog.app as app
+import prog.batch as batch
 import prog.eeprom as eeprom
 import prog.flash as flash
 import prog.memory as memory
+import prog.perf as perf
+import prog.evtrace as evtrace
 from prog.battery import BatteryManager
 from prog.comm import Comm, ProgError, Packet, PacketType, CommInterface
 from prog.spi import SpiInterface
 from utils import DataReader
 
-VERSION = 3
+VERSION = 4
+
+# first system app version supporting the baud rate packet.
+BAUD_VERSION = 8
+# baud rate negotiated by default when system app supports it.
+DEFAULT_FAST_BAUD_RATE = 1_000_000
+# time after which the system app reverts to the default baud rate if new one isn't confirmed.
+BAUD_CONFIRM_TIMEOUT = 0.2
 
 EEPROM_LOCAL_FILE = "dev/eeprom.dat"
 FLASH_LOCAL_FILE = "dev/flash.dat"
@@ -72,6 +83,10 @@ parser.add_argument(
 parser.add_argument(
     "--sim", action="store_true", dest="simulator",
     help="Connect to the simulator socket instead of the actual device.")
+parser.add_argument(
+    "-b", "--baud", action="store", type=int, dest="baud_rate", default=DEFAULT_FAST_BAUD_RATE,
+    help=f"Baud rate to negotiate for memory operations, falling back to "
+         f"{Comm.DEFAULT_BAUD_RATE} if it fails (default is {DEFAULT_FAST_BAUD_RATE})")
 
 subparsers = parser.add_subparsers(dest="command")
 
@@ -146,6 +161,18 @@ data_parser.add_argument(
     "--no-confirm", action="store_false", default=True, dest="confirm",
     help="Skip confirmation, do the operation directly.")
 
+# defrag command
+defrag_parser = subparsers.add_parser(
+    "defrag", help="Defragment flash memory",
+    description="Move installed apps in flash so that they are packed together and all free space "
+                "is left at the end of the device. If the system app supports it, data is copied "
+                "on the device instead of going through the serial connection. The flash index is "
+                "only updated once all apps have been moved. If this operation fails, it should "
+                "be retried before booting.")
+defrag_parser.add_argument(
+    "--no-confirm", action="store_false", default=True, dest="confirm",
+    help="Skip confirmation, defragment directly.")
+
 # list command
 list_parser = subparsers.add_parser(
     "list", help="List and describe installed apps",
@@ -156,6 +183,60 @@ list_parser.add_argument(
     "--details", action="store_true", default=False, dest="details",
     help="Show more information about the apps.")
 
+# perf command
+perf_parser = subparsers.add_parser(
+    "perf", help="Log performance stats of the system app",
+    description="Periodically read and print performance counters gathered by the system app "
+                "on the device: frame rate, frame time histogram, skipped frames, and if the "
+                "firmware was built with the monitors enabled, sound interrupts and main loop "
+                "phases. Press Ctrl+C to stop.")
+perf_parser.add_argument(
+    "-i", "--interval", action="store", type=float, default=1.0, dest="interval",
+    help="Interval between readings in seconds (default is 1 s).")
+perf_parser.add_argument(
+    "-n", "--count", action="store", type=int, default=0, dest="count",
+    help="Number of readings, or 0 to log until interrupted (default).")
+perf_parser.add_argument(
+    "-o", "--output", action="store", type=str, default=None, dest="output_file",
+    help="CSV file to which readings are saved.")
+
+# trace command
+trace_parser = subparsers.add_parser(
+    "trace", help="Show the event trace of the system app",
+    description="Periodically read the events recorded by the bootloader and the system app on "
+                "the device, like frame boundaries, sound buffer underruns and EEPROM waits, and "
+                "print them as a timeline. The firmware must be built with EVENT_TRACE. "
+                "Press Ctrl+C to stop.")
+trace_parser.add_argument(
+    "-i", "--interval", action="store", type=float, default=0.2, dest="interval",
+    help="Interval between readings in seconds (default is 0.2 s).")
+trace_parser.add_argument(
+    "-t", "--time", action="store", type=float, default=0.0, dest="duration",
+    help="Duration of the trace in seconds, or 0 to trace until interrupted (default).")
+trace_parser.add_argument(
+    "-o", "--output", action="store", type=str, default=None, dest="output_file",
+    help="CSV file to which events are saved.")
+
+# batch command
+batch_parser = subparsers.add_parser(
+    "batch", help="Program multiple devices at once",
+    description="Initialize multiple devices and install the apps listed in a manifest file on "
+                "them, with one worker per serial port. The manifest lists app image files, one "
+                "per line, with paths relative to the manifest. The --device option is ignored. "
+                "A result is reported for each device.")
+batch_parser.add_argument(
+    "manifest", action="store", type=str,
+    help="Install manifest file.")
+batch_parser.add_argument(
+    "ports", action="store", type=str, nargs="+",
+    help="UART device filenames, one per device to program.")
+batch_parser.add_argument(
+    "-d", "--downgrade", action="store_true", default=False, dest="downgrade",
+    help="If the new version is older than the installed version, allow downgrade.")
+batch_parser.add_argument(
+    "-l", "--log-dir", action="store", type=str, default=None, dest="log_dir",
+    help="Directory in which to save the output of the operations for each device.")
+
 # eeprom command
 memory.create_parser(subparsers, eeprom.EEPROM_SIZE, "EEPROM")
 
@@ -186,6 +267,9 @@ class Prog(CommInterface):
     boot_version: Optional[int]
     system_version_comp: Optional[int]
 
+    # app manager used by the current command, if any.
+    app_manager: Optional[app.AppManager]
+
     interrupted: bool
     operation_in_progress: bool
 
@@ -204,6 +288,7 @@ class Prog(CommInterface):
         self.system_version = None
         self.boot_version = None
         self.system_version_comp = None
+        self.app_manager = None
 
         if self.local_run:
             self.eeprom = eeprom.EepromDriver.local(EEPROM_LOCAL_FILE)
@@ -225,12 +310,24 @@ class Prog(CommInterface):
             self.print_version()
             return
         self.check_version()
+        if not self.local_run:
+            self.flash.device_commands = self.system_version >= flash.DEVICE_COMMANDS_VERSION
+            self.flash.device_stream = self.system_version >= flash.DEVICE_STREAM_VERSION
+            self.flash.device_crc = self.system_version >= memory.DEVICE_CRC_VERSION
+            self.flash.device_lzss = self.system_version >= flash.DEVICE_LZSS_VERSION
+            self.flash.device_copy = self.system_version >= flash.DEVICE_COPY_VERSION
+            self.eeprom.device_crc = self.system_version >= memory.DEVICE_CRC_VERSION
 
         cmd = self.args.command
         if cmd == "battery":
             self.command_battery()
+        elif cmd == "perf":
+            self.command_perf()
+        elif cmd == "trace":
+            self.command_trace()
         else:
             self.lock()
+            self.negotiate_baud_rate()
             if cmd == "eeprom":
                 self.command_eeprom()
             elif cmd == "flash":
@@ -243,9 +340,13 @@ class Prog(CommInterface):
                 self.command_uninstall()
             elif cmd == "data":
                 self.command_data()
+            elif cmd == "defrag":
+                self.command_defrag()
             elif cmd == "list":
                 self.command_list()
 
+            self.notify_index_changed()
+
             if self.local_run:
                 self.eeprom.save()
                 self.flash.save()
@@ -261,11 +362,22 @@ class Prog(CommInterface):
             self.system_version_comp = VERSION
         elif self.comm.is_connected():
             self.write(Packet(PacketType.VERSION))
-            version = self.read().payload
+            try:
+                version = self.read().payload
+            except ProgError:
+                if self.args.simulator:
+                    raise
+                # device may have been left at the negotiated baud rate by an interrupted run.
+                self.comm.set_baud_rate(self.args.baud_rate)
+                self.write(Packet(PacketType.VERSION))
+                version = self.read().payload
             reader = DataReader(version)
             self.system_version = reader.read(2)
             self.boot_version = reader.read(2)
             self.system_version_comp = reader.read(2)
+            if len(version) >= 8:
+                # system app reports its RX buffer size, allowing pipelined requests.
+                self.comm.rx_buffer_size = reader.read(2)
 
     def check_version(self) -> None:
         if self.system_version_comp > VERSION:
@@ -295,15 +407,24 @@ class Prog(CommInterface):
             self.interrupt_exit()
         self.operation_in_progress = False
 
-    def read(self) -> Packet:
+    def read(self, more: bool = False) -> Packet:
         """Packet read wrapper around Comm.read to ensure that read operation is not interrupted."""
         self.operation_in_progress = True
-        packet = self.comm.read()
+        packet = self.comm.read(more)
         if self.interrupted:
             self.interrupt_exit()
         self.operation_in_progress = False
         return packet
 
+    def transact(self, packets: List[Packet]) -> List[Packet]:
+        """Packet transaction wrapper around Comm.transact to ensure that it's not interrupted."""
+        self.operation_in_progress = True
+        responses = self.comm.transact(packets)
+        if self.interrupted:
+            self.interrupt_exit()
+        self.operation_in_progress = False
+        return responses
+
     def sigint_handler(self, signum, frame):
         if self.operation_in_progress:
             self.interrupted = True
@@ -319,12 +440,47 @@ class Prog(CommInterface):
         if not self.local_run:
             self.write(Packet(PacketType.LOCK, [0x00]))
             self.read()
+            # the system app goes back to the default baud rate on unlock.
+            self.comm.set_baud_rate(Comm.DEFAULT_BAUD_RATE)
+
+    def negotiate_baud_rate(self) -> None:
+        """Switch to a faster baud rate if supported, falling back to the default on failure."""
+        baud_rate = self.args.baud_rate
+        if self.local_run or self.args.simulator or self.system_version < BAUD_VERSION or \
+                baud_rate == self.comm.baud_rate:
+            return
+        self.write(Packet(PacketType.BAUD, baud_rate.to_bytes(4, "little")))
+        if not self.read().payload[0]:
+            return  # baud rate not supported by device
+        self.comm.set_baud_rate(baud_rate)
+        try:
+            # confirm new baud rate, the system app reverts if not received correctly.
+            self.write(Packet(PacketType.VERSION))
+            self.read()
+        except ProgError:
+            self.comm.set_baud_rate(Comm.DEFAULT_BAUD_RATE)
+            time.sleep(BAUD_CONFIRM_TIMEOUT * 2)
+            self.comm.serial.read_all()
 
     def create_app_manager(self) -> app.AppManager:
         manager = app.AppManager(self.eeprom, self.flash)
         manager.boot_version = self.boot_version
+        self.app_manager = manager
         return manager
 
+    def notify_index_changed(self) -> None:
+        """Notify the system app of the flash index entries changed by the command, so that it
+        updates them without reloading the whole index. Raw flash writes reload all of it."""
+        if self.local_run or self.system_version < app.INDEX_CHANGED_VERSION:
+            return
+        if self.args.command == "flash":
+            slots = {app.INDEX_CHANGED_ALL}
+        elif self.app_manager:
+            slots = self.app_manager.changed_slots
+        else:
+            return
+        self.transact([Packet(PacketType.INDEX_CHANGED, [slot]) for slot in sorted(slots)])
+
     def command_eeprom(self) -> None:
         config = memory.create_config(eeprom.EEPROM_SIZE, self.args)
         memory.execute_config(self.eeprom, config)
@@ -359,9 +515,31 @@ class Prog(CommInterface):
         elif self.args.erase:
             manager.erase_eeprom(app_id)
 
+    def command_defrag(self) -> None:
+        manager = self.create_app_manager()
+        manager.confirm = self.args.confirm
+        manager.defrag()
+
     def command_list(self) -> None:
         self.create_app_manager().list_all(self.args.details)
 
+    def command_perf(self) -> None:
+        if self.local_run:
+            raise ProgError("perf command requires a device connection")
+        if self.system_version < perf.PERF_STATS_VERSION:
+            raise ProgError(f"perf command requires system app version "
+                            f"{perf.PERF_STATS_VERSION} or later")
+        perf.PerfManager(self).log(self.args.interval, self.args.count, self.args.output_file)
+
+    def command_trace(self) -> None:
+        if self.local_run:
+            raise ProgError("trace command requires a device connection")
+        if self.system_version < evtrace.EVENT_TRACE_VERSION:
+            raise ProgError(f"trace command requires system app version "
+                            f"{evtrace.EVENT_TRACE_VERSION} or later")
+        evtrace.EventTraceManager(self).log(self.args.interval, self.args.duration,
+                                            self.args.output_file)
+
     def command_battery(self) -> None:
         manager = BatteryManager(self)
         if self.args.calibration:
@@ -373,6 +551,14 @@ class Prog(CommInterface):
 def main() -> None:
     args = parser.parse_args()
     try:
+        if args.command == "batch":
+            # each device is programmed by its own process, no connection is made here.
+            global_options = [f"--baud={args.baud_rate}"]
+            install_options = ["--downgrade"] if args.downgrade else []
+            if not batch.program_all(args.ports, args.manifest, global_options,
+                                     install_options, args.log_dir):
+                exit(1)
+            return
         prog = Prog(args)
         prog.do_command()
     except ProgError as e:
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+
+#  Copyright 2022 Nicolas Maltais
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+
+# Runs a Google Test binary in several processes, each running a shard of the tests.
+# The simulated system state is global, so tests can't run in parallel threads of a
+# single process. The output of each shard is saved next to its XML report, and results
+# are merged into a summary. The exit code is non-zero if any test failed.
+#
+# Usage:
+#
+#   $ ./gtest_shards.py <test_binary> [<shards>]
+#
+# The number of shards defaults to the number of host cores.
+
+import os
+import subprocess
+import sys
+import xml.etree.ElementTree as ElementTree
+from concurrent.futures import ThreadPoolExecutor
+from pathlib import Path
+
+
+def run_shard(binary: Path, index: int, total: int, output_dir: Path) -> int:
+    env = dict(os.environ)
+    env["GTEST_SHARD_INDEX"] = str(index)
+    env["GTEST_TOTAL_SHARDS"] = str(total)
+    xml_file = output_dir / f"shard{index}.xml"
+    with open(output_dir / f"shard{index}.txt", "w") as log:
+        return subprocess.run([binary.absolute(), f"--gtest_output=xml:{xml_file}"],
+                              env=env, stdout=log, stderr=subprocess.STDOUT).returncode
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: gtest_shards.py <test_binary> [<shards>]")
+        sys.exit(1)
+
+    binary = Path(sys.argv[1])
+    total = int(sys.argv[2]) if len(sys.argv) > 2 else os.cpu_count()
+    output_dir = binary.parent / f"{binary.name}_shards"
+    output_dir.mkdir(exist_ok=True)
+    for file in output_dir.iterdir():
+        file.unlink()
+
+    print(f"Running {binary} in {total} shards...")
+    with ThreadPoolExecutor(max_workers=total) as executor:
+        codes = list(executor.map(lambda i: run_shard(binary, i, total, output_dir),
+                                  range(total)))
+
+    # merge results from all shards
+    tests = 0
+    skipped = 0
+    failed = []
+    for index in range(total):
+        xml_file = output_dir / f"shard{index}.xml"
+        if not xml_file.exists():
+            # shard crashed before writing its report.
+            failed.append(f"shard {index} (exit code {codes[index]})")
+            continue
+        for case in ElementTree.parse(xml_file).getroot().iter("testcase"):
+            tests += 1
+            if case.find("failure") is not None:
+                failed.append(f"{case.get('classname')}.{case.get('name')}")
+            elif case.find("skipped") is not None or case.get("result") == "skipped":
+                skipped += 1
+
+    print(f"{tests} tests ran, {tests - len(failed) - skipped} passed, "
+          f"{skipped} skipped, {len(failed)} failed.")
+    for name in failed:
+        print(f"FAILED: {name}")
+    print(f"Shard outputs saved in {output_dir}")
+
+    if failed or any(codes):
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+
+#  Copyright 2022 Nicolas Maltais
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+
+
+# Selects which functions marked with AVR_OPTIMIZE(name) are built with -O3, from a function
+# profile saved by the simulator built with FUNCTION_PROFILE=1. Marked functions are selected
+# from the most to the least time spent in them, as long as the size they take in addition
+# to their -Os size fits in the program memory left free by the -Os build. The selection is
+# written to the app optimize.h header, used instead of optimizing all marked functions.
+# Hot functions that aren't marked are also listed, as candidates to be marked.
+#
+# Usage (from the sw directory, after running the simulator from the app directory):
+#
+#   $ make compile TARGET=app/tworld OPTIMIZE=none
+#   $ make compile TARGET=app/tworld OPTIMIZE=all
+#   $ ./utils/optimize_select.py app/tworld
+#
+
+import argparse
+import csv
+import re
+import subprocess
+import sys
+from dataclasses import dataclass
+from pathlib import Path
+from typing import Dict, List
+
+from avr_size import LinkerMap, MapFileError
+
+# directories searched for functions marked with AVR_OPTIMIZE, in addition to the app sources.
+SOURCE_DIRS = ["core"]
+
+# number of hot functions listed in the report.
+REPORT_COUNT = 20
+
+
+class OptimizeError(Exception):
+    pass
+
+
+@dataclass
+class Function:
+    name: str
+    calls: int = 0
+    self_time: float = 0
+    marked: bool = False
+    # size in bytes of the function built with -Os and -O3, 0 if inlined everywhere.
+    size_os: int = 0
+    size_o3: int = 0
+    selected: bool = False
+
+    @property
+    def size_cost(self) -> int:
+        return max(0, self.size_o3 - self.size_os)
+
+
+def read_symbol_sizes(nm: str, elf_file: Path) -> Dict[str, int]:
+    """Read the size of each function in an executable, merging clones created by the
+    compiler (`.constprop`, `.lto_priv`, etc) with the original function."""
+    try:
+        output = subprocess.run([nm, "--size-sort", "-S", str(elf_file)], check=True,
+                                capture_output=True, text=True).stdout
+    except (OSError, subprocess.CalledProcessError) as e:
+        raise OptimizeError(f"could not read symbols of {elf_file}: {e}")
+    sizes = {}
+    for line in output.splitlines():
+        parts = line.split()
+        if len(parts) == 4 and parts[2].lower() == "t":
+            name = parts[3].split(".")[0]
+            sizes[name] = sizes.get(name, 0) + int(parts[1], 16)
+    return sizes
+
+
+def read_profile(profile_file: Path, sim_file: Path) -> Dict[str, Function]:
+    """Read the calls and time spent per function, resolving function offsets in the
+    simulator executable with its symbols."""
+    try:
+        output = subprocess.run(["nm", "--defined-only", str(sim_file)], check=True,
+                                capture_output=True, text=True).stdout
+    except (OSError, subprocess.CalledProcessError) as e:
+        raise OptimizeError(f"could not read symbols of {sim_file}: {e}")
+    names = {}
+    for line in output.splitlines():
+        parts = line.split()
+        if len(parts) == 3 and parts[1].lower() == "t":
+            names[int(parts[0], 16)] = parts[2]
+
+    functions = {}
+    try:
+        with open(profile_file, "r", newline="") as file:
+            for row in csv.DictReader(file):
+                name = names.get(int(row["offset"], 0))
+                if name:
+                    functions[name] = Function(name, int(row["calls"]),
+                                               float(row["self_time_us"]))
+    except (IOError, KeyError, ValueError) as e:
+        raise OptimizeError(f"could not read function profile: {e}")
+    return functions
+
+
+def find_marked_functions(dirs: List[Path]) -> List[str]:
+    names = set()
+    for directory in dirs:
+        for file in directory.rglob("*.c"):
+            names.update(re.findall(r"\bAVR_OPTIMIZE\((\w+)\)", file.read_text()))
+    return sorted(names)
+
+
+def write_header(filename: Path, functions: List[Function]) -> None:
+    try:
+        with open(filename, "w") as file:
+            file.write("// file auto-generated by optimize_select.py, do not modify directly\n")
+            file.write("#ifndef OPTIMIZE_H\n#define OPTIMIZE_H\n\n")
+            for func in functions:
+                value = " __attribute__((optimize(\"O3\")))" if func.selected else ""
+                file.write(f"#define AVR_OPTIMIZE_{func.name}{value}\n")
+            file.write("\n#endif\n")
+    except IOError as e:
+        raise OptimizeError(f"could not write {filename}: {e}")
+
+
+def main() -> None:
+    args = parser.parse_args()
+    target = Path(args.target)
+    build_dir = target / "build"
+
+    functions = read_profile(Path(args.profile_file or target / "function_profile.csv"),
+                             build_dir / "sim/main")
+    total_time = sum(func.self_time for func in functions.values())
+    if total_time == 0:
+        raise OptimizeError("function profile is empty")
+
+    marked = []
+    for name in find_marked_functions([target / "src"] + [Path(d) for d in SOURCE_DIRS]):
+        func = functions.setdefault(name, Function(name))
+        func.marked = True
+        marked.append(func)
+    if not marked:
+        raise OptimizeError("no functions are marked with AVR_OPTIMIZE")
+
+    sizes_os = read_symbol_sizes(args.nm, build_dir / "avr-optimize-none/main.elf")
+    sizes_o3 = read_symbol_sizes(args.nm, build_dir / "avr-optimize-all/main.elf")
+    try:
+        linker_map = LinkerMap(str(build_dir / "avr-optimize-none/main.map"))
+        budget = linker_map.flash_size - linker_map.flash_usage - args.reserve
+    except MapFileError as e:
+        raise OptimizeError(str(e))
+    for func in marked:
+        func.size_os = sizes_os.get(func.name, 0)
+        func.size_o3 = sizes_o3.get(func.name, 0)
+
+    # greedily select marked functions from the hottest, skipping those that don't fit.
+    used = 0
+    for func in sorted(marked, key=lambda f: -f.self_time):
+        if func.self_time > 0 and used + func.size_cost <= budget:
+            func.selected = True
+            used += func.size_cost
+
+    print(f"{'FUNCTION':<32}  {'CALLS':>10}  {'TIME':>6}  {'-Os':>6}  {'-O3':>6}  SELECTION")
+    hot = sorted(functions.values(), key=lambda f: -f.self_time)
+    for func in hot[:REPORT_COUNT] + [f for f in hot[REPORT_COUNT:] if f.marked]:
+        if func.marked:
+            if func.selected:
+                selection = "-O3"
+            else:
+                selection = "-Os (doesn't fit)" if func.self_time > 0 else "-Os (not called)"
+            sizes = f"{func.size_os:>6}  {func.size_o3:>6}"
+        else:
+            selection = "not marked"
+            sizes = f"{'-':>6}  {'-':>6}"
+        print(f"{func.name:<32}  {func.calls:>10}  {func.self_time * 100 / total_time:>5.1f}%  "
+              f"{sizes}  {selection}")
+    print(f"\n{used} of {budget} bytes available used by -O3 functions "
+          f"({args.reserve} bytes kept free).")
+
+    write_header(target / "include/optimize.h", marked)
+
+
+parser = argparse.ArgumentParser(description="Select the functions built with -O3 from a "
+                                             "simulator function profile")
+parser.add_argument(
+    "target", action="store", type=str,
+    help="App directory, with the sim, avr-optimize-none and avr-optimize-all builds")
+parser.add_argument(
+    "-p", "--profile", action="store", type=str, dest="profile_file", default=None,
+    help="Function profile saved by the simulator built with FUNCTION_PROFILE=1 "
+         "(default is function_profile.csv in the app directory)")
+parser.add_argument(
+    "-r", "--reserve", action="store", type=int, default=256,
+    help="Program memory left free, for estimation errors since function sizes "
+         "depend on inlining (default is 256 bytes)")
+parser.add_argument(
+    "--nm", action="store", type=str, default="avr-nm",
+    help="nm executable of the AVR toolchain (default is avr-nm)")
+
+if __name__ == '__main__':
+    try:
+        main()
+    except OptimizeError as ex:
+        print(f"ERROR: {ex}", file=sys.stderr)
+        exit(1)
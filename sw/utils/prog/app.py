@@ -14,7 +14,9 @@
 
 from dataclasses import dataclass, field
 from datetime import date
-from typing import List, Optional
+from typing import List, Optional, Set, Tuple
+
+from bitarray import bitarray
 
 from prog.comm import ProgError
 from prog.eeprom import EEPROM_SIZE
@@ -24,8 +26,11 @@ from utils import *
 
 APP_INDEX_SIZE = 32
 
+FLASH_INDEX_MASK_START = 2
 FLASH_INDEX_START = 32
 FLASH_DATA_START = 2080
+# the last 8 kB of flash are the frame cache written by apps at runtime, see sys/flash.h.
+FLASH_DATA_END = FLASH_SIZE - 8192
 FLASH_ENTRY_SIZE = 64
 
 EEPROM_INDEX_START = 8
@@ -35,8 +40,19 @@ EEPROM_ENTRY_SIZE = 5
 APP_ID_NONE = 0
 APP_ID_SYSTEM = 0xff
 
+# first system app version which must be notified of flash index changes, see `changed_slots`.
+INDEX_CHANGED_VERSION = 13
+# index changed notification telling the system app to reload the whole flash index.
+INDEX_CHANGED_ALL = 0xff
+
 CODE_PAGE_SIZE = 256
 
+# log2 of the alignment of app code and data in flash, in bytes (one flash page).
+FLASH_ALIGN_BITS = 8
+
+# apps with a flash data space are aligned on sectors, so that the space after the image is too.
+FLASH_SECTOR_SIZE = 4096
+
 
 @dataclass
 class DataLocation:
@@ -53,6 +69,8 @@ class App:
     boot_version: int
     code_size: int
     page_height: int
+    target_fps: int
+    min_fps: int
     flash_location: DataLocation
     eeprom_location: DataLocation
     build_date: date
@@ -60,6 +78,10 @@ class App:
     author: str
 
     index: int = field(default=-1)
+    # log2 of the alignment of the image start and of the data start, 0 if not aligned.
+    align_bits: int = field(default=0)
+    # size of the flash data space written by the app at runtime, included in the flash size.
+    space_size: int = field(default=0)
 
     GC_SIGNATURE = b"gc"
 
@@ -75,7 +97,11 @@ class App:
         writer.write(self.eeprom_location.address, 2)
         writer.write(self.eeprom_location.size, 2)
         writer.write(self.flash_location.address, 3)
-        writer.data += bytearray(8)
+        writer.write(self.target_fps, 1)
+        writer.write(self.min_fps, 1)
+        writer.write(self.align_bits, 1)
+        writer.write(self.space_address, 3)
+        writer.write(self.space_size // FLASH_SECTOR_SIZE, 2)
         writer.write(self.flash_location.size, 3)
         writer.write((self.build_date.year - 2020) << 9 |
                      self.build_date.month << 5 | self.build_date.day, 2)
@@ -98,7 +124,11 @@ class App:
         eeprom_start = reader.read(2)
         eeprom_size = reader.read(2)
         flash_start = reader.read(3)
-        reader.pos += 8
+        target_fps = reader.read(1)
+        min_fps = reader.read(1)
+        align_bits = reader.read(1)
+        reader.pos += 3
+        space_size = reader.read(2) * FLASH_SECTOR_SIZE
         total_size = reader.read(3)
         build_date_raw = reader.read(2)
         try:
@@ -110,8 +140,30 @@ class App:
         name = reader.data[32:48].decode("ascii").strip('\x00')
         author = reader.data[48:64].decode("ascii").strip('\x00')
         return App(app_id, crc_image, crc_code, app_version, boot_version, code_size, page_height,
-                   DataLocation(flash_start, total_size), DataLocation(eeprom_start, eeprom_size),
-                   build_date, name, author)
+                   target_fps, min_fps, DataLocation(flash_start, total_size),
+                   DataLocation(eeprom_start, eeprom_size),
+                   build_date, name, author, align_bits=align_bits, space_size=space_size)
+
+    @property
+    def alignment(self) -> int:
+        return 1 << self.align_bits
+
+    @property
+    def data_offset(self) -> int:
+        """Offset of the app data from the start of the image."""
+        return align(self.code_size, self.alignment)
+
+    @property
+    def placement_alignment(self) -> int:
+        """Alignment of the image start in flash."""
+        return FLASH_SECTOR_SIZE if self.space_size else self.alignment
+
+    @property
+    def space_address(self) -> int:
+        """Address of the flash data space, at the end of the app flash location, 0 if none."""
+        if not self.space_size:
+            return 0
+        return self.flash_location.address + self.flash_location.size - self.space_size
 
 
 @dataclass
@@ -143,6 +195,8 @@ class AppManager:
 
     flash_index: List[App]
     eeprom_index: List[AppData]
+    # flash index entries written, for which the system app must be notified.
+    changed_slots: Set[int]
 
     def __init__(self, eeprom: MemoryDriver, flash: MemoryDriver, confirm: bool = False):
         self.eeprom = eeprom
@@ -151,6 +205,7 @@ class AppManager:
         self.boot_version = 0
         self.flash_index = []
         self.eeprom_index = []
+        self.changed_slots = set()
 
     def _check_initialized(self) -> None:
         """Check signatures in flash and EEPROM to make sure they were initialized."""
@@ -183,6 +238,29 @@ class AppManager:
             flash_pos += FLASH_ENTRY_SIZE
             eeprom_pos += EEPROM_ENTRY_SIZE
 
+        for a in self._apps_in_frame_cache():
+            AppManager._warn(f"app ID {a.app_id} overlaps the frame cache at the end of flash, "
+                             f"it will be moved on the next install or with 'defrag'")
+            print()
+
+    def _apps_in_frame_cache(self) -> List[App]:
+        """Apps installed before the frame cache was reserved may overlap it, their data would
+        be erased by apps using the frame cache (see core/framecache.h)."""
+        return [a for a in self.flash_index if a.app_id != APP_ID_NONE and
+                a.flash_location.address + a.flash_location.size > FLASH_DATA_END]
+
+    def _write_index_entry(self, flash_writer: MemoryManager, pos: int, data: bytes) -> None:
+        flash_writer.write(FLASH_INDEX_START + FLASH_ENTRY_SIZE * pos, data)
+        self.changed_slots.add(pos)
+
+    def _write_index_mask(self, flash_writer: MemoryManager) -> None:
+        """Write the mask of used flash index entries, so that the bootloader only reads these."""
+        mask = 0
+        for i, a in enumerate(self.flash_index):
+            if a.app_id != APP_ID_NONE:
+                mask |= 1 << i
+        flash_writer.write(FLASH_INDEX_MASK_START, mask.to_bytes(4, "little"))
+
     @staticmethod
     def _find_app(index: List, app_id: int) -> int:
         """Find an app in the an index."""
@@ -195,14 +273,18 @@ class AppManager:
         print(f"  Build date: {app.build_date.isoformat()}")
         print(f"  Size: {readable_size(app.flash_location.size)} "
               f"({readable_size(app.code_size)} code, "
-              f"{readable_size(app.flash_location.size - app.code_size)} data)")
+              f"{readable_size(app.flash_location.size - app.code_size - app.space_size)} data)")
         print(f"  EEPROM size: {readable_size(app.eeprom_location.size)}")
+        if app.space_size > 0:
+            print(f"  Flash data space size: {readable_size(app.space_size)}")
         print(f"  Target bootloader: v{app.boot_version}")
         if show_details:
             print(f"  Index position: {app.index}")
             print(f"  Flash address: 0x{app.flash_location.address:06x}")
             if app.eeprom_location.size > 0:
                 print(f"  EEPROM address: 0x{app.eeprom_location.address:04x}")
+            if app.space_size > 0:
+                print(f"  Flash data space address: 0x{app.space_address:06x}")
             print(f"  App CRC: 0x{app.crc_app:04x}")
             print(f"  Code CRC: 0x{app.crc_code:04x}")
             print(f"  Display page height: {app.page_height} px")
@@ -243,6 +325,7 @@ class AppManager:
             flash_writer = MemoryManager(self.flash)
             flash_writer.write(0, data)
             flash_writer.execute()
+            self.changed_slots.add(INDEX_CHANGED_ALL)
         else:
             print("Flash memory already initialized.")
         print()
@@ -261,24 +344,27 @@ class AppManager:
     def _find_write_address(used_space: List[DataLocation],
                             old_location: Optional[DataLocation],
                             new_size: int, device_name: str, device_size: int,
-                            device_start: int) -> Optional[int]:
+                            device_start: int, alignment: int = 1) -> Optional[int]:
         total_left = device_size - device_start - sum(loc.size for loc in used_space)
         if used_space:
             used_space.sort(key=lambda loc: loc.address)
             used_space.append(DataLocation(device_size, 0))
 
             if old_location:
-                next_loc = next(loc for i, loc in enumerate(used_space)
-                                if loc.address > old_location.address)
-                if old_location.address + new_size <= next_loc.address:
+                next_loc = next((loc for loc in used_space
+                                 if loc.address > old_location.address), None)
+                if next_loc and old_location.address % alignment == 0 and \
+                        old_location.address + new_size <= next_loc.address:
                     # app can be written in place at the same location
                     return old_location.address
 
             last_end = device_size
             for loc in used_space:
-                if loc.address - last_end >= new_size:
+                start = align(last_end, alignment)
+                # apps overlapping the end of the device leave no usable space after them.
+                if loc.address - start >= new_size and start + new_size <= device_size:
                     # app can be written in a space in between two apps, or after the last app
-                    return last_end
+                    return start
                 last_end = loc.address + loc.size
 
             if total_left >= new_size:
@@ -287,27 +373,14 @@ class AppManager:
 
         elif total_left >= new_size:
             # first app to be installed, put at device start
-            return device_start
+            return align(device_start, alignment)
 
         raise ProgError(f"not enough space on device {device_name}, "
                         f"{readable_size(total_left)} left but "
                         f"{readable_size(new_size)} needed")
 
-    def install(self, app_file: PathLike, dont_update: bool, downgrade: bool) -> None:
-        """Install or update an app from an app file. If `downgrade` is false, the operation
-        will abort if trying to install an app with an older version. Installing an app copies
-        the app content to flash and initializes its EEPROM space. There may be existing EEPROM
-        space for the app ID, in which case it is reused and extended.
-
-        When writing to flash or EEPROM, the following actions are tried in order:
-          1. New apps are written in the first empty space in which they fit.
-          2. When updating, if the app fits in existing space, the same address is used.
-          3. Otherwise, a continuous empty space large enough if found in memory, if there is one.
-          4. If there are no large enough continuous empty space, all other apps are shifted
-             to free up space at the end of the device.
-          5. If this also fails, then the device is out of memory.
-        """
-        # read app file
+    def _load_app_file(self, app_file: PathLike) -> Tuple[App, bytes]:
+        """Read an app file and check its CRCs. Returns the app and the image to write."""
         try:
             with open(app_file, "rb") as file:
                 app_data = bytearray(file.read())
@@ -320,7 +393,6 @@ class AppManager:
 
         new = App.decode(app_data)
         del app_data[0:FLASH_ENTRY_SIZE]
-        app_id = new.app_id
 
         # check CRCs for good measure...
         app_crc = boot_crc16(app_data)
@@ -335,21 +407,20 @@ class AppManager:
             AppManager._warn(f"targeted bootloader version (v{new.boot_version}) "
                              f"differs from device bootloader version (v{self.boot_version})")
             print()
+        return new, app_data
 
-        # check if app already exists
-        self._read_index()
-        flash_index_pos = self._find_app(self.flash_index, app_id)
-        flash_update = flash_index_pos != -1
-        if flash_update:
+    def _confirm_install(self, new: App, dont_update: bool, downgrade: bool) -> bool:
+        """Show install info for an app and confirm it. Returns false if app must be skipped."""
+        flash_index_pos = self._find_app(self.flash_index, new.app_id)
+        if flash_index_pos != -1:
             old = self.flash_index[flash_index_pos]
             if dont_update:
-                print(f"App with ID {app_id} is already installed, not updating.")
-                return
+                print(f"App with ID {new.app_id} is already installed, not updating.")
+                return False
             if new.app_version < old.app_version and not downgrade:
                 print(f"New app version ({new.app_version}) is "
                       f"older than current ({old.app_version})")
 
-            # show install info and confirm
             print("Updating existing app:")
             print(f"  Version: v{old.app_version} -> v{new.app_version}")
             print(f"  Name: {old.name.title()} -> {new.name.title()}")
@@ -361,127 +432,178 @@ class AppManager:
                   f"-> {readable_size(new.eeprom_location.size)}")
             print(f"  Target bootloader: v{old.boot_version} -> v{new.boot_version}")
             print()
-            if not self._confirm("Update app on device?"):
-                return
-
-        else:
-            old = None
-            print("Installing new app:")
-            AppManager._print_app(new)
-            print()
-            if not self._confirm("Install app on device?"):
-                return
+            return self._confirm("Update app on device?")
 
-        start_time = time.time()
+        print("Installing new app:")
+        AppManager._print_app(new)
+        print()
+        return self._confirm("Install app on device?")
+
+    def _place_eeprom(self, app_id: int, size: int) -> None:
+        """Place the EEPROM space of an app in the EEPROM index, without writing anything.
+        Other apps are packed if there's no continuous empty space large enough."""
+        index_pos = self._find_app(self.eeprom_index, app_id)
+        if size == 0:
+            if index_pos != -1:
+                self.eeprom_index[index_pos] = AppData(APP_ID_NONE, DataLocation(0, 0))
+            return
 
-        # find an address in eeprom to write to
-        eeprom_used_space = [a.location for a in self.eeprom_index
-                             if a.app_id not in [app_id, APP_ID_NONE]]
-        eeprom_new_size = new.eeprom_location.size
-        eeprom_addr = AppManager._find_write_address(eeprom_used_space,
-                                                     old.eeprom_location if old else None,
-                                                     eeprom_new_size, "EEPROM",
-                                                     EEPROM_SIZE, EEPROM_DATA_START)
-        eeprom_index_pos = self._find_app(self.eeprom_index, app_id)
-        eeprom_update = eeprom_index_pos != -1
-        eeprom_new = AppData(app_id, DataLocation(eeprom_addr, eeprom_new_size))
-        if eeprom_new_size == 0:
-            eeprom_new.app_id = APP_ID_NONE
-        if eeprom_update:
-            eeprom_old = self.eeprom_index[eeprom_index_pos]
-        else:
-            eeprom_old = None
-            eeprom_index_pos = self._find_app(self.eeprom_index, APP_ID_NONE)
-            if eeprom_index_pos == -1:
+        old_location = self.eeprom_index[index_pos].location if index_pos != -1 else None
+        used_space = [a.location for a in self.eeprom_index
+                      if a.app_id not in [app_id, APP_ID_NONE]]
+        address = AppManager._find_write_address(used_space, old_location, size, "EEPROM",
+                                                 EEPROM_SIZE, EEPROM_DATA_START)
+        if index_pos == -1:
+            index_pos = self._find_app(self.eeprom_index, APP_ID_NONE)
+            if index_pos == -1:
                 raise ProgError(f"EEPROM index is full (max {APP_INDEX_SIZE} apps)")
-        self.eeprom_index[eeprom_index_pos] = eeprom_new
-
-        # find an address in flash to write to
-        flash_used_space = [a.flash_location for a in self.flash_index
-                            if a.app_id not in [app_id, APP_ID_NONE]]
-        flash_addr = AppManager._find_write_address(flash_used_space,
-                                                    old.flash_location if old else None,
-                                                    new.flash_location.size, "flash",
-                                                    FLASH_SIZE, FLASH_DATA_START)
-        if not flash_update:
-            flash_index_pos = self._find_app(self.flash_index, APP_ID_NONE)
-            if flash_index_pos == -1:
+        if address is None:
+            # pack app data in eeprom
+            address = EEPROM_DATA_START
+            for a in self.eeprom_index:
+                if a.app_id not in [app_id, APP_ID_NONE]:
+                    a.location.address = address
+                    address += a.location.size
+        self.eeprom_index[index_pos] = AppData(app_id, DataLocation(address, size))
+
+    def _place_flash(self, new: App) -> None:
+        """Place an app in the flash index, without writing anything.
+        Other apps are packed if there's no continuous empty space large enough."""
+        index_pos = self._find_app(self.flash_index, new.app_id)
+        old_location = self.flash_index[index_pos].flash_location if index_pos != -1 else None
+        used_space = [a.flash_location for a in self.flash_index
+                      if a.app_id not in [new.app_id, APP_ID_NONE]]
+        address = AppManager._find_write_address(used_space, old_location,
+                                                 new.flash_location.size, "flash",
+                                                 FLASH_DATA_END, FLASH_DATA_START,
+                                                 new.placement_alignment)
+        if any(a.app_id != new.app_id for a in self._apps_in_frame_cache()):
+            # other apps must be moved out of the frame cache.
+            address = None
+        if index_pos == -1:
+            index_pos = self._find_app(self.flash_index, APP_ID_NONE)
+            if index_pos == -1:
                 raise ProgError(f"flash index is full (max {APP_INDEX_SIZE} apps)")
-        new.index = flash_index_pos
-        self.flash_index[flash_index_pos] = new
+        if address is None:
+            # pack apps in flash
+            address = FLASH_DATA_START
+            for a in self.flash_index:
+                if a.app_id not in [new.app_id, APP_ID_NONE]:
+                    address = align(address, a.placement_alignment)
+                    a.flash_location.address = address
+                    address += a.flash_location.size
+            address = align(address, new.placement_alignment)
+        new.index = index_pos
+        new.flash_location.address = address
+        self.flash_index[index_pos] = new
 
-        # write to eeprom (if needed)
-        if eeprom_update:
-            print("Reallocating EEPROM memory...")
-        else:
-            print("Initializing EEPROM memory...")
+    def install(self, app_file: PathLike, dont_update: bool, downgrade: bool) -> None:
+        """Install or update an app from an app file, see `install_all`."""
+        self.install_all([app_file], dont_update, downgrade)
+
+    def install_all(self, app_files: List[PathLike], dont_update: bool, downgrade: bool) -> None:
+        """Install or update apps from app files. If `downgrade` is false, the operation
+        will abort if trying to install an app with an older version. Installing an app copies
+        the app content to flash and initializes its EEPROM space. There may be existing EEPROM
+        space for the app ID, in which case it is reused and extended.
+
+        When placing an app in flash or EEPROM, the following actions are tried in order:
+          1. New apps are placed in the first empty space in which they fit.
+          2. When updating, if the app fits in existing space, the same address is used.
+          3. Otherwise, a continuous empty space large enough if found in memory, if there is one.
+          4. If there are no large enough continuous empty space, all other apps are shifted
+             to free up space at the end of the device.
+          5. If this also fails, then the device is out of memory.
+
+        All apps are placed in the index before anything is done on the device. The data of
+        moved apps is always copied from its location before the install, so that the whole
+        install is done in a single batch per memory: erasing blocks once, writing all apps,
+        then writing the changed index entries.
+        """
+        apps = {}
+        for app_file in app_files:
+            new, app_data = self._load_app_file(app_file)
+            if new.app_id in apps:
+                AppManager._warn(f"app ID {new.app_id} is given more than once, "
+                                 f"installing '{app_file}'")
+                print()
+            apps[new.app_id] = (new, app_data)
+
+        self._read_index()
+        to_install = []
+        for i, (new, app_data) in enumerate(apps.values()):
+            if len(apps) > 1:
+                print(f"APP {i + 1} / {len(apps)}")
+            if self._confirm_install(new, dont_update, downgrade):
+                to_install.append((new, app_data))
+            print()
+        if not to_install:
+            return
+
+        start_time = time.time()
+
+        # place all apps, keeping the locations before install to copy data from.
+        flash_entries = [a.encode() for a in self.flash_index]
+        eeprom_entries = [a.encode() for a in self.eeprom_index]
+        flash_before = {a.app_id: a.flash_location.address for a in self.flash_index
+                        if a.app_id != APP_ID_NONE}
+        eeprom_before = {a.app_id: DataLocation(a.location.address, a.location.size)
+                         for a in self.eeprom_index if a.app_id != APP_ID_NONE}
+        for new, _ in to_install:
+            self._place_eeprom(new.app_id, new.eeprom_location.size)
+            self._place_flash(new)
+        installed = {new.app_id for new, _ in to_install}
+
+        # write to eeprom: new spaces are initialized with zeros, moved data is copied.
         eeprom_writer = MemoryManager(self.eeprom)
-        eeprom_changed = False
-        if eeprom_addr is None:
-            # pack app data in eeprom
-            eeprom_addr = EEPROM_DATA_START
-            for i, a in enumerate(self.eeprom_index):
-                if a.app_id != app_id and a.app_id != APP_ID_NONE:
-                    a.location.address = eeprom_addr
-                    eeprom_writer.copy(a.location.address, eeprom_addr, a.location.size)
-                    eeprom_writer.write(EEPROM_INDEX_START + EEPROM_ENTRY_SIZE * i, a.encode())
-                    eeprom_addr += a.location.size
-
-        if eeprom_update:
-            if eeprom_addr != eeprom_old.location.address:
-                # app data address changed, we must read existing data to copy it elsewhere.
-                eeprom_data = self.eeprom.read(eeprom_old.location.address,
-                                               eeprom_old.location.size,
-                                               print_progress_bar("Reading EEPROM data"))
-                eeprom_writer.write(eeprom_addr, eeprom_data)
-                eeprom_changed = True
-            elif eeprom_old.location.size != eeprom_new_size:
-                eeprom_changed = True
-        elif eeprom_new_size > 0:
-            # initialize eeprom location with zeros
-            eeprom_writer.write(eeprom_addr, bytearray(eeprom_new_size))
-            eeprom_changed = True
-
-        if eeprom_changed:
-            eeprom_writer.write(EEPROM_INDEX_START + EEPROM_ENTRY_SIZE * eeprom_index_pos,
-                                eeprom_new.encode())
+        for a in self.eeprom_index:
+            if a.app_id == APP_ID_NONE:
+                continue
+            old_location = eeprom_before.get(a.app_id)
+            if old_location is None:
+                eeprom_writer.write(a.location.address, bytearray(a.location.size))
+            elif old_location.address != a.location.address:
+                eeprom_writer.copy(old_location.address, a.location.address,
+                                   min(old_location.size, a.location.size))
+        for i, a in enumerate(self.eeprom_index):
+            data = a.encode()
+            if data != eeprom_entries[i]:
+                eeprom_writer.write(EEPROM_INDEX_START + EEPROM_ENTRY_SIZE * i, data)
+        if eeprom_writer.operations:
+            print("Updating EEPROM memory...")
             eeprom_writer.execute()
-        elif eeprom_update:
-            print("EEPROM space didn't change with update, nothing to do.")
         else:
-            print("App doesn't use any EEPROM space, nothing to do.")
+            print("EEPROM space didn't change, nothing to do.")
         print()
 
-        # write to flash
+        # write to flash: installed apps are written, other moved apps are copied. The EEPROM
+        # address in the flash index is updated for all apps, since packing may have changed it.
         print("Updating flash memory...")
         flash_writer = MemoryManager(self.flash)
-        if flash_addr is None:
-            # pack apps in flash
-            flash_addr = FLASH_DATA_START
-            for i, a in enumerate(self.flash_index):
-                if a.app_id != app_id and a.app_id != APP_ID_NONE:
-                    flash_writer.copy(a.flash_location.address, flash_addr, a.flash_location.size)
-                    a.flash_location.address = flash_addr
-                    flash_writer.write(FLASH_INDEX_START + FLASH_ENTRY_SIZE * i, a.encode())
-                    flash_addr += a.flash_location.size
-        flash_writer.write(flash_addr, app_data)
-        new.flash_location.address = flash_addr
-        new.eeprom_location.address = eeprom_addr
-        flash_writer.write(FLASH_INDEX_START + FLASH_ENTRY_SIZE * flash_index_pos, new.encode())
+        for new, app_data in to_install:
+            flash_writer.write(new.flash_location.address, app_data)
+        for a in self.flash_index:
+            if a.app_id == APP_ID_NONE:
+                continue
+            if a.app_id not in installed and a.flash_location.address != flash_before[a.app_id]:
+                flash_writer.copy(flash_before[a.app_id], a.flash_location.address,
+                                  a.flash_location.size)
+            eeprom_pos = self._find_app(self.eeprom_index, a.app_id)
+            if eeprom_pos != -1:
+                a.eeprom_location.address = self.eeprom_index[eeprom_pos].location.address
+        for i, a in enumerate(self.flash_index):
+            data = a.encode()
+            if data != flash_entries[i]:
+                self._write_index_entry(flash_writer, i, data)
+        self._write_index_mask(flash_writer)
         flash_writer.execute()
         print()
 
         end_time = time.time()
-        print(f"DONE, app installed in {end_time - start_time:.1f} s")
-
-    def install_all(self, app_files: List[PathLike], dont_update: bool, downgrade: bool) -> None:
-        """Install all apps from files."""
-        self._read_index()
-        for i, app_file in enumerate(app_files):
-            if len(app_files) > 1:
-                print(f"INSTALLING APP {i + 1} / {len(app_files)}")
-            self.install(app_file, dont_update, downgrade)
-            print()
+        if len(to_install) > 1:
+            print(f"DONE, {len(to_install)} apps installed in {end_time - start_time:.1f} s")
+        else:
+            print(f"DONE, app installed in {end_time - start_time:.1f} s")
 
     def uninstall(self, app_id: int, clear_data: bool) -> None:
         """Uninstall the specified app, optionally clearing EEPROM data as well.
@@ -515,8 +637,9 @@ class AppManager:
         if flash_pos != -1:
             print("Updating flash index...")
             flash_writer = MemoryManager(self.flash)
-            flash_writer.write(FLASH_INDEX_START + FLASH_ENTRY_SIZE * flash_pos,
-                               bytearray(FLASH_ENTRY_SIZE))
+            self._write_index_entry(flash_writer, flash_pos, bytearray(FLASH_ENTRY_SIZE))
+            self.flash_index[flash_pos].app_id = APP_ID_NONE
+            self._write_index_mask(flash_writer)
             flash_writer.execute()
             print()
 
@@ -601,6 +724,121 @@ class AppManager:
         else:
             print("App not found on device, nothing to do.")
 
+    def defrag(self) -> None:
+        """Move apps in flash so that they are packed right after the index, leaving all free
+        space at the end of the device. If the device supports it, data is copied on the device
+        without going through the host, otherwise it is read and written back. In both cases,
+        the index is only updated once all apps have been moved."""
+        self._read_index()
+        apps = sorted((a for a in self.flash_index if a.app_id != APP_ID_NONE),
+                      key=lambda a: a.flash_location.address)
+        new_addresses = []
+        addr = FLASH_DATA_START
+        for a in apps:
+            addr = align(addr, a.placement_alignment)
+            new_addresses.append(addr)
+            addr += a.flash_location.size
+        if addr > FLASH_DATA_END:
+            raise ProgError(f"apps take {readable_size(addr - FLASH_DATA_START)}, more than the "
+                            f"{readable_size(FLASH_DATA_END - FLASH_DATA_START)} available "
+                            f"before the frame cache, uninstall an app first")
+        moved = [a for a, new_addr in zip(apps, new_addresses)
+                 if a.flash_location.address != new_addr]
+        if not moved:
+            print("Flash memory is not fragmented, nothing to do.")
+            return
+
+        print(f"{len(moved)} app(s) will be moved, leaving {readable_size(FLASH_DATA_END - addr)} "
+              f"of continuous free space.")
+        if not self._confirm("Defragment flash memory?"):
+            return
+
+        start_time = time.time()
+        moves = [(a.flash_location.address, new_addr, a.flash_location.size)
+                 for a, new_addr in zip(apps, new_addresses)]
+        flash_writer = MemoryManager(self.flash)
+        if not self._defrag_on_device(moves, addr):
+            # data goes through host, all reads are done before writing so overlap is not an issue.
+            for old_addr, new_addr, size in moves:
+                if old_addr != new_addr:
+                    flash_writer.copy(old_addr, new_addr, size)
+
+        print("Updating flash index...")
+        for a, new_addr in zip(apps, new_addresses):
+            if a.flash_location.address != new_addr:
+                a.flash_location.address = new_addr
+                self._write_index_entry(flash_writer, a.index, a.encode())
+        flash_writer.execute()
+        print()
+
+        end_time = time.time()
+        print(f"DONE, flash defragmented in {end_time - start_time:.1f} s")
+
+    def _defrag_on_device(self, moves: List[Tuple[int, int, int]], data_end: int) -> bool:
+        """Move app data on the device, block by block in ascending order. Each move is
+        a (from, to, size) tuple, with destination never after the source. Data that must be
+        moved within the same block is first copied to a scratch block, which must be free
+        before and after defragmentation. Returns false if moving on device isn't possible."""
+        if not self.flash.has_copy() or not self.flash.has_crc():
+            return False
+        block_size = self.flash.get_smallest_erase_size()
+        block_count = self.flash.get_block_count()
+        end_block = (data_end + block_size - 1) // block_size
+
+        # the index region before the data is kept in place.
+        moves = [(0, 0, FLASH_DATA_START)] + moves
+        used_blocks = bitarray(block_count)
+        used_blocks.setall(False)
+        for old_addr, _, size in moves:
+            used_blocks[old_addr // block_size:(old_addr + size - 1) // block_size + 1] = True
+        scratch = next((b for b in range(end_block, block_count) if not used_blocks[b]), None)
+        if scratch is None:
+            return False
+        scratch_addr = scratch * block_size
+
+        def erase_block(block: int) -> None:
+            mask = bitarray(block_count)
+            mask.setall(False)
+            mask[block] = True
+            self.flash.erase_blocks(mask, no_progress)
+
+        def copy_verified(from_addr: int, to_addr: int, size: int) -> None:
+            self.flash.copy(from_addr, to_addr, size)
+            if self.flash.crc(from_addr, size) != self.flash.crc(to_addr, size):
+                raise ProgError("copy verification failed, check serial connection and try again")
+
+        progress = print_progress_bar("Moving")
+        for block in range(end_block):
+            start = block * block_size
+            end = start + block_size
+            # find all parts to copy into this block, split so that sources don't cross blocks.
+            parts = []
+            for old_addr, new_addr, size in moves:
+                lo = max(start, new_addr)
+                hi = min(end, new_addr + size)
+                while lo < hi:
+                    src = old_addr + lo - new_addr
+                    part_size = min(hi - lo, block_size - src % block_size)
+                    parts.append((src, lo, part_size))
+                    lo += part_size
+            if all(src == dst for src, dst, _ in parts):
+                progress(end, end_block * block_size)
+                continue
+
+            if any(start <= src < end for src, _, _ in parts):
+                # some data will be erased with the block, copy the block to scratch first.
+                erase_block(scratch)
+                copy_verified(start, scratch_addr, block_size)
+                parts = [(src - start + scratch_addr if start <= src < end else src, dst, size)
+                         for src, dst, size in parts]
+
+            erase_block(block)
+            for src, dst, size in parts:
+                copy_verified(src, dst, size)
+            progress(end, end_block * block_size)
+        print()
+        return True
+
     def list_all(self, show_details: bool = False) -> None:
         """List and describe all the installed app on the device."""
         self._read_index()
@@ -627,8 +865,8 @@ class AppManager:
 
         total_flash = sum(a.flash_location.size for a in self.flash_index) + FLASH_DATA_START
         print(progress_bar("Flash usage ",
-                           f"{readable_size(total_flash)} / {readable_size(FLASH_SIZE)}",
-                           total_flash / FLASH_SIZE))
+                           f"{readable_size(total_flash)} / {readable_size(FLASH_DATA_END)}",
+                           total_flash / FLASH_DATA_END))
 
         total_eeprom = sum(a.location.size for a in self.eeprom_index) + EEPROM_DATA_START
         print(progress_bar("EEPROM usage",
@@ -0,0 +1,105 @@
+#  Copyright 2022 Nicolas Maltais
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+import subprocess
+import sys
+import time
+from concurrent.futures import ThreadPoolExecutor
+from dataclasses import dataclass
+from pathlib import Path
+from typing import List, Optional
+
+from prog.comm import ProgError
+from utils import PathLike
+
+
+@dataclass
+class BatchResult:
+    port: str
+    success: bool
+    duration: float
+    # last line of error output if the operation failed.
+    error: Optional[str]
+
+
+def read_manifest(filename: PathLike) -> List[Path]:
+    """Read an install manifest, which lists app image files, one per line. Paths are
+    relative to the manifest location. Empty lines and lines starting with '#' are ignored."""
+    manifest = Path(filename)
+    try:
+        with open(manifest, "r") as file:
+            lines = file.readlines()
+    except IOError as e:
+        raise ProgError(f"could not read manifest file '{filename}': {e}")
+    apps = []
+    for line in lines:
+        line = line.strip()
+        if line and not line.startswith("#"):
+            apps.append(manifest.parent / line)
+    if not apps:
+        raise ProgError(f"manifest file '{filename}' doesn't list any app")
+    return apps
+
+
+def _program_device(port: str, commands: List[List[str]], log_dir: Optional[Path]) -> BatchResult:
+    # each device is programmed by a separate gcprog process, so that devices are fully
+    # independent and output can be captured per device.
+    gcprog = Path(__file__).absolute().parent.parent / "gcprog.py"
+    start_time = time.time()
+    output = ""
+    error = None
+    for args in commands:
+        result = subprocess.run([sys.executable, str(gcprog), "-d", port] + args,
+                                stdin=subprocess.DEVNULL, capture_output=True, text=True)
+        output += result.stdout + result.stderr
+        if result.returncode != 0:
+            lines = result.stderr.strip().splitlines()
+            error = lines[-1] if lines else f"exited with code {result.returncode}"
+            break
+    if log_dir:
+        log_name = port.strip("/").replace("/", "_") + ".log"
+        with open(log_dir / log_name, "w") as file:
+            file.write(output)
+    return BatchResult(port, error is None, time.time() - start_time, error)
+
+
+def program_all(ports: List[str], manifest: PathLike, global_options: List[str],
+                install_options: List[str], log_dir: Optional[PathLike]) -> bool:
+    """Initialize all devices on `ports` and install the apps listed in `manifest` on them,
+    with one worker per port. `global_options` are extra gcprog options passed to all commands
+    and `install_options` are extra options passed to the install command.
+    Returns true if all devices were programmed successfully."""
+    apps = [str(a) for a in read_manifest(manifest)]
+    if log_dir:
+        log_dir = Path(log_dir)
+        log_dir.mkdir(parents=True, exist_ok=True)
+    commands = [global_options + ["init"],
+                global_options + ["install", "--no-confirm"] + install_options + apps]
+
+    print(f"Programming {len(apps)} app(s) on {len(ports)} device(s)...")
+    with ThreadPoolExecutor(max_workers=len(ports)) as executor:
+        futures = [executor.submit(_program_device, port, commands, log_dir) for port in ports]
+        results = []
+        for future in futures:
+            result = future.result()
+            results.append(result)
+            status = "OK" if result.success else f"FAILED, {result.error}"
+            print(f"  {result.port}: {status} ({result.duration:.1f} s)")
+
+    failed = sum(1 for r in results if not r.success)
+    print()
+    if failed:
+        print(f"DONE, {failed} of {len(results)} device(s) failed.")
+    else:
+        print(f"DONE, all {len(results)} device(s) programmed.")
+    return failed == 0
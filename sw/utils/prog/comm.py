@@ -14,9 +14,10 @@
 
 import abc
 import socket
+from collections import deque
 from dataclasses import dataclass
 from enum import Enum
-from typing import Optional, Sequence, Union
+from typing import Optional, Sequence, Union, List, Deque, Tuple
 
 import serial
 from serial import Serial
@@ -32,9 +33,20 @@ class PacketType(Enum):
     SPI = 0x01
     LOCK = 0x02
     SLEEP = 0x03
+    FLASH_READ = 0x04
+    FLASH_WRITE = 0x05
+    FLASH_ERASE = 0x06
+    FLASH_STREAM = 0x07
+    CRC_RANGE = 0x08
+    FLASH_WRITE_LZSS = 0x09
+    BAUD = 0x0a
+    FLASH_COPY = 0x0b
+    INDEX_CHANGED = 0x0c
     BATTERY_INFO = 0x10
     BATTERY_CALIB = 0x11
     BATTERY_LOAD = 0x12
+    PERF_STATS = 0x20
+    EVENT_TRACE = 0x21
 
 
 @dataclass
@@ -105,10 +117,20 @@ class CommInterface(abc.ABC):
         """Write a packet to the communication interface."""
         raise NotImplementedError
 
-    def read(self) -> Packet:
-        """Read a packet from the communication interface (optionally a specific packet type)."""
+    def read(self, more: bool = False) -> Packet:
+        """Read a packet from the communication interface (optionally a specific packet type).
+        If `more` is true, more response packets are expected for the last packet written."""
         raise NotImplementedError
 
+    def transact(self, packets: List[Packet]) -> List[Packet]:
+        """Write packets and read their responses, returned in the same order.
+        By default, each response is read before the next packet is written."""
+        responses = []
+        for packet in packets:
+            self.write(packet)
+            responses.append(self.read())
+        return responses
+
 
 class Comm(CommInterface):
     """Class used for communication with firmware. Uses pyserial to send and receive packets."""
@@ -117,9 +139,15 @@ class Comm(CommInterface):
     simulator: bool
     serial: Optional[Union[Serial, SimulatorSerial]]
 
-    # Used to enforce the "read after write" and "write before read" recommandations
-    # of the system UART communication interface to avoid losing packets.
-    _written: Optional[int]
+    # Size of the device RX buffer. Packets can be written before the response to previous
+    # packets is read, as long as the total size of packets in flight doesn't exceed this.
+    # If unknown (None), only one packet can be in flight at a time.
+    rx_buffer_size: Optional[int]
+
+    # Type and size of packets written for which no response was read yet, in order. Used to
+    # enforce the "write before read" rule and the RX buffer limit of the system UART
+    # communication interface to avoid losing packets.
+    _in_flight: Deque[Tuple[int, int]]
 
     DEFAULT_FILENAME = "/dev/ttyACM1"
     DEFAULT_BAUD_RATE = 250_000
@@ -131,7 +159,8 @@ class Comm(CommInterface):
         self.baud_rate = baud_rate
         self.serial = None
         self.simulator = simulator
-        self._written = None
+        self.rx_buffer_size = None
+        self._in_flight = deque()
 
     def connect(self) -> None:
         try:
@@ -153,6 +182,14 @@ class Comm(CommInterface):
         except IOError as e:
             raise ProgError("could not connect to device") from e
 
+    def set_baud_rate(self, baud_rate: int) -> None:
+        """Change the baud rate used to communicate, discarding any pending received data."""
+        self.baud_rate = baud_rate
+        self._in_flight.clear()
+        if isinstance(self.serial, Serial):
+            self.serial.baudrate = baud_rate
+            self.serial.read_all()
+
     def disconnect(self) -> None:
         if self.is_connected():
             self.serial.close()
@@ -160,14 +197,22 @@ class Comm(CommInterface):
     def is_connected(self) -> bool:
         return self.serial is not None
 
-    def write(self, packet: Packet) -> None:
-        if self._written is not None:
-            raise RuntimeError("no read after write")
-        self.serial.write(packet.encode())
-        self._written = packet.packet_type
+    def _can_write(self, size: int) -> bool:
+        if not self._in_flight:
+            return True
+        if self.rx_buffer_size is None:
+            return False
+        return sum(s for _, s in self._in_flight) + size <= self.rx_buffer_size
 
-    def read(self) -> Packet:
-        if self._written is None:
+    def write(self, packet: Packet) -> None:
+        data = packet.encode()
+        if not self._can_write(len(data)):
+            raise RuntimeError("no read after write, device RX buffer is full")
+        self.serial.write(data)
+        self._in_flight.append((packet.packet_type, len(data)))
+
+    def read(self, more: bool = False) -> Packet:
+        if not self._in_flight:
             raise RuntimeError("read without write")
 
         while True:
@@ -189,7 +234,21 @@ class Comm(CommInterface):
             packet = Packet.decode(signature + header + payload)
             break
 
-        if packet.packet_type != self._written:
+        if packet.packet_type != self._in_flight[0][0]:
             raise ProgError("unexpected packet type")
-        self._written = None
+        if not more:
+            self._in_flight.popleft()
         return packet
+
+    def transact(self, packets: List[Packet]) -> List[Packet]:
+        # keep as many packets in flight as the device RX buffer allows. The device handles
+        # packets in order, so responses are matched with requests by their order.
+        responses = []
+        pos = 0
+        while len(responses) < len(packets):
+            while pos < len(packets) and \
+                    self._can_write(len(packets[pos].payload) + Packet.PACKET_HEADER_SIZE):
+                self.write(packets[pos])
+                pos += 1
+            responses.append(self.read())
+        return responses
@@ -17,7 +17,7 @@
 # Datasheet: https://www.fremontmicro.com/downfile.aspx?filepath=/upload/2019/0805/1604ntvhj2.pdf&filename=ft25c32a_ds_rev0.82.pdf
 
 from pathlib import Path
-from typing import Union
+from typing import Union, List, Tuple
 
 from prog.memory import MemoryDriver, MemoryLocal
 from prog.spi import SpiInterface, SpiPeripheral
@@ -41,10 +41,13 @@ INSTR_WRITE = 0x2
 class EepromDriver(MemoryDriver):
     """Class used to read & write to the EEPROM chip."""
     spi: SpiInterface
+    # If true, written data is verified with a CRC computed by the firmware.
+    device_crc: bool
 
     def __init__(self, spi: SpiInterface):
         spi.peripheral = SpiPeripheral.EEPROM
         self.spi = spi
+        self.device_crc = False
 
     def get_size(self) -> int:
         return EEPROM_SIZE
@@ -52,6 +55,20 @@ class EepromDriver(MemoryDriver):
     def requires_block_erase(self) -> bool:
         return False
 
+    def has_crc(self) -> bool:
+        return self.device_crc
+
+    def crc(self, address: int, count: int) -> int:
+        return self.spi.crc(address, count)
+
+    def crcs(self, ranges: List[Tuple[int, int]]) -> List[int]:
+        return self.spi.crc_all(ranges)
+
+    def verify(self, address: int, data: bytes, progress: ProgressCallback) -> bool:
+        if self.device_crc:
+            return self.spi.verify_crc(address, data, progress)
+        return super().verify(address, data, progress)
+
     def read(self, address: int, count: int, progress: ProgressCallback) -> bytes:
         self._wait_ready()
         command = [INSTR_READ, address >> 8, address & 0xff]
@@ -68,8 +85,7 @@ class EepromDriver(MemoryDriver):
         it = iter(data)
         while written < len(data):
             self._wait_ready()
-            self.spi.transceive([INSTR_WREN])
-            # write data for one page
+            # write data for one page, right after enabling the write latch
             command = [INSTR_WRITE, address >> 8, address & 0xff]
             page_end = (address & ~(PAGE_SIZE - 1)) + PAGE_SIZE
             while written < len(data) and address < page_end:
@@ -79,7 +95,7 @@ class EepromDriver(MemoryDriver):
                 command.append(byte)
                 written += 1
                 address += 1
-            self.spi.transceive(command)
+            self.spi.transceive_all([[INSTR_WREN], command])
             progress(written, len(data))
 
     def erase(self, progress: ProgressCallback) -> None:
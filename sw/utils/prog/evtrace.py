@@ -0,0 +1,109 @@
+#  Copyright 2022 Nicolas Maltais
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+import time
+from dataclasses import dataclass
+from typing import List, Optional, Tuple
+
+from prog.comm import CommInterface, PacketType, Packet, ProgError
+from utils import DataReader, PathLike
+
+# system tick frequency, see core/time.h
+SYSTICK_FREQUENCY = 256
+
+# event names, see evtrace_event_t in core/evtrace.h
+EVENT_NAMES = {
+    0x01: "frame_start",
+    0x02: "frame_end",
+    0x03: "sound_underrun",
+    0x04: "eeprom_wait",
+}
+# first event number available to apps.
+EVENT_APP = 0x80
+
+# first system app version supporting the event trace packet.
+EVENT_TRACE_VERSION = 14
+
+EVENT_SIZE = 4
+
+
+@dataclass
+class Event:
+    time: float  # seconds, host time
+    event: int
+    arg: int
+
+    @property
+    def name(self) -> str:
+        if self.event >= EVENT_APP:
+            return f"app_{self.event - EVENT_APP}"
+        return EVENT_NAMES.get(self.event, f"unknown_{self.event:#04x}")
+
+
+class EventTraceManager:
+    comm: CommInterface
+
+    def __init__(self, comm: CommInterface):
+        self.comm = comm
+
+    def _get_events(self) -> Tuple[List[Event], int]:
+        """Read events recorded since last read, returns the events and the number of events
+        lost. Event times are converted to host time from their age relative to the device time,
+        which is correct as long as events are read at least every 256 seconds."""
+        self.comm.write(Packet(PacketType.EVENT_TRACE))
+        read_time = time.time()
+        payload = self.comm.read().payload
+        if not payload:
+            raise ProgError("system app wasn't built with EVENT_TRACE")
+        if len(payload) < 3 or (len(payload) - 3) % EVENT_SIZE != 0:
+            raise ProgError("invalid event trace packet")
+        reader = DataReader(payload)
+        device_time = reader.read(2)
+        lost = reader.read(1)
+        events = []
+        for _ in range((len(payload) - 3) // EVENT_SIZE):
+            event = reader.read(1)
+            arg = reader.read(1)
+            age = (device_time - reader.read(2)) & 0xffff
+            events.append(Event(read_time - age / SYSTICK_FREQUENCY, event, arg))
+        return events, lost
+
+    def log(self, interval: float, duration: float, output_file: Optional[PathLike]) -> None:
+        """Read the event trace every `interval` seconds for `duration` seconds or indefinitely
+        if zero, and print events as a timeline. Events are optionally saved to a CSV file."""
+        file = None
+        if output_file:
+            file = open(output_file, "w")
+            file.write("time,event,arg\n")
+
+        # first request only clears the events recorded before starting.
+        self._get_events()
+        start_time = time.time()
+        last_time = 0.0
+        try:
+            while duration == 0 or time.time() - start_time < duration:
+                time.sleep(interval)
+                events, lost = self._get_events()
+                if lost:
+                    print(f"{lost} events lost, read more often or increase the buffer size")
+                for e in events:
+                    t = e.time - start_time
+                    print(f"[{t:9.3f} s] +{(t - last_time) * 1000:7.1f} ms  {e.name} {e.arg}")
+                    last_time = t
+                    if file:
+                        file.write(f"{t:.4f},{e.name},{e.arg}\n")
+                if file:
+                    file.flush()
+        finally:
+            if file:
+                file.close()
@@ -21,9 +21,10 @@
 import time
 from dataclasses import dataclass
 from pathlib import Path
-from typing import Union
+from typing import Union, List, Tuple
 
-from prog.comm import ProgError
+import prog.lzss as lzss
+from prog.comm import ProgError, Packet, PacketType
 from prog.memory import MemoryDriver, MemoryLocal
 from prog.spi import SpiInterface, SpiPeripheral
 from utils import ProgressCallback, process_bitarray_sequences
@@ -62,14 +63,43 @@ INSTR_RESET_ENABLE = 0x66
 INSTR_RESET = 0x99
 INSTR_MANUF_ID = 0x9f
 
+# maximum number of bytes read and written per flash packet.
+DEVICE_READ_MAX_SIZE = Packet.PAYLOAD_MAX_SIZE
+DEVICE_WRITE_MAX_SIZE = PAGE_SIZE // 2
+
+# first system app version supporting the flash packets.
+DEVICE_COMMANDS_VERSION = 4
+# first system app version supporting the flash stream packet.
+DEVICE_STREAM_VERSION = 5
+# first system app version supporting the compressed flash write packet.
+DEVICE_LZSS_VERSION = 7
+# first system app version supporting the flash copy packet.
+DEVICE_COPY_VERSION = 9
+
 
 class FlashDriver(MemoryDriver):
     """Class used to read & write to the flash chip."""
     spi: SpiInterface
+    # If true, reads, writes and erases are done with the flash packets handled by the firmware,
+    # which saves the round trips for write enable and busy polling. Otherwise raw SPI is used.
+    device_commands: bool
+    # If true, reads larger than a packet are streamed by the firmware with no request per packet.
+    device_stream: bool
+    # If true, written data is verified with a CRC computed by the firmware.
+    device_crc: bool
+    # If true, written pages are LZSS compressed and decompressed by the firmware.
+    device_lzss: bool
+    # If true, data can be copied from flash to flash by the firmware.
+    device_copy: bool
 
     def __init__(self, spi: SpiInterface):
         spi.peripheral = SpiPeripheral.FLASH
         self.spi = spi
+        self.device_commands = False
+        self.device_stream = False
+        self.device_crc = False
+        self.device_lzss = False
+        self.device_copy = False
 
     def reset(self) -> None:
         """Reset device and verify manufacturer ID."""
@@ -87,6 +117,29 @@ class FlashDriver(MemoryDriver):
     def requires_block_erase(self) -> bool:
         return True
 
+    def has_crc(self) -> bool:
+        return self.device_crc
+
+    def crc(self, address: int, count: int) -> int:
+        return self.spi.crc(address, count)
+
+    def crcs(self, ranges: List[Tuple[int, int]]) -> List[int]:
+        return self.spi.crc_all(ranges)
+
+    def has_copy(self) -> bool:
+        return self.device_copy
+
+    def copy(self, from_addr: int, to_addr: int, count: int) -> None:
+        payload = from_addr.to_bytes(ADDRESS_BYTES, "big", signed=False)
+        payload += to_addr.to_bytes(ADDRESS_BYTES, "big", signed=False)
+        payload += count.to_bytes(2, "big", signed=False)
+        self._device_command(PacketType.FLASH_COPY, payload)
+
+    def verify(self, address: int, data: bytes, progress: ProgressCallback) -> bool:
+        if self.device_crc:
+            return self.spi.verify_crc(address, data, progress)
+        return super().verify(address, data, progress)
+
     def get_smallest_erase_size(self) -> int:
         return SMALLEST_BLOCK_SIZE
 
@@ -94,6 +147,10 @@ class FlashDriver(MemoryDriver):
         return FLASH_SIZE // SMALLEST_BLOCK_SIZE
 
     def read(self, address: int, count: int, progress: ProgressCallback) -> bytes:
+        if self.device_stream and count > DEVICE_READ_MAX_SIZE:
+            return self._device_stream(address, count, progress)
+        if self.device_commands:
+            return self._device_read(address, count, progress)
         self._wait_ready()
         command = bytearray([INSTR_READ])
         command += address.to_bytes(3, "big", signed=False)
@@ -108,6 +165,9 @@ class FlashDriver(MemoryDriver):
         All bytes written must be in erased state (0xff) beforehand."""
         if address % PAGE_SIZE != 0 or len(data) % PAGE_SIZE != 0:
             raise ValueError("Write address and data size must be page aligned!")
+        if self.device_commands:
+            self._device_write(address, data, progress)
+            return
         pos = 0
         self._wait_ready()
         while pos < len(data):
@@ -135,13 +195,16 @@ class FlashDriver(MemoryDriver):
                 for block_size in reversed(INSTR_ERASE):
                     if start % block_size == 0 and end - start >= block_size:
                         # this is the largest block erase possible from current position
-                        self._write_enable()
                         instr = INSTR_ERASE[block_size]
                         command = bytearray([instr.opcode])
                         if block_size != FLASH_SIZE:
                             # erase instructions require an address, except chip erase
                             command += start.to_bytes(ADDRESS_BYTES, "big", signed=False)
-                        self.spi.transceive(command)
+                        if self.device_commands:
+                            self._device_command(PacketType.FLASH_ERASE, command)
+                        else:
+                            self._write_enable()
+                            self.spi.transceive(command)
                         # estimate progress using typical datasheet erase time
                         # blocks at last byte if not done after that time.
                         start_time = time.time()
@@ -165,6 +228,64 @@ class FlashDriver(MemoryDriver):
         all_blocks.setall(True)
         self.erase_blocks(all_blocks, progress)
 
+    def _device_command(self, packet_type: PacketType, payload: bytes) -> bytes:
+        comm = self.spi.comm
+        comm.write(Packet(packet_type, payload))
+        return comm.read().payload
+
+    def _device_read(self, address: int, count: int, progress: ProgressCallback) -> bytes:
+        received = bytearray()
+        while len(received) < count:
+            length = min(count - len(received), DEVICE_READ_MAX_SIZE)
+            payload = address.to_bytes(ADDRESS_BYTES, "big", signed=False) + bytes([length])
+            data = self._device_command(PacketType.FLASH_READ, payload)
+            if len(data) != length:
+                raise ProgError("short flash read packet")
+            received += data
+            address += length
+            progress(len(received), count)
+        return received
+
+    def _device_stream(self, address: int, count: int, progress: ProgressCallback) -> bytes:
+        comm = self.spi.comm
+        payload = address.to_bytes(ADDRESS_BYTES, "big", signed=False)
+        payload += count.to_bytes(3, "big", signed=False)
+        comm.write(Packet(PacketType.FLASH_STREAM, payload))
+        received = bytearray()
+        while len(received) < count:
+            length = min(count - len(received), DEVICE_READ_MAX_SIZE)
+            data = comm.read(more=len(received) + length < count).payload
+            if len(data) != length:
+                raise ProgError("short flash stream packet")
+            received += data
+            progress(len(received), count)
+        return received
+
+    def _device_write(self, address: int, data: bytes, progress: ProgressCallback) -> None:
+        # the write size divides the page size so that no write crosses a page boundary.
+        # packets for a whole block are sent at once, without waiting for each response.
+        pos = 0
+        while pos < len(data):
+            packets = []
+            batch_end = min(len(data), pos + SMALLEST_BLOCK_SIZE)
+            while pos < batch_end:
+                payload = address.to_bytes(ADDRESS_BYTES, "big", signed=False)
+                if self.device_lzss:
+                    # compress one page at once, unless compression doesn't reduce the size.
+                    page_end = min(len(data), pos + PAGE_SIZE - address % PAGE_SIZE)
+                    compressed = payload + lzss.encode(data[pos:page_end])
+                    if len(compressed) <= min(Packet.PAYLOAD_MAX_SIZE, page_end - pos):
+                        packets.append(Packet(PacketType.FLASH_WRITE_LZSS, compressed))
+                        address += page_end - pos
+                        pos = page_end
+                        continue
+                payload += data[pos:pos + DEVICE_WRITE_MAX_SIZE]
+                packets.append(Packet(PacketType.FLASH_WRITE, payload))
+                pos += DEVICE_WRITE_MAX_SIZE
+                address += DEVICE_WRITE_MAX_SIZE
+            self.spi.comm.transact(packets)
+            progress(min(pos, len(data)), len(data))
+
     def _write_enable(self) -> None:
         self.spi.transceive([INSTR_WRITE_EN])
 
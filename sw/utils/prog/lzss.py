@@ -0,0 +1,81 @@
+#  Copyright 2022 Nicolas Maltais
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+
+# LZSS encoder used to compress flash writes, decompressed by the system app.
+# The format is the same as the one in app/tworld/utils/lzss.py, with a 256 bytes window.
+# Matches are searched with bytes.rfind instead of comparing the window byte by byte,
+# since data must be compressed faster than it can be transmitted.
+
+DISTANCE_BITS1 = 5
+DISTANCE_BITS2 = 8
+
+LENGTH_BITS1 = 7 - DISTANCE_BITS1
+LENGTH_BITS2 = 15 - DISTANCE_BITS2
+
+WINDOW_SIZE = 2 ** DISTANCE_BITS2
+
+BREAKEVEN1 = 2
+BREAKEVEN2 = 3
+
+MAX_DISTANCE1 = 2 ** DISTANCE_BITS1
+MAX_LENGTH1 = 2 ** LENGTH_BITS1 - 1 + BREAKEVEN1
+
+MAX_DISTANCE2 = 2 ** DISTANCE_BITS2
+MAX_LENGTH2 = 2 ** LENGTH_BITS2 - 1 + BREAKEVEN2
+
+
+def encode(data: bytes) -> bytes:
+    out = bytearray()
+    type_bits = 8
+    type_pos = 0
+
+    def append_token_type(typ: int) -> None:
+        nonlocal type_bits, type_pos
+        if type_bits == 8:
+            type_bits = 0
+            type_pos = len(out)
+            out.append(0)
+        out[type_pos] |= typ << type_bits
+        type_bits += 1
+
+    i = 0
+    while i < len(data):
+        # find the longest match starting in the window. The match can extend past the
+        # current position, since the decoder copies references byte by byte.
+        start = max(0, i - WINDOW_SIZE)
+        match_pos = -1
+        length = 0
+        while length < MAX_LENGTH2 and i + length < len(data):
+            pos = data.rfind(data[i:i + length + 1], start, i + length)
+            if pos == -1:
+                break
+            match_pos = pos
+            length += 1
+
+        distance = i - match_pos
+        single_byte = length <= MAX_LENGTH1 and distance <= MAX_DISTANCE1
+        if single_byte and length >= BREAKEVEN1 or length >= BREAKEVEN2:
+            append_token_type(1)
+            if single_byte:
+                out.append((distance - 1) << (LENGTH_BITS1 + 1) | (length - BREAKEVEN1) << 1)
+            else:
+                backref = (distance - 1) << (LENGTH_BITS2 + 1) | (length - BREAKEVEN2) << 1 | 0x1
+                out += backref.to_bytes(2, "little")
+            i += length
+        else:
+            append_token_type(0)
+            out.append(data[i])
+            i += 1
+
+    return bytes(out)
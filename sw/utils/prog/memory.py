@@ -14,16 +14,20 @@
 
 import abc
 import argparse
+import mmap
 import sys
 from dataclasses import dataclass
 from pathlib import Path
-from typing import List, Union
+from typing import List, Union, Tuple
 
 from bitarray import bitarray
 
 from prog.comm import ProgError
 from utils import parse_dec_or_hex_number, ProgressCallback, PathLike, print_progress_bar, \
-    process_bitarray_sequences
+    process_bitarray_sequences, boot_crc16
+
+# first system app version supporting the CRC packet.
+DEVICE_CRC_VERSION = 6
 
 STD_IO = "-"
 
@@ -76,6 +80,40 @@ class MemoryDriver(abc.ABC):
         """Write `data` to memory device at start `address`, with `progress` callback."""
         raise NotImplementedError
 
+    def has_crc(self) -> bool:
+        """Returns true if the memory device can compute the CRC of its content with `crc`."""
+        return False
+
+    def crc(self, address: int, count: int) -> int:
+        """Returns the CRC of `count` bytes at start `address` on the memory device, computed
+        like `boot_crc16`. Only available if `has_crc` returns true."""
+        raise NotImplementedError
+
+    def crcs(self, ranges: List[Tuple[int, int]]) -> List[int]:
+        """Returns the CRC of each (address, count) range, like `crc`. Drivers may send
+        the requests for all ranges without waiting for each of them to complete."""
+        return [self.crc(address, count) for address, count in ranges]
+
+    def has_copy(self) -> bool:
+        """Returns true if the memory device can copy data internally with `copy`."""
+        return False
+
+    def copy(self, from_addr: int, to_addr: int, count: int) -> None:
+        """Copy `count` bytes from `from_addr` to `to_addr` on the memory device, without
+        transferring the data. The destination must be erased and must not overlap the source.
+        Only available if `has_copy` returns true."""
+        raise NotImplementedError
+
+    def has_direct_access(self) -> bool:
+        """Returns true if the memory can be written at any address without erasing first and
+        with no cost per operation, in which case operations are done directly on it."""
+        return False
+
+    def verify(self, address: int, data: bytes, progress: ProgressCallback) -> bool:
+        """Returns true if the memory device contains `data` at start `address`, with `progress`
+        callback. By default, data is read back and compared."""
+        return self.read(address, len(data), progress) == data
+
     def erase_blocks(self, blocks: bitarray, progress: ProgressCallback) -> None:
         """Erase blocks on memory device before writing sequences, with `progress` callback.
         The `blocks` bit array indicates which blocks (the smallest block size) to erase."""
@@ -88,33 +126,33 @@ class MemoryDriver(abc.ABC):
 
 
 class MemoryLocal(MemoryDriver):
-    """Memory driver for local memory stored in a file."""
+    """Memory driver for local memory stored in a file. The file is memory-mapped, so that
+    only the regions read or written are accessed, and writes go directly to the file."""
     filename: Path
     erase_byte: int
     erase_before_write: bool
     block_erase_size: int
 
-    data: bytearray
+    data: mmap.mmap
 
     def __init__(self, filename: PathLike, size: int, erase_byte: int,
                  block_erase_size: int, erase_before_write: bool):
-        """Initialize local memory by reading a file. If the file doesn't exist,
-        the memory is initialized to the erase byte and with a size in bytes."""
+        """Initialize local memory by mapping a file. If the file doesn't exist or is too small,
+        it is extended to a size in bytes with the erase byte."""
         self.filename = Path(filename)
         self.erase_byte = erase_byte
         self.block_erase_size = block_erase_size
         self.erase_before_write = erase_before_write
 
-        self.data = bytearray(size)
-        for i in range(size):
-            self.data[i] = erase_byte
-        if self.filename.exists():
-            try:
-                with open(self.filename, "rb") as file:
-                    data = file.read()
-                    self.data[:min(size, len(data))] = data
-            except IOError as e:
-                raise ProgError(f"failed to read file '{filename}': {e}")
+        try:
+            with open(self.filename, "ab") as file:
+                length = file.tell()
+                if length < size:
+                    file.write(bytes([erase_byte]) * (size - length))
+            with open(self.filename, "r+b") as file:
+                self.data = mmap.mmap(file.fileno(), size)
+        except (IOError, ValueError) as e:
+            raise ProgError(f"failed to map file '{filename}': {e}")
 
     def get_size(self) -> int:
         return len(self.data)
@@ -125,6 +163,9 @@ class MemoryLocal(MemoryDriver):
     def get_smallest_erase_size(self) -> int:
         return self.block_erase_size
 
+    def has_direct_access(self) -> bool:
+        return True
+
     def read(self, address: int, count: int, progress: ProgressCallback) -> bytes:
         progress(count, count)
         return self.data[address:address + count]
@@ -134,27 +175,23 @@ class MemoryLocal(MemoryDriver):
         progress(len(data), len(data))
 
     def erase_blocks(self, blocks: bitarray, progress: ProgressCallback) -> None:
-        pos = 0
         block_size = self.get_smallest_erase_size()
+        erased = bytes([self.erase_byte]) * block_size
         for i in range(self.get_block_count()):
             if blocks[i]:
-                for j in range(block_size):
-                    self.data[pos + j] = self.erase_byte
-            pos += block_size
+                self.data[i * block_size:(i + 1) * block_size] = erased
         total_erased = blocks.count() * block_size
         progress(total_erased, total_erased)
 
     def erase(self, progress: ProgressCallback) -> None:
-        all_blocks = bitarray(self.get_block_count())
-        all_blocks.setall(True)
-        self.erase_blocks(all_blocks, progress)
+        self.data[:] = bytes([self.erase_byte]) * len(self.data)
+        progress(len(self.data), len(self.data))
 
     def save(self) -> None:
-        """Save local memory to file."""
+        """Flush changes to the file, they are otherwise written when the file is unmapped."""
         try:
-            with open(self.filename, "wb") as file:
-                file.write(self.data)
-        except IOError as e:
+            self.data.flush()
+        except OSError as e:
             raise ProgError(f"failed to write file '{self.filename}': {e}")
 
 
@@ -183,6 +220,11 @@ class MemoryManager:
 
     operations: List[Union[Read, Write, Copy]]
 
+    # number of blocks compared at once using the CRC, between progress updates.
+    CRC_BATCH_SIZE = 16
+    # size of the chunks compared and only written if changed, with direct access.
+    DIRECT_CHUNK_SIZE = 4096
+
     def __init__(self, driver: MemoryDriver, verbose: bool = True):
         self.driver = driver
         self.verbose = verbose
@@ -219,10 +261,48 @@ class MemoryManager:
         for i in range(start_block, end_block):
             mask[i] = True
 
+    def _execute_direct(self) -> List[bytes]:
+        """Execute operations on a driver with direct access. Reads and copy sources are done
+        first since all operations apply to the initial state, then only the bytes that differ
+        from the current content are written, without erasing or splitting into blocks."""
+        def no_progress(_count: int, _total: int) -> None:
+            pass
+
+        read_sequences = []
+        copied_data = []
+        for op in self.operations:
+            if isinstance(op, MemoryManager.Read):
+                read_sequences.append(self.driver.read(op.address, op.size, no_progress))
+            elif isinstance(op, MemoryManager.Copy):
+                copied_data.append(self.driver.read(op.from_addr, op.size, no_progress))
+
+        copied_data.reverse()
+        written = 0
+        for op in self.operations:
+            if isinstance(op, MemoryManager.Write):
+                address, data = op.address, op.data
+            elif isinstance(op, MemoryManager.Copy):
+                address, data = op.to_addr, copied_data.pop()
+            else:
+                continue
+            for pos in range(0, len(data), MemoryManager.DIRECT_CHUNK_SIZE):
+                chunk = data[pos:pos + MemoryManager.DIRECT_CHUNK_SIZE]
+                if self.driver.read(address + pos, len(chunk), no_progress) != chunk:
+                    self.driver.write(address + pos, chunk, no_progress)
+                    written += len(chunk)
+
+        if self.verbose and written == 0 and len(read_sequences) < len(self.operations):
+            print("No bytes to write, data is identical on device.")
+        self.operations.clear()
+        return read_sequences
+
     def execute(self) -> List[bytes]:
         if not self.operations:
             return []
 
+        if self.driver.has_direct_access():
+            return self._execute_direct()
+
         self.driver.reset()
         mem_size = self.driver.get_size()
         block_size = self.driver.get_smallest_erase_size()
@@ -249,9 +329,14 @@ class MemoryManager:
                 self._mark_block(extend_read_mask, op.to_addr, 0)
                 self._mark_block(extend_read_mask, op.to_addr + op.size, 0)
                 self._mark_block(write_mask, op.to_addr, op.size)
-        # to allow diffing, all written blocks will be also read beforehand
+        # to allow diffing, all written blocks will be also read beforehand, except blocks that
+        # are entirely overwritten if the device can compute their CRC to compare it instead.
+        crc_mask = bitarray(block_count)
+        crc_mask.setall(False)
+        if self.driver.has_crc() and block_size > 1:
+            crc_mask = write_mask & ~(read_mask | extend_read_mask)
         read_mask |= extend_read_mask
-        read_mask |= write_mask
+        read_mask |= write_mask & ~crc_mask
 
         # read marked blocks from device
         def read_process(start: int, end: int, progress: ProgressCallback) -> None:
@@ -291,10 +376,24 @@ class MemoryManager:
         pos = 0
         for i in range(block_count):
             end = pos + block_size
-            if write_mask[i] and write_data[pos:end] == read_data[pos:end]:
+            if write_mask[i] and not crc_mask[i] and write_data[pos:end] == read_data[pos:end]:
                 write_mask[i] = False
             pos = end
 
+        # unset blocks in write mask whose CRC on device matches the data to write
+        def compare_process(start: int, end: int, progress: ProgressCallback) -> None:
+            ranges = [(pos, block_size) for pos in range(start, end, block_size)]
+            for i in range(0, len(ranges), MemoryManager.CRC_BATCH_SIZE):
+                batch = ranges[i:i + MemoryManager.CRC_BATCH_SIZE]
+                for (pos, _), crc in zip(batch, self.driver.crcs(batch)):
+                    if crc == boot_crc16(write_data[pos:pos + block_size]):
+                        write_mask[pos // block_size] = False
+                progress(batch[-1][0] + block_size - start, end - start)
+
+        if crc_mask.any():
+            process_bitarray_sequences(self.driver, crc_mask, "Comparing",
+                                       compare_process, self.verbose)
+
         # at this point check if there's actually anything to write
         if not write_mask.any():
             if self.verbose:
@@ -314,8 +413,7 @@ class MemoryManager:
 
         # verify written data against expected data
         def verify_process(start: int, end: int, progress: ProgressCallback) -> None:
-            data = self.driver.read(start, end - start, progress)
-            if data != write_data[start:end]:
+            if not self.driver.verify(start, write_data[start:end], progress):
                 raise ProgError("verification failed, check serial connection and try again")
 
         process_bitarray_sequences(self.driver, write_mask, "Verifying",
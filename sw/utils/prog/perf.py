@@ -0,0 +1,138 @@
+#  Copyright 2022 Nicolas Maltais
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+import time
+from dataclasses import dataclass
+from typing import List, Optional
+
+from prog.comm import CommInterface, PacketType, Packet, ProgError
+from utils import DataReader, PathLike
+
+# system tick frequency, see core/time.h
+SYSTICK_FREQUENCY = 256
+
+# frame time histogram buckets, see system.h
+FRAME_TIME_BUCKETS = 8
+FRAME_TIME_BUCKET_TICKS = 4
+
+# main loop phases, see sys_loop_phase_t in sys/time.h
+LOOP_PHASES = ["other", "battery", "sound", "loop", "draw", "display", "idle"]
+
+# first system app version supporting the perf stats packet.
+PERF_STATS_VERSION = 11
+
+
+@dataclass
+class PerfStats:
+    elapsed: float  # seconds
+    frame_times: List[int]
+    skipped_frames: int
+    sound_isr_count: Optional[int]
+    loop_samples: Optional[List[int]]
+    stack_high_water: Optional[int]  # bytes
+    stack_space: Optional[int]  # bytes
+
+    @property
+    def frames(self) -> int:
+        return sum(self.frame_times)
+
+
+class PerfManager:
+    comm: CommInterface
+
+    def __init__(self, comm: CommInterface):
+        self.comm = comm
+
+    def _get_stats(self) -> PerfStats:
+        self.comm.write(Packet(PacketType.PERF_STATS))
+        payload = self.comm.read().payload
+        if len(payload) not in (37, 41):
+            raise ProgError("short perf stats packet")
+        reader = DataReader(payload)
+        elapsed = reader.read(2) / SYSTICK_FREQUENCY
+        frame_times = [reader.read(2) for _ in range(FRAME_TIME_BUCKETS)]
+        skipped_frames = reader.read(2)
+        sound_isr_count = reader.read(2)
+        loop_samples = [reader.read(2) for _ in LOOP_PHASES]
+        flags = reader.read(1)
+        stack_high_water = None
+        stack_space = None
+        if len(payload) > 37:
+            # stack usage is only reported since system app version 12.
+            stack_high_water = reader.read(2)
+            stack_space = reader.read(2)
+            if stack_space == 0:
+                # not measured in simulation.
+                stack_high_water = None
+                stack_space = None
+        return PerfStats(elapsed, frame_times, skipped_frames,
+                         sound_isr_count if flags & 0x2 else None,
+                         loop_samples if flags & 0x1 else None,
+                         stack_high_water, stack_space)
+
+    @staticmethod
+    def _format_stats(stats: PerfStats) -> str:
+        line = f"{stats.frames / stats.elapsed:5.1f} fps, {stats.skipped_frames} skipped"
+        # show the frame time histogram, with the frame count for each bucket.
+        line += ", frame time (ms):"
+        for i, count in enumerate(stats.frame_times):
+            if count:
+                start_ms = i * FRAME_TIME_BUCKET_TICKS * 1000 / SYSTICK_FREQUENCY
+                plus = "+" if i == FRAME_TIME_BUCKETS - 1 else ""
+                line += f" {start_ms:.0f}{plus}:{count}"
+        if stats.sound_isr_count is not None:
+            line += f", sound {stats.sound_isr_count / stats.elapsed:.0f} isr/s"
+        if stats.loop_samples is not None:
+            total = sum(stats.loop_samples)
+            if total:
+                line += ", loop:"
+                for name, samples in zip(LOOP_PHASES, stats.loop_samples):
+                    line += f" {name} {samples / total:.0%}"
+        if stats.stack_space is not None:
+            line += f", stack {stats.stack_high_water}/{stats.stack_space} B"
+        return line
+
+    def log(self, interval: float, count: int, output_file: Optional[PathLike]) -> None:
+        """Log performance stats every `interval` seconds, `count` times or indefinitely if
+        zero. Stats are printed and optionally saved to a CSV file."""
+        file = None
+        if output_file:
+            file = open(output_file, "w")
+            file.write("time,elapsed,skipped," +
+                       ",".join(f"frame_time_{i}" for i in range(FRAME_TIME_BUCKETS)) +
+                       ",sound_isr," + ",".join(f"loop_{name}" for name in LOOP_PHASES) +
+                       ",stack_high_water,stack_space\n")
+
+        # first request only resets the counters.
+        self._get_stats()
+        start_time = time.time()
+        n = 0
+        try:
+            while count == 0 or n < count:
+                time.sleep(interval)
+                stats = self._get_stats()
+                t = time.time() - start_time
+                print(f"[{t:7.1f} s] {PerfManager._format_stats(stats)}")
+                if file:
+                    values = [f"{t:.3f}", f"{stats.elapsed:.3f}", str(stats.skipped_frames)]
+                    values += [str(c) for c in stats.frame_times]
+                    values.append(str(stats.sound_isr_count or 0))
+                    values += [str(s) for s in stats.loop_samples or [0] * len(LOOP_PHASES)]
+                    values.append(str(stats.stack_high_water or 0))
+                    values.append(str(stats.stack_space or 0))
+                    file.write(",".join(values) + "\n")
+                    file.flush()
+                n += 1
+        finally:
+            if file:
+                file.close()
@@ -12,10 +12,10 @@
 #  See the License for the specific language governing permissions and
 #  limitations under the License.
 from enum import Enum
-from typing import Sequence
+from typing import Sequence, List, Tuple
 
 from prog.comm import CommInterface, PacketType, Packet, ProgError
-from utils import ProgressCallback
+from utils import ProgressCallback, boot_crc16
 
 
 class SpiPeripheral(Enum):
@@ -88,3 +88,70 @@ class SpiInterface:
                 progress(pos, len(data))
 
         return read
+
+    # maximum number of bytes per CRC packet, so that the response comes before the read timeout.
+    MAX_CRC_SIZE = 4096
+
+    def transceive_all(self, transfers: Sequence[Sequence[int]]) -> List[bytes]:
+        """Do multiple independent transfers with the peripheral, each being the last transfer
+        (the CS line is released after each). Each transfer must fit in a single packet.
+        Packets are written without waiting for previous responses if possible."""
+        if self.peripheral == SpiPeripheral.NONE:
+            raise RuntimeError("No SPI peripheral set before transfer")
+        packets = []
+        for data in transfers:
+            if len(data) > SpiInterface.MAX_TRANSFER_SIZE:
+                raise ValueError("SPI transfer too large for single packet")
+            payload_tx = bytearray([self.peripheral.value | 0x80])
+            payload_tx += bytes(data)
+            packets.append(Packet(PacketType.SPI, payload_tx))
+        self.last_transfer = True
+        received = []
+        for packet, response in zip(packets, self.comm.transact(packets)):
+            if len(response.payload) != len(packet.payload):
+                raise ProgError("short SPI packet")
+            received.append(response.payload[1:])
+        return received
+
+    def crc_all(self, ranges: Sequence[Tuple[int, int]]) -> List[int]:
+        """Returns the CRC of each (address, count) range on the flash or EEPROM peripheral,
+        computed by the device. `count` must not exceed `MAX_CRC_SIZE`."""
+        if self.peripheral not in (SpiPeripheral.FLASH, SpiPeripheral.EEPROM):
+            raise RuntimeError("CRC is only supported for memory peripherals")
+        packets = []
+        for address, count in ranges:
+            payload = bytearray([self.peripheral.value])
+            payload += address.to_bytes(3, "big", signed=False)
+            payload += count.to_bytes(3, "big", signed=False)
+            packets.append(Packet(PacketType.CRC_RANGE, payload))
+        crcs = []
+        for response in self.comm.transact(packets):
+            if len(response.payload) != 2:
+                raise ProgError("short CRC packet")
+            crcs.append(response.payload[0] | response.payload[1] << 8)
+        return crcs
+
+    def crc(self, address: int, count: int) -> int:
+        """Returns the CRC of `count` bytes at `address` on the flash or EEPROM peripheral,
+        computed by the device. `count` must not exceed `MAX_CRC_SIZE`."""
+        return self.crc_all([(address, count)])[0]
+
+    # number of CRC packets sent at once when verifying, between progress updates.
+    CRC_BATCH_SIZE = 16
+
+    def verify_crc(self, address: int, data: bytes, progress: ProgressCallback) -> bool:
+        """Verify that the flash or EEPROM peripheral contains `data` at `address`, using CRCs
+        computed by the device instead of reading the data back."""
+        pos = 0
+        batch_size = SpiInterface.MAX_CRC_SIZE * SpiInterface.CRC_BATCH_SIZE
+        while pos < len(data):
+            end = min(len(data), pos + batch_size)
+            ranges = [(address + p, min(SpiInterface.MAX_CRC_SIZE, end - p))
+                      for p in range(pos, end, SpiInterface.MAX_CRC_SIZE)]
+            for (chunk_addr, count), crc in zip(ranges, self.crc_all(ranges)):
+                chunk_pos = chunk_addr - address
+                if crc != boot_crc16(data[chunk_pos:chunk_pos + count]):
+                    return False
+            pos = end
+            progress(pos, len(data))
+        return True
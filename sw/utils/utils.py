@@ -75,6 +75,11 @@ def parse_dec_or_hex_number(s: str) -> int:
         return int(s, 10)
 
 
+def align(value: int, alignment: int) -> int:
+    """Round value up to a multiple of alignment, which must be a power of two."""
+    return (value + alignment - 1) & ~(alignment - 1)
+
+
 def readable_size(size: int) -> str:
     """Print size in human readable format, with units."""
     if size < 1024: